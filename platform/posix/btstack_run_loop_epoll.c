@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_run_loop_epoll.c"
+
+/*
+ *  btstack_run_loop_epoll.c
+ *
+ *  Run loop for Linux based on epoll. File descriptors are registered with the kernel once
+ *  when the data source is added, so each iteration only needs to look at the ready data sources.
+ *  Timers are managed by btstack_run_loop_base.
+ */
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include "btstack_run_loop_epoll.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+#include "btstack_linked_list.h"
+#include "btstack_debug.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+// max number of ready events processed per iteration
+#ifndef BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS
+#define BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS 32
+#endif
+
+static int epoll_fd = -1;
+static int data_sources_modified;
+
+// start time. tv_nsec = 0
+static struct timespec init_ts;
+
+static uint32_t btstack_run_loop_epoll_events_for_flags(uint16_t flags){
+    uint32_t events = 0;
+    if (flags & DATA_SOURCE_CALLBACK_READ){
+        events |= EPOLLIN;
+    }
+    if (flags & DATA_SOURCE_CALLBACK_WRITE){
+        events |= EPOLLOUT;
+    }
+    // EPOLLHUP and EPOLLERR are always reported. Without any interest, use edge-triggered mode
+    // to get them at most once instead of waking up the run loop over and over
+    if (events == 0){
+        events = EPOLLET;
+    }
+    return events;
+}
+
+static int btstack_run_loop_epoll_ctl(int op, btstack_data_source_t * ds){
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events   = btstack_run_loop_epoll_events_for_flags(ds->flags);
+    event.data.ptr = ds;
+    return epoll_ctl(epoll_fd, op, ds->source.fd, &event);
+}
+
+/**
+ * Add data_source to run_loop
+ */
+static void btstack_run_loop_epoll_add_data_source(btstack_data_source_t *ds){
+    data_sources_modified = 1;
+    btstack_run_loop_base_add_data_source(ds);
+    if (ds->source.fd < 0) return;
+    int err = btstack_run_loop_epoll_ctl(EPOLL_CTL_ADD, ds);
+    if (err != 0){
+        log_error("btstack_run_loop_epoll_add_data_source: epoll_ctl for fd %u failed, errno %u", ds->source.fd, errno);
+    }
+}
+
+/**
+ * Remove data_source from run loop
+ */
+static bool btstack_run_loop_epoll_remove_data_source(btstack_data_source_t *ds){
+    data_sources_modified = 1;
+    log_debug("btstack_run_loop_epoll_remove_data_source %p", ds);
+    if (ds->source.fd >= 0){
+        // ignore error, fd might have been closed before
+        (void) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ds->source.fd, NULL);
+    }
+    return btstack_run_loop_base_remove_data_source(ds);
+}
+
+static void btstack_run_loop_epoll_update_data_source(btstack_data_source_t * ds){
+    if (ds->source.fd < 0) return;
+    // data source might not have been added yet, interest is set on add then
+    int err = btstack_run_loop_epoll_ctl(EPOLL_CTL_MOD, ds);
+    if ((err != 0) && (errno != ENOENT)){
+        log_error("btstack_run_loop_epoll_update_data_source: epoll_ctl for fd %u failed, errno %u", ds->source.fd, errno);
+    }
+}
+
+static void btstack_run_loop_epoll_enable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    uint16_t old_flags = ds->flags;
+    btstack_run_loop_base_enable_data_source_callbacks(ds, callback_types);
+    if (ds->flags == old_flags) return;
+    btstack_run_loop_epoll_update_data_source(ds);
+}
+
+static void btstack_run_loop_epoll_disable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    uint16_t old_flags = ds->flags;
+    btstack_run_loop_base_disable_data_source_callbacks(ds, callback_types);
+    if (ds->flags == old_flags) return;
+    btstack_run_loop_epoll_update_data_source(ds);
+}
+
+/**
+ * Add timer to run_loop (keep list sorted)
+ */
+static void btstack_run_loop_epoll_add_timer(btstack_timer_source_t *ts){
+    btstack_run_loop_base_add_timer(ts);
+    log_debug("Added timer %p at %u", ts, ts->timeout);
+}
+
+/**
+ * Remove timer from run loop
+ */
+static bool btstack_run_loop_epoll_remove_timer(btstack_timer_source_t *ts){
+    return btstack_run_loop_base_remove_timer(ts);
+}
+
+static void btstack_run_loop_epoll_dump_timer(void){
+    btstack_run_loop_base_dump_timer();
+}
+
+/**
+ * @brief Queries the current time in ms since start
+ */
+static uint32_t btstack_run_loop_epoll_get_time_ms(void){
+    struct timespec now_ts;
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+    time_t   delta_sec  = now_ts.tv_sec  - init_ts.tv_sec;
+    long     delta_nsec = now_ts.tv_nsec - init_ts.tv_nsec;
+    uint64_t delta_ms   = ((uint64_t) delta_sec * 1000) + (delta_nsec / 1000000);
+    return (uint32_t) delta_ms;
+}
+
+void btstack_run_loop_epoll_execute_once(void){
+    struct epoll_event events[BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS];
+
+    // get next timeout, -1 = wait forever
+    uint32_t now_ms = btstack_run_loop_epoll_get_time_ms();
+    int timeout_ms = (int) btstack_run_loop_base_get_time_until_timeout(now_ms);
+    log_debug("btstack_run_loop_epoll_execute_once next timeout in %d ms", timeout_ms);
+
+    // wait for ready FDs
+    int num_events = epoll_wait(epoll_fd, events, BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS, timeout_ms);
+    if (num_events < 0){
+        if (errno != EINTR){
+            log_error("btstack_run_loop_epoll_execute_once: epoll_wait failed, errno %u", errno);
+        }
+        num_events = 0;
+    }
+
+    // process ready data sources. stop if data sources have been modified as the remaining
+    // events might refer to removed data sources. level-triggered events are reported again
+    data_sources_modified = 0;
+    int i;
+    for (i = 0; (i < num_events) && !data_sources_modified; i++){
+        btstack_data_source_t * ds = (btstack_data_source_t *) events[i].data.ptr;
+        uint32_t ready = events[i].events;
+        if ((ready & (EPOLLIN | EPOLLHUP | EPOLLERR)) && (ds->flags & DATA_SOURCE_CALLBACK_READ)){
+            log_debug("btstack_run_loop_epoll_execute_once: process read ds %p with fd %u", ds, ds->source.fd);
+            ds->process(ds, DATA_SOURCE_CALLBACK_READ);
+        }
+        if (data_sources_modified) break;
+        if ((ready & (EPOLLOUT | EPOLLERR)) && (ds->flags & DATA_SOURCE_CALLBACK_WRITE)){
+            log_debug("btstack_run_loop_epoll_execute_once: process write ds %p with fd %u", ds, ds->source.fd);
+            ds->process(ds, DATA_SOURCE_CALLBACK_WRITE);
+        }
+    }
+
+    // process timers
+    btstack_run_loop_base_process_timers(btstack_run_loop_epoll_get_time_ms());
+}
+
+/**
+ * Execute run_loop
+ */
+static void btstack_run_loop_epoll_execute(void) {
+    log_info("epoll run loop");
+    while (true) {
+        btstack_run_loop_epoll_execute_once();
+    }
+}
+
+// set timer
+static void btstack_run_loop_epoll_set_timer(btstack_timer_source_t *a, uint32_t timeout_in_ms){
+    uint32_t time_ms = btstack_run_loop_epoll_get_time_ms();
+    a->timeout = time_ms + timeout_in_ms;
+    log_debug("btstack_run_loop_epoll_set_timer to %u ms (now %u, timeout %u)", a->timeout, time_ms, timeout_in_ms);
+}
+
+static void btstack_run_loop_epoll_init(void){
+    btstack_run_loop_base_init();
+    if (epoll_fd >= 0){
+        close(epoll_fd);
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    btstack_assert(epoll_fd >= 0);
+    clock_gettime(CLOCK_MONOTONIC, &init_ts);
+    init_ts.tv_nsec = 0;
+}
+
+static const btstack_run_loop_t btstack_run_loop_epoll = {
+    &btstack_run_loop_epoll_init,
+    &btstack_run_loop_epoll_add_data_source,
+    &btstack_run_loop_epoll_remove_data_source,
+    &btstack_run_loop_epoll_enable_data_source_callbacks,
+    &btstack_run_loop_epoll_disable_data_source_callbacks,
+    &btstack_run_loop_epoll_set_timer,
+    &btstack_run_loop_epoll_add_timer,
+    &btstack_run_loop_epoll_remove_timer,
+    &btstack_run_loop_epoll_execute,
+    &btstack_run_loop_epoll_dump_timer,
+    &btstack_run_loop_epoll_get_time_ms,
+};
+
+/**
+ * Provide btstack_run_loop_epoll instance
+ */
+const btstack_run_loop_t * btstack_run_loop_epoll_get_instance(void){
+    return &btstack_run_loop_epoll;
+}
@@ -53,6 +53,7 @@
 #include "btstack_linked_list.h"
 #include "btstack_debug.h"
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/select.h>
@@ -60,6 +61,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
 static void btstack_run_loop_posix_dump_timer(void);
 
 // the run loop
@@ -67,6 +72,32 @@ static btstack_linked_list_t data_sources;
 static int data_sources_modified;
 static btstack_linked_list_t timers;
 
+// callback queue for other threads: bounded lock-free multi-producer / single-consumer queue
+// each cell has a sequence number that tells producers and consumer if it's free or filled
+#ifndef BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH
+#define BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH 256
+#endif
+
+#if (BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH & (BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH - 1)) != 0
+#error "BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH must be a power of two"
+#endif
+
+typedef struct {
+    uint32_t sequence;
+    void (*fn)(void *arg);
+    void * arg;
+} function_call_t;
+
+static function_call_t function_calls[BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH];
+static uint32_t function_calls_enqueue_pos;
+static uint32_t function_calls_dequeue_pos;
+
+// wakeup via eventfd (Linux) or self-pipe
+static btstack_data_source_t trigger_data_source;
+static int trigger_read_fd  = -1;
+static int trigger_write_fd = -1;
+static uint32_t trigger_pending;
+
 // start time. tv_usec/tv_nsec = 0
 #ifdef _POSIX_MONOTONIC_CLOCK
 // use monotonic clock if available
@@ -140,6 +171,123 @@ static void btstack_run_loop_posix_disable_data_source_callbacks(btstack_data_so
     ds->flags &= ~callback_types;
 }
 
+static bool btstack_run_loop_posix_function_call_enqueue(void (*fn)(void *arg), void * arg){
+    uint32_t pos = __atomic_load_n(&function_calls_enqueue_pos, __ATOMIC_RELAXED);
+    function_call_t * call;
+    while (true){
+        call = &function_calls[pos & (BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH - 1)];
+        uint32_t sequence = __atomic_load_n(&call->sequence, __ATOMIC_ACQUIRE);
+        int32_t delta = (int32_t) (sequence - pos);
+        if (delta == 0){
+            // cell is free, try to claim it. on failure, pos gets updated
+            if (__atomic_compare_exchange_n(&function_calls_enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if (delta < 0){
+            // queue full
+            return false;
+        } else {
+            // other producer was faster
+            pos = __atomic_load_n(&function_calls_enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    call->fn  = fn;
+    call->arg = arg;
+    // publish to consumer
+    __atomic_store_n(&call->sequence, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool btstack_run_loop_posix_function_call_dequeue(function_call_t * message){
+    uint32_t pos = function_calls_dequeue_pos;
+    function_call_t * call = &function_calls[pos & (BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH - 1)];
+    uint32_t sequence = __atomic_load_n(&call->sequence, __ATOMIC_ACQUIRE);
+    if (sequence != (pos + 1)) return false;
+    message->fn  = call->fn;
+    message->arg = call->arg;
+    function_calls_dequeue_pos = pos + 1;
+    // release cell for next round
+    __atomic_store_n(&call->sequence, pos + BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void btstack_run_loop_posix_function_calls_init(void){
+    uint32_t i;
+    for (i = 0; i < BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH; i++){
+        function_calls[i].sequence = i;
+        function_calls[i].fn  = NULL;
+        function_calls[i].arg = NULL;
+    }
+    function_calls_enqueue_pos = 0;
+    function_calls_dequeue_pos = 0;
+}
+
+void btstack_run_loop_posix_trigger(void){
+    // only the first trigger after the run loop woke up needs to write to the fd
+    if (__atomic_exchange_n(&trigger_pending, 1, __ATOMIC_SEQ_CST) != 0) return;
+#ifdef __linux__
+    uint64_t value = 1;
+#else
+    uint8_t value = 1;
+#endif
+    ssize_t bytes_written = write(trigger_write_fd, &value, sizeof(value));
+    UNUSED(bytes_written);
+}
+
+bool btstack_run_loop_posix_execute_code_on_main_thread(void (*fn)(void *arg), void * arg){
+    bool ok = btstack_run_loop_posix_function_call_enqueue(fn, arg);
+    btstack_run_loop_posix_trigger();
+    return ok;
+}
+
+static void btstack_run_loop_posix_trigger_process(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint8_t buffer[8];
+    ssize_t bytes_read = read(ds->source.fd, buffer, sizeof(buffer));
+    UNUSED(bytes_read);
+    // clear pending flag before draining the queue, so calls enqueued from now on trigger another wakeup
+    __atomic_store_n(&trigger_pending, 0, __ATOMIC_SEQ_CST);
+
+    // process queued calls in batch, limited to queue length to not starve other data sources
+    uint32_t num_calls;
+    for (num_calls = 0; num_calls < BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH; num_calls++){
+        function_call_t message;
+        if (btstack_run_loop_posix_function_call_dequeue(&message) == false) return;
+        if (message.fn != NULL){
+            message.fn(message.arg);
+        }
+    }
+    // more calls pending
+    btstack_run_loop_posix_trigger();
+}
+
+static void btstack_run_loop_posix_trigger_init(void){
+    if (trigger_read_fd >= 0){
+        close(trigger_read_fd);
+        if (trigger_write_fd != trigger_read_fd){
+            close(trigger_write_fd);
+        }
+    }
+#ifdef __linux__
+    trigger_read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    btstack_assert(trigger_read_fd >= 0);
+    trigger_write_fd = trigger_read_fd;
+#else
+    int fds[2];
+    int res = pipe(fds);
+    btstack_assert(res == 0);
+    UNUSED(res);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    trigger_read_fd  = fds[0];
+    trigger_write_fd = fds[1];
+#endif
+    trigger_pending = 0;
+    btstack_run_loop_posix_function_calls_init();
+    btstack_run_loop_set_data_source_fd(&trigger_data_source, trigger_read_fd);
+    btstack_run_loop_set_data_source_handler(&trigger_data_source, &btstack_run_loop_posix_trigger_process);
+    trigger_data_source.flags = DATA_SOURCE_CALLBACK_READ;
+    btstack_run_loop_posix_add_data_source(&trigger_data_source);
+}
+
 #ifdef _POSIX_MONOTONIC_CLOCK
 /**
  * @brief Returns the timespec which represents the time(stop - start). It might be negative
@@ -193,10 +341,7 @@ static uint32_t btstack_run_loop_posix_get_time_ms(void){
     return time_ms;
 }
 
-/**
- * Execute run_loop
- */
-static void btstack_run_loop_posix_execute(void) {
+void btstack_run_loop_posix_execute_once(void) {
     fd_set descriptors_read;
     fd_set descriptors_write;
     
@@ -206,87 +351,94 @@ static void btstack_run_loop_posix_execute(void) {
     struct timeval tv;
     uint32_t now_ms;
 
-#ifdef _POSIX_MONOTONIC_CLOCK
-    log_info("POSIX run loop with monotonic clock");
-#else
-    log_info("POSIX run loop using ettimeofday fallback.");
-#endif
-
-    while (true) {
-        // collect FDs
-        FD_ZERO(&descriptors_read);
-        FD_ZERO(&descriptors_write);
-        int highest_fd = -1;
-        btstack_linked_list_iterator_init(&it, &data_sources);
-        while (btstack_linked_list_iterator_has_next(&it)){
-            btstack_data_source_t *ds = (btstack_data_source_t*) btstack_linked_list_iterator_next(&it);
-            if (ds->source.fd < 0) continue;
-            if (ds->flags & DATA_SOURCE_CALLBACK_READ){
-                FD_SET(ds->source.fd, &descriptors_read);
-                if (ds->source.fd > highest_fd) {
-                    highest_fd = ds->source.fd;
-                }
-                log_debug("btstack_run_loop_execute adding fd %u for read", ds->source.fd);
-            }
-            if (ds->flags & DATA_SOURCE_CALLBACK_WRITE){
-                FD_SET(ds->source.fd, &descriptors_write);
-                if (ds->source.fd > highest_fd) {
-                    highest_fd = ds->source.fd;
-                }
-                log_debug("btstack_run_loop_execute adding fd %u for write", ds->source.fd);
+    // collect FDs
+    FD_ZERO(&descriptors_read);
+    FD_ZERO(&descriptors_write);
+    int highest_fd = -1;
+    btstack_linked_list_iterator_init(&it, &data_sources);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        btstack_data_source_t *ds = (btstack_data_source_t*) btstack_linked_list_iterator_next(&it);
+        if (ds->source.fd < 0) continue;
+        if (ds->flags & DATA_SOURCE_CALLBACK_READ){
+            FD_SET(ds->source.fd, &descriptors_read);
+            if (ds->source.fd > highest_fd) {
+                highest_fd = ds->source.fd;
             }
+            log_debug("btstack_run_loop_execute adding fd %u for read", ds->source.fd);
         }
-        
-        // get next timeout
-        timeout = NULL;
-        if (timers) {
-            ts = (btstack_timer_source_t *) timers;
-            timeout = &tv;
-            uint32_t list_timeout  = ts->timeout;
-            now_ms = btstack_run_loop_posix_get_time_ms();
-            int32_t delta = btstack_time_delta(list_timeout, now_ms);
-            if (delta < 0){
-                delta = 0;
+        if (ds->flags & DATA_SOURCE_CALLBACK_WRITE){
+            FD_SET(ds->source.fd, &descriptors_write);
+            if (ds->source.fd > highest_fd) {
+                highest_fd = ds->source.fd;
             }
-            tv.tv_sec  = delta / 1000;
-            tv.tv_usec = (int) (delta - (tv.tv_sec * 1000)) * 1000;
-            log_debug("btstack_run_loop_execute next timeout in %u ms", delta);
+            log_debug("btstack_run_loop_execute adding fd %u for write", ds->source.fd);
         }
-                
-        // wait for ready FDs
-        select( highest_fd+1 , &descriptors_read, &descriptors_write, NULL, timeout);
-                
-
-        data_sources_modified = 0;
-        btstack_linked_list_iterator_init(&it, &data_sources);
-        while (btstack_linked_list_iterator_has_next(&it) && !data_sources_modified){
-            btstack_data_source_t *ds = (btstack_data_source_t*) btstack_linked_list_iterator_next(&it);
-            log_debug("btstack_run_loop_posix_execute: check ds %p with fd %u\n", ds, ds->source.fd);
-            if (FD_ISSET(ds->source.fd, &descriptors_read)) {
-                log_debug("btstack_run_loop_posix_execute: process read ds %p with fd %u\n", ds, ds->source.fd);
-                ds->process(ds, DATA_SOURCE_CALLBACK_READ);
-            }
-            if (data_sources_modified) break;
-            if (FD_ISSET(ds->source.fd, &descriptors_write)) {
-                log_debug("btstack_run_loop_posix_execute: process write ds %p with fd %u\n", ds, ds->source.fd);
-                ds->process(ds, DATA_SOURCE_CALLBACK_WRITE);
-            }
-        }
-        log_debug("btstack_run_loop_posix_execute: after ds check\n");
-        
-        // process timers
+    }
+    
+    // get next timeout
+    timeout = NULL;
+    if (timers) {
+        ts = (btstack_timer_source_t *) timers;
+        timeout = &tv;
+        uint32_t list_timeout  = ts->timeout;
         now_ms = btstack_run_loop_posix_get_time_ms();
-        while (timers) {
-            ts = (btstack_timer_source_t *) timers;
-            int32_t delta = btstack_time_delta(ts->timeout, now_ms);
-            if (delta > 0) break;
-            log_debug("btstack_run_loop_posix_execute: process timer %p\n", ts);
+        int32_t delta = btstack_time_delta(list_timeout, now_ms);
+        if (delta < 0){
+            delta = 0;
+        }
+        tv.tv_sec  = delta / 1000;
+        tv.tv_usec = (int) (delta - (tv.tv_sec * 1000)) * 1000;
+        log_debug("btstack_run_loop_execute next timeout in %u ms", delta);
+    }
+            
+    // wait for ready FDs
+    select( highest_fd+1 , &descriptors_read, &descriptors_write, NULL, timeout);
             
-            // remove timer before processing it to allow handler to re-register with run loop
-            btstack_run_loop_posix_remove_timer(ts);
-            ts->process(ts);
+
+    data_sources_modified = 0;
+    btstack_linked_list_iterator_init(&it, &data_sources);
+    while (btstack_linked_list_iterator_has_next(&it) && !data_sources_modified){
+        btstack_data_source_t *ds = (btstack_data_source_t*) btstack_linked_list_iterator_next(&it);
+        log_debug("btstack_run_loop_posix_execute: check ds %p with fd %u\n", ds, ds->source.fd);
+        if (FD_ISSET(ds->source.fd, &descriptors_read)) {
+            log_debug("btstack_run_loop_posix_execute: process read ds %p with fd %u\n", ds, ds->source.fd);
+            ds->process(ds, DATA_SOURCE_CALLBACK_READ);
+        }
+        if (data_sources_modified) break;
+        if (FD_ISSET(ds->source.fd, &descriptors_write)) {
+            log_debug("btstack_run_loop_posix_execute: process write ds %p with fd %u\n", ds, ds->source.fd);
+            ds->process(ds, DATA_SOURCE_CALLBACK_WRITE);
         }
     }
+    log_debug("btstack_run_loop_posix_execute: after ds check\n");
+    
+    // process timers
+    now_ms = btstack_run_loop_posix_get_time_ms();
+    while (timers) {
+        ts = (btstack_timer_source_t *) timers;
+        int32_t delta = btstack_time_delta(ts->timeout, now_ms);
+        if (delta > 0) break;
+        log_debug("btstack_run_loop_posix_execute: process timer %p\n", ts);
+        
+        // remove timer before processing it to allow handler to re-register with run loop
+        btstack_run_loop_posix_remove_timer(ts);
+        ts->process(ts);
+    }
+}
+
+/**
+ * Execute run_loop
+ */
+static void btstack_run_loop_posix_execute(void) {
+#ifdef _POSIX_MONOTONIC_CLOCK
+    log_info("POSIX run loop with monotonic clock");
+#else
+    log_info("POSIX run loop using ettimeofday fallback.");
+#endif
+
+    while (true) {
+        btstack_run_loop_posix_execute_once();
+    }
 }
 
 // set timer
@@ -299,6 +451,7 @@ static void btstack_run_loop_posix_set_timer(btstack_timer_source_t *a, uint32_t
 static void btstack_run_loop_posix_init(void){
     data_sources = NULL;
     timers = NULL;
+    btstack_run_loop_posix_trigger_init();
 #ifdef _POSIX_MONOTONIC_CLOCK
     clock_gettime(CLOCK_MONOTONIC, &init_ts);
     init_ts.tv_nsec = 0;
@@ -54,6 +54,26 @@ extern "C" {
  */
 const btstack_run_loop_t * btstack_run_loop_posix_get_instance(void);
 
+/**
+ * @brief Execute run_loop once. Blocks until a data source becomes ready or the next timer expires.
+ * Can be used to integrate BTstack's timer and data source processing into a foreign run loop.
+ */
+void btstack_run_loop_posix_execute_once(void);
+
+/**
+ * @brief Wake up run loop from another thread
+ */
+void btstack_run_loop_posix_trigger(void);
+
+/**
+ * @brief Execute code on BTstack run loop. Can be called from other threads.
+ * @note Calls are queued in a lock-free queue of size BTSTACK_RUN_LOOP_POSIX_QUEUE_LENGTH and executed in order
+ * @param fn
+ * @param arg
+ * @returns true if call was queued, false if queue is full
+ */
+bool btstack_run_loop_posix_execute_code_on_main_thread(void (*fn)(void *arg), void * arg);
+
 /* API_END */
 
 #if defined __cplusplus
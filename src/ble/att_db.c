@@ -158,8 +158,268 @@ static int att_iterator_match_uuid(att_iterator_t *it, uint8_t *uuid, uint16_t u
 }
 
 
+#ifdef ENABLE_ATT_DB_INDEX
+
+#ifndef ATT_DB_INDEX_MAX_HANDLES
+#define ATT_DB_INDEX_MAX_HANDLES 256
+#endif
+
+#define ATT_DB_INDEX_NO_POSITION 0xffffu
+
+// get 16-bit UUID of attribute, also for 128-bit Bluetooth Base UUIDs, or 0
+static uint16_t att_iterator_uuid16(att_iterator_t *it){
+    if ((it->flags & ATT_PROPERTY_UUID128) == 0u) return little_endian_read_16(it->uuid, 0);
+    if (!is_Bluetooth_Base_UUID(it->uuid)) return 0;
+    return little_endian_read_16(it->uuid, 12);
+}
+
+// offset + 1 of attribute for each handle, 0 if handle does not exist
+static uint16_t att_db_index_offsets[ATT_DB_INDEX_MAX_HANDLES + 1];
+// offsets of attributes with 16-bit UUID, sorted by UUID and handle
+static uint16_t att_db_index_uuid16[ATT_DB_INDEX_MAX_HANDLES];
+static uint16_t att_db_index_uuid16_count;
+// index is built on first use after att_set_db, end marker offset is used to detect attributes added by att_db_util
+static bool     att_db_index_valid;
+static uint16_t att_db_index_end_offset;
+static uint16_t att_db_index_last_handle;
+// all attributes are indexed and stored with ascending handles
+static bool att_db_index_complete;
+
+static void att_iterator_init_at_offset(att_iterator_t *it, uint16_t offset){
+    it->att_ptr = &att_db[offset];
+}
+
+static uint16_t att_db_index_uuid16_at_position(uint16_t pos, uint16_t * handle){
+    att_iterator_t it;
+    att_iterator_init_at_offset(&it, att_db_index_uuid16[pos]);
+    att_iterator_fetch_next(&it);
+    *handle = it.handle;
+    return att_iterator_uuid16(&it);
+}
+
+// first position in UUID index with (uuid16, handle) >= given pair
+static uint16_t att_db_index_lower_bound(uint16_t uuid16, uint16_t handle){
+    uint16_t low  = 0;
+    uint16_t high = att_db_index_uuid16_count;
+    while (low < high){
+        uint16_t mid = (low + high) / 2u;
+        uint16_t mid_handle;
+        uint16_t mid_uuid16 = att_db_index_uuid16_at_position(mid, &mid_handle);
+        if ((mid_uuid16 < uuid16) || ((mid_uuid16 == uuid16) && (mid_handle < handle))){
+            low = mid + 1u;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void att_db_index_add_uuid16(uint16_t offset, uint16_t uuid16){
+    // attributes are visited in handle order, insert after all entries with lower or same UUID
+    uint16_t pos = att_db_index_uuid16_count;
+    while (pos > 0u){
+        uint16_t handle;
+        if (att_db_index_uuid16_at_position(pos - 1u, &handle) <= uuid16) break;
+        att_db_index_uuid16[pos] = att_db_index_uuid16[pos - 1u];
+        pos--;
+    }
+    att_db_index_uuid16[pos] = offset;
+    att_db_index_uuid16_count++;
+}
+
+static void att_db_index_build(void){
+    att_db_index_valid = true;
+    att_db_index_uuid16_count = 0;
+    att_db_index_end_offset = 0;
+    att_db_index_last_handle = 0;
+    att_db_index_complete = true;
+    (void)memset(att_db_index_offsets, 0, sizeof(att_db_index_offsets));
+    if (att_db == NULL) return;
+
+    att_iterator_t it;
+    att_iterator_init(&it);
+    uint32_t offset = 0;
+    bool handles_exceeded = false;
+    while (true){
+        att_iterator_fetch_next(&it);
+        if (it.handle == 0u) break;
+        if ((offset + it.size) > 0xfffeu){
+            // offsets don't fit into index, use index for attributes so far
+            att_db_index_complete = false;
+            return;
+        }
+        if (it.handle > att_db_index_last_handle){
+            att_db_index_last_handle = it.handle;
+        } else {
+            att_db_index_complete = false;
+        }
+        if (it.handle > ATT_DB_INDEX_MAX_HANDLES){
+            att_db_index_complete = false;
+            handles_exceeded = true;
+        } else if (att_db_index_offsets[it.handle] == 0u){
+            att_db_index_offsets[it.handle] = (uint16_t) offset + 1u;
+        }
+        uint16_t uuid16 = att_iterator_uuid16(&it);
+        if ((uuid16 != 0u) && (att_db_index_uuid16_count < ATT_DB_INDEX_MAX_HANDLES)){
+            att_db_index_add_uuid16((uint16_t) offset, uuid16);
+        }
+        offset += it.size;
+    }
+    att_db_index_end_offset = (uint16_t) offset;
+    if (handles_exceeded){
+        log_error("att_db index: last handle 0x%04x > ATT_DB_INDEX_MAX_HANDLES %u, attributes above are found by search",
+                  att_db_index_last_handle, ATT_DB_INDEX_MAX_HANDLES);
+    }
+    log_info("att_db index: last handle 0x%04x, %u UUID16 entries, complete %u", att_db_index_last_handle,
+             att_db_index_uuid16_count, att_db_index_complete);
+}
+
+// (re)build index if db was set or attributes have been appended
+static void att_db_index_validate(void){
+    if (att_db_index_valid){
+        // incomplete index is only used as a hint, appended attributes are found by linear search
+        if (!att_db_index_complete) return;
+        if (att_db == NULL) return;
+        if (little_endian_read_16(att_db, att_db_index_end_offset) == 0u) return;
+    }
+    att_db_index_build();
+}
+
+// end of group that starts with service declaration at handle, 0 if group extends beyond end_handle
+static uint16_t att_db_index_group_end_handle(uint16_t handle, uint16_t end_handle){
+    uint16_t next_handle = 0xffffu;
+    uint16_t service_uuids[] = { GATT_PRIMARY_SERVICE_UUID, GATT_SECONDARY_SERVICE_UUID };
+    uint16_t i;
+    for (i = 0; i < 2u; i++){
+        uint16_t pos = att_db_index_lower_bound(service_uuids[i], handle + 1u);
+        if (pos >= att_db_index_uuid16_count) continue;
+        uint16_t service_handle;
+        if (att_db_index_uuid16_at_position(pos, &service_handle) != service_uuids[i]) continue;
+        next_handle = btstack_min(next_handle, service_handle);
+    }
+    if (next_handle == 0xffffu){
+        // last group ends with db
+        if (att_db_index_last_handle > end_handle) return 0;
+        return att_db_index_last_handle;
+    }
+    if (next_handle > end_handle) return 0;
+    // group ends with attribute before next service declaration
+    uint16_t group_end_handle = next_handle - 1u;
+    while (att_db_index_offsets[group_end_handle] == 0u){
+        group_end_handle--;
+    }
+    return group_end_handle;
+}
+#endif
+
+#ifdef ENABLE_ATT_DB_DISCOVERY_CACHE
+
+#ifndef ATT_DB_DISCOVERY_CACHE_SIZE
+#define ATT_DB_DISCOVERY_CACHE_SIZE 2048
+#endif
+
+// entry: entry len (2), mtu (2), request len (1), request, response
+#define ATT_DB_DISCOVERY_CACHE_ENTRY_HEADER_LEN 5u
+#define ATT_DB_DISCOVERY_CACHE_MAX_REQUEST_LEN 21u
+
+// responses for discovery requests stored back to back
+static uint8_t  att_db_discovery_cache[ATT_DB_DISCOVERY_CACHE_SIZE];
+static uint16_t att_db_discovery_cache_len;
+// clients mostly repeat the same request sequence, start search after last hit
+static uint16_t att_db_discovery_cache_next_pos;
+// offset of end marker when first response was cached to detect attributes added by att_db_util
+static uint16_t att_db_discovery_cache_end_offset;
+// cleared by request handlers if response depends on connection security or dynamic values
+static bool     att_db_discovery_cache_static;
+
+static void att_db_discovery_cache_reset(void){
+    att_db_discovery_cache_len = 0;
+    att_db_discovery_cache_next_pos = 0;
+}
+
+static bool att_db_discovery_cache_supported(uint8_t request_type){
+    switch (request_type){
+        case ATT_FIND_INFORMATION_REQUEST:
+        case ATT_READ_BY_TYPE_REQUEST:
+        case ATT_READ_BY_GROUP_TYPE_REQUEST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint16_t att_db_discovery_cache_get(uint16_t mtu, const uint8_t * request, uint16_t request_len, uint8_t * response){
+    if (att_db_discovery_cache_len == 0u) return 0;
+
+    // drop cache if attributes have been added
+    if (little_endian_read_16(att_db, att_db_discovery_cache_end_offset) != 0u){
+        log_info("att_db discovery cache: db changed");
+        att_db_discovery_cache_reset();
+        return 0;
+    }
+
+    uint16_t pos = att_db_discovery_cache_next_pos;
+    do {
+        uint16_t entry_len = little_endian_read_16(att_db_discovery_cache, pos);
+        uint16_t entry_pos = pos;
+        pos += entry_len;
+        if (pos >= att_db_discovery_cache_len){
+            pos = 0;
+        }
+        if ((little_endian_read_16(att_db_discovery_cache, entry_pos + 2u) == mtu)
+        &&  (att_db_discovery_cache[entry_pos + 4u] == request_len)
+        &&  (memcmp(&att_db_discovery_cache[entry_pos + ATT_DB_DISCOVERY_CACHE_ENTRY_HEADER_LEN], request, request_len) == 0)){
+            uint16_t response_len = entry_len - ATT_DB_DISCOVERY_CACHE_ENTRY_HEADER_LEN - request_len;
+            (void)memcpy(response, &att_db_discovery_cache[entry_pos + ATT_DB_DISCOVERY_CACHE_ENTRY_HEADER_LEN + request_len], response_len);
+            att_db_discovery_cache_next_pos = pos;
+            return response_len;
+        }
+    } while (pos != att_db_discovery_cache_next_pos);
+    return 0;
+}
+
+static void att_db_discovery_cache_store(uint16_t mtu, const uint8_t * request, uint16_t request_len, const uint8_t * response, uint16_t response_len){
+    if (att_db == NULL) return;
+    if (request_len > ATT_DB_DISCOVERY_CACHE_MAX_REQUEST_LEN) return;
+    uint16_t entry_len = ATT_DB_DISCOVERY_CACHE_ENTRY_HEADER_LEN + request_len + response_len;
+    if ((att_db_discovery_cache_len + entry_len) > ATT_DB_DISCOVERY_CACHE_SIZE) return;
+
+    if (att_db_discovery_cache_len == 0u){
+        att_iterator_t it;
+        att_iterator_init(&it);
+        uint16_t end_offset = 0;
+        while (true){
+            att_iterator_fetch_next(&it);
+            if (it.handle == 0u) break;
+            end_offset += it.size;
+        }
+        att_db_discovery_cache_end_offset = end_offset;
+    }
+
+    uint16_t pos = att_db_discovery_cache_len;
+    little_endian_store_16(att_db_discovery_cache, pos, entry_len);
+    little_endian_store_16(att_db_discovery_cache, pos + 2u, mtu);
+    att_db_discovery_cache[pos + 4u] = (uint8_t) request_len;
+    pos += ATT_DB_DISCOVERY_CACHE_ENTRY_HEADER_LEN;
+    (void)memcpy(&att_db_discovery_cache[pos], request, request_len);
+    pos += request_len;
+    (void)memcpy(&att_db_discovery_cache[pos], response, response_len);
+    att_db_discovery_cache_len += entry_len;
+    att_db_discovery_cache_next_pos = 0;
+}
+#endif
+
 static int att_find_handle(att_iterator_t *it, uint16_t handle){
     if (handle == 0u) return 0u;
+#ifdef ENABLE_ATT_DB_INDEX
+    att_db_index_validate();
+    if ((handle <= ATT_DB_INDEX_MAX_HANDLES) && (att_db_index_offsets[handle] != 0u)){
+        att_iterator_init_at_offset(it, att_db_index_offsets[handle] - 1u);
+        att_iterator_fetch_next(it);
+        return 1;
+    }
+    if (att_db_index_complete) return 0;
+#endif
     att_iterator_init(it);
     while (att_iterator_has_next(it)){
         att_iterator_fetch_next(it);
@@ -169,6 +429,103 @@ static int att_find_handle(att_iterator_t *it, uint16_t handle){
     return 0;
 }
 
+// init iterator at first attribute with handle >= start_handle if possible, otherwise at start of db
+static void att_iterator_init_from_handle(att_iterator_t *it, uint16_t start_handle){
+    att_iterator_init(it);
+#ifdef ENABLE_ATT_DB_INDEX
+    att_db_index_validate();
+    if (att_db == NULL) return;
+    if (!att_db_index_complete) return;
+    uint16_t handle;
+    for (handle = start_handle; (handle != 0u) && (handle <= att_db_index_last_handle); handle++){
+        if (att_db_index_offsets[handle] != 0u){
+            att_iterator_init_at_offset(it, att_db_index_offsets[handle] - 1u);
+            return;
+        }
+    }
+    att_iterator_init_at_offset(it, att_db_index_end_offset);
+#else
+    UNUSED(start_handle);
+#endif
+}
+
+// iterator over attributes with given type within handle range
+typedef struct {
+    att_iterator_t it;
+    uint16_t start_handle;
+    uint16_t end_handle;
+    uint16_t attribute_type_len;
+    uint8_t * attribute_type;
+#ifdef ENABLE_ATT_DB_INDEX
+    uint16_t uuid16;
+    uint16_t index_pos;
+#endif
+} att_type_iterator_t;
+
+static void att_type_iterator_init(att_type_iterator_t *type_it, uint16_t start_handle, uint16_t end_handle,
+                                   uint16_t attribute_type_len, uint8_t * attribute_type){
+    type_it->start_handle = start_handle;
+    type_it->end_handle = end_handle;
+    type_it->attribute_type_len = attribute_type_len;
+    type_it->attribute_type = attribute_type;
+#ifdef ENABLE_ATT_DB_INDEX
+    type_it->index_pos = ATT_DB_INDEX_NO_POSITION;
+    att_db_index_validate();
+    uint16_t uuid16 = uuid16_from_uuid(attribute_type_len, attribute_type);
+    if (att_db_index_complete && (uuid16 != 0u)){
+        type_it->uuid16 = uuid16;
+        type_it->index_pos = att_db_index_lower_bound(uuid16, start_handle);
+        return;
+    }
+#endif
+    att_iterator_init_from_handle(&type_it->it, start_handle);
+}
+
+// fetch next matching attribute into it
+static bool att_type_iterator_fetch_next(att_type_iterator_t *type_it, att_iterator_t *it){
+#ifdef ENABLE_ATT_DB_INDEX
+    if (type_it->index_pos != ATT_DB_INDEX_NO_POSITION){
+        if (type_it->index_pos >= att_db_index_uuid16_count) return false;
+        att_iterator_init_at_offset(it, att_db_index_uuid16[type_it->index_pos]);
+        att_iterator_fetch_next(it);
+        if (att_iterator_uuid16(it) != type_it->uuid16) return false;
+        if (it->handle > type_it->end_handle) return false;
+        type_it->index_pos++;
+        return true;
+    }
+#endif
+    while (att_iterator_has_next(&type_it->it)){
+        att_iterator_fetch_next(&type_it->it);
+        if ((type_it->it.handle == 0u) || (type_it->it.handle > type_it->end_handle)) return false;
+        if (type_it->it.handle < type_it->start_handle) continue;
+        if (!att_iterator_match_uuid(&type_it->it, type_it->attribute_type, type_it->attribute_type_len)) continue;
+        *it = type_it->it;
+        return true;
+    }
+    return false;
+}
+
+// end of group that starts with service declaration in it, 0 if group extends beyond end_handle
+static uint16_t att_group_end_handle(const att_iterator_t *group_it, uint16_t end_handle){
+#ifdef ENABLE_ATT_DB_INDEX
+    if (att_db_index_complete){
+        return att_db_index_group_end_handle(group_it->handle, end_handle);
+    }
+#endif
+    att_iterator_t it = *group_it;
+    uint16_t prev_handle = it.handle;
+    while (att_iterator_has_next(&it)){
+        att_iterator_fetch_next(&it);
+        if (it.handle > end_handle) return 0;
+        // group ends if new service definition starts or we reach end of att db
+        if ((it.handle == 0u) || att_iterator_match_uuid16(&it, GATT_PRIMARY_SERVICE_UUID) || att_iterator_match_uuid16(&it, GATT_SECONDARY_SERVICE_UUID)){
+            break;
+        }
+        prev_handle = it.handle;
+    }
+    return prev_handle;
+}
+
 // experimental client API
 uint16_t att_uuid_for_handle(uint16_t attribute_handle){
     att_iterator_t it;
@@ -208,6 +565,12 @@ void att_set_db(uint8_t const * db){
     }
     log_info("att_set_db %p", db);
     att_db = db;
+#ifdef ENABLE_ATT_DB_INDEX
+    att_db_index_valid = false;
+#endif
+#ifdef ENABLE_ATT_DB_DISCOVERY_CACHE
+    att_db_discovery_cache_reset();
+#endif
 }
 
 void att_set_read_callback(att_read_callback_t callback){
@@ -399,7 +762,7 @@ static uint16_t handle_find_information_request2(att_connection_t * att_connecti
     uint16_t uuid_len = 0;
     
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_from_handle(&it, start_handle);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         if (!it.handle) break;
@@ -492,7 +855,7 @@ static uint16_t handle_find_by_type_value_request(att_connection_t * att_connect
     uint16_t prev_handle = 0;
 
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_from_handle(&it, start_handle);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
 
@@ -552,21 +915,15 @@ static uint16_t handle_read_by_type_request2(att_connection_t * att_connection,
     uint16_t offset   = 1;
     uint16_t pair_len = 0;
 
+    att_type_iterator_t type_it;
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_type_iterator_init(&type_it, start_handle, end_handle, attribute_type_len, attribute_type);
     uint8_t error_code = 0;
     uint16_t first_matching_but_unreadable_handle = 0;
 
-    while (att_iterator_has_next(&it)){
-        att_iterator_fetch_next(&it);
-        
-        if ((it.handle == 0u ) || (it.handle > end_handle)) break;
+    // visit attributes with matching type
+    while (att_type_iterator_fetch_next(&type_it, &it)){
 
-        if (it.handle < start_handle) continue;
-
-        // does current attribute match
-        if (!att_iterator_match_uuid(&it, attribute_type, attribute_type_len)) continue;
-        
         // skip handles that cannot be read but remember that there has been at least one
         if ((it.flags & ATT_PROPERTY_READ) == 0u) {
             if (first_matching_but_unreadable_handle == 0u) {
@@ -575,6 +932,13 @@ static uint16_t handle_read_by_type_request2(att_connection_t * att_connection,
             continue;
         }
 
+#ifdef ENABLE_ATT_DB_DISCOVERY_CACHE
+        // response depends on connection security or read callback
+        if ((it.flags & (ATT_PROPERTY_DYNAMIC | ATT_PROPERTY_READ_PERMISSION_BIT_0 | ATT_PROPERTY_READ_PERMISSION_BIT_1 | ATT_PROPERTY_READ_PERMISSION_SC)) != 0u){
+            att_db_discovery_cache_static = false;
+        }
+#endif
+
         // check security requirements
         error_code = att_validate_security(att_connection, ATT_READ, &it);
         if (error_code != 0u) break;
@@ -870,71 +1234,46 @@ static uint16_t handle_read_by_group_type_request2(att_connection_t * att_connec
 
     uint16_t offset   = 1;
     uint16_t pair_len = 0;
-    uint16_t in_group = 0;
-    uint16_t group_start_handle = 0;
-    uint8_t const * group_start_value = NULL;
-    uint16_t prev_handle = 0;
 
+    att_type_iterator_t type_it;
     att_iterator_t it;
-    att_iterator_init(&it);
-    while (att_iterator_has_next(&it)){
-        att_iterator_fetch_next(&it);
-        
-        if (it.handle && (it.handle < start_handle)) continue;
-        if (it.handle > end_handle) break;  // (1)
+    att_type_iterator_init(&type_it, start_handle, end_handle, attribute_type_len, attribute_type);
 
-        // log_info("Handle 0x%04x", it.handle);
-        
-        // close current tag, if within a group and a new service definition starts or we reach end of att db
-        if (in_group &&
-            ((it.handle == 0u) || att_iterator_match_uuid16(&it, GATT_PRIMARY_SERVICE_UUID) || att_iterator_match_uuid16(&it, GATT_SECONDARY_SERVICE_UUID))){
-            // log_info("End of group, handle 0x%04x, val_len: %u", prev_handle, pair_len - 4);
-            
-            little_endian_store_16(response_buffer, offset, group_start_handle);
-            offset += 2u;
-            little_endian_store_16(response_buffer, offset, prev_handle);
-            offset += 2u;
-            (void)memcpy(response_buffer + offset, group_start_value,
-                         pair_len - 4u);
-            offset += pair_len - 4u;
-            in_group = 0;
-            
-            // check if space for another handle pair available
-            if ((offset + pair_len) > response_buffer_size){
-                break;
-            }
+    // visit service declarations with matching type
+    while (att_type_iterator_fetch_next(&type_it, &it)){
+
+        // check if value has same len as last one
+        uint16_t this_pair_len = 4u + it.value_len;
+        if ((offset > 1u) && (this_pair_len != pair_len)) {
+            break;
         }
-        
-        // keep track of previous handle
-        prev_handle = it.handle;
-        
-        // does current attribute match
-        // log_info("compare: %04x == %04x", *(uint16_t*) context->attribute_type, *(uint16_t*) uuid);
-        if (it.handle && att_iterator_match_uuid(&it, attribute_type, attribute_type_len)) {
-            
-            // check if value has same len as last one
-            uint16_t this_pair_len = 4u + it.value_len;
-            if (offset > 1u){
-                if (this_pair_len != pair_len) {
-                    break;
-                }
-            }
-            
-            // log_info("Begin of group, handle 0x%04x", it.handle);
-            
-            // first
-            if (offset == 1u) {
-                pair_len = this_pair_len;
-                response_buffer[offset] = this_pair_len;
-                offset++;
-            }
-            
-            group_start_handle = it.handle;
-            group_start_value  = it.value;
-            in_group = 1;
+
+        // group ends before next service declaration, skip if not complete within range
+        uint16_t group_end_handle = att_group_end_handle(&it, end_handle);
+        if (group_end_handle == 0u) {
+            break;
         }
-    }        
-    
+
+        // first
+        if (offset == 1u) {
+            pair_len = this_pair_len;
+            response_buffer[offset] = this_pair_len;
+            offset++;
+        }
+
+        little_endian_store_16(response_buffer, offset, it.handle);
+        offset += 2u;
+        little_endian_store_16(response_buffer, offset, group_end_handle);
+        offset += 2u;
+        (void)memcpy(response_buffer + offset, it.value, pair_len - 4u);
+        offset += pair_len - 4u;
+
+        // check if space for another handle pair available
+        if ((offset + pair_len) > response_buffer_size){
+            break;
+        }
+    }
+
     if (offset == 1u){
         return setup_error_atribute_not_found(response_buffer, request_type, start_handle);
     }
@@ -1169,7 +1508,16 @@ uint16_t att_handle_request(att_connection_t * att_connection,
                             uint8_t * response_buffer){
     uint16_t response_len = 0;
     uint16_t response_buffer_size = att_connection->mtu;
-    
+
+#ifdef ENABLE_ATT_DB_DISCOVERY_CACHE
+    bool use_discovery_cache = att_db_discovery_cache_supported(request_buffer[0]);
+    if (use_discovery_cache){
+        response_len = att_db_discovery_cache_get(response_buffer_size, request_buffer, request_len, response_buffer);
+        if (response_len > 0u) return response_len;
+        att_db_discovery_cache_static = true;
+    }
+#endif
+
     switch (request_buffer[0]){
         case ATT_EXCHANGE_MTU_REQUEST:
             response_len = handle_exchange_mtu_request(att_connection, request_buffer, request_len, response_buffer);
@@ -1217,6 +1565,16 @@ uint16_t att_handle_request(att_connection_t * att_connection,
             log_info_hexdump(&request_buffer[9u], request_len-9u);
             break;
     }
+
+#ifdef ENABLE_ATT_DB_DISCOVERY_CACHE
+    if (use_discovery_cache && att_db_discovery_cache_static && (response_len > 0u)
+#ifdef ENABLE_ATT_DELAYED_RESPONSE
+        && (response_len != ATT_READ_RESPONSE_PENDING)
+#endif
+    ){
+        att_db_discovery_cache_store(response_buffer_size, request_buffer, request_len, response_buffer, response_len);
+    }
+#endif
     return response_len;
 }
 
@@ -1304,6 +1662,22 @@ uint16_t gatt_server_get_server_configuration_handle_for_characteristic_with_uui
     return gatt_server_get_descriptor_handle_for_characteristic_with_uuid16(start_handle, end_handle, characteristic_uuid16, GATT_SERVER_CHARACTERISTICS_CONFIGURATION);
 }
 
+// returns 0 if not found
+uint16_t gatt_server_get_client_configuration_handle_for_value_handle(uint16_t value_handle){
+    att_iterator_t it;
+    if (!att_find_handle(&it, value_handle)) return 0;
+    // descriptors follow characteristic value until next characteristic or service declaration
+    while (att_iterator_has_next(&it)){
+        att_iterator_fetch_next(&it);
+        if (it.handle == 0u) break;
+        if (att_iterator_match_uuid16(&it, GATT_CHARACTERISTICS_UUID)) break;
+        if (att_iterator_match_uuid16(&it, GATT_PRIMARY_SERVICE_UUID)) break;
+        if (att_iterator_match_uuid16(&it, GATT_SECONDARY_SERVICE_UUID)) break;
+        if (att_iterator_match_uuid16(&it, GATT_CLIENT_CHARACTERISTICS_CONFIGURATION)) return it.handle;
+    }
+    return 0;
+}
+
 // returns 1 if service found. only primary service.
 int gatt_server_get_get_handle_range_for_service_with_uuid128(const uint8_t * uuid128, uint16_t * start_handle, uint16_t * end_handle){
     uint16_t in_group    = 0;
@@ -78,6 +78,8 @@ static void att_server_handle_can_send_now(void);
 static void att_server_persistent_ccc_restore(hci_connection_t * hci_connection);
 static void att_server_persistent_ccc_clear(hci_connection_t * hci_connection);
 static void att_server_handle_att_pdu(hci_connection_t * hci_connection, uint8_t * packet, uint16_t size);
+static bool att_server_notify_all_send(hci_connection_t * hci_connection);
+static void att_server_notify_all_connection_done(void);
 
 typedef enum {
     ATT_SERVER_RUN_PHASE_1_REQUESTS,
@@ -106,6 +108,16 @@ static att_write_callback_t                   att_server_client_write_callback;
 // round robin
 static hci_con_handle_t att_server_last_can_send_now = HCI_CON_HANDLE_INVALID;
 
+// notify all, attribute handle is 0 if not active
+static uint16_t        att_server_notify_all_attribute_handle;
+static uint8_t         att_server_notify_all_pdu_header[3];
+static const uint8_t * att_server_notify_all_value;
+static uint16_t        att_server_notify_all_value_len;
+static uint16_t        att_server_notify_all_num_pending;
+static uint16_t        att_server_notify_all_num_notified;
+static uint32_t        att_server_notify_all_num_bytes;
+static uint32_t        att_server_notify_all_start_ms;
+
 #ifdef ENABLE_LE_SIGNED_WRITE
 static hci_connection_t * hci_connection_for_state(att_server_state_t state){
     btstack_linked_list_iterator_t it;
@@ -386,6 +398,10 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                         att_server->value_indication_handle = 0; // reset error state
                         att_handle_value_indication_notify_client(ATT_HANDLE_VALUE_INDICATION_DISCONNECT, att_connection->con_handle, att_handle);
                     }
+                    if (att_server->notify_all_pending){
+                        att_server->notify_all_pending = false;
+                        att_server_notify_all_connection_done();
+                    }
                     // notify all - new
                     att_emit_disconnected_event(con_handle);
                     // notify all - old
@@ -681,7 +697,7 @@ static bool att_server_data_ready_for_phase(att_server_t * att_server,  att_serv
         case ATT_SERVER_RUN_PHASE_2_INDICATIONS:
              return (!btstack_linked_list_empty(&att_server->indication_requests) && (att_server->value_indication_handle == 0));
         case ATT_SERVER_RUN_PHASE_3_NOTIFICATIONS:
-            return (!btstack_linked_list_empty(&att_server->notification_requests));
+            return att_server->notify_all_pending || (!btstack_linked_list_empty(&att_server->notification_requests));
         default:
             btstack_assert(false);
             return false;
@@ -701,6 +717,15 @@ static void att_server_trigger_send_for_phase(hci_connection_t * hci_connection,
             client->callback(client->context);
             break;
        case ATT_SERVER_RUN_PHASE_3_NOTIFICATIONS:
+            if (att_server->notify_all_pending){
+                // retry would fail again as sending is possible, skip connection
+                if (att_server_notify_all_send(hci_connection) == false){
+                    log_error("notify all: send to handle 0x%04x failed", hci_connection->con_handle);
+                }
+                att_server->notify_all_pending = false;
+                att_server_notify_all_connection_done();
+                break;
+            }
             client = (btstack_context_callback_registration_t*) att_server->notification_requests;
             btstack_linked_list_remove(&att_server->notification_requests, (btstack_linked_item_t *) client);
             client->callback(client->context);
@@ -1220,6 +1245,102 @@ int att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, co
 	return l2cap_send_prepared_connectionless(att_connection->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, size);
 }
 
+static bool att_server_notifications_enabled(hci_connection_t * hci_connection, uint16_t ccc_handle){
+    uint8_t ccc_value[2];
+    uint16_t ccc_len = att_server_read_callback(hci_connection->con_handle, ccc_handle, 0, ccc_value, sizeof(ccc_value));
+    if (ccc_len != sizeof(ccc_value)) return false;
+    return (little_endian_read_16(ccc_value, 0) & GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION) != 0u;
+}
+
+// @returns true if notification was sent
+static bool att_server_notify_all_send(hci_connection_t * hci_connection){
+    att_connection_t * att_connection = &hci_connection->att_connection;
+
+    // copy serialized PDU, truncate value to ATT_MTU
+    uint16_t value_len = btstack_min(att_server_notify_all_value_len, att_connection->mtu - 3u);
+    l2cap_reserve_packet_buffer();
+    uint8_t * packet_buffer = l2cap_get_outgoing_buffer();
+    (void)memcpy(packet_buffer, att_server_notify_all_pdu_header, 3);
+    (void)memcpy(&packet_buffer[3], att_server_notify_all_value, value_len);
+    int status = l2cap_send_prepared_connectionless(att_connection->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, 3u + value_len);
+    if (status != ERROR_CODE_SUCCESS){
+        // buffer is still reserved if packet was not passed to HCI
+        if (hci_is_packet_buffer_reserved()){
+            l2cap_release_packet_buffer();
+        }
+        return false;
+    }
+
+    att_server_notify_all_num_notified++;
+    att_server_notify_all_num_bytes += value_len;
+    return true;
+}
+
+static void att_server_notify_all_emit_complete(void){
+    uint16_t attribute_handle = att_server_notify_all_attribute_handle;
+    att_server_notify_all_attribute_handle = 0;
+
+    btstack_packet_handler_t packet_handler = att_server_packet_handler_for_handle(attribute_handle);
+    if (!packet_handler) return;
+
+    uint8_t event[14];
+    int pos = 0;
+    event[pos++] = ATT_EVENT_NOTIFY_ALL_COMPLETE;
+    event[pos++] = sizeof(event) - 2u;
+    little_endian_store_16(event, pos, attribute_handle);
+    pos += 2;
+    little_endian_store_16(event, pos, att_server_notify_all_num_notified);
+    pos += 2;
+    little_endian_store_32(event, pos, att_server_notify_all_num_bytes);
+    pos += 4;
+    little_endian_store_32(event, pos, btstack_run_loop_get_time_ms() - att_server_notify_all_start_ms);
+    (*packet_handler)(HCI_EVENT_PACKET, 0, &event[0], sizeof(event));
+}
+
+// pending connection was notified or disconnected
+static void att_server_notify_all_connection_done(void){
+    btstack_assert(att_server_notify_all_num_pending > 0u);
+    att_server_notify_all_num_pending--;
+    if (att_server_notify_all_num_pending > 0u) return;
+    att_server_notify_all_emit_complete();
+}
+
+int att_server_notify_all(uint16_t attribute_handle, const uint8_t *value, uint16_t value_len){
+    if (att_server_notify_all_attribute_handle != 0u) return ERROR_CODE_COMMAND_DISALLOWED;
+
+    uint16_t ccc_handle = gatt_server_get_client_configuration_handle_for_value_handle(attribute_handle);
+    if (ccc_handle == 0u) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+
+    // serialize PDU header once
+    att_server_notify_all_pdu_header[0] = ATT_HANDLE_VALUE_NOTIFICATION;
+    little_endian_store_16(att_server_notify_all_pdu_header, 1, attribute_handle);
+    att_server_notify_all_attribute_handle = attribute_handle;
+    att_server_notify_all_value = value;
+    att_server_notify_all_value_len = value_len;
+    att_server_notify_all_num_notified = 0;
+    att_server_notify_all_num_bytes = 0;
+    att_server_notify_all_start_ms = btstack_run_loop_get_time_ms();
+
+    // send to connections that can send right now, mark others as pending.
+    // hold back completion until all connections have been visited
+    att_server_notify_all_num_pending = 1;
+    btstack_linked_list_iterator_t it;
+    hci_connections_get_iterator(&it);
+    while(btstack_linked_list_iterator_has_next(&it)){
+        hci_connection_t * hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+        // only LE connections, notifications over GATT Classic are not supported
+        if (hci_connection->address_type == BD_ADDR_TYPE_ACL) continue;
+        if (!att_server_notifications_enabled(hci_connection, ccc_handle)) continue;
+        if (att_server_can_send_packet(hci_connection) && att_server_notify_all_send(hci_connection)) continue;
+        // retry on can send now
+        hci_connection->att_server.notify_all_pending = true;
+        att_server_notify_all_num_pending++;
+        att_server_request_can_send_now(hci_connection);
+    }
+    att_server_notify_all_connection_done();
+    return ERROR_CODE_SUCCESS;
+}
+
 int att_server_indicate(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len){
     hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
     if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
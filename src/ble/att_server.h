@@ -114,6 +114,20 @@ int att_server_request_to_send_indication(btstack_context_callback_registration_
  */
 int att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len);
 
+/**
+ * @brief notify all connected clients that enabled notifications in the Client Characteristic Configuration
+ * @note the configuration is read for each connection via the read callback. Clients that cannot receive
+ *       right now are notified when possible, the value needs to stay valid until ATT_EVENT_NOTIFY_ALL_COMPLETE
+ *       has been emitted to the packet handler for the attribute handle. The event might be emitted during this call.
+ *       A client is skipped if sending fails again on retry, the event reports the number of notified clients
+ * @param attribute_handle of characteristic value
+ * @param value
+ * @param value_len, truncated to ATT_MTU - 3 for each connection
+ * @return ERROR_CODE_SUCCESS if ok, ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS if characteristic has no
+ *         Client Characteristic Configuration, or ERROR_CODE_COMMAND_DISALLOWED if previous call not complete
+ */
+int att_server_notify_all(uint16_t attribute_handle, const uint8_t *value, uint16_t value_len);
+
 /*
  * @brief indicate value change to client. client is supposed to reply with an indication_response
  * @param con_handle
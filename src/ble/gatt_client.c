@@ -50,6 +50,7 @@
 #include "ble/gatt_client.h"
 #include "ble/le_device_db.h"
 #include "ble/sm.h"
+#include "bluetooth_gatt.h"
 #include "btstack_debug.h"
 #include "btstack_event.h"
 #include "btstack_memory.h"
@@ -61,6 +62,27 @@
 #include "hci_dump.h"
 #include "l2cap.h"
 
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+#include "btstack_tlv.h"
+
+#ifndef GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES
+#define GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES 64
+#endif
+
+#ifndef GATT_CLIENT_DISCOVERY_CACHE_MAX_RESPONSE_LEN
+#define GATT_CLIENT_DISCOVERY_CACHE_MAX_RESPONSE_LEN 128
+#endif
+
+#if GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES > 255
+#error "GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES must not exceed 255"
+#endif
+
+// Find By Type Value Request with 128-bit UUID
+#define GATT_CLIENT_DISCOVERY_CACHE_MAX_REQUEST_LEN 23
+// entry: request len, request, response
+#define GATT_CLIENT_DISCOVERY_CACHE_ENTRY_SIZE (1 + GATT_CLIENT_DISCOVERY_CACHE_MAX_REQUEST_LEN + GATT_CLIENT_DISCOVERY_CACHE_MAX_RESPONSE_LEN)
+#endif
+
 static btstack_linked_list_t gatt_client_connections;
 static btstack_linked_list_t gatt_client_value_listeners;
 static btstack_packet_callback_registration_t hci_event_callback_registration;
@@ -73,6 +95,14 @@ static gap_security_level_t gatt_client_required_security_level;
 static void gatt_client_att_packet_handler(uint8_t packet_type, uint16_t handle, uint8_t *packet, uint16_t size);
 static void gatt_client_event_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 static void gatt_client_report_error_if_pending(gatt_client_t *gatt_client, uint8_t att_error_code);
+static void gatt_client_query_requests_emit_disconnected(btstack_linked_item_t * query_requests);
+
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+static uint8_t gatt_client_discovery_cache_lookup_buffer[GATT_CLIENT_DISCOVERY_CACHE_ENTRY_SIZE];
+static uint8_t gatt_client_discovery_cache_response_buffer[GATT_CLIENT_DISCOVERY_CACHE_ENTRY_SIZE];
+static btstack_timer_source_t gatt_client_discovery_cache_timer;
+static void gatt_client_discovery_cache_trigger_delivery(void);
+#endif
 
 #ifdef ENABLE_LE_SIGNED_WRITE
 static void att_signed_write_handle_cmac_result(uint8_t hash[8]);
@@ -95,6 +125,10 @@ void gatt_client_init(void){
 
     // and ATT Client PDUs
     att_dispatch_register_client(gatt_client_att_packet_handler);
+
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+    (void)btstack_run_loop_remove_timer(&gatt_client_discovery_cache_timer);
+#endif
 }
 
 void gatt_client_set_required_security_level(gap_security_level_t level){
@@ -232,6 +266,255 @@ static uint8_t att_confirmation(uint16_t con_handle){
     return l2cap_send_prepared_connectionless(con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, 1);
 }
 
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+
+// Discovery responses of bonded devices are stored in btstack_tlv and validated by the remote Database Hash.
+// Tag: 'GC', le device index, entry index. Entry index 0 contains the Database Hash, responses start at 1
+static uint32_t gatt_client_discovery_cache_tag(int le_device_index, uint8_t index){
+    return ((uint32_t) 'G' << 24u) | ((uint32_t) 'C' << 16u) | (((uint32_t) le_device_index & 0xffu) << 8u) | index;
+}
+
+static const btstack_tlv_t * gatt_client_discovery_cache_tlv(void ** tlv_context){
+    const btstack_tlv_t * tlv_impl = NULL;
+    btstack_tlv_get_instance(&tlv_impl, tlv_context);
+    return tlv_impl;
+}
+
+// only declarations are cached, reads of characteristic values by UUID are not
+static bool gatt_client_discovery_cache_request_supported(const uint8_t * request, uint16_t request_len){
+    if (request_len > GATT_CLIENT_DISCOVERY_CACHE_MAX_REQUEST_LEN) return false;
+    switch (request[0]){
+        case ATT_FIND_INFORMATION_REQUEST:
+        case ATT_FIND_BY_TYPE_VALUE_REQUEST:
+        case ATT_READ_BY_GROUP_TYPE_REQUEST:
+            return true;
+        case ATT_READ_BY_TYPE_REQUEST:
+            if (request_len != 7u) return false;
+            switch (little_endian_read_16(request, 5)){
+                case GATT_INCLUDE_SERVICE_UUID:
+                case GATT_CHARACTERISTICS_UUID:
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+static void gatt_client_discovery_cache_clear(const btstack_tlv_t * tlv_impl, void * tlv_context, int le_device_index){
+    uint16_t index;
+    for (index = 0; index <= GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES; index++){
+        tlv_impl->delete_tag(tlv_context, gatt_client_discovery_cache_tag(le_device_index, (uint8_t) index));
+    }
+}
+
+void gatt_client_discovery_cache_delete(int le_device_index){
+    void * tlv_context;
+    const btstack_tlv_t * tlv_impl = gatt_client_discovery_cache_tlv(&tlv_context);
+    if ((tlv_impl == NULL) || (le_device_index < 0)) return;
+    log_info("GATT Client Cache: delete for le device index %d", le_device_index);
+    gatt_client_discovery_cache_clear(tlv_impl, tlv_context, le_device_index);
+}
+
+// @returns entry index of cached response, or 0 if not found
+static uint8_t gatt_client_discovery_cache_lookup(gatt_client_t * gatt_client, const uint8_t * request, uint16_t request_len){
+    void * tlv_context;
+    const btstack_tlv_t * tlv_impl = gatt_client_discovery_cache_tlv(&tlv_context);
+    if (tlv_impl == NULL) return 0;
+    uint16_t index;
+    for (index = 1; index <= GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES; index++){
+        uint32_t tag = gatt_client_discovery_cache_tag(gatt_client->discovery_cache_le_device_index, (uint8_t) index);
+        int len = tlv_impl->get_tag(tlv_context, tag, gatt_client_discovery_cache_lookup_buffer, sizeof(gatt_client_discovery_cache_lookup_buffer));
+        // entries are stored without gaps
+        if (len <= 0) break;
+        if (gatt_client_discovery_cache_lookup_buffer[0] != request_len) continue;
+        if (memcmp(&gatt_client_discovery_cache_lookup_buffer[1], request, request_len) != 0) continue;
+        return (uint8_t) index;
+    }
+    return 0;
+}
+
+static void gatt_client_discovery_cache_store(gatt_client_t * gatt_client, const uint8_t * response, uint16_t response_len){
+    if (response_len > GATT_CLIENT_DISCOVERY_CACHE_MAX_RESPONSE_LEN) return;
+    void * tlv_context;
+    const btstack_tlv_t * tlv_impl = gatt_client_discovery_cache_tlv(&tlv_context);
+    if (tlv_impl == NULL) return;
+    // find first free entry
+    uint16_t index;
+    uint32_t tag = 0;
+    for (index = 1; index <= GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES; index++){
+        tag = gatt_client_discovery_cache_tag(gatt_client->discovery_cache_le_device_index, (uint8_t) index);
+        if (tlv_impl->get_tag(tlv_context, tag, gatt_client_discovery_cache_lookup_buffer, sizeof(gatt_client_discovery_cache_lookup_buffer)) <= 0) break;
+    }
+    if (index > GATT_CLIENT_DISCOVERY_CACHE_MAX_ENTRIES){
+        log_info("GATT Client Cache: full");
+        return;
+    }
+    uint16_t request_len = gatt_client->discovery_cache_request_len;
+    gatt_client_discovery_cache_lookup_buffer[0] = (uint8_t) request_len;
+    (void)memcpy(&gatt_client_discovery_cache_lookup_buffer[1], gatt_client->discovery_cache_request, request_len);
+    (void)memcpy(&gatt_client_discovery_cache_lookup_buffer[1u + request_len], response, response_len);
+    int result = tlv_impl->store_tag(tlv_context, tag, gatt_client_discovery_cache_lookup_buffer, 1u + request_len + response_len);
+    if (result != 0){
+        log_error("GATT Client Cache: store entry %u failed", index);
+    }
+}
+
+// compare Database Hash of remote with stored one, clear cache on mismatch
+static void gatt_client_discovery_cache_validate(gatt_client_t * gatt_client, const uint8_t * packet, uint16_t size){
+    void * tlv_context;
+    const btstack_tlv_t * tlv_impl = gatt_client_discovery_cache_tlv(&tlv_context);
+    // expect Read By Type Response with a single 16 byte value
+    if ((tlv_impl == NULL) || (packet[0] != ATT_READ_BY_TYPE_RESPONSE) || (size < 20u) || (packet[1] != 18u)){
+        log_info("GATT Client Cache: no Database Hash, disabled");
+        gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_DISABLED;
+        return;
+    }
+    gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_ACTIVE;
+    const uint8_t * database_hash = &packet[4];
+    uint8_t stored_hash[16];
+    uint32_t tag = gatt_client_discovery_cache_tag(gatt_client->discovery_cache_le_device_index, 0);
+    int len = tlv_impl->get_tag(tlv_context, tag, stored_hash, sizeof(stored_hash));
+    if ((len == (int) sizeof(stored_hash)) && (memcmp(stored_hash, database_hash, sizeof(stored_hash)) == 0)){
+        log_info("GATT Client Cache: Database Hash unchanged");
+        return;
+    }
+    log_info("GATT Client Cache: Database Hash changed, clear cache");
+    gatt_client_discovery_cache_clear(tlv_impl, tlv_context, gatt_client->discovery_cache_le_device_index);
+    int result = tlv_impl->store_tag(tlv_context, tag, database_hash, 16);
+    if (result != 0){
+        log_error("GATT Client Cache: store Database Hash failed");
+        gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_DISABLED;
+    }
+}
+
+// remember value handle of Service Changed characteristic from discovered characteristic declarations
+static void gatt_client_discovery_cache_find_service_changed(gatt_client_t * gatt_client, const uint8_t * packet, uint16_t size){
+    switch (gatt_client->gatt_client_state){
+        case P_W4_ALL_CHARACTERISTICS_OF_SERVICE_QUERY_RESULT:
+        case P_W4_CHARACTERISTIC_WITH_UUID_QUERY_RESULT:
+            break;
+        default:
+            return;
+    }
+    // handle, properties, value handle, 16-bit UUID
+    if ((packet[0] != ATT_READ_BY_TYPE_RESPONSE) || (size < 2u) || (packet[1] != 7u)) return;
+    uint16_t pos;
+    for (pos = 2u; (pos + 7u) <= size; pos += 7u){
+        if (little_endian_read_16(packet, pos + 5u) != ORG_BLUETOOTH_CHARACTERISTIC_GATT_SERVICE_CHANGED) continue;
+        gatt_client->discovery_cache_service_changed_handle = little_endian_read_16(packet, pos + 3u);
+    }
+}
+
+// Service Changed indication invalidates cache, Database Hash is read again before next request.
+// if Service Changed handle was not discovered in this connection, any indication with a handle range is used.
+// a cached response that is not delivered yet is gone, the pending query fails
+static void gatt_client_discovery_cache_handle_indication(gatt_client_t * gatt_client, const uint8_t * packet, uint16_t size){
+    if (size != 7u) return;
+    uint16_t value_handle = little_endian_read_16(packet, 1);
+    if ((gatt_client->discovery_cache_service_changed_handle != 0u) && (gatt_client->discovery_cache_service_changed_handle != value_handle)) return;
+    log_info("GATT Client Cache: Service Changed, clear cache");
+    gatt_client_discovery_cache_delete(gatt_client->discovery_cache_le_device_index);
+    gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_IDLE;
+    gatt_client->discovery_cache_request_len = 0;
+}
+
+// @returns true if packet was consumed
+static bool gatt_client_discovery_cache_handle_att_response(gatt_client_t * gatt_client, const uint8_t * packet, uint16_t size){
+    gatt_client_discovery_cache_find_service_changed(gatt_client, packet, size);
+    switch (gatt_client->discovery_cache_state){
+        case GATT_CLIENT_DISCOVERY_CACHE_W4_DATABASE_HASH:
+            if ((packet[0] == ATT_READ_BY_TYPE_RESPONSE) || (packet[0] == ATT_ERROR_RESPONSE)){
+                gatt_client_discovery_cache_validate(gatt_client, packet, size);
+                return true;
+            }
+            break;
+        case GATT_CLIENT_DISCOVERY_CACHE_ACTIVE:
+            // indications are not a response to the pending request
+            if (packet[0] == ATT_HANDLE_VALUE_INDICATION){
+                gatt_client_discovery_cache_handle_indication(gatt_client, packet, size);
+                break;
+            }
+            if (gatt_client->discovery_cache_request_len == 0u) break;
+            // record response or Attribute Not Found error that ends discovery
+            if (packet[0] == (gatt_client->discovery_cache_request[0] + 1u)){
+                gatt_client_discovery_cache_store(gatt_client, packet, size);
+            } else if ((packet[0] == ATT_ERROR_RESPONSE) && (size >= 5u) && (packet[1] == gatt_client->discovery_cache_request[0]) && (packet[4] == ATT_ERROR_ATTRIBUTE_NOT_FOUND)){
+                gatt_client_discovery_cache_store(gatt_client, packet, size);
+            }
+            // any other response or error also completes the pending request
+            gatt_client->discovery_cache_request_len = 0;
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+// cached responses are delivered from the run loop, events must not be emitted before the API call returns
+static void gatt_client_discovery_cache_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    void * tlv_context;
+    const btstack_tlv_t * tlv_impl = gatt_client_discovery_cache_tlv(&tlv_context);
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) gatt_client_connections; it != NULL; it = it->next){
+        gatt_client_t * gatt_client = (gatt_client_t *) it;
+        uint8_t index = gatt_client->discovery_cache_pending_index;
+        if (index == 0u) continue;
+        gatt_client->discovery_cache_pending_index = 0;
+        uint32_t tag = gatt_client_discovery_cache_tag(gatt_client->discovery_cache_le_device_index, index);
+        int len = (tlv_impl == NULL) ? 0 : tlv_impl->get_tag(tlv_context, tag, gatt_client_discovery_cache_response_buffer, sizeof(gatt_client_discovery_cache_response_buffer));
+        uint16_t offset = 1u + gatt_client_discovery_cache_response_buffer[0];
+        if (len > (int) offset){
+            gatt_client_att_packet_handler(ATT_DATA_PACKET, gatt_client->con_handle, &gatt_client_discovery_cache_response_buffer[offset], (uint16_t) len - offset);
+        } else {
+            log_error("GATT Client Cache: entry %u missing", index);
+            gatt_client_report_error_if_pending(gatt_client, ATT_ERROR_UNLIKELY_ERROR);
+        }
+        // one response per run loop iteration, list might have changed. next request triggers delivery again
+        break;
+    }
+    for (it = (btstack_linked_item_t *) gatt_client_connections; it != NULL; it = it->next){
+        if (((gatt_client_t *) it)->discovery_cache_pending_index != 0u){
+            gatt_client_discovery_cache_trigger_delivery();
+            break;
+        }
+    }
+}
+
+static void gatt_client_discovery_cache_trigger_delivery(void){
+    (void)btstack_run_loop_remove_timer(&gatt_client_discovery_cache_timer);
+    btstack_run_loop_set_timer_handler(&gatt_client_discovery_cache_timer, &gatt_client_discovery_cache_timer_handler);
+    btstack_run_loop_set_timer(&gatt_client_discovery_cache_timer, 0);
+    btstack_run_loop_add_timer(&gatt_client_discovery_cache_timer);
+}
+#endif
+
+// precondition: can_send_packet_now == TRUE, request in outgoing buffer
+static uint8_t gatt_client_send_discovery_request(hci_con_handle_t con_handle, uint16_t request_len){
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+    gatt_client_t * gatt_client = gatt_client_get_context_for_handle(con_handle);
+    uint8_t * request = l2cap_get_outgoing_buffer();
+    if (gatt_client != NULL){
+        // response to a request that cannot be cached must not be stored for a previous one
+        gatt_client->discovery_cache_request_len = 0;
+    }
+    if ((gatt_client != NULL) && (gatt_client->discovery_cache_state == GATT_CLIENT_DISCOVERY_CACHE_ACTIVE) && gatt_client_discovery_cache_request_supported(request, request_len)){
+        uint8_t index = gatt_client_discovery_cache_lookup(gatt_client, request, request_len);
+        if (index != 0u){
+            l2cap_release_packet_buffer();
+            gatt_client->discovery_cache_pending_index = index;
+            gatt_client_discovery_cache_trigger_delivery();
+            return ERROR_CODE_SUCCESS;
+        }
+        (void)memcpy(gatt_client->discovery_cache_request, request, request_len);
+        gatt_client->discovery_cache_request_len = (uint8_t) request_len;
+    }
+#endif
+    return l2cap_send_prepared_connectionless(con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, request_len);
+}
+
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_find_information_request(uint16_t request_type, uint16_t con_handle, uint16_t start_handle, uint16_t end_handle){
     l2cap_reserve_packet_buffer();
@@ -240,7 +523,7 @@ static uint8_t att_find_information_request(uint16_t request_type, uint16_t con_
     little_endian_store_16(request, 1, start_handle);
     little_endian_store_16(request, 3, end_handle);
     
-    return l2cap_send_prepared_connectionless(con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, 5);
+    return gatt_client_send_discovery_request(con_handle, 5);
 }
 
 // precondition: can_send_packet_now == TRUE
@@ -254,7 +537,7 @@ static uint8_t att_find_by_type_value_request(uint16_t request_type, uint16_t at
     little_endian_store_16(request, 5, attribute_group_type);
     (void)memcpy(&request[7], value, value_size);
     
-    return l2cap_send_prepared_connectionless(con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, 7u + value_size);
+    return gatt_client_send_discovery_request(con_handle, 7u + value_size);
 }
 
 // precondition: can_send_packet_now == TRUE
@@ -266,7 +549,7 @@ static uint8_t att_read_by_type_or_group_request_for_uuid16(uint16_t request_typ
     little_endian_store_16(request, 3, end_handle);
     little_endian_store_16(request, 5, uuid16);
     
-    return l2cap_send_prepared_connectionless(con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, 7);
+    return gatt_client_send_discovery_request(con_handle, 7);
 }
 
 // precondition: can_send_packet_now == TRUE
@@ -278,7 +561,7 @@ static uint8_t att_read_by_type_or_group_request_for_uuid128(uint16_t request_ty
     little_endian_store_16(request, 3, end_handle);
     reverse_128(uuid128, &request[5]);
     
-    return l2cap_send_prepared_connectionless(con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, 21);
+    return gatt_client_send_discovery_request(con_handle, 21);
 }
 
 // precondition: can_send_packet_now == TRUE
@@ -530,6 +813,15 @@ static void emit_event_to_registered_listeners(hci_con_handle_t con_handle, uint
     } 
 }
 
+// start queued queries as long as GATT Client is ready
+static void gatt_client_notify_can_send_query(gatt_client_t * gatt_client){
+    while (gatt_client->gatt_client_state == P_READY){
+        btstack_context_callback_registration_t * callback_registration = (btstack_context_callback_registration_t *) btstack_linked_list_pop(&gatt_client->query_requests);
+        if (callback_registration == NULL) break;
+        (*callback_registration->callback)(callback_registration->context);
+    }
+}
+
 static void emit_gatt_complete_event(gatt_client_t * gatt_client, uint8_t att_status){
     // @format H1
     uint8_t packet[5];
@@ -538,6 +830,7 @@ static void emit_gatt_complete_event(gatt_client_t * gatt_client, uint8_t att_st
     little_endian_store_16(packet, 2, gatt_client->con_handle);
     packet[4] = att_status;
     emit_event_new(gatt_client->callback, packet, sizeof(packet));
+    gatt_client_notify_can_send_query(gatt_client);
 }
 
 static void emit_gatt_service_query_result_event(gatt_client_t * gatt_client, uint16_t start_group_handle, uint16_t end_group_handle, uint8_t * uuid128){
@@ -882,6 +1175,53 @@ static int is_value_valid(gatt_client_t *gatt_client, uint8_t *packet, uint16_t
     return memcmp(&gatt_client->attribute_value[gatt_client->attribute_offset], &packet[5], size - 5u) == 0u;
 }
 
+static void gatt_client_stream_emit_complete(gatt_client_t * gatt_client, uint8_t status){
+    gatt_client->stream_active = false;
+    // @format H1244
+    uint8_t event[15];
+    event[0] = GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE;
+    event[1] = sizeof(event) - 2u;
+    little_endian_store_16(event, 2, gatt_client->con_handle);
+    event[4] = status;
+    little_endian_store_16(event, 5, gatt_client->stream_value_handle);
+    little_endian_store_32(event, 7, gatt_client->stream_bytes_sent);
+    little_endian_store_32(event, 11, btstack_run_loop_get_time_ms() - gatt_client->stream_start_ms);
+    emit_event_new(gatt_client->stream_callback, event, sizeof(event));
+}
+
+// queue Write Commands as long as L2CAP can send, returns true if a packet was sent
+static bool gatt_client_stream_run(gatt_client_t * gatt_client){
+    bool packet_sent = false;
+    while (gatt_client->stream_active && att_dispatch_client_can_send_now(gatt_client->con_handle)){
+        uint16_t max_chunk_len = gatt_client->mtu - 3u;
+        l2cap_reserve_packet_buffer();
+        uint8_t * request = l2cap_get_outgoing_buffer();
+        uint16_t chunk_len;
+        if (gatt_client->stream_pull_callback != NULL){
+            chunk_len = (*gatt_client->stream_pull_callback)(gatt_client->con_handle, &request[3], max_chunk_len);
+            btstack_assert(chunk_len <= max_chunk_len);
+        } else {
+            chunk_len = (uint16_t) btstack_min(gatt_client->stream_size - gatt_client->stream_bytes_sent, max_chunk_len);
+            (void)memcpy(&request[3], &gatt_client->stream_data[gatt_client->stream_bytes_sent], chunk_len);
+        }
+        if (chunk_len == 0u){
+            l2cap_release_packet_buffer();
+            gatt_client_stream_emit_complete(gatt_client, ERROR_CODE_SUCCESS);
+            break;
+        }
+        request[0] = ATT_WRITE_COMMAND;
+        little_endian_store_16(request, 1, gatt_client->stream_value_handle);
+        l2cap_send_prepared_connectionless(gatt_client->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, 3u + chunk_len);
+        gatt_client->stream_bytes_sent += chunk_len;
+        packet_sent = true;
+        // buffer complete
+        if ((gatt_client->stream_pull_callback == NULL) && (gatt_client->stream_bytes_sent == gatt_client->stream_size)){
+            gatt_client_stream_emit_complete(gatt_client, ERROR_CODE_SUCCESS);
+        }
+    }
+    return packet_sent;
+}
+
 // returns 1 if packet was sent
 static bool gatt_client_run_for_gatt_client(gatt_client_t * gatt_client){
 
@@ -932,6 +1272,27 @@ static bool gatt_client_run_for_gatt_client(gatt_client_t * gatt_client){
         return true;
     }
 
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+    // read remote Database Hash before first request of bonded device
+    if (client_request_pending){
+        switch (gatt_client->discovery_cache_state){
+            case GATT_CLIENT_DISCOVERY_CACHE_IDLE:
+                gatt_client->discovery_cache_le_device_index = sm_le_device_index(gatt_client->con_handle);
+                if (gatt_client->discovery_cache_le_device_index < 0){
+                    gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_DISABLED;
+                    break;
+                }
+                gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_W4_DATABASE_HASH;
+                att_read_by_type_or_group_request_for_uuid16(ATT_READ_BY_TYPE_REQUEST, GATT_DATABASE_HASH_UUID, gatt_client->con_handle, 0x0001, 0xffff);
+                return true;
+            case GATT_CLIENT_DISCOVERY_CACHE_W4_DATABASE_HASH:
+                return false;
+            default:
+                break;
+        }
+    }
+#endif
+
     // check MTU for writes
     switch (gatt_client->gatt_client_state){
         case P_W2_SEND_WRITE_CHARACTERISTIC_VALUE:
@@ -1124,6 +1485,11 @@ static bool gatt_client_run_for_gatt_client(gatt_client_t * gatt_client){
             break;
     }
 
+    // fill free ACL buffers with Write Commands of active stream
+    if (gatt_client->stream_active){
+        if (gatt_client_stream_run(gatt_client)) return true;
+    }
+
     // requested can send snow?
     if (gatt_client->write_without_response_callback){
         btstack_packet_handler_t packet_handler = gatt_client->write_without_response_callback;
@@ -1174,14 +1540,22 @@ static void gatt_client_event_packet_handler(uint8_t packet_type, uint16_t chann
 
     hci_con_handle_t con_handle;
     gatt_client_t * gatt_client;
+    btstack_linked_item_t * query_requests;
     switch (hci_event_packet_get_type(packet)) {
         case HCI_EVENT_DISCONNECTION_COMPLETE:
             log_info("GATT Client: HCI_EVENT_DISCONNECTION_COMPLETE");
             con_handle = little_endian_read_16(packet,3);
             gatt_client = gatt_client_get_context_for_handle(con_handle);
             if (gatt_client == NULL) break;
-            
+
+            // queued queries are not started anymore, ongoing query completes first
+            query_requests = gatt_client->query_requests;
+            gatt_client->query_requests = NULL;
             gatt_client_report_error_if_pending(gatt_client, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
+            gatt_client_query_requests_emit_disconnected(query_requests);
+            if (gatt_client->stream_active){
+                gatt_client_stream_emit_complete(gatt_client, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
+            }
             gatt_client_timeout_stop(gatt_client);
             btstack_linked_list_remove(&gatt_client_connections, (btstack_linked_item_t *) gatt_client);
             btstack_memory_gatt_client_free(gatt_client);
@@ -1190,8 +1564,21 @@ static void gatt_client_event_packet_handler(uint8_t packet_type, uint16_t chann
         // Pairing complete (with/without bonding=storing of pairing information)
         case SM_EVENT_PAIRING_COMPLETE:
             con_handle = sm_event_pairing_complete_get_handle(packet);
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+            // new bonding might reuse le device db entry of a removed one
+            if (sm_event_pairing_complete_get_status(packet) == ERROR_CODE_SUCCESS){
+                gatt_client_discovery_cache_delete(sm_le_device_index(con_handle));
+            }
+#endif
             gatt_client = gatt_client_get_context_for_handle(con_handle);
             if (gatt_client == NULL) break;
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+            // validate cache again for new bonding
+            if (gatt_client->discovery_cache_state == GATT_CLIENT_DISCOVERY_CACHE_ACTIVE){
+                gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_IDLE;
+                gatt_client->discovery_cache_request_len = 0;
+            }
+#endif
 
             // update security level
             gatt_client->security_level = gatt_client_le_security_level_for_connection(con_handle);
@@ -1257,6 +1644,11 @@ static void gatt_client_event_packet_handler(uint8_t packet_type, uint16_t chann
                         hci_remove_le_device_db_entry_from_resolving_list((uint16_t) le_device_db_index);
 #endif
                         le_device_db_remove(le_device_db_index);
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+                        gatt_client_discovery_cache_delete(le_device_db_index);
+                        gatt_client->discovery_cache_state = GATT_CLIENT_DISCOVERY_CACHE_IDLE;
+                        gatt_client->discovery_cache_request_len = 0;
+#endif
                         // trigger pairing again
                         sm_request_pairing(gatt_client->con_handle);
                         break;
@@ -1320,6 +1712,13 @@ static void gatt_client_att_packet_handler(uint8_t packet_type, uint16_t handle,
 
     if (gatt_client == NULL) return;
 
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+    if (gatt_client_discovery_cache_handle_att_response(gatt_client, packet, size)){
+        gatt_client_run();
+        return;
+    }
+#endif
+
     uint8_t error_code;
     switch (packet[0]){
         case ATT_EXCHANGE_MTU_RESPONSE:
@@ -2285,6 +2684,205 @@ uint8_t gatt_client_request_can_write_without_response_event(btstack_packet_hand
     return ERROR_CODE_SUCCESS;
 }
 
+uint8_t gatt_client_request_to_send_gatt_query(btstack_context_callback_registration_t * callback_registration, hci_con_handle_t con_handle){
+    gatt_client_t * gatt_client = gatt_client_provide_context_for_handle(con_handle);
+    if (gatt_client == NULL) return BTSTACK_MEMORY_ALLOC_FAILED;
+    bool added = btstack_linked_list_add_tail(&gatt_client->query_requests, (btstack_linked_item_t *) callback_registration);
+    if (!added) return ERROR_CODE_COMMAND_DISALLOWED;
+    gatt_client_notify_can_send_query(gatt_client);
+    return ERROR_CODE_SUCCESS;
+}
+
+static void gatt_client_read_requests_emit_complete(gatt_client_read_request_t * request, uint8_t att_status){
+    // @format H1
+    uint8_t packet[5];
+    packet[0] = GATT_EVENT_QUERY_COMPLETE;
+    packet[1] = 3;
+    little_endian_store_16(packet, 2, request->con_handle);
+    packet[4] = att_status;
+    emit_event_new(request->callback, packet, sizeof(packet));
+}
+
+// distribute Read Multiple result to combined read requests
+static void gatt_client_read_requests_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(packet_type);
+    UNUSED(channel);
+    UNUSED(size);
+    gatt_client_t * gatt_client = gatt_client_get_context_for_handle(little_endian_read_16(packet, 2));
+    if (gatt_client == NULL) return;
+    btstack_linked_list_iterator_t it;
+    switch (hci_event_packet_get_type(packet)){
+        case GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT: {
+            uint16_t value_length = gatt_event_characteristic_value_query_result_get_value_length(packet);
+            uint8_t * value = &packet[characteristic_value_event_header_size];
+            uint16_t expected_length = 0;
+            btstack_linked_list_iterator_init(&it, &gatt_client->read_requests);
+            while (btstack_linked_list_iterator_has_next(&it)){
+                gatt_client_read_request_t * request = (gatt_client_read_request_t *) btstack_linked_list_iterator_next(&it);
+                expected_length += request->value_length;
+            }
+            if (value_length != expected_length){
+                log_info("Read Multiple response len %u, expected %u -> read individually", value_length, expected_length);
+                gatt_client->read_multiple_disabled = true;
+                break;
+            }
+            // @note each event header overwrites the end of the previous, already reported value
+            uint16_t offset = 0;
+            btstack_linked_list_iterator_init(&it, &gatt_client->read_requests);
+            while (btstack_linked_list_iterator_has_next(&it)){
+                gatt_client_read_request_t * request = (gatt_client_read_request_t *) btstack_linked_list_iterator_next(&it);
+                uint8_t * event = setup_characteristic_value_packet(GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT, request->con_handle, request->value_handle, &value[offset], request->value_length);
+                if (event == NULL) break;
+                emit_event_new(request->callback, event, characteristic_value_event_header_size + request->value_length);
+                offset += request->value_length;
+            }
+            break;
+        }
+        case GATT_EVENT_QUERY_COMPLETE: {
+            uint8_t att_status = gatt_event_query_complete_get_att_status(packet);
+            btstack_linked_item_t * requests = gatt_client->read_requests;
+            gatt_client->read_requests = NULL;
+            if (requests == NULL) break;
+            // error for one handle fails the whole Read Multiple, read values individually unless connection is gone
+            bool read_individually = gatt_client->read_multiple_disabled;
+            switch (att_status){
+                case ATT_ERROR_SUCCESS:
+                case ATT_ERROR_HCI_DISCONNECT_RECEIVED:
+                case ATT_ERROR_TIMEOUT:
+                    break;
+                case ATT_ERROR_REQUEST_NOT_SUPPORTED:
+                    gatt_client->read_multiple_disabled = true;
+                    read_individually = true;
+                    break;
+                default:
+                    read_individually = true;
+                    break;
+            }
+            if (read_individually){
+                // queue reads again in front of other queries
+                uint8_t num_requests = 1;
+                btstack_linked_item_t * last = requests;
+                while (last->next != NULL){
+                    last = last->next;
+                    num_requests++;
+                }
+                last->next = gatt_client->query_requests;
+                gatt_client->query_requests = requests;
+                gatt_client->read_requests_individual = num_requests;
+                break;
+            }
+            while (requests != NULL){
+                gatt_client_read_request_t * request = (gatt_client_read_request_t *) requests;
+                requests = requests->next;
+                gatt_client_read_requests_emit_complete(request, att_status);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// combine following queued reads with known value length into Read Multiple
+static void gatt_client_read_request_start(void * context){
+    gatt_client_read_request_t * request = (gatt_client_read_request_t *) context;
+    gatt_client_t * gatt_client = gatt_client_get_context_for_handle(request->con_handle);
+    btstack_assert(gatt_client != NULL);
+    uint16_t num_handles = 0;
+    bool read_individually = gatt_client->read_multiple_disabled;
+    if (gatt_client->read_requests_individual > 0u){
+        gatt_client->read_requests_individual--;
+        read_individually = true;
+    }
+    if ((request->value_length > 0u) && !read_individually){
+        uint16_t values_length = request->value_length;
+        gatt_client->read_requests = NULL;
+        btstack_linked_list_add_tail(&gatt_client->read_requests, (btstack_linked_item_t *) request);
+        gatt_client->read_requests_handles[num_handles++] = request->value_handle;
+        while (num_handles < GATT_CLIENT_READ_MULTIPLE_MAX_HANDLES){
+            btstack_context_callback_registration_t * next = (btstack_context_callback_registration_t *) gatt_client->query_requests;
+            if (next == NULL) break;
+            if (next->callback != &gatt_client_read_request_start) break;
+            gatt_client_read_request_t * next_request = (gatt_client_read_request_t *) next->context;
+            if (next_request->value_length == 0u) break;
+            // request and response have to fit into ATT MTU
+            if ((3u + (2u * num_handles)) > gatt_client->mtu) break;
+            if ((1u + values_length + next_request->value_length) > gatt_client->mtu) break;
+            values_length += next_request->value_length;
+            btstack_linked_list_pop(&gatt_client->query_requests);
+            btstack_linked_list_add_tail(&gatt_client->read_requests, (btstack_linked_item_t *) next_request);
+            gatt_client->read_requests_handles[num_handles++] = next_request->value_handle;
+        }
+    }
+    uint8_t status;
+    if (num_handles > 1u){
+        status = gatt_client_read_multiple_characteristic_values(&gatt_client_read_requests_handler, request->con_handle, num_handles, gatt_client->read_requests_handles);
+    } else {
+        gatt_client->read_requests = NULL;
+        status = gatt_client_read_value_of_characteristic_using_value_handle(request->callback, request->con_handle, request->value_handle);
+    }
+    if (status == ERROR_CODE_SUCCESS) return;
+
+    // complete requests, gatt_client_notify_can_send_query continues with next queued query
+    log_error("Queued read failed, status 0x%02x", status);
+    if (num_handles > 1u){
+        btstack_linked_item_t * requests = gatt_client->read_requests;
+        gatt_client->read_requests = NULL;
+        while (requests != NULL){
+            gatt_client_read_request_t * failed_request = (gatt_client_read_request_t *) requests;
+            requests = requests->next;
+            gatt_client_read_requests_emit_complete(failed_request, ATT_ERROR_UNLIKELY_ERROR);
+        }
+    } else {
+        gatt_client_read_requests_emit_complete(request, ATT_ERROR_UNLIKELY_ERROR);
+    }
+}
+
+// complete queued reads on disconnect, other queued queries are dropped as their callback cannot be notified
+static void gatt_client_query_requests_emit_disconnected(btstack_linked_item_t * query_requests){
+    while (query_requests != NULL){
+        btstack_context_callback_registration_t * callback_registration = (btstack_context_callback_registration_t *) query_requests;
+        query_requests = query_requests->next;
+        if (callback_registration->callback != &gatt_client_read_request_start) continue;
+        gatt_client_read_requests_emit_complete((gatt_client_read_request_t *) callback_registration->context, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
+    }
+}
+
+uint8_t gatt_client_queue_read_value_of_characteristic(gatt_client_read_request_t * request, btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, uint16_t value_length){
+    request->registration.callback = &gatt_client_read_request_start;
+    request->registration.context = request;
+    request->callback = callback;
+    request->con_handle = con_handle;
+    request->value_handle = value_handle;
+    request->value_length = value_length;
+    return gatt_client_request_to_send_gatt_query(&request->registration, con_handle);
+}
+
+static uint8_t gatt_client_stream_start(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle,
+                                        const uint8_t * data, uint32_t data_len, gatt_client_stream_pull_t pull_callback){
+    gatt_client_t * context = gatt_client_provide_context_for_handle(con_handle);
+    if (context == NULL) return BTSTACK_MEMORY_ALLOC_FAILED;
+    if (context->stream_active) return GATT_CLIENT_IN_WRONG_STATE;
+    context->stream_active = true;
+    context->stream_callback = callback;
+    context->stream_pull_callback = pull_callback;
+    context->stream_data = data;
+    context->stream_size = data_len;
+    context->stream_bytes_sent = 0;
+    context->stream_value_handle = value_handle;
+    context->stream_start_ms = btstack_run_loop_get_time_ms();
+    gatt_client_run();
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gatt_client_write_without_response_stream(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, const uint8_t * data, uint32_t data_len){
+    return gatt_client_stream_start(callback, con_handle, value_handle, data, data_len, NULL);
+}
+
+uint8_t gatt_client_write_without_response_stream_with_callback(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, gatt_client_stream_pull_t pull_callback){
+    return gatt_client_stream_start(callback, con_handle, value_handle, NULL, 0, pull_callback);
+}
+
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 void gatt_client_att_packet_handler_fuzz(uint8_t packet_type, uint16_t handle, uint8_t *packet, uint16_t size){
     gatt_client_att_packet_handler(packet_type, handle, packet, size);
@@ -45,6 +45,11 @@
 extern "C" {
 #endif
 
+// max number of queued reads combined into a single Read Multiple Request
+#ifndef GATT_CLIENT_READ_MULTIPLE_MAX_HANDLES
+#define GATT_CLIENT_READ_MULTIPLE_MAX_HANDLES 8
+#endif
+
 typedef enum {
     P_READY,
     P_W2_SEND_SERVICE_QUERY,
@@ -129,6 +134,13 @@ typedef enum {
 } gatt_client_state_t;
     
     
+typedef enum {
+    GATT_CLIENT_DISCOVERY_CACHE_IDLE = 0,
+    GATT_CLIENT_DISCOVERY_CACHE_W4_DATABASE_HASH,
+    GATT_CLIENT_DISCOVERY_CACHE_ACTIVE,
+    GATT_CLIENT_DISCOVERY_CACHE_DISABLED,
+} gatt_client_discovery_cache_state_t;
+
 typedef enum{
     SEND_MTU_EXCHANGE,
     SENT_MTU_EXCHANGE,
@@ -136,6 +148,15 @@ typedef enum{
     MTU_AUTO_EXCHANGE_DISABLED
 } gatt_client_mtu_t;
 
+/**
+ * @brief Pull callback for gatt_client_write_without_response_stream_with_callback
+ * @param con_handle
+ * @param buffer to store next chunk of data
+ * @param buffer_size max number of bytes that fit into a single Write Command
+ * @return number of bytes stored in buffer, 0 ends the stream
+ */
+typedef uint16_t (*gatt_client_stream_pull_t)(hci_con_handle_t con_handle, uint8_t * buffer, uint16_t buffer_size);
+
 typedef struct gatt_client{
     btstack_linked_item_t    item;
     // TODO: rename gatt_client_state -> state
@@ -193,8 +214,49 @@ typedef struct gatt_client{
 
     gap_security_level_t security_level;
 
+    // write without response stream
+    bool                      stream_active;
+    btstack_packet_handler_t  stream_callback;
+    gatt_client_stream_pull_t stream_pull_callback;
+    const uint8_t *           stream_data;
+    uint32_t                  stream_size;
+    uint32_t                  stream_bytes_sent;
+    uint32_t                  stream_start_ms;
+    uint16_t                  stream_value_handle;
+
+    // queued queries
+    btstack_linked_list_t query_requests;
+
+    // queued reads combined into Read Multiple
+    btstack_linked_list_t read_requests;
+    uint16_t read_requests_handles[GATT_CLIENT_READ_MULTIPLE_MAX_HANDLES];
+    bool     read_multiple_disabled;
+    // number of requeued reads to read individually after a Read Multiple error
+    uint8_t  read_requests_individual;
+
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+    gatt_client_discovery_cache_state_t discovery_cache_state;
+    int      discovery_cache_le_device_index;
+    // entry index of cached response to deliver, 0 if none
+    uint8_t  discovery_cache_pending_index;
+    // outstanding discovery request to record response for
+    uint8_t  discovery_cache_request_len;
+    uint8_t  discovery_cache_request[23];
+    // value handle of Service Changed characteristic, 0 if not discovered
+    uint16_t discovery_cache_service_changed_handle;
+#endif
+
 } gatt_client_t;
 
+typedef struct {
+    // internal
+    btstack_context_callback_registration_t registration;
+    btstack_packet_handler_t callback;
+    hci_con_handle_t con_handle;
+    uint16_t value_handle;
+    uint16_t value_length;
+} gatt_client_read_request_t;
+
 typedef struct gatt_client_notification {
     btstack_linked_item_t    item;
     btstack_packet_handler_t callback;
@@ -723,6 +785,67 @@ void gatt_client_stop_listening_for_characteristic_value_updates(gatt_client_not
  */
 uint8_t gatt_client_request_can_write_without_response_event(btstack_packet_handler_t callback, hci_con_handle_t con_handle);
 
+/**
+ * @brief Request callback when GATT Client is ready to start a new query on this connection. Requests are served
+ *        in the order they were registered, directly after the current query has completed. The callback is
+ *        expected to start a GATT query. If the GATT Client is ready, the callback is called right away.
+ * @note  Pending requests are dropped on disconnect
+ * @param callback_registration
+ * @param con_handle
+ * @return status BTSTACK_MEMORY_ALLOC_FAILED, if no GATT client for con_handle is found
+ *                ERROR_CODE_COMMAND_DISALLOWED, if callback registration is already queued
+ *                ERROR_CODE_SUCCESS          , if request was queued or callback was called
+ */
+uint8_t gatt_client_request_to_send_gatt_query(btstack_context_callback_registration_t * callback_registration, hci_con_handle_t con_handle);
+
+/**
+ * @brief Queue read of characteristic value. The result is reported as GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT
+ *        followed by GATT_EVENT_QUERY_COMPLETE, like for gatt_client_read_value_of_characteristic_using_value_handle.
+ *        Consecutive queued reads with known value length are combined into a single Read Multiple Request, as
+ *        long as the values fit into the ATT MTU. If the GATT Server does not support Read Multiple or returns
+ *        a response of unexpected size, the reads are repeated individually. On disconnect, queued reads
+ *        complete with ATT_ERROR_HCI_DISCONNECT_RECEIVED.
+ * @param  request      storage for the queued read, must stay valid until GATT_EVENT_QUERY_COMPLETE
+ * @param  callback
+ * @param  con_handle
+ * @param  value_handle
+ * @param  value_length of fixed-size characteristic value, 0 if unknown
+ * @return status see gatt_client_request_to_send_gatt_query
+ */
+uint8_t gatt_client_queue_read_value_of_characteristic(gatt_client_read_request_t * request, btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, uint16_t value_length);
+
+/**
+ * @brief Streams a large buffer to a characteristic value as a sequence of Write Without Response commands.
+ *        The data is split into chunks of ATT MTU - 3 bytes. Whenever L2CAP can send, as many Write Commands
+ *        as there are free LE ACL buffers are queued, so the controller does not run dry.
+ *        GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE reports status, number of bytes and duration
+ *        once the last chunk has been passed to the controller or the connection is lost.
+ * @note  Streaming does not use the request/response state machine and can be combined with regular GATT queries
+ * @param  callback for GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE
+ * @param  con_handle
+ * @param  value_handle
+ * @param  data is not copied, make sure memory is accessible until stream is complete
+ * @param  data_len
+ * @return status BTSTACK_MEMORY_ALLOC_FAILED, if no GATT client for con_handle is found
+ *                GATT_CLIENT_IN_WRONG_STATE , if a stream is already active on this connection
+ *                ERROR_CODE_SUCCESS         , if stream was started
+ */
+uint8_t gatt_client_write_without_response_stream(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, const uint8_t * data, uint32_t data_len);
+
+/**
+ * @brief Streams data to a characteristic value as a sequence of Write Without Response commands, with data
+ *        provided by a pull callback. The callback fills the outgoing packet buffer directly and ends the stream
+ *        by returning 0. See gatt_client_write_without_response_stream for details.
+ * @param  callback for GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE
+ * @param  con_handle
+ * @param  value_handle
+ * @param  pull_callback
+ * @return status BTSTACK_MEMORY_ALLOC_FAILED, if no GATT client for con_handle is found
+ *                GATT_CLIENT_IN_WRONG_STATE , if a stream is already active on this connection
+ *                ERROR_CODE_SUCCESS         , if stream was started
+ */
+uint8_t gatt_client_write_without_response_stream_with_callback(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, gatt_client_stream_pull_t pull_callback);
+
 /**
  * @brief Transactional write. It can be called as many times as it is needed to write the characteristics within the same transaction. Call gatt_client_execute_write to commit the transaction.
  * @param  callback   
@@ -748,6 +871,14 @@ uint8_t gatt_client_execute_write(btstack_packet_handler_t callback, hci_con_han
  */
 uint8_t gatt_client_cancel_write(btstack_packet_handler_t callback, hci_con_handle_t con_handle);
 
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+/**
+ * @brief Delete cached discovery responses for LE Device DB entry, called by gap_delete_bonding
+ * @param  le_device_index
+ */
+void gatt_client_discovery_cache_delete(int le_device_index);
+#endif
+
 /* API_END */
 
 // used by generated btstack_event.c
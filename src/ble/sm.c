@@ -42,6 +42,9 @@
 
 #include "ble/le_device_db.h"
 #include "ble/core.h"
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+#include "ble/gatt_client.h"
+#endif
 #include "ble/sm.h"
 #include "bluetooth_company_id.h"
 #include "btstack_bool.h"
@@ -90,6 +93,21 @@
 
 #define BTSTACK_TAG32(A,B,C,D) (((A) << 24) | ((B) << 16) | ((C) << 8) | (D))
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+#ifndef SM_ADDRESS_RESOLUTION_CACHE_SIZE
+#define SM_ADDRESS_RESOLUTION_CACHE_SIZE 16
+#endif
+#ifndef SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS
+// Core 5.2, Vol 3, Part C, Appendix A - recommended TGAP(private_addr_int) is 15 minutes
+#define SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS (15u * 60u * 1000u)
+#endif
+#endif
+
+// a software AES implementation allows to check all IRKs in a single pass without the crypto queue
+#if defined(ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION) && !defined(ENABLE_SOFTWARE_AES128) && !defined(HAVE_AES128)
+#error "ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION requires a software AES128. Please add ENABLE_SOFTWARE_AES128 or HAVE_AES128 to btstack_config.h"
+#endif
+
 //
 // SM internal types and globals
 //
@@ -258,6 +276,18 @@ static void *    sm_address_resolution_context;
 static address_resolution_mode_t sm_address_resolution_mode;
 static btstack_linked_list_t sm_address_resolution_general_queue;
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+// resolved private addresses, most recently used first
+typedef struct {
+    bd_addr_t address;
+    sm_key_t  irk;
+    uint32_t  resolved_ms;
+    int       le_device_index;
+} sm_address_resolution_cache_entry_t;
+static sm_address_resolution_cache_entry_t sm_address_resolution_cache[SM_ADDRESS_RESOLUTION_CACHE_SIZE];
+static uint16_t sm_address_resolution_cache_count;
+#endif
+
 // aes128 crypto engine.
 static sm_aes128_state_t  sm_aes128_state;
 
@@ -270,7 +300,9 @@ static btstack_crypto_ecc_p256_t sm_crypto_ecc_p256_request;
 
 // temp storage for random data
 static uint8_t sm_random_data[8];
+#ifndef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
 static uint8_t sm_aes128_key[16];
+#endif
 static uint8_t sm_aes128_plaintext[16];
 static uint8_t sm_aes128_ciphertext[16];
 
@@ -391,7 +423,9 @@ static void sm_done_for_handle(hci_con_handle_t con_handle);
 static sm_connection_t * sm_get_connection_for_handle(hci_con_handle_t con_handle);
 static inline int sm_calc_actual_encryption_key_size(int other);
 static int sm_validate_stk_generation_method(void);
+#ifndef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
 static void sm_handle_encryption_result_address_resolution(void *arg);
+#endif
 static void sm_handle_encryption_result_dkg_dhk(void *arg);
 static void sm_handle_encryption_result_dkg_irk(void *arg);
 static void sm_handle_encryption_result_enc_a(void *arg);
@@ -937,6 +971,67 @@ static void sm_address_resolution_start_lookup(uint8_t addr_type, hci_con_handle
     sm_notify_client_base(SM_EVENT_IDENTITY_RESOLVING_STARTED, con_handle, addr_type, addr);
 }
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+static bool sm_address_is_resolvable_private(uint8_t addr_type, const bd_addr_t addr){
+    return (addr_type == BD_ADDR_TYPE_LE_RANDOM) && ((addr[0] & 0xc0u) == 0x40u);
+}
+
+static void sm_address_resolution_cache_remove(uint16_t pos){
+    sm_address_resolution_cache_count--;
+    (void)memmove(&sm_address_resolution_cache[pos], &sm_address_resolution_cache[pos+1],
+                  (sm_address_resolution_cache_count - pos) * sizeof(sm_address_resolution_cache_entry_t));
+}
+
+static void sm_address_resolution_cache_add(const bd_addr_t addr, int le_device_index){
+    sm_address_resolution_cache_entry_t entry;
+    (void)memcpy(entry.address, addr, 6);
+    le_device_db_info(le_device_index, NULL, NULL, entry.irk);
+    entry.le_device_index = le_device_index;
+    entry.resolved_ms = btstack_run_loop_get_time_ms();
+    // drop least recently used entry if full
+    if (sm_address_resolution_cache_count == SM_ADDRESS_RESOLUTION_CACHE_SIZE){
+        sm_address_resolution_cache_count--;
+    }
+    (void)memmove(&sm_address_resolution_cache[1], &sm_address_resolution_cache[0],
+                  sm_address_resolution_cache_count * sizeof(sm_address_resolution_cache_entry_t));
+    sm_address_resolution_cache[0] = entry;
+    sm_address_resolution_cache_count++;
+}
+
+// @return le_device_index or -1 if not cached
+static int sm_address_resolution_cache_lookup(const bd_addr_t addr){
+    uint32_t now = btstack_run_loop_get_time_ms();
+    uint16_t pos = 0;
+    while (pos < sm_address_resolution_cache_count){
+        sm_address_resolution_cache_entry_t * entry = &sm_address_resolution_cache[pos];
+        // peer rotates its address at least every TGAP(private_addr_int), expire entries instead of refreshing them on use
+        if ((now - entry->resolved_ms) >= SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS){
+            sm_address_resolution_cache_remove(pos);
+            continue;
+        }
+        if (memcmp(entry->address, addr, 6) != 0){
+            pos++;
+            continue;
+        }
+        // validate that the bond still exists and has not been replaced
+        int addr_type = BD_ADDR_TYPE_UNKNOWN;
+        sm_key_t irk;
+        le_device_db_info(entry->le_device_index, &addr_type, NULL, irk);
+        if ((addr_type == BD_ADDR_TYPE_UNKNOWN) || (memcmp(irk, entry->irk, 16) != 0)){
+            sm_address_resolution_cache_remove(pos);
+            return -1;
+        }
+        // move to front
+        sm_address_resolution_cache_entry_t hit = *entry;
+        (void)memmove(&sm_address_resolution_cache[1], &sm_address_resolution_cache[0],
+                      pos * sizeof(sm_address_resolution_cache_entry_t));
+        sm_address_resolution_cache[0] = hit;
+        return hit.le_device_index;
+    }
+    return -1;
+}
+#endif
+
 int sm_address_resolution_lookup(uint8_t address_type, bd_addr_t address){
     // check if already in list
     btstack_linked_list_iterator_t it;
@@ -1256,6 +1351,15 @@ static void sm_address_resolution_handle_event(address_resolution_event_t event)
     address_resolution_mode_t mode = sm_address_resolution_mode;
     void * context = sm_address_resolution_context;
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    if ((event == ADDRESS_RESOLUTION_SUCCEEDED) && sm_address_is_resolvable_private(sm_address_resolution_addr_type, sm_address_resolution_address)){
+        // lookup also succeeds on cache hit, don't add twice
+        if (sm_address_resolution_cache_lookup(sm_address_resolution_address) < 0){
+            sm_address_resolution_cache_add(sm_address_resolution_address, matched_device_id);
+        }
+    }
+#endif
+
     // reset context
     sm_address_resolution_mode = ADDRESS_RESOLUTION_IDLE;
     sm_address_resolution_context = NULL;
@@ -2114,6 +2218,23 @@ static bool sm_run_csrk(void){
 
     // -- Continue with CSRK device lookup by public or resolvable private address
     if (!sm_address_resolution_idle()){
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+        if ((sm_address_resolution_test == 0) && sm_address_is_resolvable_private(sm_address_resolution_addr_type, sm_address_resolution_address)){
+            int le_device_index = sm_address_resolution_cache_lookup(sm_address_resolution_address);
+            if (le_device_index >= 0){
+                log_info("LE Device Lookup: found resolvable private address in cache, index %d", le_device_index);
+                sm_address_resolution_test = le_device_index;
+                sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCCEEDED);
+                return false;
+            }
+        }
+#endif
+#ifdef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
+        // r' = padding || prand is the same for all IRKs
+        uint8_t ah_r_prime[16];
+        uint8_t ah_hash[16];
+        sm_ah_r_prime(sm_address_resolution_address, ah_r_prime);
+#endif
         log_info("LE Device Lookup: device %u/%u", sm_address_resolution_test, le_device_db_max_count());
         while (sm_address_resolution_test < le_device_db_max_count()){
             int addr_type = BD_ADDR_TYPE_UNKNOWN;
@@ -2140,6 +2261,15 @@ static bool sm_run_csrk(void){
                 continue;
             }
 
+#ifdef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
+            btstack_aes128_calc(irk, ah_r_prime, ah_hash);
+            if (memcmp(&sm_address_resolution_address[3], &ah_hash[13], 3) == 0){
+                log_info("LE Device Lookup: matched resolvable private address");
+                sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCCEEDED);
+                break;
+            }
+            sm_address_resolution_test++;
+#else
             if (sm_aes128_state == SM_AES128_ACTIVE) break;
 
             log_info("LE Device Lookup: calculate AH");
@@ -2151,6 +2281,7 @@ static bool sm_run_csrk(void){
             sm_aes128_state = SM_AES128_ACTIVE;
             btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_aes128_key, sm_aes128_plaintext, sm_aes128_ciphertext, sm_handle_encryption_result_address_resolution, NULL);
             return true;
+#endif
         }
 
         if (sm_address_resolution_test >= le_device_db_max_count()){
@@ -3202,6 +3333,7 @@ static void sm_handle_encryption_result_enc_ph4_ltk(void *arg){
 }
 #endif
 
+#ifndef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
 static void sm_handle_encryption_result_address_resolution(void *arg){
     UNUSED(arg);
     sm_aes128_state = SM_AES128_IDLE;
@@ -3219,6 +3351,7 @@ static void sm_handle_encryption_result_address_resolution(void *arg){
     sm_address_resolution_test++;
     sm_trigger_run();
 }
+#endif
 
 static void sm_handle_encryption_result_dkg_irk(void *arg){
     UNUSED(arg);
@@ -4389,6 +4522,9 @@ void sm_init(void){
     sm_address_resolution_ah_calculation_active = 0;
     sm_address_resolution_mode = ADDRESS_RESOLUTION_IDLE;
     sm_address_resolution_general_queue = NULL;
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    sm_address_resolution_cache_count = 0;
+#endif
 
     gap_random_adress_update_period = 15 * 60 * 1000L;
     sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
@@ -4821,6 +4957,9 @@ void gap_delete_bonding(bd_addr_type_t address_type, bd_addr_t address){
             hci_remove_le_device_db_entry_from_resolving_list(i);
 #endif
             le_device_db_remove(i);
+#ifdef ENABLE_GATT_CLIENT_DISCOVERY_CACHE
+            gatt_client_discovery_cache_delete(i);
+#endif
             break;
         }
     }
@@ -245,6 +245,7 @@ typedef enum {
 #define RFCOMM_NO_OUTGOING_CREDITS                         0x72
 #define RFCOMM_AGGREGATE_FLOW_OFF                          0x73
 #define RFCOMM_DATA_LEN_EXCEEDS_MTU                        0x74
+#define RFCOMM_STREAM_CHANNEL_CLOSED                       0x75
 
 #define HFP_REMOTE_REJECTS_AUDIO_CONNECTION                0x7F
 
@@ -662,6 +663,7 @@ typedef enum {
 #define GAP_RECONNECTION_ADDRESS_UUID  0x2a03
 #define GAP_PERIPHERAL_PREFERRED_CONNECTION_PARAMETERS_UUID 0x2a04
 #define GAP_SERVICE_CHANGED            0x2a05
+#define GATT_DATABASE_HASH_UUID        0x2b2a
 
 // Bluetooth GATT types
 
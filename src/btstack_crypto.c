@@ -43,6 +43,7 @@
 #include "btstack_debug.h"
 #include "btstack_event.h"
 #include "btstack_linked_list.h"
+#include "btstack_run_loop.h"
 #include "btstack_util.h"
 #include "btstack_bool.h"
 #include "hci.h"
@@ -60,8 +61,14 @@
 
 #ifdef ENABLE_SOFTWARE_AES128
 #define HAVE_AES128
+// use AES-NI instructions if enabled by compiler (e.g. -maes), table-based rijndael implementation otherwise
+#if defined(__AES__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_AES_NI
+#include <wmmintrin.h>
+#else
 #include "rijndael.h"
 #endif
+#endif
 
 #ifdef HAVE_AES128
 #define USE_BTSTACK_AES128
@@ -131,6 +138,17 @@ static const uint8_t zero[16] = { 0 };
 static bool btstack_crypto_initialized;
 static bool btstack_crypto_wait_for_hci_result;
 static btstack_linked_list_t btstack_crypto_operations;
+
+#ifdef ENABLE_ECC_P256
+// ECC operations take long, they are queued separately and processed when random/AES operations are idle or wait for the Controller
+static bool btstack_crypto_ecc_wait_for_hci_result;
+static bool btstack_crypto_ecc_wait_for_random;
+static btstack_linked_list_t btstack_crypto_ecc_operations;
+#endif
+
+#ifdef ENABLE_BTSTACK_CRYPTO_STATISTICS
+static btstack_crypto_statistics_t btstack_crypto_statistics[BTSTACK_CRYPTO_CCM_DECRYPT_BLOCK + 1];
+#endif
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 
 // state for AES-CMAC
@@ -166,19 +184,108 @@ static mbedtls_ecp_group   mbedtls_ec_group;
 #endif /* ENABLE_ECC_P256 */
 
 #ifdef ENABLE_SOFTWARE_AES128
+
+// expanded key of last AES128 operation, as CMAC and CCM use the same key for all blocks of a message
+static sm_key_t btstack_crypto_aes128_key;
+static bool     btstack_crypto_aes128_key_valid;
+
+#ifdef USE_AES_NI
+
+static __m128i btstack_crypto_aes128_round_keys[11];
+
+static __m128i btstack_crypto_aes128_expand_round_key(__m128i key, __m128i key_assist){
+    key_assist = _mm_shuffle_epi32(key_assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, key_assist);
+}
+
+// round constant has to be an immediate
+#define AES_NI_EXPAND(ROUND, RCON) \
+    btstack_crypto_aes128_round_keys[ROUND] = btstack_crypto_aes128_expand_round_key(btstack_crypto_aes128_round_keys[(ROUND)-1], \
+        _mm_aeskeygenassist_si128(btstack_crypto_aes128_round_keys[(ROUND)-1], RCON))
+
+static void btstack_crypto_aes128_setup_key(const uint8_t * key){
+    btstack_crypto_aes128_round_keys[0] = _mm_loadu_si128((const __m128i *) key);
+    AES_NI_EXPAND(1, 0x01);
+    AES_NI_EXPAND(2, 0x02);
+    AES_NI_EXPAND(3, 0x04);
+    AES_NI_EXPAND(4, 0x08);
+    AES_NI_EXPAND(5, 0x10);
+    AES_NI_EXPAND(6, 0x20);
+    AES_NI_EXPAND(7, 0x40);
+    AES_NI_EXPAND(8, 0x80);
+    AES_NI_EXPAND(9, 0x1b);
+    AES_NI_EXPAND(10, 0x36);
+}
+
+static void btstack_crypto_aes128_encrypt_block(const uint8_t * plaintext, uint8_t * ciphertext){
+    __m128i state = _mm_loadu_si128((const __m128i *) plaintext);
+    state = _mm_xor_si128(state, btstack_crypto_aes128_round_keys[0]);
+    int round;
+    for (round = 1; round < 10; round++){
+        state = _mm_aesenc_si128(state, btstack_crypto_aes128_round_keys[round]);
+    }
+    state = _mm_aesenclast_si128(state, btstack_crypto_aes128_round_keys[10]);
+    _mm_storeu_si128((__m128i *) ciphertext, state);
+}
+
+#else
+
 // AES128 using public domain rijndael implementation
+static uint32_t btstack_crypto_aes128_rk[RKLENGTH(KEYBITS)];
+static int      btstack_crypto_aes128_nrounds;
+
+static void btstack_crypto_aes128_setup_key(const uint8_t * key){
+    btstack_crypto_aes128_nrounds = rijndaelSetupEncrypt(btstack_crypto_aes128_rk, &key[0], KEYBITS);
+}
+
+static void btstack_crypto_aes128_encrypt_block(const uint8_t * plaintext, uint8_t * ciphertext){
+    rijndaelEncrypt(btstack_crypto_aes128_rk, btstack_crypto_aes128_nrounds, plaintext, ciphertext);
+}
+
+#endif
+
 void btstack_aes128_calc(const uint8_t * key, const uint8_t * plaintext, uint8_t * ciphertext){
-    uint32_t rk[RKLENGTH(KEYBITS)];
-    int nrounds = rijndaelSetupEncrypt(rk, &key[0], KEYBITS);
-    rijndaelEncrypt(rk, nrounds, plaintext, ciphertext);
+    if ((btstack_crypto_aes128_key_valid == false) || (memcmp(btstack_crypto_aes128_key, key, 16) != 0)){
+        btstack_crypto_aes128_setup_key(key);
+        (void)memcpy(btstack_crypto_aes128_key, key, 16);
+        btstack_crypto_aes128_key_valid = true;
+    }
+    btstack_crypto_aes128_encrypt_block(plaintext, ciphertext);
 }
 #endif
 
-static void btstack_crypto_done(btstack_crypto_t * btstack_crypto){
-    btstack_linked_list_pop(&btstack_crypto_operations);
+static void btstack_crypto_enqueue(btstack_linked_list_t * operations, btstack_crypto_t * btstack_crypto){
+#ifdef ENABLE_BTSTACK_CRYPTO_STATISTICS
+    btstack_crypto->queued_ms = btstack_run_loop_get_time_ms();
+#endif
+    btstack_linked_list_add_tail(operations, (btstack_linked_item_t*) btstack_crypto);
+}
+
+static void btstack_crypto_complete(btstack_linked_list_t * operations, btstack_crypto_t * btstack_crypto){
+    btstack_linked_list_pop(operations);
+#ifdef ENABLE_BTSTACK_CRYPTO_STATISTICS
+    uint32_t latency_ms = btstack_run_loop_get_time_ms() - btstack_crypto->queued_ms;
+    btstack_crypto_statistics_t * statistics = &btstack_crypto_statistics[btstack_crypto->operation];
+    statistics->num_operations++;
+    statistics->total_latency_ms += latency_ms;
+    statistics->max_latency_ms = btstack_max(statistics->max_latency_ms, latency_ms);
+#endif
     (*btstack_crypto->context_callback.callback)(btstack_crypto->context_callback.context);
 }
 
+static void btstack_crypto_done(btstack_crypto_t * btstack_crypto){
+    btstack_crypto_complete(&btstack_crypto_operations, btstack_crypto);
+}
+
+#ifdef ENABLE_ECC_P256
+static void btstack_crypto_ecc_done(btstack_crypto_t * btstack_crypto){
+    btstack_crypto_complete(&btstack_crypto_ecc_operations, btstack_crypto);
+}
+#endif
+
 static void btstack_crypto_cmac_shift_left_by_one_bit_inplace(int len, uint8_t * data){
     int i;
     int carry = 0;
@@ -379,8 +486,7 @@ static void btstack_crypto_cmac_handle_encryption_result(btstack_crypto_aes128_c
             btstack_crypto_cmac_state = CMAC_IDLE;
             log_info_key("CMAC", data);
             (void)memcpy(btstack_crypto_cmac->hash, data, 16);
-			btstack_linked_list_pop(&btstack_crypto_operations);
-			(*btstack_crypto_cmac->btstack_crypto.context_callback.callback)(btstack_crypto_cmac->btstack_crypto.context_callback.context);
+            btstack_crypto_done(&btstack_crypto_cmac->btstack_crypto);
             break;
         default:
             log_info("btstack_crypto_cmac_handle_encryption_result called in state %u", btstack_crypto_cmac_state);
@@ -825,17 +931,37 @@ static void btstack_crypto_ccm_calc_aad_xn(btstack_crypto_ccm_t * btstack_crypto
 #endif
 }
 
-static void btstack_crypto_run(void){
+static bool btstack_crypto_operation_uses_hci(const btstack_crypto_t * btstack_crypto){
+    switch (btstack_crypto->operation){
+#ifdef USE_BTSTACK_AES128
+        // AES128 based operations are completed in a single pass without the Controller
+        case BTSTACK_CRYPTO_AES128:
+        case BTSTACK_CRYPTO_CMAC_MESSAGE:
+        case BTSTACK_CRYPTO_CMAC_GENERATOR:
+        case BTSTACK_CRYPTO_CCM_DIGEST_BLOCK:
+        case BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK:
+        case BTSTACK_CRYPTO_CCM_DECRYPT_BLOCK:
+            return false;
+#endif
+        default:
+            return true;
+    }
+}
+
+#ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+static bool btstack_crypto_random_pending(void){
+    if (!btstack_crypto_wait_for_hci_result) return false;
+    btstack_crypto_t * btstack_crypto = (btstack_crypto_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+    return btstack_crypto->operation == BTSTACK_CRYPTO_RANDOM;
+}
+#endif
+
+// process random and AES based operations
+static void btstack_crypto_run_operations(void){
 
     btstack_crypto_aes128_t        * btstack_crypto_aes128;
     btstack_crypto_ccm_t           * btstack_crypto_ccm;
     btstack_crypto_aes128_cmac_t   * btstack_crypto_cmac;
-#ifdef ENABLE_ECC_P256
-    btstack_crypto_ecc_p256_t      * btstack_crypto_ec_p192;
-#endif
-
-    // stack up and running?
-    if (hci_get_state() != HCI_STATE_WORKING) return;
 
     // try to do as much as possible
     while (true){
@@ -846,13 +972,18 @@ static void btstack_crypto_run(void){
         // already active?
         if (btstack_crypto_wait_for_hci_result) return;
 
-        // can send a command?
-        if (!hci_can_send_command_packet_now()) return;
-
         // ok, find next task
     	btstack_crypto_t * btstack_crypto = (btstack_crypto_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+
+        // can send a command?
+        if (btstack_crypto_operation_uses_hci(btstack_crypto) && !hci_can_send_command_packet_now()) return;
+
     	switch (btstack_crypto->operation){
     		case BTSTACK_CRYPTO_RANDOM:
+#ifdef ENABLE_ECC_P256
+                // only a single HCI LE Rand at a time
+                if (btstack_crypto_ecc_wait_for_random) return;
+#endif
     			btstack_crypto_wait_for_hci_result = true;
     		    hci_send_cmd(&hci_le_rand);
     		    break;
@@ -922,60 +1053,96 @@ static void btstack_crypto_run(void){
                 }
                 break;
 
+
+            default:
+                break;
+        }
+    }
+}
+
 #ifdef ENABLE_ECC_P256
-            case BTSTACK_CRYPTO_ECC_P256_GENERATE_KEY:
-                btstack_crypto_ec_p192 = (btstack_crypto_ecc_p256_t *) btstack_crypto;
-                switch (btstack_crypto_ecc_p256_key_generation_state){
-                    case ECC_P256_KEY_GENERATION_DONE:
-                        // done
-                        btstack_crypto_log_ec_publickey(btstack_crypto_ecc_p256_public_key);
-                        (void)memcpy(btstack_crypto_ec_p192->public_key,
-                                     btstack_crypto_ecc_p256_public_key, 64);
-                        btstack_linked_list_pop(&btstack_crypto_operations);
-                        (*btstack_crypto_ec_p192->btstack_crypto.context_callback.callback)(btstack_crypto_ec_p192->btstack_crypto.context_callback.context);
-                        break;
-                    case ECC_P256_KEY_GENERATION_IDLE:
+// process next ECC operation, @return true if operation was completed
+static bool btstack_crypto_run_ecc_operations(void){
+
+    // anything to do?
+    if (btstack_linked_list_empty(&btstack_crypto_ecc_operations)) return false;
+
+    // already active?
+    if (btstack_crypto_ecc_wait_for_hci_result) return false;
+
+    btstack_crypto_ecc_p256_t * btstack_crypto_ec_p192 = (btstack_crypto_ecc_p256_t *) btstack_linked_list_get_first_item(&btstack_crypto_ecc_operations);
+    switch (btstack_crypto_ec_p192->btstack_crypto.operation){
+        case BTSTACK_CRYPTO_ECC_P256_GENERATE_KEY:
+            switch (btstack_crypto_ecc_p256_key_generation_state){
+                case ECC_P256_KEY_GENERATION_DONE:
+                    // done
+                    btstack_crypto_log_ec_publickey(btstack_crypto_ecc_p256_public_key);
+                    (void)memcpy(btstack_crypto_ec_p192->public_key,
+                                 btstack_crypto_ecc_p256_public_key, 64);
+                    btstack_crypto_ecc_done(&btstack_crypto_ec_p192->btstack_crypto);
+                    return true;
+                case ECC_P256_KEY_GENERATION_IDLE:
+                    if (!hci_can_send_command_packet_now()) break;
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
-                        log_info("start ecc random");
-                        btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_GENERATING_RANDOM;
-                        btstack_crypto_ecc_p256_random_offset = 0;
-                        btstack_crypto_wait_for_hci_result = true;
-                        hci_send_cmd(&hci_le_rand);
+                    if (btstack_crypto_random_pending()) break;
+                    log_info("start ecc random");
+                    btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_GENERATING_RANDOM;
+                    btstack_crypto_ecc_p256_random_offset = 0;
+                    btstack_crypto_ecc_wait_for_hci_result = true;
+                    btstack_crypto_ecc_wait_for_random = true;
+                    hci_send_cmd(&hci_le_rand);
 #else
-                        btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_W4_KEY;
-                        btstack_crypto_wait_for_hci_result = 1;
-                        hci_send_cmd(&hci_le_read_local_p256_public_key);
+                    btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_W4_KEY;
+                    btstack_crypto_ecc_wait_for_hci_result = true;
+                    hci_send_cmd(&hci_le_read_local_p256_public_key);
 #endif
-                        break;
+                    break;
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
-                    case ECC_P256_KEY_GENERATION_GENERATING_RANDOM:
-                        log_info("more ecc random");
-                        btstack_crypto_wait_for_hci_result = true;
-                        hci_send_cmd(&hci_le_rand);
-                        break;
+                case ECC_P256_KEY_GENERATION_GENERATING_RANDOM:
+                    if (!hci_can_send_command_packet_now()) break;
+                    if (btstack_crypto_random_pending()) break;
+                    log_info("more ecc random");
+                    btstack_crypto_ecc_wait_for_hci_result = true;
+                    btstack_crypto_ecc_wait_for_random = true;
+                    hci_send_cmd(&hci_le_rand);
+                    break;
 #endif
-                    default:
-                        break;
-                }
-                break;
-            case BTSTACK_CRYPTO_ECC_P256_CALCULATE_DHKEY:
-                btstack_crypto_ec_p192 = (btstack_crypto_ecc_p256_t *) btstack_crypto;
+                default:
+                    break;
+            }
+            break;
+        case BTSTACK_CRYPTO_ECC_P256_CALCULATE_DHKEY:
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
-                btstack_crypto_ecc_p256_calculate_dhkey_software(btstack_crypto_ec_p192);
-                // done
-                btstack_linked_list_pop(&btstack_crypto_operations);
-                (*btstack_crypto_ec_p192->btstack_crypto.context_callback.callback)(btstack_crypto_ec_p192->btstack_crypto.context_callback.context);
+            btstack_crypto_ecc_p256_calculate_dhkey_software(btstack_crypto_ec_p192);
+            btstack_crypto_ecc_done(&btstack_crypto_ec_p192->btstack_crypto);
+            return true;
 #else
-                btstack_crypto_wait_for_hci_result = 1;
-                hci_send_cmd(&hci_le_generate_dhkey, &btstack_crypto_ec_p192->public_key[0], &btstack_crypto_ec_p192->public_key[32]);
+            if (!hci_can_send_command_packet_now()) break;
+            btstack_crypto_ecc_wait_for_hci_result = true;
+            hci_send_cmd(&hci_le_generate_dhkey, &btstack_crypto_ec_p192->public_key[0], &btstack_crypto_ec_p192->public_key[32]);
+            break;
 #endif
-                break;
-
+        default:
+            btstack_assert(false);
+            break;
+    }
+    return false;
+}
 #endif /* ENABLE_ECC_P256 */
 
-            default:
-                break;
-        }
+static void btstack_crypto_run(void){
+
+    // stack up and running?
+    if (hci_get_state() != HCI_STATE_WORKING) return;
+
+    while (true){
+        // random and AES operations are short and have priority
+        btstack_crypto_run_operations();
+#ifdef ENABLE_ECC_P256
+        // ECC operation might run while Controller is busy with AES operation, check queue again if it was completed
+        if (btstack_crypto_run_ecc_operations()) continue;
+#endif
+        return;
     }
 }
 
@@ -994,22 +1161,9 @@ static void btstack_crypto_handle_random_data(const uint8_t * data, uint16_t len
             // data processed, more?
             if (!btstack_crypto_random->size) {
                 // done
-                btstack_linked_list_pop(&btstack_crypto_operations);
-                (*btstack_crypto_random->btstack_crypto.context_callback.callback)(btstack_crypto_random->btstack_crypto.context_callback.context);
-            }
-            break;
-#ifdef ENABLE_ECC_P256
-        case BTSTACK_CRYPTO_ECC_P256_GENERATE_KEY:
-            (void)memcpy(&btstack_crypto_ecc_p256_random[btstack_crypto_ecc_p256_random_len],
-			 data, 8);
-            btstack_crypto_ecc_p256_random_len += 8u;
-            if (btstack_crypto_ecc_p256_random_len >= 64u) {
-                btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_ACTIVE;
-                btstack_crypto_ecc_p256_generate_key_software();
-                btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_DONE;
+                btstack_crypto_done(btstack_crypto);
             }
             break;
-#endif
         default:
             break;
     }
@@ -1017,6 +1171,21 @@ static void btstack_crypto_handle_random_data(const uint8_t * data, uint16_t len
 	btstack_crypto_run();
 }
 
+#ifdef ENABLE_ECC_P256
+static void btstack_crypto_ecc_handle_random_data(const uint8_t * data, uint16_t len){
+    UNUSED(len);
+    (void)memcpy(&btstack_crypto_ecc_p256_random[btstack_crypto_ecc_p256_random_len], data, 8);
+    btstack_crypto_ecc_p256_random_len += 8u;
+    if (btstack_crypto_ecc_p256_random_len >= 64u) {
+        btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_ACTIVE;
+        btstack_crypto_ecc_p256_generate_key_software();
+        btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_DONE;
+    }
+	// more work?
+	btstack_crypto_run();
+}
+#endif
+
 #ifndef USE_BTSTACK_AES128
 static void btstack_crypto_handle_encryption_result(const uint8_t * data){
 	btstack_crypto_aes128_t      * btstack_crypto_aes128;
@@ -1086,7 +1255,11 @@ static void btstack_crypto_event_handler(uint8_t packet_type, uint16_t cid, uint
     switch (hci_event_packet_get_type(packet)){
         case BTSTACK_EVENT_STATE:
             if (btstack_event_state_get_state(packet) != HCI_STATE_HALTING) break;
+#ifdef ENABLE_ECC_P256
+            if (!btstack_crypto_wait_for_hci_result && !btstack_crypto_ecc_wait_for_hci_result) break;
+#else
             if (!btstack_crypto_wait_for_hci_result) break;
+#endif
             // request stack to defer shutdown a bit
             hci_halting_defer();
             break;
@@ -1100,6 +1273,14 @@ static void btstack_crypto_event_handler(uint8_t packet_type, uint16_t cid, uint
     	    }
 #endif
     	    if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_le_rand)){
+#ifdef ENABLE_ECC_P256
+                if (btstack_crypto_ecc_wait_for_random){
+                    btstack_crypto_ecc_wait_for_random = false;
+                    btstack_crypto_ecc_wait_for_hci_result = false;
+                    btstack_crypto_ecc_handle_random_data(&packet[6], 8);
+                    return;
+                }
+#endif
                 if (!btstack_crypto_wait_for_hci_result) return;
                 btstack_crypto_wait_for_hci_result = false;
                 btstack_crypto_handle_random_data(&packet[6], 8);
@@ -1121,13 +1302,13 @@ static void btstack_crypto_event_handler(uint8_t packet_type, uint16_t cid, uint
 #ifdef ENABLE_ECC_P256
 #ifndef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
         case HCI_EVENT_LE_META:
-            btstack_crypto_ec_p192 = (btstack_crypto_ecc_p256_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+            btstack_crypto_ec_p192 = (btstack_crypto_ecc_p256_t*) btstack_linked_list_get_first_item(&btstack_crypto_ecc_operations);
             if (!btstack_crypto_ec_p192) break;
             switch (hci_event_le_meta_get_subevent_code(packet)){
                 case HCI_SUBEVENT_LE_READ_LOCAL_P256_PUBLIC_KEY_COMPLETE:
                     if (btstack_crypto_ec_p192->btstack_crypto.operation != BTSTACK_CRYPTO_ECC_P256_GENERATE_KEY) break;
-                    if (!btstack_crypto_wait_for_hci_result) return;
-                    btstack_crypto_wait_for_hci_result = 0;
+                    if (!btstack_crypto_ecc_wait_for_hci_result) return;
+                    btstack_crypto_ecc_wait_for_hci_result = false;
                     if (hci_subevent_le_read_local_p256_public_key_complete_get_status(packet)){
                         log_error("Read Local P256 Public Key failed");
                     }
@@ -1137,15 +1318,14 @@ static void btstack_crypto_event_handler(uint8_t packet_type, uint16_t cid, uint
                     break;
                 case HCI_SUBEVENT_LE_GENERATE_DHKEY_COMPLETE:
                     if (btstack_crypto_ec_p192->btstack_crypto.operation != BTSTACK_CRYPTO_ECC_P256_CALCULATE_DHKEY) break;
-                    if (!btstack_crypto_wait_for_hci_result) return;
-                    btstack_crypto_wait_for_hci_result = 0;
+                    if (!btstack_crypto_ecc_wait_for_hci_result) return;
+                    btstack_crypto_ecc_wait_for_hci_result = false;
                     if (hci_subevent_le_generate_dhkey_complete_get_status(packet)){
                         log_error("Generate DHKEY failed -> abort");
                     }
                     hci_subevent_le_generate_dhkey_complete_get_dhkey(packet, btstack_crypto_ec_p192->dhkey);
                     // done
-                    btstack_linked_list_pop(&btstack_crypto_operations);
-                    (*btstack_crypto_ec_p192->btstack_crypto.context_callback.callback)(btstack_crypto_ec_p192->btstack_crypto.context_callback.context);                    
+                    btstack_crypto_ecc_done(&btstack_crypto_ec_p192->btstack_crypto);
                     break;
                 default:
                     break;                
@@ -1181,7 +1361,7 @@ void btstack_crypto_random_generate(btstack_crypto_random_t * request, uint8_t *
 	request->btstack_crypto.operation         		   = BTSTACK_CRYPTO_RANDOM;
 	request->buffer = buffer;
 	request->size   = size;
-	btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+	btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
 	btstack_crypto_run();
 }
 
@@ -1192,7 +1372,7 @@ void btstack_crypto_aes128_encrypt(btstack_crypto_aes128_t * request, const uint
 	request->key 									   = key;
 	request->plaintext      					       = plaintext;
 	request->ciphertext 							   = ciphertext;
-	btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+	btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
 	btstack_crypto_run();
 }
 
@@ -1204,7 +1384,7 @@ void btstack_crypto_aes128_cmac_generator(btstack_crypto_aes128_cmac_t * request
 	request->size 									   = size;
 	request->data.get_byte_callback					   = get_byte_callback;
 	request->hash 									   = hash;
-	btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+	btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
 	btstack_crypto_run();
 }
 
@@ -1216,7 +1396,7 @@ void btstack_crypto_aes128_cmac_message(btstack_crypto_aes128_cmac_t * request,
 	request->size 									   = size;
 	request->data.message      						   = message;
 	request->hash 									   = hash;
-	btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+	btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
 	btstack_crypto_run();
 }
 
@@ -1228,7 +1408,7 @@ void btstack_crypto_aes128_cmac_zero(btstack_crypto_aes128_cmac_t * request, uin
     request->size                                      = len;
     request->data.message                              = message;
     request->hash                                      = hash;
-    btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+    btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
     btstack_crypto_run();
 }
 
@@ -1243,7 +1423,7 @@ void btstack_crypto_ecc_p256_generate_key(btstack_crypto_ecc_p256_t * request, u
     request->btstack_crypto.context_callback.context   = callback_arg;
     request->btstack_crypto.operation                  = BTSTACK_CRYPTO_ECC_P256_GENERATE_KEY;
     request->public_key                                = public_key;
-    btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+    btstack_crypto_enqueue(&btstack_crypto_ecc_operations, &request->btstack_crypto);
     btstack_crypto_run();
 }
 
@@ -1253,7 +1433,7 @@ void btstack_crypto_ecc_p256_calculate_dhkey(btstack_crypto_ecc_p256_t * request
     request->btstack_crypto.operation                  = BTSTACK_CRYPTO_ECC_P256_CALCULATE_DHKEY;
     request->public_key                                = (uint8_t *) public_key;
     request->dhkey                                     = dhkey;
-    btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+    btstack_crypto_enqueue(&btstack_crypto_ecc_operations, &request->btstack_crypto);
     btstack_crypto_run();
 }
 
@@ -1307,7 +1487,7 @@ void btstack_crypto_ccm_digest(btstack_crypto_ccm_t * request, uint8_t * additio
     request->btstack_crypto.operation                  = BTSTACK_CRYPTO_CCM_DIGEST_BLOCK;
     request->block_len                                 = additional_authenticated_data_len;
     request->input                                     = additional_authenticated_data;
-    btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+    btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
     btstack_crypto_run();
 }
 
@@ -1328,7 +1508,7 @@ void btstack_crypto_ccm_encrypt_block(btstack_crypto_ccm_t * request, uint16_t b
     if (request->state != CCM_CALCULATE_X1){
         request->state  = CCM_CALCULATE_XN;
     }
-    btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+    btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
     btstack_crypto_run();
 }
 
@@ -1342,7 +1522,7 @@ void btstack_crypto_ccm_decrypt_block(btstack_crypto_ccm_t * request, uint16_t b
     if (request->state != CCM_CALCULATE_X1){
         request->state  = CCM_CALCULATE_SN;
     }
-    btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) request);
+    btstack_crypto_enqueue(&btstack_crypto_operations, &request->btstack_crypto);
     btstack_crypto_run();
 }
 
@@ -1351,6 +1531,15 @@ void btstack_crypto_deinit(void) {
     btstack_crypto_initialized = false;
     btstack_crypto_wait_for_hci_result = false;
     btstack_crypto_operations = NULL;
+#ifdef ENABLE_ECC_P256
+    btstack_crypto_ecc_wait_for_hci_result = false;
+    btstack_crypto_ecc_wait_for_random = false;
+    btstack_crypto_ecc_operations = NULL;
+#endif
+#ifdef ENABLE_SOFTWARE_AES128
+    btstack_crypto_aes128_key_valid = false;
+    memset(btstack_crypto_aes128_key, 0, 16);
+#endif
 }
 
 // PTS only
@@ -1365,8 +1554,22 @@ void btstack_crypto_ecc_p256_set_key(const uint8_t * public_key, const uint8_t *
 #endif
 }
 
+#ifdef ENABLE_BTSTACK_CRYPTO_STATISTICS
+void btstack_crypto_get_statistics(btstack_crypto_operation_t operation, btstack_crypto_statistics_t * statistics){
+    btstack_assert(operation <= BTSTACK_CRYPTO_CCM_DECRYPT_BLOCK);
+    *statistics = btstack_crypto_statistics[operation];
+}
+
+void btstack_crypto_reset_statistics(void){
+    memset(btstack_crypto_statistics, 0, sizeof(btstack_crypto_statistics));
+}
+#endif
+
 // Unit testing
 int btstack_crypto_idle(void){
+#ifdef ENABLE_ECC_P256
+    if (!btstack_linked_list_empty(&btstack_crypto_ecc_operations)) return 0;
+#endif
     return btstack_linked_list_empty(&btstack_crypto_operations);
 }
 void btstack_crypto_reset(void){
@@ -69,8 +69,18 @@ typedef enum {
 typedef struct {
 	btstack_context_callback_registration_t context_callback;
 	btstack_crypto_operation_t              operation;	
+#ifdef ENABLE_BTSTACK_CRYPTO_STATISTICS
+	uint32_t                                queued_ms;
+#endif
 } btstack_crypto_t;
 
+// latency from request until callback per operation type
+typedef struct {
+	uint32_t num_operations;
+	uint32_t total_latency_ms;
+	uint32_t max_latency_ms;
+} btstack_crypto_statistics_t;
+
 typedef struct {
 	btstack_crypto_t btstack_crypto;
 	uint8_t  * buffer;
@@ -282,6 +292,20 @@ void btstack_crypto_ccm_decrypt_block(btstack_crypto_ccm_t * request, uint16_t l
 void btstack_aes128_calc(const uint8_t * key, const uint8_t * plaintext, uint8_t * ciphertext);
 #endif
 
+#ifdef ENABLE_BTSTACK_CRYPTO_STATISTICS
+/**
+ * @brief Get latency statistics for operation type, requires ENABLE_BTSTACK_CRYPTO_STATISTICS
+ * @param operation
+ * @param statistics
+ */
+void btstack_crypto_get_statistics(btstack_crypto_operation_t operation, btstack_crypto_statistics_t * statistics);
+
+/**
+ * @brief Reset latency statistics, requires ENABLE_BTSTACK_CRYPTO_STATISTICS
+ */
+void btstack_crypto_reset_statistics(void);
+#endif
+
 /**
  * @brief De-Init BTstack Crypto
  */
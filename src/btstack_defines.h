@@ -900,6 +900,41 @@ typedef uint8_t sm_key_t[16];
  */
 #define L2CAP_EVENT_TRIGGER_RUN                            0x7f
 
+// L2CAP events continued after SDP events, 0x70 - 0x7f are in use
+
+/*
+ * @format 2
+ * @param local_cid
+ */
+#define L2CAP_EVENT_ERTM_PACKET_SENT                       0x96
+
+/**
+ * @format 1BH2122
+ * @param address_type
+ * @param address
+ * @param handle
+ * @param psm
+ * @param num_channels
+ * @param local_cid
+ * @param remote_mtu
+ */
+#define L2CAP_EVENT_ECBM_INCOMING_CONNECTION               0x97
+
+/*
+ * @format 222
+ * @param local_cid
+ * @param remote_mtu
+ * @param remote_mps
+ */
+#define L2CAP_EVENT_ECBM_RECONFIGURED                      0x98
+
+/*
+ * @format 22
+ * @param local_cid
+ * @param result
+ */
+#define L2CAP_EVENT_ECBM_RECONFIGURATION_COMPLETE          0x99
+
 
 // RFCOMM EVENTS
 
@@ -956,6 +991,15 @@ typedef uint8_t sm_key_t[16];
  */
 #define RFCOMM_EVENT_CAN_SEND_NOW                          0x89
 
+/**
+ * @format 2144
+ * @param rfcomm_cid
+ * @param status
+ * @param num_bytes
+ * @param duration_ms
+ */
+#define RFCOMM_EVENT_STREAM_COMPLETE                       0x8e
+
 
 /**
  * @format 1
@@ -1102,6 +1146,16 @@ typedef uint8_t sm_key_t[16];
  */
 #define GATT_EVENT_CAN_WRITE_WITHOUT_RESPONSE                    0xAC
 
+/**
+ * @format H1244
+ * @param handle
+ * @param status
+ * @param value_handle
+ * @param num_bytes
+ * @param duration_ms
+ */
+#define GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE        0xAD
+
 /** 
  * @format 1BH
  * @param address_type
@@ -1136,6 +1190,15 @@ typedef uint8_t sm_key_t[16];
  */
 #define ATT_EVENT_CAN_SEND_NOW                                   0xB7
 
+/**
+ * @format 2244
+ * @param attribute_handle
+ * @param num_notified
+ * @param num_bytes
+ * @param duration_ms
+ */
+#define ATT_EVENT_NOTIFY_ALL_COMPLETE                            0xB8
+
 // TODO: daemon only event
 
 /**
@@ -1619,6 +1619,127 @@ static inline uint16_t l2cap_event_ertm_buffer_released_get_local_cid(const uint
     return little_endian_read_16(event, 2);
 }
 
+/**
+ * @brief Get field local_cid from event L2CAP_EVENT_ERTM_PACKET_SENT
+ * @param event packet
+ * @return local_cid
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ertm_packet_sent_get_local_cid(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+
+/**
+ * @brief Get field address_type from event L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param event packet
+ * @return address_type
+ * @note: btstack_type 1
+ */
+static inline uint8_t l2cap_event_ecbm_incoming_connection_get_address_type(const uint8_t * event){
+    return event[2];
+}
+/**
+ * @brief Get field address from event L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param event packet
+ * @param Pointer to storage for address
+ * @note: btstack_type B
+ */
+static inline void l2cap_event_ecbm_incoming_connection_get_address(const uint8_t * event, bd_addr_t address){
+    reverse_bytes(&event[3], address, 6);
+}
+/**
+ * @brief Get field handle from event L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param event packet
+ * @return handle
+ * @note: btstack_type H
+ */
+static inline hci_con_handle_t l2cap_event_ecbm_incoming_connection_get_handle(const uint8_t * event){
+    return little_endian_read_16(event, 9);
+}
+/**
+ * @brief Get field psm from event L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param event packet
+ * @return psm
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_incoming_connection_get_psm(const uint8_t * event){
+    return little_endian_read_16(event, 11);
+}
+/**
+ * @brief Get field num_channels from event L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param event packet
+ * @return num_channels
+ * @note: btstack_type 1
+ */
+static inline uint8_t l2cap_event_ecbm_incoming_connection_get_num_channels(const uint8_t * event){
+    return event[13];
+}
+/**
+ * @brief Get field local_cid from event L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param event packet
+ * @return local_cid
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_incoming_connection_get_local_cid(const uint8_t * event){
+    return little_endian_read_16(event, 14);
+}
+/**
+ * @brief Get field remote_mtu from event L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param event packet
+ * @return remote_mtu
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_incoming_connection_get_remote_mtu(const uint8_t * event){
+    return little_endian_read_16(event, 16);
+}
+
+/**
+ * @brief Get field local_cid from event L2CAP_EVENT_ECBM_RECONFIGURED
+ * @param event packet
+ * @return local_cid
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_reconfigured_get_local_cid(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field remote_mtu from event L2CAP_EVENT_ECBM_RECONFIGURED
+ * @param event packet
+ * @return remote_mtu
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_reconfigured_get_remote_mtu(const uint8_t * event){
+    return little_endian_read_16(event, 4);
+}
+/**
+ * @brief Get field remote_mps from event L2CAP_EVENT_ECBM_RECONFIGURED
+ * @param event packet
+ * @return remote_mps
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_reconfigured_get_remote_mps(const uint8_t * event){
+    return little_endian_read_16(event, 6);
+}
+
+/**
+ * @brief Get field local_cid from event L2CAP_EVENT_ECBM_RECONFIGURATION_COMPLETE
+ * @param event packet
+ * @return local_cid
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_reconfiguration_complete_get_local_cid(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field result from event L2CAP_EVENT_ECBM_RECONFIGURATION_COMPLETE
+ * @param event packet
+ * @return result
+ * @note: btstack_type 2
+ */
+static inline uint16_t l2cap_event_ecbm_reconfiguration_complete_get_result(const uint8_t * event){
+    return little_endian_read_16(event, 4);
+}
+
 
 /**
  * @brief Get field status from event RFCOMM_EVENT_CHANNEL_OPENED
@@ -1770,6 +1891,43 @@ static inline uint16_t rfcomm_event_can_send_now_get_rfcomm_cid(const uint8_t *
     return little_endian_read_16(event, 2);
 }
 
+/**
+ * @brief Get field rfcomm_cid from event RFCOMM_EVENT_STREAM_COMPLETE
+ * @param event packet
+ * @return rfcomm_cid
+ * @note: btstack_type 2
+ */
+static inline uint16_t rfcomm_event_stream_complete_get_rfcomm_cid(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field status from event RFCOMM_EVENT_STREAM_COMPLETE
+ * @param event packet
+ * @return status
+ * @note: btstack_type 1
+ */
+static inline uint8_t rfcomm_event_stream_complete_get_status(const uint8_t * event){
+    return event[4];
+}
+/**
+ * @brief Get field num_bytes from event RFCOMM_EVENT_STREAM_COMPLETE
+ * @param event packet
+ * @return num_bytes
+ * @note: btstack_type 4
+ */
+static inline uint32_t rfcomm_event_stream_complete_get_num_bytes(const uint8_t * event){
+    return little_endian_read_32(event, 5);
+}
+/**
+ * @brief Get field duration_ms from event RFCOMM_EVENT_STREAM_COMPLETE
+ * @param event packet
+ * @return duration_ms
+ * @note: btstack_type 4
+ */
+static inline uint32_t rfcomm_event_stream_complete_get_duration_ms(const uint8_t * event){
+    return little_endian_read_32(event, 9);
+}
+
 /**
  * @brief Get field status from event SDP_EVENT_QUERY_COMPLETE
  * @param event packet
@@ -2300,6 +2458,54 @@ static inline hci_con_handle_t gatt_event_can_write_without_response_get_handle(
 }
 #endif
 
+#ifdef ENABLE_BLE
+/**
+ * @brief Get field handle from event GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE
+ * @param event packet
+ * @return handle
+ * @note: btstack_type H
+ */
+static inline hci_con_handle_t gatt_event_write_without_response_stream_complete_get_handle(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field status from event GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE
+ * @param event packet
+ * @return status
+ * @note: btstack_type 1
+ */
+static inline uint8_t gatt_event_write_without_response_stream_complete_get_status(const uint8_t * event){
+    return event[4];
+}
+/**
+ * @brief Get field value_handle from event GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE
+ * @param event packet
+ * @return value_handle
+ * @note: btstack_type 2
+ */
+static inline uint16_t gatt_event_write_without_response_stream_complete_get_value_handle(const uint8_t * event){
+    return little_endian_read_16(event, 5);
+}
+/**
+ * @brief Get field num_bytes from event GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE
+ * @param event packet
+ * @return num_bytes
+ * @note: btstack_type 4
+ */
+static inline uint32_t gatt_event_write_without_response_stream_complete_get_num_bytes(const uint8_t * event){
+    return little_endian_read_32(event, 7);
+}
+/**
+ * @brief Get field duration_ms from event GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE
+ * @param event packet
+ * @return duration_ms
+ * @note: btstack_type 4
+ */
+static inline uint32_t gatt_event_write_without_response_stream_complete_get_duration_ms(const uint8_t * event){
+    return little_endian_read_32(event, 11);
+}
+#endif
+
 /**
  * @brief Get field address_type from event ATT_EVENT_CONNECTED
  * @param event packet
@@ -2386,6 +2592,43 @@ static inline uint16_t att_event_handle_value_indication_complete_get_attribute_
 }
 
 
+/**
+ * @brief Get field attribute_handle from event ATT_EVENT_NOTIFY_ALL_COMPLETE
+ * @param event packet
+ * @return attribute_handle
+ * @note: btstack_type 2
+ */
+static inline uint16_t att_event_notify_all_complete_get_attribute_handle(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field num_notified from event ATT_EVENT_NOTIFY_ALL_COMPLETE
+ * @param event packet
+ * @return num_notified
+ * @note: btstack_type 2
+ */
+static inline uint16_t att_event_notify_all_complete_get_num_notified(const uint8_t * event){
+    return little_endian_read_16(event, 4);
+}
+/**
+ * @brief Get field num_bytes from event ATT_EVENT_NOTIFY_ALL_COMPLETE
+ * @param event packet
+ * @return num_bytes
+ * @note: btstack_type 4
+ */
+static inline uint32_t att_event_notify_all_complete_get_num_bytes(const uint8_t * event){
+    return little_endian_read_32(event, 6);
+}
+/**
+ * @brief Get field duration_ms from event ATT_EVENT_NOTIFY_ALL_COMPLETE
+ * @param event packet
+ * @return duration_ms
+ * @note: btstack_type 4
+ */
+static inline uint32_t att_event_notify_all_complete_get_duration_ms(const uint8_t * event){
+    return little_endian_read_32(event, 10);
+}
+
 /**
  * @brief Get field status from event BNEP_EVENT_SERVICE_REGISTERED
  * @param event packet
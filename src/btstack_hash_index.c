@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_hash_index.c"
+
+/*
+ *  btstack_hash_index.c
+ *
+ *  Linear probing with backward shift deletion, no tombstones needed
+ */
+
+#include <string.h>
+
+#include "btstack_hash_index.h"
+#include "btstack_debug.h"
+
+// Fibonacci hashing: multiply with 2^16 / golden ratio and use upper bits
+static uint16_t btstack_hash_index_slot(const btstack_hash_index_t * index, uint16_t key){
+    uint16_t hash = (uint16_t) (key * 40503u);
+    return hash >> index->shift;
+}
+
+void btstack_hash_index_init(btstack_hash_index_t * index, btstack_hash_index_entry_t * entries, uint16_t num_entries){
+    btstack_assert(num_entries >= 2u);
+    btstack_assert((num_entries & (num_entries - 1u)) == 0u);
+    index->entries = entries;
+    index->num_entries = num_entries;
+    index->shift = 16;
+    while (num_entries > 1u){
+        num_entries >>= 1;
+        index->shift--;
+    }
+    btstack_hash_index_clear(index);
+}
+
+void btstack_hash_index_clear(btstack_hash_index_t * index){
+    memset(index->entries, 0, index->num_entries * sizeof(btstack_hash_index_entry_t));
+    index->num_used = 0;
+    index->num_missing = 0;
+}
+
+bool btstack_hash_index_add(btstack_hash_index_t * index, uint16_t key, void * value){
+    btstack_assert(value != NULL);
+    const uint16_t mask = index->num_entries - 1u;
+    uint16_t slot = btstack_hash_index_slot(index, key);
+    while (index->entries[slot].value != NULL){
+        if (index->entries[slot].key == key){
+            if (index->entries[slot].value == value) return true;
+            // previous object for key is not in index anymore
+            index->entries[slot].value = value;
+            index->num_missing++;
+            return true;
+        }
+        slot = (slot + 1u) & mask;
+    }
+    // keep one entry unused to terminate lookups
+    if ((index->num_used + 1u) >= index->num_entries){
+        index->num_missing++;
+        return false;
+    }
+    index->entries[slot].key = key;
+    index->entries[slot].value = value;
+    index->num_used++;
+    return true;
+}
+
+void btstack_hash_index_remove(btstack_hash_index_t * index, uint16_t key, const void * value){
+    const uint16_t mask = index->num_entries - 1u;
+    uint16_t slot = btstack_hash_index_slot(index, key);
+    while (true){
+        if (index->entries[slot].value == NULL){
+            // not found
+            if (index->num_missing > 0u){
+                index->num_missing--;
+            }
+            return;
+        }
+        if (index->entries[slot].key == key) break;
+        slot = (slot + 1u) & mask;
+    }
+    if (index->entries[slot].value != value){
+        // key used by other object, given object was missing
+        if (index->num_missing > 0u){
+            index->num_missing--;
+        }
+        return;
+    }
+    // move following entries back that would not be found otherwise
+    uint16_t free_slot = slot;
+    uint16_t next_slot = slot;
+    while (true){
+        next_slot = (next_slot + 1u) & mask;
+        if (index->entries[next_slot].value == NULL) break;
+        uint16_t home_slot = btstack_hash_index_slot(index, index->entries[next_slot].key);
+        // entry can be moved if its home slot is not in (free_slot, next_slot]
+        uint16_t distance_home = (next_slot - home_slot) & mask;
+        uint16_t distance_free = (next_slot - free_slot) & mask;
+        if (distance_home >= distance_free){
+            index->entries[free_slot] = index->entries[next_slot];
+            free_slot = next_slot;
+        }
+    }
+    index->entries[free_slot].value = NULL;
+    index->num_used--;
+}
+
+void * btstack_hash_index_get(const btstack_hash_index_t * index, uint16_t key){
+    const uint16_t mask = index->num_entries - 1u;
+    uint16_t slot = btstack_hash_index_slot(index, key);
+    while (index->entries[slot].value != NULL){
+        if (index->entries[slot].key == key){
+            return index->entries[slot].value;
+        }
+        slot = (slot + 1u) & mask;
+    }
+    return NULL;
+}
+
+bool btstack_hash_index_complete(const btstack_hash_index_t * index){
+    return index->num_missing == 0u;
+}
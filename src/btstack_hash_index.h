@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  btstack_hash_index.h
+ *
+ *  Open addressing hash table to map 16-bit keys, e.g. connection handles or channel ids, to objects
+ */
+
+#ifndef BTSTACK_HASH_INDEX_H
+#define BTSTACK_HASH_INDEX_H
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "btstack_bool.h"
+
+typedef struct {
+    uint16_t key;
+    // NULL if unused
+    void *   value;
+} btstack_hash_index_entry_t;
+
+typedef struct {
+    btstack_hash_index_entry_t * entries;
+    uint16_t num_entries;
+    uint16_t num_used;
+    uint8_t  shift;
+    // number of objects that could not be added as index was full or key was used by other object
+    uint16_t num_missing;
+} btstack_hash_index_t;
+
+/**
+ * Init hash index
+ * @param index object
+ * @param entries storage
+ * @param num_entries power of two, at most one less than num_entries can be stored
+ */
+void btstack_hash_index_init(btstack_hash_index_t * index, btstack_hash_index_entry_t * entries, uint16_t num_entries);
+
+/**
+ * Remove all entries
+ * @param index object
+ */
+void btstack_hash_index_clear(btstack_hash_index_t * index);
+
+/**
+ * Add object for key. If key is already used, object replaces the previous one, which then counts as missing
+ * @param index object
+ * @param key
+ * @param value != NULL
+ * @return true if added, false if index was full and object counts as missing
+ */
+bool btstack_hash_index_add(btstack_hash_index_t * index, uint16_t key, void * value);
+
+/**
+ * Remove object for key. If object was not in index, number of missing objects is reduced
+ * @param index object
+ * @param key
+ * @param value that was added for key
+ */
+void btstack_hash_index_remove(btstack_hash_index_t * index, uint16_t key, const void * value);
+
+/**
+ * Get object for key
+ * @param index object
+ * @param key
+ * @return object or NULL
+ */
+void * btstack_hash_index_get(const btstack_hash_index_t * index, uint16_t key);
+
+/**
+ * Check if all added objects are in index. If not, lookups that return NULL have to be verified by linear search
+ * @param index object
+ * @return true if all objects are in index
+ */
+bool btstack_hash_index_complete(const btstack_hash_index_t * index);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // BTSTACK_HASH_INDEX_H
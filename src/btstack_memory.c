@@ -96,18 +96,15 @@ static void btstack_memory_tracking_remove(btstack_memory_buffer_t * buffer){
 
     btstack_memory_malloc_counter--;
 }
-#endif
 
-void btstack_memory_deinit(void){
-#ifdef HAVE_MALLOC
-    while (btstack_memory_malloc_buffers != NULL){
-        btstack_memory_buffer_t * buffer = btstack_memory_malloc_buffers;
-        btstack_memory_malloc_buffers = buffer->next;
-        free(buffer);
+static void btstack_memory_stats_add(btstack_memory_pool_stats_t * stats){
+    stats->num_allocations++;
+    stats->in_use++;
+    if (stats->in_use > stats->max_in_use){
+        stats->max_in_use = stats->in_use;
     }
-    btstack_assert(btstack_memory_malloc_counter == 0);
-#endif
 }
+#endif
 
 
 // MARK: hci_connection_t
@@ -122,6 +119,7 @@ void btstack_memory_deinit(void){
 #ifdef MAX_NR_HCI_CONNECTIONS
 #if MAX_NR_HCI_CONNECTIONS > 0
 static hci_connection_t hci_connection_storage[MAX_NR_HCI_CONNECTIONS];
+static uint32_t hci_connection_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_HCI_CONNECTIONS)];
 static btstack_memory_pool_t hci_connection_pool;
 hci_connection_t * btstack_memory_hci_connection_get(void){
     void * buffer = btstack_memory_pool_get(&hci_connection_pool);
@@ -133,6 +131,9 @@ hci_connection_t * btstack_memory_hci_connection_get(void){
 void btstack_memory_hci_connection_free(hci_connection_t *hci_connection){
     btstack_memory_pool_free(&hci_connection_pool, hci_connection);
 }
+void btstack_memory_hci_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&hci_connection_pool, stats);
+}
 #else
 hci_connection_t * btstack_memory_hci_connection_get(void){
     return NULL;
@@ -140,6 +141,9 @@ hci_connection_t * btstack_memory_hci_connection_get(void){
 void btstack_memory_hci_connection_free(hci_connection_t *hci_connection){
     UNUSED(hci_connection);
 };
+void btstack_memory_hci_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -148,13 +152,17 @@ typedef struct {
     hci_connection_t data;
 } btstack_memory_hci_connection_t;
 
+static btstack_memory_pool_stats_t hci_connection_stats;
+
 hci_connection_t * btstack_memory_hci_connection_get(void){
     btstack_memory_hci_connection_t * buffer = (btstack_memory_hci_connection_t *) malloc(sizeof(btstack_memory_hci_connection_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_hci_connection_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&hci_connection_stats);
         return &buffer->data;
     } else {
+        hci_connection_stats.num_failed++;
         return NULL;
     }
 }
@@ -162,8 +170,12 @@ void btstack_memory_hci_connection_free(hci_connection_t *hci_connection){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) hci_connection)[-1];
     btstack_memory_tracking_remove(buffer);
+    hci_connection_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_hci_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = hci_connection_stats;
+}
 #endif
 
 
@@ -180,6 +192,7 @@ void btstack_memory_hci_connection_free(hci_connection_t *hci_connection){
 #ifdef MAX_NR_L2CAP_SERVICES
 #if MAX_NR_L2CAP_SERVICES > 0
 static l2cap_service_t l2cap_service_storage[MAX_NR_L2CAP_SERVICES];
+static uint32_t l2cap_service_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_L2CAP_SERVICES)];
 static btstack_memory_pool_t l2cap_service_pool;
 l2cap_service_t * btstack_memory_l2cap_service_get(void){
     void * buffer = btstack_memory_pool_get(&l2cap_service_pool);
@@ -191,6 +204,9 @@ l2cap_service_t * btstack_memory_l2cap_service_get(void){
 void btstack_memory_l2cap_service_free(l2cap_service_t *l2cap_service){
     btstack_memory_pool_free(&l2cap_service_pool, l2cap_service);
 }
+void btstack_memory_l2cap_service_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&l2cap_service_pool, stats);
+}
 #else
 l2cap_service_t * btstack_memory_l2cap_service_get(void){
     return NULL;
@@ -198,6 +214,9 @@ l2cap_service_t * btstack_memory_l2cap_service_get(void){
 void btstack_memory_l2cap_service_free(l2cap_service_t *l2cap_service){
     UNUSED(l2cap_service);
 };
+void btstack_memory_l2cap_service_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -206,13 +225,17 @@ typedef struct {
     l2cap_service_t data;
 } btstack_memory_l2cap_service_t;
 
+static btstack_memory_pool_stats_t l2cap_service_stats;
+
 l2cap_service_t * btstack_memory_l2cap_service_get(void){
     btstack_memory_l2cap_service_t * buffer = (btstack_memory_l2cap_service_t *) malloc(sizeof(btstack_memory_l2cap_service_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_l2cap_service_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&l2cap_service_stats);
         return &buffer->data;
     } else {
+        l2cap_service_stats.num_failed++;
         return NULL;
     }
 }
@@ -220,8 +243,12 @@ void btstack_memory_l2cap_service_free(l2cap_service_t *l2cap_service){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) l2cap_service)[-1];
     btstack_memory_tracking_remove(buffer);
+    l2cap_service_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_l2cap_service_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = l2cap_service_stats;
+}
 #endif
 
 
@@ -237,6 +264,7 @@ void btstack_memory_l2cap_service_free(l2cap_service_t *l2cap_service){
 #ifdef MAX_NR_L2CAP_CHANNELS
 #if MAX_NR_L2CAP_CHANNELS > 0
 static l2cap_channel_t l2cap_channel_storage[MAX_NR_L2CAP_CHANNELS];
+static uint32_t l2cap_channel_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_L2CAP_CHANNELS)];
 static btstack_memory_pool_t l2cap_channel_pool;
 l2cap_channel_t * btstack_memory_l2cap_channel_get(void){
     void * buffer = btstack_memory_pool_get(&l2cap_channel_pool);
@@ -248,6 +276,9 @@ l2cap_channel_t * btstack_memory_l2cap_channel_get(void){
 void btstack_memory_l2cap_channel_free(l2cap_channel_t *l2cap_channel){
     btstack_memory_pool_free(&l2cap_channel_pool, l2cap_channel);
 }
+void btstack_memory_l2cap_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&l2cap_channel_pool, stats);
+}
 #else
 l2cap_channel_t * btstack_memory_l2cap_channel_get(void){
     return NULL;
@@ -255,6 +286,9 @@ l2cap_channel_t * btstack_memory_l2cap_channel_get(void){
 void btstack_memory_l2cap_channel_free(l2cap_channel_t *l2cap_channel){
     UNUSED(l2cap_channel);
 };
+void btstack_memory_l2cap_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -263,13 +297,17 @@ typedef struct {
     l2cap_channel_t data;
 } btstack_memory_l2cap_channel_t;
 
+static btstack_memory_pool_stats_t l2cap_channel_stats;
+
 l2cap_channel_t * btstack_memory_l2cap_channel_get(void){
     btstack_memory_l2cap_channel_t * buffer = (btstack_memory_l2cap_channel_t *) malloc(sizeof(btstack_memory_l2cap_channel_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_l2cap_channel_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&l2cap_channel_stats);
         return &buffer->data;
     } else {
+        l2cap_channel_stats.num_failed++;
         return NULL;
     }
 }
@@ -277,8 +315,12 @@ void btstack_memory_l2cap_channel_free(l2cap_channel_t *l2cap_channel){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) l2cap_channel)[-1];
     btstack_memory_tracking_remove(buffer);
+    l2cap_channel_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_l2cap_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = l2cap_channel_stats;
+}
 #endif
 
 
@@ -296,6 +338,7 @@ void btstack_memory_l2cap_channel_free(l2cap_channel_t *l2cap_channel){
 #ifdef MAX_NR_RFCOMM_MULTIPLEXERS
 #if MAX_NR_RFCOMM_MULTIPLEXERS > 0
 static rfcomm_multiplexer_t rfcomm_multiplexer_storage[MAX_NR_RFCOMM_MULTIPLEXERS];
+static uint32_t rfcomm_multiplexer_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_RFCOMM_MULTIPLEXERS)];
 static btstack_memory_pool_t rfcomm_multiplexer_pool;
 rfcomm_multiplexer_t * btstack_memory_rfcomm_multiplexer_get(void){
     void * buffer = btstack_memory_pool_get(&rfcomm_multiplexer_pool);
@@ -307,6 +350,9 @@ rfcomm_multiplexer_t * btstack_memory_rfcomm_multiplexer_get(void){
 void btstack_memory_rfcomm_multiplexer_free(rfcomm_multiplexer_t *rfcomm_multiplexer){
     btstack_memory_pool_free(&rfcomm_multiplexer_pool, rfcomm_multiplexer);
 }
+void btstack_memory_rfcomm_multiplexer_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&rfcomm_multiplexer_pool, stats);
+}
 #else
 rfcomm_multiplexer_t * btstack_memory_rfcomm_multiplexer_get(void){
     return NULL;
@@ -314,6 +360,9 @@ rfcomm_multiplexer_t * btstack_memory_rfcomm_multiplexer_get(void){
 void btstack_memory_rfcomm_multiplexer_free(rfcomm_multiplexer_t *rfcomm_multiplexer){
     UNUSED(rfcomm_multiplexer);
 };
+void btstack_memory_rfcomm_multiplexer_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -322,13 +371,17 @@ typedef struct {
     rfcomm_multiplexer_t data;
 } btstack_memory_rfcomm_multiplexer_t;
 
+static btstack_memory_pool_stats_t rfcomm_multiplexer_stats;
+
 rfcomm_multiplexer_t * btstack_memory_rfcomm_multiplexer_get(void){
     btstack_memory_rfcomm_multiplexer_t * buffer = (btstack_memory_rfcomm_multiplexer_t *) malloc(sizeof(btstack_memory_rfcomm_multiplexer_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_rfcomm_multiplexer_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&rfcomm_multiplexer_stats);
         return &buffer->data;
     } else {
+        rfcomm_multiplexer_stats.num_failed++;
         return NULL;
     }
 }
@@ -336,8 +389,12 @@ void btstack_memory_rfcomm_multiplexer_free(rfcomm_multiplexer_t *rfcomm_multipl
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) rfcomm_multiplexer)[-1];
     btstack_memory_tracking_remove(buffer);
+    rfcomm_multiplexer_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_rfcomm_multiplexer_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = rfcomm_multiplexer_stats;
+}
 #endif
 
 
@@ -353,6 +410,7 @@ void btstack_memory_rfcomm_multiplexer_free(rfcomm_multiplexer_t *rfcomm_multipl
 #ifdef MAX_NR_RFCOMM_SERVICES
 #if MAX_NR_RFCOMM_SERVICES > 0
 static rfcomm_service_t rfcomm_service_storage[MAX_NR_RFCOMM_SERVICES];
+static uint32_t rfcomm_service_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_RFCOMM_SERVICES)];
 static btstack_memory_pool_t rfcomm_service_pool;
 rfcomm_service_t * btstack_memory_rfcomm_service_get(void){
     void * buffer = btstack_memory_pool_get(&rfcomm_service_pool);
@@ -364,6 +422,9 @@ rfcomm_service_t * btstack_memory_rfcomm_service_get(void){
 void btstack_memory_rfcomm_service_free(rfcomm_service_t *rfcomm_service){
     btstack_memory_pool_free(&rfcomm_service_pool, rfcomm_service);
 }
+void btstack_memory_rfcomm_service_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&rfcomm_service_pool, stats);
+}
 #else
 rfcomm_service_t * btstack_memory_rfcomm_service_get(void){
     return NULL;
@@ -371,6 +432,9 @@ rfcomm_service_t * btstack_memory_rfcomm_service_get(void){
 void btstack_memory_rfcomm_service_free(rfcomm_service_t *rfcomm_service){
     UNUSED(rfcomm_service);
 };
+void btstack_memory_rfcomm_service_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -379,13 +443,17 @@ typedef struct {
     rfcomm_service_t data;
 } btstack_memory_rfcomm_service_t;
 
+static btstack_memory_pool_stats_t rfcomm_service_stats;
+
 rfcomm_service_t * btstack_memory_rfcomm_service_get(void){
     btstack_memory_rfcomm_service_t * buffer = (btstack_memory_rfcomm_service_t *) malloc(sizeof(btstack_memory_rfcomm_service_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_rfcomm_service_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&rfcomm_service_stats);
         return &buffer->data;
     } else {
+        rfcomm_service_stats.num_failed++;
         return NULL;
     }
 }
@@ -393,8 +461,12 @@ void btstack_memory_rfcomm_service_free(rfcomm_service_t *rfcomm_service){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) rfcomm_service)[-1];
     btstack_memory_tracking_remove(buffer);
+    rfcomm_service_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_rfcomm_service_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = rfcomm_service_stats;
+}
 #endif
 
 
@@ -410,6 +482,7 @@ void btstack_memory_rfcomm_service_free(rfcomm_service_t *rfcomm_service){
 #ifdef MAX_NR_RFCOMM_CHANNELS
 #if MAX_NR_RFCOMM_CHANNELS > 0
 static rfcomm_channel_t rfcomm_channel_storage[MAX_NR_RFCOMM_CHANNELS];
+static uint32_t rfcomm_channel_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_RFCOMM_CHANNELS)];
 static btstack_memory_pool_t rfcomm_channel_pool;
 rfcomm_channel_t * btstack_memory_rfcomm_channel_get(void){
     void * buffer = btstack_memory_pool_get(&rfcomm_channel_pool);
@@ -421,6 +494,9 @@ rfcomm_channel_t * btstack_memory_rfcomm_channel_get(void){
 void btstack_memory_rfcomm_channel_free(rfcomm_channel_t *rfcomm_channel){
     btstack_memory_pool_free(&rfcomm_channel_pool, rfcomm_channel);
 }
+void btstack_memory_rfcomm_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&rfcomm_channel_pool, stats);
+}
 #else
 rfcomm_channel_t * btstack_memory_rfcomm_channel_get(void){
     return NULL;
@@ -428,6 +504,9 @@ rfcomm_channel_t * btstack_memory_rfcomm_channel_get(void){
 void btstack_memory_rfcomm_channel_free(rfcomm_channel_t *rfcomm_channel){
     UNUSED(rfcomm_channel);
 };
+void btstack_memory_rfcomm_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -436,13 +515,17 @@ typedef struct {
     rfcomm_channel_t data;
 } btstack_memory_rfcomm_channel_t;
 
+static btstack_memory_pool_stats_t rfcomm_channel_stats;
+
 rfcomm_channel_t * btstack_memory_rfcomm_channel_get(void){
     btstack_memory_rfcomm_channel_t * buffer = (btstack_memory_rfcomm_channel_t *) malloc(sizeof(btstack_memory_rfcomm_channel_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_rfcomm_channel_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&rfcomm_channel_stats);
         return &buffer->data;
     } else {
+        rfcomm_channel_stats.num_failed++;
         return NULL;
     }
 }
@@ -450,8 +533,12 @@ void btstack_memory_rfcomm_channel_free(rfcomm_channel_t *rfcomm_channel){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) rfcomm_channel)[-1];
     btstack_memory_tracking_remove(buffer);
+    rfcomm_channel_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_rfcomm_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = rfcomm_channel_stats;
+}
 #endif
 
 
@@ -468,6 +555,7 @@ void btstack_memory_rfcomm_channel_free(rfcomm_channel_t *rfcomm_channel){
 #ifdef MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES
 #if MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES > 0
 static btstack_link_key_db_memory_entry_t btstack_link_key_db_memory_entry_storage[MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES];
+static uint32_t btstack_link_key_db_memory_entry_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES)];
 static btstack_memory_pool_t btstack_link_key_db_memory_entry_pool;
 btstack_link_key_db_memory_entry_t * btstack_memory_btstack_link_key_db_memory_entry_get(void){
     void * buffer = btstack_memory_pool_get(&btstack_link_key_db_memory_entry_pool);
@@ -479,6 +567,9 @@ btstack_link_key_db_memory_entry_t * btstack_memory_btstack_link_key_db_memory_e
 void btstack_memory_btstack_link_key_db_memory_entry_free(btstack_link_key_db_memory_entry_t *btstack_link_key_db_memory_entry){
     btstack_memory_pool_free(&btstack_link_key_db_memory_entry_pool, btstack_link_key_db_memory_entry);
 }
+void btstack_memory_btstack_link_key_db_memory_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&btstack_link_key_db_memory_entry_pool, stats);
+}
 #else
 btstack_link_key_db_memory_entry_t * btstack_memory_btstack_link_key_db_memory_entry_get(void){
     return NULL;
@@ -486,6 +577,9 @@ btstack_link_key_db_memory_entry_t * btstack_memory_btstack_link_key_db_memory_e
 void btstack_memory_btstack_link_key_db_memory_entry_free(btstack_link_key_db_memory_entry_t *btstack_link_key_db_memory_entry){
     UNUSED(btstack_link_key_db_memory_entry);
 };
+void btstack_memory_btstack_link_key_db_memory_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -494,13 +588,17 @@ typedef struct {
     btstack_link_key_db_memory_entry_t data;
 } btstack_memory_btstack_link_key_db_memory_entry_t;
 
+static btstack_memory_pool_stats_t btstack_link_key_db_memory_entry_stats;
+
 btstack_link_key_db_memory_entry_t * btstack_memory_btstack_link_key_db_memory_entry_get(void){
     btstack_memory_btstack_link_key_db_memory_entry_t * buffer = (btstack_memory_btstack_link_key_db_memory_entry_t *) malloc(sizeof(btstack_memory_btstack_link_key_db_memory_entry_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_btstack_link_key_db_memory_entry_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&btstack_link_key_db_memory_entry_stats);
         return &buffer->data;
     } else {
+        btstack_link_key_db_memory_entry_stats.num_failed++;
         return NULL;
     }
 }
@@ -508,8 +606,12 @@ void btstack_memory_btstack_link_key_db_memory_entry_free(btstack_link_key_db_me
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) btstack_link_key_db_memory_entry)[-1];
     btstack_memory_tracking_remove(buffer);
+    btstack_link_key_db_memory_entry_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_btstack_link_key_db_memory_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = btstack_link_key_db_memory_entry_stats;
+}
 #endif
 
 
@@ -526,6 +628,7 @@ void btstack_memory_btstack_link_key_db_memory_entry_free(btstack_link_key_db_me
 #ifdef MAX_NR_BNEP_SERVICES
 #if MAX_NR_BNEP_SERVICES > 0
 static bnep_service_t bnep_service_storage[MAX_NR_BNEP_SERVICES];
+static uint32_t bnep_service_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_BNEP_SERVICES)];
 static btstack_memory_pool_t bnep_service_pool;
 bnep_service_t * btstack_memory_bnep_service_get(void){
     void * buffer = btstack_memory_pool_get(&bnep_service_pool);
@@ -537,6 +640,9 @@ bnep_service_t * btstack_memory_bnep_service_get(void){
 void btstack_memory_bnep_service_free(bnep_service_t *bnep_service){
     btstack_memory_pool_free(&bnep_service_pool, bnep_service);
 }
+void btstack_memory_bnep_service_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&bnep_service_pool, stats);
+}
 #else
 bnep_service_t * btstack_memory_bnep_service_get(void){
     return NULL;
@@ -544,6 +650,9 @@ bnep_service_t * btstack_memory_bnep_service_get(void){
 void btstack_memory_bnep_service_free(bnep_service_t *bnep_service){
     UNUSED(bnep_service);
 };
+void btstack_memory_bnep_service_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -552,13 +661,17 @@ typedef struct {
     bnep_service_t data;
 } btstack_memory_bnep_service_t;
 
+static btstack_memory_pool_stats_t bnep_service_stats;
+
 bnep_service_t * btstack_memory_bnep_service_get(void){
     btstack_memory_bnep_service_t * buffer = (btstack_memory_bnep_service_t *) malloc(sizeof(btstack_memory_bnep_service_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_bnep_service_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&bnep_service_stats);
         return &buffer->data;
     } else {
+        bnep_service_stats.num_failed++;
         return NULL;
     }
 }
@@ -566,8 +679,12 @@ void btstack_memory_bnep_service_free(bnep_service_t *bnep_service){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) bnep_service)[-1];
     btstack_memory_tracking_remove(buffer);
+    bnep_service_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_bnep_service_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = bnep_service_stats;
+}
 #endif
 
 
@@ -583,6 +700,7 @@ void btstack_memory_bnep_service_free(bnep_service_t *bnep_service){
 #ifdef MAX_NR_BNEP_CHANNELS
 #if MAX_NR_BNEP_CHANNELS > 0
 static bnep_channel_t bnep_channel_storage[MAX_NR_BNEP_CHANNELS];
+static uint32_t bnep_channel_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_BNEP_CHANNELS)];
 static btstack_memory_pool_t bnep_channel_pool;
 bnep_channel_t * btstack_memory_bnep_channel_get(void){
     void * buffer = btstack_memory_pool_get(&bnep_channel_pool);
@@ -594,6 +712,9 @@ bnep_channel_t * btstack_memory_bnep_channel_get(void){
 void btstack_memory_bnep_channel_free(bnep_channel_t *bnep_channel){
     btstack_memory_pool_free(&bnep_channel_pool, bnep_channel);
 }
+void btstack_memory_bnep_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&bnep_channel_pool, stats);
+}
 #else
 bnep_channel_t * btstack_memory_bnep_channel_get(void){
     return NULL;
@@ -601,6 +722,9 @@ bnep_channel_t * btstack_memory_bnep_channel_get(void){
 void btstack_memory_bnep_channel_free(bnep_channel_t *bnep_channel){
     UNUSED(bnep_channel);
 };
+void btstack_memory_bnep_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -609,13 +733,17 @@ typedef struct {
     bnep_channel_t data;
 } btstack_memory_bnep_channel_t;
 
+static btstack_memory_pool_stats_t bnep_channel_stats;
+
 bnep_channel_t * btstack_memory_bnep_channel_get(void){
     btstack_memory_bnep_channel_t * buffer = (btstack_memory_bnep_channel_t *) malloc(sizeof(btstack_memory_bnep_channel_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_bnep_channel_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&bnep_channel_stats);
         return &buffer->data;
     } else {
+        bnep_channel_stats.num_failed++;
         return NULL;
     }
 }
@@ -623,8 +751,12 @@ void btstack_memory_bnep_channel_free(bnep_channel_t *bnep_channel){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) bnep_channel)[-1];
     btstack_memory_tracking_remove(buffer);
+    bnep_channel_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_bnep_channel_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = bnep_channel_stats;
+}
 #endif
 
 
@@ -641,6 +773,7 @@ void btstack_memory_bnep_channel_free(bnep_channel_t *bnep_channel){
 #ifdef MAX_NR_HFP_CONNECTIONS
 #if MAX_NR_HFP_CONNECTIONS > 0
 static hfp_connection_t hfp_connection_storage[MAX_NR_HFP_CONNECTIONS];
+static uint32_t hfp_connection_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_HFP_CONNECTIONS)];
 static btstack_memory_pool_t hfp_connection_pool;
 hfp_connection_t * btstack_memory_hfp_connection_get(void){
     void * buffer = btstack_memory_pool_get(&hfp_connection_pool);
@@ -652,6 +785,9 @@ hfp_connection_t * btstack_memory_hfp_connection_get(void){
 void btstack_memory_hfp_connection_free(hfp_connection_t *hfp_connection){
     btstack_memory_pool_free(&hfp_connection_pool, hfp_connection);
 }
+void btstack_memory_hfp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&hfp_connection_pool, stats);
+}
 #else
 hfp_connection_t * btstack_memory_hfp_connection_get(void){
     return NULL;
@@ -659,6 +795,9 @@ hfp_connection_t * btstack_memory_hfp_connection_get(void){
 void btstack_memory_hfp_connection_free(hfp_connection_t *hfp_connection){
     UNUSED(hfp_connection);
 };
+void btstack_memory_hfp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -667,13 +806,17 @@ typedef struct {
     hfp_connection_t data;
 } btstack_memory_hfp_connection_t;
 
+static btstack_memory_pool_stats_t hfp_connection_stats;
+
 hfp_connection_t * btstack_memory_hfp_connection_get(void){
     btstack_memory_hfp_connection_t * buffer = (btstack_memory_hfp_connection_t *) malloc(sizeof(btstack_memory_hfp_connection_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_hfp_connection_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&hfp_connection_stats);
         return &buffer->data;
     } else {
+        hfp_connection_stats.num_failed++;
         return NULL;
     }
 }
@@ -681,8 +824,12 @@ void btstack_memory_hfp_connection_free(hfp_connection_t *hfp_connection){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) hfp_connection)[-1];
     btstack_memory_tracking_remove(buffer);
+    hfp_connection_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_hfp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = hfp_connection_stats;
+}
 #endif
 
 
@@ -699,6 +846,7 @@ void btstack_memory_hfp_connection_free(hfp_connection_t *hfp_connection){
 #ifdef MAX_NR_HID_HOST_CONNECTIONS
 #if MAX_NR_HID_HOST_CONNECTIONS > 0
 static hid_host_connection_t hid_host_connection_storage[MAX_NR_HID_HOST_CONNECTIONS];
+static uint32_t hid_host_connection_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_HID_HOST_CONNECTIONS)];
 static btstack_memory_pool_t hid_host_connection_pool;
 hid_host_connection_t * btstack_memory_hid_host_connection_get(void){
     void * buffer = btstack_memory_pool_get(&hid_host_connection_pool);
@@ -710,25 +858,50 @@ hid_host_connection_t * btstack_memory_hid_host_connection_get(void){
 void btstack_memory_hid_host_connection_free(hid_host_connection_t *hid_host_connection){
     btstack_memory_pool_free(&hid_host_connection_pool, hid_host_connection);
 }
+void btstack_memory_hid_host_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&hid_host_connection_pool, stats);
+}
 #else
 hid_host_connection_t * btstack_memory_hid_host_connection_get(void){
     return NULL;
 }
 void btstack_memory_hid_host_connection_free(hid_host_connection_t *hid_host_connection){
-    // silence compiler warning about unused parameter in a portable way
-    (void) hid_host_connection;
+    UNUSED(hid_host_connection);
 };
+void btstack_memory_hid_host_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
+
+typedef struct {
+    btstack_memory_buffer_t tracking;
+    hid_host_connection_t data;
+} btstack_memory_hid_host_connection_t;
+
+static btstack_memory_pool_stats_t hid_host_connection_stats;
+
 hid_host_connection_t * btstack_memory_hid_host_connection_get(void){
-    void * buffer = malloc(sizeof(hid_host_connection_t));
+    btstack_memory_hid_host_connection_t * buffer = (btstack_memory_hid_host_connection_t *) malloc(sizeof(btstack_memory_hid_host_connection_t));
     if (buffer){
-        memset(buffer, 0, sizeof(hid_host_connection_t));
+        memset(buffer, 0, sizeof(btstack_memory_hid_host_connection_t));
+        btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&hid_host_connection_stats);
+        return &buffer->data;
+    } else {
+        hid_host_connection_stats.num_failed++;
+        return NULL;
     }
-    return (hid_host_connection_t *) buffer;
 }
 void btstack_memory_hid_host_connection_free(hid_host_connection_t *hid_host_connection){
-    free(hid_host_connection);
+    // reconstruct buffer start
+    btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) hid_host_connection)[-1];
+    btstack_memory_tracking_remove(buffer);
+    hid_host_connection_stats.in_use--;
+    free(buffer);
+}
+void btstack_memory_hid_host_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = hid_host_connection_stats;
 }
 #endif
 
@@ -746,6 +919,7 @@ void btstack_memory_hid_host_connection_free(hid_host_connection_t *hid_host_con
 #ifdef MAX_NR_SERVICE_RECORD_ITEMS
 #if MAX_NR_SERVICE_RECORD_ITEMS > 0
 static service_record_item_t service_record_item_storage[MAX_NR_SERVICE_RECORD_ITEMS];
+static uint32_t service_record_item_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_SERVICE_RECORD_ITEMS)];
 static btstack_memory_pool_t service_record_item_pool;
 service_record_item_t * btstack_memory_service_record_item_get(void){
     void * buffer = btstack_memory_pool_get(&service_record_item_pool);
@@ -757,6 +931,9 @@ service_record_item_t * btstack_memory_service_record_item_get(void){
 void btstack_memory_service_record_item_free(service_record_item_t *service_record_item){
     btstack_memory_pool_free(&service_record_item_pool, service_record_item);
 }
+void btstack_memory_service_record_item_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&service_record_item_pool, stats);
+}
 #else
 service_record_item_t * btstack_memory_service_record_item_get(void){
     return NULL;
@@ -764,6 +941,9 @@ service_record_item_t * btstack_memory_service_record_item_get(void){
 void btstack_memory_service_record_item_free(service_record_item_t *service_record_item){
     UNUSED(service_record_item);
 };
+void btstack_memory_service_record_item_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -772,13 +952,17 @@ typedef struct {
     service_record_item_t data;
 } btstack_memory_service_record_item_t;
 
+static btstack_memory_pool_stats_t service_record_item_stats;
+
 service_record_item_t * btstack_memory_service_record_item_get(void){
     btstack_memory_service_record_item_t * buffer = (btstack_memory_service_record_item_t *) malloc(sizeof(btstack_memory_service_record_item_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_service_record_item_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&service_record_item_stats);
         return &buffer->data;
     } else {
+        service_record_item_stats.num_failed++;
         return NULL;
     }
 }
@@ -786,8 +970,12 @@ void btstack_memory_service_record_item_free(service_record_item_t *service_reco
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) service_record_item)[-1];
     btstack_memory_tracking_remove(buffer);
+    service_record_item_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_service_record_item_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = service_record_item_stats;
+}
 #endif
 
 
@@ -804,6 +992,7 @@ void btstack_memory_service_record_item_free(service_record_item_t *service_reco
 #ifdef MAX_NR_AVDTP_STREAM_ENDPOINTS
 #if MAX_NR_AVDTP_STREAM_ENDPOINTS > 0
 static avdtp_stream_endpoint_t avdtp_stream_endpoint_storage[MAX_NR_AVDTP_STREAM_ENDPOINTS];
+static uint32_t avdtp_stream_endpoint_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_AVDTP_STREAM_ENDPOINTS)];
 static btstack_memory_pool_t avdtp_stream_endpoint_pool;
 avdtp_stream_endpoint_t * btstack_memory_avdtp_stream_endpoint_get(void){
     void * buffer = btstack_memory_pool_get(&avdtp_stream_endpoint_pool);
@@ -815,6 +1004,9 @@ avdtp_stream_endpoint_t * btstack_memory_avdtp_stream_endpoint_get(void){
 void btstack_memory_avdtp_stream_endpoint_free(avdtp_stream_endpoint_t *avdtp_stream_endpoint){
     btstack_memory_pool_free(&avdtp_stream_endpoint_pool, avdtp_stream_endpoint);
 }
+void btstack_memory_avdtp_stream_endpoint_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&avdtp_stream_endpoint_pool, stats);
+}
 #else
 avdtp_stream_endpoint_t * btstack_memory_avdtp_stream_endpoint_get(void){
     return NULL;
@@ -822,6 +1014,9 @@ avdtp_stream_endpoint_t * btstack_memory_avdtp_stream_endpoint_get(void){
 void btstack_memory_avdtp_stream_endpoint_free(avdtp_stream_endpoint_t *avdtp_stream_endpoint){
     UNUSED(avdtp_stream_endpoint);
 };
+void btstack_memory_avdtp_stream_endpoint_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -830,13 +1025,17 @@ typedef struct {
     avdtp_stream_endpoint_t data;
 } btstack_memory_avdtp_stream_endpoint_t;
 
+static btstack_memory_pool_stats_t avdtp_stream_endpoint_stats;
+
 avdtp_stream_endpoint_t * btstack_memory_avdtp_stream_endpoint_get(void){
     btstack_memory_avdtp_stream_endpoint_t * buffer = (btstack_memory_avdtp_stream_endpoint_t *) malloc(sizeof(btstack_memory_avdtp_stream_endpoint_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_avdtp_stream_endpoint_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&avdtp_stream_endpoint_stats);
         return &buffer->data;
     } else {
+        avdtp_stream_endpoint_stats.num_failed++;
         return NULL;
     }
 }
@@ -844,8 +1043,12 @@ void btstack_memory_avdtp_stream_endpoint_free(avdtp_stream_endpoint_t *avdtp_st
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) avdtp_stream_endpoint)[-1];
     btstack_memory_tracking_remove(buffer);
+    avdtp_stream_endpoint_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_avdtp_stream_endpoint_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = avdtp_stream_endpoint_stats;
+}
 #endif
 
 
@@ -862,6 +1065,7 @@ void btstack_memory_avdtp_stream_endpoint_free(avdtp_stream_endpoint_t *avdtp_st
 #ifdef MAX_NR_AVDTP_CONNECTIONS
 #if MAX_NR_AVDTP_CONNECTIONS > 0
 static avdtp_connection_t avdtp_connection_storage[MAX_NR_AVDTP_CONNECTIONS];
+static uint32_t avdtp_connection_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_AVDTP_CONNECTIONS)];
 static btstack_memory_pool_t avdtp_connection_pool;
 avdtp_connection_t * btstack_memory_avdtp_connection_get(void){
     void * buffer = btstack_memory_pool_get(&avdtp_connection_pool);
@@ -873,6 +1077,9 @@ avdtp_connection_t * btstack_memory_avdtp_connection_get(void){
 void btstack_memory_avdtp_connection_free(avdtp_connection_t *avdtp_connection){
     btstack_memory_pool_free(&avdtp_connection_pool, avdtp_connection);
 }
+void btstack_memory_avdtp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&avdtp_connection_pool, stats);
+}
 #else
 avdtp_connection_t * btstack_memory_avdtp_connection_get(void){
     return NULL;
@@ -880,6 +1087,9 @@ avdtp_connection_t * btstack_memory_avdtp_connection_get(void){
 void btstack_memory_avdtp_connection_free(avdtp_connection_t *avdtp_connection){
     UNUSED(avdtp_connection);
 };
+void btstack_memory_avdtp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -888,13 +1098,17 @@ typedef struct {
     avdtp_connection_t data;
 } btstack_memory_avdtp_connection_t;
 
+static btstack_memory_pool_stats_t avdtp_connection_stats;
+
 avdtp_connection_t * btstack_memory_avdtp_connection_get(void){
     btstack_memory_avdtp_connection_t * buffer = (btstack_memory_avdtp_connection_t *) malloc(sizeof(btstack_memory_avdtp_connection_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_avdtp_connection_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&avdtp_connection_stats);
         return &buffer->data;
     } else {
+        avdtp_connection_stats.num_failed++;
         return NULL;
     }
 }
@@ -902,8 +1116,12 @@ void btstack_memory_avdtp_connection_free(avdtp_connection_t *avdtp_connection){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) avdtp_connection)[-1];
     btstack_memory_tracking_remove(buffer);
+    avdtp_connection_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_avdtp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = avdtp_connection_stats;
+}
 #endif
 
 
@@ -920,6 +1138,7 @@ void btstack_memory_avdtp_connection_free(avdtp_connection_t *avdtp_connection){
 #ifdef MAX_NR_AVRCP_CONNECTIONS
 #if MAX_NR_AVRCP_CONNECTIONS > 0
 static avrcp_connection_t avrcp_connection_storage[MAX_NR_AVRCP_CONNECTIONS];
+static uint32_t avrcp_connection_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_AVRCP_CONNECTIONS)];
 static btstack_memory_pool_t avrcp_connection_pool;
 avrcp_connection_t * btstack_memory_avrcp_connection_get(void){
     void * buffer = btstack_memory_pool_get(&avrcp_connection_pool);
@@ -931,6 +1150,9 @@ avrcp_connection_t * btstack_memory_avrcp_connection_get(void){
 void btstack_memory_avrcp_connection_free(avrcp_connection_t *avrcp_connection){
     btstack_memory_pool_free(&avrcp_connection_pool, avrcp_connection);
 }
+void btstack_memory_avrcp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&avrcp_connection_pool, stats);
+}
 #else
 avrcp_connection_t * btstack_memory_avrcp_connection_get(void){
     return NULL;
@@ -938,6 +1160,9 @@ avrcp_connection_t * btstack_memory_avrcp_connection_get(void){
 void btstack_memory_avrcp_connection_free(avrcp_connection_t *avrcp_connection){
     UNUSED(avrcp_connection);
 };
+void btstack_memory_avrcp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -946,13 +1171,17 @@ typedef struct {
     avrcp_connection_t data;
 } btstack_memory_avrcp_connection_t;
 
+static btstack_memory_pool_stats_t avrcp_connection_stats;
+
 avrcp_connection_t * btstack_memory_avrcp_connection_get(void){
     btstack_memory_avrcp_connection_t * buffer = (btstack_memory_avrcp_connection_t *) malloc(sizeof(btstack_memory_avrcp_connection_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_avrcp_connection_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&avrcp_connection_stats);
         return &buffer->data;
     } else {
+        avrcp_connection_stats.num_failed++;
         return NULL;
     }
 }
@@ -960,8 +1189,12 @@ void btstack_memory_avrcp_connection_free(avrcp_connection_t *avrcp_connection){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) avrcp_connection)[-1];
     btstack_memory_tracking_remove(buffer);
+    avrcp_connection_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_avrcp_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = avrcp_connection_stats;
+}
 #endif
 
 
@@ -978,6 +1211,7 @@ void btstack_memory_avrcp_connection_free(avrcp_connection_t *avrcp_connection){
 #ifdef MAX_NR_AVRCP_BROWSING_CONNECTIONS
 #if MAX_NR_AVRCP_BROWSING_CONNECTIONS > 0
 static avrcp_browsing_connection_t avrcp_browsing_connection_storage[MAX_NR_AVRCP_BROWSING_CONNECTIONS];
+static uint32_t avrcp_browsing_connection_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_AVRCP_BROWSING_CONNECTIONS)];
 static btstack_memory_pool_t avrcp_browsing_connection_pool;
 avrcp_browsing_connection_t * btstack_memory_avrcp_browsing_connection_get(void){
     void * buffer = btstack_memory_pool_get(&avrcp_browsing_connection_pool);
@@ -989,6 +1223,9 @@ avrcp_browsing_connection_t * btstack_memory_avrcp_browsing_connection_get(void)
 void btstack_memory_avrcp_browsing_connection_free(avrcp_browsing_connection_t *avrcp_browsing_connection){
     btstack_memory_pool_free(&avrcp_browsing_connection_pool, avrcp_browsing_connection);
 }
+void btstack_memory_avrcp_browsing_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&avrcp_browsing_connection_pool, stats);
+}
 #else
 avrcp_browsing_connection_t * btstack_memory_avrcp_browsing_connection_get(void){
     return NULL;
@@ -996,6 +1233,9 @@ avrcp_browsing_connection_t * btstack_memory_avrcp_browsing_connection_get(void)
 void btstack_memory_avrcp_browsing_connection_free(avrcp_browsing_connection_t *avrcp_browsing_connection){
     UNUSED(avrcp_browsing_connection);
 };
+void btstack_memory_avrcp_browsing_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1004,13 +1244,17 @@ typedef struct {
     avrcp_browsing_connection_t data;
 } btstack_memory_avrcp_browsing_connection_t;
 
+static btstack_memory_pool_stats_t avrcp_browsing_connection_stats;
+
 avrcp_browsing_connection_t * btstack_memory_avrcp_browsing_connection_get(void){
     btstack_memory_avrcp_browsing_connection_t * buffer = (btstack_memory_avrcp_browsing_connection_t *) malloc(sizeof(btstack_memory_avrcp_browsing_connection_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_avrcp_browsing_connection_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&avrcp_browsing_connection_stats);
         return &buffer->data;
     } else {
+        avrcp_browsing_connection_stats.num_failed++;
         return NULL;
     }
 }
@@ -1018,8 +1262,12 @@ void btstack_memory_avrcp_browsing_connection_free(avrcp_browsing_connection_t *
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) avrcp_browsing_connection)[-1];
     btstack_memory_tracking_remove(buffer);
+    avrcp_browsing_connection_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_avrcp_browsing_connection_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = avrcp_browsing_connection_stats;
+}
 #endif
 
 
@@ -1038,6 +1286,7 @@ void btstack_memory_avrcp_browsing_connection_free(avrcp_browsing_connection_t *
 #ifdef MAX_NR_GATT_CLIENTS
 #if MAX_NR_GATT_CLIENTS > 0
 static gatt_client_t gatt_client_storage[MAX_NR_GATT_CLIENTS];
+static uint32_t gatt_client_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_GATT_CLIENTS)];
 static btstack_memory_pool_t gatt_client_pool;
 gatt_client_t * btstack_memory_gatt_client_get(void){
     void * buffer = btstack_memory_pool_get(&gatt_client_pool);
@@ -1049,6 +1298,9 @@ gatt_client_t * btstack_memory_gatt_client_get(void){
 void btstack_memory_gatt_client_free(gatt_client_t *gatt_client){
     btstack_memory_pool_free(&gatt_client_pool, gatt_client);
 }
+void btstack_memory_gatt_client_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&gatt_client_pool, stats);
+}
 #else
 gatt_client_t * btstack_memory_gatt_client_get(void){
     return NULL;
@@ -1056,6 +1308,9 @@ gatt_client_t * btstack_memory_gatt_client_get(void){
 void btstack_memory_gatt_client_free(gatt_client_t *gatt_client){
     UNUSED(gatt_client);
 };
+void btstack_memory_gatt_client_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1064,13 +1319,17 @@ typedef struct {
     gatt_client_t data;
 } btstack_memory_gatt_client_t;
 
+static btstack_memory_pool_stats_t gatt_client_stats;
+
 gatt_client_t * btstack_memory_gatt_client_get(void){
     btstack_memory_gatt_client_t * buffer = (btstack_memory_gatt_client_t *) malloc(sizeof(btstack_memory_gatt_client_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_gatt_client_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&gatt_client_stats);
         return &buffer->data;
     } else {
+        gatt_client_stats.num_failed++;
         return NULL;
     }
 }
@@ -1078,8 +1337,12 @@ void btstack_memory_gatt_client_free(gatt_client_t *gatt_client){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) gatt_client)[-1];
     btstack_memory_tracking_remove(buffer);
+    gatt_client_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_gatt_client_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = gatt_client_stats;
+}
 #endif
 
 
@@ -1095,6 +1358,7 @@ void btstack_memory_gatt_client_free(gatt_client_t *gatt_client){
 #ifdef MAX_NR_WHITELIST_ENTRIES
 #if MAX_NR_WHITELIST_ENTRIES > 0
 static whitelist_entry_t whitelist_entry_storage[MAX_NR_WHITELIST_ENTRIES];
+static uint32_t whitelist_entry_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_WHITELIST_ENTRIES)];
 static btstack_memory_pool_t whitelist_entry_pool;
 whitelist_entry_t * btstack_memory_whitelist_entry_get(void){
     void * buffer = btstack_memory_pool_get(&whitelist_entry_pool);
@@ -1106,6 +1370,9 @@ whitelist_entry_t * btstack_memory_whitelist_entry_get(void){
 void btstack_memory_whitelist_entry_free(whitelist_entry_t *whitelist_entry){
     btstack_memory_pool_free(&whitelist_entry_pool, whitelist_entry);
 }
+void btstack_memory_whitelist_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&whitelist_entry_pool, stats);
+}
 #else
 whitelist_entry_t * btstack_memory_whitelist_entry_get(void){
     return NULL;
@@ -1113,6 +1380,9 @@ whitelist_entry_t * btstack_memory_whitelist_entry_get(void){
 void btstack_memory_whitelist_entry_free(whitelist_entry_t *whitelist_entry){
     UNUSED(whitelist_entry);
 };
+void btstack_memory_whitelist_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1121,13 +1391,17 @@ typedef struct {
     whitelist_entry_t data;
 } btstack_memory_whitelist_entry_t;
 
+static btstack_memory_pool_stats_t whitelist_entry_stats;
+
 whitelist_entry_t * btstack_memory_whitelist_entry_get(void){
     btstack_memory_whitelist_entry_t * buffer = (btstack_memory_whitelist_entry_t *) malloc(sizeof(btstack_memory_whitelist_entry_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_whitelist_entry_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&whitelist_entry_stats);
         return &buffer->data;
     } else {
+        whitelist_entry_stats.num_failed++;
         return NULL;
     }
 }
@@ -1135,8 +1409,12 @@ void btstack_memory_whitelist_entry_free(whitelist_entry_t *whitelist_entry){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) whitelist_entry)[-1];
     btstack_memory_tracking_remove(buffer);
+    whitelist_entry_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_whitelist_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = whitelist_entry_stats;
+}
 #endif
 
 
@@ -1152,6 +1430,7 @@ void btstack_memory_whitelist_entry_free(whitelist_entry_t *whitelist_entry){
 #ifdef MAX_NR_SM_LOOKUP_ENTRIES
 #if MAX_NR_SM_LOOKUP_ENTRIES > 0
 static sm_lookup_entry_t sm_lookup_entry_storage[MAX_NR_SM_LOOKUP_ENTRIES];
+static uint32_t sm_lookup_entry_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_SM_LOOKUP_ENTRIES)];
 static btstack_memory_pool_t sm_lookup_entry_pool;
 sm_lookup_entry_t * btstack_memory_sm_lookup_entry_get(void){
     void * buffer = btstack_memory_pool_get(&sm_lookup_entry_pool);
@@ -1163,6 +1442,9 @@ sm_lookup_entry_t * btstack_memory_sm_lookup_entry_get(void){
 void btstack_memory_sm_lookup_entry_free(sm_lookup_entry_t *sm_lookup_entry){
     btstack_memory_pool_free(&sm_lookup_entry_pool, sm_lookup_entry);
 }
+void btstack_memory_sm_lookup_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&sm_lookup_entry_pool, stats);
+}
 #else
 sm_lookup_entry_t * btstack_memory_sm_lookup_entry_get(void){
     return NULL;
@@ -1170,6 +1452,9 @@ sm_lookup_entry_t * btstack_memory_sm_lookup_entry_get(void){
 void btstack_memory_sm_lookup_entry_free(sm_lookup_entry_t *sm_lookup_entry){
     UNUSED(sm_lookup_entry);
 };
+void btstack_memory_sm_lookup_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1178,13 +1463,17 @@ typedef struct {
     sm_lookup_entry_t data;
 } btstack_memory_sm_lookup_entry_t;
 
+static btstack_memory_pool_stats_t sm_lookup_entry_stats;
+
 sm_lookup_entry_t * btstack_memory_sm_lookup_entry_get(void){
     btstack_memory_sm_lookup_entry_t * buffer = (btstack_memory_sm_lookup_entry_t *) malloc(sizeof(btstack_memory_sm_lookup_entry_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_sm_lookup_entry_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&sm_lookup_entry_stats);
         return &buffer->data;
     } else {
+        sm_lookup_entry_stats.num_failed++;
         return NULL;
     }
 }
@@ -1192,8 +1481,12 @@ void btstack_memory_sm_lookup_entry_free(sm_lookup_entry_t *sm_lookup_entry){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) sm_lookup_entry)[-1];
     btstack_memory_tracking_remove(buffer);
+    sm_lookup_entry_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_sm_lookup_entry_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = sm_lookup_entry_stats;
+}
 #endif
 
 
@@ -1212,6 +1505,7 @@ void btstack_memory_sm_lookup_entry_free(sm_lookup_entry_t *sm_lookup_entry){
 #ifdef MAX_NR_MESH_NETWORK_PDUS
 #if MAX_NR_MESH_NETWORK_PDUS > 0
 static mesh_network_pdu_t mesh_network_pdu_storage[MAX_NR_MESH_NETWORK_PDUS];
+static uint32_t mesh_network_pdu_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_MESH_NETWORK_PDUS)];
 static btstack_memory_pool_t mesh_network_pdu_pool;
 mesh_network_pdu_t * btstack_memory_mesh_network_pdu_get(void){
     void * buffer = btstack_memory_pool_get(&mesh_network_pdu_pool);
@@ -1223,6 +1517,9 @@ mesh_network_pdu_t * btstack_memory_mesh_network_pdu_get(void){
 void btstack_memory_mesh_network_pdu_free(mesh_network_pdu_t *mesh_network_pdu){
     btstack_memory_pool_free(&mesh_network_pdu_pool, mesh_network_pdu);
 }
+void btstack_memory_mesh_network_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&mesh_network_pdu_pool, stats);
+}
 #else
 mesh_network_pdu_t * btstack_memory_mesh_network_pdu_get(void){
     return NULL;
@@ -1230,6 +1527,9 @@ mesh_network_pdu_t * btstack_memory_mesh_network_pdu_get(void){
 void btstack_memory_mesh_network_pdu_free(mesh_network_pdu_t *mesh_network_pdu){
     UNUSED(mesh_network_pdu);
 };
+void btstack_memory_mesh_network_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1238,13 +1538,17 @@ typedef struct {
     mesh_network_pdu_t data;
 } btstack_memory_mesh_network_pdu_t;
 
+static btstack_memory_pool_stats_t mesh_network_pdu_stats;
+
 mesh_network_pdu_t * btstack_memory_mesh_network_pdu_get(void){
     btstack_memory_mesh_network_pdu_t * buffer = (btstack_memory_mesh_network_pdu_t *) malloc(sizeof(btstack_memory_mesh_network_pdu_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_mesh_network_pdu_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&mesh_network_pdu_stats);
         return &buffer->data;
     } else {
+        mesh_network_pdu_stats.num_failed++;
         return NULL;
     }
 }
@@ -1252,8 +1556,12 @@ void btstack_memory_mesh_network_pdu_free(mesh_network_pdu_t *mesh_network_pdu){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) mesh_network_pdu)[-1];
     btstack_memory_tracking_remove(buffer);
+    mesh_network_pdu_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_mesh_network_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = mesh_network_pdu_stats;
+}
 #endif
 
 
@@ -1269,6 +1577,7 @@ void btstack_memory_mesh_network_pdu_free(mesh_network_pdu_t *mesh_network_pdu){
 #ifdef MAX_NR_MESH_SEGMENTED_PDUS
 #if MAX_NR_MESH_SEGMENTED_PDUS > 0
 static mesh_segmented_pdu_t mesh_segmented_pdu_storage[MAX_NR_MESH_SEGMENTED_PDUS];
+static uint32_t mesh_segmented_pdu_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_MESH_SEGMENTED_PDUS)];
 static btstack_memory_pool_t mesh_segmented_pdu_pool;
 mesh_segmented_pdu_t * btstack_memory_mesh_segmented_pdu_get(void){
     void * buffer = btstack_memory_pool_get(&mesh_segmented_pdu_pool);
@@ -1280,6 +1589,9 @@ mesh_segmented_pdu_t * btstack_memory_mesh_segmented_pdu_get(void){
 void btstack_memory_mesh_segmented_pdu_free(mesh_segmented_pdu_t *mesh_segmented_pdu){
     btstack_memory_pool_free(&mesh_segmented_pdu_pool, mesh_segmented_pdu);
 }
+void btstack_memory_mesh_segmented_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&mesh_segmented_pdu_pool, stats);
+}
 #else
 mesh_segmented_pdu_t * btstack_memory_mesh_segmented_pdu_get(void){
     return NULL;
@@ -1287,6 +1599,9 @@ mesh_segmented_pdu_t * btstack_memory_mesh_segmented_pdu_get(void){
 void btstack_memory_mesh_segmented_pdu_free(mesh_segmented_pdu_t *mesh_segmented_pdu){
     UNUSED(mesh_segmented_pdu);
 };
+void btstack_memory_mesh_segmented_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1295,13 +1610,17 @@ typedef struct {
     mesh_segmented_pdu_t data;
 } btstack_memory_mesh_segmented_pdu_t;
 
+static btstack_memory_pool_stats_t mesh_segmented_pdu_stats;
+
 mesh_segmented_pdu_t * btstack_memory_mesh_segmented_pdu_get(void){
     btstack_memory_mesh_segmented_pdu_t * buffer = (btstack_memory_mesh_segmented_pdu_t *) malloc(sizeof(btstack_memory_mesh_segmented_pdu_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_mesh_segmented_pdu_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&mesh_segmented_pdu_stats);
         return &buffer->data;
     } else {
+        mesh_segmented_pdu_stats.num_failed++;
         return NULL;
     }
 }
@@ -1309,8 +1628,12 @@ void btstack_memory_mesh_segmented_pdu_free(mesh_segmented_pdu_t *mesh_segmented
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) mesh_segmented_pdu)[-1];
     btstack_memory_tracking_remove(buffer);
+    mesh_segmented_pdu_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_mesh_segmented_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = mesh_segmented_pdu_stats;
+}
 #endif
 
 
@@ -1326,6 +1649,7 @@ void btstack_memory_mesh_segmented_pdu_free(mesh_segmented_pdu_t *mesh_segmented
 #ifdef MAX_NR_MESH_UPPER_TRANSPORT_PDUS
 #if MAX_NR_MESH_UPPER_TRANSPORT_PDUS > 0
 static mesh_upper_transport_pdu_t mesh_upper_transport_pdu_storage[MAX_NR_MESH_UPPER_TRANSPORT_PDUS];
+static uint32_t mesh_upper_transport_pdu_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_MESH_UPPER_TRANSPORT_PDUS)];
 static btstack_memory_pool_t mesh_upper_transport_pdu_pool;
 mesh_upper_transport_pdu_t * btstack_memory_mesh_upper_transport_pdu_get(void){
     void * buffer = btstack_memory_pool_get(&mesh_upper_transport_pdu_pool);
@@ -1337,6 +1661,9 @@ mesh_upper_transport_pdu_t * btstack_memory_mesh_upper_transport_pdu_get(void){
 void btstack_memory_mesh_upper_transport_pdu_free(mesh_upper_transport_pdu_t *mesh_upper_transport_pdu){
     btstack_memory_pool_free(&mesh_upper_transport_pdu_pool, mesh_upper_transport_pdu);
 }
+void btstack_memory_mesh_upper_transport_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&mesh_upper_transport_pdu_pool, stats);
+}
 #else
 mesh_upper_transport_pdu_t * btstack_memory_mesh_upper_transport_pdu_get(void){
     return NULL;
@@ -1344,6 +1671,9 @@ mesh_upper_transport_pdu_t * btstack_memory_mesh_upper_transport_pdu_get(void){
 void btstack_memory_mesh_upper_transport_pdu_free(mesh_upper_transport_pdu_t *mesh_upper_transport_pdu){
     UNUSED(mesh_upper_transport_pdu);
 };
+void btstack_memory_mesh_upper_transport_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1352,13 +1682,17 @@ typedef struct {
     mesh_upper_transport_pdu_t data;
 } btstack_memory_mesh_upper_transport_pdu_t;
 
+static btstack_memory_pool_stats_t mesh_upper_transport_pdu_stats;
+
 mesh_upper_transport_pdu_t * btstack_memory_mesh_upper_transport_pdu_get(void){
     btstack_memory_mesh_upper_transport_pdu_t * buffer = (btstack_memory_mesh_upper_transport_pdu_t *) malloc(sizeof(btstack_memory_mesh_upper_transport_pdu_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_mesh_upper_transport_pdu_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&mesh_upper_transport_pdu_stats);
         return &buffer->data;
     } else {
+        mesh_upper_transport_pdu_stats.num_failed++;
         return NULL;
     }
 }
@@ -1366,8 +1700,12 @@ void btstack_memory_mesh_upper_transport_pdu_free(mesh_upper_transport_pdu_t *me
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) mesh_upper_transport_pdu)[-1];
     btstack_memory_tracking_remove(buffer);
+    mesh_upper_transport_pdu_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_mesh_upper_transport_pdu_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = mesh_upper_transport_pdu_stats;
+}
 #endif
 
 
@@ -1383,6 +1721,7 @@ void btstack_memory_mesh_upper_transport_pdu_free(mesh_upper_transport_pdu_t *me
 #ifdef MAX_NR_MESH_NETWORK_KEYS
 #if MAX_NR_MESH_NETWORK_KEYS > 0
 static mesh_network_key_t mesh_network_key_storage[MAX_NR_MESH_NETWORK_KEYS];
+static uint32_t mesh_network_key_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_MESH_NETWORK_KEYS)];
 static btstack_memory_pool_t mesh_network_key_pool;
 mesh_network_key_t * btstack_memory_mesh_network_key_get(void){
     void * buffer = btstack_memory_pool_get(&mesh_network_key_pool);
@@ -1394,6 +1733,9 @@ mesh_network_key_t * btstack_memory_mesh_network_key_get(void){
 void btstack_memory_mesh_network_key_free(mesh_network_key_t *mesh_network_key){
     btstack_memory_pool_free(&mesh_network_key_pool, mesh_network_key);
 }
+void btstack_memory_mesh_network_key_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&mesh_network_key_pool, stats);
+}
 #else
 mesh_network_key_t * btstack_memory_mesh_network_key_get(void){
     return NULL;
@@ -1401,6 +1743,9 @@ mesh_network_key_t * btstack_memory_mesh_network_key_get(void){
 void btstack_memory_mesh_network_key_free(mesh_network_key_t *mesh_network_key){
     UNUSED(mesh_network_key);
 };
+void btstack_memory_mesh_network_key_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1409,13 +1754,17 @@ typedef struct {
     mesh_network_key_t data;
 } btstack_memory_mesh_network_key_t;
 
+static btstack_memory_pool_stats_t mesh_network_key_stats;
+
 mesh_network_key_t * btstack_memory_mesh_network_key_get(void){
     btstack_memory_mesh_network_key_t * buffer = (btstack_memory_mesh_network_key_t *) malloc(sizeof(btstack_memory_mesh_network_key_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_mesh_network_key_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&mesh_network_key_stats);
         return &buffer->data;
     } else {
+        mesh_network_key_stats.num_failed++;
         return NULL;
     }
 }
@@ -1423,8 +1772,12 @@ void btstack_memory_mesh_network_key_free(mesh_network_key_t *mesh_network_key){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) mesh_network_key)[-1];
     btstack_memory_tracking_remove(buffer);
+    mesh_network_key_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_mesh_network_key_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = mesh_network_key_stats;
+}
 #endif
 
 
@@ -1440,6 +1793,7 @@ void btstack_memory_mesh_network_key_free(mesh_network_key_t *mesh_network_key){
 #ifdef MAX_NR_MESH_TRANSPORT_KEYS
 #if MAX_NR_MESH_TRANSPORT_KEYS > 0
 static mesh_transport_key_t mesh_transport_key_storage[MAX_NR_MESH_TRANSPORT_KEYS];
+static uint32_t mesh_transport_key_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_MESH_TRANSPORT_KEYS)];
 static btstack_memory_pool_t mesh_transport_key_pool;
 mesh_transport_key_t * btstack_memory_mesh_transport_key_get(void){
     void * buffer = btstack_memory_pool_get(&mesh_transport_key_pool);
@@ -1451,6 +1805,9 @@ mesh_transport_key_t * btstack_memory_mesh_transport_key_get(void){
 void btstack_memory_mesh_transport_key_free(mesh_transport_key_t *mesh_transport_key){
     btstack_memory_pool_free(&mesh_transport_key_pool, mesh_transport_key);
 }
+void btstack_memory_mesh_transport_key_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&mesh_transport_key_pool, stats);
+}
 #else
 mesh_transport_key_t * btstack_memory_mesh_transport_key_get(void){
     return NULL;
@@ -1458,6 +1815,9 @@ mesh_transport_key_t * btstack_memory_mesh_transport_key_get(void){
 void btstack_memory_mesh_transport_key_free(mesh_transport_key_t *mesh_transport_key){
     UNUSED(mesh_transport_key);
 };
+void btstack_memory_mesh_transport_key_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1466,13 +1826,17 @@ typedef struct {
     mesh_transport_key_t data;
 } btstack_memory_mesh_transport_key_t;
 
+static btstack_memory_pool_stats_t mesh_transport_key_stats;
+
 mesh_transport_key_t * btstack_memory_mesh_transport_key_get(void){
     btstack_memory_mesh_transport_key_t * buffer = (btstack_memory_mesh_transport_key_t *) malloc(sizeof(btstack_memory_mesh_transport_key_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_mesh_transport_key_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&mesh_transport_key_stats);
         return &buffer->data;
     } else {
+        mesh_transport_key_stats.num_failed++;
         return NULL;
     }
 }
@@ -1480,8 +1844,12 @@ void btstack_memory_mesh_transport_key_free(mesh_transport_key_t *mesh_transport
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) mesh_transport_key)[-1];
     btstack_memory_tracking_remove(buffer);
+    mesh_transport_key_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_mesh_transport_key_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = mesh_transport_key_stats;
+}
 #endif
 
 
@@ -1497,6 +1865,7 @@ void btstack_memory_mesh_transport_key_free(mesh_transport_key_t *mesh_transport
 #ifdef MAX_NR_MESH_VIRTUAL_ADDRESSS
 #if MAX_NR_MESH_VIRTUAL_ADDRESSS > 0
 static mesh_virtual_address_t mesh_virtual_address_storage[MAX_NR_MESH_VIRTUAL_ADDRESSS];
+static uint32_t mesh_virtual_address_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_MESH_VIRTUAL_ADDRESSS)];
 static btstack_memory_pool_t mesh_virtual_address_pool;
 mesh_virtual_address_t * btstack_memory_mesh_virtual_address_get(void){
     void * buffer = btstack_memory_pool_get(&mesh_virtual_address_pool);
@@ -1508,6 +1877,9 @@ mesh_virtual_address_t * btstack_memory_mesh_virtual_address_get(void){
 void btstack_memory_mesh_virtual_address_free(mesh_virtual_address_t *mesh_virtual_address){
     btstack_memory_pool_free(&mesh_virtual_address_pool, mesh_virtual_address);
 }
+void btstack_memory_mesh_virtual_address_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&mesh_virtual_address_pool, stats);
+}
 #else
 mesh_virtual_address_t * btstack_memory_mesh_virtual_address_get(void){
     return NULL;
@@ -1515,6 +1887,9 @@ mesh_virtual_address_t * btstack_memory_mesh_virtual_address_get(void){
 void btstack_memory_mesh_virtual_address_free(mesh_virtual_address_t *mesh_virtual_address){
     UNUSED(mesh_virtual_address);
 };
+void btstack_memory_mesh_virtual_address_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1523,13 +1898,17 @@ typedef struct {
     mesh_virtual_address_t data;
 } btstack_memory_mesh_virtual_address_t;
 
+static btstack_memory_pool_stats_t mesh_virtual_address_stats;
+
 mesh_virtual_address_t * btstack_memory_mesh_virtual_address_get(void){
     btstack_memory_mesh_virtual_address_t * buffer = (btstack_memory_mesh_virtual_address_t *) malloc(sizeof(btstack_memory_mesh_virtual_address_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_mesh_virtual_address_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&mesh_virtual_address_stats);
         return &buffer->data;
     } else {
+        mesh_virtual_address_stats.num_failed++;
         return NULL;
     }
 }
@@ -1537,8 +1916,12 @@ void btstack_memory_mesh_virtual_address_free(mesh_virtual_address_t *mesh_virtu
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) mesh_virtual_address)[-1];
     btstack_memory_tracking_remove(buffer);
+    mesh_virtual_address_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_mesh_virtual_address_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = mesh_virtual_address_stats;
+}
 #endif
 
 
@@ -1554,6 +1937,7 @@ void btstack_memory_mesh_virtual_address_free(mesh_virtual_address_t *mesh_virtu
 #ifdef MAX_NR_MESH_SUBNETS
 #if MAX_NR_MESH_SUBNETS > 0
 static mesh_subnet_t mesh_subnet_storage[MAX_NR_MESH_SUBNETS];
+static uint32_t mesh_subnet_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NR_MESH_SUBNETS)];
 static btstack_memory_pool_t mesh_subnet_pool;
 mesh_subnet_t * btstack_memory_mesh_subnet_get(void){
     void * buffer = btstack_memory_pool_get(&mesh_subnet_pool);
@@ -1565,6 +1949,9 @@ mesh_subnet_t * btstack_memory_mesh_subnet_get(void){
 void btstack_memory_mesh_subnet_free(mesh_subnet_t *mesh_subnet){
     btstack_memory_pool_free(&mesh_subnet_pool, mesh_subnet);
 }
+void btstack_memory_mesh_subnet_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&mesh_subnet_pool, stats);
+}
 #else
 mesh_subnet_t * btstack_memory_mesh_subnet_get(void){
     return NULL;
@@ -1572,6 +1959,9 @@ mesh_subnet_t * btstack_memory_mesh_subnet_get(void){
 void btstack_memory_mesh_subnet_free(mesh_subnet_t *mesh_subnet){
     UNUSED(mesh_subnet);
 };
+void btstack_memory_mesh_subnet_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -1580,13 +1970,17 @@ typedef struct {
     mesh_subnet_t data;
 } btstack_memory_mesh_subnet_t;
 
+static btstack_memory_pool_stats_t mesh_subnet_stats;
+
 mesh_subnet_t * btstack_memory_mesh_subnet_get(void){
     btstack_memory_mesh_subnet_t * buffer = (btstack_memory_mesh_subnet_t *) malloc(sizeof(btstack_memory_mesh_subnet_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_mesh_subnet_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&mesh_subnet_stats);
         return &buffer->data;
     } else {
+        mesh_subnet_stats.num_failed++;
         return NULL;
     }
 }
@@ -1594,102 +1988,292 @@ void btstack_memory_mesh_subnet_free(mesh_subnet_t *mesh_subnet){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) mesh_subnet)[-1];
     btstack_memory_tracking_remove(buffer);
+    mesh_subnet_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_mesh_subnet_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = mesh_subnet_stats;
+}
+#endif
+
+
+#endif
+#ifdef HAVE_MALLOC
+static void btstack_memory_malloc_stats_reset(void){
+#ifndef MAX_NR_HCI_CONNECTIONS
+    memset(&hci_connection_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_L2CAP_SERVICES
+    memset(&l2cap_service_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_L2CAP_CHANNELS
+    memset(&l2cap_channel_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifdef ENABLE_CLASSIC
+#ifndef MAX_NR_RFCOMM_MULTIPLEXERS
+    memset(&rfcomm_multiplexer_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_RFCOMM_SERVICES
+    memset(&rfcomm_service_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_RFCOMM_CHANNELS
+    memset(&rfcomm_channel_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES
+    memset(&btstack_link_key_db_memory_entry_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_BNEP_SERVICES
+    memset(&bnep_service_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_BNEP_CHANNELS
+    memset(&bnep_channel_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_HFP_CONNECTIONS
+    memset(&hfp_connection_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_HID_HOST_CONNECTIONS
+    memset(&hid_host_connection_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_SERVICE_RECORD_ITEMS
+    memset(&service_record_item_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_AVDTP_STREAM_ENDPOINTS
+    memset(&avdtp_stream_endpoint_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_AVDTP_CONNECTIONS
+    memset(&avdtp_connection_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_AVRCP_CONNECTIONS
+    memset(&avrcp_connection_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_AVRCP_BROWSING_CONNECTIONS
+    memset(&avrcp_browsing_connection_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#endif
+#ifdef ENABLE_BLE
+#ifndef MAX_NR_GATT_CLIENTS
+    memset(&gatt_client_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_WHITELIST_ENTRIES
+    memset(&whitelist_entry_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_SM_LOOKUP_ENTRIES
+    memset(&sm_lookup_entry_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#endif
+#ifdef ENABLE_MESH
+#ifndef MAX_NR_MESH_NETWORK_PDUS
+    memset(&mesh_network_pdu_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_MESH_SEGMENTED_PDUS
+    memset(&mesh_segmented_pdu_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_MESH_UPPER_TRANSPORT_PDUS
+    memset(&mesh_upper_transport_pdu_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_MESH_NETWORK_KEYS
+    memset(&mesh_network_key_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_MESH_TRANSPORT_KEYS
+    memset(&mesh_transport_key_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_MESH_VIRTUAL_ADDRESSS
+    memset(&mesh_virtual_address_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#ifndef MAX_NR_MESH_SUBNETS
+    memset(&mesh_subnet_stats, 0, sizeof(btstack_memory_pool_stats_t));
+#endif
+#endif
+}
 #endif
 
+typedef void (*btstack_memory_stats_handler_t)(const char * name, uint32_t size, const btstack_memory_pool_stats_t * stats);
 
+static void btstack_memory_iterate_stats(btstack_memory_stats_handler_t handler){
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hci_connection_get_stats(&stats);
+    (*handler)("hci_connection", sizeof(hci_connection_t), &stats);
+    btstack_memory_l2cap_service_get_stats(&stats);
+    (*handler)("l2cap_service", sizeof(l2cap_service_t), &stats);
+    btstack_memory_l2cap_channel_get_stats(&stats);
+    (*handler)("l2cap_channel", sizeof(l2cap_channel_t), &stats);
+#ifdef ENABLE_CLASSIC
+    btstack_memory_rfcomm_multiplexer_get_stats(&stats);
+    (*handler)("rfcomm_multiplexer", sizeof(rfcomm_multiplexer_t), &stats);
+    btstack_memory_rfcomm_service_get_stats(&stats);
+    (*handler)("rfcomm_service", sizeof(rfcomm_service_t), &stats);
+    btstack_memory_rfcomm_channel_get_stats(&stats);
+    (*handler)("rfcomm_channel", sizeof(rfcomm_channel_t), &stats);
+    btstack_memory_btstack_link_key_db_memory_entry_get_stats(&stats);
+    (*handler)("btstack_link_key_db_memory_entry", sizeof(btstack_link_key_db_memory_entry_t), &stats);
+    btstack_memory_bnep_service_get_stats(&stats);
+    (*handler)("bnep_service", sizeof(bnep_service_t), &stats);
+    btstack_memory_bnep_channel_get_stats(&stats);
+    (*handler)("bnep_channel", sizeof(bnep_channel_t), &stats);
+    btstack_memory_hfp_connection_get_stats(&stats);
+    (*handler)("hfp_connection", sizeof(hfp_connection_t), &stats);
+    btstack_memory_hid_host_connection_get_stats(&stats);
+    (*handler)("hid_host_connection", sizeof(hid_host_connection_t), &stats);
+    btstack_memory_service_record_item_get_stats(&stats);
+    (*handler)("service_record_item", sizeof(service_record_item_t), &stats);
+    btstack_memory_avdtp_stream_endpoint_get_stats(&stats);
+    (*handler)("avdtp_stream_endpoint", sizeof(avdtp_stream_endpoint_t), &stats);
+    btstack_memory_avdtp_connection_get_stats(&stats);
+    (*handler)("avdtp_connection", sizeof(avdtp_connection_t), &stats);
+    btstack_memory_avrcp_connection_get_stats(&stats);
+    (*handler)("avrcp_connection", sizeof(avrcp_connection_t), &stats);
+    btstack_memory_avrcp_browsing_connection_get_stats(&stats);
+    (*handler)("avrcp_browsing_connection", sizeof(avrcp_browsing_connection_t), &stats);
 #endif
+#ifdef ENABLE_BLE
+    btstack_memory_gatt_client_get_stats(&stats);
+    (*handler)("gatt_client", sizeof(gatt_client_t), &stats);
+    btstack_memory_whitelist_entry_get_stats(&stats);
+    (*handler)("whitelist_entry", sizeof(whitelist_entry_t), &stats);
+    btstack_memory_sm_lookup_entry_get_stats(&stats);
+    (*handler)("sm_lookup_entry", sizeof(sm_lookup_entry_t), &stats);
+#endif
+#ifdef ENABLE_MESH
+    btstack_memory_mesh_network_pdu_get_stats(&stats);
+    (*handler)("mesh_network_pdu", sizeof(mesh_network_pdu_t), &stats);
+    btstack_memory_mesh_segmented_pdu_get_stats(&stats);
+    (*handler)("mesh_segmented_pdu", sizeof(mesh_segmented_pdu_t), &stats);
+    btstack_memory_mesh_upper_transport_pdu_get_stats(&stats);
+    (*handler)("mesh_upper_transport_pdu", sizeof(mesh_upper_transport_pdu_t), &stats);
+    btstack_memory_mesh_network_key_get_stats(&stats);
+    (*handler)("mesh_network_key", sizeof(mesh_network_key_t), &stats);
+    btstack_memory_mesh_transport_key_get_stats(&stats);
+    (*handler)("mesh_transport_key", sizeof(mesh_transport_key_t), &stats);
+    btstack_memory_mesh_virtual_address_get_stats(&stats);
+    (*handler)("mesh_virtual_address", sizeof(mesh_virtual_address_t), &stats);
+    btstack_memory_mesh_subnet_get_stats(&stats);
+    (*handler)("mesh_subnet", sizeof(mesh_subnet_t), &stats);
+#endif
+}
 
 // init
 void btstack_memory_init(void){
 #ifdef HAVE_MALLOC
     // assert that there is no unexpected padding for combined buffer
     btstack_assert(sizeof(test_buffer_t) == sizeof(btstack_memory_buffer_t) + sizeof(void *));
+    btstack_memory_malloc_stats_reset();
 #endif
   
 #if MAX_NR_HCI_CONNECTIONS > 0
-    btstack_memory_pool_create(&hci_connection_pool, hci_connection_storage, MAX_NR_HCI_CONNECTIONS, sizeof(hci_connection_t));
+    btstack_memory_pool_create_with_bitmap(&hci_connection_pool, hci_connection_storage, MAX_NR_HCI_CONNECTIONS, sizeof(hci_connection_t), hci_connection_bitmap);
 #endif
 #if MAX_NR_L2CAP_SERVICES > 0
-    btstack_memory_pool_create(&l2cap_service_pool, l2cap_service_storage, MAX_NR_L2CAP_SERVICES, sizeof(l2cap_service_t));
+    btstack_memory_pool_create_with_bitmap(&l2cap_service_pool, l2cap_service_storage, MAX_NR_L2CAP_SERVICES, sizeof(l2cap_service_t), l2cap_service_bitmap);
 #endif
 #if MAX_NR_L2CAP_CHANNELS > 0
-    btstack_memory_pool_create(&l2cap_channel_pool, l2cap_channel_storage, MAX_NR_L2CAP_CHANNELS, sizeof(l2cap_channel_t));
+    btstack_memory_pool_create_with_bitmap(&l2cap_channel_pool, l2cap_channel_storage, MAX_NR_L2CAP_CHANNELS, sizeof(l2cap_channel_t), l2cap_channel_bitmap);
 #endif
 #ifdef ENABLE_CLASSIC
 #if MAX_NR_RFCOMM_MULTIPLEXERS > 0
-    btstack_memory_pool_create(&rfcomm_multiplexer_pool, rfcomm_multiplexer_storage, MAX_NR_RFCOMM_MULTIPLEXERS, sizeof(rfcomm_multiplexer_t));
+    btstack_memory_pool_create_with_bitmap(&rfcomm_multiplexer_pool, rfcomm_multiplexer_storage, MAX_NR_RFCOMM_MULTIPLEXERS, sizeof(rfcomm_multiplexer_t), rfcomm_multiplexer_bitmap);
 #endif
 #if MAX_NR_RFCOMM_SERVICES > 0
-    btstack_memory_pool_create(&rfcomm_service_pool, rfcomm_service_storage, MAX_NR_RFCOMM_SERVICES, sizeof(rfcomm_service_t));
+    btstack_memory_pool_create_with_bitmap(&rfcomm_service_pool, rfcomm_service_storage, MAX_NR_RFCOMM_SERVICES, sizeof(rfcomm_service_t), rfcomm_service_bitmap);
 #endif
 #if MAX_NR_RFCOMM_CHANNELS > 0
-    btstack_memory_pool_create(&rfcomm_channel_pool, rfcomm_channel_storage, MAX_NR_RFCOMM_CHANNELS, sizeof(rfcomm_channel_t));
+    btstack_memory_pool_create_with_bitmap(&rfcomm_channel_pool, rfcomm_channel_storage, MAX_NR_RFCOMM_CHANNELS, sizeof(rfcomm_channel_t), rfcomm_channel_bitmap);
 #endif
 #if MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES > 0
-    btstack_memory_pool_create(&btstack_link_key_db_memory_entry_pool, btstack_link_key_db_memory_entry_storage, MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES, sizeof(btstack_link_key_db_memory_entry_t));
+    btstack_memory_pool_create_with_bitmap(&btstack_link_key_db_memory_entry_pool, btstack_link_key_db_memory_entry_storage, MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES, sizeof(btstack_link_key_db_memory_entry_t), btstack_link_key_db_memory_entry_bitmap);
 #endif
 #if MAX_NR_BNEP_SERVICES > 0
-    btstack_memory_pool_create(&bnep_service_pool, bnep_service_storage, MAX_NR_BNEP_SERVICES, sizeof(bnep_service_t));
+    btstack_memory_pool_create_with_bitmap(&bnep_service_pool, bnep_service_storage, MAX_NR_BNEP_SERVICES, sizeof(bnep_service_t), bnep_service_bitmap);
 #endif
 #if MAX_NR_BNEP_CHANNELS > 0
-    btstack_memory_pool_create(&bnep_channel_pool, bnep_channel_storage, MAX_NR_BNEP_CHANNELS, sizeof(bnep_channel_t));
+    btstack_memory_pool_create_with_bitmap(&bnep_channel_pool, bnep_channel_storage, MAX_NR_BNEP_CHANNELS, sizeof(bnep_channel_t), bnep_channel_bitmap);
 #endif
 #if MAX_NR_HFP_CONNECTIONS > 0
-    btstack_memory_pool_create(&hfp_connection_pool, hfp_connection_storage, MAX_NR_HFP_CONNECTIONS, sizeof(hfp_connection_t));
+    btstack_memory_pool_create_with_bitmap(&hfp_connection_pool, hfp_connection_storage, MAX_NR_HFP_CONNECTIONS, sizeof(hfp_connection_t), hfp_connection_bitmap);
 #endif
 #if MAX_NR_HID_HOST_CONNECTIONS > 0
-    btstack_memory_pool_create(&hid_host_connection_pool, hid_host_connection_storage, MAX_NR_HID_HOST_CONNECTIONS, sizeof(hid_host_connection_t));
+    btstack_memory_pool_create_with_bitmap(&hid_host_connection_pool, hid_host_connection_storage, MAX_NR_HID_HOST_CONNECTIONS, sizeof(hid_host_connection_t), hid_host_connection_bitmap);
 #endif
 #if MAX_NR_SERVICE_RECORD_ITEMS > 0
-    btstack_memory_pool_create(&service_record_item_pool, service_record_item_storage, MAX_NR_SERVICE_RECORD_ITEMS, sizeof(service_record_item_t));
+    btstack_memory_pool_create_with_bitmap(&service_record_item_pool, service_record_item_storage, MAX_NR_SERVICE_RECORD_ITEMS, sizeof(service_record_item_t), service_record_item_bitmap);
 #endif
 #if MAX_NR_AVDTP_STREAM_ENDPOINTS > 0
-    btstack_memory_pool_create(&avdtp_stream_endpoint_pool, avdtp_stream_endpoint_storage, MAX_NR_AVDTP_STREAM_ENDPOINTS, sizeof(avdtp_stream_endpoint_t));
+    btstack_memory_pool_create_with_bitmap(&avdtp_stream_endpoint_pool, avdtp_stream_endpoint_storage, MAX_NR_AVDTP_STREAM_ENDPOINTS, sizeof(avdtp_stream_endpoint_t), avdtp_stream_endpoint_bitmap);
 #endif
 #if MAX_NR_AVDTP_CONNECTIONS > 0
-    btstack_memory_pool_create(&avdtp_connection_pool, avdtp_connection_storage, MAX_NR_AVDTP_CONNECTIONS, sizeof(avdtp_connection_t));
+    btstack_memory_pool_create_with_bitmap(&avdtp_connection_pool, avdtp_connection_storage, MAX_NR_AVDTP_CONNECTIONS, sizeof(avdtp_connection_t), avdtp_connection_bitmap);
 #endif
 #if MAX_NR_AVRCP_CONNECTIONS > 0
-    btstack_memory_pool_create(&avrcp_connection_pool, avrcp_connection_storage, MAX_NR_AVRCP_CONNECTIONS, sizeof(avrcp_connection_t));
+    btstack_memory_pool_create_with_bitmap(&avrcp_connection_pool, avrcp_connection_storage, MAX_NR_AVRCP_CONNECTIONS, sizeof(avrcp_connection_t), avrcp_connection_bitmap);
 #endif
 #if MAX_NR_AVRCP_BROWSING_CONNECTIONS > 0
-    btstack_memory_pool_create(&avrcp_browsing_connection_pool, avrcp_browsing_connection_storage, MAX_NR_AVRCP_BROWSING_CONNECTIONS, sizeof(avrcp_browsing_connection_t));
+    btstack_memory_pool_create_with_bitmap(&avrcp_browsing_connection_pool, avrcp_browsing_connection_storage, MAX_NR_AVRCP_BROWSING_CONNECTIONS, sizeof(avrcp_browsing_connection_t), avrcp_browsing_connection_bitmap);
 #endif
 #endif
 #ifdef ENABLE_BLE
 #if MAX_NR_GATT_CLIENTS > 0
-    btstack_memory_pool_create(&gatt_client_pool, gatt_client_storage, MAX_NR_GATT_CLIENTS, sizeof(gatt_client_t));
+    btstack_memory_pool_create_with_bitmap(&gatt_client_pool, gatt_client_storage, MAX_NR_GATT_CLIENTS, sizeof(gatt_client_t), gatt_client_bitmap);
 #endif
 #if MAX_NR_WHITELIST_ENTRIES > 0
-    btstack_memory_pool_create(&whitelist_entry_pool, whitelist_entry_storage, MAX_NR_WHITELIST_ENTRIES, sizeof(whitelist_entry_t));
+    btstack_memory_pool_create_with_bitmap(&whitelist_entry_pool, whitelist_entry_storage, MAX_NR_WHITELIST_ENTRIES, sizeof(whitelist_entry_t), whitelist_entry_bitmap);
 #endif
 #if MAX_NR_SM_LOOKUP_ENTRIES > 0
-    btstack_memory_pool_create(&sm_lookup_entry_pool, sm_lookup_entry_storage, MAX_NR_SM_LOOKUP_ENTRIES, sizeof(sm_lookup_entry_t));
+    btstack_memory_pool_create_with_bitmap(&sm_lookup_entry_pool, sm_lookup_entry_storage, MAX_NR_SM_LOOKUP_ENTRIES, sizeof(sm_lookup_entry_t), sm_lookup_entry_bitmap);
 #endif
 #endif
 #ifdef ENABLE_MESH
 #if MAX_NR_MESH_NETWORK_PDUS > 0
-    btstack_memory_pool_create(&mesh_network_pdu_pool, mesh_network_pdu_storage, MAX_NR_MESH_NETWORK_PDUS, sizeof(mesh_network_pdu_t));
+    btstack_memory_pool_create_with_bitmap(&mesh_network_pdu_pool, mesh_network_pdu_storage, MAX_NR_MESH_NETWORK_PDUS, sizeof(mesh_network_pdu_t), mesh_network_pdu_bitmap);
 #endif
 #if MAX_NR_MESH_SEGMENTED_PDUS > 0
-    btstack_memory_pool_create(&mesh_segmented_pdu_pool, mesh_segmented_pdu_storage, MAX_NR_MESH_SEGMENTED_PDUS, sizeof(mesh_segmented_pdu_t));
+    btstack_memory_pool_create_with_bitmap(&mesh_segmented_pdu_pool, mesh_segmented_pdu_storage, MAX_NR_MESH_SEGMENTED_PDUS, sizeof(mesh_segmented_pdu_t), mesh_segmented_pdu_bitmap);
 #endif
 #if MAX_NR_MESH_UPPER_TRANSPORT_PDUS > 0
-    btstack_memory_pool_create(&mesh_upper_transport_pdu_pool, mesh_upper_transport_pdu_storage, MAX_NR_MESH_UPPER_TRANSPORT_PDUS, sizeof(mesh_upper_transport_pdu_t));
+    btstack_memory_pool_create_with_bitmap(&mesh_upper_transport_pdu_pool, mesh_upper_transport_pdu_storage, MAX_NR_MESH_UPPER_TRANSPORT_PDUS, sizeof(mesh_upper_transport_pdu_t), mesh_upper_transport_pdu_bitmap);
 #endif
 #if MAX_NR_MESH_NETWORK_KEYS > 0
-    btstack_memory_pool_create(&mesh_network_key_pool, mesh_network_key_storage, MAX_NR_MESH_NETWORK_KEYS, sizeof(mesh_network_key_t));
+    btstack_memory_pool_create_with_bitmap(&mesh_network_key_pool, mesh_network_key_storage, MAX_NR_MESH_NETWORK_KEYS, sizeof(mesh_network_key_t), mesh_network_key_bitmap);
 #endif
 #if MAX_NR_MESH_TRANSPORT_KEYS > 0
-    btstack_memory_pool_create(&mesh_transport_key_pool, mesh_transport_key_storage, MAX_NR_MESH_TRANSPORT_KEYS, sizeof(mesh_transport_key_t));
+    btstack_memory_pool_create_with_bitmap(&mesh_transport_key_pool, mesh_transport_key_storage, MAX_NR_MESH_TRANSPORT_KEYS, sizeof(mesh_transport_key_t), mesh_transport_key_bitmap);
 #endif
 #if MAX_NR_MESH_VIRTUAL_ADDRESSS > 0
-    btstack_memory_pool_create(&mesh_virtual_address_pool, mesh_virtual_address_storage, MAX_NR_MESH_VIRTUAL_ADDRESSS, sizeof(mesh_virtual_address_t));
+    btstack_memory_pool_create_with_bitmap(&mesh_virtual_address_pool, mesh_virtual_address_storage, MAX_NR_MESH_VIRTUAL_ADDRESSS, sizeof(mesh_virtual_address_t), mesh_virtual_address_bitmap);
 #endif
 #if MAX_NR_MESH_SUBNETS > 0
-    btstack_memory_pool_create(&mesh_subnet_pool, mesh_subnet_storage, MAX_NR_MESH_SUBNETS, sizeof(mesh_subnet_t));
+    btstack_memory_pool_create_with_bitmap(&mesh_subnet_pool, mesh_subnet_storage, MAX_NR_MESH_SUBNETS, sizeof(mesh_subnet_t), mesh_subnet_bitmap);
+#endif
 #endif
+}
+
+static void btstack_memory_log_stats(const char * name, uint32_t size, const btstack_memory_pool_stats_t * stats){
+    log_info("%-32s in use %3u, max %3u, allocations %6u, failed %3u, bytes in use %6u", name,
+             (unsigned int) stats->in_use, (unsigned int) stats->max_in_use, (unsigned int) stats->num_allocations,
+             (unsigned int) stats->num_failed, (unsigned int) (stats->in_use * size));
+}
+
+void btstack_memory_dump_stats(void){
+    btstack_memory_iterate_stats(&btstack_memory_log_stats);
+}
+
+#ifdef HAVE_MALLOC
+static void btstack_memory_log_leak(const char * name, uint32_t size, const btstack_memory_pool_stats_t * stats){
+    if (stats->in_use == 0u) return;
+    log_error("%-32s %3u not freed, %6u bytes", name, (unsigned int) stats->in_use, (unsigned int) (stats->in_use * size));
+}
+#endif
+
+void btstack_memory_deinit(void){
+#ifdef HAVE_MALLOC
+    if (btstack_memory_malloc_counter > 0u){
+        log_error("%u buffers not freed", (unsigned int) btstack_memory_malloc_counter);
+        btstack_memory_iterate_stats(&btstack_memory_log_leak);
+    }
+    while (btstack_memory_malloc_buffers != NULL){
+        btstack_memory_buffer_t * buffer = btstack_memory_malloc_buffers;
+        btstack_memory_malloc_buffers = buffer->next;
+        free(buffer);
+        btstack_memory_malloc_counter--;
+    }
+    btstack_memory_malloc_stats_reset();
 #endif
 }
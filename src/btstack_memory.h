@@ -52,6 +52,7 @@ extern "C" {
 #endif
 
 #include "btstack_config.h"
+#include "btstack_memory_pool.h"
     
 // Core
 #include "hci.h"
@@ -90,95 +91,127 @@ void btstack_memory_init(void);
 
 /**
  * @brief Deinitialize BTstack memory pools
- * @note if HAVE_MALLOC is defined, all previously allocated buffers are free'd
+ * @note if HAVE_MALLOC is defined, all previously allocated buffers are free'd and reported as leaks
  */
 void btstack_memory_deinit(void);
 
+/**
+ * @brief Log allocation statistics for all types: current, max, total allocations, failed allocations and bytes in use
+ * @note use to size MAX_NR_* defines
+ */
+void btstack_memory_dump_stats(void);
+
 /* API_END */
 
 // hci_connection
 hci_connection_t * btstack_memory_hci_connection_get(void);
 void   btstack_memory_hci_connection_free(hci_connection_t *hci_connection);
+void   btstack_memory_hci_connection_get_stats(btstack_memory_pool_stats_t * stats);
 
 // l2cap_service, l2cap_channel
 l2cap_service_t * btstack_memory_l2cap_service_get(void);
 void   btstack_memory_l2cap_service_free(l2cap_service_t *l2cap_service);
+void   btstack_memory_l2cap_service_get_stats(btstack_memory_pool_stats_t * stats);
 l2cap_channel_t * btstack_memory_l2cap_channel_get(void);
 void   btstack_memory_l2cap_channel_free(l2cap_channel_t *l2cap_channel);
+void   btstack_memory_l2cap_channel_get_stats(btstack_memory_pool_stats_t * stats);
 
 #ifdef ENABLE_CLASSIC
 // rfcomm_multiplexer, rfcomm_service, rfcomm_channel
 rfcomm_multiplexer_t * btstack_memory_rfcomm_multiplexer_get(void);
 void   btstack_memory_rfcomm_multiplexer_free(rfcomm_multiplexer_t *rfcomm_multiplexer);
+void   btstack_memory_rfcomm_multiplexer_get_stats(btstack_memory_pool_stats_t * stats);
 rfcomm_service_t * btstack_memory_rfcomm_service_get(void);
 void   btstack_memory_rfcomm_service_free(rfcomm_service_t *rfcomm_service);
+void   btstack_memory_rfcomm_service_get_stats(btstack_memory_pool_stats_t * stats);
 rfcomm_channel_t * btstack_memory_rfcomm_channel_get(void);
 void   btstack_memory_rfcomm_channel_free(rfcomm_channel_t *rfcomm_channel);
+void   btstack_memory_rfcomm_channel_get_stats(btstack_memory_pool_stats_t * stats);
 
 // btstack_link_key_db_memory_entry
 btstack_link_key_db_memory_entry_t * btstack_memory_btstack_link_key_db_memory_entry_get(void);
 void   btstack_memory_btstack_link_key_db_memory_entry_free(btstack_link_key_db_memory_entry_t *btstack_link_key_db_memory_entry);
+void   btstack_memory_btstack_link_key_db_memory_entry_get_stats(btstack_memory_pool_stats_t * stats);
 
 // bnep_service, bnep_channel
 bnep_service_t * btstack_memory_bnep_service_get(void);
 void   btstack_memory_bnep_service_free(bnep_service_t *bnep_service);
+void   btstack_memory_bnep_service_get_stats(btstack_memory_pool_stats_t * stats);
 bnep_channel_t * btstack_memory_bnep_channel_get(void);
 void   btstack_memory_bnep_channel_free(bnep_channel_t *bnep_channel);
+void   btstack_memory_bnep_channel_get_stats(btstack_memory_pool_stats_t * stats);
 
 // hfp_connection
 hfp_connection_t * btstack_memory_hfp_connection_get(void);
 void   btstack_memory_hfp_connection_free(hfp_connection_t *hfp_connection);
+void   btstack_memory_hfp_connection_get_stats(btstack_memory_pool_stats_t * stats);
 
 // hid_host_connection
 hid_host_connection_t * btstack_memory_hid_host_connection_get(void);
 void   btstack_memory_hid_host_connection_free(hid_host_connection_t *hid_host_connection);
+void   btstack_memory_hid_host_connection_get_stats(btstack_memory_pool_stats_t * stats);
 
 // service_record_item
 service_record_item_t * btstack_memory_service_record_item_get(void);
 void   btstack_memory_service_record_item_free(service_record_item_t *service_record_item);
+void   btstack_memory_service_record_item_get_stats(btstack_memory_pool_stats_t * stats);
 
 // avdtp_stream_endpoint
 avdtp_stream_endpoint_t * btstack_memory_avdtp_stream_endpoint_get(void);
 void   btstack_memory_avdtp_stream_endpoint_free(avdtp_stream_endpoint_t *avdtp_stream_endpoint);
+void   btstack_memory_avdtp_stream_endpoint_get_stats(btstack_memory_pool_stats_t * stats);
 
 // avdtp_connection
 avdtp_connection_t * btstack_memory_avdtp_connection_get(void);
 void   btstack_memory_avdtp_connection_free(avdtp_connection_t *avdtp_connection);
+void   btstack_memory_avdtp_connection_get_stats(btstack_memory_pool_stats_t * stats);
 
 // avrcp_connection
 avrcp_connection_t * btstack_memory_avrcp_connection_get(void);
 void   btstack_memory_avrcp_connection_free(avrcp_connection_t *avrcp_connection);
+void   btstack_memory_avrcp_connection_get_stats(btstack_memory_pool_stats_t * stats);
 
 // avrcp_browsing_connection
 avrcp_browsing_connection_t * btstack_memory_avrcp_browsing_connection_get(void);
 void   btstack_memory_avrcp_browsing_connection_free(avrcp_browsing_connection_t *avrcp_browsing_connection);
+void   btstack_memory_avrcp_browsing_connection_get_stats(btstack_memory_pool_stats_t * stats);
 
 #endif
 #ifdef ENABLE_BLE
 // gatt_client, whitelist_entry, sm_lookup_entry
 gatt_client_t * btstack_memory_gatt_client_get(void);
 void   btstack_memory_gatt_client_free(gatt_client_t *gatt_client);
+void   btstack_memory_gatt_client_get_stats(btstack_memory_pool_stats_t * stats);
 whitelist_entry_t * btstack_memory_whitelist_entry_get(void);
 void   btstack_memory_whitelist_entry_free(whitelist_entry_t *whitelist_entry);
+void   btstack_memory_whitelist_entry_get_stats(btstack_memory_pool_stats_t * stats);
 sm_lookup_entry_t * btstack_memory_sm_lookup_entry_get(void);
 void   btstack_memory_sm_lookup_entry_free(sm_lookup_entry_t *sm_lookup_entry);
+void   btstack_memory_sm_lookup_entry_get_stats(btstack_memory_pool_stats_t * stats);
 #endif
 #ifdef ENABLE_MESH
 // mesh_network_pdu, mesh_segmented_pdu, mesh_upper_transport_pdu, mesh_network_key, mesh_transport_key, mesh_virtual_address, mesh_subnet
 mesh_network_pdu_t * btstack_memory_mesh_network_pdu_get(void);
 void   btstack_memory_mesh_network_pdu_free(mesh_network_pdu_t *mesh_network_pdu);
+void   btstack_memory_mesh_network_pdu_get_stats(btstack_memory_pool_stats_t * stats);
 mesh_segmented_pdu_t * btstack_memory_mesh_segmented_pdu_get(void);
 void   btstack_memory_mesh_segmented_pdu_free(mesh_segmented_pdu_t *mesh_segmented_pdu);
+void   btstack_memory_mesh_segmented_pdu_get_stats(btstack_memory_pool_stats_t * stats);
 mesh_upper_transport_pdu_t * btstack_memory_mesh_upper_transport_pdu_get(void);
 void   btstack_memory_mesh_upper_transport_pdu_free(mesh_upper_transport_pdu_t *mesh_upper_transport_pdu);
+void   btstack_memory_mesh_upper_transport_pdu_get_stats(btstack_memory_pool_stats_t * stats);
 mesh_network_key_t * btstack_memory_mesh_network_key_get(void);
 void   btstack_memory_mesh_network_key_free(mesh_network_key_t *mesh_network_key);
+void   btstack_memory_mesh_network_key_get_stats(btstack_memory_pool_stats_t * stats);
 mesh_transport_key_t * btstack_memory_mesh_transport_key_get(void);
 void   btstack_memory_mesh_transport_key_free(mesh_transport_key_t *mesh_transport_key);
+void   btstack_memory_mesh_transport_key_get_stats(btstack_memory_pool_stats_t * stats);
 mesh_virtual_address_t * btstack_memory_mesh_virtual_address_get(void);
 void   btstack_memory_mesh_virtual_address_free(mesh_virtual_address_t *mesh_virtual_address);
+void   btstack_memory_mesh_virtual_address_get_stats(btstack_memory_pool_stats_t * stats);
 mesh_subnet_t * btstack_memory_mesh_subnet_get(void);
 void   btstack_memory_mesh_subnet_free(mesh_subnet_t *mesh_subnet);
+void   btstack_memory_mesh_subnet_get_stats(btstack_memory_pool_stats_t * stats);
 #endif
 
 #if defined __cplusplus
@@ -44,53 +44,106 @@
  *
  *  Free blocks are kept in singly linked list
  *
+ *  Optional allocation bitmap tracks allocated blocks to detect double free without searching the free list
+ *
  */
 
 #include "btstack_memory_pool.h"
 
 #include <stddef.h>
+#include <string.h>
+#include "btstack_bool.h"
 #include "btstack_debug.h"
 
 typedef struct node {
     struct node * next;
 } node_t;
 
-void btstack_memory_pool_create(btstack_memory_pool_t *pool, void * storage, int count, int block_size){
-    node_t *free_blocks = (node_t*) pool;
-    char   *mem_ptr = (char *) storage;
+static void btstack_memory_pool_push(btstack_memory_pool_t *pool, void * block){
+    node_t *node      = (node_t*) block;
+    node->next        = (node_t*) pool->free_list;
+    pool->free_list   = node;
+}
+
+void btstack_memory_pool_create_with_bitmap(btstack_memory_pool_t *pool, void * storage, int count, int block_size, uint32_t * bitmap){
+    char *mem_ptr = (char *) storage;
     int i;
-    
+
+    pool->free_list  = NULL;
+    pool->storage    = (uint8_t *) storage;
+    pool->block_size = (uint32_t) block_size;
+    pool->count      = (uint32_t) count;
+    pool->allocated  = bitmap;
+    memset(&pool->stats, 0, sizeof(btstack_memory_pool_stats_t));
+    if (bitmap != NULL){
+        memset(bitmap, 0, BTSTACK_MEMORY_POOL_BITMAP_WORDS(count) * sizeof(uint32_t));
+    }
+
     // create singly linked list of all available blocks
-    free_blocks->next = NULL;
     for (i = 0 ; i < count ; i++){
-        btstack_memory_pool_free(pool, mem_ptr);
+        btstack_memory_pool_push(pool, mem_ptr);
         mem_ptr += block_size;
     }
 }
 
+void btstack_memory_pool_create(btstack_memory_pool_t *pool, void * storage, int count, int block_size){
+    btstack_memory_pool_create_with_bitmap(pool, storage, count, block_size, NULL);
+}
+
 void * btstack_memory_pool_get(btstack_memory_pool_t *pool){
-    node_t *free_blocks = (node_t*) pool;
-    
-    if (!free_blocks->next) return NULL;
-    
+    node_t *node = (node_t*) pool->free_list;
+
+    if (node == NULL){
+        pool->stats.num_failed++;
+        return NULL;
+    }
+
     // remove first
-    node_t *node      = free_blocks->next;
-    free_blocks->next = node->next;
-    
+    pool->free_list = node->next;
+
+    if (pool->allocated != NULL){
+        uint32_t index = (uint32_t) (((uint8_t *) node) - pool->storage) / pool->block_size;
+        pool->allocated[index >> 5] |= 1u << (index & 0x1fu);
+    }
+
+    pool->stats.num_allocations++;
+    pool->stats.in_use++;
+    if (pool->stats.in_use > pool->stats.max_in_use){
+        pool->stats.max_in_use = pool->stats.in_use;
+    }
+
     return (void*) node;
 }
 
 void btstack_memory_pool_free(btstack_memory_pool_t *pool, void * block){
-    node_t *free_blocks = (node_t*) pool;
-    node_t *node        = (node_t*) block;
-
-    // assert that node is not already in list
-    node_t * it;
-    for (it = free_blocks->next; it != NULL; it = it->next){
-        btstack_assert(it != node);
+    if (pool->allocated != NULL){
+        // check that block is part of pool and currently allocated
+        uint32_t offset = (uint32_t) (((uint8_t *) block) - pool->storage);
+        uint32_t index  = offset / pool->block_size;
+        if ((((uint8_t *) block) < pool->storage) || (index >= pool->count) || ((offset % pool->block_size) != 0u)){
+            log_error("free %p: not part of pool", block);
+            btstack_assert(false);
+            return;
+        }
+        uint32_t mask = 1u << (index & 0x1fu);
+        if ((pool->allocated[index >> 5] & mask) == 0u){
+            log_error("free %p: already free", block);
+            btstack_assert(false);
+            return;
+        }
+        pool->allocated[index >> 5] &= ~mask;
+    } else {
+        // assert that node is not already in list
+        node_t * it;
+        for (it = (node_t*) pool->free_list; it != NULL; it = it->next){
+            btstack_assert(it != block);
+        }
     }
 
-    // add block as node to list
-    node->next          = free_blocks->next;
-    free_blocks->next   = node;
+    pool->stats.in_use--;
+    btstack_memory_pool_push(pool, block);
+}
+
+void btstack_memory_pool_get_stats(const btstack_memory_pool_t *pool, btstack_memory_pool_stats_t * stats){
+    *stats = pool->stats;
 }
@@ -43,7 +43,8 @@
  *  @Assumption block_size >= sizeof(void *)
  *  @Assumption size of storage >= count * block_size
  *
- *  @Note minimal implementation, no error checking/handling
+ *  @Note get and free are O(1). With an allocation bitmap, blocks that are not part of the pool or already free are
+ *        detected on free, otherwise the free list is searched if btstack_assert is enabled
  */
 
 #ifndef btstack_memory_pool_H
@@ -53,17 +54,48 @@
 extern "C" {
 #endif
 
-typedef void * btstack_memory_pool_t;
+#include <stdint.h>
+
+// number of uint32_t words for allocation bitmap of pool with count blocks
+#define BTSTACK_MEMORY_POOL_BITMAP_WORDS(count) (((count) + 31) / 32)
+
+typedef struct {
+    // currently allocated blocks
+    uint32_t in_use;
+    // max allocated blocks since create
+    uint32_t max_in_use;
+    // total number of successful gets
+    uint32_t num_allocations;
+    // number of gets that returned NULL
+    uint32_t num_failed;
+} btstack_memory_pool_stats_t;
+
+typedef struct {
+    // singly linked list of free blocks
+    void *     free_list;
+    uint8_t *  storage;
+    uint32_t   block_size;
+    uint32_t   count;
+    // optional, bit set for allocated blocks
+    uint32_t * allocated;
+    btstack_memory_pool_stats_t stats;
+} btstack_memory_pool_t;
 
 // initialize memory pool with with given storage, block size and count
 void   btstack_memory_pool_create(btstack_memory_pool_t *pool, void * storage, int count, int block_size);
 
+// initialize memory pool with allocation bitmap of BTSTACK_MEMORY_POOL_BITMAP_WORDS(count) words for O(1) check on free
+void   btstack_memory_pool_create_with_bitmap(btstack_memory_pool_t *pool, void * storage, int count, int block_size, uint32_t * bitmap);
+
 // get free block from pool, @returns NULL or pointer to block
 void * btstack_memory_pool_get(btstack_memory_pool_t *pool);
 
 // return previously reserved block to memory pool
 void   btstack_memory_pool_free(btstack_memory_pool_t *pool, void * block);
 
+// get pool statistics
+void   btstack_memory_pool_get_stats(const btstack_memory_pool_t *pool, btstack_memory_pool_stats_t * stats);
+
 #if defined __cplusplus
 }
 #endif
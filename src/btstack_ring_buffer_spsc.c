@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_ring_buffer_spsc.c"
+
+/*
+ *  btstack_ring_buffer_spsc.c
+ *
+ *  Producer and consumer each own one free running index. The owner publishes its index with release
+ *  semantics after accessing the storage, the other side reads it with acquire semantics before
+ *  accessing the storage. Indices are masked with size - 1 to access the storage.
+ */
+
+#include <string.h>
+
+#include "btstack_ring_buffer_spsc.h"
+#include "bluetooth.h"
+#include "btstack_debug.h"
+#include "btstack_util.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SPSC_LOAD_ACQUIRE(index)         __atomic_load_n(index, __ATOMIC_ACQUIRE)
+#define SPSC_STORE_RELEASE(index, value) __atomic_store_n(index, value, __ATOMIC_RELEASE)
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+static inline uint32_t spsc_load_acquire(uint32_t * index){
+    uint32_t value = *(volatile uint32_t *) index;
+    atomic_thread_fence(memory_order_acquire);
+    return value;
+}
+static inline void spsc_store_release(uint32_t * index, uint32_t value){
+    atomic_thread_fence(memory_order_release);
+    *(volatile uint32_t *) index = value;
+}
+#define SPSC_LOAD_ACQUIRE(index)         spsc_load_acquire(index)
+#define SPSC_STORE_RELEASE(index, value) spsc_store_release(index, value)
+#else
+#error "btstack_ring_buffer_spsc requires GCC/Clang atomic builtins or C11 atomics"
+#endif
+
+int btstack_ring_buffer_spsc_init(btstack_ring_buffer_spsc_t * ring_buffer, uint8_t * storage, uint32_t storage_size){
+    // power of two, at most 2^31 to keep difference of free running indices unambiguous
+    if ((storage_size == 0u) || ((storage_size & (storage_size - 1u)) != 0u) || (storage_size > 0x80000000u)){
+        log_error("ring buffer size %u not a power of two", (unsigned int) storage_size);
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    ring_buffer->storage = storage;
+    ring_buffer->size = storage_size;
+    ring_buffer->mask = storage_size - 1u;
+    btstack_ring_buffer_spsc_reset(ring_buffer);
+    return ERROR_CODE_SUCCESS;
+}
+
+void btstack_ring_buffer_spsc_reset(btstack_ring_buffer_spsc_t * ring_buffer){
+    ring_buffer->read_index = 0;
+    SPSC_STORE_RELEASE(&ring_buffer->write_index, 0);
+}
+
+uint32_t btstack_ring_buffer_spsc_bytes_available(btstack_ring_buffer_spsc_t * ring_buffer){
+    uint32_t write_index = SPSC_LOAD_ACQUIRE(&ring_buffer->write_index);
+    return write_index - ring_buffer->read_index;
+}
+
+uint32_t btstack_ring_buffer_spsc_bytes_free(btstack_ring_buffer_spsc_t * ring_buffer){
+    uint32_t read_index = SPSC_LOAD_ACQUIRE(&ring_buffer->read_index);
+    return ring_buffer->size - (ring_buffer->write_index - read_index);
+}
+
+int btstack_ring_buffer_spsc_write(btstack_ring_buffer_spsc_t * ring_buffer, const uint8_t * data, uint32_t data_length){
+    if (data_length > btstack_ring_buffer_spsc_bytes_free(ring_buffer)){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    // copy first chunk up to end of storage, then remainder from start
+    uint32_t write_pos = ring_buffer->write_index & ring_buffer->mask;
+    uint32_t bytes_until_end = ring_buffer->size - write_pos;
+    uint32_t bytes_to_copy = btstack_min(bytes_until_end, data_length);
+    (void) memcpy(&ring_buffer->storage[write_pos], data, bytes_to_copy);
+    if (bytes_to_copy < data_length){
+        (void) memcpy(ring_buffer->storage, &data[bytes_to_copy], data_length - bytes_to_copy);
+    }
+
+    SPSC_STORE_RELEASE(&ring_buffer->write_index, ring_buffer->write_index + data_length);
+    return ERROR_CODE_SUCCESS;
+}
+
+void btstack_ring_buffer_spsc_read(btstack_ring_buffer_spsc_t * ring_buffer, uint8_t * buffer, uint32_t length, uint32_t * number_of_bytes_read){
+    uint32_t bytes_to_read = btstack_min(btstack_ring_buffer_spsc_bytes_available(ring_buffer), length);
+
+    uint32_t read_pos = ring_buffer->read_index & ring_buffer->mask;
+    uint32_t bytes_until_end = ring_buffer->size - read_pos;
+    uint32_t bytes_to_copy = btstack_min(bytes_until_end, bytes_to_read);
+    (void) memcpy(buffer, &ring_buffer->storage[read_pos], bytes_to_copy);
+    if (bytes_to_copy < bytes_to_read){
+        (void) memcpy(&buffer[bytes_to_copy], ring_buffer->storage, bytes_to_read - bytes_to_copy);
+    }
+
+    SPSC_STORE_RELEASE(&ring_buffer->read_index, ring_buffer->read_index + bytes_to_read);
+    *number_of_bytes_read = bytes_to_read;
+}
+
+uint8_t * btstack_ring_buffer_spsc_get_write_ptr(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t * length){
+    uint32_t write_pos = ring_buffer->write_index & ring_buffer->mask;
+    *length = btstack_min(btstack_ring_buffer_spsc_bytes_free(ring_buffer), ring_buffer->size - write_pos);
+    return &ring_buffer->storage[write_pos];
+}
+
+void btstack_ring_buffer_spsc_commit(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t length){
+    btstack_assert(length <= btstack_ring_buffer_spsc_bytes_free(ring_buffer));
+    SPSC_STORE_RELEASE(&ring_buffer->write_index, ring_buffer->write_index + length);
+}
+
+const uint8_t * btstack_ring_buffer_spsc_get_read_ptr(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t * length){
+    uint32_t read_pos = ring_buffer->read_index & ring_buffer->mask;
+    *length = btstack_min(btstack_ring_buffer_spsc_bytes_available(ring_buffer), ring_buffer->size - read_pos);
+    return &ring_buffer->storage[read_pos];
+}
+
+void btstack_ring_buffer_spsc_consume(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t length){
+    btstack_assert(length <= btstack_ring_buffer_spsc_bytes_available(ring_buffer));
+    SPSC_STORE_RELEASE(&ring_buffer->read_index, ring_buffer->read_index + length);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  btstack_ring_buffer_spsc.h
+ *
+ *  Ring buffer for a single producer and a single consumer that may run in different threads or
+ *  interrupt context without additional locking. Size must be a power of two.
+ */
+
+#ifndef BTSTACK_RING_BUFFER_SPSC_H
+#define BTSTACK_RING_BUFFER_SPSC_H
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct btstack_ring_buffer_spsc {
+    uint8_t  * storage;
+    uint32_t size;
+    uint32_t mask;
+    // free running indices, write_index only modified by producer, read_index only modified by consumer
+    uint32_t write_index;
+    uint32_t read_index;
+} btstack_ring_buffer_spsc_t;
+
+/**
+ * Init ring buffer
+ * @param ring_buffer object
+ * @param storage
+ * @param storage_size in bytes, power of two
+ * @return 0 if ok, ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS if storage_size is not a power of two
+ */
+int btstack_ring_buffer_spsc_init(btstack_ring_buffer_spsc_t * ring_buffer, uint8_t * storage, uint32_t storage_size);
+
+/**
+ * Reset ring buffer to initial state (empty). Neither producer nor consumer may access the ring buffer concurrently
+ * @param ring_buffer object
+ */
+void btstack_ring_buffer_spsc_reset(btstack_ring_buffer_spsc_t * ring_buffer);
+
+/**
+ * Get number of bytes available for read, called by consumer
+ * @param ring_buffer object
+ * @return number of bytes available for read
+ */
+uint32_t btstack_ring_buffer_spsc_bytes_available(btstack_ring_buffer_spsc_t * ring_buffer);
+
+/**
+ * Get free space available for write, called by producer
+ * @param ring_buffer object
+ * @return number of bytes available for write
+ */
+uint32_t btstack_ring_buffer_spsc_bytes_free(btstack_ring_buffer_spsc_t * ring_buffer);
+
+/**
+ * Write bytes into ring buffer, called by producer
+ * @param ring_buffer object
+ * @param data to store
+ * @param data_length
+ * @return 0 if ok, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if not enough space in buffer
+ */
+int btstack_ring_buffer_spsc_write(btstack_ring_buffer_spsc_t * ring_buffer, const uint8_t * data, uint32_t data_length);
+
+/**
+ * Read from ring buffer, called by consumer
+ * @param ring_buffer object
+ * @param buffer to store read data
+ * @param length to read
+ * @param number_of_bytes_read
+ */
+void btstack_ring_buffer_spsc_read(btstack_ring_buffer_spsc_t * ring_buffer, uint8_t * buffer, uint32_t length, uint32_t * number_of_bytes_read);
+
+/**
+ * Get contiguous free region for write, called by producer. Data becomes visible to consumer with commit
+ * @param ring_buffer object
+ * @param length of contiguous region, may be smaller than bytes_free at the end of storage
+ * @return start of free region
+ */
+uint8_t * btstack_ring_buffer_spsc_get_write_ptr(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t * length);
+
+/**
+ * Make bytes written to region from get_write_ptr available to consumer
+ * @param ring_buffer object
+ * @param length <= length returned by get_write_ptr
+ */
+void btstack_ring_buffer_spsc_commit(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t length);
+
+/**
+ * Get contiguous region of available data, called by consumer. Region is released with consume
+ * @param ring_buffer object
+ * @param length of contiguous region, may be smaller than bytes_available at the end of storage
+ * @return start of available data
+ */
+const uint8_t * btstack_ring_buffer_spsc_get_read_ptr(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t * length);
+
+/**
+ * Release bytes from region returned by get_read_ptr to producer
+ * @param ring_buffer object
+ * @param length <= length returned by get_read_ptr
+ */
+void btstack_ring_buffer_spsc_consume(btstack_ring_buffer_spsc_t * ring_buffer, uint32_t length);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // BTSTACK_RING_BUFFER_SPSC_H
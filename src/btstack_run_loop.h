@@ -92,6 +92,15 @@ typedef struct btstack_timer_source {
     // will be called when timer fired
     void  (*process)(struct btstack_timer_source *ts); 
     void * context;
+#ifdef ENABLE_RUN_LOOP_TIMER_HEAP
+    // pairing heap used by btstack_run_loop_base, item.next is used as next sibling
+    // leftmost child
+    struct btstack_timer_source * child;
+    // parent for leftmost child, previous sibling otherwise
+    struct btstack_timer_source * prev;
+    // points to timer itself while in heap, a copy or uninitialized timer does not match its own address
+    struct btstack_timer_source * in_heap;
+#endif
 } btstack_timer_source_t;
 
 typedef struct btstack_run_loop {
@@ -74,6 +74,149 @@ void btstack_run_loop_base_disable_data_source_callbacks(btstack_data_source_t *
     ds->flags &= ~callback_types;
 }
 
+#ifdef ENABLE_RUN_LOOP_TIMER_HEAP
+
+// Timers are stored in a pairing heap with btstack_run_loop_base_timers pointing to the root (= next timer to fire)
+// Add: O(1), remove: O(log n) amortized
+// Note: timers with the same timeout are not guaranteed to fire in the order they have been added
+
+static inline bool btstack_run_loop_base_timer_before(const btstack_timer_source_t * a, const btstack_timer_source_t * b){
+    return btstack_time_delta(a->timeout, b->timeout) < 0;
+}
+
+static inline btstack_timer_source_t * btstack_run_loop_base_timer_next(const btstack_timer_source_t * ts){
+    return (btstack_timer_source_t *) ts->item.next;
+}
+
+static inline btstack_timer_source_t * btstack_run_loop_base_timer_root(void){
+    return (btstack_timer_source_t *) btstack_run_loop_base_timers;
+}
+
+// meld two heaps, both roots have no siblings
+static btstack_timer_source_t * btstack_run_loop_base_timer_meld(btstack_timer_source_t * a, btstack_timer_source_t * b){
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (btstack_run_loop_base_timer_before(b, a)){
+        btstack_timer_source_t * tmp = a;
+        a = b;
+        b = tmp;
+    }
+    // b becomes leftmost child of a
+    b->prev = a;
+    b->item.next = (btstack_linked_item_t *) a->child;
+    if (a->child != NULL){
+        a->child->prev = b;
+    }
+    a->child = b;
+    return a;
+}
+
+// two-pass pairing of a list of siblings into a single heap
+static btstack_timer_source_t * btstack_run_loop_base_timer_merge_pairs(btstack_timer_source_t * first){
+    if (first == NULL) return NULL;
+
+    // first pass: meld pairs left to right, collect results in reverse order
+    btstack_timer_source_t * pairs = NULL;
+    while (first != NULL){
+        btstack_timer_source_t * a = first;
+        btstack_timer_source_t * b = btstack_run_loop_base_timer_next(a);
+        first = (b != NULL) ? btstack_run_loop_base_timer_next(b) : NULL;
+        a->item.next = NULL;
+        a->prev = NULL;
+        if (b != NULL){
+            b->item.next = NULL;
+            b->prev = NULL;
+        }
+        btstack_timer_source_t * melded = btstack_run_loop_base_timer_meld(a, b);
+        melded->item.next = (btstack_linked_item_t *) pairs;
+        pairs = melded;
+    }
+
+    // second pass: meld right to left
+    btstack_timer_source_t * result = pairs;
+    pairs = btstack_run_loop_base_timer_next(pairs);
+    result->item.next = NULL;
+    while (pairs != NULL){
+        btstack_timer_source_t * next = btstack_run_loop_base_timer_next(pairs);
+        pairs->item.next = NULL;
+        result = btstack_run_loop_base_timer_meld(result, pairs);
+        pairs = next;
+    }
+    return result;
+}
+
+// marker is set on add and cleared on remove. it is only compared with the timer address,
+// stale links in a copy of a timer or in uninitialized memory are never followed
+static bool btstack_run_loop_base_timer_in_heap(const btstack_timer_source_t * ts){
+    return ts->in_heap == ts;
+}
+
+bool btstack_run_loop_base_remove_timer(btstack_timer_source_t *ts){
+    if (btstack_run_loop_base_timer_in_heap(ts) == false) return false;
+    btstack_timer_source_t * subtree = btstack_run_loop_base_timer_merge_pairs(ts->child);
+    if (ts == btstack_run_loop_base_timer_root()){
+        btstack_run_loop_base_timers = (btstack_linked_item_t *) subtree;
+    } else {
+        // unlink from parent or previous sibling
+        btstack_timer_source_t * next = btstack_run_loop_base_timer_next(ts);
+        if (ts->prev->child == ts){
+            ts->prev->child = next;
+        } else {
+            ts->prev->item.next = (btstack_linked_item_t *) next;
+        }
+        if (next != NULL){
+            next->prev = ts->prev;
+        }
+        btstack_run_loop_base_timers = (btstack_linked_item_t *) btstack_run_loop_base_timer_meld(btstack_run_loop_base_timer_root(), subtree);
+    }
+    ts->item.next = NULL;
+    ts->child = NULL;
+    ts->prev  = NULL;
+    ts->in_heap = NULL;
+    return true;
+}
+
+void btstack_run_loop_base_add_timer(btstack_timer_source_t *ts){
+    // don't add timer that's already in there
+    if (btstack_run_loop_base_timer_in_heap(ts)){
+        log_error( "btstack_run_loop_timer_add error: timer to add already in list!");
+        return;
+    }
+    ts->item.next = NULL;
+    ts->child = NULL;
+    ts->prev  = NULL;
+    ts->in_heap = ts;
+    btstack_run_loop_base_timers = (btstack_linked_item_t *) btstack_run_loop_base_timer_meld(btstack_run_loop_base_timer_root(), ts);
+}
+
+void btstack_run_loop_base_dump_timer(void){
+#ifdef ENABLE_LOG_INFO
+    // pre-order traversal, not sorted by timeout
+    btstack_timer_source_t * ts = btstack_run_loop_base_timer_root();
+    uint16_t i = 0;
+    while (ts != NULL){
+        log_info("timer %u (%p): timeout %u\n", i++, ts, ts->timeout);
+        if (ts->child != NULL){
+            ts = ts->child;
+            continue;
+        }
+        // go up until a node with a next sibling is found
+        while ((ts != NULL) && (ts->item.next == NULL)){
+            // find parent: walk previous siblings back to leftmost child
+            while ((ts->prev != NULL) && (ts->prev->child != ts)){
+                ts = ts->prev;
+            }
+            ts = ts->prev;
+        }
+        if (ts != NULL){
+            ts = btstack_run_loop_base_timer_next(ts);
+        }
+    }
+#endif
+}
+
+#else
+
 bool btstack_run_loop_base_remove_timer(btstack_timer_source_t *ts){
     return btstack_linked_list_remove(&btstack_run_loop_base_timers, (btstack_linked_item_t *) ts);
 }
@@ -95,17 +238,6 @@ void btstack_run_loop_base_add_timer(btstack_timer_source_t *ts){
     it->next = (btstack_linked_item_t *) ts;
 }
 
-void btstack_run_loop_base_process_timers(uint32_t now){
-    // process timers, exit when timeout is in the future
-    while (btstack_run_loop_base_timers) {
-        btstack_timer_source_t * ts = (btstack_timer_source_t *) btstack_run_loop_base_timers;
-        int32_t delta = btstack_time_delta(ts->timeout, now);
-        if (delta > 0) break;
-        btstack_run_loop_base_remove_timer(ts);
-        ts->process(ts);
-    }
-}
-
 void btstack_run_loop_base_dump_timer(void){
 #ifdef ENABLE_LOG_INFO
     btstack_linked_item_t *it;
@@ -117,6 +249,20 @@ void btstack_run_loop_base_dump_timer(void){
 #endif
 
 }
+
+#endif
+
+void btstack_run_loop_base_process_timers(uint32_t now){
+    // process timers, exit when timeout is in the future
+    while (btstack_run_loop_base_timers) {
+        btstack_timer_source_t * ts = (btstack_timer_source_t *) btstack_run_loop_base_timers;
+        int32_t delta = btstack_time_delta(ts->timeout, now);
+        if (delta > 0) break;
+        btstack_run_loop_base_remove_timer(ts);
+        ts->process(ts);
+    }
+}
+
 /**
  * @brief Get time until first timer fires
  * @returns -1 if no timers, time until next timeout otherwise
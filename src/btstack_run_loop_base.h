@@ -55,6 +55,7 @@ extern "C" {
 #endif
 
 // private data (access only by run loop implementations)
+// with ENABLE_RUN_LOOP_TIMER_HEAP, btstack_run_loop_base_timers points to the root of a pairing heap
 extern btstack_linked_list_t btstack_run_loop_base_timers;
 extern btstack_linked_list_t btstack_run_loop_base_data_sources;
 	
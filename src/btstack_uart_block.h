@@ -143,6 +143,18 @@ typedef struct {
      */
     void (*set_wakeup_handler)(void (*wakeup_handler)(void));
 
+    // optional support for streaming receive, e.g. used by H4 with ENABLE_H4_RX_STREAMING
+
+    /**
+     * set callback for bytes received via receive_bytes. NULL disables callback
+     */
+    void (*set_bytes_received)(void (*bytes_handler)(uint16_t num_bytes));
+
+    /**
+     * receive up to len bytes, bytes received handler is called as soon as at least one byte was received
+     */
+    void (*receive_bytes)(uint8_t *buffer, uint16_t len);
+
 } btstack_uart_block_t;
 
 // common implementations
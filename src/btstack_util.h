@@ -288,6 +288,30 @@ int count_set_bits_uint32(uint32_t x);
 uint8_t btstack_crc8_check(uint8_t *data, uint16_t len, uint8_t check_sum);
 uint8_t btstack_crc8_calc(uint8_t *data, uint16_t len);
 
+/**
+ * CRC16 functions with polynomial x^16 + x^15 + x^2 + 1, LSB first, initial value 0.
+ * Used by L2CAP for the FCS in Enhanced Retransmission Mode
+ */
+uint16_t btstack_crc16_calc(const uint8_t * data, uint16_t len);
+
+/**
+ * @brief Continue CRC16 calculation, e.g. for data split across several buffers
+ * @param crc of previous data, 0 for first buffer
+ * @param data
+ * @param len
+ * @return crc
+ */
+uint16_t btstack_crc16_update(uint16_t crc, const uint8_t * data, uint16_t len);
+
+/**
+ * @brief Get CRC16 of concatenated data A|B from CRC16 of A and B without accessing the data
+ * @param crc_a
+ * @param crc_b
+ * @param len_b of data B
+ * @return crc
+ */
+uint16_t btstack_crc16_combine(uint16_t crc_a, uint16_t crc_b, uint16_t len_b);
+
 /* API_END */
 
 #if defined __cplusplus
@@ -81,6 +81,11 @@
 
 #define RFCOMM_CREDITS 10
 
+// max number of credits the remote gets with automatic credits, <= 255
+#ifndef RFCOMM_CREDITS_MAX
+#define RFCOMM_CREDITS_MAX 64
+#endif
+
 // FCS calc 
 #define BT_RFCOMM_CODE_WORD         0xE0 // pol = x8+x2+x1+1
 #define BT_RFCOMM_CRC_CHECK_LEN     3
@@ -183,6 +188,8 @@ static uint8_t outgoing_buffer[1030];
 static int  rfcomm_channel_can_send(rfcomm_channel_t * channel);
 static int  rfcomm_channel_ready_for_open(rfcomm_channel_t *channel);
 static int rfcomm_channel_ready_to_send(rfcomm_channel_t * channel);
+static int  rfcomm_channel_stream_ready(rfcomm_channel_t * channel);
+static void rfcomm_channel_stream_run(rfcomm_channel_t * channel);
 static void rfcomm_channel_state_machine_with_channel(rfcomm_channel_t *channel, const rfcomm_channel_event_t *event, int * out_channel_valid);
 static void rfcomm_channel_state_machine_with_dlci(rfcomm_multiplexer_t * multiplexer, uint8_t dlci, const rfcomm_channel_event_t *event);
 static void rfcomm_emit_can_send_now(rfcomm_channel_t *channel);
@@ -283,8 +290,26 @@ static void rfcomm_emit_channel_opened(rfcomm_channel_t *channel, uint8_t status
     }
 }
 
+// data: event(8), len(8), rfcomm_cid(16), status(8), num_bytes(32), duration_ms(32)
+static void rfcomm_emit_stream_complete(rfcomm_channel_t * channel, uint8_t status){
+    log_info("RFCOMM_EVENT_STREAM_COMPLETE cid 0x%02x, status 0x%02x, %u bytes", channel->rfcomm_cid, status, (unsigned int) channel->stream_bytes_sent);
+    channel->stream_active = 0;
+    uint8_t event[13];
+    event[0] = RFCOMM_EVENT_STREAM_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    little_endian_store_16(event, 2, channel->rfcomm_cid);
+    event[4] = status;
+    little_endian_store_32(event, 5, channel->stream_bytes_sent);
+    little_endian_store_32(event, 9, btstack_run_loop_get_time_ms() - channel->stream_start_ms);
+    hci_dump_packet(HCI_EVENT_PACKET, 0, event, sizeof(event));
+    (channel->packet_handler)(HCI_EVENT_PACKET, channel->rfcomm_cid, event, sizeof(event));
+}
+
 // data: event(8), len(8), rfcomm_cid(16)
 static void rfcomm_emit_channel_closed(rfcomm_channel_t * channel) {
+    if (channel->stream_active){
+        rfcomm_emit_stream_complete(channel, RFCOMM_STREAM_CHANNEL_CLOSED);
+    }
     log_info("RFCOMM_EVENT_CHANNEL_CLOSED cid 0x%02x", channel->rfcomm_cid);
     uint8_t event[4];
     event[0] = RFCOMM_EVENT_CHANNEL_CLOSED;
@@ -472,6 +497,11 @@ static void rfcomm_channel_initialize(rfcomm_channel_t *channel, rfcomm_multiple
     // incoming flow control not active
     channel->new_credits_incoming  = RFCOMM_CREDITS;
     channel->incoming_flow_control = 0;
+    channel->credits_target        = RFCOMM_CREDITS;
+    channel->credits_grant_balance = 0;
+    channel->credits_grant_frames  = 0;
+
+    channel->stream_active         = 0;
 
     channel->rls_line_status       = RFCOMM_RLS_STATUS_INVALID;
 
@@ -985,6 +1015,17 @@ static void rfcomm_handle_can_send_now(uint16_t l2cap_cid){
         }
     }
 
+    // forward token to active stream
+    btstack_linked_list_iterator_init(&it, &rfcomm_channels);
+    while (!token_consumed && btstack_linked_list_iterator_has_next(&it)){
+        rfcomm_channel_t * channel = (rfcomm_channel_t *) btstack_linked_list_iterator_next(&it);
+        if (channel->multiplexer->l2cap_cid != l2cap_cid) continue;
+        if (!rfcomm_channel_stream_ready(channel)) continue;
+        log_debug("rfcomm_handle_can_send_now enter: stream token");
+        token_consumed = 1;
+        rfcomm_channel_stream_run(channel);
+    }
+
     // forward token to client
     btstack_linked_list_iterator_init(&it, &rfcomm_channels);
     while (!token_consumed && btstack_linked_list_iterator_has_next(&it)){
@@ -1381,17 +1422,153 @@ static void rfcomm_multiplexer_state_machine(rfcomm_multiplexer_t * multiplexer,
 
 // MARK: RFCOMM CHANNEL
 
-static void rfcomm_channel_send_credits(rfcomm_channel_t *channel, uint8_t credits){
+// remember how many credits the remote had left when new credits were granted
+static void rfcomm_channel_credits_granted(rfcomm_channel_t *channel, uint8_t credits){
+    // start new measurement unless first frame with credits from previous grant is still outstanding
+    if ((channel->credits_grant_balance == 0) || (channel->credits_grant_frames > channel->credits_grant_balance)){
+        channel->credits_grant_balance = channel->credits_incoming;
+        channel->credits_grant_frames  = 0;
+        channel->credits_grant_time_ms = btstack_run_loop_get_time_ms();
+    }
     channel->credits_incoming += credits;
+}
+
+static void rfcomm_channel_send_credits(rfcomm_channel_t *channel, uint8_t credits){
+    rfcomm_channel_credits_granted(channel, credits);
     rfcomm_send_uih_credits(channel->multiplexer, channel->dlci, credits);
 }
 
+// automatic credits: double target if remote had to wait for credits, top up if half of the credits are used
+static int rfcomm_channel_automatic_credits_frame_received(rfcomm_channel_t *channel){
+    uint32_t now = btstack_run_loop_get_time_ms();
+
+    // remote used all credits
+    int starved = channel->credits_incoming == 0;
+
+    // first frame with credits from last grant: remote waited for them if it arrives after a longer pause
+    if (channel->credits_grant_frames < 0xffff){
+        channel->credits_grant_frames++;
+    }
+    if ((channel->credits_grant_balance > 0) && (channel->credits_grant_frames == (channel->credits_grant_balance + 1))){
+        uint32_t frame_interval_ms = (channel->credits_last_rx_ms - channel->credits_grant_time_ms) / channel->credits_grant_balance;
+        if ((now - channel->credits_last_rx_ms) > ((2 * frame_interval_ms) + 1)){
+            starved = 1;
+        }
+    }
+    channel->credits_last_rx_ms = now;
+
+    if (starved && (channel->credits_target < RFCOMM_CREDITS_MAX)){
+        channel->credits_target = (uint8_t) btstack_min(2 * channel->credits_target, RFCOMM_CREDITS_MAX);
+        log_info("RFCOMM cid 0x%02x, remote waited for credits, target %u", channel->rfcomm_cid, channel->credits_target);
+    }
+
+    if ((channel->credits_incoming + channel->new_credits_incoming) > (channel->credits_target / 2)) return 0;
+    channel->new_credits_incoming = channel->credits_target - channel->credits_incoming;
+    return 1;
+}
+
 static int rfcomm_channel_can_send(rfcomm_channel_t * channel){
     if (!channel->credits_outgoing) return 0;
     if ((channel->multiplexer->fcon & 1) == 0) return 0;
     return l2cap_can_send_packet_now(channel->multiplexer->l2cap_cid);
 }
 
+// MARK: RFCOMM STREAM
+
+static int rfcomm_channel_stream_ready(rfcomm_channel_t * channel){
+    if (!channel->stream_active) return 0;
+    if (channel->state != RFCOMM_CHANNEL_OPEN) return 0;
+    if (!channel->credits_outgoing) return 0;
+    return (channel->multiplexer->fcon & 1) != 0;
+}
+
+// max payload for frame with 2 byte length field and optional credits field
+static uint16_t rfcomm_channel_stream_max_payload(rfcomm_channel_t * channel, uint8_t credits_len){
+    // address + control + length (16) + fcs
+#ifdef RFCOMM_USE_OUTGOING_BUFFER
+    uint16_t max_frame_size = sizeof(outgoing_buffer) - 5;
+#else
+    uint16_t max_frame_size = l2cap_max_mtu() - 5;
+#endif
+    max_frame_size = btstack_min(max_frame_size, channel->multiplexer->max_frame_size) - credits_len;
+    return btstack_min(max_frame_size, channel->max_frame_size);
+}
+
+// send UIH frames as long as there are credits and L2CAP can send, pending credits are sent in UIH_PF frame
+static void rfcomm_channel_stream_run(rfcomm_channel_t * channel){
+    rfcomm_multiplexer_t * multiplexer = channel->multiplexer;
+    while (rfcomm_channel_stream_ready(channel) && l2cap_can_send_packet_now(multiplexer->l2cap_cid)){
+
+        uint8_t credits = channel->new_credits_incoming;
+        uint8_t header_len = (credits > 0) ? 5 : 4;
+        uint16_t max_payload = rfcomm_channel_stream_max_payload(channel, header_len - 4);
+
+#ifdef RFCOMM_USE_OUTGOING_BUFFER
+        uint8_t * rfcomm_out_buffer = outgoing_buffer;
+#else
+        l2cap_reserve_packet_buffer();
+        uint8_t * rfcomm_out_buffer = l2cap_get_outgoing_buffer();
+#endif
+        uint16_t len;
+        if (channel->stream_pull_callback != NULL){
+            len = (*channel->stream_pull_callback)(channel->rfcomm_cid, &rfcomm_out_buffer[header_len], max_payload);
+            btstack_assert(len <= max_payload);
+        } else {
+            len = (uint16_t) btstack_min(channel->stream_size - channel->stream_bytes_sent, max_payload);
+            (void)memcpy(&rfcomm_out_buffer[header_len], &channel->stream_data[channel->stream_bytes_sent], len);
+        }
+        if (len == 0){
+#ifndef RFCOMM_USE_OUTGOING_BUFFER
+            l2cap_release_packet_buffer();
+#endif
+            rfcomm_emit_stream_complete(channel, ERROR_CODE_SUCCESS);
+            break;
+        }
+
+        uint16_t pos = 0;
+        rfcomm_out_buffer[pos++] = (1 << 0) | (multiplexer->outgoing << 1) | (channel->dlci << 2);
+        rfcomm_out_buffer[pos++] = (credits > 0) ? BT_RFCOMM_UIH_PF : BT_RFCOMM_UIH;
+        rfcomm_out_buffer[pos++] = (len & 0x7f) << 1; // bits 0-6
+        rfcomm_out_buffer[pos++] = len >> 7;          // bits 7-14
+        if (credits > 0){
+            rfcomm_out_buffer[pos++] = credits;
+        }
+        pos += len;
+        rfcomm_out_buffer[pos++] = (credits > 0) ? channel->stream_fcs_uih_pf : channel->stream_fcs_uih;
+
+        // send might cause l2cap to emit new credits, update counters first
+        channel->credits_outgoing--;
+        if (credits > 0){
+            channel->new_credits_incoming = 0;
+            rfcomm_channel_credits_granted(channel, credits);
+        }
+
+#ifdef RFCOMM_USE_OUTGOING_BUFFER
+        int err = l2cap_send(multiplexer->l2cap_cid, rfcomm_out_buffer, pos);
+#else
+        int err = l2cap_send_prepared(multiplexer->l2cap_cid, pos);
+#endif
+        if (err != 0){
+            log_error("rfcomm_channel_stream_run: error %d", err);
+#ifndef RFCOMM_USE_OUTGOING_BUFFER
+            l2cap_release_packet_buffer();
+#endif
+            channel->credits_outgoing++;
+            if (credits > 0){
+                channel->credits_incoming -= credits;
+                channel->new_credits_incoming = credits;
+            }
+            rfcomm_emit_stream_complete(channel, (uint8_t) err);
+            break;
+        }
+
+        channel->stream_bytes_sent += len;
+        if ((channel->stream_pull_callback == NULL) && (channel->stream_bytes_sent == channel->stream_size)){
+            rfcomm_emit_stream_complete(channel, ERROR_CODE_SUCCESS);
+        }
+    }
+}
+
 static void rfcomm_channel_opened(rfcomm_channel_t *rfChannel){
     
     log_info("rfcomm_channel_opened!");
@@ -1439,7 +1616,7 @@ static void rfcomm_channel_packet_handler_uih(rfcomm_multiplexer_t *multiplexer,
         int rfcomm_channel_valid = 1;
         rfcomm_channel_state_machine_with_channel(channel, &channel_event, &rfcomm_channel_valid);
         if (rfcomm_channel_valid){
-            if (rfcomm_channel_ready_to_send(channel) || channel->waiting_for_can_send_now){
+            if (rfcomm_channel_ready_to_send(channel) || channel->waiting_for_can_send_now || rfcomm_channel_stream_ready(channel)){
                 request_can_send_now = 1;
             }
         }        
@@ -1454,18 +1631,17 @@ static void rfcomm_channel_packet_handler_uih(rfcomm_multiplexer_t *multiplexer,
         if (channel->credits_incoming > 0){
             channel->credits_incoming--;
         }
-        
+
+        // automatically provide new credits to remote device, if no incoming flow control
+        if (!channel->incoming_flow_control && rfcomm_channel_automatic_credits_frame_received(channel)){
+            request_can_send_now = 1;
+        }
+
         // deliver payload
         (channel->packet_handler)(RFCOMM_DATA_PACKET, channel->rfcomm_cid,
                               &packet[payload_offset], size-payload_offset-1);
     }
     
-    // automatically provide new credits to remote device, if no incoming flow control
-    if (!channel->incoming_flow_control && (channel->credits_incoming < 5)){
-        channel->new_credits_incoming = RFCOMM_CREDITS;
-        request_can_send_now = 1;
-    }    
-
     if (request_can_send_now){
         l2cap_request_can_send_now_event(multiplexer->l2cap_cid);
     }
@@ -1796,7 +1972,8 @@ static int rfcomm_channel_ready_to_send(rfcomm_channel_t * channel){
             log_debug("ch-ready: state %u", channel->state);
             return 1;
         case RFCOMM_CHANNEL_OPEN:
-            if (channel->new_credits_incoming) { 
+            // new credits are sent with stream data if possible
+            if (channel->new_credits_incoming && !rfcomm_channel_stream_ready(channel)) {
                 log_debug("ch-ready: channel open & new_credits_incoming") ; 
                 return 1;
             }
@@ -2359,6 +2536,48 @@ int rfcomm_send(uint16_t rfcomm_cid, uint8_t *data, uint16_t len){
     return err;
 }
 
+static uint8_t rfcomm_stream_start(uint16_t rfcomm_cid, const uint8_t * data, uint32_t data_len, rfcomm_stream_pull_t pull_callback){
+    rfcomm_channel_t * channel = rfcomm_channel_for_rfcomm_cid(rfcomm_cid);
+    if (!channel){
+        log_error("rfcomm_stream_send cid 0x%02x doesn't exist!", rfcomm_cid);
+        return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    }
+    if (channel->state != RFCOMM_CHANNEL_OPEN) return ERROR_CODE_COMMAND_DISALLOWED;
+    if (channel->stream_active) return ERROR_CODE_COMMAND_DISALLOWED;
+
+    channel->stream_active = 1;
+    channel->stream_pull_callback = pull_callback;
+    channel->stream_data = data;
+    channel->stream_size = data_len;
+    channel->stream_bytes_sent = 0;
+    channel->stream_start_ms = btstack_run_loop_get_time_ms();
+
+    uint8_t header[2];
+    header[0] = (1 << 0) | (channel->multiplexer->outgoing << 1) | (channel->dlci << 2);
+    header[1] = BT_RFCOMM_UIH;
+    channel->stream_fcs_uih = btstack_crc8_calc(header, 2);
+    header[1] = BT_RFCOMM_UIH_PF;
+    channel->stream_fcs_uih_pf = btstack_crc8_calc(header, 2);
+
+    if ((pull_callback == NULL) && (data_len == 0)){
+        rfcomm_emit_stream_complete(channel, ERROR_CODE_SUCCESS);
+        return ERROR_CODE_SUCCESS;
+    }
+
+    if (rfcomm_channel_stream_ready(channel)){
+        l2cap_request_can_send_now_event(channel->multiplexer->l2cap_cid);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t rfcomm_stream_send(uint16_t rfcomm_cid, const uint8_t * data, uint32_t data_len){
+    return rfcomm_stream_start(rfcomm_cid, data, data_len, NULL);
+}
+
+uint8_t rfcomm_stream_send_with_callback(uint16_t rfcomm_cid, rfcomm_stream_pull_t pull_callback){
+    return rfcomm_stream_start(rfcomm_cid, NULL, 0, pull_callback);
+}
+
 // Sends Local Lnie Status, see LINE_STATUS_..
 int rfcomm_send_local_line_status(uint16_t rfcomm_cid, uint8_t line_status){
     rfcomm_channel_t * channel = rfcomm_channel_for_rfcomm_cid(rfcomm_cid);
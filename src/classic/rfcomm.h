@@ -127,6 +127,15 @@ typedef struct rfcomm_rpn_data {
     uint8_t parameter_mask_1;   // second byte
 } rfcomm_rpn_data_t;
 
+/**
+ * @brief Pull callback for rfcomm_stream_send_with_callback
+ * @param rfcomm_cid
+ * @param buffer to store payload of next UIH frame
+ * @param buffer_size max number of bytes that fit into the frame
+ * @return number of bytes stored in buffer, 0 ends the stream
+ */
+typedef uint16_t (*rfcomm_stream_pull_t)(uint16_t rfcomm_cid, uint8_t * buffer, uint16_t buffer_size);
+
 // info regarding potential connections
 typedef struct {
     // linked list - assert: first field
@@ -246,7 +255,25 @@ typedef struct {
 
     //
     uint8_t   waiting_for_can_send_now;
-        
+
+    // automatic credits: number of credits the remote should have, state of last grant
+    uint8_t   credits_target;
+    uint8_t   credits_grant_balance;
+    uint16_t  credits_grant_frames;
+    uint32_t  credits_grant_time_ms;
+    uint32_t  credits_last_rx_ms;
+
+    // stream
+    uint8_t                stream_active;
+    rfcomm_stream_pull_t   stream_pull_callback;
+    const uint8_t *        stream_data;
+    uint32_t               stream_size;
+    uint32_t               stream_bytes_sent;
+    uint32_t               stream_start_ms;
+    // FCS for UIH frames only covers address and control
+    uint8_t                stream_fcs_uih;
+    uint8_t                stream_fcs_uih_pf;
+
 } rfcomm_channel_t;
 
 // struct used in ERTM callback
@@ -364,6 +391,33 @@ void rfcomm_request_can_send_now_event(uint16_t rfcomm_cid);
  */
 int  rfcomm_send(uint16_t rfcomm_cid, uint8_t *data, uint16_t len);
 
+/**
+ * @brief Streams a large buffer over the RFCOMM channel. The data is split into UIH frames of max frame size.
+ *        Whenever L2CAP can send, frames are sent back-to-back as long as there are outgoing credits.
+ *        New incoming credits are sent along with the data instead of in separate frames.
+ *        RFCOMM_EVENT_STREAM_COMPLETE reports status, number of bytes and duration once the last frame
+ *        has been sent or the channel was closed.
+ * @note  Don't use rfcomm_send or rfcomm_send_prepared while a stream is active
+ * @param rfcomm_cid
+ * @param data is not copied, make sure memory is accessible until stream is complete
+ * @param data_len
+ * @return status ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, if channel does not exist
+ *                ERROR_CODE_COMMAND_DISALLOWED            , if channel is not open or a stream is already active
+ *                ERROR_CODE_SUCCESS                       , if stream was started
+ */
+uint8_t rfcomm_stream_send(uint16_t rfcomm_cid, const uint8_t * data, uint32_t data_len);
+
+/**
+ * @brief Streams data over the RFCOMM channel with data provided by a pull callback. The callback fills
+ *        the outgoing packet buffer directly and ends the stream by returning 0. See rfcomm_stream_send for details.
+ * @param rfcomm_cid
+ * @param pull_callback
+ * @return status ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, if channel does not exist
+ *                ERROR_CODE_COMMAND_DISALLOWED            , if channel is not open or a stream is already active
+ *                ERROR_CODE_SUCCESS                       , if stream was started
+ */
+uint8_t rfcomm_stream_send_with_callback(uint16_t rfcomm_cid, rfcomm_stream_pull_t pull_callback);
+
 /** 
  * @brief Sends Local Line Status, see LINE_STATUS_..
  * @param rfcomm_cid
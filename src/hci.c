@@ -222,6 +222,20 @@ static hci_connection_t * create_connection_for_bd_addr_and_type(const bd_addr_t
     return conn;
 }
 
+static void hci_connection_set_con_handle(hci_connection_t * conn, hci_con_handle_t con_handle){
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    if (conn->con_handle != HCI_CON_HANDLE_INVALID){
+        btstack_hash_index_remove(&hci_stack->connection_index, conn->con_handle, conn);
+    }
+    if (con_handle != HCI_CON_HANDLE_INVALID){
+        if (btstack_hash_index_add(&hci_stack->connection_index, con_handle, conn) == false){
+            log_info("connection index full, use linear search");
+        }
+    }
+#endif
+    conn->con_handle = con_handle;
+}
+
 
 /**
  * get le connection parameter range
@@ -289,6 +303,13 @@ void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
  * @return connection OR NULL, if not found
  */
 hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    if (con_handle != HCI_CON_HANDLE_INVALID){
+        hci_connection_t * connection = (hci_connection_t *) btstack_hash_index_get(&hci_stack->connection_index, con_handle);
+        if (connection != NULL) return connection;
+        if (btstack_hash_index_complete(&hci_stack->connection_index)) return NULL;
+    }
+#endif
     btstack_linked_list_iterator_t it;
     btstack_linked_list_iterator_init(&it, &hci_stack->connections);
     while (btstack_linked_list_iterator_has_next(&it)){
@@ -531,6 +552,135 @@ int hci_number_free_acl_slots_for_handle(hci_con_handle_t con_handle){
     return hci_number_free_acl_slots_for_connection_type(connection->address_type);
 }
 
+// max ACL data packet length depends on connection type (LE vs. Classic) and available buffers
+static uint16_t hci_max_acl_data_packet_length_for_connection(hci_connection_t * connection){
+    uint16_t max_acl_data_packet_length = hci_stack->acl_data_packet_length;
+    if (hci_is_le_connection(connection) && (hci_stack->le_data_packets_length > 0u)){
+        max_acl_data_packet_length = hci_stack->le_data_packets_length;
+    }
+
+#ifdef ENABLE_LE_LIMIT_ACL_FRAGMENT_BY_MAX_OCTETS
+    if (hci_is_le_connection(connection)){
+        max_acl_data_packet_length = connection->le_max_tx_octets;
+    }
+#endif
+    return max_acl_data_packet_length;
+}
+
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+
+#define ACL_QUEUE_TX_NONE 0xffu
+
+static uint8_t * hci_acl_queue_buffer_for_index(uint8_t buffer_index){
+    if (buffer_index == 0u){
+        return &hci_stack->hci_packet_buffer_data[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    }
+    return &hci_stack->acl_queue_buffer_data[buffer_index - 1u][HCI_OUTGOING_PRE_BUFFER_SIZE];
+}
+
+// use first buffer that is not used by a queued ACL packet as hci_packet_buffer
+static void hci_acl_queue_select_packet_buffer(void){
+    uint8_t buffer_index;
+    for (buffer_index = 0; buffer_index < HCI_OUTGOING_ACL_QUEUE_SIZE; buffer_index++){
+        bool used = false;
+        uint8_t i;
+        for (i = 0; i < hci_stack->acl_queue_len; i++){
+            if (hci_stack->acl_queue[i].buffer_index == buffer_index){
+                used = true;
+                break;
+            }
+        }
+        if (used == false) break;
+    }
+    hci_stack->hci_packet_buffer_index = buffer_index;
+    hci_stack->hci_packet_buffer = hci_acl_queue_buffer_for_index(buffer_index);
+}
+
+static void hci_acl_queue_reset(void){
+    hci_stack->acl_queue_len = 0;
+    hci_stack->acl_queue_tx_index = ACL_QUEUE_TX_NONE;
+    hci_acl_queue_select_packet_buffer();
+}
+
+static void hci_acl_queue_remove(uint8_t queue_index){
+    uint8_t num_following = hci_stack->acl_queue_len - queue_index - 1u;
+    (void)memmove(&hci_stack->acl_queue[queue_index], &hci_stack->acl_queue[queue_index + 1u], num_following * sizeof(hci_outgoing_acl_packet_t));
+    hci_stack->acl_queue_len--;
+    if ((hci_stack->acl_queue_tx_index != ACL_QUEUE_TX_NONE) && (hci_stack->acl_queue_tx_index > queue_index)){
+        hci_stack->acl_queue_tx_index--;
+    }
+}
+
+// number of queued packets for connection where sending did not start yet
+static uint8_t hci_acl_queue_num_waiting_packets_for_handle(hci_con_handle_t con_handle){
+    uint8_t num_packets = 0;
+    uint8_t i;
+    for (i = 0; i < hci_stack->acl_queue_len; i++){
+        const hci_outgoing_acl_packet_t * acl_packet = &hci_stack->acl_queue[i];
+        if ((acl_packet->con_handle == con_handle) && (acl_packet->pos == 4u)){
+            num_packets++;
+        }
+    }
+    return num_packets;
+}
+
+static int hci_acl_queue_num_acl_connections(void){
+    int num_connections = 0;
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) hci_stack->connections; it != NULL; it = it->next){
+        hci_connection_t * connection = (hci_connection_t *) it;
+        if (connection->address_type != BD_ADDR_TYPE_SCO){
+            num_connections++;
+        }
+    }
+    return num_connections;
+}
+
+// number of fragments of queued ACL packets that have not been sent yet and use the same controller buffers as given connection type
+static int hci_acl_queue_num_pending_fragments(bd_addr_type_t address_type){
+    const bool is_le = address_type != BD_ADDR_TYPE_ACL;
+    const bool shared_buffers = hci_stack->le_acl_packets_total_num == 0u;
+    int num_fragments = 0;
+    uint8_t i;
+    for (i = 0; i < hci_stack->acl_queue_len; i++){
+        const hci_outgoing_acl_packet_t * acl_packet = &hci_stack->acl_queue[i];
+        hci_connection_t * connection = hci_connection_for_handle(acl_packet->con_handle);
+        if (connection == NULL) continue;
+        if ((shared_buffers == false) && (hci_is_le_connection(connection) != is_le)) continue;
+        uint16_t bytes_to_send = acl_packet->size - acl_packet->pos;
+        if (bytes_to_send == 0u) continue;
+        uint16_t max_acl_data_packet_length = hci_max_acl_data_packet_length_for_connection(connection);
+        if (max_acl_data_packet_length == 0u){
+            num_fragments++;
+        } else {
+            num_fragments += (bytes_to_send + max_acl_data_packet_length - 1u) / max_acl_data_packet_length;
+        }
+    }
+    return num_fragments;
+}
+
+static bool hci_acl_queue_can_add_for_address_type(bd_addr_type_t address_type){
+    if (hci_stack->acl_queue_len >= HCI_OUTGOING_ACL_QUEUE_SIZE) return false;
+    // only accept packets that can be sent with the ACL buffers left on the controller
+    return (hci_number_free_acl_slots_for_connection_type(address_type) - hci_acl_queue_num_pending_fragments(address_type)) > 0;
+}
+
+static bool hci_acl_queue_can_add(hci_con_handle_t con_handle){
+    hci_connection_t * connection = hci_connection_for_handle(con_handle);
+    if (connection == NULL){
+        log_error("hci_acl_queue_can_add: handle 0x%04x not in connection list", con_handle);
+        return false;
+    }
+    if (hci_acl_queue_can_add_for_address_type(connection->address_type) == false) return false;
+    // limit waiting packets per connection, so a single connection cannot block all others
+    int max_waiting_packets = HCI_OUTGOING_ACL_QUEUE_SIZE / btstack_max(1, hci_acl_queue_num_acl_connections());
+    if (max_waiting_packets < 1){
+        max_waiting_packets = 1;
+    }
+    return hci_acl_queue_num_waiting_packets_for_handle(con_handle) < max_waiting_packets;
+}
+#endif
+
 #ifdef ENABLE_CLASSIC
 static int hci_number_free_sco_slots(void){
     unsigned int num_sco_packets_sent  = 0;
@@ -587,8 +737,13 @@ static int hci_transport_can_send_prepared_packet_now(uint8_t packet_type){
 }
 
 static int hci_can_send_prepared_acl_packet_for_address_type(bd_addr_type_t address_type){
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    // packet gets queued if transport is busy
+    return hci_acl_queue_can_add_for_address_type(address_type) ? 1 : 0;
+#else
     if (!hci_transport_can_send_prepared_packet_now(HCI_ACL_DATA_PACKET)) return 0;
     return hci_number_free_acl_slots_for_connection_type(address_type) > 0;
+#endif
 }
 
 int hci_can_send_acl_le_packet_now(void){
@@ -597,8 +752,13 @@ int hci_can_send_acl_le_packet_now(void){
 }
 
 int hci_can_send_prepared_acl_packet_now(hci_con_handle_t con_handle) {
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    // packet gets queued if transport is busy
+    return hci_acl_queue_can_add(con_handle) ? 1 : 0;
+#else
     if (!hci_transport_can_send_prepared_packet_now(HCI_ACL_DATA_PACKET)) return 0;
     return hci_number_free_acl_slots_for_handle(con_handle) > 0;
+#endif
 }
 
 int hci_can_send_acl_packet_now(hci_con_handle_t con_handle){
@@ -656,22 +816,127 @@ static int hci_transport_synchronous(void){
     return hci_stack->hci_transport->can_send_packet_now == NULL;
 }
 
-static int hci_send_acl_packet_fragments(hci_connection_t *connection){
+// send single fragment of ACL packet in buffer, fragment payload starts at pos
+static int hci_send_acl_fragment(hci_connection_t * connection, uint8_t * buffer, uint16_t pos, uint16_t len){
 
-    // log_info("hci_send_acl_packet_fragments  %u/%u (con 0x%04x)", hci_stack->acl_fragmentation_pos, hci_stack->acl_fragmentation_total_size, connection->con_handle);
+    const uint16_t acl_header_pos = pos - 4u;
 
-    // max ACL data packet length depends on connection type (LE vs. Classic) and available buffers
-    uint16_t max_acl_data_packet_length = hci_stack->acl_data_packet_length;
-    if (hci_is_le_connection(connection) && (hci_stack->le_data_packets_length > 0u)){
-        max_acl_data_packet_length = hci_stack->le_data_packets_length;
+    // copy handle_and_flags if not first fragment and update packet boundary flags to be 01 (continuing fragmnent)
+    if (acl_header_pos > 0u){
+        uint16_t handle_and_flags = little_endian_read_16(buffer, 0);
+        handle_and_flags = (handle_and_flags & 0xcfffu) | (1u << 12u);
+        little_endian_store_16(buffer, acl_header_pos, handle_and_flags);
     }
 
-#ifdef ENABLE_LE_LIMIT_ACL_FRAGMENT_BY_MAX_OCTETS
-    if (hci_is_le_connection(connection)){
-        max_acl_data_packet_length = connection->le_max_tx_octets;
+    // update header len
+    little_endian_store_16(buffer, acl_header_pos + 2u, len);
+
+    // count packet
+    connection->num_packets_sent++;
+
+    // send packet
+    uint8_t * packet = &buffer[acl_header_pos];
+    const int size = len + 4;
+    hci_dump_packet(HCI_ACL_DATA_PACKET, 0, packet, size);
+    return hci_stack->hci_transport->send_packet(HCI_ACL_DATA_PACKET, packet, size);
+}
+
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+// called when transport has sent fragment of queued ACL packet
+static void hci_acl_queue_fragment_sent(void){
+    uint8_t queue_index = hci_stack->acl_queue_tx_index;
+    hci_stack->acl_queue_tx_index = ACL_QUEUE_TX_NONE;
+    if (queue_index >= hci_stack->acl_queue_len) return;
+    hci_outgoing_acl_packet_t * acl_packet = &hci_stack->acl_queue[queue_index];
+    if (acl_packet->pos < acl_packet->size) return;
+    // packet complete, its buffer becomes available
+    hci_acl_queue_remove(queue_index);
+}
+
+// drop queued ACL packets for closed connection, fragment currently sent by transport completes packet
+static void hci_acl_queue_drop_packets_for_handle(hci_con_handle_t con_handle){
+    uint8_t queue_index = 0;
+    while (queue_index < hci_stack->acl_queue_len){
+        hci_outgoing_acl_packet_t * acl_packet = &hci_stack->acl_queue[queue_index];
+        if (acl_packet->con_handle != con_handle){
+            queue_index++;
+        } else if (queue_index == hci_stack->acl_queue_tx_index){
+            log_info("hci_acl_queue: drop remaining fragments for closed connection 0x%04x", con_handle);
+            acl_packet->pos = acl_packet->size;
+            queue_index++;
+        } else {
+            log_info("hci_acl_queue: drop ACL packet for closed connection 0x%04x", con_handle);
+            hci_acl_queue_remove(queue_index);
+        }
+    }
+}
+
+// index of first queued packet that can be sent now. packets of a connection are sent in order
+static uint8_t hci_acl_queue_next_packet(void){
+    uint8_t queue_index = 0;
+    while (queue_index < hci_stack->acl_queue_len){
+        hci_con_handle_t con_handle = hci_stack->acl_queue[queue_index].con_handle;
+        hci_connection_t * connection = hci_connection_for_handle(con_handle);
+        if (connection == NULL){
+            log_info("hci_acl_queue: drop ACL packet for closed connection 0x%04x", con_handle);
+            hci_acl_queue_remove(queue_index);
+            continue;
+        }
+        bool first_for_connection = true;
+        uint8_t i;
+        for (i = 0; i < queue_index; i++){
+            if (hci_stack->acl_queue[i].con_handle == con_handle){
+                first_for_connection = false;
+                break;
+            }
+        }
+        if (first_for_connection && (hci_number_free_acl_slots_for_connection_type(connection->address_type) > 0)){
+            return queue_index;
+        }
+        queue_index++;
+    }
+    return ACL_QUEUE_TX_NONE;
+}
+
+// send fragments of queued ACL packets as long as transport and controller accept them. @returns true if fragment was sent
+static bool hci_acl_queue_run(void){
+    bool fragment_sent = false;
+    while (hci_stack->acl_queue_tx_index == ACL_QUEUE_TX_NONE){
+        if (!hci_transport_can_send_prepared_packet_now(HCI_ACL_DATA_PACKET)) break;
+        uint8_t queue_index = hci_acl_queue_next_packet();
+        if (queue_index == ACL_QUEUE_TX_NONE) break;
+
+        hci_outgoing_acl_packet_t * acl_packet = &hci_stack->acl_queue[queue_index];
+        hci_connection_t * connection = hci_connection_for_handle(acl_packet->con_handle);
+        uint16_t max_acl_data_packet_length = hci_max_acl_data_packet_length_for_connection(connection);
+        const uint16_t fragment_pos = acl_packet->pos;
+        uint16_t fragment_len = acl_packet->size - acl_packet->pos;
+        if ((max_acl_data_packet_length > 0u) && (fragment_len > max_acl_data_packet_length)){
+            fragment_len = max_acl_data_packet_length;
+        }
+
+        // update state before send as "transport done" might be sent during send_packet already
+        acl_packet->pos += fragment_len;
+        hci_stack->acl_queue_tx_index = queue_index;
+        (void) hci_send_acl_fragment(connection, hci_acl_queue_buffer_for_index(acl_packet->buffer_index), fragment_pos, fragment_len);
+        fragment_sent = true;
+
+        // synchronous transports don't emit HCI_EVENT_TRANSPORT_PACKET_SENT
+        if (hci_transport_synchronous()){
+            hci_acl_queue_fragment_sent();
+        }
     }
+    return fragment_sent;
+}
 #endif
 
+#ifndef ENABLE_HCI_OUTGOING_ACL_QUEUE
+static int hci_send_acl_packet_fragments(hci_connection_t *connection){
+
+    // log_info("hci_send_acl_packet_fragments  %u/%u (con 0x%04x)", hci_stack->acl_fragmentation_pos, hci_stack->acl_fragmentation_total_size, connection->con_handle);
+
+    uint16_t max_acl_data_packet_length = hci_max_acl_data_packet_length_for_connection(connection);
+
     log_debug("hci_send_acl_packet_fragments entered");
 
     int err;
@@ -681,7 +946,7 @@ static int hci_send_acl_packet_fragments(hci_connection_t *connection){
         log_debug("hci_send_acl_packet_fragments loop entered");
 
         // get current data
-        const uint16_t acl_header_pos = hci_stack->acl_fragmentation_pos - 4u;
+        const uint16_t acl_fragment_pos = hci_stack->acl_fragmentation_pos;
         int current_acl_data_packet_length = hci_stack->acl_fragmentation_total_size - hci_stack->acl_fragmentation_pos;
         bool more_fragments = false;
 
@@ -691,18 +956,6 @@ static int hci_send_acl_packet_fragments(hci_connection_t *connection){
             current_acl_data_packet_length = max_acl_data_packet_length;
         }
 
-        // copy handle_and_flags if not first fragment and update packet boundary flags to be 01 (continuing fragmnent)
-        if (acl_header_pos > 0u){
-            uint16_t handle_and_flags = little_endian_read_16(hci_stack->hci_packet_buffer, 0);
-            handle_and_flags = (handle_and_flags & 0xcfffu) | (1u << 12u);
-            little_endian_store_16(hci_stack->hci_packet_buffer, acl_header_pos, handle_and_flags);
-        }
-
-        // update header len
-        little_endian_store_16(hci_stack->hci_packet_buffer, acl_header_pos + 2u, current_acl_data_packet_length);
-
-        // count packet
-        connection->num_packets_sent++;
         log_debug("hci_send_acl_packet_fragments loop before send (more fragments %d)", (int) more_fragments);
 
         // update state for next fragment (if any) as "transport done" might be sent during send_packet already
@@ -716,11 +969,8 @@ static int hci_send_acl_packet_fragments(hci_connection_t *connection){
         }
 
         // send packet
-        uint8_t * packet = &hci_stack->hci_packet_buffer[acl_header_pos];
-        const int size = current_acl_data_packet_length + 4;
-        hci_dump_packet(HCI_ACL_DATA_PACKET, 0, packet, size);
         hci_stack->acl_fragmentation_tx_active = 1;
-        err = hci_stack->hci_transport->send_packet(HCI_ACL_DATA_PACKET, packet, size);
+        err = hci_send_acl_fragment(connection, hci_stack->hci_packet_buffer, acl_fragment_pos, current_acl_data_packet_length);
 
         log_debug("hci_send_acl_packet_fragments loop after send (more fragments %d)", (int) more_fragments);
 
@@ -742,6 +992,7 @@ static int hci_send_acl_packet_fragments(hci_connection_t *connection){
 
     return err;
 }
+#endif
 
 // pre: caller has reserved the packet buffer
 int hci_send_acl_packet_buffer(int size){
@@ -778,11 +1029,29 @@ int hci_send_acl_packet_buffer(int size){
 
     // hci_dump_packet( HCI_ACL_DATA_PACKET, 0, packet, size);
 
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    // queue packet, use another buffer for next packet and release it
+    hci_outgoing_acl_packet_t * acl_packet = &hci_stack->acl_queue[hci_stack->acl_queue_len++];
+    acl_packet->con_handle   = con_handle;
+    acl_packet->size         = (uint16_t) size;
+    acl_packet->pos          = 4;   // start of L2CAP packet
+    acl_packet->buffer_index = hci_stack->hci_packet_buffer_index;
+    hci_acl_queue_select_packet_buffer();
+    hci_release_packet_buffer();
+
+    (void) hci_acl_queue_run();
+
+    if (hci_transport_synchronous()){
+        hci_emit_transport_packet_sent();
+    }
+    return ERROR_CODE_SUCCESS;
+#else
     // setup data
     hci_stack->acl_fragmentation_total_size = size;
     hci_stack->acl_fragmentation_pos = 4;   // start of L2CAP packet
 
     return hci_send_acl_packet_fragments(connection);
+#endif
 }
 
 #ifdef ENABLE_CLASSIC
@@ -957,6 +1226,7 @@ static void hci_shutdown_connection(hci_connection_t *conn){
 
     btstack_run_loop_remove_timer(&conn->timeout);
     
+    hci_connection_set_con_handle(conn, HCI_CON_HANDLE_INVALID);
     btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
     btstack_memory_hci_connection_free( conn );
     
@@ -1910,6 +2180,7 @@ static void hci_handle_connection_failed(hci_connection_t * conn, uint8_t status
 #endif
     
     // connection failed, remove entry
+    hci_connection_set_con_handle(conn, HCI_CON_HANDLE_INVALID);
     btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
     btstack_memory_hci_connection_free( conn );
 
@@ -2212,6 +2483,7 @@ static void event_handle_le_connection_complete(const uint8_t * packet){
 		// outgoing le connection establishment is done
 		if (conn){
 			// remove entry
+			hci_connection_set_con_handle(conn, HCI_CON_HANDLE_INVALID);
 			btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
 			btstack_memory_hci_connection_free( conn );
 		}
@@ -2248,7 +2520,7 @@ static void event_handle_le_connection_complete(const uint8_t * packet){
 
 	conn->state = OPEN;
 	conn->role  = packet[6];
-	conn->con_handle             = hci_subevent_le_connection_complete_get_connection_handle(packet);
+	hci_connection_set_con_handle(conn, hci_subevent_le_connection_complete_get_connection_handle(packet));
 	conn->le_connection_interval = hci_subevent_le_connection_complete_get_conn_interval(packet);
 
 #ifdef ENABLE_LE_PERIPHERAL
@@ -2431,7 +2703,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
             if (conn) {
                 if (!packet[2]){
                     conn->state = OPEN;
-                    conn->con_handle = little_endian_read_16(packet, 3);
+                    hci_connection_set_con_handle(conn, little_endian_read_16(packet, 3));
 
                     // queue get remote feature
                     conn->bonding_flags |= BONDING_REQUEST_REMOTE_FEATURES_PAGE_0;
@@ -2470,7 +2742,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                 break;
             }
             conn->state = OPEN;
-            conn->con_handle = little_endian_read_16(packet, 3);            
+            hci_connection_set_con_handle(conn, little_endian_read_16(packet, 3));
 
 #ifdef ENABLE_SCO_OVER_HCI
             // update SCO
@@ -2697,6 +2969,9 @@ static void event_handler(uint8_t *packet, uint16_t size){
         case HCI_EVENT_DISCONNECTION_COMPLETE:
             if (packet[2]) break;   // status != 0
             handle = little_endian_read_16(packet, 3);
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+            hci_acl_queue_drop_packets_for_handle(handle);
+#else
             // drop outgoing ACL fragments if it is for closed connection and release buffer if tx not active
             if (hci_stack->acl_fragmentation_total_size > 0u) {
                 if (handle == READ_ACL_CONNECTION_HANDLE(hci_stack->hci_packet_buffer)){
@@ -2709,6 +2984,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                     }
                 }
             }
+#endif
 
             conn = hci_connection_for_handle(handle);
             if (!conn) break;
@@ -2758,9 +3034,18 @@ static void event_handler(uint8_t *packet, uint16_t size){
                 log_error("Synchronous HCI Transport shouldn't send HCI_EVENT_TRANSPORT_PACKET_SENT");
                 return; // instead of break: to avoid re-entering hci_run()
             }
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+            if (hci_stack->acl_queue_tx_index != ACL_QUEUE_TX_NONE){
+                // fragment of queued ACL packet, packet buffer was not used
+                hci_acl_queue_fragment_sent();
+            } else {
+                hci_release_packet_buffer();
+            }
+#else
             hci_stack->acl_fragmentation_tx_active = 0;
             if (hci_stack->acl_fragmentation_total_size) break;
             hci_release_packet_buffer();
+#endif
             
             // L2CAP receives this event via the hci_emit_event below
 
@@ -3022,6 +3307,9 @@ void hci_register_sco_packet_handler(btstack_packet_handler_t handler){
 static void hci_state_reset(void){
     // no connections yet
     hci_stack->connections = NULL;
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    btstack_hash_index_init(&hci_stack->connection_index, hci_stack->connection_index_entries, HCI_CONNECTION_INDEX_SIZE);
+#endif
 
     // keep discoverable/connectable as this has been requested by the client(s)
     // hci_stack->discoverable = 0;
@@ -3031,6 +3319,9 @@ static void hci_state_reset(void){
 
     // buffer is free
     hci_stack->hci_packet_buffer_reserved = 0;
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    hci_acl_queue_reset();
+#endif
 
     // no pending cmds
     hci_stack->decline_reason = 0;
@@ -3384,6 +3675,9 @@ static void hci_power_transition_to_initializing(void){
     // set up state machine
     hci_stack->num_cmd_packets = 1; // assume that one cmd can be sent
     hci_stack->hci_packet_buffer_reserved = 0;
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    hci_acl_queue_reset();
+#endif
     hci_stack->state = HCI_STATE_INITIALIZING;
     hci_stack->substate = HCI_INIT_SEND_RESET;
 }
@@ -3664,6 +3958,9 @@ static void hci_halting_timeout_handler(btstack_timer_source_t * ds){
 }   
 
 static bool hci_run_acl_fragments(void){
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    return hci_acl_queue_run();
+#else
     if (hci_stack->acl_fragmentation_total_size > 0u) {
         hci_con_handle_t con_handle = READ_ACL_CONNECTION_HANDLE(hci_stack->hci_packet_buffer);
         hci_connection_t *connection = hci_connection_for_handle(con_handle);
@@ -3680,6 +3977,7 @@ static bool hci_run_acl_fragments(void){
         }
     }
     return false;
+#endif
 }
 
 #ifdef ENABLE_CLASSIC
@@ -5360,6 +5658,7 @@ uint8_t gap_connect_cancel(void){
         case SEND_CREATE_CONNECTION:
             // skip sending create connection and emit event instead
             hci_emit_le_connection_complete(conn->address_type, conn->address, 0, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+            hci_connection_set_con_handle(conn, HCI_CON_HANDLE_INVALID);
             btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
             btstack_memory_hci_connection_free( conn );
             break;            
@@ -6286,7 +6585,7 @@ void hci_setup_test_connections_fuzz(void){
     // setup incoming Classic ACL connection with con handle 0x0001, 66:55:44:33:22:01
     addr[5] = 0x01;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_ACL);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->role  = HCI_ROLE_SLAVE;
     conn->state = RECEIVED_CONNECTION_REQUEST;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
@@ -6294,7 +6593,7 @@ void hci_setup_test_connections_fuzz(void){
     // setup incoming Classic SCO connection with con handle 0x0002
     addr[5] = 0x02;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_SCO);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->role  = HCI_ROLE_SLAVE;
     conn->state = RECEIVED_CONNECTION_REQUEST;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
@@ -6302,7 +6601,7 @@ void hci_setup_test_connections_fuzz(void){
     // setup ready Classic ACL connection with con handle 0x0003
     addr[5] = 0x03;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_ACL);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->role  = HCI_ROLE_SLAVE;
     conn->state = OPEN;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
@@ -6310,7 +6609,7 @@ void hci_setup_test_connections_fuzz(void){
     // setup ready Classic SCO connection with con handle 0x0004
     addr[5] = 0x04;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_SCO);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->role  = HCI_ROLE_SLAVE;
     conn->state = OPEN;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
@@ -6318,7 +6617,7 @@ void hci_setup_test_connections_fuzz(void){
     // setup ready LE ACL connection with con handle 0x005 and public address
     addr[5] = 0x05;
     conn = create_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_LE_PUBLIC);
-    conn->con_handle = addr[5];
+    hci_connection_set_con_handle(conn, addr[5]);
     conn->role  = HCI_ROLE_SLAVE;
     conn->state = OPEN;
     conn->sm_connection.sm_role = HCI_ROLE_SLAVE;
@@ -6329,6 +6628,7 @@ void hci_free_connections_fuzz(void){
     btstack_linked_list_iterator_init(&it, &hci_stack->connections);
     while (btstack_linked_list_iterator_has_next(&it)){
         hci_connection_t * con = (hci_connection_t*) btstack_linked_list_iterator_next(&it);
+        hci_connection_set_con_handle(con, HCI_CON_HANDLE_INVALID);
         btstack_linked_list_iterator_remove(&it);
         btstack_memory_hci_connection_free(con);
     }
@@ -49,6 +49,7 @@
 
 #include "btstack_chipset.h"
 #include "btstack_control.h"
+#include "btstack_hash_index.h"
 #include "btstack_linked_list.h"
 #include "btstack_util.h"
 #include "classic/btstack_link_key_db.h"
@@ -140,6 +141,23 @@ extern "C" {
 #endif
 #endif
 
+// number of outgoing ACL packets that can be queued for the HCI Transport with ENABLE_HCI_OUTGOING_ACL_QUEUE
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+#ifndef HCI_OUTGOING_ACL_QUEUE_SIZE
+#define HCI_OUTGOING_ACL_QUEUE_SIZE 3
+#endif
+#if (HCI_OUTGOING_ACL_QUEUE_SIZE < 1) || (HCI_OUTGOING_ACL_QUEUE_SIZE > 254)
+#error HCI_OUTGOING_ACL_QUEUE_SIZE must be in range 1..254
+#endif
+#endif
+
+// size of hash index for connection lookup by handle with ENABLE_HCI_CONNECTION_INDEX, must be power of two
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+#ifndef HCI_CONNECTION_INDEX_SIZE
+#define HCI_CONNECTION_INDEX_SIZE 32
+#endif
+#endif
+
 // BNEP may uncompress the IP Header by 16 bytes, GATT Client requires two additional bytes for long characteristic reads
 #ifndef HCI_INCOMING_PRE_BUFFER_SIZE
 #ifdef ENABLE_CLASSIC
@@ -455,6 +473,9 @@ typedef struct {
     btstack_linked_list_t   notification_requests;
     btstack_linked_list_t   indication_requests;
 
+    // value of att_server_notify_all not sent yet
+    bool                    notify_all_pending;
+
 #ifdef ENABLE_GATT_OVER_CLASSIC
     uint16_t                l2cap_cid;
 #endif
@@ -756,6 +777,19 @@ typedef enum {
     LE_RESOLVING_LIST_DONE
 } le_resolving_list_state_t;
 
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+// ACL packet queued for sending, stored in one of the outgoing packet buffers
+typedef struct {
+    hci_con_handle_t con_handle;
+    // size of complete ACL packet incl. ACL header
+    uint16_t         size;
+    // start of next fragment to send
+    uint16_t         pos;
+    // 0 = hci_packet_buffer_data, 1.. = acl_queue_buffer_data
+    uint8_t          buffer_index;
+} hci_outgoing_acl_packet_t;
+#endif
+
 /**
  * main data structure
  */
@@ -775,6 +809,11 @@ typedef struct {
 
     // list of existing baseband connections
     btstack_linked_list_t     connections;
+#ifdef ENABLE_HCI_CONNECTION_INDEX
+    // connections with valid con handle by con handle
+    btstack_hash_index_t       connection_index;
+    btstack_hash_index_entry_t connection_index_entries[HCI_CONNECTION_INDEX_SIZE];
+#endif
 
     /* callback to L2CAP layer */
     btstack_packet_handler_t acl_packet_handler;
@@ -821,6 +860,16 @@ typedef struct {
     uint16_t  acl_fragmentation_pos;
     uint16_t  acl_fragmentation_total_size;
     uint8_t   acl_fragmentation_tx_active;
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    // additional buffers for queued ACL packets, hci_packet_buffer points to an unused one
+    uint8_t   acl_queue_buffer_data[HCI_OUTGOING_ACL_QUEUE_SIZE][HCI_OUTGOING_PRE_BUFFER_SIZE + HCI_OUTGOING_PACKET_BUFFER_SIZE];
+    uint8_t   hci_packet_buffer_index;
+    // queued ACL packets in order of submission
+    hci_outgoing_acl_packet_t acl_queue[HCI_OUTGOING_ACL_QUEUE_SIZE];
+    uint8_t   acl_queue_len;
+    // index into acl_queue of packet with fragment in transport, or ACL_QUEUE_TX_NONE
+    uint8_t   acl_queue_tx_index;
+#endif
      
     /* host to controller flow control */
     uint8_t  num_cmd_packets;
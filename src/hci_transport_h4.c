@@ -103,6 +103,10 @@ static btstack_timer_source_t ehcill_sleep_ack_timer;
 #error HCI_OUTGOING_PRE_BUFFER_SIZE not defined. Please update hci.h
 #endif
 
+#if defined(ENABLE_H4_RX_STREAMING) && defined(ENABLE_EHCILL)
+#error "ENABLE_H4_RX_STREAMING cannot be used with ENABLE_EHCILL"
+#endif
+
 static void dummy_handler(uint8_t packet_type, uint8_t *packet, uint16_t size); 
 
 typedef enum {
@@ -147,6 +151,29 @@ static uint16_t read_pos;
 static uint8_t hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + HCI_INCOMING_PACKET_BUFFER_SIZE + 1]; // packet type + max(acl header + acl payload, event header + event data)
 static uint8_t * hci_packet = &hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
 
+#ifdef ENABLE_H4_RX_STREAMING
+// streaming receive: read as many bytes as available into a larger buffer and deliver all complete packets in place.
+// as packets are processed in order, the pre-buffer of a packet overlaps with the already processed previous one.
+// the remaining partial packet is only moved to the start if there's not enough space for a full packet left.
+#ifndef HCI_H4_RX_STREAMING_BUFFER_SIZE
+#define HCI_H4_RX_STREAMING_BUFFER_SIZE (4 * (HCI_INCOMING_PACKET_BUFFER_SIZE + 1))
+#endif
+#if HCI_H4_RX_STREAMING_BUFFER_SIZE < (2 * (HCI_INCOMING_PACKET_BUFFER_SIZE + 1))
+#error "HCI_H4_RX_STREAMING_BUFFER_SIZE must hold at least two packets"
+#endif
+#if HCI_H4_RX_STREAMING_BUFFER_SIZE > 0xffff
+#error "HCI_H4_RX_STREAMING_BUFFER_SIZE must be smaller than 64 kB"
+#endif
+// + 1 to allow packet handler to write one byte after the end of the packet, e.g. for string termination
+static uint8_t  h4_rx_buffer_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + HCI_H4_RX_STREAMING_BUFFER_SIZE + 1];
+static uint8_t * h4_rx_buffer = &h4_rx_buffer_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
+static uint16_t h4_rx_parse_pos;
+static uint16_t h4_rx_fill_pos;
+static bool     h4_rx_streaming;
+// incremented on open to detect close/open from packet handler
+static uint8_t  h4_rx_session;
+#endif
+
 // Baudrate change bugs in TI CC256x and CYW20704
 #ifdef ENABLE_CC256X_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
 #define ENABLE_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
@@ -187,12 +214,12 @@ static void hci_transport_h4_trigger_next_read(void){
     btstack_uart->receive_block(&hci_packet[read_pos], bytes_to_read);  
 }
 
-static void hci_transport_h4_packet_complete(void){
 #ifdef ENABLE_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
+static void hci_transport_h4_baudrate_change_workaround_detect_chipset(const uint8_t * h4_packet){
     if (baudrate_change_workaround_state == BAUDRATE_CHANGE_WORKAROUND_IDLE
-            && memcmp(hci_packet, local_version_event_prefix, sizeof(local_version_event_prefix)) == 0){
+            && memcmp(h4_packet, local_version_event_prefix, sizeof(local_version_event_prefix)) == 0){
 #ifdef ENABLE_CC256X_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
-                if (little_endian_read_16(hci_packet, 11) == BLUETOOTH_COMPANY_ID_TEXAS_INSTRUMENTS_INC){
+                if (little_endian_read_16(h4_packet, 11) == BLUETOOTH_COMPANY_ID_TEXAS_INSTRUMENTS_INC){
                     // detect TI CC256x controller based on manufacturer
                     log_info("Detected CC256x controller");
                     baudrate_change_workaround_state = BAUDRATE_CHANGE_WORKAROUND_CHIPSET_DETECTED;
@@ -203,7 +230,7 @@ static void hci_transport_h4_packet_complete(void){
                 }
 #endif
 #ifdef ENABLE_CYPRESS_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
-                if (little_endian_read_16(hci_packet, 11) == BLUETOOTH_COMPANY_ID_CYPRESS_SEMICONDUCTOR){
+                if (little_endian_read_16(h4_packet, 11) == BLUETOOTH_COMPANY_ID_CYPRESS_SEMICONDUCTOR){
                     // detect Cypress controller based on manufacturer
                     log_info("Detected Cypress controller");
                     baudrate_change_workaround_state = BAUDRATE_CHANGE_WORKAROUND_CHIPSET_DETECTED;
@@ -214,6 +241,12 @@ static void hci_transport_h4_packet_complete(void){
                 }
 #endif
             }
+}
+#endif
+
+static void hci_transport_h4_packet_complete(void){
+#ifdef ENABLE_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
+    hci_transport_h4_baudrate_change_workaround_detect_chipset(hci_packet);
 #endif
     uint16_t packet_len = read_pos-1u;
 
@@ -321,6 +354,105 @@ static void hci_transport_h4_block_read(void){
     }
 }
 
+#ifdef ENABLE_H4_RX_STREAMING
+// returns size of complete H4 packet incl. packet type, 0 if more data is needed, or -1 if header is invalid
+static int hci_transport_h4_streaming_packet_size(const uint8_t * h4_packet, uint16_t available){
+    uint16_t header_size;
+    switch (h4_packet[0]){
+        case HCI_EVENT_PACKET:
+            header_size = HCI_EVENT_HEADER_SIZE;
+            break;
+        case HCI_ACL_DATA_PACKET:
+            header_size = HCI_ACL_HEADER_SIZE;
+            break;
+        case HCI_SCO_DATA_PACKET:
+            header_size = HCI_SCO_HEADER_SIZE;
+            break;
+        default:
+            log_error("hci_transport_h4: invalid packet type 0x%02x", h4_packet[0]);
+            return -1;
+    }
+    if (available < (1u + header_size)) return 0;
+
+    uint16_t payload_len;
+    switch (h4_packet[0]){
+        case HCI_EVENT_PACKET:
+            payload_len = h4_packet[2];
+            break;
+        case HCI_ACL_DATA_PACKET:
+            payload_len = little_endian_read_16(h4_packet, 3);
+            break;
+        default:
+            payload_len = h4_packet[3];
+            break;
+    }
+    if (payload_len > (HCI_INCOMING_PACKET_BUFFER_SIZE - header_size)){
+        log_error("hci_transport_h4: invalid payload len %u for packet type 0x%02x - only space for %u",
+                  payload_len, h4_packet[0], HCI_INCOMING_PACKET_BUFFER_SIZE - header_size);
+        return -1;
+    }
+
+    uint16_t packet_size = 1u + header_size + payload_len;
+    if (available < packet_size) return 0;
+    return packet_size;
+}
+
+static void hci_transport_h4_streaming_trigger_next_read(void){
+    if (h4_rx_parse_pos == h4_rx_fill_pos){
+        // all data processed, start over
+        h4_rx_parse_pos = 0;
+        h4_rx_fill_pos  = 0;
+    } else if ((h4_rx_parse_pos + HCI_INCOMING_PACKET_BUFFER_SIZE + 1u) > HCI_H4_RX_STREAMING_BUFFER_SIZE){
+        // not enough space to complete largest packet, move partial packet to start
+        uint16_t partial_len = h4_rx_fill_pos - h4_rx_parse_pos;
+        memmove(&h4_rx_buffer[0], &h4_rx_buffer[h4_rx_parse_pos], partial_len);
+        h4_rx_parse_pos = 0;
+        h4_rx_fill_pos  = partial_len;
+    }
+    btstack_uart->receive_bytes(&h4_rx_buffer[h4_rx_fill_pos], HCI_H4_RX_STREAMING_BUFFER_SIZE - h4_rx_fill_pos);
+}
+
+static void hci_transport_h4_streaming_bytes_received(uint16_t num_bytes){
+    if (h4_state == H4_OFF) return;
+
+    h4_rx_fill_pos += num_bytes;
+
+#ifdef ENABLE_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
+    // all available bytes are read at once, no need to force a single read for the command complete event
+    if (baudrate_change_workaround_state == BAUDRATE_CHANGE_WORKAROUND_BAUDRATE_COMMAND_SENT){
+        baudrate_change_workaround_state = BAUDRATE_CHANGE_WORKAROUND_IDLE;
+    }
+#endif
+
+    uint8_t session = h4_rx_session;
+    while (h4_rx_parse_pos < h4_rx_fill_pos){
+        uint8_t * h4_packet = &h4_rx_buffer[h4_rx_parse_pos];
+        int packet_size = hci_transport_h4_streaming_packet_size(h4_packet, h4_rx_fill_pos - h4_rx_parse_pos);
+        if (packet_size == 0) break;
+        if (packet_size < 0){
+            // skip invalid byte, same as block read
+            h4_rx_parse_pos++;
+            continue;
+        }
+
+#ifdef ENABLE_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
+        hci_transport_h4_baudrate_change_workaround_detect_chipset(h4_packet);
+#endif
+        h4_rx_parse_pos += (uint16_t) packet_size;
+
+        // deliver packet in place, packet handler might modify the byte after the packet
+        uint8_t next_byte = h4_rx_buffer[h4_rx_parse_pos];
+        packet_handler(h4_packet[0], &h4_packet[1], (uint16_t) (packet_size - 1));
+
+        // stop if transport was closed or re-opened by packet handler
+        if ((h4_state == H4_OFF) || (session != h4_rx_session)) return;
+        h4_rx_buffer[h4_rx_parse_pos] = next_byte;
+    }
+
+    hci_transport_h4_streaming_trigger_next_read();
+}
+#endif
+
 static void hci_transport_h4_block_sent(void){
 
     static const uint8_t packet_sent_event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
@@ -420,6 +552,16 @@ static void hci_transport_h4_init(const void * transport_config){
     btstack_uart->init(&uart_config);
     btstack_uart->set_block_received(&hci_transport_h4_block_read);
     btstack_uart->set_block_sent(&hci_transport_h4_block_sent);
+
+#ifdef ENABLE_H4_RX_STREAMING
+    // fallback to block reads if UART driver does not support streaming receive
+    h4_rx_streaming = (btstack_uart->set_bytes_received != NULL) && (btstack_uart->receive_bytes != NULL);
+    if (h4_rx_streaming){
+        btstack_uart->set_bytes_received(&hci_transport_h4_streaming_bytes_received);
+    } else {
+        log_info("hci_transport_h4: UART driver does not support streaming receive");
+    }
+#endif
 }
 
 static int hci_transport_h4_open(void){
@@ -431,7 +573,18 @@ static int hci_transport_h4_open(void){
 
     // init rx + tx state machines
     hci_transport_h4_reset_statemachine();
+#ifdef ENABLE_H4_RX_STREAMING
+    h4_rx_session++;
+    if (h4_rx_streaming){
+        h4_rx_parse_pos = 0;
+        h4_rx_fill_pos  = 0;
+        hci_transport_h4_streaming_trigger_next_read();
+    } else {
+        hci_transport_h4_trigger_next_read();
+    }
+#else
     hci_transport_h4_trigger_next_read();
+#endif
     tx_state = TX_IDLE;
 
 #ifdef ENABLE_EHCILL
@@ -50,6 +50,7 @@
 #include "btstack_bool.h"
 #include "btstack_debug.h"
 #include "btstack_event.h"
+#include "btstack_hash_index.h"
 #include "btstack_memory.h"
 
 #ifdef ENABLE_LE_DATA_CHANNELS
@@ -121,9 +122,20 @@ typedef enum {
 // used to cache l2cap rejects, echo, and informational requests
 #define NR_PENDING_SIGNALING_RESPONSES 3
 
-// nr of credits provided to remote if credits fall below watermark
-#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_WATERMARK 5
-#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INCREMENT 5
+// automatic credits: initial credits and min credits provided to remote
+#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INITIAL 10
+#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MIN      4
+
+// automatic credits: round trip time assumed before first measurement if connection interval is unknown
+#define L2CAP_LE_DATA_CHANNELS_DEFAULT_RTT_MS 50
+
+// automatic credits: min duration of rate measurement interval
+#define L2CAP_LE_DATA_CHANNELS_RATE_INTERVAL_MIN_MS 10
+
+// automatic credits: max number of bytes remote can send without new credits, per channel
+#ifndef L2CAP_LE_DATA_CHANNELS_CREDIT_BUDGET
+#define L2CAP_LE_DATA_CHANNELS_CREDIT_BUDGET 16384
+#endif
 
 // offsets for L2CAP SIGNALING COMMANDS
 #define L2CAP_SIGNALING_COMMAND_CODE_OFFSET   0
@@ -131,10 +143,19 @@ typedef enum {
 #define L2CAP_SIGNALING_COMMAND_LENGTH_OFFSET 2
 #define L2CAP_SIGNALING_COMMAND_DATA_OFFSET   4
 
+// size of hash index for channel lookup by local cid with ENABLE_L2CAP_CHANNEL_INDEX, must be power of two
+#if defined(ENABLE_L2CAP_CHANNEL_INDEX) && !defined(L2CAP_CHANNEL_INDEX_SIZE)
+#define L2CAP_CHANNEL_INDEX_SIZE 32
+#endif
+
 #if defined(ENABLE_LE_DATA_CHANNELS) || defined(ENABLE_CLASSIC)
 #define L2CAP_USES_CHANNELS
 #endif
 
+#if defined(ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE) && !defined(ENABLE_LE_DATA_CHANNELS)
+#error "Enhanced Credit Based Flow Control Mode requires LE Data Channels. Please add ENABLE_LE_DATA_CHANNELS to btstack_config.h"
+#endif
+
 // prototypes
 static void l2cap_run(void);
 static void l2cap_hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
@@ -159,7 +180,7 @@ static void l2cap_emit_le_channel_closed(l2cap_channel_t * channel);
 static void l2cap_emit_le_incoming_connection(l2cap_channel_t *channel);
 static void l2cap_le_notify_channel_can_send(l2cap_channel_t *channel);
 static void l2cap_le_finialize_channel_close(l2cap_channel_t *channel);
-static void l2cap_le_send_pdu(l2cap_channel_t *channel);
+static bool l2cap_le_send_pdu(l2cap_channel_t *channel);
 static inline l2cap_service_t * l2cap_le_get_service(uint16_t psm);
 #endif
 #ifdef L2CAP_USES_CHANNELS
@@ -175,6 +196,7 @@ static void l2cap_free_channel_entry(l2cap_channel_t * channel);
 static void l2cap_ertm_notify_channel_can_send(l2cap_channel_t * channel);
 static void l2cap_ertm_monitor_timeout_callback(btstack_timer_source_t * ts);
 static void l2cap_ertm_retransmission_timeout_callback(btstack_timer_source_t * ts);
+static int  l2cap_channel_send_prepared(l2cap_channel_t * channel, uint16_t len, const l2cap_ertm_tx_packet_state_t * tx_state);
 #endif
 
 // l2cap_fixed_channel_t entries
@@ -198,6 +220,11 @@ static btstack_linked_list_t l2cap_le_services;
 
 // single list of channels for Classic Channels, LE Data Channels, Classic Connectionless, ATT, and SM
 static btstack_linked_list_t l2cap_channels;
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+// channels in l2cap_channels by local cid
+static btstack_hash_index_t       l2cap_channel_index;
+static btstack_hash_index_entry_t l2cap_channel_index_entries[L2CAP_CHANNEL_INDEX_SIZE];
+#endif
 #ifdef L2CAP_USES_CHANNELS
 // next channel id for new connections
 static uint16_t  local_source_cid;
@@ -208,6 +235,7 @@ static uint8_t   sig_seq_nr;
 // used to cache l2cap rejects, echo, and informational requests
 static l2cap_signaling_response_t signaling_responses[NR_PENDING_SIGNALING_RESPONSES];
 static int signaling_responses_pending;
+static bool l2cap_notify_channel_can_send_active;
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 
 #ifdef ENABLE_BLE
@@ -216,51 +244,72 @@ static btstack_packet_handler_t l2cap_event_packet_handler;
 static uint16_t l2cap_le_custom_max_mtu;
 #endif
 
+static void l2cap_channel_index_add(l2cap_fixed_channel_t * channel){
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    if (btstack_hash_index_add(&l2cap_channel_index, channel->local_cid, channel) == false){
+        log_info("channel index full, use linear search");
+    }
+#else
+    UNUSED(channel);
+#endif
+}
+
+static void l2cap_channel_index_remove(l2cap_fixed_channel_t * channel){
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    btstack_hash_index_remove(&l2cap_channel_index, channel->local_cid, channel);
+#else
+    UNUSED(channel);
+#endif
+}
+
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
 
 // enable for testing
 // #define L2CAP_ERTM_SIMULATE_FCS_ERROR_INTERVAL 16
 
-/*
- * CRC lookup table for generator polynom D^16 + D^15 + D^2 + 1
- */
-static const uint16_t crc16_table[256] = {
-    0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601, 0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440,
-    0xcc01, 0x0cc0, 0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81, 0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841,
-    0xd801, 0x18c0, 0x1980, 0xd941, 0x1b00, 0xdbc1, 0xda81, 0x1a40, 0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01, 0x1dc0, 0x1c80, 0xdc41,
-    0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0, 0x1680, 0xd641, 0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081, 0x1040,
-    0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240, 0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441,
-    0x3c00, 0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41, 0xfa01, 0x3ac0, 0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840,
-    0x2800, 0xe8c1, 0xe981, 0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41, 0xee01, 0x2ec0, 0x2f80, 0xef41, 0x2d00, 0xedc1, 0xec81, 0x2c40,
-    0xe401, 0x24c0, 0x2580, 0xe541, 0x2700, 0xe7c1, 0xe681, 0x2640, 0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0, 0x2080, 0xe041,
-    0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281, 0x6240, 0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
-    0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41, 0xaa01, 0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840,
-    0x7800, 0xb8c1, 0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41, 0xbe01, 0x7ec0, 0x7f80, 0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40,
-    0xb401, 0x74c0, 0x7580, 0xb541, 0x7700, 0xb7c1, 0xb681, 0x7640, 0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101, 0x71c0, 0x7080, 0xb041,
-    0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0, 0x5280, 0x9241, 0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481, 0x5440,
-    0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40, 0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841,
-    0x8801, 0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40, 0x4e00, 0x8ec1, 0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41,
-    0x4400, 0x84c1, 0x8581, 0x4540, 0x8701, 0x47c0, 0x4680, 0x8641, 0x8201, 0x42c0, 0x4380, 0x8341, 0x4100, 0x81c1, 0x8081, 0x4040, 
-};
-
-static uint16_t crc16_calc(uint8_t * data, uint16_t len){
-    uint16_t crc = 0;   // initial value = 0 
-    while (len--){
-        crc = (crc >> 8) ^ crc16_table[ (crc ^ ((uint16_t) *data++)) & 0x00FF ];
-    }
-    return crc;
-}
-
-static inline uint16_t l2cap_encanced_control_field_for_information_frame(uint8_t tx_seq, int final, uint8_t req_seq, l2cap_segmentation_and_reassembly_t sar){
+// max TxWindow with Enhanced Control Field (6-bit sequence numbers)
+#define L2CAP_ERTM_MAX_TX_WINDOW_ENHANCED   63
+// max TxWindow with Extended Control Field (14-bit sequence numbers)
+#define L2CAP_ERTM_MAX_TX_WINDOW_EXTENDED   0x3fff
+
+static inline uint32_t l2cap_encanced_control_field_for_information_frame(const l2cap_channel_t * channel, uint16_t tx_seq, int final, uint16_t req_seq, l2cap_segmentation_and_reassembly_t sar){
+    if (channel->extended_control){
+        return (((uint32_t) tx_seq) << 18) | (((uint32_t) sar) << 16) | (((uint32_t) req_seq) << 2) | (final << 1) | 0;
+    }
     return (((uint16_t) sar) << 14) | (req_seq << 8) | (final << 7) | (tx_seq << 1) | 0; 
 }
 
-static inline uint16_t l2cap_encanced_control_field_for_supevisor_frame(l2cap_supervisory_function_t supervisory_function, int poll, int final, uint8_t req_seq){
+static inline uint32_t l2cap_encanced_control_field_for_supevisor_frame(const l2cap_channel_t * channel, l2cap_supervisory_function_t supervisory_function, int poll, int final, uint16_t req_seq){
+    if (channel->extended_control){
+        return (((uint32_t) poll) << 18) | (((uint32_t) supervisory_function) << 16) | (((uint32_t) req_seq) << 2) | (final << 1) | 1;
+    }
     return (req_seq << 8) | (final << 7) | (poll << 4) | (((int) supervisory_function) << 2) | 1; 
 }
 
-static int l2cap_next_ertm_seq_nr(int seq_nr){
-    return (seq_nr + 1) & 0x3f;
+static inline uint16_t l2cap_ertm_control_field_size(const l2cap_channel_t * channel){
+    return channel->extended_control ? 4 : 2;
+}
+
+static void l2cap_ertm_store_control_field(const l2cap_channel_t * channel, uint8_t * buffer, uint32_t control){
+    if (channel->extended_control){
+        little_endian_store_32(buffer, 0, control);
+    } else {
+        little_endian_store_16(buffer, 0, (uint16_t) control);
+    }
+}
+
+static inline uint16_t l2cap_ertm_seq_nr_mask(const l2cap_channel_t * channel){
+    return channel->extended_control ? 0x3fff : 0x3f;
+}
+
+static uint16_t l2cap_next_ertm_seq_nr(const l2cap_channel_t * channel, uint16_t seq_nr){
+    return (seq_nr + 1) & l2cap_ertm_seq_nr_mask(channel);
+}
+
+// max number of out-of-order frames that can be stored, limited by sequence number space
+static uint16_t l2cap_ertm_rx_window(const l2cap_channel_t * channel){
+    if (channel->extended_control) return channel->num_rx_buffers;
+    return btstack_min(channel->num_rx_buffers, L2CAP_ERTM_MAX_TX_WINDOW_ENHANCED);
 }
 
 static int l2cap_ertm_can_store_packet_now(l2cap_channel_t * channel){
@@ -333,13 +382,10 @@ static void l2cap_ertm_monitor_timeout_callback(btstack_timer_source_t * ts){
         // increment retry count
         tx_state->retry_count++;
 
-        // start retransmit
-        l2cap_ertm_retransmit_unacknowleded_frames(l2cap_channel);
-
         // start monitor timer
         l2cap_ertm_start_monitor_timer(l2cap_channel);
 
-        // send RR/P=1
+        // send RR/P=1, retransmit frames requested by response with final bit set
         l2cap_channel->send_supervisor_frame_receiver_ready_poll = 1;
     } else {
         log_info("Monitor timer expired & retry count >= max transmit -> disconnect");
@@ -359,14 +405,13 @@ static void l2cap_ertm_retransmission_timeout_callback(btstack_timer_source_t *
     // set retry count = 1
     tx_state->retry_count = 1;
 
-    // start retransmit
-    l2cap_ertm_retransmit_unacknowleded_frames(l2cap_channel);
-
     // start monitor timer
     l2cap_ertm_start_monitor_timer(l2cap_channel);
  
-    // send RR/P=1
+    // send RR/P=1 and stop sending new I-Frames. Instead of retransmitting all unacknowledged frames,
+    // only frames requested by the response with final bit set (SREJ, or RR/REJ with ReqSeq) are retransmitted
     l2cap_channel->send_supervisor_frame_receiver_ready_poll = 1;
+    l2cap_channel->wait_final = 1;
     l2cap_run();
 }
 
@@ -374,19 +419,25 @@ static int l2cap_ertm_send_information_frame(l2cap_channel_t * channel, int inde
     l2cap_ertm_tx_packet_state_t * tx_state = &channel->tx_packets_state[index];
     hci_reserve_packet_buffer();
     uint8_t *acl_buffer = hci_get_outgoing_packet_buffer();
-    uint16_t control = l2cap_encanced_control_field_for_information_frame(tx_state->tx_seq, final, channel->req_seq, tx_state->sar);
-    log_info("I-Frame: control 0x%04x", control);
-    little_endian_store_16(acl_buffer, 8, control);
-    (void)memcpy(&acl_buffer[8 + 2],
-                 &channel->tx_packets_data[index * channel->local_mps],
-                 tx_state->len);
+    uint32_t control = l2cap_encanced_control_field_for_information_frame(channel, tx_state->tx_seq, final, channel->req_seq, tx_state->sar);
+    log_info("I-Frame: control 0x%04x", (unsigned int) control);
+    l2cap_ertm_store_control_field(channel, &acl_buffer[8], control);
+    uint16_t pos = 8 + l2cap_ertm_control_field_size(channel);
+    uint16_t data_len = tx_state->len;
+    if (tx_state->sar == L2CAP_SEGMENTATION_AND_REASSEMBLY_START_OF_L2CAP_SDU){
+        little_endian_store_16(acl_buffer, pos, tx_state->sdu_length);
+        pos      += 2;
+        data_len -= 2;
+    }
+    (void)memcpy(&acl_buffer[pos], tx_state->data, data_len);
     // (re-)start retransmission timer on 
     l2cap_ertm_start_retransmission_timer(channel);
     // send
-    return l2cap_send_prepared(channel->local_cid, 2 + tx_state->len);
+    return l2cap_channel_send_prepared(channel, pos + data_len - 8, tx_state);
 }
 
-static void l2cap_ertm_store_fragment(l2cap_channel_t * channel, l2cap_segmentation_and_reassembly_t sar, uint16_t sdu_length, uint8_t * data, uint16_t len){
+// by_reference: data stays valid until acknowledged, otherwise it gets copied into tx_packets_data
+static void l2cap_ertm_store_fragment(l2cap_channel_t * channel, l2cap_segmentation_and_reassembly_t sar, uint16_t sdu_length, const uint8_t * data, uint16_t len, bool by_reference){
     // get next index for storing packets
     int index = channel->tx_write_index;
 
@@ -394,27 +445,42 @@ static void l2cap_ertm_store_fragment(l2cap_channel_t * channel, l2cap_segmentat
     tx_state->tx_seq = channel->next_tx_seq;
     tx_state->sar = sar;
     tx_state->retry_count = 0;
+    tx_state->retransmission_requested = 0;
+    tx_state->sdu_length = sdu_length;
+    tx_state->release_sdu = by_reference && ((sar == L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU) || (sar == L2CAP_SEGMENTATION_AND_REASSEMBLY_END_OF_L2CAP_SDU));
 
-    uint8_t * tx_packet = &channel->tx_packets_data[index * channel->local_mps];
-    log_debug("index %u, local mps %u, remote mps %u, packet tx %p, len %u", index, channel->local_mps, channel->remote_mps, tx_packet, len);
-    int pos = 0;
+    if (by_reference){
+        tx_state->data = data;
+    } else {
+        uint8_t * tx_packet = &channel->tx_packets_data[index * channel->local_mps];
+        log_debug("index %u, local mps %u, remote mps %u, packet tx %p, len %u", index, channel->local_mps, channel->remote_mps, tx_packet, len);
+        (void)memcpy(tx_packet, data, len);
+        tx_state->data = tx_packet;
+    }
+
+    uint16_t crc = 0;
+    tx_state->len = len;
     if (sar == L2CAP_SEGMENTATION_AND_REASSEMBLY_START_OF_L2CAP_SDU){
-        little_endian_store_16(tx_packet, 0, sdu_length);
-        pos += 2;
+        uint8_t sdu_length_buffer[2];
+        little_endian_store_16(sdu_length_buffer, 0, sdu_length);
+        crc = btstack_crc16_calc(sdu_length_buffer, 2);
+        tx_state->len += 2;
+    }
+    if (channel->fcs_option){
+        // FCS of stored payload, reused for retransmissions
+        tx_state->fcs = btstack_crc16_update(crc, data, len);
     }
-    (void)memcpy(&tx_packet[pos], data, len);
-    tx_state->len = pos + len;
 
     // update
     channel->num_stored_tx_frames++;
-    channel->next_tx_seq = l2cap_next_ertm_seq_nr(channel->next_tx_seq);
+    channel->next_tx_seq = l2cap_next_ertm_seq_nr(channel, channel->next_tx_seq);
     l2cap_ertm_next_tx_write_index(channel);
 
     log_info("l2cap_ertm_store_fragment: tx_read_index %u, tx_write_index %u, num stored %u", channel->tx_read_index, channel->tx_write_index, channel->num_stored_tx_frames);
 
 }
 
-static int l2cap_ertm_send(l2cap_channel_t * channel, uint8_t * data, uint16_t len){
+static int l2cap_ertm_send(l2cap_channel_t * channel, const uint8_t * data, uint16_t len, bool by_reference){
     if (len > channel->remote_mtu){
         log_error("l2cap_ertm_send cid 0x%02x, data length exceeds remote MTU.", channel->local_cid);
         return L2CAP_DATA_LEN_EXCEEDS_REMOTE_MTU;
@@ -435,7 +501,8 @@ static int l2cap_ertm_send(l2cap_channel_t * channel, uint8_t * data, uint16_t l
             switch (sar){
                 case L2CAP_SEGMENTATION_AND_REASSEMBLY_START_OF_L2CAP_SDU:
                     chunk_len = effective_mps - 2;    // sdu_length
-                    l2cap_ertm_store_fragment(channel, sar, len, data, chunk_len);
+                    l2cap_ertm_store_fragment(channel, sar, len, data, chunk_len, by_reference);
+                    data += chunk_len;
                     len -= chunk_len;
                     sar = L2CAP_SEGMENTATION_AND_REASSEMBLY_CONTINUATION_OF_L2CAP_SDU;
                     break;
@@ -445,7 +512,8 @@ static int l2cap_ertm_send(l2cap_channel_t * channel, uint8_t * data, uint16_t l
                         sar = L2CAP_SEGMENTATION_AND_REASSEMBLY_END_OF_L2CAP_SDU; 
                         chunk_len = len;                       
                     }
-                    l2cap_ertm_store_fragment(channel, sar, len, data, chunk_len);
+                    l2cap_ertm_store_fragment(channel, sar, 0, data, chunk_len, by_reference);
+                    data += chunk_len;
                     len -= chunk_len;
                     break;
                 default:
@@ -454,7 +522,7 @@ static int l2cap_ertm_send(l2cap_channel_t * channel, uint8_t * data, uint16_t l
         }
 
     } else {
-        l2cap_ertm_store_fragment(channel, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, 0, data, len);
+        l2cap_ertm_store_fragment(channel, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, 0, data, len, by_reference);
     }
 
     // try to send
@@ -462,12 +530,22 @@ static int l2cap_ertm_send(l2cap_channel_t * channel, uint8_t * data, uint16_t l
     return 0;
 }
 
+static int l2cap_ertm_remote_supports_extended_window_size(l2cap_channel_t * channel){
+    hci_connection_t * connection = hci_connection_for_handle(channel->con_handle);
+    if (connection == NULL) return 0;
+    return (connection->l2cap_state.extended_feature_mask & 0x100) != 0;
+}
+
 static uint16_t l2cap_setup_options_ertm_request(l2cap_channel_t * channel, uint8_t * config_options){
+    // use Extended Window Size option and Extended Control Field for TxWindow > 63 if supported by remote
+    if ((channel->num_rx_buffers > L2CAP_ERTM_MAX_TX_WINDOW_ENHANCED) && l2cap_ertm_remote_supports_extended_window_size(channel)){
+        channel->extended_control = 1;
+    }
     int pos = 0;
     config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_RETRANSMISSION_AND_FLOW_CONTROL;
     config_options[pos++] = 9;      // length
     config_options[pos++] = (uint8_t) channel->mode;
-    config_options[pos++] = channel->num_rx_buffers;    // == TxWindows size
+    config_options[pos++] = (uint8_t) btstack_min(channel->num_rx_buffers, L2CAP_ERTM_MAX_TX_WINDOW_ENHANCED);    // == TxWindows size
     config_options[pos++] = channel->local_max_transmit;
     little_endian_store_16( config_options, pos, channel->local_retransmission_timeout_ms);
     pos += 2;
@@ -486,7 +564,14 @@ static uint16_t l2cap_setup_options_ertm_request(l2cap_channel_t * channel, uint
     config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_FRAME_CHECK_SEQUENCE;
     config_options[pos++] = 1;     // length
     config_options[pos++] = channel->fcs_option;
-    return pos; // 11+4+3=18
+
+    if (channel->extended_control){
+        config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE;
+        config_options[pos++] = 2;     // length
+        little_endian_store_16(config_options, pos, btstack_min(channel->num_rx_buffers, L2CAP_ERTM_MAX_TX_WINDOW_EXTENDED));
+        pos += 2;
+    }
+    return pos; // 11+4+3+4=22
 }
 
 static uint16_t l2cap_setup_options_ertm_response(l2cap_channel_t * channel, uint8_t * config_options){
@@ -495,7 +580,8 @@ static uint16_t l2cap_setup_options_ertm_response(l2cap_channel_t * channel, uin
     config_options[pos++] = 9;      // length
     config_options[pos++] = (uint8_t) channel->mode;
     // less or equal to remote tx window size
-    config_options[pos++] = btstack_min(channel->num_tx_buffers, channel->remote_tx_window_size);
+    uint16_t tx_window_size = btstack_min(channel->num_tx_buffers, channel->remote_tx_window_size);
+    config_options[pos++] = (uint8_t) btstack_min(tx_window_size, L2CAP_ERTM_MAX_TX_WINDOW_ENHANCED);
     // max transmit in response shall be ignored -> use sender values
     config_options[pos++] = channel->remote_max_transmit;
     // A value for the Retransmission time-out shall be sent in a positive Configuration Response
@@ -521,15 +607,21 @@ static uint16_t l2cap_setup_options_ertm_response(l2cap_channel_t * channel, uin
     config_options[pos++] = 1;     // length
     config_options[pos++] = channel->fcs_option;
 #endif
-    return pos; // 11+4=15
+    if (channel->extended_control){
+        config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE;
+        config_options[pos++] = 2;     // length
+        little_endian_store_16(config_options, pos, tx_window_size);
+        pos += 2;
+    }
+    return pos; // 11+4+4=19
 }
 
-static int l2cap_ertm_send_supervisor_frame(l2cap_channel_t * channel, uint16_t control){
+static int l2cap_ertm_send_supervisor_frame(l2cap_channel_t * channel, uint32_t control){
     hci_reserve_packet_buffer();
     uint8_t *acl_buffer = hci_get_outgoing_packet_buffer();
-    log_info("S-Frame: control 0x%04x", control);
-    little_endian_store_16(acl_buffer, 8, control);
-    return l2cap_send_prepared(channel->local_cid, 2);
+    log_info("S-Frame: control 0x%04x", (unsigned int) control);
+    l2cap_ertm_store_control_field(channel, &acl_buffer[8], control);
+    return l2cap_send_prepared(channel->local_cid, l2cap_ertm_control_field_size(channel));
 }
 
 static uint8_t l2cap_ertm_validate_local_config(l2cap_ertm_config_t * ertm_config){
@@ -551,8 +643,8 @@ static uint8_t l2cap_ertm_validate_local_config(l2cap_ertm_config_t * ertm_confi
         log_error("local_mtu must be >= 48");
         result = ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
     }
-    if (ertm_config->num_rx_buffers < 1){
-        log_error("num_rx_buffers must be >= 1");
+    if ((ertm_config->num_rx_buffers < 1) || (ertm_config->num_rx_buffers > L2CAP_ERTM_MAX_TX_WINDOW_EXTENDED)){
+        log_error("num_rx_buffers must be >= 1 and <= 16383");
         result = ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
     }
     if (ertm_config->num_tx_buffers < 1){
@@ -572,6 +664,7 @@ static void l2cap_ertm_configure_channel(l2cap_channel_t * channel, l2cap_ertm_c
     channel->local_mtu = ertm_config->local_mtu;
     channel->num_rx_buffers = ertm_config->num_rx_buffers;
     channel->num_tx_buffers = ertm_config->num_tx_buffers;
+    channel->extended_control = 0;
 
     // align buffer to 16-byte boundary to assert l2cap_ertm_rx_packet_state_t is aligned
     int bytes_till_alignment = 16 - (((uintptr_t) buffer) & 0x0f);
@@ -584,16 +677,17 @@ static void l2cap_ertm_configure_channel(l2cap_channel_t * channel, l2cap_ertm_c
     pos += ertm_config->num_rx_buffers * sizeof(l2cap_ertm_rx_packet_state_t);
     channel->tx_packets_state = (l2cap_ertm_tx_packet_state_t *) (void *) &buffer[pos];
     pos += ertm_config->num_tx_buffers * sizeof(l2cap_ertm_tx_packet_state_t);
+    (void)memset(buffer, 0, pos);
 
     // setup reassembly buffer
     channel->reassembly_buffer = &buffer[pos];
     pos += ertm_config->local_mtu;
 
-    // divide rest of data equally
-    channel->local_mps = (size - pos) / (ertm_config->num_rx_buffers + ertm_config->num_tx_buffers);
+    // divide rest of data equally, rx buffers hold SDU length of start and unsegmented SDUs in addition
+    channel->local_mps = (size - pos - (2u * ertm_config->num_rx_buffers)) / (ertm_config->num_rx_buffers + ertm_config->num_tx_buffers);
     log_info("Local MPS: %u", channel->local_mps);
     channel->rx_packets_data = &buffer[pos];
-    pos += ertm_config->num_rx_buffers * channel->local_mps;
+    pos += ertm_config->num_rx_buffers * (channel->local_mps + 2u);
     channel->tx_packets_data = &buffer[pos];
 
     channel->fcs_option = ertm_config->fcs_option;
@@ -618,6 +712,7 @@ uint8_t l2cap_create_ertm_channel(btstack_packet_handler_t packet_handler, bd_ad
 
     // add to connections list
     btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_channel_index_add((l2cap_fixed_channel_t *) channel);
 
     // store local_cid
     if (out_local_cid){
@@ -720,8 +815,20 @@ uint8_t l2cap_ertm_set_ready(uint16_t local_cid){
     return ERROR_CODE_SUCCESS;
 }
 
+uint8_t l2cap_ertm_send_data(uint16_t local_cid, const uint8_t * data, uint16_t size){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        log_error("l2cap_ertm_send_data no channel for cid 0x%02x", local_cid);
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+    if (channel->mode != L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+    return (uint8_t) l2cap_ertm_send(channel, data, size, true);
+}
+
 // Process-ReqSeq
-static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t req_seq){
+static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint16_t req_seq){
     int num_buffers_acked = 0;
     l2cap_ertm_tx_packet_state_t * tx_state;
     log_info("l2cap_ertm_process_req_seq: tx_read_index %u, tx_write_index %u, req_seq %u", l2cap_channel->tx_read_index, l2cap_channel->tx_write_index, req_seq);
@@ -736,17 +843,23 @@ static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t
 
         tx_state = &l2cap_channel->tx_packets_state[l2cap_channel->tx_read_index];
         // calc delta
-        int delta = (req_seq - tx_state->tx_seq) & 0x03f;
+        int delta = (req_seq - tx_state->tx_seq) & l2cap_ertm_seq_nr_mask(l2cap_channel);
         if (delta == 0) break;  // all packets acknowledged
-        if (delta > l2cap_channel->remote_tx_window_size) break;   
+        if (delta > l2cap_channel->unacked_frames) break;
 
         num_buffers_acked++;
         l2cap_channel->num_stored_tx_frames--;
         l2cap_channel->unacked_frames--;
-        log_info("RR seq %u => packet with tx_seq %u done", req_seq, tx_state->tx_seq);
+        log_debug("RR seq %u => packet with tx_seq %u done", req_seq, tx_state->tx_seq);
+
+        tx_state->retransmission_requested = 0;
+        if (tx_state->release_sdu){
+            tx_state->release_sdu = 0;
+            l2cap_emit_simple_event_with_cid(l2cap_channel, L2CAP_EVENT_ERTM_PACKET_SENT);
+        }
 
         l2cap_channel->tx_read_index++;
-        if (l2cap_channel->tx_read_index >= l2cap_channel->num_rx_buffers){
+        if (l2cap_channel->tx_read_index >= l2cap_channel->num_tx_buffers){
             l2cap_channel->tx_read_index = 0;
         }
     }
@@ -756,36 +869,79 @@ static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t
 }     
 }     
 
-static l2cap_ertm_tx_packet_state_t * l2cap_ertm_get_tx_state(l2cap_channel_t * l2cap_channel, uint8_t tx_seq){
-    int i;
-    for (i=0;i<l2cap_channel->num_tx_buffers;i++){
-        l2cap_ertm_tx_packet_state_t * tx_state = &l2cap_channel->tx_packets_state[i];
-        if (tx_state->tx_seq == tx_seq) return tx_state;
+// only unacknowledged frames can be requested. frames are stored in order of tx_seq starting at tx_read_index
+static l2cap_ertm_tx_packet_state_t * l2cap_ertm_get_tx_state(l2cap_channel_t * l2cap_channel, uint16_t tx_seq){
+    if (l2cap_channel->unacked_frames == 0) return NULL;
+    const l2cap_ertm_tx_packet_state_t * oldest = &l2cap_channel->tx_packets_state[l2cap_channel->tx_read_index];
+    uint16_t delta = (tx_seq - oldest->tx_seq) & l2cap_ertm_seq_nr_mask(l2cap_channel);
+    if (delta >= l2cap_channel->unacked_frames) return NULL;
+    uint32_t index = l2cap_channel->tx_read_index + delta;
+    if (index >= l2cap_channel->num_tx_buffers){
+        index -= l2cap_channel->num_tx_buffers;
     }
-    return NULL;
+    return &l2cap_channel->tx_packets_state[index];
 }
 
-// @param delta number of frames in the future, >= 1
-// @assumption size <= l2cap_channel->local_mps (checked in l2cap_acl_classic_handler)
-static void l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel_t * l2cap_channel, l2cap_segmentation_and_reassembly_t sar, int delta, const uint8_t * payload, uint16_t size){
-    log_info("Store SDU with delta %u", delta);
-    // get rx state for packet to store
-    int index = l2cap_channel->rx_store_index + delta - 1;
-    if (index > l2cap_channel->num_rx_buffers){
+static inline uint16_t l2cap_ertm_rx_index_for_delta(const l2cap_channel_t * l2cap_channel, uint16_t delta){
+    uint32_t index = l2cap_channel->rx_store_index + delta;
+    if (index >= l2cap_channel->num_rx_buffers){
         index -= l2cap_channel->num_rx_buffers;
     }
+    return (uint16_t) index;
+}
+
+// rx buffers have room for local_mps plus SDU length
+static inline uint8_t * l2cap_ertm_rx_packet_data(const l2cap_channel_t * l2cap_channel, uint16_t index){
+    return &l2cap_channel->rx_packets_data[(uint32_t) index * (l2cap_channel->local_mps + 2u)];
+}
+
+// advance expected_tx_seq after in-sequence frame, SREJ cursors stay within [expected_tx_seq, expected_tx_seq + rx window]
+static void l2cap_ertm_next_expected_tx_seq(l2cap_channel_t * l2cap_channel){
+    if (l2cap_channel->srej_next_tx_seq == l2cap_channel->expected_tx_seq){
+        l2cap_channel->srej_next_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel, l2cap_channel->srej_next_tx_seq);
+    }
+    if (l2cap_channel->srej_end_tx_seq == l2cap_channel->expected_tx_seq){
+        l2cap_channel->srej_end_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel, l2cap_channel->srej_end_tx_seq);
+    }
+    l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel, l2cap_channel->expected_tx_seq);
+    l2cap_channel->req_seq         = l2cap_channel->expected_tx_seq;
+    l2cap_channel->rx_store_index  = l2cap_ertm_rx_index_for_delta(l2cap_channel, 1);
+}
+
+// get next missing frame before highest stored out-of-order frame, returns -1 if none
+static int l2cap_ertm_next_missing_tx_seq(l2cap_channel_t * l2cap_channel){
+    uint16_t mask = l2cap_ertm_seq_nr_mask(l2cap_channel);
+    while (l2cap_channel->srej_next_tx_seq != l2cap_channel->srej_end_tx_seq){
+        uint16_t tx_seq = l2cap_channel->srej_next_tx_seq;
+        uint16_t index  = l2cap_ertm_rx_index_for_delta(l2cap_channel, (tx_seq - l2cap_channel->expected_tx_seq) & mask);
+        l2cap_channel->srej_next_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel, tx_seq);
+        if (l2cap_channel->rx_packets_state[index].valid == 0) return tx_seq;
+    }
+    return -1;
+}
+
+// @param delta number of frames in the future, >= 1 and < rx window
+static void l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel_t * l2cap_channel, l2cap_segmentation_and_reassembly_t sar, uint16_t delta, const uint8_t * payload, uint16_t size){
+    log_info("Store SDU with delta %u", delta);
+    // get rx state for packet to store
+    uint16_t index = l2cap_ertm_rx_index_for_delta(l2cap_channel, delta);
     log_info("Index of packet to store %u", index);
     l2cap_ertm_rx_packet_state_t * rx_state = &l2cap_channel->rx_packets_state[index];
     // check if buffer is free
     if (rx_state->valid){
-        log_error("Packet buffer already used");
+        log_info("Packet buffer already used");
         return;
     }
+    // request missing frames up to this one
+    uint16_t mask = l2cap_ertm_seq_nr_mask(l2cap_channel);
+    if (delta >= ((l2cap_channel->srej_end_tx_seq - l2cap_channel->expected_tx_seq) & mask)){
+        l2cap_channel->srej_end_tx_seq = (l2cap_channel->expected_tx_seq + delta + 1) & mask;
+    }
+    l2cap_channel->send_supervisor_frame_selective_reject = 1;
     rx_state->valid = 1;
     rx_state->sar = sar;
     rx_state->len = size;
-    uint8_t * rx_buffer = &l2cap_channel->rx_packets_data[index];
-    (void)memcpy(rx_buffer, payload, size);
+    (void)memcpy(l2cap_ertm_rx_packet_data(l2cap_channel, index), payload, size);
 }
 
 // @assumption size <= l2cap_channel->local_mps (checked in l2cap_acl_classic_handler)
@@ -878,6 +1034,9 @@ void l2cap_init(void){
 #endif
     sig_seq_nr  = 0xff;
     l2cap_channels = NULL;
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    btstack_hash_index_init(&l2cap_channel_index, l2cap_channel_index_entries, L2CAP_CHANNEL_INDEX_SIZE);
+#endif
 
 #ifdef ENABLE_CLASSIC
     l2cap_services = NULL;
@@ -887,6 +1046,7 @@ void l2cap_init(void){
     l2cap_fixed_channel_connectionless.local_cid     = L2CAP_CID_CONNECTIONLESS_CHANNEL;
     l2cap_fixed_channel_connectionless.channel_type  = L2CAP_CHANNEL_TYPE_CONNECTIONLESS;
     btstack_linked_list_add(&l2cap_channels, (btstack_linked_item_t *) &l2cap_fixed_channel_connectionless);
+    l2cap_channel_index_add(&l2cap_fixed_channel_connectionless);
 #endif
 
 #ifdef ENABLE_LE_DATA_CHANNELS
@@ -901,11 +1061,13 @@ void l2cap_init(void){
     l2cap_fixed_channel_att.local_cid    = L2CAP_CID_ATTRIBUTE_PROTOCOL;
     l2cap_fixed_channel_att.channel_type = L2CAP_CHANNEL_TYPE_LE_FIXED;
     btstack_linked_list_add(&l2cap_channels, (btstack_linked_item_t *) &l2cap_fixed_channel_att);
+    l2cap_channel_index_add(&l2cap_fixed_channel_att);
 
     // Setup fixed SM Channel
     l2cap_fixed_channel_sm.local_cid     = L2CAP_CID_SECURITY_MANAGER_PROTOCOL;
     l2cap_fixed_channel_sm.channel_type  = L2CAP_CHANNEL_TYPE_LE_FIXED;
     btstack_linked_list_add(&l2cap_channels, (btstack_linked_item_t *) &l2cap_fixed_channel_sm);
+    l2cap_channel_index_add(&l2cap_fixed_channel_sm);
 #endif
     
     // 
@@ -1116,6 +1278,11 @@ static void l2cap_handle_channel_closed(l2cap_channel_t * channel){
 #endif
 
 static l2cap_fixed_channel_t * l2cap_channel_item_by_cid(uint16_t cid){
+#ifdef ENABLE_L2CAP_CHANNEL_INDEX
+    l2cap_fixed_channel_t * channel = (l2cap_fixed_channel_t *) btstack_hash_index_get(&l2cap_channel_index, cid);
+    if (channel != NULL) return channel;
+    if (btstack_hash_index_complete(&l2cap_channel_index)) return NULL;
+#endif
     btstack_linked_list_iterator_t it;    
     btstack_linked_list_iterator_init(&it, &l2cap_channels);
     while (btstack_linked_list_iterator_has_next(&it)){
@@ -1231,6 +1398,7 @@ static void l2cap_rtx_timeout(btstack_timer_source_t * ts){
     l2cap_handle_channel_open_failed(channel, L2CAP_CONNECTION_RESPONSE_RESULT_RTX_TIMEOUT);
 
     // discard channel
+    l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
     btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
     l2cap_free_channel_entry(channel);
 }
@@ -1288,26 +1456,15 @@ static int l2cap_send_signaling_packet(hci_con_handle_t handle, L2CAP_SIGNALING_
 }
 
 // assumption - only on Classic connections
-// cannot be used for L2CAP ERTM
-int l2cap_send_prepared(uint16_t local_cid, uint16_t len){
-    
-    if (!hci_is_packet_buffer_reserved()){
-        log_error("l2cap_send_prepared called without reserving packet first");
-        return BTSTACK_ACL_BUFFERS_FULL;
-    }
-
-    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
-    if (!channel) {
-        log_error("l2cap_send_prepared no channel for cid 0x%02x", local_cid);
-        return -1;   // TODO: define error
-    }
+// tx_state: stored ERTM I-Frame with payload FCS at the end of the packet, or NULL
+static int l2cap_channel_send_prepared(l2cap_channel_t * channel, uint16_t len, const l2cap_ertm_tx_packet_state_t * tx_state){
 
     if (!hci_can_send_prepared_acl_packet_now(channel->con_handle)){
-        log_info("l2cap_send_prepared cid 0x%02x, cannot send", local_cid);
+        log_info("l2cap_send_prepared cid 0x%02x, cannot send", channel->local_cid);
         return BTSTACK_ACL_BUFFERS_FULL;
     }
     
-    log_debug("l2cap_send_prepared cid 0x%02x, handle %u, 1 credit used", local_cid, channel->con_handle);
+    log_debug("l2cap_send_prepared cid 0x%02x, handle %u, 1 credit used", channel->local_cid, channel->con_handle);
     
     int fcs_size = 0;
 
@@ -1325,16 +1482,42 @@ int l2cap_send_prepared(uint16_t local_cid, uint16_t len){
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
     if (fcs_size){
         // calculate FCS over l2cap data
-        uint16_t fcs = crc16_calc(acl_buffer + 4, 4 + len);
+        uint16_t fcs;
+        if (tx_state != NULL){
+            // only header and control field, payload FCS was calculated when the fragment was stored
+            uint16_t header_len = 4 + len - tx_state->len;
+            fcs = btstack_crc16_combine(btstack_crc16_calc(acl_buffer + 4, header_len), tx_state->fcs, tx_state->len);
+        } else {
+            fcs = btstack_crc16_calc(acl_buffer + 4, 4 + len);
+        }
         log_info("I-Frame: fcs 0x%04x", fcs);
         little_endian_store_16(acl_buffer, 8 + len, fcs);
     }
+#else
+    UNUSED(tx_state);
 #endif
 
     // send
     return hci_send_acl_packet_buffer(len+8+fcs_size);
 }
 
+// cannot be used for L2CAP ERTM
+int l2cap_send_prepared(uint16_t local_cid, uint16_t len){
+    
+    if (!hci_is_packet_buffer_reserved()){
+        log_error("l2cap_send_prepared called without reserving packet first");
+        return BTSTACK_ACL_BUFFERS_FULL;
+    }
+
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        log_error("l2cap_send_prepared no channel for cid 0x%02x", local_cid);
+        return -1;   // TODO: define error
+    }
+
+    return l2cap_channel_send_prepared(channel, len, NULL);
+}
+
 // assumption - only on Classic connections
 int l2cap_send(uint16_t local_cid, uint8_t *data, uint16_t len){
     l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
@@ -1346,7 +1529,7 @@ int l2cap_send(uint16_t local_cid, uint8_t *data, uint16_t len){
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
     // send in ERTM
     if (channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION){
-        return l2cap_ertm_send(channel, data, len);
+        return l2cap_ertm_send(channel, data, len, false);
     }
 #endif
 
@@ -1369,7 +1552,9 @@ int l2cap_send(uint16_t local_cid, uint8_t *data, uint16_t len){
 int l2cap_send_echo_request(hci_con_handle_t con_handle, uint8_t *data, uint16_t len){
     return l2cap_send_signaling_packet(con_handle, ECHO_REQUEST, 0x77, len, data);
 }
+#endif
 
+#ifdef L2CAP_USES_CHANNELS
 static inline void channelStateVarSetFlag(l2cap_channel_t *channel, L2CAP_CHANNEL_STATE_VAR flag){
     channel->state_var = (L2CAP_CHANNEL_STATE_VAR) (channel->state_var | flag);
 }
@@ -1454,7 +1639,8 @@ static uint32_t l2cap_extended_features_mask(void){
     // extended features request supported, features: fixed channels, unicast connectionless data reception
     uint32_t features = 0x280;
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
-    features |= 0x0028;
+    // enhanced retransmission mode, fcs option, extended window size
+    features |= 0x0128;
 #endif
     return features;
 }
@@ -1467,7 +1653,7 @@ static uint32_t l2cap_extended_features_mask(void){
 static bool l2cap_run_for_classic_channel(l2cap_channel_t * channel){
 
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
-    uint8_t  config_options[18];
+    uint8_t  config_options[22];
 #else
     uint8_t  config_options[10];
 #endif
@@ -1497,6 +1683,7 @@ static bool l2cap_run_for_classic_channel(l2cap_channel_t * channel){
             channel->state = L2CAP_STATE_INVALID;
             l2cap_send_signaling_packet(channel->con_handle, CONNECTION_RESPONSE, channel->remote_sig_id, channel->local_cid, channel->remote_cid, channel->reason, 0);
             // discard channel - l2cap_finialize_channel_close without sending l2cap close event
+            l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
             btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
             l2cap_free_channel_entry(channel);
             channel = NULL;
@@ -1611,7 +1798,7 @@ static void l2cap_run_for_classic_channel_ertm(l2cap_channel_t * channel){
     if (channel->send_supervisor_frame_receiver_ready){
         channel->send_supervisor_frame_receiver_ready = 0;
         log_info("Send S-Frame: RR %u, final %u", channel->req_seq, channel->set_final_bit_after_packet_with_poll_bit_set);
-        uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 0,  channel->set_final_bit_after_packet_with_poll_bit_set, channel->req_seq);
+        uint32_t control = l2cap_encanced_control_field_for_supevisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 0,  channel->set_final_bit_after_packet_with_poll_bit_set, channel->req_seq);
         channel->set_final_bit_after_packet_with_poll_bit_set = 0;
         l2cap_ertm_send_supervisor_frame(channel, control);
         return;
@@ -1619,52 +1806,58 @@ static void l2cap_run_for_classic_channel_ertm(l2cap_channel_t * channel){
     if (channel->send_supervisor_frame_receiver_ready_poll){
         channel->send_supervisor_frame_receiver_ready_poll = 0;
         log_info("Send S-Frame: RR %u with poll=1 ", channel->req_seq);
-        uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 1, 0, channel->req_seq);
+        uint32_t control = l2cap_encanced_control_field_for_supevisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 1, 0, channel->req_seq);
         l2cap_ertm_send_supervisor_frame(channel, control);
         return;
     }
     if (channel->send_supervisor_frame_receiver_not_ready){
         channel->send_supervisor_frame_receiver_not_ready = 0;
         log_info("Send S-Frame: RNR %u", channel->req_seq);
-        uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_RNR_RECEIVER_NOT_READY, 0, 0, channel->req_seq);
+        uint32_t control = l2cap_encanced_control_field_for_supevisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_RNR_RECEIVER_NOT_READY, 0, 0, channel->req_seq);
         l2cap_ertm_send_supervisor_frame(channel, control);
         return;
     }
     if (channel->send_supervisor_frame_reject){
         channel->send_supervisor_frame_reject = 0;
         log_info("Send S-Frame: REJ %u", channel->req_seq);
-        uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_REJ_REJECT, 0, 0, channel->req_seq);
+        uint32_t control = l2cap_encanced_control_field_for_supevisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_REJ_REJECT, 0, 0, channel->req_seq);
         l2cap_ertm_send_supervisor_frame(channel, control);
         return;
     }
     if (channel->send_supervisor_frame_selective_reject){
+        // one SREJ per missing frame
+        int tx_seq = l2cap_ertm_next_missing_tx_seq(channel);
+        if (tx_seq >= 0){
+            log_info("Send S-Frame: SREJ %u", tx_seq);
+            uint32_t control = l2cap_encanced_control_field_for_supevisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_SREJ_SELECTIVE_REJECT, 0, channel->set_final_bit_after_packet_with_poll_bit_set, (uint16_t) tx_seq);
+            channel->set_final_bit_after_packet_with_poll_bit_set = 0;
+            l2cap_ertm_send_supervisor_frame(channel, control);
+            return;
+        }
         channel->send_supervisor_frame_selective_reject = 0;
-        log_info("Send S-Frame: SREJ %u", channel->expected_tx_seq);
-        uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_SREJ_SELECTIVE_REJECT, 0, channel->set_final_bit_after_packet_with_poll_bit_set, channel->expected_tx_seq);
-        channel->set_final_bit_after_packet_with_poll_bit_set = 0;
-        l2cap_ertm_send_supervisor_frame(channel, control);
-        return;
     }
 
     if (channel->srej_active){
-        int i;
-        for (i=0;i<channel->num_tx_buffers;i++){
-            l2cap_ertm_tx_packet_state_t * tx_state = &channel->tx_packets_state[i];
+        // requested frames are unacknowledged, check from oldest
+        uint16_t i;
+        uint16_t index = channel->tx_read_index;
+        for (i=0;i<channel->unacked_frames;i++){
+            l2cap_ertm_tx_packet_state_t * tx_state = &channel->tx_packets_state[index];
             if (tx_state->retransmission_requested) {
                 tx_state->retransmission_requested = 0;
                 uint8_t final = channel->set_final_bit_after_packet_with_poll_bit_set;
                 channel->set_final_bit_after_packet_with_poll_bit_set = 0;
-                l2cap_ertm_send_information_frame(channel, i, final);
-                break;
+                l2cap_ertm_send_information_frame(channel, index, final);
+                // packet was sent
+                return;
+            }
+            index++;
+            if (index >= channel->num_tx_buffers){
+                index = 0;
             }
         }
-        if (i == channel->num_tx_buffers){
-            // no retransmission request found
-            channel->srej_active = 0;
-        } else {
-            // packet was sent
-            return;
-        }
+        // no retransmission request found
+        channel->srej_active = 0;
     }
 }
 #endif /* ERTM */
@@ -1686,6 +1879,10 @@ static void l2cap_run_signaling_response(void) {
         uint16_t info_type     = signaling_responses[0].data;  // INFORMATION_REQUEST
         uint16_t source_cid    = signaling_responses[0].cid;   // CONNECTION_REQUEST
 #endif
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+        uint16_t num_cids      = signaling_responses[0].cid;   // CREDIT_BASED_CONNECTION_REQUEST
+        uint8_t  destination_cids[2 * L2CAP_ECBM_MAX_CHANNELS];
+#endif
 
         // remove first item before sending (to avoid sending response mutliple times)
         signaling_responses_pending--;
@@ -1744,6 +1941,16 @@ static void l2cap_run_signaling_response(void) {
             case COMMAND_REJECT_LE:
                 l2cap_send_le_signaling_packet(handle, COMMAND_REJECT, sig_id, result, 0, NULL);
                 break;
+#endif
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+            case CREDIT_BASED_CONNECTION_REQUEST:
+                // all connections refused: destination cid 0x0000 for each requested channel
+                memset(destination_cids, 0, sizeof(destination_cids));
+                l2cap_send_le_signaling_packet(handle, CREDIT_BASED_CONNECTION_RESPONSE, sig_id, 0, 0, 0, result, 2u * num_cids, destination_cids);
+                break;
+            case CREDIT_BASED_RECONFIGURE_REQUEST:
+                l2cap_send_le_signaling_packet(handle, CREDIT_BASED_RECONFIGURE_RESPONSE, sig_id, result);
+                break;
 #endif
             default:
                 // should not happen
@@ -1772,7 +1979,266 @@ static bool l2ap_run_ertm(void){
 }
 #endif
 
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+// collect channels of a Credit Based Connection or Reconfigure Request in list order, they share con handle and sig id
+static uint8_t l2cap_ecbm_get_channels_for_request(hci_con_handle_t con_handle, L2CAP_STATE state, L2CAP_CHANNEL_STATE_VAR state_var,
+                                                   uint8_t sig_id, bool remote_sig_id, l2cap_channel_t ** channels){
+    uint8_t num_channels = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &l2cap_channels);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        l2cap_channel_t * channel = (l2cap_channel_t *) btstack_linked_list_iterator_next(&it);
+        if (channel->channel_type != L2CAP_CHANNEL_TYPE_LE_DATA_CHANNEL) continue;
+        if (channel->ecbm == 0u) continue;
+        if (channel->con_handle != con_handle) continue;
+        if (channel->state != state) continue;
+        if ((channel->state_var & state_var) != state_var) continue;
+        if ((remote_sig_id ? channel->remote_sig_id : channel->local_sig_id) != sig_id) continue;
+        channels[num_channels++] = channel;
+        if (num_channels == L2CAP_ECBM_MAX_CHANNELS) break;
+    }
+    return num_channels;
+}
+
+// MPS follows MTU, API ensures that it is not below L2CAP_ECBM_MIN_MTU
+static uint16_t l2cap_ecbm_local_mps(uint16_t mtu){
+    uint16_t mps = btstack_min(l2cap_max_le_mtu(), mtu);
+    btstack_assert(mps >= L2CAP_ECBM_MIN_MTU);
+    return mps;
+}
+
+static void l2cap_ecbm_send_connection_request(l2cap_channel_t * channel){
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t source_cids[2 * L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_channels = l2cap_ecbm_get_channels_for_request(channel->con_handle, L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_REQUEST,
+                                                               L2CAP_CHANNEL_STATE_VAR_NONE, channel->local_sig_id, false, channels);
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        channels[i]->state = L2CAP_STATE_WAIT_ENHANCED_CONNECTION_RESPONSE;
+        channels[i]->credits_incoming = channels[i]->new_credits_incoming;
+        channels[i]->new_credits_incoming = 0;
+        little_endian_store_16(source_cids, 2u * i, channels[i]->local_cid);
+    }
+    // spsm, mtu, mps, initial credits, source cids - mtu and credits are the same for all channels
+    uint16_t mps = l2cap_ecbm_local_mps(channel->local_mtu);
+    l2cap_send_le_signaling_packet(channel->con_handle, CREDIT_BASED_CONNECTION_REQUEST, channel->local_sig_id, channel->psm,
+                                   channel->local_mtu, mps, channel->credits_incoming, 2u * num_channels, source_cids);
+}
+
+static void l2cap_ecbm_send_connection_response(l2cap_channel_t * channel, btstack_linked_list_iterator_t * it){
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t destination_cids[2 * L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_channels = l2cap_ecbm_get_channels_for_request(channel->con_handle, L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_RESPONSE,
+                                                               L2CAP_CHANNEL_STATE_VAR_NONE, channel->remote_sig_id, true, channels);
+    // refused channels have a reason set and use destination cid 0x0000
+    l2cap_channel_t * accepted_channel = NULL;
+    uint8_t num_accepted = 0;
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        uint16_t destination_cid = 0;
+        if (channels[i]->reason == 0u){
+            destination_cid = channels[i]->local_cid;
+            accepted_channel = channels[i];
+            num_accepted++;
+        }
+        little_endian_store_16(destination_cids, 2u * i, destination_cid);
+    }
+    uint16_t result;
+    uint16_t mtu = 0;
+    uint16_t mps = 0;
+    uint16_t credits = 0;
+    if (num_accepted == 0u){
+        result = channel->reason;
+    } else {
+        // 0x0004 Some connections refused – insufficient resources available
+        result = (num_accepted == num_channels) ? 0x0000 : 0x0004;
+        mtu = accepted_channel->local_mtu;
+        mps = l2cap_ecbm_local_mps(mtu);
+        credits = accepted_channel->new_credits_incoming;
+    }
+
+    // update state before sending, as l2cap_run is called again on synchronous transports
+    for (i=0;i<num_channels;i++){
+        if (channels[i]->reason != 0u){
+            channels[i]->state = L2CAP_STATE_INVALID;
+            continue;
+        }
+        channels[i]->state = L2CAP_STATE_OPEN;
+        channels[i]->credits_incoming = channels[i]->new_credits_incoming;
+        channels[i]->new_credits_incoming = 0;
+    }
+    l2cap_send_le_signaling_packet(channel->con_handle, CREDIT_BASED_CONNECTION_RESPONSE, channel->remote_sig_id, mtu, mps, credits,
+                                   result, 2u * num_channels, destination_cids);
+
+    // notify client about accepted channels
+    for (i=0;i<num_channels;i++){
+        if (channels[i]->reason != 0u) continue;
+        l2cap_emit_le_channel_opened(channels[i], 0);
+    }
+
+    // discard refused channels without event
+    bool channels_removed = false;
+    for (i=0;i<num_channels;i++){
+        if (channels[i]->reason == 0u) continue;
+        l2cap_channel_index_remove((l2cap_fixed_channel_t *) channels[i]);
+        btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channels[i]);
+        l2cap_free_channel_entry(channels[i]);
+        channels_removed = true;
+    }
+
+    // iterator might point to a removed channel, start over
+    if (channels_removed){
+        btstack_linked_list_iterator_init(it, &l2cap_channels);
+    }
+}
+
+static void l2cap_ecbm_send_reconfigure_request(l2cap_channel_t * channel){
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t source_cids[2 * L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_channels = l2cap_ecbm_get_channels_for_request(channel->con_handle, L2CAP_STATE_OPEN, L2CAP_CHANNEL_STATE_VAR_SEND_RECONFIGURE_REQ,
+                                                               channel->local_sig_id, false, channels);
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        channelStateVarClearFlag(channels[i], L2CAP_CHANNEL_STATE_VAR_SEND_RECONFIGURE_REQ);
+        channelStateVarSetFlag(channels[i], L2CAP_CHANNEL_STATE_VAR_WAIT_RECONFIGURE_RSP);
+        little_endian_store_16(source_cids, 2u * i, channels[i]->local_cid);
+    }
+    // MPS follows MTU and does not decrease as MTU must not be reduced
+    uint16_t mps = l2cap_ecbm_local_mps(channel->reconfigure_mtu);
+    l2cap_send_le_signaling_packet(channel->con_handle, CREDIT_BASED_RECONFIGURE_REQUEST, channel->local_sig_id,
+                                   channel->reconfigure_mtu, mps, 2u * num_channels, source_cids);
+}
+#endif
+
 #ifdef ENABLE_LE_DATA_CHANNELS
+static void l2cap_le_credits_set_budget(l2cap_channel_t * channel, uint32_t budget){
+    l2cap_le_credit_controller_t * controller = &channel->credit_controller;
+    uint16_t mps = btstack_min(l2cap_max_le_mtu(), channel->local_mtu);
+    uint32_t credits = budget / btstack_max(mps, 1u);
+    controller->budget_bytes = budget;
+    controller->budget = (uint16_t) btstack_max(1u, btstack_min(credits, 0xfff0u));
+    controller->target = btstack_min(controller->target, controller->budget);
+}
+
+static void l2cap_le_credits_init(l2cap_channel_t * channel, uint16_t initial_credits){
+    l2cap_le_credit_controller_t * controller = &channel->credit_controller;
+    memset(controller, 0, sizeof(l2cap_le_credit_controller_t));
+    controller->target = L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INITIAL;
+    l2cap_le_credits_set_budget(channel, L2CAP_LE_DATA_CHANNELS_CREDIT_BUDGET);
+    channel->automatic_credits = initial_credits == L2CAP_LE_AUTOMATIC_CREDITS;
+    if (channel->automatic_credits){
+        // start small, target grows with measured rate and round trip time
+        channel->new_credits_incoming = controller->target;
+    } else {
+        channel->new_credits_incoming = initial_credits;
+    }
+}
+
+static uint16_t l2cap_le_credits_rtt_ms(l2cap_channel_t * channel){
+    if (channel->credit_controller.rtt_ms != 0u){
+        return channel->credit_controller.rtt_ms;
+    }
+    // credits and next K-Frame need at least two connection events (interval in 1.25 ms units)
+    uint16_t conn_interval = gap_le_connection_interval(channel->con_handle);
+    if (conn_interval == 0u){
+        return L2CAP_LE_DATA_CHANNELS_DEFAULT_RTT_MS;
+    }
+    return (conn_interval * 5u) / 2u;
+}
+
+static l2cap_le_credit_grant_t * l2cap_le_credits_get_grant(l2cap_le_credit_controller_t * controller, uint16_t credit){
+    uint8_t i;
+    for (i=0;i<L2CAP_LE_CREDIT_GRANTS_NUM;i++){
+        l2cap_le_credit_grant_t * grant = &controller->grants[i];
+        if ((uint16_t)(credit - grant->first_credit) < grant->num_credits){
+            return grant;
+        }
+    }
+    return NULL;
+}
+
+// credits are about to be sent to remote
+static void l2cap_le_credits_granted(l2cap_channel_t * channel, uint16_t num_credits){
+    l2cap_le_credit_controller_t * controller = &channel->credit_controller;
+    l2cap_le_credit_grant_t * grant = &controller->grants[controller->grants_index];
+    controller->grants_index = (controller->grants_index + 1u) % L2CAP_LE_CREDIT_GRANTS_NUM;
+    grant->time_ms = btstack_run_loop_get_time_ms();
+    grant->first_credit = controller->next_credit + channel->credits_incoming;
+    grant->num_credits = num_credits;
+}
+
+static void l2cap_le_credits_k_frame_received(l2cap_channel_t * channel){
+    l2cap_le_credit_controller_t * controller = &channel->credit_controller;
+    uint32_t now = btstack_run_loop_get_time_ms();
+    uint16_t credit = controller->next_credit++;
+
+    // starvation ends with next K-Frame
+    if (controller->starved != 0u){
+        controller->starved = 0;
+        controller->starvation_ms += now - controller->starved_since_ms;
+    }
+
+    // round trip time: first K-Frame using a grant was sent after grant was received by remote.
+    // sample is exact if remote was waiting for credits, track minimum and follow increases slowly
+    l2cap_le_credit_grant_t * grant = l2cap_le_credits_get_grant(controller, credit);
+    if ((grant != NULL) && (grant->first_credit == credit)){
+        uint32_t sample = btstack_max(1u, btstack_min(now - grant->time_ms, 0xffffu));
+        if ((controller->rtt_ms == 0u) || (sample < controller->rtt_ms)){
+            controller->rtt_ms = (uint16_t) sample;
+        } else {
+            controller->rtt_ms += (uint16_t) ((sample - controller->rtt_ms) / 8u);
+        }
+    }
+
+    // remote used its last credit, or next credit was granted less than a round trip before K-Frame was sent
+    uint16_t rtt_ms = l2cap_le_credits_rtt_ms(channel);
+    bool starved = channel->credits_incoming == 0u;
+    grant = l2cap_le_credits_get_grant(controller, credit + 1u);
+    if ((grant != NULL) && ((now - grant->time_ms) < rtt_ms)){
+        starved = true;
+    }
+    if (starved){
+        controller->starved = 1;
+        controller->starved_since_ms = now;
+        controller->starvation_count++;
+        controller->interval_starved = 1;
+    }
+
+    if (channel->automatic_credits == 0u) return;
+
+    // rate: K-Frames per measurement interval of at least one round trip
+    if (controller->interval_k_frames == 0u){
+        controller->interval_start_ms = now;
+    }
+    controller->interval_k_frames++;
+    uint32_t interval_ms = now - controller->interval_start_ms;
+    if (interval_ms >= btstack_max(rtt_ms, L2CAP_LE_DATA_CHANNELS_RATE_INTERVAL_MIN_MS)){
+        uint32_t sample = btstack_min((1000u * controller->interval_k_frames) / interval_ms, 0xffffu);
+        if (controller->rate == 0u){
+            controller->rate = (uint16_t) sample;
+        } else {
+            controller->rate = (uint16_t) ((controller->rate + sample) / 2u);
+        }
+        controller->interval_k_frames = 0;
+        // keep pipe full: twice the credits consumed per round trip, within memory budget
+        uint32_t target = ((uint32_t) controller->rate * rtt_ms * 2u) / 1000u + 1u;
+        target = btstack_max(target, L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MIN);
+        // rate was limited by credits: double target per round trip
+        if (controller->interval_starved != 0u){
+            controller->interval_starved = 0;
+            target = btstack_max(target, 2u * controller->target);
+        }
+        controller->target = (uint16_t) btstack_min(target, controller->budget);
+    }
+
+    // grant credits in batches when remote has used a quarter of the target. With target of two round trips,
+    // remote still has credits for half a round trip when the grant arrives
+    uint16_t outstanding = channel->credits_incoming + channel->new_credits_incoming;
+    if (outstanding <= ((3u * controller->target) / 4u)){
+        channel->new_credits_incoming = controller->target - channel->credits_incoming;
+    }
+}
+
 static void l2cap_run_le_data_channels(void){
     btstack_linked_list_iterator_t it;
     btstack_linked_list_iterator_init(&it, &l2cap_channels);
@@ -1794,6 +2260,16 @@ static void l2cap_run_le_data_channels(void){
                 mps = btstack_min(l2cap_max_le_mtu(), channel->local_mtu);
                 l2cap_send_le_signaling_packet( channel->con_handle, LE_CREDIT_BASED_CONNECTION_REQUEST, channel->local_sig_id, channel->psm, channel->local_cid, channel->local_mtu, mps, channel->credits_incoming);
                 break;
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+            case L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_REQUEST:
+                if (!hci_can_send_acl_packet_now(channel->con_handle)) break;
+                l2cap_ecbm_send_connection_request(channel);
+                break;
+            case L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_RESPONSE:
+                if (!hci_can_send_acl_packet_now(channel->con_handle)) break;
+                l2cap_ecbm_send_connection_response(channel, &it);
+                break;
+#endif
             case L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_ACCEPT:
                 if (!hci_can_send_acl_packet_now(channel->con_handle)) break;
                 // TODO: support larger MPS
@@ -1810,20 +2286,30 @@ static void l2cap_run_le_data_channels(void){
                 channel->state = L2CAP_STATE_INVALID;
                 l2cap_send_le_signaling_packet(channel->con_handle, LE_CREDIT_BASED_CONNECTION_RESPONSE, channel->remote_sig_id, 0, 0, 0, 0, channel->reason);
                 // discard channel - l2cap_finialize_channel_close without sending l2cap close event
+                l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
                 btstack_linked_list_iterator_remove(&it);
                 l2cap_free_channel_entry(channel);
                 break;
             case L2CAP_STATE_OPEN:
                 if (!hci_can_send_acl_packet_now(channel->con_handle)) break;
 
-                // send credits
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+                // send reconfigure request
+                if (channel->state_var & L2CAP_CHANNEL_STATE_VAR_SEND_RECONFIGURE_REQ){
+                    l2cap_ecbm_send_reconfigure_request(channel);
+                    break;
+                }
+#endif
+
+                // send credits - no response expected, local_sig_id is kept for pending requests
                 if (channel->new_credits_incoming){
                     log_info("l2cap: sending %u credits", channel->new_credits_incoming);
-                    channel->local_sig_id = l2cap_next_sig_id();
                     uint16_t new_credits = channel->new_credits_incoming;
                     channel->new_credits_incoming = 0;
+                    l2cap_le_credits_granted(channel, new_credits);
                     channel->credits_incoming += new_credits;
-                    l2cap_send_le_signaling_packet(channel->con_handle, LE_FLOW_CONTROL_CREDIT, channel->local_sig_id, channel->remote_cid, new_credits);
+                    // cid is the source cid of the device that grants the credits
+                    l2cap_send_le_signaling_packet(channel->con_handle, LE_FLOW_CONTROL_CREDIT, l2cap_next_sig_id(), channel->local_cid, new_credits);
                 }
                 break;
 
@@ -2034,6 +2520,7 @@ uint8_t l2cap_create_channel(btstack_packet_handler_t channel_packet_handler, bd
 
     // add to connections list
     btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_channel_index_add((l2cap_fixed_channel_t *) channel);
 
     // store local_cid
     if (out_local_cid){
@@ -2104,6 +2591,7 @@ static void l2cap_handle_connection_failed_for_addr(bd_addr_t address, uint8_t s
                 // failure, forward error code
                 l2cap_handle_channel_open_failed(channel, status);
                 // discard channel
+                l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
                 btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
                 l2cap_free_channel_entry(channel);
                 break;
@@ -2136,6 +2624,7 @@ static bool l2cap_channel_ready_to_send(l2cap_channel_t * channel){
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
             // send if we have more data and remote windows isn't full yet
             if (channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION) {
+                if (channel->wait_final) return false;
                 if (channel->unacked_frames >= btstack_min(channel->num_stored_tx_frames, channel->remote_tx_window_size)) return false;
                 return hci_can_send_acl_classic_packet_now() != 0;
             }
@@ -2188,7 +2677,13 @@ static void l2cap_channel_trigger_send(l2cap_channel_t * channel){
             break;
 #ifdef ENABLE_LE_DATA_CHANNELS
         case L2CAP_CHANNEL_TYPE_LE_DATA_CHANNEL:
-            l2cap_le_send_pdu(channel);
+            // send K-Frames of current SDU back-to-back while credits and controller buffers are available
+            // stop after last K-Frame, as the app might have closed the channel on L2CAP_EVENT_LE_PACKET_SENT
+            while (true){
+                bool sdu_sent = l2cap_le_send_pdu(channel);
+                if (sdu_sent) break;
+                if (!l2cap_channel_ready_to_send(channel)) break;
+            }
             break;
 #endif
 #endif
@@ -2198,6 +2693,10 @@ static void l2cap_channel_trigger_send(l2cap_channel_t * channel){
 }
 
 static void l2cap_notify_channel_can_send(void){
+    // called again when HCI_EVENT_TRANSPORT_PACKET_SENT is emitted during send on synchronous transports
+    // outer invocation checks all channels again after each send, so there's no need to recurse
+    if (l2cap_notify_channel_can_send_active) return;
+    l2cap_notify_channel_can_send_active = true;
     bool done = false;
     while (!done){
         done = true;
@@ -2220,6 +2719,7 @@ static void l2cap_notify_channel_can_send(void){
             break;
         }
     }
+    l2cap_notify_channel_can_send_active = false;
 }
 
 #ifdef L2CAP_USES_CHANNELS
@@ -2241,6 +2741,8 @@ static int l2cap_send_open_failed_on_hci_disconnect(l2cap_channel_t * channel){
         case L2CAP_STATE_WILL_SEND_CONNECTION_REQUEST:
         case L2CAP_STATE_WILL_SEND_LE_CONNECTION_REQUEST:
         case L2CAP_STATE_WAIT_LE_CONNECTION_RESPONSE:
+        case L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_REQUEST:
+        case L2CAP_STATE_WAIT_ENHANCED_CONNECTION_RESPONSE:
         case L2CAP_STATE_EMIT_OPEN_FAILED_AND_DISCARD:
             return 1;
 
@@ -2255,6 +2757,7 @@ static int l2cap_send_open_failed_on_hci_disconnect(l2cap_channel_t * channel){
         case L2CAP_STATE_WILL_SEND_DISCONNECT_RESPONSE:
         case L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_DECLINE:
         case L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_ACCEPT:
+        case L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_RESPONSE:
         case L2CAP_STATE_INVALID:
         case L2CAP_STATE_WAIT_INCOMING_SECURITY_LEVEL_UPDATE:
             return 0;
@@ -2392,6 +2895,7 @@ static void l2cap_handle_disconnection_complete(hci_con_handle_t handle){
         l2cap_channel_t *channel = (l2cap_channel_t *) btstack_linked_list_iterator_next(&it);
         if (!l2cap_is_dynamic_channel_type(channel->channel_type)) continue;
         if (channel->con_handle != handle) continue;
+        l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
         btstack_linked_list_iterator_remove(&it);
         btstack_linked_list_add(&channels_to_close, (btstack_linked_item_t *) channel);
     }
@@ -2591,6 +3095,7 @@ static void l2cap_handle_connection_request(hci_con_handle_t handle, uint8_t sig
     
     // add to connections list
     btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_channel_index_add((l2cap_fixed_channel_t *) channel);
 
     // assert security requirements
     gap_request_security_level(handle, channel->required_security_level);
@@ -2632,6 +3137,7 @@ static void l2cap_signaling_handle_configure_request(l2cap_channel_t *channel, u
 
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
     uint8_t use_fcs = 1;
+    uint16_t extended_window_size = 0;
 #endif
 
     channel->remote_sig_id = command[L2CAP_SIGNALING_COMMAND_SIGID_OFFSET];
@@ -2714,6 +3220,10 @@ static void l2cap_signaling_handle_configure_request(l2cap_channel_t *channel, u
         if (option_type == L2CAP_CONFIG_OPTION_TYPE_FRAME_CHECK_SEQUENCE && length == 1){
             use_fcs = command[pos];
         }        
+        // Extended Window Size { type(8): 7, len(8): 2, Max Window Size(16) }
+        if (option_type == L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE && length == 2){
+            extended_window_size = btstack_min(little_endian_read_16(command, pos), L2CAP_ERTM_MAX_TX_WINDOW_EXTENDED);
+        }
 #endif        
         // check for unknown options
         if ((option_hint == 0) && ((option_type < L2CAP_CONFIG_OPTION_TYPE_MAX_TRANSMISSION_UNIT) || (option_type > L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE))){
@@ -2728,6 +3238,12 @@ static void l2cap_signaling_handle_configure_request(l2cap_channel_t *channel, u
         uint8_t update = channel->fcs_option || use_fcs;
         log_info("local fcs: %u, remote fcs: %u -> %u", channel->fcs_option, use_fcs, update);
         channel->fcs_option = update;
+        // Extended Window Size replaces TxWindow of Retransmission and Flow Control option and implies Extended Control Field
+        if ((extended_window_size > 0) && (channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION)){
+            log_info("Extended Window Size %u", extended_window_size);
+            channel->remote_tx_window_size = extended_window_size;
+            channel->extended_control = 1;
+        }
         // If ERTM mandatory, but remote didn't send Retransmission and Flowcontrol options -> disconnect
         if (((channel->state_var & L2CAP_CHANNEL_STATE_VAR_SEND_CONF_RSP_ERTM) == 0) & (channel->ertm_mandatory)){
             channel->state = L2CAP_STATE_WILL_SEND_DISCONNECT_REQUEST;
@@ -2850,6 +3366,7 @@ static void l2cap_signaling_handler_channel(l2cap_channel_t *channel, uint8_t *c
                             }
                             
                             // discard channel
+                            l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
                             btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
                             l2cap_free_channel_entry(channel);
                             break;
@@ -2915,10 +3432,10 @@ static void l2cap_signaling_handler_channel(l2cap_channel_t *channel, uint8_t *c
                 // assert that packet can be stored in fragment buffers in ertm
                 if (channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION){
                     uint16_t effective_mps = btstack_min(channel->remote_mps, channel->local_mps);
-                    uint16_t usable_mtu = channel->num_tx_buffers == 1 ? effective_mps : channel->num_tx_buffers * effective_mps - 2;
+                    uint32_t usable_mtu = channel->num_tx_buffers == 1 ? effective_mps : ((uint32_t) channel->num_tx_buffers) * effective_mps - 2;
                     if (usable_mtu < channel->remote_mtu){
                         log_info("Remote MTU %u > max storable ERTM packet, only using MTU = %u", channel->remote_mtu, usable_mtu);
-                        channel->remote_mtu = usable_mtu;
+                        channel->remote_mtu = (uint16_t) usable_mtu;
                     }
                 }
 #endif
@@ -3039,6 +3556,7 @@ static void l2cap_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t *
                             // map l2cap connection response result to BTstack status enumeration
                             l2cap_handle_channel_open_failed(channel, L2CAP_CONNECTION_RESPONSE_RESULT_ERTM_NOT_SUPPORTED);
                             // discard channel
+                            l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
                             btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
                             l2cap_free_channel_entry(channel);
                             continue;
@@ -3102,6 +3620,280 @@ static void l2cap_emit_connection_parameter_update_response(hci_con_handle_t con
     (*l2cap_event_packet_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
 }
 
+#ifdef ENABLE_LE_DATA_CHANNELS
+static l2cap_channel_t * l2cap_le_get_channel_for_remote_cid_and_handle(uint16_t remote_cid, hci_con_handle_t con_handle){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &l2cap_channels);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        l2cap_channel_t * channel = (l2cap_channel_t *) btstack_linked_list_iterator_next(&it);
+        if (channel->channel_type != L2CAP_CHANNEL_TYPE_LE_DATA_CHANNEL) continue;
+        if (channel->con_handle != con_handle) continue;
+        if (channel->remote_cid != remote_cid) continue;
+        return channel;
+    }
+    return NULL;
+}
+
+// @returns 0 or result code for (LE) Credit Based Connection Response if security requirements of service are not met
+static uint16_t l2cap_le_security_check(hci_con_handle_t handle, const l2cap_service_t * service){
+    // security: check encryption
+    if (service->required_security_level >= LEVEL_2){
+        if (gap_encryption_key_size(handle) == 0){
+            // 0x0008 Connection refused - insufficient encryption
+            return 0x0008;
+        }
+        // anything less than 16 byte key size is insufficient
+        if (gap_encryption_key_size(handle) < 16){
+            // 0x0007 Connection refused – insufficient encryption key size
+            return 0x0007;
+        }
+    }
+
+    // security: check authencation
+    if (service->required_security_level >= LEVEL_3){
+        if (!gap_authenticated(handle)){
+            // 0x0005 Connection refused – insufficient authentication
+            return 0x0005;
+        }
+    }
+
+    // security: check authorization
+    if (service->required_security_level >= LEVEL_4){
+        if (gap_authorization_state(handle) != AUTHORIZATION_GRANTED){
+            // 0x0006 Connection refused – insufficient authorization
+            return 0x0006;
+        }
+    }
+    return 0;
+}
+#endif
+
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+static void l2cap_ecbm_emit_incoming_connection(l2cap_channel_t * channel, uint8_t num_channels){
+    log_info("L2CAP_EVENT_ECBM_INCOMING_CONNECTION addr_type %u, addr %s handle 0x%x psm 0x%x num_channels %u local_cid 0x%x remote_mtu %u",
+             channel->address_type, bd_addr_to_str(channel->address), channel->con_handle, channel->psm, num_channels, channel->local_cid, channel->remote_mtu);
+    uint8_t event[18];
+    event[0] = L2CAP_EVENT_ECBM_INCOMING_CONNECTION;
+    event[1] = sizeof(event) - 2u;
+    event[2] = channel->address_type;
+    reverse_bd_addr(channel->address, &event[3]);
+    little_endian_store_16(event,  9, channel->con_handle);
+    little_endian_store_16(event, 11, channel->psm);
+    event[13] = num_channels;
+    little_endian_store_16(event, 14, channel->local_cid);
+    little_endian_store_16(event, 16, channel->remote_mtu);
+    hci_dump_packet( HCI_EVENT_PACKET, 0, event, sizeof(event));
+    l2cap_dispatch_to_channel(channel, HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void l2cap_ecbm_emit_reconfigured(l2cap_channel_t * channel){
+    uint8_t event[8];
+    event[0] = L2CAP_EVENT_ECBM_RECONFIGURED;
+    event[1] = sizeof(event) - 2u;
+    little_endian_store_16(event, 2, channel->local_cid);
+    little_endian_store_16(event, 4, channel->remote_mtu);
+    little_endian_store_16(event, 6, channel->remote_mps);
+    hci_dump_packet( HCI_EVENT_PACKET, 0, event, sizeof(event));
+    l2cap_dispatch_to_channel(channel, HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void l2cap_ecbm_emit_reconfiguration_complete(l2cap_channel_t * channel, uint16_t result){
+    uint8_t event[6];
+    event[0] = L2CAP_EVENT_ECBM_RECONFIGURATION_COMPLETE;
+    event[1] = sizeof(event) - 2u;
+    little_endian_store_16(event, 2, channel->local_cid);
+    little_endian_store_16(event, 4, result);
+    hci_dump_packet( HCI_EVENT_PACKET, 0, event, sizeof(event));
+    l2cap_dispatch_to_channel(channel, HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void l2cap_ecbm_handle_connection_request(hci_connection_t * connection, uint8_t sig_id, const uint8_t * command, uint16_t len){
+    hci_con_handle_t handle = connection->con_handle;
+
+    // spsm, mtu, mps, initial credits, source cids
+    uint16_t le_psm      = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 0);
+    uint16_t remote_mtu  = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 2);
+    uint16_t remote_mps  = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 4);
+    uint16_t credits     = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 6);
+    uint16_t num_source_cids = (len - 8u) / 2u;
+    uint8_t  num_channels = (uint8_t) btstack_min(num_source_cids, L2CAP_ECBM_MAX_CHANNELS);
+    const uint8_t * source_cids = &command[L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 8];
+
+    uint16_t result;
+    l2cap_service_t * service = l2cap_le_get_service(le_psm);
+    if (service == NULL){
+        // 0x0002 All connections refused – SPSM not supported
+        result = 0x0002;
+    } else if ((num_source_cids > L2CAP_ECBM_MAX_CHANNELS) || (remote_mtu < L2CAP_ECBM_MIN_MTU) || (remote_mps < L2CAP_ECBM_MIN_MTU)){
+        // 0x000c All connections refused – invalid parameters
+        result = 0x000c;
+    } else {
+        result = l2cap_le_security_check(handle, service);
+    }
+
+    // validate source cids, refuse all channels if one of them is invalid or already in use
+    uint8_t i;
+    for (i=0; (i < num_channels) && (result == 0u); i++){
+        uint16_t source_cid = little_endian_read_16(source_cids, 2u * i);
+        if (source_cid < 0x40u){
+            // 0x0009 Some connections refused – invalid Source CID
+            result = 0x0009;
+            break;
+        }
+        // 0x000a Some connections refused – Source CID already allocated, also used for duplicates in request
+        if (l2cap_le_get_channel_for_remote_cid_and_handle(source_cid, handle) != NULL){
+            result = 0x000a;
+        }
+        uint8_t j;
+        for (j=0;j<i;j++){
+            if (little_endian_read_16(source_cids, 2u * j) == source_cid){
+                result = 0x000a;
+            }
+        }
+    }
+
+    // allocate channels
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_allocated = 0;
+    while ((result == 0u) && (num_allocated < num_channels)){
+        l2cap_channel_t * channel = l2cap_create_channel_entry(service->packet_handler, L2CAP_CHANNEL_TYPE_LE_DATA_CHANNEL, connection->address,
+                                                               connection->address_type, le_psm, service->mtu, service->required_security_level);
+        if (channel == NULL){
+            // 0x0004 All connections refused – insufficient resources available
+            result = 0x0004;
+            break;
+        }
+        channels[num_allocated++] = channel;
+    }
+
+    if (result != 0u){
+        for (i=0;i<num_allocated;i++){
+            l2cap_free_channel_entry(channels[i]);
+        }
+        l2cap_register_signaling_response(handle, CREDIT_BASED_CONNECTION_REQUEST, sig_id, num_channels, result);
+        return;
+    }
+
+    for (i=0;i<num_channels;i++){
+        l2cap_channel_t * channel = channels[i];
+        channel->ecbm = 1;
+        channel->con_handle = handle;
+        channel->remote_cid = little_endian_read_16(source_cids, 2u * i);
+        channel->remote_sig_id = sig_id;
+        channel->remote_mtu = remote_mtu;
+        channel->remote_mps = remote_mps;
+        channel->credits_outgoing = credits;
+
+        // set initial state
+        channel->state      = L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT;
+        channel->state_var = (L2CAP_CHANNEL_STATE_VAR) (channel->state_var | L2CAP_CHANNEL_STATE_VAR_INCOMING);
+
+        // add to connections list
+        btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+        l2cap_channel_index_add((l2cap_fixed_channel_t *) channel);
+    }
+
+    // post single connection request event for all channels
+    l2cap_ecbm_emit_incoming_connection(channels[0], num_channels);
+}
+
+static void l2cap_ecbm_handle_connection_response(hci_con_handle_t handle, uint8_t sig_id, uint16_t result, uint16_t remote_mtu,
+                                                  uint16_t remote_mps, uint16_t credits, uint16_t num_destination_cids, const uint8_t * destination_cids){
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_channels = l2cap_ecbm_get_channels_for_request(handle, L2CAP_STATE_WAIT_ENHANCED_CONNECTION_RESPONSE,
+                                                               L2CAP_CHANNEL_STATE_VAR_NONE, sig_id, false, channels);
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        l2cap_channel_t * channel = channels[i];
+        uint16_t destination_cid = 0;
+        if (i < num_destination_cids){
+            destination_cid = little_endian_read_16(destination_cids, 2u * i);
+        }
+        if (destination_cid == 0u){
+            // channel refused, use 0x0004 insufficient resources if result does not tell
+            channel->state = L2CAP_STATE_CLOSED;
+            l2cap_emit_le_channel_opened(channel, (result != 0u) ? result : 0x0004);
+
+            // discard channel
+            l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
+            btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
+            l2cap_free_channel_entry(channel);
+            continue;
+        }
+        channel->remote_cid = destination_cid;
+        channel->remote_mtu = remote_mtu;
+        channel->remote_mps = remote_mps;
+        channel->credits_outgoing = credits;
+        channel->state = L2CAP_STATE_OPEN;
+        l2cap_emit_le_channel_opened(channel, 0);
+    }
+}
+
+// @returns result for Credit Based Reconfigure Response
+static uint16_t l2cap_ecbm_handle_reconfigure_request(hci_con_handle_t handle, const uint8_t * command, uint16_t len){
+    // mtu, mps, destination cids - the remote lists its own cids, which are our remote cids
+    uint16_t new_mtu  = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 0);
+    uint16_t new_mps  = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 2);
+    uint16_t num_cids = (len - 4u) / 2u;
+    if ((num_cids == 0u) || (num_cids > L2CAP_ECBM_MAX_CHANNELS) || (new_mtu < L2CAP_ECBM_MIN_MTU) || (new_mps < L2CAP_ECBM_MIN_MTU)){
+        // 0x0004 Reconfiguration failed - other unacceptable parameters
+        return 0x0004;
+    }
+
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t i;
+    for (i=0;i<num_cids;i++){
+        uint16_t remote_cid = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 4 + (2u * i));
+        l2cap_channel_t * channel = l2cap_le_get_channel_for_remote_cid_and_handle(remote_cid, handle);
+        if ((channel == NULL) || (channel->ecbm == 0u) || (channel->state != L2CAP_STATE_OPEN)){
+            // 0x0003 Reconfiguration failed - one or more Destination CIDs invalid
+            return 0x0003;
+        }
+        if (new_mtu < channel->remote_mtu){
+            // 0x0001 Reconfiguration failed - reduction in size of MTU not allowed
+            return 0x0001;
+        }
+        if ((num_cids > 1u) && (new_mps < channel->remote_mps)){
+            // 0x0002 Reconfiguration failed - reduction in size of MPS not allowed for more than one channel at a time
+            return 0x0002;
+        }
+        channels[i] = channel;
+    }
+
+    for (i=0;i<num_cids;i++){
+        channels[i]->remote_mtu = new_mtu;
+        channels[i]->remote_mps = new_mps;
+        l2cap_ecbm_emit_reconfigured(channels[i]);
+    }
+    return 0;
+}
+
+static void l2cap_ecbm_handle_reconfigure_response(hci_con_handle_t handle, uint8_t sig_id, uint16_t result){
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_channels = l2cap_ecbm_get_channels_for_request(handle, L2CAP_STATE_OPEN, L2CAP_CHANNEL_STATE_VAR_WAIT_RECONFIGURE_RSP,
+                                                               sig_id, false, channels);
+    if (num_channels == 0u) return;
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        l2cap_channel_t * channel = channels[i];
+        channelStateVarClearFlag(channel, L2CAP_CHANNEL_STATE_VAR_WAIT_RECONFIGURE_RSP);
+        if (result == 0u){
+            // switch to new receive buffer, keep partially received SDU
+            if (channel->receive_sdu_len != 0u){
+                (void)memcpy(channel->reconfigure_sdu_buffer, channel->receive_sdu_buffer, channel->receive_sdu_pos);
+            }
+            channel->receive_sdu_buffer = channel->reconfigure_sdu_buffer;
+            channel->local_mtu = channel->reconfigure_mtu;
+            // MPS follows MTU
+            l2cap_le_credits_set_budget(channel, channel->credit_controller.budget_bytes);
+        }
+        channel->reconfigure_sdu_buffer = NULL;
+        channel->reconfigure_mtu = 0;
+    }
+    l2cap_ecbm_emit_reconfiguration_complete(channels[0], result);
+}
+#endif
+
 // @returns valid
 static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t * command, uint8_t sig_id){
     hci_connection_t * connection;
@@ -3117,6 +3909,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
     uint16_t credits_before;
     l2cap_service_t * service;
     uint16_t source_cid;
+    uint16_t remote_cid;
 #endif
 
     uint8_t code   = command[L2CAP_SIGNALING_COMMAND_CODE_OFFSET];
@@ -3175,6 +3968,12 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
 #ifdef ENABLE_LE_DATA_CHANNELS
 
         case COMMAND_REJECT:
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+            // remote does not support Enhanced Credit Based Flow Control Mode
+            // use 0x0002 All connections refused – SPSM not supported, 0x0004 Reconfiguration failed - other unacceptable parameters
+            l2cap_ecbm_handle_connection_response(handle, sig_id, 0x0002, 0, 0, 0, 0, NULL);
+            l2cap_ecbm_handle_reconfigure_response(handle, sig_id, 0x0004);
+#endif
             // Find channel for this sig_id and connection handle
             channel = NULL;
             btstack_linked_list_iterator_init(&it, &l2cap_channels);
@@ -3195,6 +3994,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                 l2cap_emit_le_channel_opened(channel, 0x0002);
                                 
                 // discard channel
+                l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
                 btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
                 l2cap_free_channel_entry(channel);
                 break;
@@ -3233,37 +4033,11 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                     return 1;
                 }                    
 
-                // security: check encryption
-                if (service->required_security_level >= LEVEL_2){
-                    if (gap_encryption_key_size(handle) == 0){
-                        // 0x0008 Connection refused - insufficient encryption 
-                        l2cap_register_signaling_response(handle, LE_CREDIT_BASED_CONNECTION_REQUEST, sig_id, source_cid, 0x0008);
-                        return 1;
-                    }
-                    // anything less than 16 byte key size is insufficient
-                    if (gap_encryption_key_size(handle) < 16){
-                        // 0x0007 Connection refused – insufficient encryption key size
-                        l2cap_register_signaling_response(handle, LE_CREDIT_BASED_CONNECTION_REQUEST, sig_id, source_cid, 0x0007);
-                        return 1;
-                    }
-                }
-
-                // security: check authencation
-                if (service->required_security_level >= LEVEL_3){
-                    if (!gap_authenticated(handle)){
-                        // 0x0005 Connection refused – insufficient authentication
-                        l2cap_register_signaling_response(handle, LE_CREDIT_BASED_CONNECTION_REQUEST, sig_id, source_cid, 0x0005);
-                        return 1;
-                    }
-                }
-
-                // security: check authorization
-                if (service->required_security_level >= LEVEL_4){
-                    if (gap_authorization_state(handle) != AUTHORIZATION_GRANTED){
-                        // 0x0006 Connection refused – insufficient authorization
-                        l2cap_register_signaling_response(handle, LE_CREDIT_BASED_CONNECTION_REQUEST, sig_id, source_cid, 0x0006);
-                        return 1;
-                    }
+                // security: check encryption, authentication, and authorization
+                result = l2cap_le_security_check(handle, service);
+                if (result != 0u){
+                    l2cap_register_signaling_response(handle, LE_CREDIT_BASED_CONNECTION_REQUEST, sig_id, source_cid, result);
+                    return 1;
                 }
 
                 // allocate channel
@@ -3284,10 +4058,11 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
 
                 // set initial state
                 channel->state      = L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT;
-                channel->state_var |= L2CAP_CHANNEL_STATE_VAR_INCOMING;
+                channel->state_var = (L2CAP_CHANNEL_STATE_VAR) (channel->state_var | L2CAP_CHANNEL_STATE_VAR_INCOMING);
 
                 // add to connections list
                 btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+                l2cap_channel_index_add((l2cap_fixed_channel_t *) channel);
 
                 // post connection request event
                 l2cap_emit_le_incoming_connection(channel);
@@ -3323,6 +4098,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                 l2cap_emit_le_channel_opened(channel, result);
                                 
                 // discard channel
+                l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
                 btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
                 l2cap_free_channel_entry(channel);
                 break;
@@ -3341,13 +4117,14 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
             // check size
             if (len < 4u) return 0u;
 
-            // find channel
-            local_cid = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 0);
-            channel = l2cap_get_channel_for_local_cid_and_handle(local_cid, handle);
+            // find channel - cid is the source cid of the device that grants the credits
+            remote_cid = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 0);
+            channel = l2cap_le_get_channel_for_remote_cid_and_handle(remote_cid, handle);
             if (!channel) {
-                log_error("l2cap: no channel for cid 0x%02x", local_cid);
+                log_error("l2cap: no channel for remote cid 0x%02x", remote_cid);
                 break;
             }
+            local_cid = channel->local_cid;
             new_credits = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 2);
             credits_before = channel->credits_outgoing;
             channel->credits_outgoing += new_credits;
@@ -3358,6 +4135,10 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                 break;
             }            
             log_info("l2cap: %u credits for 0x%02x, now %u", new_credits, local_cid, channel->credits_outgoing);
+            // resume sending if blocked by missing credits
+            if (credits_before == 0u){
+                l2cap_notify_channel_can_send();
+            }
             break;
 
         case DISCONNECTION_REQUEST:
@@ -3376,6 +4157,43 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
             channel->state = L2CAP_STATE_WILL_SEND_DISCONNECT_RESPONSE;
             break;
 
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+        case CREDIT_BASED_CONNECTION_REQUEST:
+            // check size: spsm, mtu, mps, initial credits, at least one source cid
+            if (len < 10u) return 0u;
+
+            // get hci connection, bail if not found (must not happen)
+            connection = hci_connection_for_handle(handle);
+            if (!connection) return 0;
+
+            l2cap_ecbm_handle_connection_request(connection, sig_id, command, len);
+            break;
+
+        case CREDIT_BASED_CONNECTION_RESPONSE:
+            // check size: mtu, mps, initial credits, result
+            if (len < 8u) return 0u;
+            l2cap_ecbm_handle_connection_response(handle, sig_id,
+                                                  little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 6),
+                                                  little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 0),
+                                                  little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 2),
+                                                  little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 4),
+                                                  (len - 8u) / 2u, &command[L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 8]);
+            break;
+
+        case CREDIT_BASED_RECONFIGURE_REQUEST:
+            // check size: mtu, mps, at least one destination cid
+            if (len < 6u) return 0u;
+            result = l2cap_ecbm_handle_reconfigure_request(handle, command, len);
+            l2cap_register_signaling_response(handle, CREDIT_BASED_RECONFIGURE_REQUEST, sig_id, 0, result);
+            break;
+
+        case CREDIT_BASED_RECONFIGURE_RESPONSE:
+            // check size
+            if (len < 2u) return 0u;
+            l2cap_ecbm_handle_reconfigure_response(handle, sig_id, little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET));
+            break;
+#endif
+
 #endif
 
         case DISCONNECTION_RESPONSE:
@@ -3399,13 +4217,14 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
     if (l2cap_channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION){
 
         int fcs_size = l2cap_channel->fcs_option ? 2 : 0;
+        uint16_t control_size = l2cap_ertm_control_field_size(l2cap_channel);
 
         // assert control + FCS fields are inside
-        if (size < COMPLETE_L2CAP_HEADER+2+fcs_size) return;
+        if (size < COMPLETE_L2CAP_HEADER+control_size+fcs_size) return;
 
         if (l2cap_channel->fcs_option){
             // verify FCS (required if one side requested it)
-            uint16_t fcs_calculated = crc16_calc(&packet[4], size - (4+2));
+            uint16_t fcs_calculated = btstack_crc16_calc(&packet[4], size - (4+2));
             uint16_t fcs_packet     = little_endian_read_16(packet, size-2);
 
 #ifdef L2CAP_ERTM_SIMULATE_FCS_ERROR_INTERVAL
@@ -3428,14 +4247,34 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
         }
 
         // switch on packet type
-        uint16_t control = little_endian_read_16(packet, COMPLETE_L2CAP_HEADER);
-        uint8_t  req_seq = (control >> 8) & 0x3f;
-        int final = (control >> 7) & 0x01;
+        uint32_t control;
+        uint16_t req_seq;
+        int final;
+        int poll;
+        l2cap_supervisory_function_t s;
+        l2cap_segmentation_and_reassembly_t sar;
+        uint16_t tx_seq;
+        if (l2cap_channel->extended_control){
+            control = little_endian_read_32(packet, COMPLETE_L2CAP_HEADER);
+            req_seq = (control >> 2) & 0x3fff;
+            final   = (control >> 1) & 0x01;
+            poll    = (control >> 18) & 0x01;
+            s       = (l2cap_supervisory_function_t) ((control >> 16) & 0x03);
+            sar     = (l2cap_segmentation_and_reassembly_t) ((control >> 16) & 0x03);
+            tx_seq  = (control >> 18) & 0x3fff;
+        } else {
+            control = little_endian_read_16(packet, COMPLETE_L2CAP_HEADER);
+            req_seq = (control >> 8) & 0x3f;
+            final   = (control >> 7) & 0x01;
+            poll    = (control >> 4) & 0x01;
+            s       = (l2cap_supervisory_function_t) ((control >> 2) & 0x03);
+            sar     = (l2cap_segmentation_and_reassembly_t) ((control >> 14) & 0x03);
+            tx_seq  = (control >> 1) & 0x3f;
+        }
+        uint16_t mask = l2cap_ertm_seq_nr_mask(l2cap_channel);
         if (control & 1){
             // S-Frame
-            int poll  = (control >> 4) & 0x01;
-            l2cap_supervisory_function_t s = (l2cap_supervisory_function_t) ((control >> 2) & 0x03);
-            log_info("Control: 0x%04x => Supervisory function %u, ReqSeq %02u", control, (int) s, req_seq);
+            log_info("Control: 0x%04x => Supervisory function %u, ReqSeq %02u", (unsigned int) control, (int) s, req_seq);
             l2cap_ertm_tx_packet_state_t * tx_state;
             switch (s){
                 case L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY:
@@ -3448,18 +4287,9 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
                     }
                     if (poll){
                         // check if we did request selective retransmission before <==> we have stored SDU segments
-                        int i;
-                        int num_stored_out_of_order_packets = 0;
-                        for (i=0;i<l2cap_channel->num_rx_buffers;i++){
-                            int index = l2cap_channel->rx_store_index + i;
-                            if (index >= l2cap_channel->num_rx_buffers){
-                                index -= l2cap_channel->num_rx_buffers;
-                            }
-                            l2cap_ertm_rx_packet_state_t * rx_state = &l2cap_channel->rx_packets_state[index];
-                            if (!rx_state->valid) continue;
-                            num_stored_out_of_order_packets++;
-                        }
-                        if (num_stored_out_of_order_packets){
+                        if (l2cap_channel->srej_end_tx_seq != l2cap_channel->expected_tx_seq){
+                            // request all missing frames again, first SREJ with final bit set
+                            l2cap_channel->srej_next_tx_seq = l2cap_channel->expected_tx_seq;
                             l2cap_channel->send_supervisor_frame_selective_reject = 1;
                         } else {
                             l2cap_channel->send_supervisor_frame_receiver_ready   = 1;
@@ -3475,6 +4305,7 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
                         }
                         // final bit set <- response to RR with poll bit set. All not acknowledged packets need to be retransmitted
                         l2cap_ertm_retransmit_unacknowleded_frames(l2cap_channel);
+                        l2cap_channel->wait_final = 0;
                     }
                     break;
                 case L2CAP_SUPERVISORY_FUNCTION_REJ_REJECT:
@@ -3482,6 +4313,10 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
                     l2cap_ertm_process_req_seq(l2cap_channel, req_seq);
                     // restart transmittion from last unacknowledted packet (earlier packets already freed in l2cap_ertm_process_req_seq)
                     l2cap_ertm_retransmit_unacknowleded_frames(l2cap_channel);
+                    if (final){
+                        l2cap_ertm_stop_monitor_timer(l2cap_channel);
+                        l2cap_channel->wait_final = 0;
+                    }
                     break;
                 case L2CAP_SUPERVISORY_FUNCTION_RNR_RECEIVER_NOT_READY:
                     log_error("L2CAP_SUPERVISORY_FUNCTION_RNR_RECEIVER_NOT_READY");
@@ -3495,31 +4330,40 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
                     tx_state = l2cap_ertm_get_tx_state(l2cap_channel, req_seq);
                     if (tx_state){
                         log_info("Retransmission for tx_seq %u requested", req_seq);
-                        l2cap_channel->set_final_bit_after_packet_with_poll_bit_set = poll;
+                        if (poll){
+                            l2cap_channel->set_final_bit_after_packet_with_poll_bit_set = 1;
+                        }
                         tx_state->retransmission_requested = 1;
                         l2cap_channel->srej_active = 1;
                     }
+                    if (final){
+                        // response to RR with poll bit set, only requested frame is retransmitted
+                        l2cap_ertm_stop_monitor_timer(l2cap_channel);
+                        if (l2cap_channel->unacked_frames){
+                            l2cap_ertm_start_retransmission_timer(l2cap_channel);
+                        }
+                        l2cap_channel->wait_final = 0;
+                    }
                     break;
                 default:
                     break;
             }
         } else {
             // I-Frame
-            // get control
-            l2cap_segmentation_and_reassembly_t sar = (l2cap_segmentation_and_reassembly_t) (control >> 14);
-            uint8_t tx_seq = (control >> 1) & 0x3f;
-            log_info("Control: 0x%04x => SAR %u, ReqSeq %02u, R?, TxSeq %02u", control, (int) sar, req_seq, tx_seq);
-            log_info("SAR: pos %u", l2cap_channel->reassembly_pos);
-            log_info("State: expected_tx_seq %02u, req_seq %02u", l2cap_channel->expected_tx_seq, l2cap_channel->req_seq);
+            log_info("Control: 0x%04x => SAR %u, ReqSeq %02u, R?, TxSeq %02u", (unsigned int) control, (int) sar, req_seq, tx_seq);
+            log_debug("SAR: pos %u", l2cap_channel->reassembly_pos);
+            log_debug("State: expected_tx_seq %02u, req_seq %02u", l2cap_channel->expected_tx_seq, l2cap_channel->req_seq);
             l2cap_ertm_process_req_seq(l2cap_channel, req_seq);
             if (final){
                 // final bit set <- response to RR with poll bit set. All not acknowledged packets need to be retransmitted
                 l2cap_ertm_retransmit_unacknowleded_frames(l2cap_channel);
+                l2cap_ertm_stop_monitor_timer(l2cap_channel);
+                l2cap_channel->wait_final = 0;
             }
 
             // get SDU
-            const uint8_t * payload_data = &packet[COMPLETE_L2CAP_HEADER+2];
-            uint16_t        payload_len  = size-(COMPLETE_L2CAP_HEADER+2+fcs_size);
+            const uint8_t * payload_data = &packet[COMPLETE_L2CAP_HEADER+control_size];
+            uint16_t        payload_len  = size-(COMPLETE_L2CAP_HEADER+control_size+fcs_size);
 
             // assert SDU size is smaller or equal to our buffers
             uint16_t max_payload_size = 0;
@@ -3545,50 +4389,44 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
             // check ordering
             if (l2cap_channel->expected_tx_seq == tx_seq){
                 log_info("Received expected frame with TxSeq == ExpectedTxSeq == %02u", tx_seq);
-                l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel->expected_tx_seq);
-                l2cap_channel->req_seq         = l2cap_channel->expected_tx_seq;
+                l2cap_ertm_next_expected_tx_seq(l2cap_channel);
 
                 // process SDU
                 l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, sar, payload_data, payload_len);
 
                 // process stored segments
                 while (true){
-                    int index = l2cap_channel->rx_store_index;
+                    uint16_t index = l2cap_channel->rx_store_index;
                     l2cap_ertm_rx_packet_state_t * rx_state = &l2cap_channel->rx_packets_state[index];
                     if (!rx_state->valid) break;
 
                     log_info("Processing stored frame with TxSeq == ExpectedTxSeq == %02u", l2cap_channel->expected_tx_seq);
-                    l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel->expected_tx_seq);
-                    l2cap_channel->req_seq         = l2cap_channel->expected_tx_seq;
+                    l2cap_ertm_next_expected_tx_seq(l2cap_channel);
 
                     rx_state->valid = 0;
-                    l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, rx_state->sar, &l2cap_channel->rx_packets_data[index], rx_state->len);
-
-                    // update rx store index
-                    index++;
-                    if (index >= l2cap_channel->num_rx_buffers){
-                        index = 0;
-                    }
-                    l2cap_channel->rx_store_index = index;
+                    l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, rx_state->sar, l2cap_ertm_rx_packet_data(l2cap_channel, index), rx_state->len);
                 }
 
                 //
                 l2cap_channel->send_supervisor_frame_receiver_ready = 1;
 
             } else {
-                int delta = (tx_seq - l2cap_channel->expected_tx_seq) & 0x3f;
-                if (delta < 2){
-                    // store segment
-                    l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel, sar, delta, payload_data, payload_len);
-
+                uint16_t delta = (tx_seq - l2cap_channel->expected_tx_seq) & mask;
+                if (delta < l2cap_ertm_rx_window(l2cap_channel)){
+                    // store segment and request missing frames
                     log_info("Received unexpected frame TxSeq %u but expected %u -> send S-SREJ", tx_seq, l2cap_channel->expected_tx_seq);
-                    l2cap_channel->send_supervisor_frame_selective_reject = 1;
+                    l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel, sar, delta, payload_data, payload_len);
+                } else if (((l2cap_channel->expected_tx_seq - tx_seq) & mask) <= l2cap_ertm_rx_window(l2cap_channel)){
+                    // already received, e.g. retransmission after acknowledgement got lost
+                    log_info("Received duplicate frame TxSeq %u, expected %u -> ignore", tx_seq, l2cap_channel->expected_tx_seq);
                 } else {
                     log_info("Received unexpected frame TxSeq %u but expected %u -> send S-REJ", tx_seq, l2cap_channel->expected_tx_seq);
                     l2cap_channel->send_supervisor_frame_reject = 1;
                 }
             }
         }
+        // acknowledgements, REJ and frames with final bit may allow to (re)send I-Frames
+        l2cap_notify_channel_can_send();
         return;
     }
 #endif
@@ -3701,10 +4539,8 @@ static void l2cap_acl_le_handler(hci_con_handle_t handle, uint8_t *packet, uint1
                 }
                 l2cap_channel->credits_incoming--;
 
-                // automatic credits
-                if ((l2cap_channel->credits_incoming < L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_WATERMARK) && l2cap_channel->automatic_credits){
-                    l2cap_channel->new_credits_incoming = L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INCREMENT;
-                }
+                // track rate, round trip time and starvation, grant automatic credits
+                l2cap_le_credits_k_frame_received(l2cap_channel);
 
                 // first fragment
                 uint16_t pos = 0;
@@ -3773,6 +4609,7 @@ void l2cap_finialize_channel_close(l2cap_channel_t * channel){
     channel->state = L2CAP_STATE_CLOSED;
     l2cap_handle_channel_closed(channel);
     // discard channel
+    l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
     btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
     l2cap_free_channel_entry(channel);
 }
@@ -3912,7 +4749,8 @@ static void l2cap_emit_le_channel_closed(l2cap_channel_t * channel){
     l2cap_dispatch_to_channel(channel, HCI_EVENT_PACKET, event, sizeof(event));
 }
 
-static void l2cap_le_send_pdu(l2cap_channel_t *channel){
+// @returns true if SDU was sent and L2CAP_EVENT_LE_PACKET_SENT was emitted, channel might be gone
+static bool l2cap_le_send_pdu(l2cap_channel_t *channel){
     btstack_assert(channel != NULL);
     btstack_assert(channel->send_sdu_buffer != NULL);
     btstack_assert(channel->credits_outgoing > 0);
@@ -3928,8 +4766,10 @@ static void l2cap_le_send_pdu(l2cap_channel_t *channel){
         little_endian_store_16(l2cap_payload, pos, channel->send_sdu_len);
         pos += 2u;
     }
-    uint16_t payload_size = btstack_min(channel->send_sdu_len + 2u - channel->send_sdu_pos, channel->remote_mps - pos);
-    log_info("len %u, pos %u => payload %u, credits %u", channel->send_sdu_len, channel->send_sdu_pos, payload_size, channel->credits_outgoing);
+    // K-Frame size is limited by remote MPS and our outgoing buffer
+    uint16_t mps = btstack_min(channel->remote_mps, l2cap_max_le_mtu());
+    uint16_t payload_size = btstack_min(channel->send_sdu_len + 2u - channel->send_sdu_pos, mps - pos);
+    log_debug("len %u, pos %u => payload %u, credits %u", channel->send_sdu_len, channel->send_sdu_pos, payload_size, channel->credits_outgoing);
     (void)memcpy(&l2cap_payload[pos],
                  &channel->send_sdu_buffer[channel->send_sdu_pos - 2u],
                  payload_size); // -2 for virtual SDU len
@@ -3941,13 +4781,14 @@ static void l2cap_le_send_pdu(l2cap_channel_t *channel){
 
     hci_send_acl_packet_buffer(8u + pos);
 
-    if (channel->send_sdu_pos >= (channel->send_sdu_len + 2u)){
-        channel->send_sdu_buffer = NULL;
-        // send done event
-        l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_LE_PACKET_SENT);
-        // inform about can send now
-        l2cap_le_notify_channel_can_send(channel);
-    }
+    if (channel->send_sdu_pos < (channel->send_sdu_len + 2u)) return false;
+
+    channel->send_sdu_buffer = NULL;
+    // send done event
+    l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_LE_PACKET_SENT);
+    // inform about can send now
+    l2cap_le_notify_channel_can_send(channel);
+    return true;
 }
 
 // finalize closed channel - l2cap_handle_disconnect_request & DISCONNECTION_RESPONSE
@@ -3955,6 +4796,7 @@ void l2cap_le_finialize_channel_close(l2cap_channel_t * channel){
     channel->state = L2CAP_STATE_CLOSED;
     l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_CHANNEL_CLOSED);
     // discard channel
+    l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
     btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
     l2cap_free_channel_entry(channel);
 }
@@ -4012,13 +4854,18 @@ uint8_t l2cap_le_accept_connection(uint16_t local_cid, uint8_t * receive_sdu_buf
     if (channel->state != L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT){
         return ERROR_CODE_COMMAND_DISALLOWED;
     }
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+    // ECBM channels are accepted with l2cap_ecbm_accept_channels
+    if (channel->ecbm){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+#endif
 
     // set state accept connection
     channel->state = L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_ACCEPT;
     channel->receive_sdu_buffer = receive_sdu_buffer;
     channel->local_mtu = mtu;
-    channel->new_credits_incoming = initial_credits;
-    channel->automatic_credits  = initial_credits == L2CAP_LE_AUTOMATIC_CREDITS;
+    l2cap_le_credits_init(channel, initial_credits);
 
     // test
     // channel->new_credits_incoming = 1;
@@ -4042,6 +4889,12 @@ uint8_t l2cap_le_decline_connection(uint16_t local_cid){
     if (channel->state != L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT){
         return ERROR_CODE_COMMAND_DISALLOWED;
     }
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+    // ECBM channels are declined with l2cap_ecbm_decline_channels
+    if (channel->ecbm){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+#endif
 
     // set state decline connection
     channel->state  = L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_DECLINE;
@@ -4081,23 +4934,40 @@ static void l2cap_sm_packet_handler(uint8_t packet_type, uint16_t channel_nr, ui
             // pairing failed or wasn't good enough, inform user
             l2cap_emit_le_channel_opened(channel, ERROR_CODE_INSUFFICIENT_SECURITY);
             // discard channel
+            l2cap_channel_index_remove((l2cap_fixed_channel_t *) channel);
             btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
             l2cap_free_channel_entry(channel);
         } else {
             // send conn request now
             channel->state = L2CAP_STATE_WILL_SEND_LE_CONNECTION_REQUEST;
-            l2cap_run();
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+            if (channel->ecbm){
+                channel->state = L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_REQUEST;
+            }
+#endif
         }
     }
+    // after all channels have been updated, as ECBM channels are sent in a single request
+    l2cap_run();
+}
+
+// request pairing for outgoing channels, SM events are registered on first use
+static void l2cap_le_request_pairing(hci_con_handle_t con_handle){
+    static btstack_packet_callback_registration_t sm_event_callback_registration;
+    static bool sm_callback_registered = false;
+    if (!sm_callback_registered){
+        sm_callback_registered = true;
+        // lazy registration for SM events
+        sm_event_callback_registration.callback = &l2cap_sm_packet_handler;
+        sm_add_event_handler(&sm_event_callback_registration);
+    }
+    sm_request_pairing(con_handle);
 }
 
 uint8_t l2cap_le_create_channel(btstack_packet_handler_t packet_handler, hci_con_handle_t con_handle,
     uint16_t psm, uint8_t * receive_sdu_buffer, uint16_t mtu, uint16_t initial_credits, gap_security_level_t security_level,
     uint16_t * out_local_cid) {
 
-    static btstack_packet_callback_registration_t sm_event_callback_registration;
-    static bool sm_callback_registered = false;
-
     log_info("L2CAP_LE_CREATE_CHANNEL handle 0x%04x psm 0x%x mtu %u", con_handle, psm, mtu);
 
     hci_connection_t * connection = hci_connection_for_handle(con_handle);
@@ -4120,24 +4990,17 @@ uint8_t l2cap_le_create_channel(btstack_packet_handler_t packet_handler, hci_con
     // setup channel entry
     channel->con_handle = con_handle;
     channel->receive_sdu_buffer = receive_sdu_buffer;
-    channel->new_credits_incoming = initial_credits;
-    channel->automatic_credits    = initial_credits == L2CAP_LE_AUTOMATIC_CREDITS;
+    l2cap_le_credits_init(channel, initial_credits);
 
     // add to connections list
     btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+    l2cap_channel_index_add((l2cap_fixed_channel_t *) channel);
 
     // check security level
     if (l2cap_le_security_level_for_connection(con_handle) < channel->required_security_level){
-        if (!sm_callback_registered){
-            sm_callback_registered = true;
-            // lazy registration for SM events
-            sm_event_callback_registration.callback = &l2cap_sm_packet_handler;
-            sm_add_event_handler(&sm_event_callback_registration);
-        }
-
         // start pairing
         channel->state = L2CAP_STATE_WAIT_OUTGOING_SECURITY_LEVEL_UPDATE;
-        sm_request_pairing(con_handle);
+        l2cap_le_request_pairing(con_handle);
     } else {
         // send conn request right away
         channel->state = L2CAP_STATE_WILL_SEND_LE_CONNECTION_REQUEST;
@@ -4182,6 +5045,39 @@ uint8_t l2cap_le_provide_credits(uint16_t local_cid, uint16_t credits){
     return ERROR_CODE_SUCCESS;
 }
 
+uint8_t l2cap_le_set_credit_budget(uint16_t local_cid, uint32_t budget){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        log_error("l2cap_le_set_credit_budget no channel for cid 0x%02x", local_cid);
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+    if (channel->channel_type != L2CAP_CHANNEL_TYPE_LE_DATA_CHANNEL){
+        log_error("l2cap_le_set_credit_budget cid 0x%02x is not an LE Data Channel", local_cid);
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+    l2cap_le_credits_set_budget(channel, budget);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_le_get_credit_statistics(uint16_t local_cid, l2cap_le_credit_statistics_t * statistics){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if ((channel == NULL) || (channel->channel_type != L2CAP_CHANNEL_TYPE_LE_DATA_CHANNEL)) {
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+    const l2cap_le_credit_controller_t * controller = &channel->credit_controller;
+    statistics->starvation_count = controller->starvation_count;
+    statistics->starvation_ms    = controller->starvation_ms;
+    if (controller->starved != 0u){
+        statistics->starvation_ms += btstack_run_loop_get_time_ms() - controller->starved_since_ms;
+    }
+    statistics->credits_incoming = channel->credits_incoming;
+    statistics->credits_target   = controller->target;
+    statistics->credits_budget   = controller->budget;
+    statistics->rate             = controller->rate;
+    statistics->rtt_ms           = controller->rtt_ms;
+    return ERROR_CODE_SUCCESS;
+}
+
 /**
  * @brief Check if outgoing buffer is available and that there's space on the Bluetooth module
  * @param local_cid             L2CAP LE Data Channel Identifier
@@ -4270,4 +5166,186 @@ uint8_t l2cap_le_disconnect(uint16_t local_cid)
     return ERROR_CODE_SUCCESS;
 }
 
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+
+uint8_t l2cap_ecbm_create_channels(btstack_packet_handler_t packet_handler, hci_con_handle_t con_handle,
+    gap_security_level_t security_level, uint16_t psm, uint8_t num_channels, uint16_t initial_credits,
+    uint16_t receive_buffer_size, uint8_t ** receive_buffers, uint16_t * out_local_cids){
+
+    log_info("L2CAP_ECBM_CREATE_CHANNELS handle 0x%04x psm 0x%x num_channels %u mtu %u", con_handle, psm, num_channels, receive_buffer_size);
+
+    if ((num_channels == 0u) || (num_channels > L2CAP_ECBM_MAX_CHANNELS) || (receive_buffer_size < L2CAP_ECBM_MIN_MTU)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    // MPS has to be at least 64
+    if (l2cap_max_le_mtu() < L2CAP_ECBM_MIN_MTU){
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    }
+
+    hci_connection_t * connection = hci_connection_for_handle(con_handle);
+    if (!connection) {
+        log_error("no hci_connection for handle 0x%04x", con_handle);
+        return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    }
+
+    // allocate all channels before sending the request
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        channels[i] = l2cap_create_channel_entry(packet_handler, L2CAP_CHANNEL_TYPE_LE_DATA_CHANNEL, connection->address,
+                                                 connection->address_type, psm, receive_buffer_size, security_level);
+        if (channels[i] == NULL){
+            while (i > 0u){
+                i--;
+                l2cap_free_channel_entry(channels[i]);
+            }
+            return BTSTACK_MEMORY_ALLOC_FAILED;
+        }
+    }
+
+    // channels of a request share the signaling identifier
+    uint8_t sig_id = l2cap_next_sig_id();
+    bool pairing_required = l2cap_le_security_level_for_connection(con_handle) < security_level;
+    for (i=0;i<num_channels;i++){
+        l2cap_channel_t * channel = channels[i];
+        channel->ecbm = 1;
+        channel->con_handle = con_handle;
+        channel->local_sig_id = sig_id;
+        channel->receive_sdu_buffer = receive_buffers[i];
+        l2cap_le_credits_init(channel, initial_credits);
+        channel->state = pairing_required ? L2CAP_STATE_WAIT_OUTGOING_SECURITY_LEVEL_UPDATE : L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_REQUEST;
+
+        // add to connections list
+        btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+        l2cap_channel_index_add((l2cap_fixed_channel_t *) channel);
+
+        // store local_cid
+        if (out_local_cids != NULL){
+            out_local_cids[i] = channel->local_cid;
+        }
+    }
+
+    if (pairing_required){
+        l2cap_le_request_pairing(con_handle);
+    } else {
+        l2cap_run();
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+static uint8_t l2cap_ecbm_get_channels_for_incoming_request(uint16_t local_cid, l2cap_channel_t ** channels, uint8_t * num_channels){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+
+    // validate state
+    if ((channel->ecbm == 0u) || (channel->state != L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT)){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+
+    *num_channels = l2cap_ecbm_get_channels_for_request(channel->con_handle, L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT,
+                                                        L2CAP_CHANNEL_STATE_VAR_NONE, channel->remote_sig_id, true, channels);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_ecbm_accept_channels(uint16_t local_cid, uint8_t num_channels, uint16_t initial_credits,
+    uint16_t receive_buffer_size, uint8_t ** receive_buffers, uint16_t * out_local_cids){
+
+    if (receive_buffer_size < L2CAP_ECBM_MIN_MTU){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    // MPS has to be at least 64
+    if (l2cap_max_le_mtu() < L2CAP_ECBM_MIN_MTU){
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    }
+
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_requested = 0;
+    uint8_t status = l2cap_ecbm_get_channels_for_incoming_request(local_cid, channels, &num_requested);
+    if (status != ERROR_CODE_SUCCESS) return status;
+
+    uint8_t i;
+    for (i=0;i<num_requested;i++){
+        l2cap_channel_t * channel = channels[i];
+        channel->state = L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_RESPONSE;
+        if (i >= num_channels){
+            // 0x0004 Some connections refused – insufficient resources available
+            channel->reason = 0x04;
+            continue;
+        }
+        channel->receive_sdu_buffer = receive_buffers[i];
+        channel->local_mtu = receive_buffer_size;
+        l2cap_le_credits_init(channel, initial_credits);
+        if (out_local_cids != NULL){
+            out_local_cids[i] = channel->local_cid;
+        }
+    }
+
+    // go
+    l2cap_run();
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_ecbm_decline_channels(uint16_t local_cid, uint16_t result){
+    // all refused result codes fit into reason
+    if ((result == 0u) || (result > 0xffu)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t num_requested = 0;
+    uint8_t status = l2cap_ecbm_get_channels_for_incoming_request(local_cid, channels, &num_requested);
+    if (status != ERROR_CODE_SUCCESS) return status;
+
+    uint8_t i;
+    for (i=0;i<num_requested;i++){
+        channels[i]->state  = L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_RESPONSE;
+        channels[i]->reason = (uint8_t) result;
+    }
+    l2cap_run();
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_ecbm_reconfigure_channels(uint8_t num_cids, uint16_t * local_cids, uint16_t receive_buffer_size, uint8_t ** receive_buffers){
+    if ((num_cids == 0u) || (num_cids > L2CAP_ECBM_MAX_CHANNELS)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    // MPS has to be at least 64
+    if (l2cap_max_le_mtu() < L2CAP_ECBM_MIN_MTU){
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    }
+
+    l2cap_channel_t * channels[L2CAP_ECBM_MAX_CHANNELS];
+    uint8_t i;
+    for (i=0;i<num_cids;i++){
+        l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cids[i]);
+        if (!channel) return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+        if ((channel->ecbm == 0u) || (channel->state != L2CAP_STATE_OPEN)){
+            return ERROR_CODE_COMMAND_DISALLOWED;
+        }
+        // only one reconfiguration at a time
+        if ((channel->state_var & (L2CAP_CHANNEL_STATE_VAR_SEND_RECONFIGURE_REQ | L2CAP_CHANNEL_STATE_VAR_WAIT_RECONFIGURE_RSP)) != 0u){
+            return ERROR_CODE_COMMAND_DISALLOWED;
+        }
+        channels[i] = channel;
+        // all channels on same connection, MTU must not be reduced
+        if ((channel->con_handle != channels[0]->con_handle) || (receive_buffer_size < channel->local_mtu)){
+            return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+        }
+    }
+
+    uint8_t sig_id = l2cap_next_sig_id();
+    for (i=0;i<num_cids;i++){
+        channels[i]->local_sig_id = sig_id;
+        channels[i]->reconfigure_mtu = receive_buffer_size;
+        channels[i]->reconfigure_sdu_buffer = receive_buffers[i];
+        channelStateVarSetFlag(channels[i], L2CAP_CHANNEL_STATE_VAR_SEND_RECONFIGURE_REQ);
+    }
+    l2cap_run();
+    return ERROR_CODE_SUCCESS;
+}
+#endif
+
 #endif
@@ -69,6 +69,14 @@ extern "C" {
 
 #define L2CAP_LE_AUTOMATIC_CREDITS 0xffff
 
+// number of recent credit grants tracked per LE Data Channel: credits are granted about every half round trip
+// and used up to two round trips later
+#define L2CAP_LE_CREDIT_GRANTS_NUM 8
+
+// Enhanced Credit Based Flow Control Mode: max number of channels per Credit Based Connection Request and minimal MTU/MPS
+#define L2CAP_ECBM_MAX_CHANNELS 5
+#define L2CAP_ECBM_MIN_MTU      64
+
 // private structs
 typedef enum {
     L2CAP_STATE_CLOSED = 1,           // no baseband
@@ -94,6 +102,9 @@ typedef enum {
     L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_DECLINE,
     L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_ACCEPT,
     L2CAP_STATE_WAIT_LE_CONNECTION_RESPONSE,
+    L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_REQUEST,      // only for Enhanced Credit Based Flow Control Mode
+    L2CAP_STATE_WILL_SEND_ENHANCED_CONNECTION_RESPONSE,     // only for Enhanced Credit Based Flow Control Mode
+    L2CAP_STATE_WAIT_ENHANCED_CONNECTION_RESPONSE,          // only for Enhanced Credit Based Flow Control Mode
     L2CAP_STATE_EMIT_OPEN_FAILED_AND_DISCARD,
     L2CAP_STATE_INVALID,
 } L2CAP_STATE;
@@ -114,7 +125,9 @@ typedef enum {
     L2CAP_CHANNEL_STATE_VAR_BASIC_FALLBACK_TRIED   = 1 << 11,  // set when ERTM was requested but we want only Basic mode (ERM)
     L2CAP_CHANNEL_STATE_VAR_SEND_CMD_REJ_UNKNOWN   = 1 << 12,  // send CMD_REJ with reason unknown
     L2CAP_CHANNEL_STATE_VAR_SEND_CONN_RESP_PEND    = 1 << 13,  // send Connection Respond with pending
+    L2CAP_CHANNEL_STATE_VAR_SEND_RECONFIGURE_REQ   = 1 << 14,  // send Credit Based Reconfigure Request (ECBM)
     L2CAP_CHANNEL_STATE_VAR_INCOMING               = 1 << 15,  // channel is incoming
+    L2CAP_CHANNEL_STATE_VAR_WAIT_RECONFIGURE_RSP   = 1 << 16,  // wait for Credit Based Reconfigure Response (ECBM)
 } L2CAP_CHANNEL_STATE_VAR;
 
 typedef enum {
@@ -143,10 +156,19 @@ typedef struct {
 
 typedef struct {
     l2cap_segmentation_and_reassembly_t sar;
+    // fragment payload without SDU Length, either in tx_packets_data or in SDU provided by l2cap_ertm_send_data
+    const uint8_t * data;
+    // payload length incl. SDU Length for start fragment
     uint16_t len;
-    uint8_t tx_seq;
+    // SDU Length for start fragment
+    uint16_t sdu_length;
+    // FCS over payload
+    uint16_t fcs;
+    uint16_t tx_seq;
     uint8_t retry_count;
     uint8_t retransmission_requested;
+    // last fragment of SDU provided by l2cap_ertm_send_data -> emit L2CAP_EVENT_ERTM_PACKET_SENT on ack
+    uint8_t release_sdu;
 } l2cap_ertm_tx_packet_state_t;
 
 typedef struct {
@@ -166,10 +188,11 @@ typedef struct {
     uint16_t local_mtu;
 
     // Number of buffers for outgoing data
-    uint8_t num_tx_buffers;
+    uint16_t num_tx_buffers;
 
     // Number of packets that can be received out of order (-> our tx_window size)
-    uint8_t num_rx_buffers;
+    // Extended Window Size is used for more than 63 buffers if supported by remote, max 16383
+    uint16_t num_rx_buffers;
 
     // Frame Check Sequence (FCS) Option
     uint8_t fcs_option;
@@ -199,6 +222,52 @@ typedef struct l2cap_fixed_channel {
 
 } l2cap_fixed_channel_t;
 
+// LE Data Channels: credits granted to remote, credits are numbered by the K-Frame that uses them
+typedef struct {
+    uint32_t time_ms;
+    uint16_t first_credit;
+    uint16_t num_credits;
+} l2cap_le_credit_grant_t;
+
+// LE Data Channels: tracks rate and round trip time of incoming K-Frames to grant automatic credits in batches
+typedef struct {
+    // memory budget in bytes, and max number of credits the remote may have derived from it and the local MPS
+    uint32_t budget_bytes;
+    uint16_t budget;
+    // number of credits the remote should have
+    uint16_t target;
+    // smoothed rate in K-Frames per second and round trip time of credits in ms
+    uint16_t rate;
+    uint16_t rtt_ms;
+    // rate measurement
+    uint32_t interval_start_ms;
+    uint16_t interval_k_frames;
+    uint8_t  interval_starved;
+    // number of received K-Frames = number of next credit used by remote
+    uint16_t next_credit;
+    // recent grants to detect credits not yet received by remote
+    l2cap_le_credit_grant_t grants[L2CAP_LE_CREDIT_GRANTS_NUM];
+    uint8_t  grants_index;
+    // remote used last credit available to it
+    uint8_t  starved;
+    uint32_t starved_since_ms;
+    uint32_t starvation_count;
+    uint32_t starvation_ms;
+} l2cap_le_credit_controller_t;
+
+typedef struct {
+    // number of times the remote ran out of credits and total time without credits
+    uint32_t starvation_count;
+    uint32_t starvation_ms;
+    // credits the remote has, credits the remote should have, max credits within memory budget
+    uint16_t credits_incoming;
+    uint16_t credits_target;
+    uint16_t credits_budget;
+    // received K-Frames per second and round trip time of credits in ms, 0 if not measured yet
+    uint16_t rate;
+    uint16_t rtt_ms;
+} l2cap_le_credit_statistics_t;
+
 typedef struct {
     // linked list - assert: first field
     btstack_linked_item_t    item;
@@ -272,6 +341,20 @@ typedef struct {
     // automatic credits incoming
     uint16_t automatic_credits;
 
+#ifdef ENABLE_LE_DATA_CHANNELS
+    // credit controller for incoming traffic
+    l2cap_le_credit_controller_t credit_controller;
+#endif
+
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+    // channel was created by Credit Based Connection Request, channels of one request share con handle and sig id
+    uint8_t   ecbm;
+
+    // local MTU and receive buffer requested by l2cap_ecbm_reconfigure_channels, used after remote accepted it
+    uint16_t  reconfigure_mtu;
+    uint8_t * reconfigure_sdu_buffer;
+#endif
+
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
 
     // l2cap channel mode: basic or enhanced retransmission mode
@@ -293,7 +376,7 @@ typedef struct {
     uint16_t remote_retransmission_timeout_ms;
     uint16_t remote_monitor_timeout_ms;
 
-    uint8_t remote_tx_window_size;
+    uint16_t remote_tx_window_size;
 
     uint8_t local_max_transmit;
     uint8_t remote_max_transmit;
@@ -304,42 +387,54 @@ typedef struct {
     // Frame Chech Sequence (crc16) is present in both directions
     uint8_t fcs_option;
 
+    // Extended Control Field with 14-bit sequence numbers is used, if Extended Window Size option was sent or received
+    uint8_t extended_control;
+
     // sender: max num of stored outgoing frames
-    uint8_t num_tx_buffers;
+    uint16_t num_tx_buffers;
 
     // sender: num stored outgoing frames
-    uint8_t num_stored_tx_frames;
+    uint16_t num_stored_tx_frames;
 
     // sender: number of unacknowledeged I-Frames - frames have been sent, but not acknowledged yet
-    uint8_t unacked_frames;
+    uint16_t unacked_frames;
 
     // sender: buffer index of oldest packet
-    uint8_t tx_read_index;
+    uint16_t tx_read_index;
 
     // sender: buffer index to store next tx packet
-    uint8_t tx_write_index;
+    uint16_t tx_write_index;
 
     // sender: buffer index of packet to send next
-    uint8_t tx_send_index;
+    uint16_t tx_send_index;
 
     // sender: next seq nr used for sending
-    uint8_t next_tx_seq;
+    uint16_t next_tx_seq;
 
     // sender: selective retransmission requested
     uint8_t srej_active;
 
+    // sender: RR/RNR with poll bit was sent after retransmission timeout, don't send new I-Frames until final bit received
+    uint8_t wait_final;
+
 
     // receiver: max num out-of-order packets // tx_window
-    uint8_t num_rx_buffers;
+    uint16_t num_rx_buffers;
 
-    // receiver: buffer index of to store packet with delta = 1
-    uint8_t rx_store_index;
+    // receiver: buffer index of frame with tx_seq == expected_tx_seq
+    uint16_t rx_store_index;
+
+    // receiver: next missing frame to check for SREJ
+    uint16_t srej_next_tx_seq;
+
+    // receiver: tx_seq after highest stored out-of-order frame
+    uint16_t srej_end_tx_seq;
 
     // receiver: value of tx_seq in next expected i-frame
-    uint8_t expected_tx_seq;
+    uint16_t expected_tx_seq;
 
     // receiver: request transmission with tx_seq = req_seq and ack up to and including req_seq
-    uint8_t req_seq;
+    uint16_t req_seq;
 
     // receiver: local busy condition
     uint8_t local_busy;
@@ -377,7 +472,7 @@ typedef struct {
     // receiver: eassembly buffer
     uint8_t * reassembly_buffer;
 
-    // receiver: num_rx_buffers of size local_mps
+    // receiver: num_rx_buffers of size local_mps + 2 for SDU length
     uint8_t * rx_packets_data;
 
     // sender: num_tx_buffers of size local_mps
@@ -486,7 +581,8 @@ uint8_t l2cap_create_channel(btstack_packet_handler_t packet_handler, bd_addr_t
  * @param psm
  * @param ertm_config
  * @param buffer to store reassembled rx packet, out-of-order packets and unacknowledged outgoing packets with their tretransmission timers
- * @param size of buffer
+ * @param size of buffer: local_mtu + num_rx_buffers * (sizeof(l2cap_ertm_rx_packet_state_t) + local MPS + 2)
+ *        + num_tx_buffers * (sizeof(l2cap_ertm_tx_packet_state_t) + local MPS) + up to 16 bytes for alignment
  * @param local_cid
  * @return status
  */
@@ -528,7 +624,8 @@ void l2cap_accept_connection(uint16_t local_cid);
  * @param local_cid
  * @param ertm_config
  * @param buffer to store reassembled rx packet, out-of-order packets and unacknowledged outgoing packets with their tretransmission timers
- * @param size of buffer
+ * @param size of buffer: local_mtu + num_rx_buffers * (sizeof(l2cap_ertm_rx_packet_state_t) + local MPS + 2)
+ *        + num_tx_buffers * (sizeof(l2cap_ertm_tx_packet_state_t) + local MPS) + up to 16 bytes for alignment
  * @return status
  */
 uint8_t l2cap_accept_ertm_connection(uint16_t local_cid, l2cap_ertm_config_t * ertm_contig, uint8_t * buffer, uint32_t size);
@@ -636,6 +733,22 @@ uint8_t l2cap_le_create_channel(btstack_packet_handler_t packet_handler, hci_con
  */
 uint8_t l2cap_le_provide_credits(uint16_t cid, uint16_t credits);
 
+/**
+ * @brief Set memory budget for automatic credits of LE Data Channel
+ * @note With L2CAP_LE_AUTOMATIC_CREDITS, credits are granted in batches based on measured rate and round trip time.
+ *       The remote never gets more credits than needed to send budget bytes. Default: L2CAP_LE_DATA_CHANNELS_CREDIT_BUDGET
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @param budget                Max number of bytes the remote can send without new credits
+ */
+uint8_t l2cap_le_set_credit_budget(uint16_t local_cid, uint32_t budget);
+
+/**
+ * @brief Get credit statistics of LE Data Channel, incl. how often and how long the remote had no credits
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @param statistics
+ */
+uint8_t l2cap_le_get_credit_statistics(uint16_t local_cid, l2cap_le_credit_statistics_t * statistics);
+
 /**
  * @brief Check if packet can be scheduled for transmission
  * @param local_cid             L2CAP LE Data Channel Identifier
@@ -665,6 +778,63 @@ uint8_t l2cap_le_send_data(uint16_t cid, uint8_t * data, uint16_t size);
  */
 uint8_t l2cap_le_disconnect(uint16_t cid);
 
+
+//
+// Enhanced Credit Based Flow Control Mode (ECBM) for LE Data Channels
+//
+// Channels are set up in groups of up to L2CAP_ECBM_MAX_CHANNELS with a single request and use the same
+// data path as LE Data Channels: l2cap_le_send_data, l2cap_le_provide_credits, l2cap_le_disconnect, ...
+// Incoming requests for services registered with l2cap_le_register_service are reported as
+// L2CAP_EVENT_ECBM_INCOMING_CONNECTION, each channel then reports L2CAP_EVENT_LE_CHANNEL_OPENED.
+//
+
+/**
+ * @brief Create up to L2CAP_ECBM_MAX_CHANNELS LE Data Channels with a single Credit Based Connection Request
+ * @param packet_handler        Packet handler for these channels
+ * @param con_handle            ACL-LE HCI Connction Handle
+ * @param security_level        Minimum required security level
+ * @param psm                   Service PSM to connect to
+ * @param num_channels          Number of channels
+ * @param initial_credits       Number of initial credits provided to peer per channel or L2CAP_LE_AUTOMATIC_CREDITS to enable automatic credits
+ * @param receive_buffer_size   buffer size equals MTU, at least L2CAP_ECBM_MIN_MTU
+ * @param receive_buffers       Array of buffers used for reassembly of L2CAP Information Frames into service data unit (SDU), one per channel
+ * @param out_local_cids        Array of L2CAP Channel Identifiers is stored here, one per channel
+ */
+uint8_t l2cap_ecbm_create_channels(btstack_packet_handler_t packet_handler, hci_con_handle_t con_handle,
+    gap_security_level_t security_level, uint16_t psm, uint8_t num_channels, uint16_t initial_credits,
+    uint16_t receive_buffer_size, uint8_t ** receive_buffers, uint16_t * out_local_cids);
+
+/**
+ * @brief Accept channels of incoming Credit Based Connection Request reported by L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @note Remaining channels are refused if num_channels is smaller than the number of requested channels
+ * @param local_cid             L2CAP Channel Identifier of first channel from L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param num_channels          Number of channels to accept
+ * @param initial_credits       Number of initial credits provided to peer per channel or L2CAP_LE_AUTOMATIC_CREDITS to enable automatic credits
+ * @param receive_buffer_size   buffer size equals MTU, at least L2CAP_ECBM_MIN_MTU
+ * @param receive_buffers       Array of buffers used for reassembly of L2CAP Information Frames into service data unit (SDU), one per channel
+ * @param out_local_cids        Array of L2CAP Channel Identifiers is stored here, one per accepted channel
+ */
+uint8_t l2cap_ecbm_accept_channels(uint16_t local_cid, uint8_t num_channels, uint16_t initial_credits,
+    uint16_t receive_buffer_size, uint8_t ** receive_buffers, uint16_t * out_local_cids);
+
+/**
+ * @brief Decline all channels of incoming Credit Based Connection Request
+ * @param local_cid             L2CAP Channel Identifier of first channel from L2CAP_EVENT_ECBM_INCOMING_CONNECTION
+ * @param result                Result for L2CAP Credit Based Connection Response, e.g. 0x0004 for no resources available
+ */
+uint8_t l2cap_ecbm_decline_channels(uint16_t local_cid, uint16_t result);
+
+/**
+ * @brief Increase MTU of open ECBM channels with a single Credit Based Reconfigure Request
+ * @note New receive buffers are used after the remote accepted the request, which is reported by
+ *       L2CAP_EVENT_ECBM_RECONFIGURATION_COMPLETE. The old buffers need to stay valid until then.
+ * @param num_cids              Number of channels, up to L2CAP_ECBM_MAX_CHANNELS on the same connection
+ * @param local_cids            Array of L2CAP Channel Identifiers
+ * @param receive_buffer_size   new MTU, must not be smaller than the current MTU
+ * @param receive_buffers       Array of new receive buffers, one per channel
+ */
+uint8_t l2cap_ecbm_reconfigure_channels(uint8_t num_cids, uint16_t * local_cids, uint16_t receive_buffer_size, uint8_t ** receive_buffers);
+
 /**
  * @brief ERTM Set channel as busy.
  * @note Can be cleared by l2cap_ertm_set_ready
@@ -679,6 +849,17 @@ uint8_t l2cap_ertm_set_busy(uint16_t local_cid);
  */
 uint8_t l2cap_ertm_set_ready(uint16_t local_cid);
 
+/**
+ * @brief ERTM Send SDU without copying it into the channel's tx buffers
+ * @note data needs to stay valid until L2CAP_EVENT_ERTM_PACKET_SENT, which is emitted when the remote acknowledged
+ *       the last fragment. Events for multiple SDUs are emitted in the order the SDUs were sent.
+ * @param local_cid
+ * @param data
+ * @param size
+ * @return status
+ */
+uint8_t l2cap_ertm_send_data(uint16_t local_cid, const uint8_t * data, uint16_t size);
+
 /**
  * @brief De-Init L2CAP
  */
@@ -50,6 +50,7 @@
 #include "mesh/mesh_foundation.h"
 #include "mesh/mesh_iv_index_seq_number.h"
 #include "mesh/mesh_keys.h"
+#include "mesh/mesh_network_cache.h"
 #include "mesh/mesh_node.h"
 #include "mesh/provisioning.h"
 #include "mesh/provisioning_device.h"
@@ -62,9 +63,6 @@
 #include "mesh/gatt_bearer.h"
 #endif
 
-// configuration
-#define MESH_NETWORK_CACHE_SIZE 2
-
 // debug config
 #define LOG_NETWORK
 
@@ -135,10 +133,6 @@ static mesh_network_pdu_t * adv_bearer_network_pdu;
 #endif
 
 
-// mesh network cache - we use 32-bit 'hashes'
-static uint32_t mesh_network_cache[MESH_NETWORK_CACHE_SIZE];
-static int      mesh_network_cache_index;
-
 // register for freed network pdu
 void (*mesh_network_free_pdu_callback)(void);
 
@@ -147,35 +141,6 @@ void (*mesh_network_free_pdu_callback)(void);
 static void mesh_network_run(void);
 static void process_network_pdu_validate(void);
 
-// network caching
-static uint32_t mesh_network_cache_hash(mesh_network_pdu_t * network_pdu){
-    // - The SEQ field is a 24-bit integer that when combined with the IV Index, 
-    // shall be a unique value for each new Network PDU originated by this node (=> SRC)
-    // - IV updates only rarely
-    // => 16 bit SRC, 1 bit IVI, 15 bit SEQ
-    uint8_t  ivi = network_pdu->data[0] >> 7;
-    uint16_t seq = big_endian_read_16(network_pdu->data, 3);
-    uint16_t src = big_endian_read_16(network_pdu->data, 5);
-    return (src << 16) | (ivi << 15) | (seq & 0x7fff);
-}
-
-static int mesh_network_cache_find(uint32_t hash){
-    int i;
-    for (i = 0; i < MESH_NETWORK_CACHE_SIZE; i++) {
-        if (mesh_network_cache[i] == hash) {
-            return 1;
-        }
-    }
-    return 0;
-}
-
-static void mesh_network_cache_add(uint32_t hash){
-    mesh_network_cache[mesh_network_cache_index++] = hash;
-    if (mesh_network_cache_index >= MESH_NETWORK_CACHE_SIZE){
-        mesh_network_cache_index = 0;
-    }
-}
-
 // common helper
 int mesh_network_address_unicast(uint16_t addr){
     return addr != MESH_ADDRESS_UNSASSIGNED && (addr < 0x8000);
@@ -559,11 +524,12 @@ static void process_network_pdu_validate_d(void * arg){
         }
 
         // check cache
-        uint32_t hash = mesh_network_cache_hash(incoming_pdu_decoded);
+        uint8_t  ivi = incoming_pdu_decoded->data[0] >> 7;
+        uint32_t seq = big_endian_read_24(incoming_pdu_decoded->data, 2);
 #ifdef LOG_NETWORK
-        printf("RX-Hash (%p): %08x\n", incoming_pdu_decoded, hash);
+        printf("RX-Cache (%p): src %04x, ivi %u, seq %06x\n", incoming_pdu_decoded, src, ivi, (unsigned int) seq);
 #endif
-        if (mesh_network_cache_find(hash)){
+        if (mesh_network_cache_contains(src, ivi, seq)){
             // found in cache, drop
 #ifdef LOG_NETWORK
             printf("Found in cache -> drop packet (%p)\n", incoming_pdu_decoded);
@@ -575,7 +541,7 @@ static void process_network_pdu_validate_d(void * arg){
         }
 
         // store in network cache
-        mesh_network_cache_add(hash);
+        mesh_network_cache_add(src, ivi, seq);
 
 #ifdef LOG_NETWORK
             printf("RX-Validated (%p) - forward to lower transport\n", incoming_pdu_decoded);
@@ -1250,6 +1216,9 @@ void mesh_network_reset(void){
         mesh_network_pdu_free(incoming_pdu_decoded);
         incoming_pdu_decoded = NULL;
     }
+
+    mesh_network_cache_reset();
+
     mesh_crypto_active = 0;
 }
 
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "mesh_network_cache.c"
+
+#include "mesh/mesh_network_cache.h"
+
+#include <string.h>
+
+#include "btstack_config.h"
+#include "btstack_debug.h"
+
+// number of remembered Network PDUs
+#ifndef MESH_NETWORK_CACHE_SIZE
+#define MESH_NETWORK_CACHE_SIZE 2
+#endif
+
+#if MESH_NETWORK_CACHE_SIZE >= 0x8000
+#error "MESH_NETWORK_CACHE_SIZE must be smaller than 32768"
+#endif
+
+// load factor <= 0.5 keeps probe sequences short
+#define MESH_NETWORK_CACHE_NUM_BUCKETS (2 * MESH_NETWORK_CACHE_SIZE)
+
+// SRC + IVI + SEQ identify a Network PDU
+typedef struct {
+    uint32_t ivi_seq;
+    uint16_t src;
+} mesh_network_cache_entry_t;
+
+// entries in order of arrival
+static mesh_network_cache_entry_t mesh_network_cache_entries[MESH_NETWORK_CACHE_SIZE];
+static uint16_t mesh_network_cache_num_entries;
+static uint16_t mesh_network_cache_oldest;
+
+// bucket holds entry index + 1, 0 = empty
+static uint16_t mesh_network_cache_buckets[MESH_NETWORK_CACHE_NUM_BUCKETS];
+
+static uint16_t mesh_network_cache_home_bucket(uint16_t src, uint32_t ivi_seq){
+    uint32_t hash = (ivi_seq * 0x9E3779B1u) ^ (src * 0x85EBCA77u);
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    // map hash to [0..NUM_BUCKETS) without division
+    return (uint16_t) (((uint64_t) hash * MESH_NETWORK_CACHE_NUM_BUCKETS) >> 32);
+}
+
+static inline uint16_t mesh_network_cache_next_bucket(uint16_t bucket){
+    bucket++;
+    if (bucket == MESH_NETWORK_CACHE_NUM_BUCKETS){
+        bucket = 0;
+    }
+    return bucket;
+}
+
+static inline uint32_t mesh_network_cache_ivi_seq(uint8_t ivi, uint32_t seq){
+    return ((uint32_t) (ivi & 1) << 24) | (seq & 0x00ffffffu);
+}
+
+// returns bucket that holds the entry or the empty bucket ending the probe sequence
+static uint16_t mesh_network_cache_probe(uint16_t src, uint32_t ivi_seq){
+    uint16_t bucket = mesh_network_cache_home_bucket(src, ivi_seq);
+    while (true){
+        uint16_t slot = mesh_network_cache_buckets[bucket];
+        if (slot == 0){
+            return bucket;
+        }
+        const mesh_network_cache_entry_t * entry = &mesh_network_cache_entries[slot - 1];
+        if ((entry->ivi_seq == ivi_seq) && (entry->src == src)){
+            return bucket;
+        }
+        bucket = mesh_network_cache_next_bucket(bucket);
+    }
+}
+
+// backward shift deletion keeps linear probing sequences intact without tombstones
+static void mesh_network_cache_remove_bucket(uint16_t hole){
+    uint16_t bucket = hole;
+    while (true){
+        bucket = mesh_network_cache_next_bucket(bucket);
+        uint16_t slot = mesh_network_cache_buckets[bucket];
+        if (slot == 0){
+            break;
+        }
+        const mesh_network_cache_entry_t * entry = &mesh_network_cache_entries[slot - 1];
+        uint16_t home = mesh_network_cache_home_bucket(entry->src, entry->ivi_seq);
+        // entry can stay if its home lies cyclically within (hole, bucket]
+        bool stays;
+        if (hole <= bucket){
+            stays = (hole < home) && (home <= bucket);
+        } else {
+            stays = (hole < home) || (home <= bucket);
+        }
+        if (stays){
+            continue;
+        }
+        mesh_network_cache_buckets[hole] = slot;
+        hole = bucket;
+    }
+    mesh_network_cache_buckets[hole] = 0;
+}
+
+void mesh_network_cache_reset(void){
+    memset(mesh_network_cache_buckets, 0, sizeof(mesh_network_cache_buckets));
+    mesh_network_cache_num_entries = 0;
+    mesh_network_cache_oldest = 0;
+}
+
+bool mesh_network_cache_contains(uint16_t src, uint8_t ivi, uint32_t seq){
+    uint16_t bucket = mesh_network_cache_probe(src, mesh_network_cache_ivi_seq(ivi, seq));
+    return mesh_network_cache_buckets[bucket] != 0;
+}
+
+void mesh_network_cache_add(uint16_t src, uint8_t ivi, uint32_t seq){
+    uint16_t index;
+    if (mesh_network_cache_num_entries < MESH_NETWORK_CACHE_SIZE){
+        index = mesh_network_cache_num_entries++;
+    } else {
+        // evict oldest entry and reuse its slot
+        index = mesh_network_cache_oldest++;
+        if (mesh_network_cache_oldest == MESH_NETWORK_CACHE_SIZE){
+            mesh_network_cache_oldest = 0;
+        }
+        const mesh_network_cache_entry_t * oldest = &mesh_network_cache_entries[index];
+        uint16_t bucket = mesh_network_cache_probe(oldest->src, oldest->ivi_seq);
+        btstack_assert(mesh_network_cache_buckets[bucket] == (index + 1));
+        mesh_network_cache_remove_bucket(bucket);
+    }
+
+    uint32_t ivi_seq = mesh_network_cache_ivi_seq(ivi, seq);
+    mesh_network_cache_entries[index].src     = src;
+    mesh_network_cache_entries[index].ivi_seq = ivi_seq;
+
+    uint16_t bucket = mesh_network_cache_probe(src, ivi_seq);
+    btstack_assert(mesh_network_cache_buckets[bucket] == 0);
+    mesh_network_cache_buckets[bucket] = index + 1;
+}
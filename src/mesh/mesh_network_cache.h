@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#ifndef __MESH_NETWORK_CACHE_H
+#define __MESH_NETWORK_CACHE_H
+
+#include <stdint.h>
+
+#include "btstack_bool.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Network Message Cache
+ *
+ * Remembers the last MESH_NETWORK_CACHE_SIZE Network PDUs by SRC, IVI and 24-bit SEQ.
+ * Entries are kept in an open-addressed hash set, the oldest entry is evicted when full.
+ */
+
+/**
+ * @brief Remove all entries
+ */
+void mesh_network_cache_reset(void);
+
+/**
+ * @brief Check if Network PDU has been seen before
+ * @param src
+ * @param ivi least significant bit of IV Index
+ * @param seq 24-bit sequence number
+ * @return true if in cache
+ */
+bool mesh_network_cache_contains(uint16_t src, uint8_t ivi, uint32_t seq);
+
+/**
+ * @brief Add Network PDU to cache, evicts oldest entry if cache is full
+ * @note entry must not be in cache already
+ * @param src
+ * @param ivi least significant bit of IV Index
+ * @param seq 24-bit sequence number
+ */
+void mesh_network_cache_add(uint16_t src, uint8_t ivi, uint32_t seq);
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif // __MESH_NETWORK_CACHE_H
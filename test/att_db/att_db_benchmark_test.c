@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// Replays GATT discovery and reads on a large ATT DB to compare linear search with ENABLE_ATT_DB_INDEX and ENABLE_ATT_DB_DISCOVERY_CACHE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "ble/att_db.h"
+#include "ble/att_db_util.h"
+#include "btstack_util.h"
+#include "bluetooth_gatt.h"
+#include "btstack_crypto.h"
+#include "hci_dump.h"
+
+#define NUM_SERVICES                24
+#define NUM_CHARACTERISTICS          6
+#define NUM_ROUNDS                 200
+
+typedef struct {
+    uint16_t start_handle;
+    uint16_t end_handle;
+    uint16_t num_characteristics;
+    uint16_t num_descriptors;
+} service_t;
+
+static service_t services[NUM_SERVICES];
+static uint16_t  num_services_16;
+static uint16_t  num_services_128;
+
+static att_connection_t att_connection;
+static uint8_t  att_request[20];
+static uint8_t  att_response[512];
+static uint8_t  value[4] = { 1, 2, 3, 4 };
+static bool     read_values;
+
+static const uint8_t service_uuid128[] = { 0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00 };
+
+static void add_service(uint16_t index, bool with_uuid128){
+    if (with_uuid128){
+        uint8_t uuid128[16];
+        (void)memcpy(uuid128, service_uuid128, 16);
+        uuid128[0] = (uint8_t) index;
+        services[index].start_handle = att_db_util_add_service_uuid128(uuid128);
+        num_services_128++;
+    } else {
+        services[index].start_handle = att_db_util_add_service_uuid16(0x1800 + index);
+        num_services_16++;
+    }
+    uint16_t i;
+    for (i = 0; i < NUM_CHARACTERISTICS; i++){
+        uint16_t properties = ATT_PROPERTY_READ;
+        if ((i & 1u) == 0u){
+            properties |= ATT_PROPERTY_NOTIFY;
+            services[index].num_descriptors++;
+        }
+        att_db_util_add_characteristic_uuid16(0x2a00 + (index * NUM_CHARACTERISTICS) + i, properties, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+        if (i == 1u){
+            att_db_util_add_descriptor_uuid16(GATT_CHARACTERISTIC_USER_DESCRIPTION, ATT_PROPERTY_READ, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+            services[index].num_descriptors++;
+        }
+        services[index].num_characteristics++;
+    }
+    services[index].end_handle = services[index].start_handle + (2u * NUM_CHARACTERISTICS) + services[index].num_descriptors;
+}
+
+// att_db_util_hash_calc not used
+extern "C" void btstack_crypto_aes128_cmac_generator(btstack_crypto_aes128_cmac_t * request, const uint8_t * key, uint16_t size, uint8_t (*get_byte_callback)(uint16_t pos), uint8_t * hash, void (* callback)(void * arg), void * callback_arg){
+}
+
+static uint16_t handle_request(uint16_t request_len){
+    return att_handle_request(&att_connection, att_request, request_len, att_response);
+}
+
+static uint16_t read_by_group_type(uint16_t start_handle){
+    att_request[0] = ATT_READ_BY_GROUP_TYPE_REQUEST;
+    little_endian_store_16(att_request, 1, start_handle);
+    little_endian_store_16(att_request, 3, 0xffff);
+    little_endian_store_16(att_request, 5, GATT_PRIMARY_SERVICE_UUID);
+    return handle_request(7);
+}
+
+static uint16_t read_by_type(uint16_t start_handle, uint16_t end_handle, uint16_t uuid16){
+    att_request[0] = ATT_READ_BY_TYPE_REQUEST;
+    little_endian_store_16(att_request, 1, start_handle);
+    little_endian_store_16(att_request, 3, end_handle);
+    little_endian_store_16(att_request, 5, uuid16);
+    return handle_request(7);
+}
+
+static uint16_t find_information(uint16_t start_handle, uint16_t end_handle){
+    att_request[0] = ATT_FIND_INFORMATION_REQUEST;
+    little_endian_store_16(att_request, 1, start_handle);
+    little_endian_store_16(att_request, 3, end_handle);
+    return handle_request(5);
+}
+
+static uint16_t read_value(uint16_t handle){
+    att_request[0] = ATT_READ_REQUEST;
+    little_endian_store_16(att_request, 1, handle);
+    return handle_request(3);
+}
+
+// discover all services like gatt_client, returns number of services found
+static uint16_t discover_services(uint16_t * uuid16_services, uint16_t * uuid128_services){
+    uint16_t num_found = 0;
+    uint16_t start_handle = 1;
+    while (true){
+        uint16_t response_len = read_by_group_type(start_handle);
+        if (att_response[0] != ATT_READ_BY_GROUP_TYPE_RESPONSE) break;
+        uint16_t pair_len = att_response[1];
+        uint16_t pos;
+        uint16_t end_handle = 0;
+        for (pos = 2; (pos + pair_len) <= response_len; pos += pair_len){
+            uint16_t handle = little_endian_read_16(att_response, pos);
+            end_handle      = little_endian_read_16(att_response, pos + 2u);
+            CHECK(num_found < NUM_SERVICES);
+            CHECK_EQUAL(services[num_found].start_handle, handle);
+            CHECK_EQUAL(services[num_found].end_handle, end_handle);
+            if (pair_len == 6u){
+                (*uuid16_services)++;
+            } else {
+                (*uuid128_services)++;
+            }
+            num_found++;
+        }
+        if (end_handle == 0xffffu) break;
+        start_handle = end_handle + 1u;
+    }
+    return num_found;
+}
+
+// discover characteristics, their descriptors, and read all values of a service
+static void discover_service(const service_t * service){
+    uint16_t value_handles[NUM_CHARACTERISTICS];
+    uint16_t num_characteristics = 0;
+    uint16_t start_handle = service->start_handle;
+    while (start_handle <= service->end_handle){
+        uint16_t response_len = read_by_type(start_handle, service->end_handle, GATT_CHARACTERISTICS_UUID);
+        if (att_response[0] != ATT_READ_BY_TYPE_RESPONSE) break;
+        uint16_t pair_len = att_response[1];
+        uint16_t pos;
+        for (pos = 2; (pos + pair_len) <= response_len; pos += pair_len){
+            CHECK(num_characteristics < NUM_CHARACTERISTICS);
+            start_handle = little_endian_read_16(att_response, pos) + 1u;
+            value_handles[num_characteristics++] = little_endian_read_16(att_response, pos + 3u);
+        }
+    }
+    CHECK_EQUAL(service->num_characteristics, num_characteristics);
+
+    uint16_t num_descriptors = 0;
+    uint16_t i;
+    for (i = 0; i < num_characteristics; i++){
+        uint16_t end_handle = (i + 1u < num_characteristics) ? (value_handles[i + 1u] - 2u) : service->end_handle;
+        if (end_handle > value_handles[i]){
+            uint16_t response_len = find_information(value_handles[i] + 1u, end_handle);
+            CHECK_EQUAL(ATT_FIND_INFORMATION_REPLY, att_response[0]);
+            num_descriptors += (response_len - 2u) / 4u;
+        }
+        if (!read_values) continue;
+        uint16_t response_len = read_value(value_handles[i]);
+        CHECK_EQUAL(ATT_READ_RESPONSE, att_response[0]);
+        CHECK_EQUAL(1u + sizeof(value), response_len);
+    }
+    CHECK_EQUAL(service->num_descriptors, num_descriptors);
+}
+
+static void discover_all(void){
+    uint16_t uuid16_services = 0;
+    uint16_t uuid128_services = 0;
+    CHECK_EQUAL(NUM_SERVICES, discover_services(&uuid16_services, &uuid128_services));
+    CHECK_EQUAL(num_services_16, uuid16_services);
+    CHECK_EQUAL(num_services_128, uuid128_services);
+    uint16_t i;
+    for (i = 0; i < NUM_SERVICES; i++){
+        discover_service(&services[i]);
+    }
+}
+
+static uint32_t time_us(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((now.tv_sec * 1000000) + (now.tv_nsec / 1000));
+}
+
+TEST_GROUP(AttDbBenchmark){
+    void setup(void){
+        // skip request logging in benchmark
+        hci_dump_enable_log_level(HCI_DUMP_LOG_LEVEL_INFO, 0);
+        (void)memset(&att_connection, 0, sizeof(att_connection));
+        att_connection.max_mtu = 185;
+        att_connection.mtu = 185;
+        (void)memset(services, 0, sizeof(services));
+        num_services_16 = 0;
+        num_services_128 = 0;
+        read_values = true;
+
+        att_db_util_init();
+        uint16_t i;
+        for (i = 0; i < NUM_SERVICES; i++){
+            add_service(i, (i % 4u) == 3u);
+        }
+        att_set_db(att_db_util_get_address());
+    }
+};
+
+static uint32_t measure_discovery(void){
+    discover_all();
+    uint32_t start = time_us();
+    uint16_t round;
+    for (round = 0; round < NUM_ROUNDS; round++){
+        discover_all();
+    }
+    return (time_us() - start) / NUM_ROUNDS;
+}
+
+TEST(AttDbBenchmark, Discovery){
+    read_values = false;
+    uint32_t discovery_us = measure_discovery();
+    read_values = true;
+    uint32_t discovery_and_read_us = measure_discovery();
+#if defined(ENABLE_ATT_DB_INDEX)
+    const char * variant = "indexed";
+#elif defined(ENABLE_ATT_DB_DISCOVERY_CACHE)
+    const char * variant = "cached";
+#else
+    const char * variant = "linear";
+#endif
+    printf("\nATT DB %s: %u attributes, discovery %u us, discovery and read all %u us\n", variant,
+           services[NUM_SERVICES - 1].end_handle, discovery_us, discovery_and_read_us);
+}
+
+TEST(AttDbBenchmark, UnknownHandle){
+    read_value(services[NUM_SERVICES - 1].end_handle + 1u);
+    CHECK_EQUAL(ATT_ERROR_RESPONSE, att_response[0]);
+    CHECK_EQUAL(ATT_ERROR_INVALID_HANDLE, att_response[4]);
+    find_information(services[NUM_SERVICES - 1].end_handle + 1u, 0xffff);
+    CHECK_EQUAL(ATT_ERROR_RESPONSE, att_response[0]);
+    CHECK_EQUAL(ATT_ERROR_ATTRIBUTE_NOT_FOUND, att_response[4]);
+}
+
+TEST(AttDbBenchmark, GroupBeyondEndHandle){
+    // first service group ends after requested range
+    att_request[0] = ATT_READ_BY_GROUP_TYPE_REQUEST;
+    little_endian_store_16(att_request, 1, 1);
+    little_endian_store_16(att_request, 3, services[0].end_handle - 1u);
+    little_endian_store_16(att_request, 5, GATT_PRIMARY_SERVICE_UUID);
+    handle_request(7);
+    CHECK_EQUAL(ATT_ERROR_RESPONSE, att_response[0]);
+    CHECK_EQUAL(ATT_ERROR_ATTRIBUTE_NOT_FOUND, att_response[4]);
+}
+
+TEST(AttDbBenchmark, AppendAttributes){
+    discover_all();
+    uint16_t next_handle = services[NUM_SERVICES - 1].end_handle + 1u;
+    read_by_group_type(next_handle);
+    CHECK_EQUAL(ATT_ERROR_RESPONSE, att_response[0]);
+
+    // add service after db was set, att_db_util calls att_set_db only on realloc
+    uint16_t handle = att_db_util_add_service_uuid16(0x1900);
+    uint16_t value_handle = att_db_util_add_characteristic_uuid16(0x2b00, ATT_PROPERTY_READ, ATT_SECURITY_NONE, ATT_SECURITY_NONE, value, sizeof(value));
+    CHECK_EQUAL(next_handle, handle);
+    CHECK_EQUAL(handle + 2u, value_handle);
+
+    read_by_group_type(next_handle);
+    CHECK_EQUAL(ATT_READ_BY_GROUP_TYPE_RESPONSE, att_response[0]);
+    CHECK_EQUAL(handle, little_endian_read_16(att_response, 2));
+    CHECK_EQUAL(value_handle, little_endian_read_16(att_response, 4));
+    read_value(value_handle);
+    CHECK_EQUAL(ATT_READ_RESPONSE, att_response[0]);
+    read_by_type(1, 0xffff, 0x2b00);
+    CHECK_EQUAL(ATT_READ_BY_TYPE_RESPONSE, att_response[0]);
+    CHECK_EQUAL(value_handle, little_endian_read_16(att_response, 2));
+}
+
+TEST(AttDbBenchmark, MtuChange){
+    discover_all();
+    att_connection.mtu = ATT_DEFAULT_MTU;
+    discover_all();
+    att_connection.mtu = 185;
+    discover_all();
+}
+
+TEST(AttDbBenchmark, Security){
+    uint16_t handle = att_db_util_add_service_uuid16(0x1900);
+    att_db_util_add_characteristic_uuid16(0x2b00, ATT_PROPERTY_READ, ATT_SECURITY_AUTHENTICATED, ATT_SECURITY_NONE, value, sizeof(value));
+    att_set_db(att_db_util_get_address());
+
+    read_by_type(handle, 0xffff, 0x2b00);
+    CHECK_EQUAL(ATT_ERROR_RESPONSE, att_response[0]);
+    CHECK_EQUAL(ATT_ERROR_INSUFFICIENT_AUTHENTICATION, att_response[4]);
+
+    att_connection.encryption_key_size = 16;
+    att_connection.authenticated = 1;
+    read_by_type(handle, 0xffff, 0x2b00);
+    CHECK_EQUAL(ATT_READ_BY_TYPE_RESPONSE, att_response[0]);
+
+    att_connection.encryption_key_size = 0;
+    att_connection.authenticated = 0;
+    read_by_type(handle, 0xffff, 0x2b00);
+    CHECK_EQUAL(ATT_ERROR_RESPONSE, att_response[0]);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
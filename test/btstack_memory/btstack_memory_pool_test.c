@@ -123,6 +123,79 @@ TEST(MemoryPool, CreateAndFree){
     CHECK(next_node == NULL);
 }
 
+TEST(MemoryPool, Stats){
+    uint32_t bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NUM_PDUS)];
+    btstack_memory_pool_create_with_bitmap(&pdu_pool, pdu_storage, 3, sizeof(test_pdu_t), bitmap);
+    btstack_memory_pool_stats_t stats;
+
+    void * node_1 = btstack_memory_pool_get(&pdu_pool);
+    void * node_2 = btstack_memory_pool_get(&pdu_pool);
+    btstack_memory_pool_free(&pdu_pool, node_1);
+    btstack_memory_pool_get_stats(&pdu_pool, &stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(2, stats.max_in_use);
+    CHECK_EQUAL(2, stats.num_allocations);
+    CHECK_EQUAL(0, stats.num_failed);
+
+    btstack_memory_pool_get(&pdu_pool);
+    btstack_memory_pool_get(&pdu_pool);
+    CHECK(btstack_memory_pool_get(&pdu_pool) == NULL);
+    btstack_memory_pool_free(&pdu_pool, node_2);
+    btstack_memory_pool_get_stats(&pdu_pool, &stats);
+    CHECK_EQUAL(2, stats.in_use);
+    CHECK_EQUAL(3, stats.max_in_use);
+    CHECK_EQUAL(4, stats.num_allocations);
+    CHECK_EQUAL(1, stats.num_failed);
+}
+
+TEST(MemoryPool, BitmapLargePool){
+    uint32_t bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NUM_PDUS)];
+    btstack_memory_pool_create_with_bitmap(&pdu_pool, pdu_storage, MAX_NUM_PDUS, sizeof(test_pdu_t), bitmap);
+    void * nodes[MAX_NUM_PDUS];
+    int i;
+    for (i = 0; i < MAX_NUM_PDUS; i++){
+        nodes[i] = btstack_memory_pool_get(&pdu_pool);
+        CHECK(nodes[i] != NULL);
+    }
+    CHECK(btstack_memory_pool_get(&pdu_pool) == NULL);
+    for (i = 0; i < MAX_NUM_PDUS; i++){
+        btstack_memory_pool_free(&pdu_pool, nodes[i]);
+    }
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_pool_get_stats(&pdu_pool, &stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(MAX_NUM_PDUS, stats.max_in_use);
+}
+
+#ifndef HAVE_ASSERT
+// without assert, invalid free is logged and ignored
+TEST(MemoryPool, DoubleFree){
+    uint32_t bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NUM_PDUS)];
+    btstack_memory_pool_create_with_bitmap(&pdu_pool, pdu_storage, 3, sizeof(test_pdu_t), bitmap);
+    test_pdu_t * node = (test_pdu_t *) btstack_memory_pool_get(&pdu_pool);
+    btstack_memory_pool_free(&pdu_pool, node);
+    btstack_memory_pool_free(&pdu_pool, node);
+    CHECK(btstack_memory_pool_get(&pdu_pool) == node);
+    CHECK(btstack_memory_pool_get(&pdu_pool) != node);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_pool_get_stats(&pdu_pool, &stats);
+    CHECK_EQUAL(2, stats.in_use);
+}
+
+TEST(MemoryPool, FreeInvalidBlock){
+    uint32_t bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(MAX_NUM_PDUS)];
+    btstack_memory_pool_create_with_bitmap(&pdu_pool, pdu_storage, 3, sizeof(test_pdu_t), bitmap);
+    btstack_memory_pool_get(&pdu_pool);
+    // outside of pool
+    btstack_memory_pool_free(&pdu_pool, &pdu_storage[3]);
+    // not at block start
+    btstack_memory_pool_free(&pdu_pool, &pdu_storage[2].value);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_pool_get_stats(&pdu_pool, &stats);
+    CHECK_EQUAL(1, stats.in_use);
+}
+#endif
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
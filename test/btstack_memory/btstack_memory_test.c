@@ -78,10 +78,24 @@ TEST(btstack_memory, deinit){
     btstack_memory_hci_connection_free(buffer_1);
     // leave buffer in list
     (void) buffer_2;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(3, stats.max_in_use);
+    CHECK_EQUAL(3, stats.num_allocations);
+    // report leak and free buffer
     btstack_memory_deinit();
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
 }
 #endif
 
+TEST(btstack_memory, dump_stats){
+    hci_connection_t * buffer = btstack_memory_hci_connection_get();
+    btstack_memory_dump_stats();
+    btstack_memory_hci_connection_free(buffer);
+}
+
 
 
 
@@ -90,7 +104,14 @@ TEST(btstack_memory, hci_connection_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_hci_connection_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(hci_connection_t) * stats.in_use, sizeof(hci_connection_t));
     btstack_memory_hci_connection_free(context);
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_HCI_CONNECTIONS
     // single
@@ -110,6 +131,9 @@ TEST(btstack_memory, hci_connection_NotEnoughBuffers){
     hci_connection_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_HCI_CONNECTIONS
     int i;
@@ -123,6 +147,16 @@ TEST(btstack_memory, hci_connection_NotEnoughBuffers){
     // get one more
     context = btstack_memory_hci_connection_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_HCI_CONNECTIONS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_HCI_CONNECTIONS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_HCI_CONNECTIONS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -132,7 +166,14 @@ TEST(btstack_memory, l2cap_service_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_l2cap_service_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_l2cap_service_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(l2cap_service_t) * stats.in_use, sizeof(l2cap_service_t));
     btstack_memory_l2cap_service_free(context);
+    btstack_memory_l2cap_service_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_L2CAP_SERVICES
     // single
@@ -152,6 +193,9 @@ TEST(btstack_memory, l2cap_service_NotEnoughBuffers){
     l2cap_service_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_l2cap_service_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_L2CAP_SERVICES
     int i;
@@ -165,6 +209,16 @@ TEST(btstack_memory, l2cap_service_NotEnoughBuffers){
     // get one more
     context = btstack_memory_l2cap_service_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_l2cap_service_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_L2CAP_SERVICES)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_l2cap_service_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_L2CAP_SERVICES, stats.in_use);
+    CHECK_EQUAL(MAX_NR_L2CAP_SERVICES, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -174,7 +228,14 @@ TEST(btstack_memory, l2cap_channel_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_l2cap_channel_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_l2cap_channel_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(l2cap_channel_t) * stats.in_use, sizeof(l2cap_channel_t));
     btstack_memory_l2cap_channel_free(context);
+    btstack_memory_l2cap_channel_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_L2CAP_CHANNELS
     // single
@@ -194,6 +255,9 @@ TEST(btstack_memory, l2cap_channel_NotEnoughBuffers){
     l2cap_channel_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_l2cap_channel_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_L2CAP_CHANNELS
     int i;
@@ -207,6 +271,16 @@ TEST(btstack_memory, l2cap_channel_NotEnoughBuffers){
     // get one more
     context = btstack_memory_l2cap_channel_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_l2cap_channel_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_L2CAP_CHANNELS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_l2cap_channel_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_L2CAP_CHANNELS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_L2CAP_CHANNELS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 #ifdef ENABLE_CLASSIC
@@ -217,7 +291,14 @@ TEST(btstack_memory, rfcomm_multiplexer_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_rfcomm_multiplexer_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_multiplexer_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(rfcomm_multiplexer_t) * stats.in_use, sizeof(rfcomm_multiplexer_t));
     btstack_memory_rfcomm_multiplexer_free(context);
+    btstack_memory_rfcomm_multiplexer_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_RFCOMM_MULTIPLEXERS
     // single
@@ -237,6 +318,9 @@ TEST(btstack_memory, rfcomm_multiplexer_NotEnoughBuffers){
     rfcomm_multiplexer_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_multiplexer_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_RFCOMM_MULTIPLEXERS
     int i;
@@ -250,6 +334,16 @@ TEST(btstack_memory, rfcomm_multiplexer_NotEnoughBuffers){
     // get one more
     context = btstack_memory_rfcomm_multiplexer_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_rfcomm_multiplexer_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_RFCOMM_MULTIPLEXERS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_multiplexer_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_RFCOMM_MULTIPLEXERS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_RFCOMM_MULTIPLEXERS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -259,7 +353,14 @@ TEST(btstack_memory, rfcomm_service_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_rfcomm_service_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_service_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(rfcomm_service_t) * stats.in_use, sizeof(rfcomm_service_t));
     btstack_memory_rfcomm_service_free(context);
+    btstack_memory_rfcomm_service_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_RFCOMM_SERVICES
     // single
@@ -279,6 +380,9 @@ TEST(btstack_memory, rfcomm_service_NotEnoughBuffers){
     rfcomm_service_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_service_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_RFCOMM_SERVICES
     int i;
@@ -292,6 +396,16 @@ TEST(btstack_memory, rfcomm_service_NotEnoughBuffers){
     // get one more
     context = btstack_memory_rfcomm_service_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_rfcomm_service_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_RFCOMM_SERVICES)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_service_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_RFCOMM_SERVICES, stats.in_use);
+    CHECK_EQUAL(MAX_NR_RFCOMM_SERVICES, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -301,7 +415,14 @@ TEST(btstack_memory, rfcomm_channel_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_rfcomm_channel_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_channel_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(rfcomm_channel_t) * stats.in_use, sizeof(rfcomm_channel_t));
     btstack_memory_rfcomm_channel_free(context);
+    btstack_memory_rfcomm_channel_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_RFCOMM_CHANNELS
     // single
@@ -321,6 +442,9 @@ TEST(btstack_memory, rfcomm_channel_NotEnoughBuffers){
     rfcomm_channel_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_channel_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_RFCOMM_CHANNELS
     int i;
@@ -334,6 +458,16 @@ TEST(btstack_memory, rfcomm_channel_NotEnoughBuffers){
     // get one more
     context = btstack_memory_rfcomm_channel_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_rfcomm_channel_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_RFCOMM_CHANNELS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_rfcomm_channel_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_RFCOMM_CHANNELS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_RFCOMM_CHANNELS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -343,7 +477,14 @@ TEST(btstack_memory, btstack_link_key_db_memory_entry_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_btstack_link_key_db_memory_entry_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_btstack_link_key_db_memory_entry_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(btstack_link_key_db_memory_entry_t) * stats.in_use, sizeof(btstack_link_key_db_memory_entry_t));
     btstack_memory_btstack_link_key_db_memory_entry_free(context);
+    btstack_memory_btstack_link_key_db_memory_entry_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES
     // single
@@ -363,6 +504,9 @@ TEST(btstack_memory, btstack_link_key_db_memory_entry_NotEnoughBuffers){
     btstack_link_key_db_memory_entry_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_btstack_link_key_db_memory_entry_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES
     int i;
@@ -376,6 +520,16 @@ TEST(btstack_memory, btstack_link_key_db_memory_entry_NotEnoughBuffers){
     // get one more
     context = btstack_memory_btstack_link_key_db_memory_entry_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_btstack_link_key_db_memory_entry_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_btstack_link_key_db_memory_entry_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES, stats.in_use);
+    CHECK_EQUAL(MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -385,7 +539,14 @@ TEST(btstack_memory, bnep_service_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_bnep_service_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_bnep_service_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(bnep_service_t) * stats.in_use, sizeof(bnep_service_t));
     btstack_memory_bnep_service_free(context);
+    btstack_memory_bnep_service_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_BNEP_SERVICES
     // single
@@ -405,6 +566,9 @@ TEST(btstack_memory, bnep_service_NotEnoughBuffers){
     bnep_service_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_bnep_service_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_BNEP_SERVICES
     int i;
@@ -418,6 +582,16 @@ TEST(btstack_memory, bnep_service_NotEnoughBuffers){
     // get one more
     context = btstack_memory_bnep_service_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_bnep_service_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_BNEP_SERVICES)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_bnep_service_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_BNEP_SERVICES, stats.in_use);
+    CHECK_EQUAL(MAX_NR_BNEP_SERVICES, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -427,7 +601,14 @@ TEST(btstack_memory, bnep_channel_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_bnep_channel_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_bnep_channel_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(bnep_channel_t) * stats.in_use, sizeof(bnep_channel_t));
     btstack_memory_bnep_channel_free(context);
+    btstack_memory_bnep_channel_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_BNEP_CHANNELS
     // single
@@ -447,6 +628,9 @@ TEST(btstack_memory, bnep_channel_NotEnoughBuffers){
     bnep_channel_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_bnep_channel_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_BNEP_CHANNELS
     int i;
@@ -460,6 +644,16 @@ TEST(btstack_memory, bnep_channel_NotEnoughBuffers){
     // get one more
     context = btstack_memory_bnep_channel_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_bnep_channel_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_BNEP_CHANNELS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_bnep_channel_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_BNEP_CHANNELS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_BNEP_CHANNELS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -469,7 +663,14 @@ TEST(btstack_memory, hfp_connection_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_hfp_connection_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hfp_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(hfp_connection_t) * stats.in_use, sizeof(hfp_connection_t));
     btstack_memory_hfp_connection_free(context);
+    btstack_memory_hfp_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_HFP_CONNECTIONS
     // single
@@ -489,6 +690,9 @@ TEST(btstack_memory, hfp_connection_NotEnoughBuffers){
     hfp_connection_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hfp_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_HFP_CONNECTIONS
     int i;
@@ -502,6 +706,78 @@ TEST(btstack_memory, hfp_connection_NotEnoughBuffers){
     // get one more
     context = btstack_memory_hfp_connection_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_hfp_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_HFP_CONNECTIONS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hfp_connection_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_HFP_CONNECTIONS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_HFP_CONNECTIONS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
+}
+
+
+
+TEST(btstack_memory, hid_host_connection_GetAndFree){
+    hid_host_connection_t * context;
+#ifdef HAVE_MALLOC
+    context = btstack_memory_hid_host_connection_get();
+    CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hid_host_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(hid_host_connection_t) * stats.in_use, sizeof(hid_host_connection_t));
+    btstack_memory_hid_host_connection_free(context);
+    btstack_memory_hid_host_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
+#else
+#ifdef MAX_NR_HID_HOST_CONNECTIONS
+    // single
+    context = btstack_memory_hid_host_connection_get();
+    CHECK(context != NULL);
+    btstack_memory_hid_host_connection_free(context);
+#else
+    // none
+    context = btstack_memory_hid_host_connection_get();
+    CHECK(context == NULL);
+    btstack_memory_hid_host_connection_free(context);
+#endif
+#endif
+}
+
+TEST(btstack_memory, hid_host_connection_NotEnoughBuffers){
+    hid_host_connection_t * context;
+#ifdef HAVE_MALLOC
+    simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hid_host_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
+#else
+#ifdef MAX_NR_HID_HOST_CONNECTIONS
+    int i;
+    // alloc all static buffers
+    for (i = 0; i < MAX_NR_HID_HOST_CONNECTIONS; i++){
+        context = btstack_memory_hid_host_connection_get();
+        CHECK(context != NULL);
+    }
+#endif
+#endif
+    // get one more
+    context = btstack_memory_hid_host_connection_get();
+    CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_hid_host_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_HID_HOST_CONNECTIONS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hid_host_connection_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_HID_HOST_CONNECTIONS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_HID_HOST_CONNECTIONS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -511,7 +787,14 @@ TEST(btstack_memory, service_record_item_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_service_record_item_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_service_record_item_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(service_record_item_t) * stats.in_use, sizeof(service_record_item_t));
     btstack_memory_service_record_item_free(context);
+    btstack_memory_service_record_item_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_SERVICE_RECORD_ITEMS
     // single
@@ -531,6 +814,9 @@ TEST(btstack_memory, service_record_item_NotEnoughBuffers){
     service_record_item_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_service_record_item_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_SERVICE_RECORD_ITEMS
     int i;
@@ -544,6 +830,16 @@ TEST(btstack_memory, service_record_item_NotEnoughBuffers){
     // get one more
     context = btstack_memory_service_record_item_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_service_record_item_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_SERVICE_RECORD_ITEMS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_service_record_item_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_SERVICE_RECORD_ITEMS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_SERVICE_RECORD_ITEMS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -553,7 +849,14 @@ TEST(btstack_memory, avdtp_stream_endpoint_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_avdtp_stream_endpoint_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avdtp_stream_endpoint_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(avdtp_stream_endpoint_t) * stats.in_use, sizeof(avdtp_stream_endpoint_t));
     btstack_memory_avdtp_stream_endpoint_free(context);
+    btstack_memory_avdtp_stream_endpoint_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_AVDTP_STREAM_ENDPOINTS
     // single
@@ -573,6 +876,9 @@ TEST(btstack_memory, avdtp_stream_endpoint_NotEnoughBuffers){
     avdtp_stream_endpoint_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avdtp_stream_endpoint_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_AVDTP_STREAM_ENDPOINTS
     int i;
@@ -586,6 +892,16 @@ TEST(btstack_memory, avdtp_stream_endpoint_NotEnoughBuffers){
     // get one more
     context = btstack_memory_avdtp_stream_endpoint_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_avdtp_stream_endpoint_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_AVDTP_STREAM_ENDPOINTS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avdtp_stream_endpoint_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_AVDTP_STREAM_ENDPOINTS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_AVDTP_STREAM_ENDPOINTS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -595,7 +911,14 @@ TEST(btstack_memory, avdtp_connection_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_avdtp_connection_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avdtp_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(avdtp_connection_t) * stats.in_use, sizeof(avdtp_connection_t));
     btstack_memory_avdtp_connection_free(context);
+    btstack_memory_avdtp_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_AVDTP_CONNECTIONS
     // single
@@ -615,6 +938,9 @@ TEST(btstack_memory, avdtp_connection_NotEnoughBuffers){
     avdtp_connection_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avdtp_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_AVDTP_CONNECTIONS
     int i;
@@ -628,6 +954,16 @@ TEST(btstack_memory, avdtp_connection_NotEnoughBuffers){
     // get one more
     context = btstack_memory_avdtp_connection_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_avdtp_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_AVDTP_CONNECTIONS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avdtp_connection_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_AVDTP_CONNECTIONS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_AVDTP_CONNECTIONS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -637,7 +973,14 @@ TEST(btstack_memory, avrcp_connection_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_avrcp_connection_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avrcp_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(avrcp_connection_t) * stats.in_use, sizeof(avrcp_connection_t));
     btstack_memory_avrcp_connection_free(context);
+    btstack_memory_avrcp_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_AVRCP_CONNECTIONS
     // single
@@ -657,6 +1000,9 @@ TEST(btstack_memory, avrcp_connection_NotEnoughBuffers){
     avrcp_connection_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avrcp_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_AVRCP_CONNECTIONS
     int i;
@@ -670,6 +1016,16 @@ TEST(btstack_memory, avrcp_connection_NotEnoughBuffers){
     // get one more
     context = btstack_memory_avrcp_connection_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_avrcp_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_AVRCP_CONNECTIONS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avrcp_connection_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_AVRCP_CONNECTIONS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_AVRCP_CONNECTIONS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -679,7 +1035,14 @@ TEST(btstack_memory, avrcp_browsing_connection_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_avrcp_browsing_connection_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avrcp_browsing_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(avrcp_browsing_connection_t) * stats.in_use, sizeof(avrcp_browsing_connection_t));
     btstack_memory_avrcp_browsing_connection_free(context);
+    btstack_memory_avrcp_browsing_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_AVRCP_BROWSING_CONNECTIONS
     // single
@@ -699,6 +1062,9 @@ TEST(btstack_memory, avrcp_browsing_connection_NotEnoughBuffers){
     avrcp_browsing_connection_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avrcp_browsing_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_AVRCP_BROWSING_CONNECTIONS
     int i;
@@ -712,6 +1078,16 @@ TEST(btstack_memory, avrcp_browsing_connection_NotEnoughBuffers){
     // get one more
     context = btstack_memory_avrcp_browsing_connection_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_avrcp_browsing_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_AVRCP_BROWSING_CONNECTIONS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_avrcp_browsing_connection_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_AVRCP_BROWSING_CONNECTIONS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_AVRCP_BROWSING_CONNECTIONS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 #endif
@@ -723,7 +1099,14 @@ TEST(btstack_memory, gatt_client_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_gatt_client_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_gatt_client_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(gatt_client_t) * stats.in_use, sizeof(gatt_client_t));
     btstack_memory_gatt_client_free(context);
+    btstack_memory_gatt_client_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_GATT_CLIENTS
     // single
@@ -743,6 +1126,9 @@ TEST(btstack_memory, gatt_client_NotEnoughBuffers){
     gatt_client_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_gatt_client_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_GATT_CLIENTS
     int i;
@@ -756,6 +1142,16 @@ TEST(btstack_memory, gatt_client_NotEnoughBuffers){
     // get one more
     context = btstack_memory_gatt_client_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_gatt_client_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_GATT_CLIENTS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_gatt_client_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_GATT_CLIENTS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_GATT_CLIENTS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -765,7 +1161,14 @@ TEST(btstack_memory, whitelist_entry_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_whitelist_entry_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_whitelist_entry_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(whitelist_entry_t) * stats.in_use, sizeof(whitelist_entry_t));
     btstack_memory_whitelist_entry_free(context);
+    btstack_memory_whitelist_entry_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_WHITELIST_ENTRIES
     // single
@@ -785,6 +1188,9 @@ TEST(btstack_memory, whitelist_entry_NotEnoughBuffers){
     whitelist_entry_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_whitelist_entry_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_WHITELIST_ENTRIES
     int i;
@@ -798,6 +1204,16 @@ TEST(btstack_memory, whitelist_entry_NotEnoughBuffers){
     // get one more
     context = btstack_memory_whitelist_entry_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_whitelist_entry_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_WHITELIST_ENTRIES)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_whitelist_entry_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_WHITELIST_ENTRIES, stats.in_use);
+    CHECK_EQUAL(MAX_NR_WHITELIST_ENTRIES, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -807,7 +1223,14 @@ TEST(btstack_memory, sm_lookup_entry_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_sm_lookup_entry_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_sm_lookup_entry_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(sm_lookup_entry_t) * stats.in_use, sizeof(sm_lookup_entry_t));
     btstack_memory_sm_lookup_entry_free(context);
+    btstack_memory_sm_lookup_entry_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_SM_LOOKUP_ENTRIES
     // single
@@ -827,6 +1250,9 @@ TEST(btstack_memory, sm_lookup_entry_NotEnoughBuffers){
     sm_lookup_entry_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_sm_lookup_entry_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_SM_LOOKUP_ENTRIES
     int i;
@@ -840,6 +1266,16 @@ TEST(btstack_memory, sm_lookup_entry_NotEnoughBuffers){
     // get one more
     context = btstack_memory_sm_lookup_entry_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_sm_lookup_entry_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_SM_LOOKUP_ENTRIES)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_sm_lookup_entry_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_SM_LOOKUP_ENTRIES, stats.in_use);
+    CHECK_EQUAL(MAX_NR_SM_LOOKUP_ENTRIES, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 #endif
@@ -851,7 +1287,14 @@ TEST(btstack_memory, mesh_network_pdu_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_mesh_network_pdu_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_network_pdu_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(mesh_network_pdu_t) * stats.in_use, sizeof(mesh_network_pdu_t));
     btstack_memory_mesh_network_pdu_free(context);
+    btstack_memory_mesh_network_pdu_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_MESH_NETWORK_PDUS
     // single
@@ -871,6 +1314,9 @@ TEST(btstack_memory, mesh_network_pdu_NotEnoughBuffers){
     mesh_network_pdu_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_network_pdu_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_MESH_NETWORK_PDUS
     int i;
@@ -884,6 +1330,16 @@ TEST(btstack_memory, mesh_network_pdu_NotEnoughBuffers){
     // get one more
     context = btstack_memory_mesh_network_pdu_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_mesh_network_pdu_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_MESH_NETWORK_PDUS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_network_pdu_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_MESH_NETWORK_PDUS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_MESH_NETWORK_PDUS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -893,7 +1349,14 @@ TEST(btstack_memory, mesh_segmented_pdu_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_mesh_segmented_pdu_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_segmented_pdu_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(mesh_segmented_pdu_t) * stats.in_use, sizeof(mesh_segmented_pdu_t));
     btstack_memory_mesh_segmented_pdu_free(context);
+    btstack_memory_mesh_segmented_pdu_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_MESH_SEGMENTED_PDUS
     // single
@@ -913,6 +1376,9 @@ TEST(btstack_memory, mesh_segmented_pdu_NotEnoughBuffers){
     mesh_segmented_pdu_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_segmented_pdu_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_MESH_SEGMENTED_PDUS
     int i;
@@ -926,6 +1392,16 @@ TEST(btstack_memory, mesh_segmented_pdu_NotEnoughBuffers){
     // get one more
     context = btstack_memory_mesh_segmented_pdu_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_mesh_segmented_pdu_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_MESH_SEGMENTED_PDUS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_segmented_pdu_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_MESH_SEGMENTED_PDUS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_MESH_SEGMENTED_PDUS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -935,7 +1411,14 @@ TEST(btstack_memory, mesh_upper_transport_pdu_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_mesh_upper_transport_pdu_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_upper_transport_pdu_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(mesh_upper_transport_pdu_t) * stats.in_use, sizeof(mesh_upper_transport_pdu_t));
     btstack_memory_mesh_upper_transport_pdu_free(context);
+    btstack_memory_mesh_upper_transport_pdu_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_MESH_UPPER_TRANSPORT_PDUS
     // single
@@ -955,6 +1438,9 @@ TEST(btstack_memory, mesh_upper_transport_pdu_NotEnoughBuffers){
     mesh_upper_transport_pdu_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_upper_transport_pdu_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_MESH_UPPER_TRANSPORT_PDUS
     int i;
@@ -968,6 +1454,16 @@ TEST(btstack_memory, mesh_upper_transport_pdu_NotEnoughBuffers){
     // get one more
     context = btstack_memory_mesh_upper_transport_pdu_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_mesh_upper_transport_pdu_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_MESH_UPPER_TRANSPORT_PDUS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_upper_transport_pdu_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_MESH_UPPER_TRANSPORT_PDUS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_MESH_UPPER_TRANSPORT_PDUS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -977,7 +1473,14 @@ TEST(btstack_memory, mesh_network_key_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_mesh_network_key_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_network_key_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(mesh_network_key_t) * stats.in_use, sizeof(mesh_network_key_t));
     btstack_memory_mesh_network_key_free(context);
+    btstack_memory_mesh_network_key_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_MESH_NETWORK_KEYS
     // single
@@ -997,6 +1500,9 @@ TEST(btstack_memory, mesh_network_key_NotEnoughBuffers){
     mesh_network_key_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_network_key_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_MESH_NETWORK_KEYS
     int i;
@@ -1010,6 +1516,16 @@ TEST(btstack_memory, mesh_network_key_NotEnoughBuffers){
     // get one more
     context = btstack_memory_mesh_network_key_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_mesh_network_key_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_MESH_NETWORK_KEYS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_network_key_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_MESH_NETWORK_KEYS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_MESH_NETWORK_KEYS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -1019,7 +1535,14 @@ TEST(btstack_memory, mesh_transport_key_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_mesh_transport_key_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_transport_key_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(mesh_transport_key_t) * stats.in_use, sizeof(mesh_transport_key_t));
     btstack_memory_mesh_transport_key_free(context);
+    btstack_memory_mesh_transport_key_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_MESH_TRANSPORT_KEYS
     // single
@@ -1039,6 +1562,9 @@ TEST(btstack_memory, mesh_transport_key_NotEnoughBuffers){
     mesh_transport_key_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_transport_key_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_MESH_TRANSPORT_KEYS
     int i;
@@ -1052,6 +1578,16 @@ TEST(btstack_memory, mesh_transport_key_NotEnoughBuffers){
     // get one more
     context = btstack_memory_mesh_transport_key_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_mesh_transport_key_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_MESH_TRANSPORT_KEYS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_transport_key_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_MESH_TRANSPORT_KEYS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_MESH_TRANSPORT_KEYS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -1061,7 +1597,14 @@ TEST(btstack_memory, mesh_virtual_address_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_mesh_virtual_address_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_virtual_address_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(mesh_virtual_address_t) * stats.in_use, sizeof(mesh_virtual_address_t));
     btstack_memory_mesh_virtual_address_free(context);
+    btstack_memory_mesh_virtual_address_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_MESH_VIRTUAL_ADDRESSS
     // single
@@ -1081,6 +1624,9 @@ TEST(btstack_memory, mesh_virtual_address_NotEnoughBuffers){
     mesh_virtual_address_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_virtual_address_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_MESH_VIRTUAL_ADDRESSS
     int i;
@@ -1094,6 +1640,16 @@ TEST(btstack_memory, mesh_virtual_address_NotEnoughBuffers){
     // get one more
     context = btstack_memory_mesh_virtual_address_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_mesh_virtual_address_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_MESH_VIRTUAL_ADDRESSS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_virtual_address_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_MESH_VIRTUAL_ADDRESSS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_MESH_VIRTUAL_ADDRESSS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 
@@ -1103,7 +1659,14 @@ TEST(btstack_memory, mesh_subnet_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_mesh_subnet_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_subnet_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(mesh_subnet_t) * stats.in_use, sizeof(mesh_subnet_t));
     btstack_memory_mesh_subnet_free(context);
+    btstack_memory_mesh_subnet_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef MAX_NR_MESH_SUBNETS
     // single
@@ -1123,6 +1686,9 @@ TEST(btstack_memory, mesh_subnet_NotEnoughBuffers){
     mesh_subnet_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_subnet_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef MAX_NR_MESH_SUBNETS
     int i;
@@ -1136,6 +1702,16 @@ TEST(btstack_memory, mesh_subnet_NotEnoughBuffers){
     // get one more
     context = btstack_memory_mesh_subnet_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_mesh_subnet_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(MAX_NR_MESH_SUBNETS)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_mesh_subnet_get_stats(&stats);
+    CHECK_EQUAL(MAX_NR_MESH_SUBNETS, stats.in_use);
+    CHECK_EQUAL(MAX_NR_MESH_SUBNETS, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 
 #endif
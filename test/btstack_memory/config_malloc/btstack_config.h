@@ -22,7 +22,12 @@
 #define HCI_ACL_PAYLOAD_SIZE 1024
 #define HCI_INCOMING_PRE_BUFFER_SIZE 6
 
-// test hook to mock malloc
+// test hook to mock malloc, include stdlib.h first so that C++ <cstdlib> does not see the macro
+#include <stdlib.h>
+#if defined __cplusplus
+extern "C"
+#endif
+void * test_malloc(size_t size);
 #define malloc test_malloc
 
 #endif
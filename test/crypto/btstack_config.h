@@ -19,7 +19,14 @@
 #define ENABLE_LOG_ERROR
 #define ENABLE_LOG_INFO
 #define ENABLE_PRINTF_HEXDUMP
+// btstack_crypto_benchmark and btstack_crypto_scheduling_test are also built with TEST_CONTROLLER_CRYPTO
+// to use HCI LE Encrypt and LE Generate DHKey
+#ifdef TEST_CONTROLLER_CRYPTO
+#define ENABLE_LE_SECURE_CONNECTIONS
+#define ENABLE_BTSTACK_CRYPTO_STATISTICS
+#else
 #define ENABLE_SOFTWARE_AES128
+#endif
 
 // BTstack configuration. buffers, sizes, ...
 #define HCI_ACL_PAYLOAD_SIZE 1024
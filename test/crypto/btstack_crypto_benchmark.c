@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// *****************************************************************************
+//
+// btstack_crypto throughput: software AES128 vs. HCI LE Encrypt
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_crypto.h"
+#include "btstack_util.h"
+
+extern "C" {
+#include "aes_ccm.h"
+#include "aes_cmac.h"
+uint32_t mock_get_le_encrypt_count(void);
+}
+
+#ifdef ENABLE_SOFTWARE_AES128
+#ifdef __AES__
+#define ENGINE "software AES128 (AES-NI)"
+#else
+#define ENGINE "software AES128"
+#endif
+#define NUM_ITERATIONS 20000
+#else
+#define ENGINE "HCI LE Encrypt (host only)"
+#define NUM_ITERATIONS 2000
+#endif
+
+static const uint8_t key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const uint8_t nonce[13] = {
+    0x00, 0x80, 0x00, 0x00, 0x01, 0x12, 0x34, 0x00, 0x00, 0x00, 0x00, 0x12, 0x33
+};
+
+static btstack_crypto_aes128_t      aes128_request;
+static btstack_crypto_aes128_cmac_t cmac_request;
+static btstack_crypto_ccm_t         ccm_request;
+static uint8_t  message[64];
+static uint8_t  result[64];
+static uint32_t num_done;
+
+static void crypto_done(void * arg){
+    UNUSED(arg);
+    num_done++;
+}
+
+static double time_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void report(const char * name, double start_s, uint32_t le_encrypt_start){
+    double duration_s = time_s() - start_s;
+    uint32_t le_encrypt_per_op = (mock_get_le_encrypt_count() - le_encrypt_start) / NUM_ITERATIONS;
+    printf("%-24s %-28s %10.0f ops/s, %2u LE Encrypt per op\n", name, ENGINE, NUM_ITERATIONS / duration_s, le_encrypt_per_op);
+}
+
+static void ccm_encrypt(uint16_t len, uint8_t * mic){
+    btstack_crypto_ccm_init(&ccm_request, key, nonce, len, 0, 8);
+    btstack_crypto_ccm_encrypt_block(&ccm_request, len, message, result, &crypto_done, NULL);
+    btstack_crypto_ccm_get_authentication_value(&ccm_request, mic);
+}
+
+TEST_GROUP(CryptoBenchmark){
+    void setup(void){
+        btstack_crypto_init();
+        num_done = 0;
+        int i;
+        for (i=0;i<(int)sizeof(message);i++){
+            message[i] = (uint8_t) i;
+        }
+    }
+    void teardown(void){
+        btstack_crypto_deinit();
+    }
+};
+
+TEST(CryptoBenchmark, AES128){
+    uint8_t expected[16];
+    aes128_calc_cyphertext(key, message, expected);
+    uint32_t le_encrypt_start = mock_get_le_encrypt_count();
+    double start_s = time_s();
+    int i;
+    for (i=0;i<NUM_ITERATIONS;i++){
+        btstack_crypto_aes128_encrypt(&aes128_request, key, message, result, &crypto_done, NULL);
+    }
+    report("AES128", start_s, le_encrypt_start);
+    CHECK_EQUAL(NUM_ITERATIONS, num_done);
+    MEMCMP_EQUAL(expected, result, 16);
+}
+
+TEST(CryptoBenchmark, CMAC_64){
+    sm_key_t expected;
+    sm_key_t k;
+    memcpy(k, key, 16);
+    aes_cmac(expected, k, message, 64);
+    uint32_t le_encrypt_start = mock_get_le_encrypt_count();
+    double start_s = time_s();
+    int i;
+    for (i=0;i<NUM_ITERATIONS;i++){
+        btstack_crypto_aes128_cmac_message(&cmac_request, key, 64, message, result, &crypto_done, NULL);
+    }
+    report("CMAC 64 bytes", start_s, le_encrypt_start);
+    CHECK_EQUAL(NUM_ITERATIONS, num_done);
+    MEMCMP_EQUAL(expected, result, 16);
+}
+
+TEST(CryptoBenchmark, CCM_Encrypt_29){
+    // max Network PDU payload
+    const uint16_t len = 29;
+    uint8_t expected[29 + 8];
+    uint8_t nonce_copy[13];
+    memcpy(nonce_copy, nonce, 13);
+    bt_mesh_ccm_encrypt(key, nonce_copy, message, len, NULL, 0, expected, 8);
+    uint8_t mic[8];
+    uint32_t le_encrypt_start = mock_get_le_encrypt_count();
+    double start_s = time_s();
+    int i;
+    for (i=0;i<NUM_ITERATIONS;i++){
+        ccm_encrypt(len, mic);
+    }
+    report("CCM encrypt 29 bytes", start_s, le_encrypt_start);
+    CHECK_EQUAL(NUM_ITERATIONS, num_done);
+    MEMCMP_EQUAL(expected, result, len);
+    MEMCMP_EQUAL(&expected[len], mic, 8);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
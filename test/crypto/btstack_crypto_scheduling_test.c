@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// *****************************************************************************
+//
+// btstack_crypto scheduling: AES operations don't wait for ECC operations
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_crypto.h"
+#include "btstack_util.h"
+#include "hci.h"
+
+extern "C" {
+uint32_t mock_get_le_encrypt_count(void);
+void mock_simulate_hci_event(uint8_t * packet, uint16_t size);
+void mock_advance_time_ms(uint32_t delta_ms);
+}
+
+static const uint8_t key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const uint8_t nonce[13] = {
+    0x00, 0x80, 0x00, 0x00, 0x01, 0x12, 0x34, 0x00, 0x00, 0x00, 0x00, 0x12, 0x33
+};
+
+static btstack_crypto_ecc_p256_t ecc_request;
+static btstack_crypto_aes128_t   aes128_request;
+static btstack_crypto_ccm_t      ccm_request;
+static uint8_t public_key[64];
+static uint8_t dhkey[32];
+static uint8_t message[29];
+static uint8_t result[29];
+static bool    dhkey_done;
+static bool    aes128_done;
+static bool    ccm_done;
+
+static void dhkey_calculated(void * arg){
+    UNUSED(arg);
+    dhkey_done = true;
+}
+
+static void aes128_calculated(void * arg){
+    UNUSED(arg);
+    aes128_done = true;
+}
+
+static void ccm_calculated(void * arg){
+    UNUSED(arg);
+    ccm_done = true;
+}
+
+static void simulate_generate_dhkey_complete(void){
+    uint8_t event[36];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_LE_META;
+    event[1] = sizeof(event) - 2;
+    event[2] = HCI_SUBEVENT_LE_GENERATE_DHKEY_COMPLETE;
+    event[3] = ERROR_CODE_SUCCESS;
+    memset(&event[4], 0x55, 32);
+    mock_simulate_hci_event(event, sizeof(event));
+}
+
+static void print_statistics(const char * name, btstack_crypto_operation_t operation){
+    btstack_crypto_statistics_t statistics;
+    btstack_crypto_get_statistics(operation, &statistics);
+    printf("%-16s %u operations, max latency %u ms\n", name, statistics.num_operations, statistics.max_latency_ms);
+}
+
+TEST_GROUP(CryptoScheduling){
+    void setup(void){
+        btstack_crypto_init();
+        btstack_crypto_reset_statistics();
+        dhkey_done  = false;
+        aes128_done = false;
+        ccm_done    = false;
+    }
+    void teardown(void){
+        btstack_crypto_deinit();
+    }
+};
+
+TEST(CryptoScheduling, AESNotBlockedByDHKey){
+    // Controller is busy with LE Generate DHKey
+    btstack_crypto_ecc_p256_calculate_dhkey(&ecc_request, public_key, dhkey, &dhkey_calculated, NULL);
+    CHECK_FALSE(dhkey_done);
+
+    // AES and CCM requests queued later complete meanwhile
+    uint8_t ciphertext[16];
+    btstack_crypto_aes128_encrypt(&aes128_request, key, key, ciphertext, &aes128_calculated, NULL);
+    CHECK_TRUE(aes128_done);
+
+    uint8_t mic[4];
+    btstack_crypto_ccm_init(&ccm_request, key, nonce, sizeof(message), 0, sizeof(mic));
+    btstack_crypto_ccm_encrypt_block(&ccm_request, sizeof(message), message, result, &ccm_calculated, NULL);
+    btstack_crypto_ccm_get_authentication_value(&ccm_request, mic);
+    CHECK_TRUE(ccm_done);
+    CHECK_FALSE(dhkey_done);
+    CHECK_EQUAL(0, btstack_crypto_idle());
+
+    mock_advance_time_ms(150);
+    simulate_generate_dhkey_complete();
+    CHECK_TRUE(dhkey_done);
+    CHECK_EQUAL(0x55, dhkey[0]);
+    CHECK_EQUAL(1, btstack_crypto_idle());
+
+    btstack_crypto_statistics_t statistics;
+    btstack_crypto_get_statistics(BTSTACK_CRYPTO_AES128, &statistics);
+    CHECK_EQUAL(1, statistics.num_operations);
+    CHECK_EQUAL(0, statistics.max_latency_ms);
+    btstack_crypto_get_statistics(BTSTACK_CRYPTO_ECC_P256_CALCULATE_DHKEY, &statistics);
+    CHECK_EQUAL(1, statistics.num_operations);
+    CHECK_EQUAL(150, statistics.max_latency_ms);
+
+    print_statistics("AES128", BTSTACK_CRYPTO_AES128);
+    print_statistics("CCM encrypt", BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK);
+    print_statistics("ECC P-256 DHKey", BTSTACK_CRYPTO_ECC_P256_CALCULATE_DHKEY);
+}
+
+TEST(CryptoScheduling, DHKeyAfterAES){
+    // DHKey request queued while Controller is busy with AES, AES result is not mistaken for DHKey
+    btstack_crypto_aes128_encrypt(&aes128_request, key, key, result, &aes128_calculated, NULL);
+    btstack_crypto_ecc_p256_calculate_dhkey(&ecc_request, public_key, dhkey, &dhkey_calculated, NULL);
+    CHECK_TRUE(aes128_done);
+    CHECK_FALSE(dhkey_done);
+    simulate_generate_dhkey_complete();
+    CHECK_TRUE(dhkey_done);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -9,6 +9,13 @@ static uint8_t packet_buffer[256];
 static uint16_t packet_buffer_len;
 
 static uint8_t aes128_cyphertext[16];
+static uint32_t le_encrypt_count;
+static uint32_t time_ms;
+
+uint32_t mock_get_le_encrypt_count(void){
+	return le_encrypt_count;
+}
+
 void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
 	btstack_linked_list_add(&event_packet_handlers, (btstack_linked_item_t *) callback_handler);
 }
@@ -21,7 +28,7 @@ HCI_STATE hci_get_state(void){
 	return HCI_STATE_WORKING;
 }
 
-static void mock_simulate_hci_event(uint8_t * packet, uint16_t size){
+void mock_simulate_hci_event(uint8_t * packet, uint16_t size){
 	static int level = 0;
 	// hci_dump_packet(HCI_EVENT_PACKET, 1, packet, size);
 	btstack_linked_list_iterator_t  it;
@@ -49,6 +56,7 @@ int hci_send_cmd(const hci_cmd_t *cmd, ...){
 	// dump_packet(HCI_COMMAND_DATA_PACKET, packet_buffer, len);
 	packet_buffer_len = len;
 	if (cmd->opcode ==  hci_le_encrypt.opcode){
+		le_encrypt_count++;
 	    uint8_t * key_flipped = &packet_buffer[3];
 	    uint8_t key[16];
 		reverse_128(key_flipped, key);
@@ -63,3 +71,11 @@ int hci_send_cmd(const hci_cmd_t *cmd, ...){
 
 void hci_halting_defer(void){
 }
+
+uint32_t btstack_run_loop_get_time_ms(void){
+	return time_ms;
+}
+
+void mock_advance_time_ms(uint32_t delta_ms){
+	time_ms += delta_ms;
+}
@@ -25,6 +25,7 @@
 #define ENABLE_LE_CENTRAL
 #define ENABLE_LE_PERIPHERAL
 #define ENABLE_LE_SIGNED_WRITE
+#define ENABLE_GATT_CLIENT_DISCOVERY_CACHE
 #define ENABLE_SDP_EXTRA_QUERIES
 
 // BTstack configuration. buffers, sizes, ...
@@ -19,11 +19,30 @@
 #include "btstack_memory.h"
 #include "hci.h"
 #include "hci_dump.h"
+#include "btstack_event.h"
+#include "btstack_run_loop.h"
+#include "btstack_tlv.h"
+#include "btstack_tlv_flash_bank.h"
+#include "hal_flash_bank_memory.h"
 #include "ble/gatt_client.h"
 #include "ble/att_db.h"
 #include "profile.h"
 #include "expected_results.h"
 
+void mock_set_acl_credits(int credits);
+int mock_get_acl_credits(void);
+uint16_t mock_get_write_commands_sent(void);
+uint32_t mock_get_write_command_bytes(void);
+void mock_set_time_ms(uint32_t time_ms);
+void mock_simulate_number_of_completed_packets(int num_packets);
+uint32_t mock_get_num_packets_sent(void);
+void mock_set_round_trip_time_ms(uint32_t round_trip_time_ms);
+void mock_set_le_device_index(int le_device_index);
+void mock_set_database_hash(const uint8_t * database_hash);
+void mock_simulate_disconnected(void);
+void mock_simulate_service_changed(uint16_t value_handle);
+void mock_run_timers(void);
+
 static uint16_t gatt_client_handle = 0x40;
 static int gatt_query_complete = 0;
 
@@ -298,6 +317,7 @@ TEST_GROUP(GATTClient){
 		result_counter = 0;
 		result_index = 0;
 		test = IDLE;
+		mock_set_acl_credits(-1);
 	}
 
 	void reset_query_state(void){
@@ -699,8 +719,397 @@ TEST(GATTClient, TestWriteReliableLongCharacteristicValue){
 	CHECK_EQUAL(gatt_query_complete, 1);
 }
 
+static const uint16_t stream_value_handle = 0x0012;
+static int      stream_complete;
+static uint8_t  stream_status;
+static uint32_t stream_num_bytes;
+static uint32_t stream_duration_ms;
+static uint16_t stream_chunks_pulled;
+
+static void handle_stream_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+	if (packet_type != HCI_EVENT_PACKET) return;
+	if (hci_event_packet_get_type(packet) != GATT_EVENT_WRITE_WITHOUT_RESPONSE_STREAM_COMPLETE) return;
+	CHECK_EQUAL(gatt_client_handle, gatt_event_write_without_response_stream_complete_get_handle(packet));
+	CHECK_EQUAL(stream_value_handle, gatt_event_write_without_response_stream_complete_get_value_handle(packet));
+	stream_complete++;
+	stream_status = gatt_event_write_without_response_stream_complete_get_status(packet);
+	stream_num_bytes = gatt_event_write_without_response_stream_complete_get_num_bytes(packet);
+	stream_duration_ms = gatt_event_write_without_response_stream_complete_get_duration_ms(packet);
+}
+
+static uint16_t stream_pull(hci_con_handle_t con_handle, uint8_t * buffer, uint16_t buffer_size){
+	if (stream_chunks_pulled == 5) return 0;
+	stream_chunks_pulled++;
+	memset(buffer, stream_chunks_pulled, 7);
+	return 7;
+}
+
+TEST(GATTClient, TestWriteWithoutResponseStream){
+	static uint8_t data[1000];
+	stream_complete = 0;
+	mock_set_time_ms(1000);
+	mock_set_acl_credits(4);
+
+	status = gatt_client_write_without_response_stream(&handle_stream_event, gatt_client_handle, stream_value_handle, data, sizeof(data));
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	// all ACL buffers filled right away
+	CHECK_EQUAL(4, mock_get_write_commands_sent());
+	CHECK_EQUAL(0, mock_get_acl_credits());
+
+	status = gatt_client_write_without_response_stream(&handle_stream_event, gatt_client_handle, stream_value_handle, data, sizeof(data));
+	CHECK_EQUAL(GATT_CLIENT_IN_WRONG_STATE, status);
+
+	// every completed packet is replaced immediately
+	uint32_t time_ms = 1000;
+	while (stream_complete == 0){
+		time_ms += 10;
+		mock_set_time_ms(time_ms);
+		uint16_t num_sent = mock_get_write_commands_sent();
+		mock_simulate_number_of_completed_packets(1);
+		CHECK_EQUAL(num_sent + 1, mock_get_write_commands_sent());
+		CHECK_EQUAL(0, mock_get_acl_credits());
+	}
+
+	// 20 byte chunks with default ATT MTU
+	CHECK_EQUAL(50, mock_get_write_commands_sent());
+	CHECK_EQUAL(sizeof(data), mock_get_write_command_bytes());
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, stream_status);
+	CHECK_EQUAL(sizeof(data), stream_num_bytes);
+	CHECK_EQUAL(time_ms - 1000, stream_duration_ms);
+
+	// no further packets once complete
+	mock_simulate_number_of_completed_packets(4);
+	CHECK_EQUAL(50, mock_get_write_commands_sent());
+	CHECK_EQUAL(1, stream_complete);
+}
+
+TEST(GATTClient, TestWriteWithoutResponseStreamWithCallback){
+	stream_complete = 0;
+	stream_chunks_pulled = 0;
+	mock_set_acl_credits(2);
+
+	status = gatt_client_write_without_response_stream_with_callback(&handle_stream_event, gatt_client_handle, stream_value_handle, &stream_pull);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	CHECK_EQUAL(2, mock_get_write_commands_sent());
+
+	while (stream_complete == 0){
+		mock_simulate_number_of_completed_packets(1);
+	}
+	CHECK_EQUAL(5, mock_get_write_commands_sent());
+	CHECK_EQUAL(35, mock_get_write_command_bytes());
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, stream_status);
+	CHECK_EQUAL(35, stream_num_bytes);
+
+	// new stream can be started after completion
+	stream_chunks_pulled = 5;
+	status = gatt_client_write_without_response_stream_with_callback(&handle_stream_event, gatt_client_handle, stream_value_handle, &stream_pull);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	mock_simulate_number_of_completed_packets(1);
+	CHECK_EQUAL(2, stream_complete);
+	CHECK_EQUAL(0, stream_num_bytes);
+}
+
+// reconnect, find characteristic and read it, returns elapsed time
+static uint32_t discovery_cache_connect_and_read(void){
+	uint32_t start_ms = btstack_run_loop_get_time_ms();
+	test = READ_CHARACTERISTIC_VALUE;
+	gatt_query_complete = 0;
+	result_counter = 0;
+	result_index = 0;
+	uint8_t status = gatt_client_discover_primary_services_by_uuid16(handle_ble_client_event, gatt_client_handle, service_uuid16);
+	CHECK_EQUAL(0, status);
+	mock_run_timers();
+	CHECK_EQUAL(1, gatt_query_complete);
+	CHECK_EQUAL(1, result_counter);
+
+	gatt_query_complete = 0;
+	result_counter = 0;
+	result_index = 0;
+	status = gatt_client_discover_characteristics_for_service_by_uuid16(handle_ble_client_event, gatt_client_handle, &services[0], 0xF100);
+	CHECK_EQUAL(0, status);
+	mock_run_timers();
+	CHECK_EQUAL(1, gatt_query_complete);
+	CHECK_EQUAL(1, result_counter);
+
+	gatt_query_complete = 0;
+	result_counter = 0;
+	status = gatt_client_read_value_of_characteristic(handle_ble_client_event, gatt_client_handle, &characteristics[0]);
+	CHECK_EQUAL(0, status);
+	mock_run_timers();
+	CHECK_EQUAL(1, gatt_query_complete);
+	CHECK_EQUAL(3, result_counter);
+	return btstack_run_loop_get_time_ms() - start_ms;
+}
+
+// discover all services, characteristics and descriptors, returns number of reported attributes
+static int discovery_cache_discover_all(void){
+	test = IDLE;
+	gatt_query_complete = 0;
+	result_index = 0;
+	uint8_t status = gatt_client_discover_primary_services(handle_ble_client_event, gatt_client_handle);
+	CHECK_EQUAL(0, status);
+	mock_run_timers();
+	CHECK_EQUAL(1, gatt_query_complete);
+	int num_services = result_index;
+	int num_attributes = num_services;
+	for (int i = 0; i < num_services; i++){
+		gatt_query_complete = 0;
+		result_index = 0;
+		status = gatt_client_discover_characteristics_for_service(handle_ble_client_event, gatt_client_handle, &services[i]);
+		CHECK_EQUAL(0, status);
+		mock_run_timers();
+		CHECK_EQUAL(1, gatt_query_complete);
+		int num_characteristics = result_index;
+		num_attributes += num_characteristics;
+		gatt_client_characteristic_t service_characteristics[50];
+		memcpy(service_characteristics, characteristics, sizeof(characteristics));
+		for (int j = 0; j < num_characteristics; j++){
+			gatt_query_complete = 0;
+			result_index = 0;
+			status = gatt_client_discover_characteristic_descriptors(handle_ble_client_event, gatt_client_handle, &service_characteristics[j]);
+			CHECK_EQUAL(0, status);
+			mock_run_timers();
+			CHECK_EQUAL(1, gatt_query_complete);
+			num_attributes += result_index;
+		}
+	}
+	return num_attributes;
+}
+
+TEST(GATTClient, TestDiscoveryCache){
+	static const uint8_t database_hash[16]         = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10 };
+	static const uint8_t database_hash_changed[16] = { 0x11, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10 };
+
+	// bonded device, each request takes one connection interval
+	mock_simulate_disconnected();
+	mock_set_round_trip_time_ms(30);
+	mock_set_le_device_index(0);
+	mock_set_database_hash(database_hash);
+
+	// first connection: discovery over the air
+	uint32_t num_packets = mock_get_num_packets_sent();
+	uint32_t uncached_ms = discovery_cache_connect_and_read();
+	uint32_t uncached_round_trips = mock_get_num_packets_sent() - num_packets;
+	num_packets = mock_get_num_packets_sent();
+	int num_attributes = discovery_cache_discover_all();
+	uint32_t discover_all_round_trips = mock_get_num_packets_sent() - num_packets;
+	mock_simulate_disconnected();
+
+	// reconnect: only Database Hash and value are read
+	num_packets = mock_get_num_packets_sent();
+	uint32_t cached_ms = discovery_cache_connect_and_read();
+	CHECK_EQUAL(2, mock_get_num_packets_sent() - num_packets);
+	CHECK(cached_ms < uncached_ms);
+	num_packets = mock_get_num_packets_sent();
+	CHECK_EQUAL(num_attributes, discovery_cache_discover_all());
+	CHECK_EQUAL(0, mock_get_num_packets_sent() - num_packets);
+
+	// cached responses are delivered from the run loop, not before the API call returns
+	gatt_query_complete = 0;
+	result_index = 0;
+	uint8_t status = gatt_client_discover_primary_services(handle_ble_client_event, gatt_client_handle);
+	CHECK_EQUAL(0, status);
+	CHECK_EQUAL(0, gatt_query_complete);
+	CHECK_EQUAL(0, result_index);
+	mock_run_timers();
+	CHECK_EQUAL(1, gatt_query_complete);
+	CHECK(result_index > 0);
+	mock_simulate_disconnected();
+
+	printf("GATT Client Discovery Cache: reconnect to first read %u ms (%u requests) uncached, %u ms cached, full discovery %u requests uncached\n",
+		   (unsigned int) uncached_ms, (unsigned int) uncached_round_trips, (unsigned int) cached_ms, (unsigned int) discover_all_round_trips);
+
+	// Service Changed indication invalidates cache during connection
+	discovery_cache_connect_and_read();
+	mock_simulate_service_changed(ATT_CHARACTERISTIC_GATT_SERVICE_CHANGED_01_VALUE_HANDLE);
+	num_packets = mock_get_num_packets_sent();
+	discovery_cache_connect_and_read();
+	CHECK_EQUAL(uncached_round_trips, mock_get_num_packets_sent() - num_packets);
+	mock_simulate_disconnected();
+	num_packets = mock_get_num_packets_sent();
+	discovery_cache_connect_and_read();
+	CHECK_EQUAL(2, mock_get_num_packets_sent() - num_packets);
+	mock_simulate_disconnected();
+
+	// changed Database Hash invalidates cache
+	mock_set_database_hash(database_hash_changed);
+	num_packets = mock_get_num_packets_sent();
+	discovery_cache_connect_and_read();
+	CHECK_EQUAL(uncached_round_trips, mock_get_num_packets_sent() - num_packets);
+	mock_simulate_disconnected();
+
+	// no Database Hash: cache not used
+	mock_set_database_hash(NULL);
+	num_packets = mock_get_num_packets_sent();
+	discovery_cache_connect_and_read();
+	CHECK_EQUAL(uncached_round_trips, mock_get_num_packets_sent() - num_packets);
+	mock_simulate_disconnected();
+
+	mock_set_le_device_index(-1);
+	mock_set_round_trip_time_ms(0);
+}
+
+static int      queued_num_values;
+static int      queued_num_complete;
+static int      queued_num_errors;
+static uint16_t queued_value_handles[10];
+
+static void handle_queued_read_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+	if (packet_type != HCI_EVENT_PACKET) return;
+	switch (hci_event_packet_get_type(packet)){
+		case GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT:
+			CHECK_EQUAL(short_value_length, gatt_event_characteristic_value_query_result_get_value_length(packet));
+			CHECK_EQUAL_ARRAY((uint8_t*)short_value, (uint8_t *) gatt_event_characteristic_value_query_result_get_value(packet), short_value_length);
+			queued_value_handles[queued_num_values++] = gatt_event_characteristic_value_query_result_get_value_handle(packet);
+			break;
+		case GATT_EVENT_QUERY_COMPLETE:
+			if (gatt_event_query_complete_get_att_status(packet) != ATT_ERROR_SUCCESS){
+				queued_num_errors++;
+			}
+			queued_num_complete++;
+			break;
+		default:
+			break;
+	}
+}
+
+static void queued_discover_primary_services(void * context){
+	uint8_t status = gatt_client_discover_primary_services(handle_ble_client_event, gatt_client_handle);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+}
+
+// let controller send queued requests one by one
+static void queued_run_until_complete(int num_complete){
+	for (int i = 0; (i < 100) && (queued_num_complete < num_complete); i++){
+		mock_simulate_number_of_completed_packets(1);
+	}
+	CHECK_EQUAL(num_complete, queued_num_complete);
+}
+
+TEST(GATTClient, TestQueuedReads){
+	static const uint16_t value_handles[] = {
+		ATT_CHARACTERISTIC_F100_01_VALUE_HANDLE, ATT_CHARACTERISTIC_F10B_01_VALUE_HANDLE,
+		ATT_CHARACTERISTIC_F10D_01_VALUE_HANDLE, ATT_CHARACTERISTIC_F10C_01_VALUE_HANDLE
+	};
+	gatt_client_read_request_t requests[5];
+	btstack_context_callback_registration_t discovery_request;
+
+	mock_simulate_disconnected();
+	test = READ_CHARACTERISTIC_VALUE;
+	queued_num_values = 0;
+	queued_num_complete = 0;
+	queued_num_errors = 0;
+	mock_set_acl_credits(0);
+
+	// first read is started right away, following reads are combined into Read Multiple
+	uint32_t num_packets = mock_get_num_packets_sent();
+	for (int i = 0; i < 4; i++){
+		status = gatt_client_queue_read_value_of_characteristic(&requests[i], &handle_queued_read_event, gatt_client_handle, value_handles[i], short_value_length);
+		CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	}
+	status = gatt_client_request_to_send_gatt_query(&requests[3].registration, gatt_client_handle);
+	CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, status);
+	queued_run_until_complete(4);
+	CHECK_EQUAL(2, mock_get_num_packets_sent() - num_packets);
+	CHECK_EQUAL(4, queued_num_values);
+	for (int i = 0; i < 4; i++){
+		CHECK_EQUAL(value_handles[i], queued_value_handles[i]);
+	}
+
+	// queries are executed in order, reads with unknown length are not combined
+	queued_num_values = 0;
+	queued_num_complete = 0;
+	result_index = 0;
+	gatt_query_complete = 0;
+	status = gatt_client_queue_read_value_of_characteristic(&requests[0], &handle_queued_read_event, gatt_client_handle, value_handles[0], short_value_length);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	discovery_request.callback = &queued_discover_primary_services;
+	status = gatt_client_request_to_send_gatt_query(&discovery_request, gatt_client_handle);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	status = gatt_client_queue_read_value_of_characteristic(&requests[1], &handle_queued_read_event, gatt_client_handle, value_handles[1], 0);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	status = gatt_client_queue_read_value_of_characteristic(&requests[2], &handle_queued_read_event, gatt_client_handle, value_handles[2], 0);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	queued_run_until_complete(3);
+	CHECK_EQUAL(1, gatt_query_complete);
+	verify_primary_services();
+	CHECK_EQUAL(3, queued_num_values);
+
+	// error for one handle: reads are repeated individually, only that read fails
+	queued_num_values = 0;
+	queued_num_complete = 0;
+	num_packets = mock_get_num_packets_sent();
+	status = gatt_client_queue_read_value_of_characteristic(&requests[0], &handle_queued_read_event, gatt_client_handle, value_handles[0], short_value_length);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	status = gatt_client_queue_read_value_of_characteristic(&requests[1], &handle_queued_read_event, gatt_client_handle, value_handles[1], short_value_length);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	status = gatt_client_queue_read_value_of_characteristic(&requests[2], &handle_queued_read_event, gatt_client_handle, 0xfff0, short_value_length);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	status = gatt_client_queue_read_value_of_characteristic(&requests[3], &handle_queued_read_event, gatt_client_handle, value_handles[3], short_value_length);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	queued_run_until_complete(4);
+	CHECK_EQUAL(3, queued_num_values);
+	CHECK_EQUAL(1, queued_num_errors);
+	CHECK_EQUAL(5, mock_get_num_packets_sent() - num_packets);
+
+	// Read Multiple is still used afterwards
+	queued_num_values = 0;
+	queued_num_complete = 0;
+	queued_num_errors = 0;
+	num_packets = mock_get_num_packets_sent();
+	for (int i = 0; i < 4; i++){
+		status = gatt_client_queue_read_value_of_characteristic(&requests[i], &handle_queued_read_event, gatt_client_handle, value_handles[i], short_value_length);
+		CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	}
+	queued_run_until_complete(4);
+	CHECK_EQUAL(4, queued_num_values);
+	CHECK_EQUAL(2, mock_get_num_packets_sent() - num_packets);
+
+	// unexpected response size: reads are repeated individually
+	queued_num_values = 0;
+	queued_num_complete = 0;
+	num_packets = mock_get_num_packets_sent();
+	for (int i = 0; i < 4; i++){
+		status = gatt_client_queue_read_value_of_characteristic(&requests[i], &handle_queued_read_event, gatt_client_handle, value_handles[i], short_value_length - 1);
+		CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	}
+	queued_run_until_complete(4);
+	CHECK_EQUAL(4, queued_num_values);
+	for (int i = 0; i < 4; i++){
+		CHECK_EQUAL(value_handles[i], queued_value_handles[i]);
+	}
+	CHECK_EQUAL(5, mock_get_num_packets_sent() - num_packets);
+	CHECK_EQUAL(0, queued_num_errors);
+
+	// disconnect: ongoing and queued reads complete with error, other queued queries are dropped
+	queued_num_values = 0;
+	queued_num_complete = 0;
+	gatt_query_complete = 0;
+	for (int i = 0; i < 4; i++){
+		status = gatt_client_queue_read_value_of_characteristic(&requests[i], &handle_queued_read_event, gatt_client_handle, value_handles[i], short_value_length);
+		CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	}
+	status = gatt_client_request_to_send_gatt_query(&discovery_request, gatt_client_handle);
+	CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+	CHECK_EQUAL(0, queued_num_complete);
+	mock_simulate_disconnected();
+	CHECK_EQUAL(4, queued_num_complete);
+	CHECK_EQUAL(4, queued_num_errors);
+	CHECK_EQUAL(0, queued_num_values);
+	CHECK_EQUAL(0, gatt_query_complete);
+	mock_set_acl_credits(-1);
+}
+
+#define HAL_FLASH_BANK_MEMORY_STORAGE_SIZE 8192
+static uint8_t hal_flash_bank_memory_storage[HAL_FLASH_BANK_MEMORY_STORAGE_SIZE];
+static hal_flash_bank_memory_t  hal_flash_bank_context;
+static btstack_tlv_flash_bank_t btstack_tlv_context;
 
 int main (int argc, const char * argv[]){
+	const hal_flash_bank_t * hal_flash_bank_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, hal_flash_bank_memory_storage, HAL_FLASH_BANK_MEMORY_STORAGE_SIZE);
+	const btstack_tlv_t * btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	btstack_tlv_set_instance(btstack_tlv_impl, &btstack_tlv_context);
+
 	att_set_db(profile_data);
 	att_set_write_callback(&att_write_callback);
 	att_set_read_callback(&att_read_callback);
@@ -23,6 +23,20 @@ static uint8_t  l2cap_stack_buffer[PREBUFFER_SIZE + max_mtu];	// pre buffer + HC
 static uint16_t gatt_client_handle = 0x40;
 static hci_connection_t hci_connection;
 
+// LE ACL flow control: number of free controller buffers, negative for unlimited
+static int      mock_acl_credits = -1;
+static bool     mock_can_send_now_requested;
+static uint32_t mock_time_ms;
+static uint16_t mock_write_commands_sent;
+static uint32_t mock_write_command_bytes;
+static uint32_t mock_num_packets_sent;
+static uint32_t mock_round_trip_time_ms;
+static btstack_linked_list_t mock_timers;
+
+// remote device
+static int             mock_le_device_index = -1;
+static const uint8_t * mock_database_hash;
+
 uint16_t get_gatt_client_handle(void){
 	return gatt_client_handle;
 }
@@ -46,6 +60,76 @@ void mock_simulate_scan_response(void){
 	uint8_t packet[] = {0xE2, 0x13, 0xE2, 0x01, 0x34, 0xB1, 0xF7, 0xD1, 0x77, 0x9B, 0xCC, 0x09, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
 }
+void mock_set_acl_credits(int credits){
+	mock_acl_credits = credits;
+	mock_can_send_now_requested = false;
+	mock_write_commands_sent = 0;
+	mock_write_command_bytes = 0;
+}
+
+int mock_get_acl_credits(void){
+	return mock_acl_credits;
+}
+
+uint16_t mock_get_write_commands_sent(void){
+	return mock_write_commands_sent;
+}
+
+uint32_t mock_get_write_command_bytes(void){
+	return mock_write_command_bytes;
+}
+
+void mock_set_time_ms(uint32_t time_ms){
+	mock_time_ms = time_ms;
+}
+
+uint32_t mock_get_num_packets_sent(void){
+	return mock_num_packets_sent;
+}
+
+void mock_set_round_trip_time_ms(uint32_t round_trip_time_ms){
+	mock_round_trip_time_ms = round_trip_time_ms;
+}
+
+void mock_set_le_device_index(int le_device_index){
+	mock_le_device_index = le_device_index;
+}
+
+// Database Hash reported by remote, NULL if not supported
+void mock_set_database_hash(const uint8_t * database_hash){
+	mock_database_hash = database_hash;
+}
+
+void mock_simulate_disconnected(void){
+	uint8_t packet[] = {HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, (uint8_t) (gatt_client_handle & 0xff), (uint8_t) (gatt_client_handle >> 8), 0x13};
+	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
+}
+
+// remote indicates Service Changed for the full handle range
+void mock_simulate_service_changed(uint16_t value_handle){
+	// events are created in place, provide pre buffer
+	uint8_t packet_buffer[PREBUFFER_SIZE + 7];
+	uint8_t * packet = &packet_buffer[PREBUFFER_SIZE];
+	packet[0] = ATT_HANDLE_VALUE_INDICATION;
+	little_endian_store_16(packet, 1, value_handle);
+	little_endian_store_16(packet, 3, 0x0001);
+	little_endian_store_16(packet, 5, 0xffff);
+	att_packet_handler(ATT_DATA_PACKET, gatt_client_handle, packet, 7);
+}
+
+static void mock_emit_can_send_now(void){
+	uint8_t event[] = { L2CAP_EVENT_CAN_SEND_NOW, 2, 1, 0};
+	att_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
+}
+
+// controller reports completed packets, emit pending can send now
+void mock_simulate_number_of_completed_packets(int num_packets){
+	mock_acl_credits += num_packets;
+	if (!mock_can_send_now_requested) return;
+	mock_can_send_now_requested = false;
+	mock_emit_can_send_now();
+}
+
 int gap_authenticated(hci_con_handle_t con_handle){
 	UNUSED(con_handle);
 	return false;
@@ -81,7 +165,7 @@ static void att_init_connection(att_connection_t * att_connection){
 }
 
 int hci_can_send_acl_le_packet_now(void){
-	return 1;
+	return mock_acl_credits != 0;
 }
 
 int  l2cap_can_send_connectionless_packet_now(void){
@@ -116,21 +200,46 @@ int l2cap_reserve_packet_buffer(void){
 	return 1;
 }
 
+void l2cap_release_packet_buffer(void){
+}
+
 int l2cap_can_send_fixed_channel_packet_now(uint16_t handle, uint16_t channel_id){
-	return 1;
+	return mock_acl_credits != 0;
 }
 
 void l2cap_request_can_send_fix_channel_now_event(uint16_t handle, uint16_t channel_id){
-	uint8_t event[] = { L2CAP_EVENT_CAN_SEND_NOW, 2, 1, 0};
-	att_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
+	if (mock_acl_credits == 0){
+		mock_can_send_now_requested = true;
+		return;
+	}
+	mock_emit_can_send_now();
 }
 
 int l2cap_send_prepared_connectionless(uint16_t handle, uint16_t cid, uint16_t len){
+	if (mock_acl_credits > 0){
+		mock_acl_credits--;
+	}
+	uint8_t * request = l2cap_get_outgoing_buffer();
+	mock_num_packets_sent++;
+	mock_time_ms += mock_round_trip_time_ms;
+	if (request[0] == ATT_WRITE_COMMAND){
+		mock_write_commands_sent++;
+		mock_write_command_bytes += len - 3u;
+	}
 	att_connection_t att_connection;
 	att_init_connection(&att_connection);
 	uint8_t response_buffer[PREBUFFER_SIZE + max_mtu];
 	uint8_t * response = &response_buffer[PREBUFFER_SIZE];
-	uint16_t response_len = att_handle_request(&att_connection, l2cap_get_outgoing_buffer(), len, response);
+	uint16_t response_len;
+	if ((mock_database_hash != NULL) && (request[0] == ATT_READ_BY_TYPE_REQUEST) && (little_endian_read_16(request, 5) == GATT_DATABASE_HASH_UUID)){
+		response[0] = ATT_READ_BY_TYPE_RESPONSE;
+		response[1] = 18;
+		little_endian_store_16(response, 2, 0x00ff);
+		memcpy(&response[4], mock_database_hash, 16);
+		response_len = 20;
+	} else {
+		response_len = att_handle_request(&att_connection, request, len, response);
+	}
 	if (response_len){
 		att_packet_handler(ATT_DATA_PACKET, gatt_client_handle, &response[0], response_len);
 	}
@@ -147,7 +256,7 @@ void sm_cmac_signed_write_start(const sm_key_t key, uint8_t opcode, uint16_t att
 	//sm_notify_client(SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED, sm_central_device_addr_type, sm_central_device_address, 0, sm_central_device_matched);      
 }
 int sm_le_device_index(uint16_t handle ){
-	return -1;
+	return mock_le_device_index;
 }
 void sm_send_security_request(hci_con_handle_t con_handle){
 }
@@ -155,19 +264,44 @@ void sm_send_security_request(hci_con_handle_t con_handle){
 irk_lookup_state_t sm_identity_resolving_state(hci_con_handle_t con_handle){
 	return IRK_LOOKUP_SUCCEEDED;
 }
+uint32_t btstack_run_loop_get_time_ms(void){
+	return mock_time_ms;
+}
+
 void btstack_run_loop_set_timer(btstack_timer_source_t *a, uint32_t timeout_in_ms){
+	a->timeout = mock_time_ms + timeout_in_ms;
 }
 
 // Set callback that will be executed when timer expires.
 void btstack_run_loop_set_timer_handler(btstack_timer_source_t *ts, void (*process)(btstack_timer_source_t *_ts)){
+	ts->process = process;
 }
 
 // Add/Remove timer source.
 void btstack_run_loop_add_timer(btstack_timer_source_t *timer){
+	btstack_linked_list_remove(&mock_timers, (btstack_linked_item_t *) timer);
+	btstack_linked_list_add_tail(&mock_timers, (btstack_linked_item_t *) timer);
 }
 
 int  btstack_run_loop_remove_timer(btstack_timer_source_t *timer){
-	return 1;
+	return btstack_linked_list_remove(&mock_timers, (btstack_linked_item_t *) timer) ? 1 : 0;
+}
+
+// execute expired timers, time is not advanced
+void mock_run_timers(void){
+	bool expired = true;
+	while (expired){
+		expired = false;
+		btstack_linked_item_t * it;
+		for (it = mock_timers; it != NULL; it = it->next){
+			btstack_timer_source_t * timer = (btstack_timer_source_t *) it;
+			if ((int32_t)(timer->timeout - mock_time_ms) > 0) continue;
+			btstack_linked_list_remove(&mock_timers, it);
+			timer->process(timer);
+			expired = true;
+			break;
+		}
+	}
 }
 
 // todo:
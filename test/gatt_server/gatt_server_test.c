@@ -18,6 +18,7 @@
 #include "ble/att_db.h"
 #include "ble/att_db_util.h"
 #include "ble/att_server.h"
+#include "btstack_event.h"
 #include "btstack_util.h"
 #include "bluetooth.h"
 
@@ -28,17 +29,39 @@ static const uint8_t uuid128_with_bluetooth_base[] = { 0x00, 0x00, 0xBB, 0xBB, 0
 static const uint8_t uuid128_no_bluetooth_base[] =   { 0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0xAA, 0xAA, 0x00, 0x00 };
 
 void l2cap_can_send_fixed_channel_packet_now_set_status(uint8_t status);
+uint16_t mock_l2cap_num_packets_sent(void);
+void mock_l2cap_send_prepared_connectionless_fail(uint16_t num_errors);
+uint16_t mock_l2cap_send_prepared_connectionless_errors_pending(void);
+int hci_is_packet_buffer_reserved(void);
+void mock_add_le_connection(hci_connection_t * connection);
+void mock_remove_le_connections(void);
+void mock_simulate_hci_event(uint8_t * packet, uint16_t size);
+
+#define NUM_LE_CONNECTIONS 20
+
+static hci_connection_t le_connections[NUM_LE_CONNECTIONS];
+static uint16_t notify_ccc_handle;
+static uint8_t  notify_all_complete_event[14];
 
 static uint16_t att_read_callback(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t offset, uint8_t * buffer, uint16_t buffer_size){
-    UNUSED(connection_handle);
-    UNUSED(att_handle);
     UNUSED(offset);
-    UNUSED(buffer);
-    UNUSED(buffer_size);
 
+    // notifications enabled for odd connection handles
+    if ((notify_ccc_handle != 0) && (att_handle == notify_ccc_handle)){
+        uint16_t ccc_value = ((connection_handle & 1) != 0) ? GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION : 0;
+        return att_read_callback_handle_little_endian_16(ccc_value, offset, buffer, buffer_size);
+    }
     return 0;
 }
 
+static void att_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != ATT_EVENT_NOTIFY_ALL_COMPLETE) return;
+    CHECK_EQUAL(sizeof(notify_all_complete_event), size);
+    memcpy(notify_all_complete_event, packet, size);
+}
+
 static int att_write_callback(hci_con_handle_t connection_handle, uint16_t att_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size){
     UNUSED(connection_handle);
     UNUSED(att_handle);
@@ -84,6 +107,23 @@ TEST_GROUP(ATT_SERVER){
 
         // setup ATT server
         att_server_init(att_db_util_get_address(), att_read_callback, att_write_callback);
+        att_server_register_packet_handler(&att_packet_handler);
+
+        notify_ccc_handle = 0;
+        memset(notify_all_complete_event, 0, sizeof(notify_all_complete_event));
+        memset(le_connections, 0, sizeof(le_connections));
+        mock_remove_le_connections();
+        int i;
+        for (i = 0; i < NUM_LE_CONNECTIONS; i++){
+            le_connections[i].con_handle = 0x80 + i;
+            le_connections[i].address_type = BD_ADDR_TYPE_LE_RANDOM;
+            le_connections[i].att_connection.con_handle = 0x80 + i;
+            le_connections[i].att_connection.mtu = ATT_DEFAULT_MTU;
+            mock_add_le_connection(&le_connections[i]);
+        }
+    }
+    void teardown(void){
+        mock_remove_le_connections();
     }
 };
 
@@ -168,6 +208,99 @@ TEST(ATT_SERVER, att_server_notify){
     CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
 }
 
+TEST(ATT_SERVER, att_server_notify_all){
+    static uint8_t value[30];
+    uint16_t value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BODY_SENSOR_LOCATION);
+    notify_ccc_handle = gatt_server_get_client_configuration_handle_for_value_handle(value_handle);
+    CHECK_EQUAL(value_handle + 1, notify_ccc_handle);
+    uint8_t status;
+
+    // characteristic without Client Characteristic Configuration
+    uint16_t no_ccc_value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BLOOD_PRESSURE_MEASUREMENT);
+    CHECK_EQUAL(0, gatt_server_get_client_configuration_handle_for_value_handle(no_ccc_value_handle));
+    status = att_server_notify_all(no_ccc_value_handle, value, sizeof(value));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, status);
+
+    // all connections can send, value truncated to ATT_MTU - 3
+    uint16_t num_packets_sent = mock_l2cap_num_packets_sent();
+    status = att_server_notify_all(value_handle, value, sizeof(value));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(NUM_LE_CONNECTIONS / 2, mock_l2cap_num_packets_sent() - num_packets_sent);
+    CHECK_EQUAL(ATT_EVENT_NOTIFY_ALL_COMPLETE, notify_all_complete_event[0]);
+    CHECK_EQUAL(value_handle, little_endian_read_16(notify_all_complete_event, 2));
+    CHECK_EQUAL(NUM_LE_CONNECTIONS / 2, little_endian_read_16(notify_all_complete_event, 4));
+    CHECK_EQUAL((NUM_LE_CONNECTIONS / 2) * (ATT_DEFAULT_MTU - 3), little_endian_read_32(notify_all_complete_event, 6));
+}
+
+TEST(ATT_SERVER, att_server_notify_all_flow_control){
+    static uint8_t value[] = {0x55, 0x66};
+    uint16_t value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BODY_SENSOR_LOCATION);
+    notify_ccc_handle = gatt_server_get_client_configuration_handle_for_value_handle(value_handle);
+    uint8_t status;
+
+    // L2CAP cannot send, all connections pending
+    uint16_t num_packets_sent = mock_l2cap_num_packets_sent();
+    l2cap_can_send_fixed_channel_packet_now_set_status(0);
+    status = att_server_notify_all(value_handle, value, sizeof(value));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(0, mock_l2cap_num_packets_sent() - num_packets_sent);
+    CHECK_EQUAL(0, notify_all_complete_event[0]);
+
+    // already in progress
+    status = att_server_notify_all(value_handle, value, sizeof(value));
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, status);
+
+    // pending connection disconnects
+    uint8_t disconnect_event[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, 0x81, 0x00, 0x13};
+    mock_simulate_hci_event(disconnect_event, sizeof(disconnect_event));
+    CHECK_EQUAL(0, notify_all_complete_event[0]);
+
+    // send when possible
+    l2cap_can_send_fixed_channel_packet_now_set_status(1);
+    CHECK_EQUAL((NUM_LE_CONNECTIONS / 2) - 1, mock_l2cap_num_packets_sent() - num_packets_sent);
+    CHECK_EQUAL(ATT_EVENT_NOTIFY_ALL_COMPLETE, notify_all_complete_event[0]);
+    CHECK_EQUAL((NUM_LE_CONNECTIONS / 2) - 1, little_endian_read_16(notify_all_complete_event, 4));
+    CHECK_EQUAL(((NUM_LE_CONNECTIONS / 2) - 1) * sizeof(value), little_endian_read_32(notify_all_complete_event, 6));
+
+    // next fan-out possible
+    status = att_server_notify_all(value_handle, value, sizeof(value));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+}
+
+TEST(ATT_SERVER, att_server_notify_all_send_error){
+    static uint8_t value[] = {0x55, 0x66};
+    uint16_t value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BODY_SENSOR_LOCATION);
+    notify_ccc_handle = gatt_server_get_client_configuration_handle_for_value_handle(value_handle);
+
+    // first notification cannot be sent, connection stays pending and is notified on can send now
+    mock_l2cap_send_prepared_connectionless_fail(1);
+    uint16_t num_packets_sent = mock_l2cap_num_packets_sent();
+    uint8_t status = att_server_notify_all(value_handle, value, sizeof(value));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(0, hci_is_packet_buffer_reserved());
+    CHECK_EQUAL(NUM_LE_CONNECTIONS / 2, mock_l2cap_num_packets_sent() - num_packets_sent);
+    CHECK_EQUAL(ATT_EVENT_NOTIFY_ALL_COMPLETE, notify_all_complete_event[0]);
+    CHECK_EQUAL(NUM_LE_CONNECTIONS / 2, little_endian_read_16(notify_all_complete_event, 4));
+}
+
+TEST(ATT_SERVER, att_server_notify_all_send_error_persistent){
+    static uint8_t value[] = {0x55, 0x66};
+    uint16_t value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BODY_SENSOR_LOCATION);
+    notify_ccc_handle = gatt_server_get_client_configuration_handle_for_value_handle(value_handle);
+
+    // sending fails although ACL buffers are available: each connection is retried once on can send now
+    mock_l2cap_send_prepared_connectionless_fail(100);
+    uint16_t num_packets_sent = mock_l2cap_num_packets_sent();
+    uint8_t status = att_server_notify_all(value_handle, value, sizeof(value));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(100 - NUM_LE_CONNECTIONS, mock_l2cap_send_prepared_connectionless_errors_pending());
+    mock_l2cap_send_prepared_connectionless_fail(0);
+    CHECK_EQUAL(0, hci_is_packet_buffer_reserved());
+    CHECK_EQUAL(0, mock_l2cap_num_packets_sent() - num_packets_sent);
+    CHECK_EQUAL(ATT_EVENT_NOTIFY_ALL_COMPLETE, notify_all_complete_event[0]);
+    CHECK_EQUAL(0, little_endian_read_16(notify_all_complete_event, 4));
+}
+
 TEST(ATT_SERVER, att_server_get_mtu){
     // invalid conneciton handle
     uint8_t mtu = att_server_get_mtu(0x50);
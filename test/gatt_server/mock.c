@@ -41,6 +41,10 @@ void mock_simulate_connected(void){
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
 }
 
+void mock_simulate_hci_event(uint8_t * packet, uint16_t size){
+	registered_hci_event_handler(HCI_EVENT_PACKET, 0, packet, size);
+}
+
 void mock_simulate_scan_response(void){
 	uint8_t packet[] = {0xE2, 0x13, 0xE2, 0x01, 0x34, 0xB1, 0xF7, 0xD1, 0x77, 0x9B, 0xCC, 0x09, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
@@ -118,17 +122,37 @@ void hci_add_event_handler(btstack_packet_callback_registration_t * callback_han
 	registered_hci_event_handler = callback_handler->callback;
 }
 
+static bool l2cap_packet_buffer_reserved;
+
 int l2cap_reserve_packet_buffer(void){
+	l2cap_packet_buffer_reserved = true;
 	return 1;
 }
 
 void l2cap_release_packet_buffer(void){
+	l2cap_packet_buffer_reserved = false;
+}
+
+int hci_is_packet_buffer_reserved(void){
+	return l2cap_packet_buffer_reserved ? 1 : 0;
 }
 
 static uint8_t l2cap_can_send_fixed_channel_packet_now_status = 1;
+static bool    l2cap_can_send_fixed_channel_packet_now_requested;
+static uint16_t l2cap_num_packets_sent;
+static uint16_t l2cap_num_send_errors;
+
+static void l2cap_emit_can_send_now(void){
+	uint8_t event[] = { L2CAP_EVENT_CAN_SEND_NOW, 2, 1, 0};
+	att_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
+}
 
 void l2cap_can_send_fixed_channel_packet_now_set_status(uint8_t status){
 	l2cap_can_send_fixed_channel_packet_now_status = status;
+	if (status && l2cap_can_send_fixed_channel_packet_now_requested){
+		l2cap_can_send_fixed_channel_packet_now_requested = false;
+		l2cap_emit_can_send_now();
+	}
 }
 
 int l2cap_can_send_fixed_channel_packet_now(uint16_t handle, uint16_t channel_id){
@@ -136,11 +160,34 @@ int l2cap_can_send_fixed_channel_packet_now(uint16_t handle, uint16_t channel_id
 }
 
 void l2cap_request_can_send_fix_channel_now_event(uint16_t handle, uint16_t channel_id){
-	uint8_t event[] = { L2CAP_EVENT_CAN_SEND_NOW, 2, 1, 0};
-	att_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
+	// delay event until sending is possible
+	if (!l2cap_can_send_fixed_channel_packet_now_status){
+		l2cap_can_send_fixed_channel_packet_now_requested = true;
+		return;
+	}
+	l2cap_emit_can_send_now();
+}
+
+uint16_t mock_l2cap_num_packets_sent(void){
+	return l2cap_num_packets_sent;
+}
+
+// next num_errors calls to l2cap_send_prepared_connectionless fail, packet buffer stays reserved
+void mock_l2cap_send_prepared_connectionless_fail(uint16_t num_errors){
+	l2cap_num_send_errors = num_errors;
+}
+
+uint16_t mock_l2cap_send_prepared_connectionless_errors_pending(void){
+	return l2cap_num_send_errors;
 }
 
 int l2cap_send_prepared_connectionless(uint16_t handle, uint16_t cid, uint16_t len){
+	if (l2cap_num_send_errors > 0){
+		l2cap_num_send_errors--;
+		return BTSTACK_ACL_BUFFERS_FULL;
+	}
+	l2cap_packet_buffer_reserved = false;
+	l2cap_num_packets_sent++;
 	att_connection_t att_connection;
 	att_init_connection(&att_connection);
 	uint8_t response[max_mtu];
@@ -186,6 +233,10 @@ int  btstack_run_loop_remove_timer(btstack_timer_source_t *timer){
 	return 1;
 }
 
+uint32_t btstack_run_loop_get_time_ms(void){
+	return 0;
+}
+
 void * btstack_run_loop_get_timer_context(btstack_timer_source_t *ts){
     return ts->context;
 }
@@ -196,8 +247,20 @@ hci_connection_t * hci_connection_for_bd_addr_and_type(bd_addr_t addr, bd_addr_t
 	return NULL;
 }
 hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
-	if (con_handle != 0) return NULL;
-	return &hci_connection;
+	if (con_handle == 0) return &hci_connection;
+	btstack_linked_list_iterator_t it;
+	btstack_linked_list_iterator_init(&it, &connections);
+	while (btstack_linked_list_iterator_has_next(&it)){
+		hci_connection_t * connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+		if (connection->con_handle == con_handle) return connection;
+	}
+	return NULL;
+}
+void mock_add_le_connection(hci_connection_t * connection){
+	btstack_linked_list_add_tail(&connections, (btstack_linked_item_t *) connection);
+}
+void mock_remove_le_connections(void){
+	connections = NULL;
 }
 void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
 	// printf("hci_connections_get_iterator not implemented in mock backend\n");
@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_hash_index.h"
+
+#define NUM_ENTRIES 16
+
+static btstack_hash_index_t       hash_index;
+static btstack_hash_index_entry_t hash_index_entries[NUM_ENTRIES];
+static uint8_t                    objects[0x10000];
+
+TEST_GROUP(HashIndex){
+    void setup(void){
+        btstack_hash_index_init(&hash_index, hash_index_entries, NUM_ENTRIES);
+    }
+};
+
+TEST(HashIndex, Empty){
+    POINTERS_EQUAL(NULL, btstack_hash_index_get(&hash_index, 0x0040));
+    CHECK_TRUE(btstack_hash_index_complete(&hash_index));
+}
+
+TEST(HashIndex, AddGetRemove){
+    CHECK_TRUE(btstack_hash_index_add(&hash_index, 0x0040, &objects[0x40]));
+    CHECK_TRUE(btstack_hash_index_add(&hash_index, 0x0041, &objects[0x41]));
+    POINTERS_EQUAL(&objects[0x40], btstack_hash_index_get(&hash_index, 0x0040));
+    POINTERS_EQUAL(&objects[0x41], btstack_hash_index_get(&hash_index, 0x0041));
+    btstack_hash_index_remove(&hash_index, 0x0040, &objects[0x40]);
+    POINTERS_EQUAL(NULL, btstack_hash_index_get(&hash_index, 0x0040));
+    POINTERS_EQUAL(&objects[0x41], btstack_hash_index_get(&hash_index, 0x0041));
+    CHECK_TRUE(btstack_hash_index_complete(&hash_index));
+}
+
+TEST(HashIndex, Full){
+    uint16_t key;
+    for (key = 0; key < (NUM_ENTRIES - 1); key++){
+        CHECK_TRUE(btstack_hash_index_add(&hash_index, key, &objects[key]));
+    }
+    // one entry is kept free
+    CHECK_FALSE(btstack_hash_index_add(&hash_index, 0x1000, &objects[0x1000]));
+    CHECK_FALSE(btstack_hash_index_complete(&hash_index));
+    POINTERS_EQUAL(NULL, btstack_hash_index_get(&hash_index, 0x1000));
+    // removing missing object completes index again
+    btstack_hash_index_remove(&hash_index, 0x1000, &objects[0x1000]);
+    CHECK_TRUE(btstack_hash_index_complete(&hash_index));
+    for (key = 0; key < (NUM_ENTRIES - 1); key++){
+        POINTERS_EQUAL(&objects[key], btstack_hash_index_get(&hash_index, key));
+    }
+}
+
+TEST(HashIndex, ReplaceKey){
+    CHECK_TRUE(btstack_hash_index_add(&hash_index, 0x0001, &objects[1]));
+    CHECK_TRUE(btstack_hash_index_add(&hash_index, 0x0001, &objects[1]));
+    CHECK_TRUE(btstack_hash_index_complete(&hash_index));
+    CHECK_TRUE(btstack_hash_index_add(&hash_index, 0x0001, &objects[2]));
+    CHECK_FALSE(btstack_hash_index_complete(&hash_index));
+    POINTERS_EQUAL(&objects[2], btstack_hash_index_get(&hash_index, 0x0001));
+    btstack_hash_index_remove(&hash_index, 0x0001, &objects[1]);
+    CHECK_TRUE(btstack_hash_index_complete(&hash_index));
+    POINTERS_EQUAL(&objects[2], btstack_hash_index_get(&hash_index, 0x0001));
+}
+
+// compare against simple array for random sequence of add and remove
+TEST(HashIndex, Random){
+    static void * reference[256];
+    memset(reference, 0, sizeof(reference));
+    int num_used = 0;
+    srand(1);
+    int i;
+    for (i = 0; i < 100000; i++){
+        uint16_t key = (uint16_t) (rand() & 0xff);
+        if (reference[key] != NULL){
+            btstack_hash_index_remove(&hash_index, key, reference[key]);
+            reference[key] = NULL;
+            num_used--;
+        } else if (num_used < (NUM_ENTRIES - 1)){
+            reference[key] = &objects[key];
+            CHECK_TRUE(btstack_hash_index_add(&hash_index, key, &objects[key]));
+            num_used++;
+        }
+        uint16_t probe = (uint16_t) (rand() & 0xff);
+        POINTERS_EQUAL(reference[probe], btstack_hash_index_get(&hash_index, probe));
+    }
+    CHECK_TRUE(btstack_hash_index_complete(&hash_index));
+    uint16_t key;
+    for (key = 0; key < 256; key++){
+        POINTERS_EQUAL(reference[key], btstack_hash_index_get(&hash_index, key));
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,262 @@
+// replay incoming ACL traffic over many LE connections and LE Data Channels
+// to measure connection lookup in hci.c and channel lookup in l2cap.c
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_debug.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "ble/sm.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+
+#define NUM_CONNECTIONS          32
+#define NUM_CHANNELS_PER_CONNECTION 4
+#define NUM_PACKETS              20000
+#define CON_HANDLE_BASE          0x0040
+#define TEST_PSM                 0x0080
+#define TEST_MTU                 100
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// last LE Credit Based Connection Request sent
+static uint8_t  connection_request_sig_id;
+static uint16_t connection_request_local_cid;
+
+static uint16_t local_cids[NUM_CONNECTIONS][NUM_CHANNELS_PER_CONNECTION];
+static uint8_t  receive_buffers[NUM_CONNECTIONS][NUM_CHANNELS_PER_CONNECTION][TEST_MTU];
+static int      num_data_packets_received;
+static int      num_att_packets_received;
+static uint16_t last_data_channel;
+// ACL packets sent by L2CAP, e.g. for credits, are completed by controller after each received packet
+static uint16_t acl_packets_sent[NUM_CONNECTIONS];
+static hci_con_handle_t last_att_con_handle;
+
+// SM is not used as LE Data Channels are created with security level 0
+void sm_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    UNUSED(callback_handler);
+}
+
+void sm_request_pairing(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+}
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    UNUSED(size);
+    if (packet_type != HCI_ACL_DATA_PACKET) return 0;
+    hci_con_handle_t con_handle = little_endian_read_16(packet, 0) & 0x0fff;
+    acl_packets_sent[con_handle - CON_HANDLE_BASE]++;
+    // LE signaling channel
+    if (little_endian_read_16(packet, 6) != L2CAP_CID_SIGNALING_LE) return 0;
+    if (packet[8] != LE_CREDIT_BASED_CONNECTION_REQUEST) return 0;
+    connection_request_sig_id    = packet[9];
+    connection_request_local_cid = little_endian_read_16(packet, 14);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+// synchronous transport
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void l2cap_channel_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(packet);
+    UNUSED(size);
+    if (packet_type != L2CAP_DATA_PACKET) return;
+    num_data_packets_received++;
+    last_data_channel = channel;
+}
+
+static void att_packet_handler(uint8_t packet_type, uint16_t con_handle, uint8_t *packet, uint16_t size){
+    UNUSED(packet);
+    UNUSED(size);
+    if (packet_type != ATT_DATA_PACKET) return;
+    num_att_packets_received++;
+    last_att_con_handle = con_handle;
+}
+
+static void command_complete(const uint8_t * event, uint16_t size){
+    packet_handler(HCI_EVENT_PACKET, (uint8_t *) event, size);
+}
+
+static void number_of_completed_packets(void){
+    int i;
+    for (i = 0; i < NUM_CONNECTIONS; i++){
+        if (acl_packets_sent[i] == 0) continue;
+        uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 0, 0 };
+        little_endian_store_16(event, 3, CON_HANDLE_BASE + i);
+        little_endian_store_16(event, 5, acl_packets_sent[i]);
+        acl_packets_sent[i] = 0;
+        packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    }
+}
+
+static void le_connection_complete(hci_con_handle_t con_handle){
+    uint8_t event[] = { HCI_EVENT_LE_META, 19, HCI_SUBEVENT_LE_CONNECTION_COMPLETE, 0, 0, 0, HCI_ROLE_SLAVE, 0,
+        0, 0, 0, 0, 0, 0, 0x28, 0, 0, 0, 0xc8, 0, 0 };
+    little_endian_store_16(event, 4, con_handle);
+    little_endian_store_16(event, 8, con_handle);
+    event[10] = 0x33;
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void acl_packet(hci_con_handle_t con_handle, uint16_t cid, const uint8_t * payload, uint16_t len){
+    uint8_t packet[8 + 32];
+    little_endian_store_16(packet, 0, con_handle | (2u << 12));
+    little_endian_store_16(packet, 2, 4 + len);
+    little_endian_store_16(packet, 4, len);
+    little_endian_store_16(packet, 6, cid);
+    memcpy(&packet[8], payload, len);
+    packet_handler(HCI_ACL_DATA_PACKET, packet, 8 + len);
+    number_of_completed_packets();
+}
+
+static void le_credit_based_connection_response(hci_con_handle_t con_handle){
+    uint8_t response[14];
+    response[0] = LE_CREDIT_BASED_CONNECTION_RESPONSE;
+    response[1] = connection_request_sig_id;
+    little_endian_store_16(response, 2, 10);
+    // remote cid = local cid
+    little_endian_store_16(response, 4, connection_request_local_cid);
+    little_endian_store_16(response, 6, TEST_MTU);
+    little_endian_store_16(response, 8, TEST_MTU);
+    little_endian_store_16(response, 10, 10);
+    little_endian_store_16(response, 12, 0);
+    acl_packet(con_handle, L2CAP_CID_SIGNALING_LE, response, sizeof(response));
+}
+
+static double time_ms(const struct timespec * start, const struct timespec * end){
+    return ((double) (end->tv_sec - start->tv_sec) * 1000.0) + ((double) (end->tv_nsec - start->tv_nsec) / 1000000.0);
+}
+
+TEST_GROUP(AclLookup){
+    void setup(void){
+        num_data_packets_received = 0;
+        num_att_packets_received  = 0;
+        memset(acl_packets_sent, 0, sizeof(acl_packets_sent));
+        btstack_memory_init();
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        hci_init(&hci_transport_test, NULL);
+        // HCI Read Buffer Size and LE Read Buffer Size are only processed during init
+        hci_power_control(HCI_POWER_ON);
+        static const uint8_t read_buffer_size_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 11, 1, 0x05, 0x10, 0,
+            0xfd, 0x03, 0x40, 0x0a, 0x00, 0x04, 0x00 };
+        command_complete(read_buffer_size_complete, sizeof(read_buffer_size_complete));
+        hci_simulate_working_fuzz();
+        static const uint8_t le_read_buffer_size_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 7, 1, 0x02, 0x20, 0,
+            0xfb, 0x00, 8 };
+        command_complete(le_read_buffer_size_complete, sizeof(le_read_buffer_size_complete));
+        l2cap_init();
+        l2cap_register_fixed_channel(&att_packet_handler, L2CAP_CID_ATTRIBUTE_PROTOCOL);
+
+        int i;
+        int j;
+        for (i = 0; i < NUM_CONNECTIONS; i++){
+            hci_con_handle_t con_handle = CON_HANDLE_BASE + i;
+            le_connection_complete(con_handle);
+            for (j = 0; j < NUM_CHANNELS_PER_CONNECTION; j++){
+                uint8_t status = l2cap_le_create_channel(&l2cap_channel_packet_handler, con_handle, TEST_PSM, receive_buffers[i][j],
+                                                         TEST_MTU, L2CAP_LE_AUTOMATIC_CREDITS, LEVEL_0, &local_cids[i][j]);
+                CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+                CHECK_EQUAL(local_cids[i][j], connection_request_local_cid);
+                le_credit_based_connection_response(con_handle);
+            }
+        }
+    }
+    void teardown(void){
+        hci_free_connections_fuzz();
+        hci_deinit();
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(AclLookup, Replay){
+    // single fragment SDU: len (2) + payload
+    uint8_t sdu[] = { 4, 0, 1, 2, 3, 4 };
+    uint8_t att_pdu[] = { 0x52, 0x03, 0x00, 0x01 };
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    srand(1);
+    int k;
+    for (k = 0; k < NUM_PACKETS; k++){
+        int i = rand() % NUM_CONNECTIONS;
+        int j = rand() % (NUM_CHANNELS_PER_CONNECTION + 1);
+        hci_con_handle_t con_handle = CON_HANDLE_BASE + i;
+        if (j == NUM_CHANNELS_PER_CONNECTION){
+            acl_packet(con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, att_pdu, sizeof(att_pdu));
+            CHECK_EQUAL(con_handle, last_att_con_handle);
+        } else {
+            acl_packet(con_handle, local_cids[i][j], sdu, sizeof(sdu));
+            CHECK_EQUAL(local_cids[i][j], last_data_channel);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    CHECK_EQUAL(NUM_PACKETS, num_data_packets_received + num_att_packets_received);
+
+    double duration_ms = time_ms(&start, &end);
+    printf("%u connections, %u LE Data Channels: %u ACL packets in %.1f ms, %.0f ns per packet\n",
+        NUM_CONNECTIONS, NUM_CONNECTIONS * NUM_CHANNELS_PER_CONNECTION, NUM_PACKETS, duration_ms, duration_ms * 1000000.0 / NUM_PACKETS);
+}
+
+TEST(AclLookup, Disconnect){
+    // channels and connection are removed from index
+    hci_con_handle_t con_handle = CON_HANDLE_BASE + 1;
+    uint8_t disconnection_complete[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, 0, 0, 0x13 };
+    little_endian_store_16(disconnection_complete, 3, con_handle);
+    packet_handler(HCI_EVENT_PACKET, disconnection_complete, sizeof(disconnection_complete));
+    POINTERS_EQUAL(NULL, hci_connection_for_handle(con_handle));
+    CHECK(hci_connection_for_handle(CON_HANDLE_BASE) != NULL);
+
+    uint8_t sdu[] = { 4, 0, 1, 2, 3, 4 };
+    acl_packet(con_handle, local_cids[1][0], sdu, sizeof(sdu));
+    CHECK_EQUAL(0, num_data_packets_received);
+    acl_packet(CON_HANDLE_BASE, local_cids[0][0], sdu, sizeof(sdu));
+    CHECK_EQUAL(1, num_data_packets_received);
+
+    // new connection reuses handle
+    le_connection_complete(con_handle);
+    CHECK(hci_connection_for_handle(con_handle) != NULL);
+    acl_packet(con_handle, local_cids[1][0], sdu, sizeof(sdu));
+    CHECK_EQUAL(1, num_data_packets_received);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,372 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_debug.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+#include "hci_transport.h"
+
+// connections from hci_setup_test_connections_fuzz
+#define CON_HANDLE_CLASSIC 0x0003
+#define CON_HANDLE_LE      0x0005
+
+#define LE_ACL_DATA_PACKET_LENGTH 27
+#define LE_ACL_PACKETS_TOTAL_NUM  3
+
+// simulated time: sending a packet over the transport takes transport_tx_time
+static uint32_t sim_time;
+static uint32_t transport_tx_time;
+static bool     transport_busy;
+static uint32_t transport_done_time;
+static uint8_t  transport_packet_type;
+static uint16_t transport_con_handle;
+// controller returns ACL buffer as soon as fragment was received
+static bool     controller_auto_complete;
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// sent ACL fragments
+#define MAX_ACL_FRAGMENTS 1000
+typedef struct {
+    hci_con_handle_t con_handle;
+    uint8_t          packet_boundary_flag;
+    uint16_t         len;
+} acl_fragment_t;
+static acl_fragment_t acl_fragments[MAX_ACL_FRAGMENTS];
+static int            acl_fragments_num;
+static int            acl_fragments_in_controller[CON_HANDLE_LE + 1];
+
+// reassembled ACL packets, payload: len (2), sequence number (1), pattern
+#define MAX_ACL_PACKETS 1000
+typedef struct {
+    uint8_t  buffer[HCI_ACL_PAYLOAD_SIZE];
+    uint16_t pos;
+    uint8_t  sequence_numbers[MAX_ACL_PACKETS];
+    int      num_packets;
+} acl_stream_t;
+static acl_stream_t acl_streams[CON_HANDLE_LE + 1];
+static int          acl_packets_num;
+
+static void acl_reassemble(hci_con_handle_t con_handle, uint8_t packet_boundary_flag, const uint8_t * data, uint16_t len){
+    acl_stream_t * stream = &acl_streams[con_handle];
+    if (packet_boundary_flag != 1u){
+        stream->pos = 0;
+    }
+    CHECK(stream->pos + len <= sizeof(stream->buffer));
+    memcpy(&stream->buffer[stream->pos], data, len);
+    stream->pos += len;
+    if (stream->pos < 2u) return;
+    uint16_t packet_len = little_endian_read_16(stream->buffer, 0);
+    if (stream->pos < packet_len) return;
+    CHECK_EQUAL(packet_len, stream->pos);
+    uint16_t i;
+    for (i = 3; i < packet_len; i++){
+        BYTES_EQUAL((uint8_t) (i + stream->buffer[2]), stream->buffer[i]);
+    }
+    stream->sequence_numbers[stream->num_packets++] = stream->buffer[2];
+    stream->pos = 0;
+    acl_packets_num++;
+}
+
+static int hci_transport_test_can_send_now(uint8_t packet_type){
+    UNUSED(packet_type);
+    return transport_busy ? 0 : 1;
+}
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    CHECK(transport_busy == false);
+    transport_busy = true;
+    transport_done_time = sim_time + transport_tx_time;
+    transport_packet_type = packet_type;
+    if (packet_type != HCI_ACL_DATA_PACKET) return 0;
+
+    hci_con_handle_t con_handle = little_endian_read_16(packet, 0) & 0x0fffu;
+    uint8_t packet_boundary_flag = (packet[1] >> 4) & 0x03u;
+    uint16_t len = little_endian_read_16(packet, 2);
+    CHECK_EQUAL(size - 4, len);
+    CHECK(acl_fragments_num < MAX_ACL_FRAGMENTS);
+    acl_fragments[acl_fragments_num].con_handle = con_handle;
+    acl_fragments[acl_fragments_num].packet_boundary_flag = packet_boundary_flag;
+    acl_fragments[acl_fragments_num].len = len;
+    acl_fragments_num++;
+    transport_con_handle = con_handle;
+
+    // controller buffers must not be exceeded
+    acl_fragments_in_controller[con_handle]++;
+    if (con_handle == CON_HANDLE_LE){
+        CHECK(acl_fragments_in_controller[con_handle] <= LE_ACL_PACKETS_TOTAL_NUM);
+    }
+    acl_reassemble(con_handle, packet_boundary_flag, &packet[4], len);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       &hci_transport_test_can_send_now,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void controller_complete_packets(hci_con_handle_t con_handle, uint16_t num_packets){
+    uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 0, 0};
+    little_endian_store_16(event, 3, con_handle);
+    little_endian_store_16(event, 5, num_packets);
+    acl_fragments_in_controller[con_handle] -= num_packets;
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void transport_complete(void){
+    CHECK(transport_busy);
+    sim_time = btstack_max(sim_time, transport_done_time);
+    transport_busy = false;
+    // next packet might be sent from packet handler
+    uint8_t packet_type = transport_packet_type;
+    hci_con_handle_t con_handle = transport_con_handle;
+    uint8_t packet_sent_event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    packet_handler(HCI_EVENT_PACKET, packet_sent_event, sizeof(packet_sent_event));
+    if (controller_auto_complete && (packet_type == HCI_ACL_DATA_PACKET)){
+        controller_complete_packets(con_handle, 1);
+    }
+}
+
+static void transport_flush(void){
+    while (transport_busy){
+        transport_complete();
+    }
+}
+
+static void command_complete(const uint8_t * event, uint16_t size){
+    packet_handler(HCI_EVENT_PACKET, (uint8_t *) event, size);
+}
+
+static int send_acl_packet(hci_con_handle_t con_handle, uint16_t len, uint8_t sequence_number){
+    CHECK(hci_reserve_packet_buffer());
+    uint8_t * buffer = hci_get_outgoing_packet_buffer();
+    little_endian_store_16(buffer, 0, con_handle | (2u << 12));
+    little_endian_store_16(buffer, 2, len);
+    little_endian_store_16(buffer, 4, len);
+    buffer[6] = sequence_number;
+    uint16_t i;
+    for (i = 3; i < len; i++){
+        buffer[4 + i] = (uint8_t) (i + sequence_number);
+    }
+    return hci_send_acl_packet_buffer(4 + len);
+}
+
+TEST_GROUP(HCI_ACL){
+    void setup(void){
+        sim_time = 0;
+        transport_tx_time = 10;
+        transport_busy = false;
+        controller_auto_complete = true;
+        acl_fragments_num = 0;
+        acl_packets_num = 0;
+        memset(acl_fragments_in_controller, 0, sizeof(acl_fragments_in_controller));
+        memset(acl_streams, 0, sizeof(acl_streams));
+
+        btstack_memory_init();
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        hci_init(&hci_transport_test, NULL);
+
+        // HCI Read Buffer Size is only processed during init
+        hci_power_control(HCI_POWER_ON);
+        transport_flush();
+        static const uint8_t read_buffer_size_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 11, 1, 0x05, 0x10, 0,
+            0xfd, 0x03, 0x40, 0x0a, 0x00, 0x04, 0x00 };
+        command_complete(read_buffer_size_complete, sizeof(read_buffer_size_complete));
+        transport_flush();
+
+        hci_simulate_working_fuzz();
+        transport_flush();
+        hci_setup_test_connections_fuzz();
+
+        static const uint8_t le_read_buffer_size_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 7, 1, 0x02, 0x20, 0,
+            LE_ACL_DATA_PACKET_LENGTH, 0x00, LE_ACL_PACKETS_TOTAL_NUM };
+        command_complete(le_read_buffer_size_complete, sizeof(le_read_buffer_size_complete));
+        transport_flush();
+        acl_fragments_num = 0;
+        sim_time = 0;
+    }
+    void teardown(void){
+        hci_free_connections_fuzz();
+        hci_deinit();
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(HCI_ACL, SendPacket){
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_CLASSIC));
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_CLASSIC, 100, 1));
+    CHECK_EQUAL(1, acl_fragments_num);
+    CHECK_EQUAL(100, acl_fragments[0].len);
+    CHECK_EQUAL(2, acl_fragments[0].packet_boundary_flag);
+    transport_flush();
+    CHECK_EQUAL(1, acl_streams[CON_HANDLE_CLASSIC].num_packets);
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_CLASSIC));
+}
+
+TEST(HCI_ACL, Fragmentation){
+    controller_auto_complete = false;
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_LE, 100, 7));
+    transport_flush();
+    // only LE_ACL_PACKETS_TOTAL_NUM fragments fit into the controller
+    CHECK_EQUAL(LE_ACL_PACKETS_TOTAL_NUM, acl_fragments_num);
+    CHECK_EQUAL(0, hci_can_send_acl_packet_now(CON_HANDLE_LE));
+    controller_complete_packets(CON_HANDLE_LE, 1);
+    transport_flush();
+    CHECK_EQUAL(4, acl_fragments_num);
+    CHECK_EQUAL(2, acl_fragments[0].packet_boundary_flag);
+    CHECK_EQUAL(1, acl_fragments[1].packet_boundary_flag);
+    CHECK_EQUAL(LE_ACL_DATA_PACKET_LENGTH, acl_fragments[0].len);
+    CHECK_EQUAL(100 - 3 * LE_ACL_DATA_PACKET_LENGTH, acl_fragments[3].len);
+    CHECK_EQUAL(1, acl_streams[CON_HANDLE_LE].num_packets);
+    CHECK_EQUAL(7, acl_streams[CON_HANDLE_LE].sequence_numbers[0]);
+}
+
+TEST(HCI_ACL, SendWhileTransportBusy){
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_CLASSIC, 100, 1));
+    CHECK(transport_busy);
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    // packet for other connection is queued
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_LE));
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_LE, 20, 2));
+    CHECK_EQUAL(1, acl_fragments_num);
+    transport_flush();
+    CHECK_EQUAL(2, acl_fragments_num);
+    CHECK_EQUAL(CON_HANDLE_LE, acl_fragments[1].con_handle);
+#else
+    CHECK_EQUAL(0, hci_can_send_acl_packet_now(CON_HANDLE_LE));
+    transport_flush();
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_LE));
+#endif
+}
+
+TEST(HCI_ACL, DisconnectDropsFragments){
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_LE, 100, 1));
+    CHECK_EQUAL(1, acl_fragments_num);
+    uint8_t disconnection_complete[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, CON_HANDLE_LE, 0, 0x13 };
+    packet_handler(HCI_EVENT_PACKET, disconnection_complete, sizeof(disconnection_complete));
+    controller_auto_complete = false;
+    transport_flush();
+    CHECK_EQUAL(1, acl_fragments_num);
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_CLASSIC));
+}
+
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+TEST(HCI_ACL, QueueFairShare){
+    // 3 ACL connections share queue of size HCI_OUTGOING_ACL_QUEUE_SIZE, one waiting packet each
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_CLASSIC, 100, 1));
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_CLASSIC));
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_CLASSIC, 100, 2));
+    CHECK_EQUAL(0, hci_can_send_acl_packet_now(CON_HANDLE_CLASSIC));
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_LE));
+    transport_flush();
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_CLASSIC));
+}
+
+TEST(HCI_ACL, QueueOrder){
+    controller_auto_complete = false;
+    // LE packet uses all controller buffers, classic packets are sent in between
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_LE, 100, 1));
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_CLASSIC, 50, 2));
+    transport_flush();
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_CLASSIC, 50, 3));
+    transport_flush();
+    CHECK_EQUAL(5, acl_fragments_num);
+    CHECK_EQUAL(2, acl_streams[CON_HANDLE_CLASSIC].num_packets);
+    CHECK_EQUAL(2, acl_streams[CON_HANDLE_CLASSIC].sequence_numbers[0]);
+    CHECK_EQUAL(3, acl_streams[CON_HANDLE_CLASSIC].sequence_numbers[1]);
+    CHECK_EQUAL(0, acl_streams[CON_HANDLE_LE].num_packets);
+    controller_complete_packets(CON_HANDLE_LE, 3);
+    transport_flush();
+    CHECK_EQUAL(1, acl_streams[CON_HANDLE_LE].num_packets);
+}
+
+TEST(HCI_ACL, DisconnectDropsQueuedPackets){
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_CLASSIC, 100, 1));
+    CHECK_EQUAL(0, send_acl_packet(CON_HANDLE_LE, 20, 2));
+    uint8_t disconnection_complete[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, CON_HANDLE_LE, 0, 0x13 };
+    packet_handler(HCI_EVENT_PACKET, disconnection_complete, sizeof(disconnection_complete));
+    transport_flush();
+    CHECK_EQUAL(1, acl_fragments_num);
+    CHECK_EQUAL(1, hci_can_send_acl_packet_now(CON_HANDLE_CLASSIC));
+}
+#endif
+
+// producer reacts to 'can send now' with a latency, e.g. as it has to wait for an event from its data source
+static uint32_t send_packets_with_latency(hci_con_handle_t con_handle, int num_packets, uint16_t len, uint32_t latency){
+    int packets_sent = 0;
+    bool producer_pending = false;
+    uint32_t producer_ready_time = 0;
+    while ((packets_sent < num_packets) || transport_busy){
+        if (!producer_pending && (packets_sent < num_packets) && hci_can_send_acl_packet_now(con_handle)){
+            producer_pending = true;
+            producer_ready_time = sim_time + latency;
+        }
+        if (producer_pending && (!transport_busy || (producer_ready_time <= transport_done_time))){
+            sim_time = btstack_max(sim_time, producer_ready_time);
+            CHECK_EQUAL(0, send_acl_packet(con_handle, len, (uint8_t) packets_sent));
+            producer_pending = false;
+            packets_sent++;
+        } else {
+            CHECK(transport_busy);
+            transport_complete();
+        }
+    }
+    return sim_time;
+}
+
+TEST(HCI_ACL, Throughput){
+    const int num_packets = 200;
+    const uint32_t latency = 4;
+    uint32_t duration = send_packets_with_latency(CON_HANDLE_CLASSIC, num_packets, 1000, latency);
+    CHECK_EQUAL(num_packets, acl_streams[CON_HANDLE_CLASSIC].num_packets);
+    int i;
+    for (i = 0; i < num_packets; i++){
+        CHECK_EQUAL((uint8_t) i, acl_streams[CON_HANDLE_CLASSIC].sequence_numbers[i]);
+    }
+    uint32_t transport_time = num_packets * transport_tx_time;
+    printf("%u packets: transport busy %u of %u time units (%u%%)\n", num_packets, transport_time, duration, 100 * transport_time / duration);
+#ifdef ENABLE_HCI_OUTGOING_ACL_QUEUE
+    // producer latency is hidden while transport is busy
+    CHECK_EQUAL(transport_time + latency, duration);
+#else
+    // transport is idle while producer prepares next packet
+    CHECK_EQUAL(transport_time + num_packets * latency, duration);
+#endif
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
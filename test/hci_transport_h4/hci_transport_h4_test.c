@@ -0,0 +1,599 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_uart_block.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+
+static int pty_master_fd = -1;
+
+#ifdef HAVE_WRAP_SYSCALLS
+// count syscalls of UART driver, ignore pty master used by test threads
+static int read_syscalls;
+static int write_syscalls;
+extern "C" ssize_t __real_read(int fd, void * buffer, size_t count);
+extern "C" ssize_t __real_write(int fd, const void * buffer, size_t count);
+extern "C" ssize_t __wrap_read(int fd, void * buffer, size_t count){
+    if (fd != pty_master_fd) read_syscalls++;
+    return __real_read(fd, buffer, count);
+}
+extern "C" ssize_t __wrap_write(int fd, const void * buffer, size_t count){
+    if (fd != pty_master_fd) write_syscalls++;
+    return __real_write(fd, buffer, count);
+}
+#endif
+
+// H4 test stream
+#define MAX_STREAM_SIZE (8*1024*1024)
+static uint8_t  stream[MAX_STREAM_SIZE];
+static uint32_t stream_len;
+static int      stream_num_packets;
+
+// received packets
+static uint8_t  received[MAX_STREAM_SIZE];
+static uint32_t received_len;
+static int      received_num_packets;
+static int      packet_sent_events;
+static bool     packet_handler_write_after_packet;
+static int      packet_handler_close_after;
+static const hci_transport_t * transport;
+
+static void stream_reset(void){
+    stream_len = 0;
+    stream_num_packets = 0;
+}
+
+static void stream_add(const uint8_t * data, uint16_t len){
+    memcpy(&stream[stream_len], data, len);
+    stream_len += len;
+}
+
+static void stream_add_event(uint8_t event_code, uint8_t param_len){
+    uint8_t header[] = { HCI_EVENT_PACKET, event_code, param_len };
+    stream_add(header, sizeof(header));
+    uint16_t i;
+    for (i=0;i<param_len;i++){
+        stream[stream_len++] = (uint8_t) (i + stream_num_packets);
+    }
+    stream_num_packets++;
+}
+
+static void stream_add_acl(uint16_t con_handle, uint16_t payload_len){
+    uint8_t header[5];
+    header[0] = HCI_ACL_DATA_PACKET;
+    little_endian_store_16(header, 1, con_handle);
+    little_endian_store_16(header, 3, payload_len);
+    stream_add(header, sizeof(header));
+    uint16_t i;
+    for (i=0;i<payload_len;i++){
+        stream[stream_len++] = (uint8_t) (i * 7 + stream_num_packets);
+    }
+    stream_num_packets++;
+}
+
+static void stream_add_sco(uint16_t con_handle, uint8_t payload_len){
+    uint8_t header[4];
+    header[0] = HCI_SCO_DATA_PACKET;
+    little_endian_store_16(header, 1, con_handle);
+    header[3] = payload_len;
+    stream_add(header, sizeof(header));
+    uint16_t i;
+    for (i=0;i<payload_len;i++){
+        stream[stream_len++] = (uint8_t) (0x80 + i);
+    }
+    stream_num_packets++;
+}
+
+// mixed traffic similar to A2DP streaming
+static void stream_add_mixed(int num_packets){
+    int i;
+    for (i=0;i<num_packets;i++){
+        switch (i % 4){
+            case 0:
+                stream_add_event(HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5);
+                break;
+            case 1:
+                stream_add_acl(0x0001, (uint16_t) (600 + (i % 400)));
+                break;
+            case 2:
+                stream_add_acl(0x0001, 1021);
+                break;
+            default:
+                stream_add_acl(0x0001, (uint16_t) (i % 100));
+                break;
+        }
+    }
+}
+
+static void packet_handler(uint8_t packet_type, uint8_t *packet, uint16_t size){
+    if ((packet_type == HCI_EVENT_PACKET) && (packet[0] == HCI_EVENT_TRANSPORT_PACKET_SENT)){
+        packet_sent_events++;
+        return;
+    }
+    received[received_len++] = packet_type;
+    memcpy(&received[received_len], packet, size);
+    received_len += size;
+    received_num_packets++;
+    // e.g. hci.c terminates local name in place
+    if (packet_handler_write_after_packet){
+        packet[size] = 0;
+    }
+    if (received_num_packets == packet_handler_close_after){
+        transport->close();
+    }
+}
+
+static void received_reset(void){
+    received_len = 0;
+    received_num_packets = 0;
+    packet_sent_events = 0;
+    packet_handler_write_after_packet = false;
+    packet_handler_close_after = 0;
+}
+
+// mock UART driver with block and optional streaming receive
+
+static void (*mock_block_received)(void);
+static void (*mock_block_sent)(void);
+static void (*mock_bytes_received)(uint16_t num_bytes);
+static uint8_t * mock_read_buffer;
+static uint16_t  mock_read_len;
+static bool      mock_read_partial;
+static uint32_t  mock_stream_pos;
+static int       mock_reads;
+
+static int mock_uart_init(const btstack_uart_config_t * uart_config){
+    UNUSED(uart_config);
+    return 0;
+}
+
+static int mock_uart_open(void){
+    mock_read_len = 0;
+    return 0;
+}
+
+static int mock_uart_close(void){
+    mock_read_len = 0;
+    return 0;
+}
+
+static void mock_uart_set_block_received(void (*handler)(void)){
+    mock_block_received = handler;
+}
+
+static void mock_uart_set_block_sent(void (*handler)(void)){
+    mock_block_sent = handler;
+}
+
+static void mock_uart_set_bytes_received(void (*handler)(uint16_t num_bytes)){
+    mock_bytes_received = handler;
+}
+
+static int mock_uart_set_baudrate(uint32_t baudrate){
+    UNUSED(baudrate);
+    return 0;
+}
+
+static void mock_uart_receive_block(uint8_t * buffer, uint16_t len){
+    mock_read_buffer  = buffer;
+    mock_read_len     = len;
+    mock_read_partial = false;
+}
+
+static void mock_uart_receive_bytes(uint8_t * buffer, uint16_t len){
+    mock_read_buffer  = buffer;
+    mock_read_len     = len;
+    mock_read_partial = true;
+}
+
+static void mock_uart_send_block(const uint8_t * buffer, uint16_t len){
+    UNUSED(buffer);
+    UNUSED(len);
+    mock_block_sent();
+}
+
+// deliver test stream in chunks of up to max_chunk bytes
+static void mock_uart_deliver(uint16_t max_chunk){
+    mock_stream_pos = 0;
+    mock_reads = 0;
+    while ((mock_read_len > 0) && (mock_stream_pos < stream_len)){
+        uint32_t available = stream_len - mock_stream_pos;
+        uint16_t len = mock_read_len;
+        if (mock_read_partial){
+            len = btstack_min(len, max_chunk);
+            len = (uint16_t) btstack_min(len, available);
+        } else if (len > available){
+            break;
+        }
+        memcpy(mock_read_buffer, &stream[mock_stream_pos], len);
+        mock_stream_pos += len;
+        mock_read_len = 0;
+        mock_reads++;
+        if (mock_read_partial){
+            mock_bytes_received(len);
+        } else {
+            mock_block_received();
+        }
+    }
+}
+
+static const btstack_uart_block_t mock_uart_streaming = {
+    /* int  (*init)(hci_transport_config_uart_t * config); */         &mock_uart_init,
+    /* int  (*open)(void); */                                         &mock_uart_open,
+    /* int  (*close)(void); */                                        &mock_uart_close,
+    /* void (*set_block_received)(void (*handler)(void)); */          &mock_uart_set_block_received,
+    /* void (*set_block_sent)(void (*handler)(void)); */              &mock_uart_set_block_sent,
+    /* int  (*set_baudrate)(uint32_t baudrate); */                    &mock_uart_set_baudrate,
+    /* int  (*set_parity)(int parity); */                             NULL,
+    /* int  (*set_flowcontrol)(int flowcontrol); */                   NULL,
+    /* void (*receive_block)(uint8_t *buffer, uint16_t len); */       &mock_uart_receive_block,
+    /* void (*send_block)(const uint8_t *buffer, uint16_t length); */ &mock_uart_send_block,
+    /* int (*get_supported_sleep_modes); */                           NULL,
+    /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    NULL,
+    /* void (*set_wakeup_handler)(void (*handler)(void)); */          NULL,
+    /* void (*set_bytes_received)(void (*handler)(uint16_t)); */      &mock_uart_set_bytes_received,
+    /* void (*receive_bytes)(uint8_t *buffer, uint16_t len); */       &mock_uart_receive_bytes,
+};
+
+static const btstack_uart_block_t mock_uart_block = {
+    /* int  (*init)(hci_transport_config_uart_t * config); */         &mock_uart_init,
+    /* int  (*open)(void); */                                         &mock_uart_open,
+    /* int  (*close)(void); */                                        &mock_uart_close,
+    /* void (*set_block_received)(void (*handler)(void)); */          &mock_uart_set_block_received,
+    /* void (*set_block_sent)(void (*handler)(void)); */              &mock_uart_set_block_sent,
+    /* int  (*set_baudrate)(uint32_t baudrate); */                    &mock_uart_set_baudrate,
+    /* int  (*set_parity)(int parity); */                             NULL,
+    /* int  (*set_flowcontrol)(int flowcontrol); */                   NULL,
+    /* void (*receive_block)(uint8_t *buffer, uint16_t len); */       &mock_uart_receive_block,
+    /* void (*send_block)(const uint8_t *buffer, uint16_t length); */ &mock_uart_send_block,
+    /* int (*get_supported_sleep_modes); */                           NULL,
+    /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    NULL,
+    /* void (*set_wakeup_handler)(void (*handler)(void)); */          NULL,
+};
+
+static hci_transport_config_uart_t transport_config = {
+    HCI_TRANSPORT_CONFIG_UART,
+    115200,
+    0,
+    1,
+    NULL,
+};
+
+static void transport_setup(const btstack_uart_block_t * uart_driver){
+    transport = hci_transport_h4_instance(uart_driver);
+    transport->init(&transport_config);
+    transport->register_packet_handler(&packet_handler);
+    CHECK_EQUAL(0, transport->open());
+}
+
+static void check_received_stream(void){
+    CHECK_EQUAL(stream_num_packets, received_num_packets);
+    CHECK_EQUAL(stream_len, received_len);
+    MEMCMP_EQUAL(stream, received, stream_len);
+}
+
+TEST_GROUP(H4Streaming){
+    void setup(void){
+        stream_reset();
+        received_reset();
+        transport_setup(&mock_uart_streaming);
+    }
+    void teardown(void){
+        transport->close();
+    }
+};
+
+TEST(H4Streaming, SinglePacket){
+    stream_add_event(HCI_EVENT_COMMAND_COMPLETE, 4);
+    mock_uart_deliver(0xffff);
+    check_received_stream();
+    CHECK_EQUAL(1, mock_reads);
+}
+
+TEST(H4Streaming, MultiplePacketsPerRead){
+    stream_add_mixed(100);
+    mock_uart_deliver(0xffff);
+    check_received_stream();
+    CHECK(mock_reads < stream_num_packets);
+}
+
+TEST(H4Streaming, EmptyPayload){
+    stream_add_event(HCI_EVENT_COMMAND_STATUS, 0);
+    stream_add_acl(0x0002, 0);
+    stream_add_sco(0x0003, 0);
+    stream_add_sco(0x0003, 60);
+    mock_uart_deliver(0xffff);
+    check_received_stream();
+}
+
+TEST(H4Streaming, Fragmented){
+    uint16_t chunks[] = { 1, 2, 3, 7, 100, 1025, 3000 };
+    unsigned int i;
+    stream_add_mixed(200);
+    for (i=0;i<sizeof(chunks)/sizeof(chunks[0]);i++){
+        received_reset();
+        mock_uart_deliver(chunks[i]);
+        check_received_stream();
+    }
+}
+
+TEST(H4Streaming, InvalidPacketType){
+    uint8_t garbage[] = { 0x00, 0x7f };
+    stream_add(garbage, sizeof(garbage));
+    stream_num_packets = 0;
+    uint32_t valid_start = stream_len;
+    stream_add_event(HCI_EVENT_COMMAND_COMPLETE, 4);
+    stream_add_acl(0x0001, 10);
+    mock_uart_deliver(0xffff);
+    CHECK_EQUAL(2, received_num_packets);
+    MEMCMP_EQUAL(&stream[valid_start], received, stream_len - valid_start);
+}
+
+TEST(H4Streaming, InvalidAclLength){
+    uint8_t invalid_acl[] = { HCI_ACL_DATA_PACKET, 0x01, 0x00, 0xff, 0xff };
+    stream_add(invalid_acl, sizeof(invalid_acl));
+    mock_uart_deliver(0xffff);
+    CHECK_EQUAL(0, received_num_packets);
+    // resync on next valid packet
+    stream_reset();
+    stream_add_event(HCI_EVENT_COMMAND_COMPLETE, 4);
+    mock_uart_deliver(0xffff);
+    CHECK_EQUAL(1, received_num_packets);
+}
+
+TEST(H4Streaming, WriteAfterPacket){
+    packet_handler_write_after_packet = true;
+    stream_add_mixed(50);
+    mock_uart_deliver(0xffff);
+    check_received_stream();
+}
+
+TEST(H4Streaming, CloseInPacketHandler){
+    packet_handler_close_after = 3;
+    stream_add_mixed(20);
+    mock_uart_deliver(0xffff);
+    CHECK_EQUAL(3, received_num_packets);
+    CHECK_EQUAL(0, mock_read_len);
+}
+
+TEST(H4Streaming, ReopenInPacketHandler){
+    stream_add_mixed(20);
+    packet_handler_close_after = 3;
+    mock_uart_deliver(0xffff);
+    CHECK_EQUAL(0, transport->open());
+    received_reset();
+    mock_uart_deliver(0xffff);
+    check_received_stream();
+}
+
+TEST(H4Streaming, SendPacket){
+    uint8_t buffer[HCI_OUTGOING_PRE_BUFFER_SIZE + 4];
+    uint8_t * packet = &buffer[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    CHECK_EQUAL(1, transport->can_send_packet_now(HCI_COMMAND_DATA_PACKET));
+    CHECK_EQUAL(0, transport->send_packet(HCI_COMMAND_DATA_PACKET, packet, 3));
+    CHECK_EQUAL(1, packet_sent_events);
+}
+
+TEST_GROUP(H4Block){
+    void setup(void){
+        stream_reset();
+        received_reset();
+        transport_setup(&mock_uart_block);
+    }
+    void teardown(void){
+        transport->close();
+    }
+};
+
+TEST(H4Block, Fallback){
+    stream_add_mixed(100);
+    stream_add_event(HCI_EVENT_COMMAND_STATUS, 0);
+    mock_uart_deliver(0xffff);
+    check_received_stream();
+    // packet type, header, payload
+    CHECK(mock_reads >= 2 * stream_num_packets);
+}
+
+// pty loopback with POSIX UART driver
+
+#define PTY_NUM_PACKETS 10000
+
+static char pty_slave_name[100];
+
+static void * pty_writer_thread(void * arg){
+    UNUSED(arg);
+    uint32_t pos = 0;
+    while (pos < stream_len){
+        ssize_t res = write(pty_master_fd, &stream[pos], stream_len - pos);
+        if (res <= 0) break;
+        pos += (uint32_t) res;
+    }
+    return NULL;
+}
+
+static double timespec_diff_s(const struct timespec * start, const struct timespec * end){
+    return (double) (end->tv_sec - start->tv_sec) + (double) (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static void pty_benchmark(const char * name, const btstack_uart_block_t * uart_driver){
+    stream_reset();
+    received_reset();
+    stream_add_mixed(PTY_NUM_PACKETS);
+
+    transport_config.device_name = pty_slave_name;
+    transport_setup(uart_driver);
+
+#ifdef HAVE_WRAP_SYSCALLS
+    read_syscalls = 0;
+#endif
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t writer;
+    CHECK_EQUAL(0, pthread_create(&writer, NULL, &pty_writer_thread, NULL));
+    while (received_num_packets < stream_num_packets){
+        btstack_run_loop_posix_execute_once();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_join(writer, NULL);
+    transport->close();
+
+    check_received_stream();
+    double duration_s = timespec_diff_s(&start, &end);
+    printf("H4 pty %-9s: %u packets, %u bytes, %6.1f MB/s", name, (unsigned int) stream_num_packets,
+           (unsigned int) stream_len, (double) stream_len / duration_s / 1e6);
+#ifdef HAVE_WRAP_SYSCALLS
+    printf(", %u read() calls, %.2f per packet", read_syscalls, (double) read_syscalls / (double) stream_num_packets);
+#endif
+    printf("\n");
+}
+
+TEST_GROUP(H4Pty){
+    btstack_uart_block_t uart_block;
+    void setup(void){
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        pty_master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+        CHECK(pty_master_fd >= 0);
+        CHECK_EQUAL(0, grantpt(pty_master_fd));
+        CHECK_EQUAL(0, unlockpt(pty_master_fd));
+        strncpy(pty_slave_name, ptsname(pty_master_fd), sizeof(pty_slave_name) - 1);
+        // posix uart driver without streaming support
+        uart_block = *btstack_uart_block_posix_instance();
+        uart_block.set_bytes_received = NULL;
+        uart_block.receive_bytes = NULL;
+    }
+    void teardown(void){
+        close(pty_master_fd);
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(H4Pty, Benchmark){
+    pty_benchmark("block", &uart_block);
+    pty_benchmark("streaming", btstack_uart_block_posix_instance());
+}
+
+// large L2CAP SDUs fragmented into ACL packets like hci_send_acl_packet_fragments
+
+#define PTY_SDU_LEN          16384
+#define PTY_NUM_SDUS         200
+#define PTY_ACL_FRAGMENT_LEN 1021
+
+static uint8_t  sdu_pattern[4 + PTY_SDU_LEN];
+static uint8_t  sdu_buffer[HCI_OUTGOING_PRE_BUFFER_SIZE + 4 + PTY_SDU_LEN];
+static uint32_t pty_expected_len;
+
+static void * pty_reader_thread(void * arg){
+    UNUSED(arg);
+    while (received_len < pty_expected_len){
+        ssize_t res = read(pty_master_fd, &received[received_len], pty_expected_len - received_len);
+        if (res <= 0) break;
+        received_len += (uint32_t) res;
+    }
+    return NULL;
+}
+
+static void pty_wait_packet_sent(int num_packets_sent){
+    while (packet_sent_events < num_packets_sent){
+        btstack_run_loop_posix_execute_once();
+    }
+}
+
+static void pty_send_sdus(void){
+    // ACL header + L2CAP header + payload
+    uint16_t acl_len = sizeof(sdu_pattern);
+    little_endian_store_16(sdu_pattern, 0, 0x0001 | (2u << 12));
+    little_endian_store_16(sdu_pattern, 2, acl_len - 4u);
+    little_endian_store_16(sdu_pattern, 4, acl_len - 8u);
+    little_endian_store_16(sdu_pattern, 6, 0x0040);
+    uint16_t i;
+    for (i=8;i<acl_len;i++){
+        sdu_pattern[i] = (uint8_t) (i * 13);
+    }
+
+    // expected H4 stream
+    stream_reset();
+    uint16_t pos;
+    for (pos = 4; pos < acl_len; pos += PTY_ACL_FRAGMENT_LEN){
+        uint16_t len = btstack_min(PTY_ACL_FRAGMENT_LEN, acl_len - pos);
+        uint8_t header[5];
+        header[0] = HCI_ACL_DATA_PACKET;
+        little_endian_store_16(header, 1, pos == 4 ? 0x2001 : 0x1001);
+        little_endian_store_16(header, 3, len);
+        stream_add(header, sizeof(header));
+        stream_add(&sdu_pattern[pos], len);
+        stream_num_packets++;
+    }
+    uint32_t sdu_stream_len = stream_len;
+    int fragments_per_sdu = stream_num_packets;
+
+    received_reset();
+    transport_config.device_name = pty_slave_name;
+    transport_setup(btstack_uart_block_posix_instance());
+
+#ifdef HAVE_WRAP_SYSCALLS
+    write_syscalls = 0;
+#endif
+    pty_expected_len = sdu_stream_len * PTY_NUM_SDUS;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t reader;
+    CHECK_EQUAL(0, pthread_create(&reader, NULL, &pty_reader_thread, NULL));
+
+    int num_packets_sent = 0;
+    int sdu;
+    for (sdu = 0; sdu < PTY_NUM_SDUS; sdu++){
+        // l2cap assembles SDU in HCI packet buffer
+        uint8_t * packet = &sdu_buffer[HCI_OUTGOING_PRE_BUFFER_SIZE];
+        memcpy(packet, sdu_pattern, acl_len);
+        for (pos = 4; pos < acl_len; pos += PTY_ACL_FRAGMENT_LEN){
+            uint16_t acl_header_pos = pos - 4u;
+            uint16_t len = btstack_min(PTY_ACL_FRAGMENT_LEN, acl_len - pos);
+            if (acl_header_pos > 0u){
+                uint16_t handle_and_flags = little_endian_read_16(packet, 0);
+                handle_and_flags = (handle_and_flags & 0xcfffu) | (1u << 12u);
+                little_endian_store_16(packet, acl_header_pos, handle_and_flags);
+            }
+            little_endian_store_16(packet, acl_header_pos + 2u, len);
+            CHECK_EQUAL(0, transport->send_packet(HCI_ACL_DATA_PACKET, &packet[acl_header_pos], len + 4));
+            num_packets_sent++;
+            pty_wait_packet_sent(num_packets_sent);
+        }
+    }
+
+    pthread_join(reader, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    transport->close();
+
+    CHECK_EQUAL(pty_expected_len, received_len);
+    for (sdu = 0; sdu < PTY_NUM_SDUS; sdu++){
+        MEMCMP_EQUAL(stream, &received[sdu * sdu_stream_len], sdu_stream_len);
+    }
+
+    double duration_s = timespec_diff_s(&start, &end);
+    printf("H4 pty tx: %u SDUs of %u bytes, %u fragments, %6.1f MB/s", PTY_NUM_SDUS, PTY_SDU_LEN,
+           (unsigned int) (fragments_per_sdu * PTY_NUM_SDUS), (double) pty_expected_len / duration_s / 1e6);
+#ifdef HAVE_WRAP_SYSCALLS
+    printf(", %u write() calls", write_syscalls);
+#endif
+    printf("\n");
+}
+
+TEST(H4Pty, SendLargeSdu){
+    pty_send_sdus();
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
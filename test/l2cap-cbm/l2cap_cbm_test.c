@@ -0,0 +1,1273 @@
+// *****************************************************************************
+//
+// L2CAP LE Data Channels with simulated LE peer and virtual time:
+// LE Credit Based Flow Control Mode vs. Enhanced Credit Based Flow Control Mode,
+// automatic credits for incoming K-Frames vs. credits provided by application
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+#include "l2cap_signaling.h"
+
+// LE connection created by hci_setup_test_connections_fuzz
+#define CON_HANDLE          0x0005
+#define TEST_PSM            0x0081
+#define PEER_CID_BASE       0x0080
+#define NUM_CHANNELS        L2CAP_ECBM_MAX_CHANNELS
+#define SDU_LEN             600
+#define MTU                 1000
+#define ACL_PACKETS_NUM     8
+#define MAX_FRAMES_IN_FLIGHT 4096
+#define MAX_FRAME_SIZE      300
+#define PEER_MAX_K_FRAME    247
+#define TIME_LIMIT_MS       1000000
+// L2CAP_LE_DATA_CHANNELS_CREDIT_BUDGET
+#define CREDIT_BUDGET       16384
+
+// virtual time run loop
+
+static uint32_t virtual_time_ms;
+
+static void run_loop_virtual_init(void){
+    btstack_run_loop_base_init();
+    virtual_time_ms = 0;
+}
+
+static void run_loop_virtual_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = virtual_time_ms + timeout_in_ms;
+}
+
+static uint32_t run_loop_virtual_get_time_ms(void){
+    return virtual_time_ms;
+}
+
+static const btstack_run_loop_t run_loop_virtual = {
+    &run_loop_virtual_init,
+    &btstack_run_loop_base_add_data_source,
+    &btstack_run_loop_base_remove_data_source,
+    &btstack_run_loop_base_enable_data_source_callbacks,
+    &btstack_run_loop_base_disable_data_source_callbacks,
+    &run_loop_virtual_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    NULL,
+    &btstack_run_loop_base_dump_timer,
+    &run_loop_virtual_get_time_ms,
+};
+
+// link: one ACL packet per ms, arrives after the one-way latency
+
+typedef struct {
+    uint32_t arrival_ms;
+    uint16_t len;
+    uint8_t  data[MAX_FRAME_SIZE];
+} frame_t;
+
+typedef struct {
+    frame_t  frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t head;
+    uint32_t tail;
+} frame_queue_t;
+
+static void frame_queue_reset(frame_queue_t * queue){
+    queue->head = 0;
+    queue->tail = 0;
+}
+
+static bool frame_queue_empty(const frame_queue_t * queue){
+    return queue->head == queue->tail;
+}
+
+static uint32_t frame_queue_len(const frame_queue_t * queue){
+    return queue->tail - queue->head;
+}
+
+static void frame_queue_push(frame_queue_t * queue, uint32_t arrival_ms, const uint8_t * data, uint16_t len){
+    CHECK(len <= MAX_FRAME_SIZE);
+    CHECK((queue->tail - queue->head) < MAX_FRAMES_IN_FLIGHT);
+    frame_t * frame = &queue->frames[queue->tail % MAX_FRAMES_IN_FLIGHT];
+    frame->arrival_ms = arrival_ms;
+    frame->len = len;
+    memcpy(frame->data, data, len);
+    queue->tail++;
+}
+
+static frame_t * frame_queue_peek(frame_queue_t * queue){
+    if (frame_queue_empty(queue)) return NULL;
+    return &queue->frames[queue->head % MAX_FRAMES_IN_FLIGHT];
+}
+
+static frame_t * frame_queue_get(frame_queue_t * queue, uint32_t index){
+    return &queue->frames[(queue->head + index) % MAX_FRAMES_IN_FLIGHT];
+}
+
+static void frame_queue_pop(frame_queue_t * queue){
+    queue->head++;
+}
+
+// BTstack -> controller, controller -> peer, peer -> BTstack
+static frame_queue_t controller_queue;
+static frame_queue_t to_peer;
+static frame_queue_t to_btstack;
+
+static uint32_t link_latency_ms;
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// peer
+
+typedef struct {
+    uint16_t cid;
+    uint16_t btstack_cid;
+    // data received from BTstack
+    uint16_t sdu_len;
+    uint16_t sdu_pos;
+    uint32_t num_sdus_received;
+    uint32_t num_bytes_received;
+    uint32_t num_k_frames_received;
+    uint16_t max_k_frame_payload;
+    uint16_t credits_to_return;
+    bool     sdu_error;
+    // data sent to BTstack
+    uint16_t send_sdu_pos;
+    uint16_t send_credits;
+    uint16_t send_credits_max;
+    uint32_t send_k_frames;
+    uint32_t send_starved_ms;
+} peer_channel_t;
+
+typedef struct {
+    // config
+    uint16_t mtu;
+    uint16_t mps;
+    uint16_t initial_credits;
+    uint16_t credit_batch;
+    uint8_t  num_accepted;
+    bool     reject_ecbm;
+    uint16_t reconfigure_result;
+    // BTstack receive parameters
+    uint16_t btstack_mtu;
+    uint16_t btstack_mps;
+    uint16_t btstack_credits;
+    // channels
+    uint8_t  num_channels;
+    peer_channel_t channels[NUM_CHANNELS];
+    uint8_t  next_sig_id;
+    // signaling PDUs
+    uint32_t num_signaling_sent;
+    uint32_t num_signaling_received;
+    uint8_t  last_code;
+    uint8_t  last_sig_id;
+    uint16_t last_len;
+    uint8_t  last_data[64];
+    uint16_t last_credit_cid;
+    uint16_t last_credits;
+} peer_t;
+
+static peer_t peer;
+
+// application
+
+typedef struct {
+    uint16_t cid;
+    bool     open;
+    bool     busy;
+    uint32_t num_sdus_sent;
+    uint8_t  sdu[SDU_LEN];
+    uint8_t  receive_buffer[MTU];
+} app_channel_t;
+
+static app_channel_t app_channels[NUM_CHANNELS];
+static uint8_t  * app_receive_buffers[NUM_CHANNELS];
+static uint8_t  app_num_channels;
+static uint32_t app_sdus_per_channel;
+static uint8_t  app_num_accept;
+static uint16_t app_num_open_failed;
+static uint16_t app_last_open_status;
+static uint8_t  app_incoming_num_channels;
+static uint16_t app_incoming_remote_mtu;
+static uint32_t app_num_data_packets_received;
+static uint16_t app_last_data_packet_len;
+static uint16_t app_reconfigured_mtu;
+static uint16_t app_reconfigured_mps;
+static uint8_t  app_num_reconfigured;
+static uint16_t app_reconfiguration_result;
+static bool     app_reconfiguration_complete;
+static uint16_t app_initial_credits;
+static uint16_t app_credits_per_sdu;
+static bool     app_disconnect_on_packet_sent;
+
+static uint8_t sdu_byte(uint8_t channel_index, uint32_t sdu_index, uint32_t pos){
+    return (uint8_t) (channel_index * 31 + sdu_index * 7 + pos);
+}
+
+static void peer_send_acl(uint16_t cid, const uint8_t * payload, uint16_t len){
+    uint8_t packet[MAX_FRAME_SIZE];
+    little_endian_store_16(packet, 0, CON_HANDLE | (2u << 12));
+    little_endian_store_16(packet, 2, 4 + len);
+    little_endian_store_16(packet, 4, len);
+    little_endian_store_16(packet, 6, cid);
+    memcpy(&packet[8], payload, len);
+    frame_queue_push(&to_btstack, virtual_time_ms + link_latency_ms, packet, 8 + len);
+}
+
+static void peer_send_signaling(uint8_t code, uint8_t sig_id, const uint8_t * data, uint16_t len){
+    uint8_t command[64];
+    command[0] = code;
+    command[1] = sig_id;
+    little_endian_store_16(command, 2, len);
+    memcpy(&command[4], data, len);
+    peer.num_signaling_sent++;
+    peer_send_acl(L2CAP_CID_SIGNALING_LE, command, 4 + len);
+}
+
+static peer_channel_t * peer_add_channel(uint16_t btstack_cid){
+    CHECK(peer.num_channels < NUM_CHANNELS);
+    peer_channel_t * channel = &peer.channels[peer.num_channels];
+    memset(channel, 0, sizeof(peer_channel_t));
+    channel->cid = PEER_CID_BASE + peer.num_channels;
+    channel->btstack_cid = btstack_cid;
+    peer.num_channels++;
+    return channel;
+}
+
+static peer_channel_t * peer_get_channel(uint16_t cid){
+    uint8_t i;
+    for (i=0;i<peer.num_channels;i++){
+        if (peer.channels[i].cid == cid) return &peer.channels[i];
+    }
+    return NULL;
+}
+
+static void peer_send_credits(peer_channel_t * channel, uint16_t credits){
+    // cid is the source cid of the device that grants the credits
+    uint8_t data[4];
+    little_endian_store_16(data, 0, channel->cid);
+    little_endian_store_16(data, 2, credits);
+    peer_send_signaling(LE_FLOW_CONTROL_CREDIT, peer.next_sig_id++, data, 4);
+}
+
+// request channels from BTstack
+static void peer_send_ecbm_connection_request(uint16_t psm, uint16_t mtu, uint16_t mps, uint8_t num_cids, const uint16_t * source_cids){
+    uint8_t data[8 + 2 * 8];
+    little_endian_store_16(data, 0, psm);
+    little_endian_store_16(data, 2, mtu);
+    little_endian_store_16(data, 4, mps);
+    little_endian_store_16(data, 6, peer.initial_credits);
+    uint8_t i;
+    for (i=0;i<num_cids;i++){
+        little_endian_store_16(data, 8 + 2 * i, source_cids[i]);
+    }
+    peer_send_signaling(CREDIT_BASED_CONNECTION_REQUEST, peer.next_sig_id++, data, 8 + 2 * num_cids);
+}
+
+static void peer_send_reconfigure_request(uint16_t mtu, uint16_t mps, uint8_t num_cids, const uint16_t * cids){
+    uint8_t data[4 + 2 * 8];
+    little_endian_store_16(data, 0, mtu);
+    little_endian_store_16(data, 2, mps);
+    uint8_t i;
+    for (i=0;i<num_cids;i++){
+        little_endian_store_16(data, 4 + 2 * i, cids[i]);
+    }
+    peer_send_signaling(CREDIT_BASED_RECONFIGURE_REQUEST, peer.next_sig_id++, data, 4 + 2 * num_cids);
+}
+
+// send SDU to BTstack in K-Frames of BTstack's MPS or smaller
+static void peer_send_sdu(peer_channel_t * channel, const uint8_t * sdu, uint16_t len){
+    uint8_t k_frame[MAX_FRAME_SIZE];
+    uint16_t sdu_pos = 0;
+    bool first = true;
+    while (first || (sdu_pos < len)){
+        uint16_t pos = 0;
+        if (first){
+            little_endian_store_16(k_frame, 0, len);
+            pos = 2;
+            first = false;
+        }
+        uint16_t payload_size = btstack_min(len - sdu_pos, btstack_min(peer.btstack_mps, PEER_MAX_K_FRAME) - pos);
+        memcpy(&k_frame[pos], &sdu[sdu_pos], payload_size);
+        sdu_pos += payload_size;
+        peer_send_acl(channel->btstack_cid, k_frame, pos + payload_size);
+    }
+}
+
+// send one K-Frame of SDU_LEN byte SDUs per ms while credits are available
+static void peer_stream_step(peer_channel_t * channel){
+    if (channel->send_k_frames == 0) return;
+    if (channel->send_credits == 0){
+        channel->send_starved_ms++;
+        return;
+    }
+    uint8_t k_frame[MAX_FRAME_SIZE];
+    uint16_t pos = 0;
+    if (channel->send_sdu_pos == 0){
+        little_endian_store_16(k_frame, 0, SDU_LEN);
+        pos = 2;
+    }
+    uint16_t payload_size = btstack_min(SDU_LEN - channel->send_sdu_pos, btstack_min(peer.btstack_mps, PEER_MAX_K_FRAME) - pos);
+    memset(&k_frame[pos], 0x55, payload_size);
+    channel->send_sdu_pos += payload_size;
+    if (channel->send_sdu_pos == SDU_LEN){
+        channel->send_sdu_pos = 0;
+    }
+    channel->send_credits--;
+    channel->send_k_frames--;
+    peer_send_acl(channel->btstack_cid, k_frame, pos + payload_size);
+}
+
+static void peer_handle_signaling(const uint8_t * command){
+    uint8_t code   = command[0];
+    uint8_t sig_id = command[1];
+    uint16_t len   = little_endian_read_16(command, 2);
+    const uint8_t * data = &command[4];
+    uint8_t response[8 + 2 * 8];
+    uint8_t i;
+
+    peer.num_signaling_received++;
+    peer.last_code = code;
+    peer.last_sig_id = sig_id;
+    peer.last_len = len;
+    memcpy(peer.last_data, data, btstack_min(len, sizeof(peer.last_data)));
+
+    switch (code){
+        case LE_CREDIT_BASED_CONNECTION_REQUEST: {
+            // psm, source cid, mtu, mps, credits
+            peer.btstack_mtu = little_endian_read_16(data, 4);
+            peer.btstack_mps = little_endian_read_16(data, 6);
+            peer.btstack_credits = little_endian_read_16(data, 8);
+            peer_channel_t * channel = peer_add_channel(little_endian_read_16(data, 2));
+            channel->send_credits = peer.btstack_credits;
+            channel->send_credits_max = peer.btstack_credits;
+            little_endian_store_16(response, 0, channel->cid);
+            little_endian_store_16(response, 2, peer.mtu);
+            little_endian_store_16(response, 4, peer.mps);
+            little_endian_store_16(response, 6, peer.initial_credits);
+            little_endian_store_16(response, 8, 0);
+            peer_send_signaling(LE_CREDIT_BASED_CONNECTION_RESPONSE, sig_id, response, 10);
+            break;
+        }
+        case CREDIT_BASED_CONNECTION_REQUEST: {
+            if (peer.reject_ecbm){
+                // 0x0000 Command not understood
+                little_endian_store_16(response, 0, 0);
+                peer_send_signaling(COMMAND_REJECT, sig_id, response, 2);
+                break;
+            }
+            // spsm, mtu, mps, credits, source cids
+            peer.btstack_mtu = little_endian_read_16(data, 2);
+            peer.btstack_mps = little_endian_read_16(data, 4);
+            peer.btstack_credits = little_endian_read_16(data, 6);
+            uint8_t num_cids = (len - 8) / 2;
+            for (i=0;i<num_cids;i++){
+                uint16_t destination_cid = 0;
+                if (i < peer.num_accepted){
+                    destination_cid = peer_add_channel(little_endian_read_16(data, 8 + 2 * i))->cid;
+                }
+                little_endian_store_16(response, 8 + 2 * i, destination_cid);
+            }
+            little_endian_store_16(response, 0, peer.mtu);
+            little_endian_store_16(response, 2, peer.mps);
+            little_endian_store_16(response, 4, peer.initial_credits);
+            little_endian_store_16(response, 6, (peer.num_accepted >= num_cids) ? 0x0000 : 0x0004);
+            peer_send_signaling(CREDIT_BASED_CONNECTION_RESPONSE, sig_id, response, 8 + 2 * num_cids);
+            break;
+        }
+        case CREDIT_BASED_CONNECTION_RESPONSE: {
+            // mtu, mps, credits, result, destination cids
+            peer.btstack_mtu = little_endian_read_16(data, 0);
+            peer.btstack_mps = little_endian_read_16(data, 2);
+            peer.btstack_credits = little_endian_read_16(data, 4);
+            uint8_t num_cids = (len - 8) / 2;
+            for (i=0;i<num_cids;i++){
+                uint16_t destination_cid = little_endian_read_16(data, 8 + 2 * i);
+                if (destination_cid == 0) continue;
+                peer.channels[i].btstack_cid = destination_cid;
+            }
+            break;
+        }
+        case CREDIT_BASED_RECONFIGURE_REQUEST:
+            peer.btstack_mtu = little_endian_read_16(data, 0);
+            peer.btstack_mps = little_endian_read_16(data, 2);
+            little_endian_store_16(response, 0, peer.reconfigure_result);
+            peer_send_signaling(CREDIT_BASED_RECONFIGURE_RESPONSE, sig_id, response, 2);
+            break;
+        case LE_FLOW_CONTROL_CREDIT:
+            peer.last_credit_cid = little_endian_read_16(data, 0);
+            peer.last_credits = little_endian_read_16(data, 2);
+            for (i=0;i<peer.num_channels;i++){
+                peer_channel_t * channel = &peer.channels[i];
+                if (channel->btstack_cid != peer.last_credit_cid) continue;
+                channel->send_credits += peer.last_credits;
+                channel->send_credits_max = btstack_max(channel->send_credits_max, channel->send_credits);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void peer_handle_k_frame(peer_channel_t * channel, const uint8_t * payload, uint16_t len){
+    channel->num_k_frames_received++;
+    channel->max_k_frame_payload = btstack_max(channel->max_k_frame_payload, len);
+    if (len > peer.mps) channel->sdu_error = true;
+    uint8_t channel_index = (uint8_t) (channel - peer.channels);
+    if (channel->sdu_len == 0){
+        channel->sdu_len = little_endian_read_16(payload, 0);
+        channel->sdu_pos = 0;
+        payload += 2;
+        len -= 2;
+    }
+    uint16_t i;
+    for (i=0;i<len;i++){
+        if (payload[i] != sdu_byte(channel_index, channel->num_sdus_received, channel->sdu_pos + i)){
+            channel->sdu_error = true;
+        }
+    }
+    channel->sdu_pos += len;
+    channel->num_bytes_received += len;
+    if (channel->sdu_pos >= channel->sdu_len){
+        if (channel->sdu_pos != channel->sdu_len) channel->sdu_error = true;
+        channel->sdu_len = 0;
+        channel->num_sdus_received++;
+    }
+    // return credits in batches
+    channel->credits_to_return++;
+    if (channel->credits_to_return >= peer.credit_batch){
+        peer_send_credits(channel, channel->credits_to_return);
+        channel->credits_to_return = 0;
+    }
+}
+
+static void peer_handle_frame(const uint8_t * packet, uint16_t size){
+    uint16_t cid = little_endian_read_16(packet, 6);
+    if (cid == L2CAP_CID_SIGNALING_LE){
+        peer_handle_signaling(&packet[8]);
+        return;
+    }
+    peer_channel_t * channel = peer_get_channel(cid);
+    if (channel != NULL){
+        peer_handle_k_frame(channel, &packet[8], size - 8);
+    }
+}
+
+// SM is not used as all channels use security level 0
+void sm_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    UNUSED(callback_handler);
+}
+
+void sm_request_pairing(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+}
+
+// HCI transport
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_ACL_DATA_PACKET) return 0;
+    frame_queue_push(&controller_queue, 0, packet, (uint16_t) size);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void send_event(const uint8_t * event, uint16_t size){
+    packet_handler(HCI_EVENT_PACKET, (uint8_t *) event, size);
+}
+
+// advance virtual time by 1 ms
+static void link_step(void){
+    // controller sends one ACL packet per ms
+    frame_t * frame = frame_queue_peek(&controller_queue);
+    if (frame != NULL){
+        frame_queue_push(&to_peer, virtual_time_ms + link_latency_ms, frame->data, frame->len);
+        frame_queue_pop(&controller_queue);
+        uint8_t number_of_completed_packets[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0 };
+        little_endian_store_16(number_of_completed_packets, 3, CON_HANDLE);
+        send_event(number_of_completed_packets, sizeof(number_of_completed_packets));
+    }
+    // peer
+    while (true){
+        frame = frame_queue_peek(&to_peer);
+        if ((frame == NULL) || (frame->arrival_ms > virtual_time_ms)) break;
+        peer_handle_frame(frame->data, frame->len);
+        frame_queue_pop(&to_peer);
+    }
+    uint8_t i;
+    for (i=0;i<peer.num_channels;i++){
+        peer_stream_step(&peer.channels[i]);
+    }
+    // BTstack
+    while (true){
+        frame = frame_queue_peek(&to_btstack);
+        if ((frame == NULL) || (frame->arrival_ms > virtual_time_ms)) break;
+        uint8_t packet[MAX_FRAME_SIZE];
+        uint16_t len = frame->len;
+        memcpy(packet, frame->data, len);
+        frame_queue_pop(&to_btstack);
+        packet_handler(HCI_ACL_DATA_PACKET, packet, len);
+    }
+    btstack_run_loop_base_process_timers(virtual_time_ms);
+    virtual_time_ms++;
+}
+
+static void link_run(uint32_t duration_ms){
+    uint32_t end_ms = virtual_time_ms + duration_ms;
+    while (virtual_time_ms < end_ms){
+        link_step();
+    }
+}
+
+// application
+
+static app_channel_t * app_get_channel(uint16_t cid){
+    uint8_t i;
+    for (i=0;i<app_num_channels;i++){
+        if (app_channels[i].cid == cid) return &app_channels[i];
+    }
+    return NULL;
+}
+
+static void app_send_sdu(uint8_t channel_index){
+    app_channel_t * channel = &app_channels[channel_index];
+    if (!channel->open || channel->busy) return;
+    if (channel->num_sdus_sent >= app_sdus_per_channel) return;
+    uint16_t i;
+    for (i=0;i<SDU_LEN;i++){
+        channel->sdu[i] = sdu_byte(channel_index, channel->num_sdus_sent, i);
+    }
+    channel->busy = true;
+    channel->num_sdus_sent++;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_send_data(channel->cid, channel->sdu, SDU_LEN));
+}
+
+static void l2cap_channel_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    app_channel_t * app_channel;
+    if (packet_type == L2CAP_DATA_PACKET){
+        app_num_data_packets_received++;
+        app_last_data_packet_len = size;
+        if (app_credits_per_sdu != 0){
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_provide_credits(channel, app_credits_per_sdu));
+        }
+        return;
+    }
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case L2CAP_EVENT_ECBM_INCOMING_CONNECTION:
+            app_incoming_num_channels = l2cap_event_ecbm_incoming_connection_get_num_channels(packet);
+            app_incoming_remote_mtu = l2cap_event_ecbm_incoming_connection_get_remote_mtu(packet);
+            if (app_num_accept == 0){
+                // 0x0004 All connections refused – insufficient resources available
+                CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_ecbm_decline_channels(l2cap_event_ecbm_incoming_connection_get_local_cid(packet), 0x0004));
+                break;
+            }
+            // accepted channels are added on open as the response is sent right away
+            app_num_channels = 0;
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_ecbm_accept_channels(l2cap_event_ecbm_incoming_connection_get_local_cid(packet), app_num_accept,
+                        L2CAP_LE_AUTOMATIC_CREDITS, MTU, app_receive_buffers, NULL));
+            break;
+        case L2CAP_EVENT_LE_CHANNEL_OPENED:
+            app_last_open_status = l2cap_event_le_channel_opened_get_status(packet);
+            if (app_last_open_status != ERROR_CODE_SUCCESS){
+                app_num_open_failed++;
+                break;
+            }
+            app_channel = app_get_channel(l2cap_event_le_channel_opened_get_local_cid(packet));
+            if (app_channel == NULL){
+                // incoming channel
+                CHECK(app_num_channels < NUM_CHANNELS);
+                app_channel = &app_channels[app_num_channels++];
+                app_channel->cid = l2cap_event_le_channel_opened_get_local_cid(packet);
+            }
+            app_channel->open = true;
+            app_send_sdu((uint8_t) (app_channel - app_channels));
+            break;
+        case L2CAP_EVENT_LE_PACKET_SENT:
+            app_channel = app_get_channel(l2cap_event_le_packet_sent_get_local_cid(packet));
+            CHECK(app_channel != NULL);
+            app_channel->busy = false;
+            if (app_disconnect_on_packet_sent){
+                CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_disconnect(app_channel->cid));
+                break;
+            }
+            app_send_sdu((uint8_t) (app_channel - app_channels));
+            break;
+        case L2CAP_EVENT_ECBM_RECONFIGURED:
+            app_num_reconfigured++;
+            app_reconfigured_mtu = l2cap_event_ecbm_reconfigured_get_remote_mtu(packet);
+            app_reconfigured_mps = l2cap_event_ecbm_reconfigured_get_remote_mps(packet);
+            break;
+        case L2CAP_EVENT_ECBM_RECONFIGURATION_COMPLETE:
+            app_reconfiguration_complete = true;
+            app_reconfiguration_result = l2cap_event_ecbm_reconfiguration_complete_get_result(packet);
+            break;
+        default:
+            break;
+    }
+}
+
+static uint8_t app_num_channels_open(void){
+    uint8_t num_open = 0;
+    uint8_t i;
+    for (i=0;i<app_num_channels;i++){
+        if (app_channels[i].open) num_open++;
+    }
+    return num_open;
+}
+
+static bool stack_active;
+
+static void stack_setup(uint16_t peer_mps){
+    stack_active = true;
+    memset(&peer, 0, sizeof(peer));
+    peer.mtu = MTU;
+    peer.mps = peer_mps;
+    peer.initial_credits = 10;
+    peer.credit_batch = 5;
+    peer.num_accepted = NUM_CHANNELS;
+    peer.next_sig_id = 0x80;
+
+    memset(app_channels, 0, sizeof(app_channels));
+    uint8_t i;
+    for (i=0;i<NUM_CHANNELS;i++){
+        app_receive_buffers[i] = app_channels[i].receive_buffer;
+    }
+    app_num_channels = 0;
+    app_sdus_per_channel = 0;
+    app_num_accept = NUM_CHANNELS;
+    app_num_open_failed = 0;
+    app_last_open_status = 0;
+    app_incoming_num_channels = 0;
+    app_num_data_packets_received = 0;
+    app_num_reconfigured = 0;
+    app_reconfiguration_complete = false;
+    app_initial_credits = L2CAP_LE_AUTOMATIC_CREDITS;
+    app_credits_per_sdu = 0;
+    app_disconnect_on_packet_sent = false;
+
+    frame_queue_reset(&controller_queue);
+    frame_queue_reset(&to_peer);
+    frame_queue_reset(&to_btstack);
+
+    btstack_memory_init();
+    btstack_run_loop_init(&run_loop_virtual);
+    hci_init(&hci_transport_test, NULL);
+    hci_power_control(HCI_POWER_ON);
+    hci_simulate_working_fuzz();
+    hci_setup_test_connections_fuzz();
+    // HCI Read Buffer Size: ACL 1021 bytes, ACL_PACKETS_NUM packets shared with LE
+    uint8_t read_buffer_size_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 11, 1, 0x05, 0x10, 0, 0xfd, 0x03, 0x40, ACL_PACKETS_NUM, 0x00, 0x04, 0x00 };
+    send_event(read_buffer_size_complete, sizeof(read_buffer_size_complete));
+    l2cap_init();
+    l2cap_le_register_service(&l2cap_channel_packet_handler, TEST_PSM, LEVEL_0);
+}
+
+static void stack_teardown(void){
+    stack_active = false;
+    // disconnect closes L2CAP channels
+    uint8_t disconnection_complete[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, 0, 0, 0x13 };
+    little_endian_store_16(disconnection_complete, 3, CON_HANDLE);
+    send_event(disconnection_complete, sizeof(disconnection_complete));
+    l2cap_le_unregister_service(TEST_PSM);
+    hci_free_connections_fuzz();
+    l2cap_deinit();
+    hci_deinit();
+    btstack_memory_deinit();
+    btstack_run_loop_deinit();
+}
+
+static void run_until_open(uint8_t num_channels){
+    uint32_t start_ms = virtual_time_ms;
+    while ((app_num_channels_open() + app_num_open_failed) < num_channels){
+        CHECK(virtual_time_ms < (start_ms + 1000));
+        link_step();
+    }
+}
+
+// outgoing channels: one ECBM request or one LE Credit Based Connection Request per channel
+static void app_create_channels(bool ecbm, uint8_t num_channels){
+    uint16_t local_cids[NUM_CHANNELS];
+    app_num_channels = num_channels;
+    if (ecbm){
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_ecbm_create_channels(&l2cap_channel_packet_handler, CON_HANDLE, LEVEL_0, TEST_PSM,
+                    num_channels, app_initial_credits, MTU, app_receive_buffers, local_cids));
+    } else {
+        uint8_t i;
+        for (i=0;i<num_channels;i++){
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_create_channel(&l2cap_channel_packet_handler, CON_HANDLE, TEST_PSM, app_receive_buffers[i],
+                        MTU, app_initial_credits, LEVEL_0, &local_cids[i]));
+        }
+    }
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        app_channels[i].cid = local_cids[i];
+    }
+}
+
+static uint16_t peer_cids(uint16_t * cids){
+    uint8_t i;
+    for (i=0;i<peer.num_channels;i++){
+        cids[i] = peer.channels[i].cid;
+    }
+    return peer.num_channels;
+}
+
+TEST_GROUP(L2capEcbm){
+    void setup(void){
+        link_latency_ms = 5;
+        stack_setup(64);
+    }
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(L2capEcbm, OutgoingChannelsInSingleRequest){
+    app_create_channels(true, NUM_CHANNELS);
+    run_until_open(NUM_CHANNELS);
+    CHECK_EQUAL(NUM_CHANNELS, app_num_channels_open());
+    // one request with all source cids, no credits sent yet
+    CHECK_EQUAL(1, peer.num_signaling_received);
+    CHECK_EQUAL(NUM_CHANNELS, peer.num_channels);
+    CHECK_EQUAL(MTU, peer.btstack_mtu);
+    uint8_t i;
+    for (i=0;i<NUM_CHANNELS;i++){
+        CHECK_EQUAL(app_channels[i].cid, peer.channels[i].btstack_cid);
+    }
+}
+
+TEST(L2capEcbm, OutgoingInvalidParameters){
+    uint16_t local_cids[NUM_CHANNELS + 1];
+    uint8_t * receive_buffers[NUM_CHANNELS + 1];
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, l2cap_ecbm_create_channels(&l2cap_channel_packet_handler, CON_HANDLE, LEVEL_0, TEST_PSM,
+                NUM_CHANNELS + 1, 10, MTU, receive_buffers, local_cids));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, l2cap_ecbm_create_channels(&l2cap_channel_packet_handler, CON_HANDLE, LEVEL_0, TEST_PSM,
+                1, 10, L2CAP_ECBM_MIN_MTU - 1, receive_buffers, local_cids));
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, l2cap_ecbm_create_channels(&l2cap_channel_packet_handler, 0x0123, LEVEL_0, TEST_PSM,
+                1, 10, MTU, receive_buffers, local_cids));
+    // MPS follows max LE MTU and has to be at least 64
+    l2cap_set_max_le_mtu(L2CAP_ECBM_MIN_MTU - 1);
+    CHECK_EQUAL(ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE, l2cap_ecbm_create_channels(&l2cap_channel_packet_handler, CON_HANDLE, LEVEL_0, TEST_PSM,
+                1, 10, MTU, receive_buffers, local_cids));
+}
+
+TEST(L2capEcbm, OutgoingSomeRefused){
+    peer.num_accepted = 3;
+    app_create_channels(true, NUM_CHANNELS);
+    run_until_open(NUM_CHANNELS);
+    CHECK_EQUAL(3, app_num_channels_open());
+    CHECK_EQUAL(2, app_num_open_failed);
+    CHECK_EQUAL(0x0004, app_last_open_status);
+    // refused channels are gone
+    CHECK_EQUAL(L2CAP_LOCAL_CID_DOES_NOT_EXIST, l2cap_le_send_data(app_channels[4].cid, app_channels[4].sdu, 10));
+}
+
+TEST(L2capEcbm, OutgoingRejectedByLegacyPeer){
+    peer.reject_ecbm = true;
+    app_create_channels(true, NUM_CHANNELS);
+    run_until_open(NUM_CHANNELS);
+    CHECK_EQUAL(0, app_num_channels_open());
+    CHECK_EQUAL(NUM_CHANNELS, app_num_open_failed);
+    CHECK_EQUAL(0x0002, app_last_open_status);
+}
+
+TEST(L2capEcbm, IncomingSomeAccepted){
+    app_num_accept = 2;
+    uint16_t source_cids[] = { 0x0040, 0x0041, 0x0042 };
+    peer.initial_credits = 4;
+    peer_send_ecbm_connection_request(TEST_PSM, 200, 100, 3, source_cids);
+    link_run(20);
+    CHECK_EQUAL(3, app_incoming_num_channels);
+    CHECK_EQUAL(200, app_incoming_remote_mtu);
+    CHECK_EQUAL(2, app_num_channels_open());
+    CHECK_EQUAL(CREDIT_BASED_CONNECTION_RESPONSE, peer.last_code);
+    CHECK_EQUAL(14, peer.last_len);
+    CHECK_EQUAL(MTU, little_endian_read_16(peer.last_data, 0));
+    CHECK_EQUAL(0x0004, little_endian_read_16(peer.last_data, 6));
+    CHECK_EQUAL(app_channels[0].cid, little_endian_read_16(peer.last_data, 8));
+    CHECK_EQUAL(app_channels[1].cid, little_endian_read_16(peer.last_data, 10));
+    CHECK_EQUAL(0, little_endian_read_16(peer.last_data, 12));
+
+    // peer sends SDU over second channel
+    uint8_t sdu[300];
+    memset(sdu, 0x55, sizeof(sdu));
+    peer_channel_t * channel = peer_add_channel(app_channels[1].cid);
+    peer_send_sdu(channel, sdu, sizeof(sdu));
+    link_run(20);
+    CHECK_EQUAL(1, app_num_data_packets_received);
+    CHECK_EQUAL(300, app_last_data_packet_len);
+}
+
+TEST(L2capEcbm, IncomingDeclined){
+    app_num_accept = 0;
+    uint16_t source_cids[] = { 0x0040, 0x0041 };
+    peer_send_ecbm_connection_request(TEST_PSM, 200, 100, 2, source_cids);
+    link_run(20);
+    CHECK_EQUAL(2, app_incoming_num_channels);
+    CHECK_EQUAL(0, app_num_channels_open());
+    CHECK_EQUAL(CREDIT_BASED_CONNECTION_RESPONSE, peer.last_code);
+    CHECK_EQUAL(12, peer.last_len);
+    CHECK_EQUAL(0x0004, little_endian_read_16(peer.last_data, 6));
+    CHECK_EQUAL(0, little_endian_read_16(peer.last_data, 8));
+    CHECK_EQUAL(0, little_endian_read_16(peer.last_data, 10));
+}
+
+static uint16_t incoming_request_result(uint16_t psm, uint16_t mtu, uint16_t mps, uint8_t num_cids, const uint16_t * source_cids){
+    peer.last_code = 0;
+    peer_send_ecbm_connection_request(psm, mtu, mps, num_cids, source_cids);
+    link_run(20);
+    CHECK_EQUAL(CREDIT_BASED_CONNECTION_RESPONSE, peer.last_code);
+    // all destination cids are 0x0000 if all channels are refused
+    uint8_t i;
+    for (i=0;i<num_cids;i++){
+        CHECK_EQUAL(0, little_endian_read_16(peer.last_data, 8 + 2 * i));
+    }
+    return little_endian_read_16(peer.last_data, 6);
+}
+
+TEST(L2capEcbm, IncomingRefused){
+    uint16_t source_cids[] = { 0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045 };
+    uint16_t duplicate_cids[] = { 0x0040, 0x0040 };
+    uint16_t invalid_cids[] = { 0x0040, 0x0005 };
+    // SPSM not supported
+    CHECK_EQUAL(0x0002, incoming_request_result(0x0083, 200, 100, 2, source_cids));
+    // invalid parameters: MTU, MPS, more than five channels
+    CHECK_EQUAL(0x000c, incoming_request_result(TEST_PSM, L2CAP_ECBM_MIN_MTU - 1, 100, 2, source_cids));
+    CHECK_EQUAL(0x000c, incoming_request_result(TEST_PSM, 200, L2CAP_ECBM_MIN_MTU - 1, 2, source_cids));
+    CHECK_EQUAL(0x000c, incoming_request_result(TEST_PSM, 200, 100, 6, source_cids));
+    // invalid and duplicate source cids
+    CHECK_EQUAL(0x0009, incoming_request_result(TEST_PSM, 200, 100, 2, invalid_cids));
+    CHECK_EQUAL(0x000a, incoming_request_result(TEST_PSM, 200, 100, 2, duplicate_cids));
+    CHECK_EQUAL(0, app_incoming_num_channels);
+    // source cid already in use
+    app_num_accept = 1;
+    peer_send_ecbm_connection_request(TEST_PSM, 200, 100, 1, source_cids);
+    link_run(20);
+    CHECK_EQUAL(1, app_num_channels_open());
+    CHECK_EQUAL(0x000a, incoming_request_result(TEST_PSM, 200, 100, 1, source_cids));
+}
+
+TEST(L2capEcbm, ReconfigureByPeer){
+    app_create_channels(true, 2);
+    run_until_open(2);
+    uint16_t cids[NUM_CHANNELS];
+    uint8_t num_cids = peer_cids(cids);
+    uint16_t unknown_cids[] = { 0x0090 };
+
+    // reduction of MTU not allowed
+    peer_send_reconfigure_request(MTU - 1, 100, num_cids, cids);
+    link_run(20);
+    CHECK_EQUAL(CREDIT_BASED_RECONFIGURE_RESPONSE, peer.last_code);
+    CHECK_EQUAL(0x0001, little_endian_read_16(peer.last_data, 0));
+    // unknown channel
+    peer_send_reconfigure_request(MTU, 100, 1, unknown_cids);
+    link_run(20);
+    CHECK_EQUAL(0x0003, little_endian_read_16(peer.last_data, 0));
+    // invalid MPS
+    peer_send_reconfigure_request(MTU, L2CAP_ECBM_MIN_MTU - 1, 1, cids);
+    link_run(20);
+    CHECK_EQUAL(0x0004, little_endian_read_16(peer.last_data, 0));
+    CHECK_EQUAL(0, app_num_reconfigured);
+
+    // larger MPS for both channels
+    peer.mps = 247;
+    peer_send_reconfigure_request(MTU, peer.mps, num_cids, cids);
+    link_run(20);
+    CHECK_EQUAL(0x0000, little_endian_read_16(peer.last_data, 0));
+    CHECK_EQUAL(2, app_num_reconfigured);
+    CHECK_EQUAL(MTU, app_reconfigured_mtu);
+    CHECK_EQUAL(247, app_reconfigured_mps);
+
+    // reduction of MPS only allowed for a single channel
+    peer_send_reconfigure_request(MTU, 100, num_cids, cids);
+    link_run(20);
+    CHECK_EQUAL(0x0002, little_endian_read_16(peer.last_data, 0));
+    peer_send_reconfigure_request(MTU, 100, 1, &cids[1]);
+    link_run(20);
+    CHECK_EQUAL(0x0000, little_endian_read_16(peer.last_data, 0));
+    CHECK_EQUAL(3, app_num_reconfigured);
+    CHECK_EQUAL(100, app_reconfigured_mps);
+
+    // larger MPS is used for next SDU
+    app_sdus_per_channel = 1;
+    app_send_sdu(0);
+    link_run(50);
+    CHECK_EQUAL(1, peer.channels[0].num_sdus_received);
+    CHECK_EQUAL(3, peer.channels[0].num_k_frames_received);
+    CHECK_EQUAL(247, peer.channels[0].max_k_frame_payload);
+    CHECK_FALSE(peer.channels[0].sdu_error);
+}
+
+TEST(L2capEcbm, ReconfigureByBTstack){
+    app_create_channels(true, 2);
+    run_until_open(2);
+    static uint8_t larger_buffers[2][2 * MTU];
+    uint8_t * receive_buffers[] = { larger_buffers[0], larger_buffers[1] };
+    uint16_t local_cids[] = { app_channels[0].cid, app_channels[1].cid };
+
+    // MTU cannot be reduced
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, l2cap_ecbm_reconfigure_channels(2, local_cids, MTU - 1, receive_buffers));
+
+    // rejected by peer
+    peer.reconfigure_result = 0x0004;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_ecbm_reconfigure_channels(2, local_cids, 2 * MTU, receive_buffers));
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, l2cap_ecbm_reconfigure_channels(2, local_cids, 2 * MTU, receive_buffers));
+    link_run(20);
+    CHECK(app_reconfiguration_complete);
+    CHECK_EQUAL(0x0004, app_reconfiguration_result);
+    CHECK_EQUAL(CREDIT_BASED_RECONFIGURE_REQUEST, peer.last_code);
+    CHECK_EQUAL(8, peer.last_len);
+    CHECK_EQUAL(2 * MTU, little_endian_read_16(peer.last_data, 0));
+    CHECK_EQUAL(local_cids[0], little_endian_read_16(peer.last_data, 4));
+    CHECK_EQUAL(local_cids[1], little_endian_read_16(peer.last_data, 6));
+
+    // credit budget in K-Frames of MPS, which follows MTU up to max LE MTU
+    l2cap_le_credit_statistics_t statistics;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_set_credit_budget(local_cids[0], 4000));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_get_credit_statistics(local_cids[0], &statistics));
+    CHECK_EQUAL(4000 / MTU, statistics.credits_budget);
+
+    // accepted by peer: SDU larger than old MTU is received
+    peer.reconfigure_result = 0;
+    app_reconfiguration_complete = false;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_ecbm_reconfigure_channels(2, local_cids, 2 * MTU, receive_buffers));
+    link_run(20);
+    CHECK(app_reconfiguration_complete);
+    CHECK_EQUAL(0, app_reconfiguration_result);
+    // budget recomputed for new MPS
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_get_credit_statistics(local_cids[0], &statistics));
+    CHECK_EQUAL(4000 / l2cap_max_le_mtu(), statistics.credits_budget);
+    static uint8_t sdu[2 * MTU];
+    memset(sdu, 0x55, sizeof(sdu));
+    peer_send_sdu(&peer.channels[1], sdu, sizeof(sdu));
+    link_run(50);
+    CHECK_EQUAL(1, app_num_data_packets_received);
+    CHECK_EQUAL(2 * MTU, app_last_data_packet_len);
+}
+
+TEST(L2capEcbm, CreditCidIsSourceCid){
+    app_num_channels = 1;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_ecbm_create_channels(&l2cap_channel_packet_handler, CON_HANDLE, LEVEL_0, TEST_PSM,
+                1, 10, MTU, app_receive_buffers, &app_channels[0].cid));
+    run_until_open(1);
+    CHECK_EQUAL(10, peer.btstack_credits);
+    // BTstack grants credits for its own cid
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_provide_credits(app_channels[0].cid, 5));
+    link_run(20);
+    CHECK_EQUAL(LE_FLOW_CONTROL_CREDIT, peer.last_code);
+    CHECK_EQUAL(app_channels[0].cid, peer.last_credit_cid);
+    CHECK_EQUAL(5, peer.last_credits);
+
+    // peer grants credits for its own cid: BTstack can send after running out of credits
+    peer.credit_batch = 0xffff;
+    app_sdus_per_channel = 2;
+    app_send_sdu(0);
+    link_run(50);
+    // 600 bytes + SDU length in 10 K-Frames of 64 bytes, second SDU blocked
+    CHECK_EQUAL(10, peer.channels[0].num_k_frames_received);
+    CHECK_EQUAL(1, peer.channels[0].num_sdus_received);
+    peer_send_credits(&peer.channels[0], 10);
+    link_run(50);
+    CHECK_EQUAL(2, peer.channels[0].num_sdus_received);
+    CHECK_FALSE(peer.channels[0].sdu_error);
+}
+
+TEST(L2capEcbm, KFramesPipelined){
+    peer.mps = 247;
+    app_create_channels(true, 1);
+    run_until_open(1);
+    link_run(20);
+    CHECK(frame_queue_empty(&controller_queue));
+    // all K-Frames of the SDU are passed to the controller at once
+    app_sdus_per_channel = 1;
+    app_send_sdu(0);
+    CHECK_EQUAL(3, frame_queue_len(&controller_queue));
+    uint16_t i;
+    for (i=0;i<3;i++){
+        CHECK_EQUAL(peer.channels[0].cid, little_endian_read_16(frame_queue_get(&controller_queue, i)->data, 6));
+    }
+}
+
+TEST(L2capEcbm, DisconnectOnPacketSent){
+    // no further K-Frames are sent after the app closed the channel on L2CAP_EVENT_LE_PACKET_SENT
+    peer.mps = 247;
+    app_sdus_per_channel = 2;
+    app_disconnect_on_packet_sent = true;
+    app_create_channels(true, 1);
+    run_until_open(1);
+    link_run(50);
+    CHECK_EQUAL(1, app_channels[0].num_sdus_sent);
+    CHECK_EQUAL(1, peer.channels[0].num_sdus_received);
+    CHECK_EQUAL(DISCONNECTION_REQUEST, peer.last_code);
+}
+
+// benchmark: NUM_CHANNELS channels, SDU_LEN byte SDUs, peer returns credits in batches
+
+static uint32_t num_signaling_pdus;
+
+static double benchmark(const char * name, bool ecbm, uint16_t peer_mps, uint16_t reconfigure_mps){
+    uint32_t sdus_per_channel = 40;
+    link_latency_ms = 10;
+    stack_setup(peer_mps);
+
+    // setup
+    app_create_channels(ecbm, NUM_CHANNELS);
+    run_until_open(NUM_CHANNELS);
+    CHECK_EQUAL(NUM_CHANNELS, app_num_channels_open());
+    uint32_t setup_ms = virtual_time_ms;
+    if (reconfigure_mps != 0){
+        uint16_t cids[NUM_CHANNELS];
+        uint8_t num_cids = peer_cids(cids);
+        peer.mps = reconfigure_mps;
+        peer_send_reconfigure_request(peer.mtu, peer.mps, num_cids, cids);
+        while (peer.last_code != CREDIT_BASED_RECONFIGURE_RESPONSE){
+            link_step();
+        }
+        CHECK_EQUAL(NUM_CHANNELS, app_num_reconfigured);
+    }
+    num_signaling_pdus = peer.num_signaling_sent + peer.num_signaling_received;
+
+    // transfer
+    uint32_t start_ms = virtual_time_ms;
+    app_sdus_per_channel = sdus_per_channel;
+    uint8_t i;
+    for (i=0;i<NUM_CHANNELS;i++){
+        app_send_sdu(i);
+    }
+    uint32_t num_bytes = 0;
+    uint32_t num_k_frames = 0;
+    while (true){
+        uint32_t num_sdus = 0;
+        for (i=0;i<NUM_CHANNELS;i++){
+            num_sdus += peer.channels[i].num_sdus_received;
+        }
+        if (num_sdus == (NUM_CHANNELS * sdus_per_channel)) break;
+        CHECK(virtual_time_ms < TIME_LIMIT_MS);
+        link_step();
+    }
+    for (i=0;i<NUM_CHANNELS;i++){
+        CHECK_FALSE(peer.channels[i].sdu_error);
+        num_bytes    += peer.channels[i].num_bytes_received;
+        num_k_frames += peer.channels[i].num_k_frames_received;
+    }
+    double goodput = (double) num_bytes / (double) (virtual_time_ms - start_ms);
+    printf("%-20s %u channels, MPS %3u: setup %3u ms, %2u signaling PDUs, %5u K-Frames, %6.1f kB/s\n",
+           name, NUM_CHANNELS, peer.mps, setup_ms, num_signaling_pdus, num_k_frames, goodput);
+    stack_teardown();
+    return goodput;
+}
+
+TEST_GROUP(L2capCbmThroughput){
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(L2capCbmThroughput, CreditBasedVsEnhancedCreditBased){
+    printf("\n");
+    double coc = benchmark("LE CoC", false, 64, 0);
+    uint32_t coc_signaling_pdus = num_signaling_pdus;
+    double ecbm = benchmark("ECBM", true, 64, 0);
+    uint32_t ecbm_signaling_pdus = num_signaling_pdus;
+    double ecbm_reconfigured = benchmark("ECBM + reconfigure", true, 64, 247);
+    uint32_t ecbm_reconfigured_signaling_pdus = num_signaling_pdus;
+    // single request/response for all channels
+    CHECK_EQUAL(2 * NUM_CHANNELS, coc_signaling_pdus);
+    CHECK_EQUAL(2, ecbm_signaling_pdus);
+    CHECK_EQUAL(4, ecbm_reconfigured_signaling_pdus);
+    // same data path
+    CHECK(ecbm >= coc * 0.99);
+    // fewer, larger K-Frames after MPS increase
+    CHECK(ecbm_reconfigured > coc * 2);
+}
+
+// incoming K-Frames: peer streams SDUs to BTstack in K-Frames of PEER_MAX_K_FRAME bytes
+
+static void credits_setup(uint16_t initial_credits){
+    stack_setup(PEER_MAX_K_FRAME);
+    // credit budget is counted in K-Frames of BTstack's MPS
+    l2cap_set_max_le_mtu(PEER_MAX_K_FRAME);
+    app_initial_credits = initial_credits;
+    app_create_channels(false, 1);
+    run_until_open(1);
+    CHECK_EQUAL(1, app_num_channels_open());
+    CHECK_EQUAL(PEER_MAX_K_FRAME, peer.btstack_mps);
+}
+
+static l2cap_le_credit_statistics_t credit_statistics(void){
+    l2cap_le_credit_statistics_t statistics;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_get_credit_statistics(app_channels[0].cid, &statistics));
+    return statistics;
+}
+
+TEST_GROUP(L2capCredits){
+    void setup(void){
+        link_latency_ms = 20;
+    }
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(L2capCredits, AutomaticCreditsStartSmall){
+    credits_setup(L2CAP_LE_AUTOMATIC_CREDITS);
+    CHECK_EQUAL(10, peer.btstack_credits);
+    l2cap_le_credit_statistics_t statistics = credit_statistics();
+    CHECK_EQUAL(10, statistics.credits_target);
+    CHECK_EQUAL(CREDIT_BUDGET / PEER_MAX_K_FRAME, statistics.credits_budget);
+    CHECK_EQUAL(0, statistics.starvation_count);
+    // unknown channel
+    CHECK_EQUAL(L2CAP_LOCAL_CID_DOES_NOT_EXIST, l2cap_le_get_credit_statistics(0x1234, &statistics));
+    CHECK_EQUAL(L2CAP_LOCAL_CID_DOES_NOT_EXIST, l2cap_le_set_credit_budget(0x1234, 1000));
+}
+
+TEST(L2capCredits, StarvationCountedForAppCredits){
+    credits_setup(2);
+    peer.channels[0].send_k_frames = 3;
+    link_run(50);
+    CHECK_EQUAL(1, peer.channels[0].send_k_frames);
+    l2cap_le_credit_statistics_t statistics = credit_statistics();
+    CHECK_EQUAL(1, statistics.starvation_count);
+    CHECK_EQUAL(0, statistics.credits_incoming);
+    // remote is starved until application provides credits
+    CHECK(statistics.starvation_ms >= 25);
+    link_run(50);
+    CHECK(credit_statistics().starvation_ms >= 75);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_provide_credits(app_channels[0].cid, 1));
+    link_run(50);
+    CHECK_EQUAL(0, peer.channels[0].send_k_frames);
+    // starved again by last K-Frame, round trip time of credits measured
+    statistics = credit_statistics();
+    CHECK_EQUAL(2, statistics.starvation_count);
+    CHECK(statistics.rtt_ms >= 2 * link_latency_ms);
+    CHECK(statistics.rtt_ms <= 2 * link_latency_ms + 5);
+}
+
+TEST(L2capCredits, AutomaticCreditsWithinBudget){
+    credits_setup(L2CAP_LE_AUTOMATIC_CREDITS);
+    // 2 kB budget = 8 K-Frames
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_set_credit_budget(app_channels[0].cid, 2048));
+    CHECK_EQUAL(8, credit_statistics().credits_budget);
+    peer.channels[0].send_k_frames = 300;
+    link_run(2000);
+    CHECK_EQUAL(0, peer.channels[0].send_k_frames);
+    CHECK_EQUAL(100, app_num_data_packets_received);
+    // initial credits granted before budget was set
+    CHECK(peer.channels[0].send_credits_max <= 10);
+    l2cap_le_credit_statistics_t statistics = credit_statistics();
+    CHECK_EQUAL(8, statistics.credits_target);
+    CHECK(statistics.starvation_count > 0);
+    CHECK(statistics.rate > 0);
+}
+
+// benchmark: one channel, peer streams 500 SDUs of SDU_LEN bytes over link with 20 ms latency
+
+typedef struct {
+    double   goodput;
+    uint16_t max_credits;
+    l2cap_le_credit_statistics_t statistics;
+} credits_result_t;
+
+static credits_result_t credits_benchmark(const char * name, uint16_t initial_credits, uint16_t credits_per_sdu, uint32_t budget){
+    uint32_t num_sdus = 500;
+    // SDU length + SDU_LEN bytes in K-Frames of PEER_MAX_K_FRAME bytes
+    uint32_t k_frames_per_sdu = (2 + SDU_LEN + PEER_MAX_K_FRAME - 1) / PEER_MAX_K_FRAME;
+    link_latency_ms = 20;
+    credits_setup(initial_credits);
+    app_credits_per_sdu = credits_per_sdu;
+    if (budget != 0){
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_le_set_credit_budget(app_channels[0].cid, budget));
+    }
+    uint32_t start_ms = virtual_time_ms;
+    peer.channels[0].send_k_frames = num_sdus * k_frames_per_sdu;
+    while (app_num_data_packets_received < num_sdus){
+        CHECK(virtual_time_ms < TIME_LIMIT_MS);
+        link_step();
+    }
+    credits_result_t result;
+    result.goodput = (double) (num_sdus * SDU_LEN) / (double) (virtual_time_ms - start_ms);
+    result.max_credits = peer.channels[0].send_credits_max;
+    result.statistics = credit_statistics();
+    printf("%-26s %6.1f kB/s, max %3u credits (%5u bytes), starved %3u times for %5u ms, target %3u, rate %4u K-Frames/s, rtt %3u ms\n",
+           name, result.goodput, result.max_credits, result.max_credits * PEER_MAX_K_FRAME,
+           result.statistics.starvation_count, result.statistics.starvation_ms,
+           result.statistics.credits_target, result.statistics.rate, result.statistics.rtt_ms);
+    stack_teardown();
+    return result;
+}
+
+TEST_GROUP(L2capCreditsThroughput){
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(L2capCreditsThroughput, AutomaticVsAppCredits){
+    printf("\n");
+    // application returns credits for each SDU received
+    credits_result_t app = credits_benchmark("App credits, 10 initial", 10, 3, 0);
+    credits_result_t automatic = credits_benchmark("Automatic credits", L2CAP_LE_AUTOMATIC_CREDITS, 0, 0);
+    credits_result_t small_budget = credits_benchmark("Automatic credits, 4 kB", L2CAP_LE_AUTOMATIC_CREDITS, 0, 4096);
+    // link is kept busy: one K-Frame per ms, three K-Frames per SDU
+    CHECK(automatic.goodput > app.goodput * 2);
+    CHECK(automatic.goodput > 0.9 * SDU_LEN / 3);
+    // credits stay within budget
+    CHECK(automatic.max_credits * PEER_MAX_K_FRAME <= CREDIT_BUDGET);
+    CHECK(small_budget.max_credits <= 4096 / PEER_MAX_K_FRAME);
+    // remote with smaller budget runs out of credits
+    CHECK(small_budget.goodput < automatic.goodput);
+    CHECK(small_budget.statistics.starvation_count > automatic.statistics.starvation_count);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,970 @@
+
+// *****************************************************************************
+//
+// L2CAP ERTM over a simulated lossy link with virtual time:
+// selective reject vs. reject, extended window size and SDUs sent by reference
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+#include "l2cap_signaling.h"
+
+#define CON_HANDLE          0x0040
+#define TEST_PSM            0x1001
+#define REMOTE_CID          0x0080
+#define PEER_MPS            250
+#define PEER_MTU            1000
+#define SDU_LEN             600
+#define NUM_SDUS            400
+#define PEER_MAX_WINDOW     1024
+#define ACL_PACKETS_NUM     8
+#define MAX_FRAMES_IN_FLIGHT 4096
+#define MAX_FRAME_SIZE      300
+#define TIME_LIMIT_MS       1000000
+
+// L2CAP constants private to l2cap.c
+#define SUPERVISORY_FUNCTION_RR     0
+#define SUPERVISORY_FUNCTION_REJ    1
+#define SUPERVISORY_FUNCTION_SREJ   3
+#define CONFIG_OPTION_MTU                               1
+#define CONFIG_OPTION_RETRANSMISSION_AND_FLOW_CONTROL   4
+#define CONFIG_OPTION_FCS                               5
+#define CONFIG_OPTION_EXTENDED_WINDOW_SIZE              7
+#define INFO_TYPE_EXTENDED_FEATURES                     2
+
+// virtual time run loop
+
+static uint32_t virtual_time_ms;
+
+static void run_loop_virtual_init(void){
+    btstack_run_loop_base_init();
+    virtual_time_ms = 0;
+}
+
+static void run_loop_virtual_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = virtual_time_ms + timeout_in_ms;
+}
+
+static uint32_t run_loop_virtual_get_time_ms(void){
+    return virtual_time_ms;
+}
+
+static const btstack_run_loop_t run_loop_virtual = {
+    &run_loop_virtual_init,
+    &btstack_run_loop_base_add_data_source,
+    &btstack_run_loop_base_remove_data_source,
+    &btstack_run_loop_base_enable_data_source_callbacks,
+    &btstack_run_loop_base_disable_data_source_callbacks,
+    &run_loop_virtual_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    NULL,
+    &btstack_run_loop_base_dump_timer,
+    &run_loop_virtual_get_time_ms,
+};
+
+// link: frames are sent one per ms and arrive after the one-way latency
+
+typedef struct {
+    uint32_t arrival_ms;
+    uint16_t len;
+    uint8_t  data[MAX_FRAME_SIZE];
+} frame_t;
+
+typedef struct {
+    frame_t  frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t head;
+    uint32_t tail;
+} frame_queue_t;
+
+static void frame_queue_reset(frame_queue_t * queue){
+    queue->head = 0;
+    queue->tail = 0;
+}
+
+static bool frame_queue_empty(const frame_queue_t * queue){
+    return queue->head == queue->tail;
+}
+
+static void frame_queue_push(frame_queue_t * queue, uint32_t arrival_ms, const uint8_t * data, uint16_t len){
+    CHECK(len <= MAX_FRAME_SIZE);
+    CHECK((queue->tail - queue->head) < MAX_FRAMES_IN_FLIGHT);
+    frame_t * frame = &queue->frames[queue->tail % MAX_FRAMES_IN_FLIGHT];
+    frame->arrival_ms = arrival_ms;
+    frame->len = len;
+    memcpy(frame->data, data, len);
+    queue->tail++;
+}
+
+static frame_t * frame_queue_peek(frame_queue_t * queue){
+    if (frame_queue_empty(queue)) return NULL;
+    return &queue->frames[queue->head % MAX_FRAMES_IN_FLIGHT];
+}
+
+static void frame_queue_pop(frame_queue_t * queue){
+    queue->head++;
+}
+
+// BTstack -> controller, controller -> peer, peer -> BTstack
+static frame_queue_t controller_queue;
+static frame_queue_t to_peer;
+static frame_queue_t to_btstack;
+
+static uint32_t link_latency_ms;
+static uint16_t loss_permille;
+static uint32_t loss_state;
+static uint32_t num_i_frames_sent;
+static uint32_t num_i_frames_lost;
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// peer
+
+typedef struct {
+    // config
+    bool     selective_reject;
+    bool     extended_window_size;
+    uint16_t rx_window;
+    // btstack channel
+    uint16_t local_cid;
+    bool     extended_control;
+    uint16_t btstack_tx_window;
+    uint16_t btstack_mps;
+    bool     config_request_with_extended_window_size;
+    // receiver
+    uint16_t expected_tx_seq;
+    uint16_t srej_end_tx_seq;
+    bool     reject_sent;
+    bool     stored[PEER_MAX_WINDOW];
+    l2cap_segmentation_and_reassembly_t stored_sar[PEER_MAX_WINDOW];
+    uint16_t stored_len[PEER_MAX_WINDOW];
+    uint8_t  stored_data[PEER_MAX_WINDOW][PEER_MPS];
+    // order in which SREJ for missing frame was sent
+    uint32_t srej_counter;
+    uint32_t srej_order[PEER_MAX_WINDOW];
+    // reassembly
+    uint16_t sdu_pos;
+    uint32_t num_sdus_received;
+    uint32_t num_bytes_received;
+    bool     sdu_error;
+    // S-Frames received
+    uint32_t num_polls;
+    // S-Frames sent
+    uint32_t num_srej_sent;
+    uint32_t num_rej_sent;
+} peer_t;
+
+static peer_t peer;
+
+// application
+static uint8_t  sdu_data[NUM_SDUS * SDU_LEN];
+static uint32_t num_sdus_sent;
+static uint32_t num_sdus_released;
+static uint16_t num_sdus_to_send;
+static uint16_t local_cid;
+static bool     channel_open;
+static l2cap_ertm_config_t ertm_config;
+static uint8_t  * ertm_buffer;
+static uint32_t ertm_buffer_size;
+static uint32_t num_data_packets_received;
+static uint8_t  last_data_packet[PEER_MTU];
+static uint16_t last_data_packet_len;
+
+static uint8_t sdu_byte(uint32_t sdu_index, uint32_t pos){
+    return (uint8_t) (sdu_index * 7 + pos);
+}
+
+static uint16_t seq_mask(void){
+    return peer.extended_control ? 0x3fff : 0x3f;
+}
+
+static bool link_loses_frame(void){
+    if (loss_permille == 0) return false;
+    loss_state = loss_state * 1103515245u + 12345u;
+    return ((loss_state >> 16) % 1000) < loss_permille;
+}
+
+static void peer_send_acl(uint16_t cid, const uint8_t * payload, uint16_t len){
+    uint8_t packet[MAX_FRAME_SIZE];
+    little_endian_store_16(packet, 0, CON_HANDLE | (2u << 12));
+    little_endian_store_16(packet, 2, 4 + len);
+    little_endian_store_16(packet, 4, len);
+    little_endian_store_16(packet, 6, cid);
+    memcpy(&packet[8], payload, len);
+    frame_queue_push(&to_btstack, virtual_time_ms + link_latency_ms, packet, 8 + len);
+}
+
+static void peer_send_signaling(uint8_t code, uint8_t sig_id, const uint8_t * data, uint16_t len){
+    uint8_t command[64];
+    command[0] = code;
+    command[1] = sig_id;
+    little_endian_store_16(command, 2, len);
+    memcpy(&command[4], data, len);
+    peer_send_acl(L2CAP_CID_SIGNALING, command, 4 + len);
+}
+
+// ERTM frame with control field and FCS
+static void peer_send_ertm_frame(uint32_t control, const uint8_t * payload, uint16_t len){
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint16_t pos = 4;
+    if (peer.extended_control){
+        little_endian_store_32(frame, pos, control);
+        pos += 4;
+    } else {
+        little_endian_store_16(frame, pos, (uint16_t) control);
+        pos += 2;
+    }
+    memcpy(&frame[pos], payload, len);
+    pos += len;
+    little_endian_store_16(frame, 0, pos - 4 + 2);
+    little_endian_store_16(frame, 2, peer.local_cid);
+    little_endian_store_16(frame, pos, btstack_crc16_calc(frame, pos));
+    pos += 2;
+    peer_send_acl(peer.local_cid, &frame[4], pos - 4);
+}
+
+static void peer_send_s_frame(uint8_t s, int poll, int final, uint16_t req_seq){
+    uint32_t control;
+    if (peer.extended_control){
+        control = (((uint32_t) poll) << 18) | (((uint32_t) s) << 16) | (((uint32_t) req_seq) << 2) | (final << 1) | 1;
+    } else {
+        control = (req_seq << 8) | (final << 7) | (poll << 4) | (((int) s) << 2) | 1;
+    }
+    if (s == SUPERVISORY_FUNCTION_SREJ) peer.num_srej_sent++;
+    if (s == SUPERVISORY_FUNCTION_REJ) peer.num_rej_sent++;
+    peer_send_ertm_frame(control, NULL, 0);
+}
+
+static void peer_send_i_frame(uint16_t tx_seq, l2cap_segmentation_and_reassembly_t sar, const uint8_t * payload, uint16_t len){
+    uint32_t control;
+    if (peer.extended_control){
+        control = (((uint32_t) tx_seq) << 18) | (((uint32_t) sar) << 16) | (((uint32_t) peer.expected_tx_seq) << 2);
+    } else {
+        control = (((uint16_t) sar) << 14) | (peer.expected_tx_seq << 8) | (tx_seq << 1);
+    }
+    peer_send_ertm_frame(control, payload, len);
+}
+
+static void peer_send_config_request(void){
+    uint8_t data[32];
+    uint16_t pos = 0;
+    little_endian_store_16(data, pos, peer.local_cid);
+    pos += 2;
+    little_endian_store_16(data, pos, 0);   // flags
+    pos += 2;
+    data[pos++] = CONFIG_OPTION_MTU;
+    data[pos++] = 2;
+    little_endian_store_16(data, pos, PEER_MTU);
+    pos += 2;
+    data[pos++] = CONFIG_OPTION_RETRANSMISSION_AND_FLOW_CONTROL;
+    data[pos++] = 9;
+    data[pos++] = L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION;
+    data[pos++] = (uint8_t) btstack_min(peer.rx_window, 63);
+    data[pos++] = 20;   // max transmit
+    little_endian_store_16(data, pos, 2000);
+    pos += 2;
+    little_endian_store_16(data, pos, 12000);
+    pos += 2;
+    little_endian_store_16(data, pos, PEER_MPS);
+    pos += 2;
+    data[pos++] = CONFIG_OPTION_FCS;
+    data[pos++] = 1;
+    data[pos++] = 1;
+    if (peer.extended_window_size && (peer.rx_window > 63)){
+        peer.extended_control = true;
+        data[pos++] = CONFIG_OPTION_EXTENDED_WINDOW_SIZE;
+        data[pos++] = 2;
+        little_endian_store_16(data, pos, peer.rx_window);
+        pos += 2;
+    }
+    peer_send_signaling(CONFIGURE_REQUEST, 0x80, data, pos);
+}
+
+static void peer_handle_signaling(const uint8_t * command){
+    uint8_t code   = command[0];
+    uint8_t sig_id = command[1];
+    uint16_t len   = little_endian_read_16(command, 2);
+    const uint8_t * data = &command[4];
+    uint8_t response[16];
+    uint16_t pos;
+    switch (code){
+        case INFORMATION_REQUEST:
+            little_endian_store_16(response, 0, little_endian_read_16(data, 0));
+            if (little_endian_read_16(data, 0) == INFO_TYPE_EXTENDED_FEATURES){
+                // ERTM, FCS option, optionally extended window size
+                uint32_t features = 0x28 | (peer.extended_window_size ? 0x100 : 0);
+                little_endian_store_16(response, 2, 0);
+                little_endian_store_32(response, 4, features);
+                peer_send_signaling(INFORMATION_RESPONSE, sig_id, response, 8);
+            } else {
+                little_endian_store_16(response, 2, 1);     // not supported
+                peer_send_signaling(INFORMATION_RESPONSE, sig_id, response, 4);
+            }
+            break;
+        case CONNECTION_RESPONSE:
+            if (little_endian_read_16(data, 4) != 0) break;
+            peer.local_cid = little_endian_read_16(data, 0);
+            peer_send_config_request();
+            break;
+        case CONFIGURE_REQUEST:
+            pos = 4;
+            while (pos < len){
+                uint8_t option_type   = data[pos] & 0x7f;
+                uint8_t option_length = data[pos+1];
+                if (option_type == CONFIG_OPTION_RETRANSMISSION_AND_FLOW_CONTROL){
+                    peer.btstack_tx_window = data[pos+3];
+                    peer.btstack_mps = little_endian_read_16(data, pos+9);
+                }
+                if (option_type == CONFIG_OPTION_EXTENDED_WINDOW_SIZE){
+                    peer.config_request_with_extended_window_size = true;
+                    peer.btstack_tx_window = little_endian_read_16(data, pos+2);
+                    peer.extended_control = true;
+                }
+                pos += 2 + option_length;
+            }
+            little_endian_store_16(response, 0, REMOTE_CID);
+            little_endian_store_16(response, 2, 0);
+            little_endian_store_16(response, 4, 0);
+            peer_send_signaling(CONFIGURE_RESPONSE, sig_id, response, 6);
+            break;
+        default:
+            break;
+    }
+}
+
+static void peer_deliver_frame(l2cap_segmentation_and_reassembly_t sar, const uint8_t * payload, uint16_t len){
+    uint32_t sdu_index = peer.num_sdus_received;
+    switch (sar){
+        case L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU:
+            peer.sdu_pos = 0;
+            break;
+        case L2CAP_SEGMENTATION_AND_REASSEMBLY_START_OF_L2CAP_SDU:
+            if (little_endian_read_16(payload, 0) != SDU_LEN) peer.sdu_error = true;
+            payload += 2;
+            len -= 2;
+            peer.sdu_pos = 0;
+            break;
+        default:
+            break;
+    }
+    uint16_t i;
+    for (i=0;i<len;i++){
+        if (payload[i] != sdu_byte(sdu_index, peer.sdu_pos + i)) {
+            peer.sdu_error = true;
+        }
+    }
+    peer.sdu_pos += len;
+    peer.num_bytes_received += len;
+    if ((sar == L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU) || (sar == L2CAP_SEGMENTATION_AND_REASSEMBLY_END_OF_L2CAP_SDU)){
+        if (peer.sdu_pos != SDU_LEN) peer.sdu_error = true;
+        peer.num_sdus_received++;
+    }
+}
+
+// request all missing frames before srej_end_tx_seq
+static void peer_send_selective_reject(uint16_t tx_seq, int final){
+    peer.srej_order[tx_seq % PEER_MAX_WINDOW] = ++peer.srej_counter;
+    peer_send_s_frame(SUPERVISORY_FUNCTION_SREJ, 0, final, tx_seq);
+}
+
+// request all missing frames before srej_end_tx_seq
+static void peer_send_selective_rejects(uint16_t from_delta, int final){
+    uint16_t end_delta = (peer.srej_end_tx_seq - peer.expected_tx_seq) & seq_mask();
+    uint16_t delta;
+    for (delta = from_delta; delta < end_delta; delta++){
+        uint16_t tx_seq = (peer.expected_tx_seq + delta) & seq_mask();
+        if (peer.stored[tx_seq % PEER_MAX_WINDOW]) continue;
+        peer_send_selective_reject(tx_seq, final);
+        final = 0;
+    }
+}
+
+// retransmissions arrive in the order of the SREJs. frames requested before the one received got lost again
+static void peer_resend_selective_rejects(uint16_t received_tx_seq){
+    uint32_t received_order = peer.srej_order[received_tx_seq % PEER_MAX_WINDOW];
+    uint16_t end_delta = (received_tx_seq - peer.expected_tx_seq) & seq_mask();
+    uint16_t delta;
+    for (delta = 0; delta < end_delta; delta++){
+        uint16_t tx_seq = (peer.expected_tx_seq + delta) & seq_mask();
+        if (peer.stored[tx_seq % PEER_MAX_WINDOW]) continue;
+        if (peer.srej_order[tx_seq % PEER_MAX_WINDOW] > received_order) continue;
+        peer_send_selective_reject(tx_seq, 0);
+    }
+}
+
+// srej_end_tx_seq stays within [expected_tx_seq, expected_tx_seq + rx window]
+static void peer_next_expected_tx_seq(void){
+    if (peer.srej_end_tx_seq == peer.expected_tx_seq){
+        peer.srej_end_tx_seq = (peer.srej_end_tx_seq + 1) & seq_mask();
+    }
+    peer.expected_tx_seq = (peer.expected_tx_seq + 1) & seq_mask();
+}
+
+static void peer_handle_i_frame(uint16_t tx_seq, l2cap_segmentation_and_reassembly_t sar, const uint8_t * payload, uint16_t len){
+    uint16_t delta = (tx_seq - peer.expected_tx_seq) & seq_mask();
+    if (delta == 0){
+        peer_deliver_frame(sar, payload, len);
+        peer_next_expected_tx_seq();
+        peer.reject_sent = false;
+        // deliver stored frames
+        while (peer.stored[peer.expected_tx_seq % PEER_MAX_WINDOW]){
+            uint16_t slot = peer.expected_tx_seq % PEER_MAX_WINDOW;
+            peer.stored[slot] = false;
+            peer_deliver_frame(peer.stored_sar[slot], peer.stored_data[slot], peer.stored_len[slot]);
+            peer_next_expected_tx_seq();
+        }
+        peer_send_s_frame(SUPERVISORY_FUNCTION_RR, 0, 0, peer.expected_tx_seq);
+        return;
+    }
+    if (delta >= peer.rx_window) {
+        // duplicate
+        return;
+    }
+    if (peer.selective_reject){
+        uint16_t slot = tx_seq % PEER_MAX_WINDOW;
+        if (peer.stored[slot]) return;
+        peer.stored[slot] = true;
+        peer.stored_sar[slot] = sar;
+        peer.stored_len[slot] = len;
+        memcpy(peer.stored_data[slot], payload, len);
+        uint16_t end_delta = (peer.srej_end_tx_seq - peer.expected_tx_seq) & seq_mask();
+        if (delta >= end_delta){
+            peer.srej_end_tx_seq = (tx_seq + 1) & seq_mask();
+            peer_send_selective_rejects(end_delta, 0);
+        } else {
+            peer_resend_selective_rejects(tx_seq);
+        }
+    } else {
+        if (peer.reject_sent) return;
+        peer.reject_sent = true;
+        peer_send_s_frame(SUPERVISORY_FUNCTION_REJ, 0, 0, peer.expected_tx_seq);
+    }
+}
+
+static void peer_handle_ertm_frame(const uint8_t * packet, uint16_t size){
+    // verify FCS
+    CHECK_EQUAL(little_endian_read_16(packet, size - 2), btstack_crc16_calc(&packet[4], size - 6));
+    uint32_t control;
+    uint16_t control_size;
+    uint16_t req_seq;
+    uint16_t tx_seq;
+    int poll;
+    l2cap_segmentation_and_reassembly_t sar;
+    if (peer.extended_control){
+        control = little_endian_read_32(packet, 8);
+        control_size = 4;
+        req_seq = (control >> 2) & 0x3fff;
+        poll    = (control >> 18) & 1;
+        sar     = (l2cap_segmentation_and_reassembly_t) ((control >> 16) & 3);
+        tx_seq  = (control >> 18) & 0x3fff;
+    } else {
+        control = little_endian_read_16(packet, 8);
+        control_size = 2;
+        req_seq = (control >> 8) & 0x3f;
+        poll    = (control >> 4) & 1;
+        sar     = (l2cap_segmentation_and_reassembly_t) ((control >> 14) & 3);
+        tx_seq  = (control >> 1) & 0x3f;
+    }
+    UNUSED(req_seq);
+    if ((control & 1) == 0){
+        peer_handle_i_frame(tx_seq, sar, &packet[8 + control_size], size - (8 + control_size + 2));
+        return;
+    }
+    if (poll){
+        // RR/P=1 after retransmission timeout: request missing frames or retransmission from expected_tx_seq
+        peer.num_polls++;
+        if (peer.selective_reject && (peer.srej_end_tx_seq != peer.expected_tx_seq)){
+            peer_send_selective_rejects(0, 1);
+        } else {
+            peer_send_s_frame(SUPERVISORY_FUNCTION_RR, 0, 1, peer.expected_tx_seq);
+        }
+    }
+}
+
+static void peer_handle_frame(const uint8_t * packet, uint16_t size){
+    uint16_t cid = little_endian_read_16(packet, 6);
+    if (cid == L2CAP_CID_SIGNALING){
+        peer_handle_signaling(&packet[8]);
+        return;
+    }
+    if (cid == REMOTE_CID){
+        peer_handle_ertm_frame(packet, size);
+    }
+}
+
+// SM is not used as the channel is created with security level 0
+void sm_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    UNUSED(callback_handler);
+}
+
+void sm_request_pairing(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+}
+
+// HCI transport
+
+static bool is_i_frame(const uint8_t * packet){
+    if (little_endian_read_16(packet, 6) != REMOTE_CID) return false;
+    return (packet[8] & 1) == 0;
+}
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_ACL_DATA_PACKET) return 0;
+    frame_queue_push(&controller_queue, 0, packet, (uint16_t) size);
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    UNUSED(transport_config);
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void send_event(const uint8_t * event, uint16_t size){
+    packet_handler(HCI_EVENT_PACKET, (uint8_t *) event, size);
+}
+
+// advance virtual time by 1 ms
+static void link_step(void){
+    // controller sends one frame per ms
+    frame_t * frame = frame_queue_peek(&controller_queue);
+    if (frame != NULL){
+        bool lost = false;
+        if (is_i_frame(frame->data)){
+            num_i_frames_sent++;
+            lost = link_loses_frame();
+            if (lost) num_i_frames_lost++;
+        }
+        if (!lost){
+            frame_queue_push(&to_peer, virtual_time_ms + link_latency_ms, frame->data, frame->len);
+        }
+        frame_queue_pop(&controller_queue);
+        uint8_t number_of_completed_packets[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0 };
+        little_endian_store_16(number_of_completed_packets, 3, CON_HANDLE);
+        send_event(number_of_completed_packets, sizeof(number_of_completed_packets));
+    }
+    // peer
+    while (true){
+        frame = frame_queue_peek(&to_peer);
+        if ((frame == NULL) || (frame->arrival_ms > virtual_time_ms)) break;
+        peer_handle_frame(frame->data, frame->len);
+        frame_queue_pop(&to_peer);
+    }
+    // BTstack
+    while (true){
+        frame = frame_queue_peek(&to_btstack);
+        if ((frame == NULL) || (frame->arrival_ms > virtual_time_ms)) break;
+        uint8_t packet[MAX_FRAME_SIZE];
+        uint16_t len = frame->len;
+        memcpy(packet, frame->data, len);
+        frame_queue_pop(&to_btstack);
+        packet_handler(HCI_ACL_DATA_PACKET, packet, len);
+    }
+    btstack_run_loop_base_process_timers(virtual_time_ms);
+    virtual_time_ms++;
+}
+
+// application
+
+static void app_send_sdus(void){
+    while (num_sdus_sent < num_sdus_to_send){
+        if (!l2cap_can_send_packet_now(local_cid)){
+            l2cap_request_can_send_now_event(local_cid);
+            break;
+        }
+        uint8_t status = l2cap_ertm_send_data(local_cid, &sdu_data[num_sdus_sent * SDU_LEN], SDU_LEN);
+        if (status != ERROR_CODE_SUCCESS) break;
+        num_sdus_sent++;
+    }
+}
+
+static void l2cap_channel_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    if (packet_type == L2CAP_DATA_PACKET){
+        num_data_packets_received++;
+        memcpy(last_data_packet, packet, size);
+        last_data_packet_len = size;
+        return;
+    }
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case L2CAP_EVENT_INCOMING_CONNECTION:
+            local_cid = l2cap_event_incoming_connection_get_local_cid(packet);
+            l2cap_accept_ertm_connection(local_cid, &ertm_config, ertm_buffer, ertm_buffer_size);
+            break;
+        case L2CAP_EVENT_CHANNEL_OPENED:
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_event_channel_opened_get_status(packet));
+            channel_open = true;
+            app_send_sdus();
+            break;
+        case L2CAP_EVENT_CAN_SEND_NOW:
+            app_send_sdus();
+            break;
+        case L2CAP_EVENT_ERTM_PACKET_SENT:
+            CHECK_EQUAL(local_cid, l2cap_event_ertm_packet_sent_get_local_cid(packet));
+            num_sdus_released++;
+            break;
+        default:
+            break;
+    }
+    UNUSED(channel);
+}
+
+static bool stack_active;
+
+static void stack_setup(uint16_t peer_rx_window, bool peer_extended_window_size, bool peer_selective_reject, uint16_t btstack_num_tx_buffers, uint16_t btstack_num_rx_buffers){
+    stack_active = true;
+    memset(&peer, 0, sizeof(peer));
+    peer.rx_window = peer_rx_window;
+    peer.extended_window_size = peer_extended_window_size;
+    peer.selective_reject = peer_selective_reject;
+
+    frame_queue_reset(&controller_queue);
+    frame_queue_reset(&to_peer);
+    frame_queue_reset(&to_btstack);
+    loss_state = 1;
+    num_i_frames_sent = 0;
+    num_i_frames_lost = 0;
+    num_sdus_to_send = 0;
+    num_sdus_sent = 0;
+    num_sdus_released = 0;
+    num_data_packets_received = 0;
+    channel_open = false;
+
+    ertm_config.ertm_mandatory = 1;
+    ertm_config.max_transmit = 20;
+    ertm_config.retransmission_timeout_ms = 2000;
+    ertm_config.monitor_timeout_ms = 12000;
+    ertm_config.local_mtu = PEER_MTU;
+    ertm_config.num_tx_buffers = btstack_num_tx_buffers;
+    ertm_config.num_rx_buffers = btstack_num_rx_buffers;
+    ertm_config.fcs_option = 1;
+    ertm_buffer_size = (ertm_config.num_rx_buffers + ertm_config.num_tx_buffers) * (PEER_MPS + sizeof(l2cap_ertm_tx_packet_state_t))
+        + (2 * ertm_config.num_rx_buffers) + ertm_config.local_mtu + 16;
+    ertm_buffer = (uint8_t *) malloc(ertm_buffer_size);
+
+    btstack_memory_init();
+    btstack_run_loop_init(&run_loop_virtual);
+    hci_init(&hci_transport_test, NULL);
+    hci_power_control(HCI_POWER_ON);
+    // HCI Read Buffer Size: ACL 1021 bytes, ACL_PACKETS_NUM packets
+    uint8_t read_buffer_size_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 11, 1, 0x05, 0x10, 0, 0xfd, 0x03, 0x40, ACL_PACKETS_NUM, 0x00, 0x04, 0x00 };
+    send_event(read_buffer_size_complete, sizeof(read_buffer_size_complete));
+    hci_simulate_working_fuzz();
+    l2cap_init();
+    l2cap_register_service(&l2cap_channel_packet_handler, TEST_PSM, PEER_MTU, LEVEL_0);
+
+    // incoming ACL connection
+    uint8_t connection_request[] = { HCI_EVENT_CONNECTION_REQUEST, 10, 1, 2, 3, 4, 5, 6, 0, 0, 0, HCI_LINK_TYPE_ACL };
+    send_event(connection_request, sizeof(connection_request));
+    uint8_t connection_complete[] = { HCI_EVENT_CONNECTION_COMPLETE, 11, 0, 0, 0, 1, 2, 3, 4, 5, 6, HCI_LINK_TYPE_ACL, 0 };
+    little_endian_store_16(connection_complete, 3, CON_HANDLE);
+    send_event(connection_complete, sizeof(connection_complete));
+
+    // L2CAP connection request from peer
+    uint8_t request[4];
+    little_endian_store_16(request, 0, TEST_PSM);
+    little_endian_store_16(request, 2, REMOTE_CID);
+    peer_send_signaling(CONNECTION_REQUEST, 0x01, request, sizeof(request));
+    while (!channel_open && (virtual_time_ms < 1000)){
+        link_step();
+    }
+    CHECK(channel_open);
+}
+
+static void stack_teardown(void){
+    stack_active = false;
+    // disconnect closes L2CAP channel
+    uint8_t disconnection_complete[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, 0, 0, 0x13 };
+    little_endian_store_16(disconnection_complete, 3, CON_HANDLE);
+    send_event(disconnection_complete, sizeof(disconnection_complete));
+    l2cap_unregister_service(TEST_PSM);
+    hci_free_connections_fuzz();
+    l2cap_deinit();
+    hci_deinit();
+    btstack_memory_deinit();
+    btstack_run_loop_deinit();
+    free(ertm_buffer);
+}
+
+// send NUM_SDUS over lossy link, returns goodput in kB/s (virtual time)
+static double transfer(uint16_t num_sdus){
+    uint32_t start_ms = virtual_time_ms;
+    num_sdus_to_send = num_sdus;
+    app_send_sdus();
+    while ((num_sdus_released < num_sdus) && (virtual_time_ms < TIME_LIMIT_MS)){
+        link_step();
+    }
+    CHECK_EQUAL(num_sdus, num_sdus_released);
+    CHECK_EQUAL(num_sdus, peer.num_sdus_received);
+    CHECK_FALSE(peer.sdu_error);
+    return (double) peer.num_bytes_received / (double) (virtual_time_ms - start_ms);
+}
+
+static double run_scenario(const char * name, uint16_t window, bool extended_window_size, bool selective_reject, uint16_t loss, uint32_t latency_ms){
+    link_latency_ms = 0;
+    loss_permille = 0;
+    stack_setup(window, extended_window_size, selective_reject, window, 8);
+    link_latency_ms = latency_ms;
+    loss_permille = loss;
+    double goodput = transfer(NUM_SDUS);
+    printf("%-8s window %4u, loss %4.1f %%, one-way latency %3u ms: %7.1f kB/s, %5u I-Frames sent, %4u lost, %3u SREJ, %3u REJ, %2u polls\n",
+        name, window, loss / 10.0, latency_ms, goodput, num_i_frames_sent, num_i_frames_lost, peer.num_srej_sent, peer.num_rej_sent, peer.num_polls);
+    stack_teardown();
+    return goodput;
+}
+
+static void init_sdu_data(void){
+    uint32_t i;
+    uint32_t j;
+    for (i=0;i<NUM_SDUS;i++){
+        for (j=0;j<SDU_LEN;j++){
+            sdu_data[i * SDU_LEN + j] = sdu_byte(i, j);
+        }
+    }
+}
+
+TEST_GROUP(ErtmNegotiation){
+    void setup(void){
+        init_sdu_data();
+        link_latency_ms = 0;
+        loss_permille = 0;
+    }
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(ErtmNegotiation, ExtendedWindowSizeRequestedByRemote){
+    stack_setup(512, true, true, 512, 8);
+    // BTstack's rx window is small, but remote requested extended window size
+    CHECK(peer.extended_control);
+    CHECK_FALSE(peer.config_request_with_extended_window_size);
+    CHECK(transfer(20) > 0);
+    stack_teardown();
+}
+
+TEST(ErtmNegotiation, ExtendedWindowSizeRequestedByBTstack){
+    stack_setup(32, true, true, 32, 100);
+    CHECK(peer.config_request_with_extended_window_size);
+    CHECK_EQUAL(100, peer.btstack_tx_window);
+    CHECK(peer.extended_control);
+    CHECK(transfer(20) > 0);
+    stack_teardown();
+}
+
+TEST(ErtmNegotiation, NoExtendedWindowSize){
+    // remote does not support extended window size: window limited to 63, enhanced control field
+    stack_setup(512, false, true, 512, 100);
+    CHECK_FALSE(peer.extended_control);
+    CHECK_FALSE(peer.config_request_with_extended_window_size);
+    CHECK_EQUAL(63, peer.btstack_tx_window);
+    CHECK(transfer(20) > 0);
+    stack_teardown();
+}
+
+TEST_GROUP(ErtmReceiver){
+    void setup(void){
+        init_sdu_data();
+        link_latency_ms = 0;
+        loss_permille = 0;
+        stack_setup(63, false, true, 8, 8);
+    }
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+// collect S-Frames sent by BTstack
+static uint32_t captured_controls[32];
+static uint16_t num_captured_controls;
+
+static void capture_s_frames(void){
+    num_captured_controls = 0;
+    while (!frame_queue_empty(&controller_queue) || !frame_queue_empty(&to_btstack)){
+        frame_t * frame = frame_queue_peek(&controller_queue);
+        if (frame != NULL){
+            if (little_endian_read_16(frame->data, 6) == REMOTE_CID){
+                CHECK(num_captured_controls < 32);
+                captured_controls[num_captured_controls++] = peer.extended_control ? little_endian_read_32(frame->data, 8) : little_endian_read_16(frame->data, 8);
+            }
+            // consumed here, not forwarded to peer
+            frame_queue_pop(&controller_queue);
+            uint8_t number_of_completed_packets[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0 };
+            little_endian_store_16(number_of_completed_packets, 3, CON_HANDLE);
+            send_event(number_of_completed_packets, sizeof(number_of_completed_packets));
+            continue;
+        }
+        link_step();
+    }
+}
+
+TEST(ErtmReceiver, SelectiveRejectForEachMissingFrame){
+    // frames 0..7, unsegmented SDUs of 10 bytes, frames 2 and 4 + 5 lost
+    uint8_t payload[8][10];
+    uint16_t i;
+    for (i=0;i<8;i++){
+        memset(payload[i], i, 10);
+    }
+    for (i=0;i<8;i++){
+        if ((i == 2) || (i == 4) || (i == 5)) continue;
+        peer_send_i_frame(i, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload[i], 10);
+    }
+    capture_s_frames();
+    CHECK_EQUAL(2, num_data_packets_received);
+    // SREJ 2, SREJ 4, SREJ 5 in between RR acks
+    uint16_t srej_mask = 0;
+    for (i=0;i<num_captured_controls;i++){
+        uint32_t control = captured_controls[i];
+        CHECK(control & 1);
+        if (((control >> 2) & 3) != SUPERVISORY_FUNCTION_SREJ) continue;
+        uint16_t req_seq = (control >> 8) & 0x3f;
+        CHECK((srej_mask & (1 << req_seq)) == 0);
+        srej_mask |= 1 << req_seq;
+    }
+    CHECK_EQUAL((1 << 2) | (1 << 4) | (1 << 5), srej_mask);
+
+    // retransmission of 4 only delivers nothing, 2 delivers 2 + 3 + 4
+    peer_send_i_frame(4, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload[4], 10);
+    capture_s_frames();
+    CHECK_EQUAL(2, num_data_packets_received);
+    peer_send_i_frame(2, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload[2], 10);
+    capture_s_frames();
+    CHECK_EQUAL(5, num_data_packets_received);
+    peer_send_i_frame(5, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload[5], 10);
+    capture_s_frames();
+    CHECK_EQUAL(8, num_data_packets_received);
+    CHECK_EQUAL(10, last_data_packet_len);
+    CHECK_EQUAL(7, last_data_packet[0]);
+    // last S-Frame is RR 8
+    uint32_t control = captured_controls[num_captured_controls - 1];
+    CHECK_EQUAL(SUPERVISORY_FUNCTION_RR, (control >> 2) & 3);
+    CHECK_EQUAL(8, (control >> 8) & 0x3f);
+}
+
+TEST(ErtmReceiver, StoreFrameLargerThanMps){
+    // unsegmented SDUs might be 2 bytes larger than MPS and are stored out of sequence as well
+    uint8_t payload[MAX_FRAME_SIZE];
+    CHECK((peer.btstack_mps + 2u) <= (MAX_FRAME_SIZE - 16u));
+    memset(payload, 0x55, sizeof(payload));
+    peer_send_i_frame(0, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload, 10);
+    peer_send_i_frame(2, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload, peer.btstack_mps + 2);
+    capture_s_frames();
+    CHECK_EQUAL(1, num_data_packets_received);
+    // only SREJ 1
+    uint16_t srej_mask = 0;
+    uint16_t i;
+    for (i=0;i<num_captured_controls;i++){
+        uint32_t control = captured_controls[i];
+        if (((control >> 2) & 3) != SUPERVISORY_FUNCTION_SREJ) continue;
+        srej_mask |= 1 << ((control >> 8) & 0x3f);
+    }
+    CHECK_EQUAL(1 << 1, srej_mask);
+
+    // retransmission delivers stored frame in sequence
+    peer_send_i_frame(1, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload, 10);
+    capture_s_frames();
+    CHECK_EQUAL(3, num_data_packets_received);
+    CHECK_EQUAL(peer.btstack_mps + 2, last_data_packet_len);
+}
+
+TEST(ErtmReceiver, PollRequestsMissingFramesAgain){
+    uint8_t payload[10];
+    memset(payload, 0x55, sizeof(payload));
+    peer_send_i_frame(0, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload, 10);
+    peer_send_i_frame(3, L2CAP_SEGMENTATION_AND_REASSEMBLY_UNSEGMENTED_L2CAP_SDU, payload, 10);
+    capture_s_frames();
+    // RR/P=1 -> SREJ 1 with F=1, SREJ 2
+    peer_send_s_frame(SUPERVISORY_FUNCTION_RR, 1, 0, 0);
+    capture_s_frames();
+    CHECK_EQUAL(2, num_captured_controls);
+    CHECK_EQUAL(SUPERVISORY_FUNCTION_SREJ, (captured_controls[0] >> 2) & 3);
+    CHECK_EQUAL(1, (captured_controls[0] >> 8) & 0x3f);
+    CHECK_EQUAL(1, (captured_controls[0] >> 7) & 1);
+    CHECK_EQUAL(SUPERVISORY_FUNCTION_SREJ, (captured_controls[1] >> 2) & 3);
+    CHECK_EQUAL(2, (captured_controls[1] >> 8) & 0x3f);
+    CHECK_EQUAL(0, (captured_controls[1] >> 7) & 1);
+}
+
+TEST_GROUP(ErtmLossyLink){
+    void setup(void){
+        init_sdu_data();
+    }
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(ErtmLossyLink, Goodput){
+    printf("\n");
+    double rej_clean   = run_scenario("REJ",  63, false, false,  0, 20);
+    double srej_clean  = run_scenario("SREJ", 63, false, true,   0, 20);
+    double rej_lossy   = run_scenario("REJ",  63, false, false, 20, 20);
+    double srej_lossy  = run_scenario("SREJ", 63, false, true,  20, 20);
+    double rej_lossy5  = run_scenario("REJ",  63, false, false, 50, 20);
+    double srej_lossy5 = run_scenario("SREJ", 63, false, true,  50, 20);
+    // without loss, both use the full link
+    CHECK(srej_clean >= rej_clean * 0.99);
+    // selective reject only retransmits lost frames
+    CHECK(srej_lossy  > rej_lossy);
+    CHECK(srej_lossy5 > rej_lossy5);
+}
+
+TEST(ErtmLossyLink, ExtendedWindowSize){
+    printf("\n");
+    // link with 200 ms round trip time needs more than 63 frames in flight
+    double window_63   = run_scenario("SREJ",  63, false, true,  0, 100);
+    double window_512  = run_scenario("SREJ", 512, true,  true,  0, 100);
+    double window_63_lossy  = run_scenario("SREJ",  63, false, true, 20, 100);
+    double window_512_lossy = run_scenario("SREJ", 512, true,  true, 20, 100);
+    CHECK(window_512 > window_63 * 2);
+    CHECK(window_512_lossy > window_63_lossy);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,134 @@
+
+// *****************************************************************************
+//
+// L2CAP ERTM FCS: btstack_crc16 vs. previous byte-at-a-time implementation
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_util.h"
+
+#if defined(__PCLMUL__) && defined(__x86_64__)
+#define ENGINE "PCLMULQDQ"
+#elif defined(ENABLE_CRC16_SLICE_BY_8)
+#define ENGINE "slice-by-8"
+#else
+#define ENGINE "byte table"
+#endif
+
+#define BENCHMARK_FRAME_LEN   1021
+#define BENCHMARK_ITERATIONS  20000
+
+// previous crc16_calc from l2cap.c, table generated for generator polynom D^16 + D^15 + D^2 + 1
+static uint16_t reference_table[256];
+
+static void reference_init(void){
+    int i;
+    for (i=0;i<256;i++){
+        uint16_t crc = (uint16_t) i;
+        int bit;
+        for (bit=0;bit<8;bit++){
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xa001) : (crc >> 1);
+        }
+        reference_table[i] = crc;
+    }
+}
+
+static uint16_t reference_crc16_calc(const uint8_t * data, uint16_t len){
+    uint16_t crc = 0;   // initial value = 0
+    while (len--){
+        crc = (crc >> 8) ^ reference_table[ (crc ^ ((uint16_t) *data++)) & 0x00FF ];
+    }
+    return crc;
+}
+
+static uint8_t buffer[2048 + 8];
+
+static double time_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+TEST_GROUP(L2CAPFCS){
+    void setup(void){
+        reference_init();
+        srand(42);
+        unsigned int i;
+        for (i=0;i<sizeof(buffer);i++){
+            buffer[i] = (uint8_t) rand();
+        }
+    }
+};
+
+TEST(L2CAPFCS, SpecExamples){
+    // Core Spec Vol 3, Part A, 3.3.5 Frame Check Sequence
+    const uint8_t i_frame[] = { 0x0E, 0x00, 0x40, 0x00, 0x02, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09 };
+    const uint8_t rr_frame[] = { 0x04, 0x00, 0x40, 0x00, 0x01, 0x01 };
+    CHECK_EQUAL(0x6138, btstack_crc16_calc(i_frame, sizeof(i_frame)));
+    CHECK_EQUAL(0x14D4, btstack_crc16_calc(rr_frame, sizeof(rr_frame)));
+}
+
+TEST(L2CAPFCS, MatchesReference){
+    uint16_t offset;
+    for (offset=0;offset<8;offset++){
+        uint16_t len;
+        for (len=0;len<=1100;len++){
+            CHECK_EQUAL(reference_crc16_calc(&buffer[offset], len), btstack_crc16_calc(&buffer[offset], len));
+        }
+    }
+}
+
+TEST(L2CAPFCS, Update){
+    uint16_t expected = reference_crc16_calc(buffer, 1000);
+    uint16_t split;
+    for (split=0;split<=1000;split+=7){
+        uint16_t crc = btstack_crc16_update(0, buffer, split);
+        crc = btstack_crc16_update(crc, &buffer[split], 1000 - split);
+        CHECK_EQUAL(expected, crc);
+    }
+}
+
+TEST(L2CAPFCS, Combine){
+    uint16_t header_len;
+    for (header_len=0;header_len<=8;header_len++){
+        uint16_t payload_len;
+        for (payload_len=0;payload_len<=2048-8;payload_len+=13){
+            uint16_t expected = reference_crc16_calc(buffer, header_len + payload_len);
+            uint16_t crc_header  = btstack_crc16_calc(buffer, header_len);
+            uint16_t crc_payload = btstack_crc16_calc(&buffer[header_len], payload_len);
+            CHECK_EQUAL(expected, btstack_crc16_combine(crc_header, crc_payload, payload_len));
+        }
+    }
+}
+
+TEST(L2CAPFCS, Benchmark){
+    volatile uint16_t sink = 0;
+    int i;
+    double start_s = time_s();
+    for (i=0;i<BENCHMARK_ITERATIONS;i++){
+        sink ^= reference_crc16_calc(buffer, BENCHMARK_FRAME_LEN);
+    }
+    double reference_s = time_s() - start_s;
+    start_s = time_s();
+    for (i=0;i<BENCHMARK_ITERATIONS;i++){
+        sink ^= btstack_crc16_calc(buffer, BENCHMARK_FRAME_LEN);
+    }
+    double engine_s = time_s() - start_s;
+    double megabytes = (double) BENCHMARK_FRAME_LEN * BENCHMARK_ITERATIONS / 1e6;
+    printf("FCS over %u byte frames: byte table (previous) %7.1f MB/s, %-12s %7.1f MB/s\n", BENCHMARK_FRAME_LEN,
+           megabytes / reference_s, ENGINE, megabytes / engine_s);
+    CHECK_EQUAL(0, sink);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_config.h"
+#include "mesh/mesh_network_cache.h"
+
+// relay node in a dense mesh: every Network PDU is heard directly and repeated by two other relays
+#define NUM_NODES           200
+#define NUM_UNIQUE_PDUS     200000
+#define DUPLICATE_DELAY_1   16
+#define DUPLICATE_DELAY_2   48
+
+typedef struct {
+    uint16_t src;
+    uint32_t seq;
+} benchmark_pdu_t;
+
+static benchmark_pdu_t pdus[3 * NUM_UNIQUE_PDUS];
+static int num_pdus;
+
+// previous implementation: linear scan over 32-bit 'hashes' with 15-bit SEQ
+static uint32_t linear_cache[MESH_NETWORK_CACHE_SIZE];
+static int      linear_cache_index;
+
+static uint32_t linear_cache_hash(uint16_t src, uint8_t ivi, uint32_t seq){
+    return ((uint32_t) src << 16) | (ivi << 15) | (seq & 0x7fff);
+}
+
+static bool linear_cache_find(uint32_t hash){
+    int i;
+    for (i = 0; i < MESH_NETWORK_CACHE_SIZE; i++) {
+        if (linear_cache[i] == hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void linear_cache_add(uint32_t hash){
+    linear_cache[linear_cache_index++] = hash;
+    if (linear_cache_index >= MESH_NETWORK_CACHE_SIZE){
+        linear_cache_index = 0;
+    }
+}
+
+static double time_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void report(const char * name, double start_s, int num_forwarded){
+    double duration_s = time_s() - start_s;
+    printf("%-28s cache size %5u: %12.0f PDUs/s, %u of %u forwarded\n", name, MESH_NETWORK_CACHE_SIZE,
+           num_pdus / duration_s, num_forwarded, num_pdus);
+}
+
+static void benchmark_pdu_unique(int index, benchmark_pdu_t * pdu){
+    pdu->src = 1 + (index % NUM_NODES);
+    pdu->seq = index / NUM_NODES;
+}
+
+TEST_GROUP(MeshNetworkCacheBenchmark){
+    void setup(void){
+        num_pdus = 0;
+        int i;
+        for (i=0;i<NUM_UNIQUE_PDUS;i++){
+            benchmark_pdu_unique(i, &pdus[num_pdus++]);
+            if (i >= DUPLICATE_DELAY_1){
+                benchmark_pdu_unique(i - DUPLICATE_DELAY_1, &pdus[num_pdus++]);
+            }
+            if (i >= DUPLICATE_DELAY_2){
+                benchmark_pdu_unique(i - DUPLICATE_DELAY_2, &pdus[num_pdus++]);
+            }
+        }
+        mesh_network_cache_reset();
+        memset(linear_cache, 0, sizeof(linear_cache));
+        linear_cache_index = 0;
+    }
+};
+
+TEST(MeshNetworkCacheBenchmark, HashSet){
+    int num_forwarded = 0;
+    double start_s = time_s();
+    int i;
+    for (i=0;i<num_pdus;i++){
+        const benchmark_pdu_t * pdu = &pdus[i];
+        if (mesh_network_cache_contains(pdu->src, 0, pdu->seq)) continue;
+        mesh_network_cache_add(pdu->src, 0, pdu->seq);
+        num_forwarded++;
+    }
+    report("hash set", start_s, num_forwarded);
+#if MESH_NETWORK_CACHE_SIZE > DUPLICATE_DELAY_2
+    CHECK_EQUAL(NUM_UNIQUE_PDUS, num_forwarded);
+#endif
+}
+
+TEST(MeshNetworkCacheBenchmark, LinearScan){
+    int num_forwarded = 0;
+    double start_s = time_s();
+    int i;
+    for (i=0;i<num_pdus;i++){
+        const benchmark_pdu_t * pdu = &pdus[i];
+        uint32_t hash = linear_cache_hash(pdu->src, 0, pdu->seq);
+        if (linear_cache_find(hash)) continue;
+        linear_cache_add(hash);
+        num_forwarded++;
+    }
+    report("linear scan (previous)", start_s, num_forwarded);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
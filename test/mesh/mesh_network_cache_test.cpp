@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_config.h"
+#include "mesh/mesh_network_cache.h"
+
+// reference: FIFO list with linear scan
+typedef struct {
+    uint16_t src;
+    uint8_t  ivi;
+    uint32_t seq;
+} reference_entry_t;
+
+static reference_entry_t reference_entries[MESH_NETWORK_CACHE_SIZE];
+static int reference_num_entries;
+static int reference_oldest;
+
+static bool reference_contains(uint16_t src, uint8_t ivi, uint32_t seq){
+    int i;
+    for (i=0;i<reference_num_entries;i++){
+        const reference_entry_t * entry = &reference_entries[i];
+        if ((entry->src == src) && (entry->ivi == ivi) && (entry->seq == seq)) return true;
+    }
+    return false;
+}
+
+static void reference_add(uint16_t src, uint8_t ivi, uint32_t seq){
+    int index;
+    if (reference_num_entries < MESH_NETWORK_CACHE_SIZE){
+        index = reference_num_entries++;
+    } else {
+        index = reference_oldest++;
+        if (reference_oldest == MESH_NETWORK_CACHE_SIZE){
+            reference_oldest = 0;
+        }
+    }
+    reference_entries[index].src = src;
+    reference_entries[index].ivi = ivi;
+    reference_entries[index].seq = seq;
+}
+
+TEST_GROUP(MeshNetworkCache){
+    void setup(void){
+        mesh_network_cache_reset();
+        reference_num_entries = 0;
+        reference_oldest = 0;
+    }
+};
+
+TEST(MeshNetworkCache, Empty){
+    CHECK_FALSE(mesh_network_cache_contains(0x0001, 0, 0));
+}
+
+TEST(MeshNetworkCache, AddContains){
+    mesh_network_cache_add(0x1234, 1, 0x123456);
+    CHECK_TRUE(mesh_network_cache_contains(0x1234, 1, 0x123456));
+    CHECK_FALSE(mesh_network_cache_contains(0x1235, 1, 0x123456));
+    CHECK_FALSE(mesh_network_cache_contains(0x1234, 0, 0x123456));
+    CHECK_FALSE(mesh_network_cache_contains(0x1234, 1, 0x123457));
+}
+
+TEST(MeshNetworkCache, FullSeq){
+    // SEQs 32768 apart were folded onto the same 32-bit hash before
+    mesh_network_cache_add(0x0001, 0, 0x000010);
+    CHECK_FALSE(mesh_network_cache_contains(0x0001, 0, 0x008010));
+    CHECK_FALSE(mesh_network_cache_contains(0x0001, 0, 0x800010));
+    mesh_network_cache_add(0x0001, 0, 0x008010);
+    CHECK_TRUE(mesh_network_cache_contains(0x0001, 0, 0x000010));
+    CHECK_TRUE(mesh_network_cache_contains(0x0001, 0, 0x008010));
+}
+
+TEST(MeshNetworkCache, FifoEviction){
+    uint32_t seq;
+    for (seq = 0; seq <= MESH_NETWORK_CACHE_SIZE; seq++){
+        mesh_network_cache_add(0x0002, 0, seq);
+    }
+    CHECK_FALSE(mesh_network_cache_contains(0x0002, 0, 0));
+    for (seq = 1; seq <= MESH_NETWORK_CACHE_SIZE; seq++){
+        CHECK_TRUE(mesh_network_cache_contains(0x0002, 0, seq));
+    }
+}
+
+TEST(MeshNetworkCache, Reset){
+    mesh_network_cache_add(0x0003, 1, 7);
+    mesh_network_cache_reset();
+    CHECK_FALSE(mesh_network_cache_contains(0x0003, 1, 7));
+    mesh_network_cache_add(0x0003, 1, 7);
+    CHECK_TRUE(mesh_network_cache_contains(0x0003, 1, 7));
+}
+
+TEST(MeshNetworkCache, MatchesReference){
+    // small key space forces duplicates, collisions and evictions from any probe position
+    srand(1234);
+    int i;
+    for (i=0;i<200000;i++){
+        uint16_t src = 1 + (rand() % 8);
+        uint8_t  ivi = rand() & 1;
+        uint32_t seq = (rand() % (MESH_NETWORK_CACHE_SIZE / 4 + 1)) << (rand() % 3 == 0 ? 15 : 0);
+        bool expected = reference_contains(src, ivi, seq);
+        CHECK_EQUAL(expected, mesh_network_cache_contains(src, ivi, seq));
+        if (!expected){
+            reference_add(src, ivi, seq);
+            mesh_network_cache_add(src, ivi, seq);
+        }
+    }
+    for (i=0;i<reference_num_entries;i++){
+        const reference_entry_t * entry = &reference_entries[i];
+        CHECK_TRUE(mesh_network_cache_contains(entry->src, entry->ivi, entry->seq));
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
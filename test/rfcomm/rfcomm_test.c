@@ -0,0 +1,981 @@
+// *****************************************************************************
+//
+// RFCOMM with mocked L2CAP, simulated RFCOMM peer and virtual time:
+// rfcomm_send vs. rfcomm_stream_send, piggybacked credits, automatic credits
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_sdp.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+#include "classic/rfcomm.h"
+#include "gap.h"
+#include "l2cap.h"
+
+#define CON_HANDLE          0x0001
+#define L2CAP_CID           0x0041
+#define L2CAP_MTU           1017
+#define SERVER_CHANNEL      1
+#define DLCI                (SERVER_CHANNEL << 1)
+// BTstack controller buffers, peer keeps its controller busy with a few packets
+#define ACL_PACKETS_NUM     4
+#define PEER_ACL_PACKETS_NUM 4
+#define QUEUE_SIZE          64
+// simulation step, baseband slot, default latency from air to host
+#define TICK_US             125
+#define SLOT_US             625
+#define HOST_LATENCY_US     1500
+#define HOST_LATENCY_SLOW_US 20000
+#define TIME_LIMIT_US       60000000
+#define TEST_DATA_LEN       200000
+
+#define RFCOMM_SABM         0x3F
+#define RFCOMM_UA           0x73
+#define RFCOMM_DISC         0x53
+#define RFCOMM_UIH          0xEF
+#define RFCOMM_UIH_PF       0xFF
+#define RFCOMM_MSC_CMD      0xE3
+#define RFCOMM_MSC_RSP      0xE1
+#define RFCOMM_PN_CMD       0x83
+#define RFCOMM_PN_RSP       0x81
+
+static const bd_addr_t peer_addr = { 0x00, 0x1B, 0xDC, 0x07, 0x32, 0xEF };
+
+// virtual time run loop
+
+static uint32_t virtual_time_us;
+static uint32_t host_latency_us;
+
+static void run_loop_virtual_init(void){
+    btstack_run_loop_base_init();
+    virtual_time_us = 0;
+}
+
+static void run_loop_virtual_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = virtual_time_us / 1000 + timeout_in_ms;
+}
+
+static uint32_t run_loop_virtual_get_time_ms(void){
+    return virtual_time_us / 1000;
+}
+
+static const btstack_run_loop_t run_loop_virtual = {
+    &run_loop_virtual_init,
+    &btstack_run_loop_base_add_data_source,
+    &btstack_run_loop_base_remove_data_source,
+    &btstack_run_loop_base_enable_data_source_callbacks,
+    &btstack_run_loop_base_disable_data_source_callbacks,
+    &run_loop_virtual_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    NULL,
+    &btstack_run_loop_base_dump_timer,
+    &run_loop_virtual_get_time_ms,
+};
+
+// L2CAP PDU queues
+
+typedef struct {
+    uint32_t time_us;
+    uint16_t len;
+    uint8_t  data[L2CAP_MTU];
+} pdu_t;
+
+typedef struct {
+    pdu_t    pdus[QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} pdu_queue_t;
+
+static void pdu_queue_reset(pdu_queue_t * queue){
+    queue->head = 0;
+    queue->tail = 0;
+}
+
+static uint32_t pdu_queue_len(const pdu_queue_t * queue){
+    return queue->tail - queue->head;
+}
+
+static void pdu_queue_push(pdu_queue_t * queue, uint32_t time_us, const uint8_t * data, uint16_t len){
+    CHECK(len <= L2CAP_MTU);
+    CHECK(pdu_queue_len(queue) < QUEUE_SIZE);
+    pdu_t * pdu = &queue->pdus[queue->tail % QUEUE_SIZE];
+    pdu->time_us = time_us;
+    pdu->len = len;
+    memcpy(pdu->data, data, len);
+    queue->tail++;
+}
+
+static pdu_t * pdu_queue_peek(pdu_queue_t * queue){
+    if (pdu_queue_len(queue) == 0) return NULL;
+    return &queue->pdus[queue->head % QUEUE_SIZE];
+}
+
+static void pdu_queue_pop(pdu_queue_t * queue){
+    queue->head++;
+}
+
+// controller queues, packets on air and in HCI transport
+static pdu_queue_t btstack_controller;
+static pdu_queue_t peer_controller;
+static pdu_queue_t to_peer;
+static pdu_queue_t to_btstack;
+
+// air: one packet at a time, directions alternate if both have data
+static uint32_t air_busy_until_us;
+static bool     air_active;
+static bool     air_from_btstack;
+
+// mocked L2CAP
+
+static btstack_packet_handler_t l2cap_rfcomm_handler;
+static bool     l2cap_packet_buffer_reserved;
+static uint8_t  l2cap_outgoing_buffer[L2CAP_MTU];
+static bool     l2cap_can_send_now_requested;
+static bool     l2cap_emit_channel_opened;
+static bool     l2cap_channel_open;
+static uint32_t l2cap_num_packets_sent;
+static int      l2cap_send_error;
+
+uint16_t l2cap_max_mtu(void){
+    return L2CAP_MTU;
+}
+
+uint8_t l2cap_register_service(btstack_packet_handler_t packet_handler, uint16_t psm, uint16_t mtu, gap_security_level_t security_level){
+    UNUSED(mtu);
+    UNUSED(security_level);
+    CHECK_EQUAL(BLUETOOTH_PROTOCOL_RFCOMM, psm);
+    l2cap_rfcomm_handler = packet_handler;
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_unregister_service(uint16_t psm){
+    UNUSED(psm);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_create_channel(btstack_packet_handler_t packet_handler, bd_addr_t address, uint16_t psm, uint16_t mtu, uint16_t * out_local_cid){
+    UNUSED(packet_handler);
+    (void) address;
+    UNUSED(psm);
+    UNUSED(mtu);
+    UNUSED(out_local_cid);
+    return BTSTACK_MEMORY_ALLOC_FAILED;
+}
+
+void l2cap_accept_connection(uint16_t local_cid){
+    CHECK_EQUAL(L2CAP_CID, local_cid);
+    l2cap_emit_channel_opened = true;
+}
+
+void l2cap_decline_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+    FAIL("L2CAP connection declined");
+}
+
+void l2cap_disconnect(uint16_t local_cid, uint8_t reason){
+    UNUSED(local_cid);
+    UNUSED(reason);
+    l2cap_channel_open = false;
+}
+
+int l2cap_can_send_packet_now(uint16_t local_cid){
+    UNUSED(local_cid);
+    if (l2cap_packet_buffer_reserved) return 0;
+    return pdu_queue_len(&btstack_controller) < ACL_PACKETS_NUM;
+}
+
+int l2cap_can_send_prepared_packet_now(uint16_t local_cid){
+    UNUSED(local_cid);
+    return pdu_queue_len(&btstack_controller) < ACL_PACKETS_NUM;
+}
+
+void l2cap_request_can_send_now_event(uint16_t local_cid){
+    UNUSED(local_cid);
+    l2cap_can_send_now_requested = true;
+}
+
+int l2cap_reserve_packet_buffer(void){
+    CHECK(!l2cap_packet_buffer_reserved);
+    l2cap_packet_buffer_reserved = true;
+    return 1;
+}
+
+void l2cap_release_packet_buffer(void){
+    l2cap_packet_buffer_reserved = false;
+}
+
+uint8_t * l2cap_get_outgoing_buffer(void){
+    return l2cap_outgoing_buffer;
+}
+
+int l2cap_send_prepared(uint16_t local_cid, uint16_t len){
+    CHECK_EQUAL(L2CAP_CID, local_cid);
+    CHECK(l2cap_packet_buffer_reserved);
+    // buffer stays reserved on error
+    if (l2cap_send_error != 0) return l2cap_send_error;
+    if (pdu_queue_len(&btstack_controller) >= ACL_PACKETS_NUM) return BTSTACK_ACL_BUFFERS_FULL;
+    l2cap_packet_buffer_reserved = false;
+    pdu_queue_push(&btstack_controller, virtual_time_us, l2cap_outgoing_buffer, len);
+    l2cap_num_packets_sent++;
+    return ERROR_CODE_SUCCESS;
+}
+
+int l2cap_send(uint16_t local_cid, uint8_t *data, uint16_t len){
+    CHECK_EQUAL(L2CAP_CID, local_cid);
+    if (!l2cap_can_send_packet_now(local_cid)) return BTSTACK_ACL_BUFFERS_FULL;
+    pdu_queue_push(&btstack_controller, virtual_time_us, data, len);
+    l2cap_num_packets_sent++;
+    return ERROR_CODE_SUCCESS;
+}
+
+gap_security_level_t gap_get_security_level(void){
+    return LEVEL_2;
+}
+
+static void l2cap_emit_incoming_connection(void){
+    uint8_t event[16];
+    event[0] = L2CAP_EVENT_INCOMING_CONNECTION;
+    event[1] = sizeof(event) - 2;
+    reverse_bd_addr(peer_addr, &event[2]);
+    little_endian_store_16(event, 8, CON_HANDLE);
+    little_endian_store_16(event, 10, BLUETOOTH_PROTOCOL_RFCOMM);
+    little_endian_store_16(event, 12, L2CAP_CID);
+    little_endian_store_16(event, 14, L2CAP_CID);
+    (*l2cap_rfcomm_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+}
+
+static void l2cap_emit_opened(void){
+    uint8_t event[26];
+    memset(event, 0, sizeof(event));
+    event[0] = L2CAP_EVENT_CHANNEL_OPENED;
+    event[1] = sizeof(event) - 2;
+    event[2] = ERROR_CODE_SUCCESS;
+    reverse_bd_addr(peer_addr, &event[3]);
+    little_endian_store_16(event,  9, CON_HANDLE);
+    little_endian_store_16(event, 11, BLUETOOTH_PROTOCOL_RFCOMM);
+    little_endian_store_16(event, 13, L2CAP_CID);
+    little_endian_store_16(event, 15, L2CAP_CID);
+    little_endian_store_16(event, 17, L2CAP_MTU);
+    little_endian_store_16(event, 19, L2CAP_MTU);
+    event[23] = 1;
+    l2cap_channel_open = true;
+    (*l2cap_rfcomm_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+}
+
+static void l2cap_emit_can_send_now(void){
+    uint8_t event[4];
+    event[0] = L2CAP_EVENT_CAN_SEND_NOW;
+    event[1] = sizeof(event) - 2;
+    little_endian_store_16(event, 2, L2CAP_CID);
+    (*l2cap_rfcomm_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+}
+
+static void l2cap_emit_channel_closed(void){
+    uint8_t event[4];
+    event[0] = L2CAP_EVENT_CHANNEL_CLOSED;
+    event[1] = sizeof(event) - 2;
+    little_endian_store_16(event, 2, L2CAP_CID);
+    l2cap_channel_open = false;
+    (*l2cap_rfcomm_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+}
+
+// test data
+
+static uint8_t test_data[TEST_DATA_LEN];
+
+static uint8_t test_data_byte(uint32_t pos){
+    return (uint8_t) ((pos * 7) + (pos >> 8));
+}
+
+// peer: initiates multiplexer and DLC, receives data from BTstack, streams data to BTstack
+
+typedef struct {
+    // config
+    uint16_t max_frame_size;
+    uint8_t  initial_credits;
+    uint8_t  credit_batch;
+    // setup
+    bool     dlc_open;
+    // credits for BTstack
+    uint16_t btstack_credits;
+    uint16_t frames_since_grant;
+    // data received from BTstack
+    uint32_t rx_bytes;
+    uint32_t rx_frames;
+    uint32_t rx_credit_frames;
+    uint32_t rx_piggybacked_credits;
+    // data sent to BTstack
+    uint32_t tx_bytes;
+    uint32_t tx_remaining;
+    uint16_t tx_frame_size;
+    uint16_t credits;
+    uint16_t credits_max;
+    uint32_t tx_starved_us;
+    bool     send_disc;
+} peer_t;
+
+static peer_t peer;
+
+static void peer_send_frame(uint8_t dlci, uint8_t control, uint8_t credits, const uint8_t * payload, uint16_t len){
+    uint8_t frame[L2CAP_MTU];
+    uint16_t pos = 0;
+    // peer is initiator: C/R = 1 for commands and UIH frames
+    frame[pos++] = (dlci << 2) | 3;
+    frame[pos++] = control;
+    if (len < 128){
+        frame[pos++] = (len << 1) | 1;
+    } else {
+        frame[pos++] = (len & 0x7f) << 1;
+        frame[pos++] = len >> 7;
+    }
+    if (control == RFCOMM_UIH_PF){
+        frame[pos++] = credits;
+    }
+    memcpy(&frame[pos], payload, len);
+    pos += len;
+    uint8_t fcs_len = ((control & 0xef) == RFCOMM_UIH) ? 2 : 3;
+    frame[pos] = btstack_crc8_calc(frame, fcs_len);
+    pos++;
+    pdu_queue_push(&peer_controller, virtual_time_us, frame, pos);
+}
+
+static void peer_send_mcc(uint8_t type, const uint8_t * values, uint8_t len){
+    uint8_t payload[16];
+    payload[0] = type;
+    payload[1] = (len << 1) | 1;
+    memcpy(&payload[2], values, len);
+    peer_send_frame(0, RFCOMM_UIH, 0, payload, 2 + len);
+}
+
+static void peer_send_credits(uint8_t credits){
+    peer.btstack_credits += credits;
+    peer_send_frame(DLCI, RFCOMM_UIH_PF, credits, NULL, 0);
+}
+
+static void peer_handle_mcc(const uint8_t * payload, uint16_t len){
+    CHECK(len >= 2);
+    uint8_t values[8];
+    switch (payload[0]){
+        case RFCOMM_PN_RSP:
+            CHECK_EQUAL(DLCI, payload[2]);
+            peer_send_frame(DLCI, RFCOMM_SABM, 0, NULL, 0);
+            break;
+        case RFCOMM_MSC_CMD:
+            values[0] = payload[2];
+            values[1] = payload[3];
+            peer_send_mcc(RFCOMM_MSC_RSP, values, 2);
+            break;
+        default:
+            break;
+    }
+}
+
+static void peer_handle_data(const uint8_t * frame, uint16_t size){
+    uint8_t control = frame[1];
+    uint16_t pos = 2;
+    uint16_t len = frame[pos] >> 1;
+    if ((frame[pos++] & 1) == 0){
+        len |= frame[pos++] << 7;
+    }
+    if (control == RFCOMM_UIH_PF){
+        uint8_t credits = frame[pos++];
+        peer.credits += credits;
+        peer.credits_max = btstack_max(peer.credits_max, peer.credits);
+        if (len == 0){
+            peer.rx_credit_frames++;
+        } else {
+            peer.rx_piggybacked_credits++;
+        }
+    }
+    CHECK_EQUAL(pos + len + 1, size);
+    if (len == 0) return;
+
+    // BTstack only sends with credits, data arrives in order
+    CHECK(peer.btstack_credits > 0);
+    peer.btstack_credits--;
+    uint16_t i;
+    for (i=0;i<len;i++){
+        CHECK_EQUAL(test_data_byte(peer.rx_bytes + i), frame[pos + i]);
+    }
+    peer.rx_bytes += len;
+    peer.rx_frames++;
+
+    // return credits in batches
+    peer.frames_since_grant++;
+    if (peer.frames_since_grant >= peer.credit_batch){
+        peer_send_credits(peer.frames_since_grant);
+        peer.frames_since_grant = 0;
+    }
+}
+
+static void peer_handle_frame(const uint8_t * frame, uint16_t size){
+    CHECK(size >= 4);
+    uint8_t dlci = frame[0] >> 2;
+    uint8_t control = frame[1];
+    // UIH frames only cover address and control
+    uint8_t fcs_len = ((control & 0xef) == RFCOMM_UIH) ? 2 : 3;
+    CHECK_EQUAL(btstack_crc8_calc((uint8_t *) frame, fcs_len), frame[size - 1]);
+    uint8_t values[8];
+    switch (control){
+        case RFCOMM_UA:
+            if (dlci == 0){
+                // parameter negotiation with initial credits for BTstack
+                values[0] = DLCI;
+                values[1] = 0xf0;
+                values[2] = 0;
+                values[3] = 0;
+                little_endian_store_16(values, 4, peer.max_frame_size);
+                values[6] = 0;
+                values[7] = peer.initial_credits;
+                peer.btstack_credits = peer.initial_credits;
+                peer_send_mcc(RFCOMM_PN_CMD, values, 8);
+            } else {
+                peer.dlc_open = true;
+                values[0] = (DLCI << 2) | 3;
+                values[1] = 0x8d;
+                peer_send_mcc(RFCOMM_MSC_CMD, values, 2);
+            }
+            break;
+        case RFCOMM_UIH:
+        case RFCOMM_UIH_PF:
+            if (dlci == 0){
+                uint16_t payload_offset = (frame[2] & 1) ? 3 : 4;
+                peer_handle_mcc(&frame[payload_offset], size - payload_offset - 1);
+            } else {
+                peer_handle_data(frame, size);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void peer_stream(void){
+    if (!peer.dlc_open) return;
+    if (peer.send_disc){
+        peer.send_disc = false;
+        peer_send_frame(DLCI, RFCOMM_DISC, 0, NULL, 0);
+    }
+    if (peer.tx_remaining == 0) return;
+    while ((peer.tx_remaining > 0) && (peer.credits > 0) && (pdu_queue_len(&peer_controller) < PEER_ACL_PACKETS_NUM)){
+        uint16_t len = (uint16_t) btstack_min(peer.tx_remaining, peer.tx_frame_size);
+        peer_send_frame(DLCI, RFCOMM_UIH, 0, &test_data[peer.tx_bytes % (TEST_DATA_LEN - L2CAP_MTU)], len);
+        peer.credits--;
+        peer.tx_bytes += len;
+        peer.tx_remaining -= len;
+    }
+    if ((peer.tx_remaining > 0) && (peer.credits == 0) && (pdu_queue_len(&peer_controller) == 0)){
+        peer.tx_starved_us += TICK_US;
+    }
+}
+
+// application on BTstack
+
+static uint16_t app_rfcomm_cid;
+static bool     app_channel_open;
+static uint16_t app_max_frame_size;
+// rfcomm_send per RFCOMM_EVENT_CAN_SEND_NOW
+static uint32_t app_send_remaining;
+static uint32_t app_send_pos;
+static uint16_t app_send_chunk;
+// stream
+static bool     app_stream_complete;
+static uint8_t  app_stream_status;
+static uint32_t app_stream_num_bytes;
+static uint32_t app_pull_pos;
+static uint32_t app_pull_len;
+static uint16_t app_pull_max_len;
+// received data
+static uint32_t app_rx_bytes;
+static uint32_t app_rx_pos;
+// credits provided by application, if incoming flow control is used
+static uint16_t app_credits;
+
+static void app_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    uint16_t i;
+    switch (packet_type){
+        case RFCOMM_DATA_PACKET:
+            CHECK_EQUAL(app_rfcomm_cid, channel);
+            for (i=0;i<size;i++){
+                CHECK_EQUAL(test_data_byte(app_rx_pos + i), packet[i]);
+            }
+            app_rx_pos = (app_rx_pos + size) % (TEST_DATA_LEN - L2CAP_MTU);
+            app_rx_bytes += size;
+            // grant 10 credits when less than 5 are left
+            if (app_credits > 0){
+                app_credits--;
+                if (app_credits < 5){
+                    app_credits += 10;
+                    rfcomm_grant_credits(app_rfcomm_cid, 10);
+                }
+            }
+            break;
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case RFCOMM_EVENT_INCOMING_CONNECTION:
+                    app_rfcomm_cid = rfcomm_event_incoming_connection_get_rfcomm_cid(packet);
+                    rfcomm_accept_connection(app_rfcomm_cid);
+                    break;
+                case RFCOMM_EVENT_CHANNEL_OPENED:
+                    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_event_channel_opened_get_status(packet));
+                    app_max_frame_size = rfcomm_event_channel_opened_get_max_frame_size(packet);
+                    app_channel_open = true;
+                    break;
+                case RFCOMM_EVENT_CHANNEL_CLOSED:
+                    app_channel_open = false;
+                    break;
+                case RFCOMM_EVENT_CAN_SEND_NOW:
+                    if (app_send_remaining == 0) break;
+                    {
+                        uint16_t len = (uint16_t) btstack_min(app_send_remaining, app_send_chunk);
+                        CHECK_EQUAL(0, rfcomm_send(app_rfcomm_cid, &test_data[app_send_pos], len));
+                        app_send_pos += len;
+                        app_send_remaining -= len;
+                    }
+                    if (app_send_remaining > 0){
+                        rfcomm_request_can_send_now_event(app_rfcomm_cid);
+                    }
+                    break;
+                case RFCOMM_EVENT_STREAM_COMPLETE:
+                    CHECK_EQUAL(app_rfcomm_cid, rfcomm_event_stream_complete_get_rfcomm_cid(packet));
+                    app_stream_complete = true;
+                    app_stream_status = rfcomm_event_stream_complete_get_status(packet);
+                    app_stream_num_bytes = rfcomm_event_stream_complete_get_num_bytes(packet);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static uint16_t app_pull_callback(uint16_t rfcomm_cid, uint8_t * buffer, uint16_t buffer_size){
+    CHECK_EQUAL(app_rfcomm_cid, rfcomm_cid);
+    app_pull_max_len = btstack_max(app_pull_max_len, buffer_size);
+    uint16_t len = (uint16_t) btstack_min(app_pull_len - app_pull_pos, buffer_size);
+    memcpy(buffer, &test_data[app_pull_pos], len);
+    app_pull_pos += len;
+    return len;
+}
+
+// simulation
+
+static uint32_t air_time_us(uint16_t l2cap_len){
+    // EDR 3 Mbps: 3-DH1, 3-DH3, 3-DH5 incl. slot for return packet
+    uint16_t acl_len = l2cap_len + 4;
+    if (acl_len <= 83)  return 2 * SLOT_US;
+    if (acl_len <= 552) return 4 * SLOT_US;
+    return 6 * SLOT_US;
+}
+
+static void air_step(void){
+    if (air_active){
+        if (virtual_time_us < air_busy_until_us) return;
+        // packet received, controller buffer is free again
+        pdu_queue_t * source = air_from_btstack ? &btstack_controller : &peer_controller;
+        pdu_queue_t * destination = air_from_btstack ? &to_peer : &to_btstack;
+        pdu_t * pdu = pdu_queue_peek(source);
+        pdu_queue_push(destination, virtual_time_us + host_latency_us, pdu->data, pdu->len);
+        pdu_queue_pop(source);
+        air_active = false;
+    }
+    bool btstack_ready = pdu_queue_len(&btstack_controller) > 0;
+    bool peer_ready    = pdu_queue_len(&peer_controller) > 0;
+    if (!btstack_ready && !peer_ready) return;
+    if (btstack_ready && peer_ready){
+        air_from_btstack = !air_from_btstack;
+    } else {
+        air_from_btstack = btstack_ready;
+    }
+    pdu_t * pdu = pdu_queue_peek(air_from_btstack ? &btstack_controller : &peer_controller);
+    air_busy_until_us = virtual_time_us + air_time_us(pdu->len);
+    air_active = true;
+}
+
+static void sim_step(void){
+    pdu_t * pdu;
+    if (l2cap_emit_channel_opened){
+        l2cap_emit_channel_opened = false;
+        l2cap_emit_opened();
+        // peer starts multiplexer
+        peer_send_frame(0, RFCOMM_SABM, 0, NULL, 0);
+    }
+    while (((pdu = pdu_queue_peek(&to_btstack)) != NULL) && (pdu->time_us <= virtual_time_us)){
+        uint8_t data[L2CAP_MTU];
+        uint16_t len = pdu->len;
+        memcpy(data, pdu->data, len);
+        pdu_queue_pop(&to_btstack);
+        if (l2cap_channel_open){
+            (*l2cap_rfcomm_handler)(L2CAP_DATA_PACKET, L2CAP_CID, data, len);
+        }
+    }
+    while (((pdu = pdu_queue_peek(&to_peer)) != NULL) && (pdu->time_us <= virtual_time_us)){
+        peer_handle_frame(pdu->data, pdu->len);
+        pdu_queue_pop(&to_peer);
+    }
+    if (l2cap_can_send_now_requested && l2cap_channel_open && l2cap_can_send_packet_now(L2CAP_CID)){
+        l2cap_can_send_now_requested = false;
+        l2cap_emit_can_send_now();
+    }
+    peer_stream();
+    air_step();
+    btstack_run_loop_base_process_timers(virtual_time_us / 1000);
+    virtual_time_us += TICK_US;
+    CHECK(virtual_time_us < TIME_LIMIT_US);
+}
+
+static bool stack_active;
+
+static void stack_setup(uint8_t initial_credits, uint8_t credit_batch, uint16_t peer_max_frame_size){
+    uint32_t i;
+    for (i=0;i<TEST_DATA_LEN;i++){
+        test_data[i] = test_data_byte(i);
+    }
+    pdu_queue_reset(&btstack_controller);
+    pdu_queue_reset(&peer_controller);
+    pdu_queue_reset(&to_peer);
+    pdu_queue_reset(&to_btstack);
+    air_active = false;
+    air_from_btstack = false;
+    host_latency_us = HOST_LATENCY_US;
+    l2cap_packet_buffer_reserved = false;
+    l2cap_can_send_now_requested = false;
+    l2cap_emit_channel_opened = false;
+    l2cap_channel_open = false;
+    l2cap_num_packets_sent = 0;
+    l2cap_send_error = 0;
+    memset(&peer, 0, sizeof(peer));
+    peer.initial_credits = initial_credits;
+    peer.credit_batch = credit_batch;
+    peer.max_frame_size = peer_max_frame_size;
+    app_rfcomm_cid = 0;
+    app_channel_open = false;
+    app_send_remaining = 0;
+    app_send_pos = 0;
+    app_stream_complete = false;
+    app_pull_pos = 0;
+    app_pull_len = 0;
+    app_pull_max_len = 0;
+    app_rx_bytes = 0;
+    app_rx_pos = 0;
+    app_credits = 0;
+
+    btstack_memory_init();
+    btstack_run_loop_init(&run_loop_virtual);
+    rfcomm_init();
+    stack_active = true;
+}
+
+static void stack_connect(void){
+    l2cap_emit_incoming_connection();
+    while (!app_channel_open || !peer.dlc_open || (peer.credits == 0)){
+        sim_step();
+    }
+}
+
+static void stack_teardown(void){
+    if (l2cap_channel_open){
+        l2cap_emit_channel_closed();
+    }
+    rfcomm_unregister_service(SERVER_CHANNEL);
+    rfcomm_deinit();
+    btstack_memory_deinit();
+    btstack_run_loop_deinit();
+    stack_active = false;
+}
+
+static void stack_open(uint8_t initial_credits, uint8_t credit_batch, uint16_t peer_max_frame_size){
+    stack_setup(initial_credits, credit_batch, peer_max_frame_size);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_register_service(&app_packet_handler, SERVER_CHANNEL, 0xffff));
+    stack_connect();
+}
+
+static void run_until_received(uint32_t num_bytes){
+    while (peer.rx_bytes < num_bytes){
+        sim_step();
+    }
+}
+
+TEST_GROUP(RfcommStream){
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(RfcommStream, InvalidParameters){
+    stack_open(10, 5, 0xffff);
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, rfcomm_stream_send(app_rfcomm_cid + 1, test_data, 100));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, 100));
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, rfcomm_stream_send(app_rfcomm_cid, test_data, 100));
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, rfcomm_stream_send_with_callback(app_rfcomm_cid, &app_pull_callback));
+    run_until_received(100);
+    CHECK(app_stream_complete);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, app_stream_status);
+    // empty buffer completes right away
+    app_stream_complete = false;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, 0));
+    CHECK(app_stream_complete);
+    CHECK_EQUAL(0, app_stream_num_bytes);
+}
+
+TEST(RfcommStream, BufferInFullFrames){
+    uint32_t len = 100000;
+    stack_open(10, 5, 0xffff);
+    CHECK_EQUAL(L2CAP_MTU - 5, app_max_frame_size);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, len));
+    run_until_received(len);
+    CHECK(app_stream_complete);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, app_stream_status);
+    CHECK_EQUAL(len, app_stream_num_bytes);
+    // frames carry max frame size payload, or one byte less if credits are piggybacked
+    CHECK(peer.rx_frames <= (len + app_max_frame_size - 2) / (app_max_frame_size - 1));
+}
+
+TEST(RfcommStream, RespectsNegotiatedFrameSize){
+    uint32_t len = 10000;
+    stack_open(10, 5, 127);
+    CHECK_EQUAL(127, app_max_frame_size);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, len));
+    run_until_received(len);
+    CHECK(app_stream_complete);
+    CHECK_EQUAL((len + 126) / 127, peer.rx_frames);
+}
+
+TEST(RfcommStream, PullCallback){
+    stack_open(10, 5, 0xffff);
+    app_pull_len = 50000;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send_with_callback(app_rfcomm_cid, &app_pull_callback));
+    run_until_received(app_pull_len);
+    while (!app_stream_complete){
+        sim_step();
+    }
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, app_stream_status);
+    CHECK_EQUAL(app_pull_len, app_stream_num_bytes);
+    CHECK_EQUAL(app_max_frame_size, app_pull_max_len);
+}
+
+TEST(RfcommStream, CreditsPiggybacked){
+    uint32_t len = 100000;
+    // peer grants enough credits so that BTstack does not wait for them
+    stack_open(30, 5, 0xffff);
+    // peer streams to BTstack while BTstack streams to peer
+    peer.tx_frame_size = app_max_frame_size;
+    peer.tx_remaining = len;
+    uint32_t credit_frames_before = peer.rx_credit_frames;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, len));
+    run_until_received(len);
+    CHECK(app_stream_complete);
+    CHECK(peer.rx_piggybacked_credits > 0);
+    CHECK(peer.rx_credit_frames - credit_frames_before < peer.rx_piggybacked_credits / 4);
+}
+
+TEST(RfcommStream, ChannelClosedDuringStream){
+    stack_open(10, 5, 0xffff);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, 100000));
+    run_until_received(10000);
+    peer.send_disc = true;
+    while (app_channel_open){
+        sim_step();
+    }
+    CHECK(app_stream_complete);
+    CHECK_EQUAL(RFCOMM_STREAM_CHANNEL_CLOSED, app_stream_status);
+    CHECK(app_stream_num_bytes < 100000);
+}
+
+TEST(RfcommStream, SendErrorReleasesBuffer){
+    stack_open(10, 5, 0xffff);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, 100000));
+    run_until_received(10000);
+    uint32_t bytes_received = peer.rx_bytes;
+    l2cap_send_error = -1;
+    while (!app_stream_complete){
+        sim_step();
+    }
+    CHECK_EQUAL(0xff, app_stream_status);
+    CHECK(!l2cap_packet_buffer_reserved);
+    // channel can be used afterwards
+    l2cap_send_error = 0;
+    while (pdu_queue_len(&to_peer) > 0){
+        sim_step();
+    }
+    app_stream_complete = false;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, &test_data[app_stream_num_bytes], 1000));
+    run_until_received(app_stream_num_bytes + 1000);
+    CHECK(app_stream_complete);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, app_stream_status);
+    CHECK(peer.rx_bytes >= bytes_received);
+}
+
+TEST_GROUP(RfcommCredits){
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(RfcommCredits, AutomaticCreditsStartSmall){
+    stack_open(10, 5, 0xffff);
+    CHECK_EQUAL(10, peer.credits);
+}
+
+TEST(RfcommCredits, AutomaticCreditsGrowIfRemoteWaits){
+    uint32_t len = 100000;
+    stack_open(10, 5, 127);
+    host_latency_us = HOST_LATENCY_SLOW_US;
+    peer.tx_frame_size = 127;
+    peer.tx_remaining = len;
+    while (app_rx_bytes < len){
+        sim_step();
+    }
+    // credits limited by RFCOMM_CREDITS_MAX
+    CHECK(peer.credits_max > 15);
+    CHECK(peer.credits_max <= 64);
+}
+
+// throughput
+
+typedef struct {
+    double   goodput;
+    uint32_t l2cap_packets;
+    uint32_t credit_frames;
+    uint32_t piggybacked_credits;
+} send_result_t;
+
+typedef enum {
+    SEND_MODE_RFCOMM_SEND = 0,
+    SEND_MODE_STREAM_BUFFER,
+    SEND_MODE_STREAM_CALLBACK,
+} send_mode_t;
+
+static send_result_t send_benchmark(const char * name, send_mode_t mode, uint16_t chunk_size, uint32_t peer_tx_bytes){
+    uint32_t len = TEST_DATA_LEN;
+    stack_open(30, 5, 0xffff);
+    uint32_t start_us = virtual_time_us;
+    uint32_t packets_before = l2cap_num_packets_sent;
+    uint32_t credit_frames_before = peer.rx_credit_frames;
+    peer.tx_frame_size = app_max_frame_size;
+    peer.tx_remaining = peer_tx_bytes;
+    switch (mode){
+        case SEND_MODE_RFCOMM_SEND:
+            app_send_chunk = chunk_size;
+            app_send_remaining = len;
+            rfcomm_request_can_send_now_event(app_rfcomm_cid);
+            break;
+        case SEND_MODE_STREAM_BUFFER:
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send(app_rfcomm_cid, test_data, len));
+            break;
+        case SEND_MODE_STREAM_CALLBACK:
+            app_pull_len = len;
+            CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_stream_send_with_callback(app_rfcomm_cid, &app_pull_callback));
+            break;
+        default:
+            break;
+    }
+    run_until_received(len);
+    send_result_t result;
+    result.goodput = (double) len * 1000.0 / (double) (virtual_time_us - start_us);
+    result.l2cap_packets = l2cap_num_packets_sent - packets_before;
+    result.credit_frames = peer.rx_credit_frames - credit_frames_before;
+    result.piggybacked_credits = peer.rx_piggybacked_credits;
+    printf("%-36s %6.1f kB/s, %4u L2CAP packets, %3u credit frames, %3u credits with data\n",
+           name, result.goodput, result.l2cap_packets, result.credit_frames, result.piggybacked_credits);
+    stack_teardown();
+    return result;
+}
+
+typedef struct {
+    double   goodput;
+    uint16_t max_credits;
+    uint32_t starved_ms;
+} receive_result_t;
+
+static receive_result_t receive_benchmark(const char * name, bool app_credits_fixed, uint16_t frame_size){
+    uint32_t len = TEST_DATA_LEN;
+    stack_setup(10, 5, frame_size);
+    if (app_credits_fixed){
+        // previous automatic credits: grant 10 credits when less than 5 are left
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_register_service_with_initial_credits(&app_packet_handler, SERVER_CHANNEL, 0xffff, 10));
+        app_credits = 10;
+    } else {
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, rfcomm_register_service(&app_packet_handler, SERVER_CHANNEL, 0xffff));
+    }
+    stack_connect();
+    host_latency_us = HOST_LATENCY_SLOW_US;
+    uint32_t start_us = virtual_time_us;
+    peer.tx_frame_size = frame_size;
+    peer.tx_remaining = len;
+    while (app_rx_bytes < len){
+        sim_step();
+    }
+    receive_result_t result;
+    result.goodput = (double) len * 1000.0 / (double) (virtual_time_us - start_us);
+    result.max_credits = peer.credits_max;
+    result.starved_ms = peer.tx_starved_us / 1000;
+    printf("%-36s %6.1f kB/s, max %3u credits, remote waited for credits %4u ms\n",
+           name, result.goodput, result.max_credits, result.starved_ms);
+    stack_teardown();
+    return result;
+}
+
+TEST_GROUP(RfcommThroughput){
+    void teardown(void){
+        if (stack_active){
+            stack_teardown();
+        }
+    }
+};
+
+TEST(RfcommThroughput, SendVsStream){
+    printf("\n");
+    send_result_t small  = send_benchmark("rfcomm_send, 100 byte writes", SEND_MODE_RFCOMM_SEND, 100, 0);
+    send_result_t full   = send_benchmark("rfcomm_send, max frame size writes", SEND_MODE_RFCOMM_SEND, L2CAP_MTU - 5, 0);
+    send_result_t buffer = send_benchmark("rfcomm_stream_send", SEND_MODE_STREAM_BUFFER, 0, 0);
+    send_result_t pull   = send_benchmark("rfcomm_stream_send_with_callback", SEND_MODE_STREAM_CALLBACK, 0, 0);
+    // full frames use 3-DH5 packets
+    CHECK(buffer.goodput > small.goodput * 2);
+    CHECK(buffer.goodput >= full.goodput * 0.95);
+    CHECK(pull.goodput >= full.goodput * 0.95);
+    CHECK(buffer.l2cap_packets * 5 < small.l2cap_packets);
+}
+
+TEST(RfcommThroughput, Bidirectional){
+    printf("\n");
+    send_result_t full   = send_benchmark("rfcomm_send + peer streams", SEND_MODE_RFCOMM_SEND, L2CAP_MTU - 5, TEST_DATA_LEN);
+    send_result_t buffer = send_benchmark("rfcomm_stream_send + peer streams", SEND_MODE_STREAM_BUFFER, 0, TEST_DATA_LEN);
+    // credits for received data are sent with stream data
+    CHECK(buffer.credit_frames * 4 < full.credit_frames);
+    CHECK(buffer.l2cap_packets < full.l2cap_packets);
+}
+
+TEST(RfcommThroughput, AutomaticVsFixedCredits){
+    printf("\n");
+    receive_result_t fixed_small     = receive_benchmark("Fixed credits, 127 byte frames", true, 127);
+    receive_result_t automatic_small = receive_benchmark("Automatic credits, 127 byte frames", false, 127);
+    receive_result_t fixed_full      = receive_benchmark("Fixed credits, max frame size", true, L2CAP_MTU - 5);
+    receive_result_t automatic_full  = receive_benchmark("Automatic credits, max frame size", false, L2CAP_MTU - 5);
+    CHECK(automatic_small.goodput > fixed_small.goodput);
+    CHECK(automatic_small.starved_ms < fixed_small.starved_ms);
+    CHECK(automatic_full.goodput >= fixed_full.goodput * 0.95);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
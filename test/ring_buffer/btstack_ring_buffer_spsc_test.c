@@ -0,0 +1,285 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+#include "bluetooth.h"
+#include "btstack_ring_buffer.h"
+#include "btstack_ring_buffer_spsc.h"
+#include "btstack_util.h"
+
+#define STORAGE_SIZE 16
+
+static uint8_t storage[STORAGE_SIZE];
+
+TEST_GROUP(RingBufferSPSC){
+    btstack_ring_buffer_spsc_t ring_buffer;
+
+    void setup(void){
+        memset(storage, 0, sizeof(storage));
+        btstack_ring_buffer_spsc_init(&ring_buffer, storage, sizeof(storage));
+    }
+};
+
+TEST(RingBufferSPSC, InitSize){
+    btstack_ring_buffer_spsc_t other;
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_ring_buffer_spsc_init(&other, storage, 0));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_ring_buffer_spsc_init(&other, storage, 10));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, btstack_ring_buffer_spsc_init(&other, storage, 8));
+}
+
+TEST(RingBufferSPSC, EmptyBuffer){
+    CHECK_EQUAL(0, btstack_ring_buffer_spsc_bytes_available(&ring_buffer));
+    CHECK_EQUAL(STORAGE_SIZE, btstack_ring_buffer_spsc_bytes_free(&ring_buffer));
+    uint8_t data[4];
+    uint32_t number_of_bytes_read = 1;
+    btstack_ring_buffer_spsc_read(&ring_buffer, data, sizeof(data), &number_of_bytes_read);
+    CHECK_EQUAL(0, number_of_bytes_read);
+}
+
+TEST(RingBufferSPSC, WriteReadWrapAround){
+    uint8_t write_data[STORAGE_SIZE];
+    uint8_t read_data[STORAGE_SIZE];
+    uint32_t number_of_bytes_read;
+    int i;
+    for (i = 0; i < STORAGE_SIZE; i++){
+        write_data[i] = (uint8_t) i;
+    }
+    // move indices close to end
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, btstack_ring_buffer_spsc_write(&ring_buffer, write_data, 12));
+    btstack_ring_buffer_spsc_read(&ring_buffer, read_data, 12, &number_of_bytes_read);
+    CHECK_EQUAL(12, number_of_bytes_read);
+
+    // wrap around
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, btstack_ring_buffer_spsc_write(&ring_buffer, write_data, 10));
+    CHECK_EQUAL(10, btstack_ring_buffer_spsc_bytes_available(&ring_buffer));
+    CHECK_EQUAL(6, btstack_ring_buffer_spsc_bytes_free(&ring_buffer));
+    memset(read_data, 0, sizeof(read_data));
+    btstack_ring_buffer_spsc_read(&ring_buffer, read_data, sizeof(read_data), &number_of_bytes_read);
+    CHECK_EQUAL(10, number_of_bytes_read);
+    MEMCMP_EQUAL(write_data, read_data, 10);
+}
+
+TEST(RingBufferSPSC, WriteFull){
+    uint8_t write_data[STORAGE_SIZE + 1];
+    memset(write_data, 0x55, sizeof(write_data));
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, btstack_ring_buffer_spsc_write(&ring_buffer, write_data, sizeof(write_data)));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, btstack_ring_buffer_spsc_write(&ring_buffer, write_data, STORAGE_SIZE));
+    CHECK_EQUAL(0, btstack_ring_buffer_spsc_bytes_free(&ring_buffer));
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, btstack_ring_buffer_spsc_write(&ring_buffer, write_data, 1));
+    CHECK_EQUAL(STORAGE_SIZE, btstack_ring_buffer_spsc_bytes_available(&ring_buffer));
+}
+
+TEST(RingBufferSPSC, ContiguousRegions){
+    uint8_t write_data[STORAGE_SIZE];
+    uint8_t read_data[STORAGE_SIZE];
+    uint32_t number_of_bytes_read;
+    uint32_t length;
+    memset(write_data, 0, sizeof(write_data));
+    btstack_ring_buffer_spsc_write(&ring_buffer, write_data, 12);
+    btstack_ring_buffer_spsc_read(&ring_buffer, read_data, 10, &number_of_bytes_read);
+
+    // write region ends at end of storage
+    uint8_t * write_ptr = btstack_ring_buffer_spsc_get_write_ptr(&ring_buffer, &length);
+    POINTERS_EQUAL(&storage[12], write_ptr);
+    CHECK_EQUAL(4, length);
+    memset(write_ptr, 0x11, 4);
+    btstack_ring_buffer_spsc_commit(&ring_buffer, 4);
+
+    // followed by region at start, limited by read index
+    write_ptr = btstack_ring_buffer_spsc_get_write_ptr(&ring_buffer, &length);
+    POINTERS_EQUAL(&storage[0], write_ptr);
+    CHECK_EQUAL(10, length);
+    memset(write_ptr, 0x22, 3);
+    btstack_ring_buffer_spsc_commit(&ring_buffer, 3);
+    CHECK_EQUAL(9, btstack_ring_buffer_spsc_bytes_available(&ring_buffer));
+
+    // read region ends at end of storage
+    const uint8_t * read_ptr = btstack_ring_buffer_spsc_get_read_ptr(&ring_buffer, &length);
+    POINTERS_EQUAL(&storage[10], read_ptr);
+    CHECK_EQUAL(6, length);
+    CHECK_EQUAL(0x11, read_ptr[5]);
+    btstack_ring_buffer_spsc_consume(&ring_buffer, 6);
+
+    read_ptr = btstack_ring_buffer_spsc_get_read_ptr(&ring_buffer, &length);
+    POINTERS_EQUAL(&storage[0], read_ptr);
+    CHECK_EQUAL(3, length);
+    CHECK_EQUAL(0x22, read_ptr[2]);
+    btstack_ring_buffer_spsc_consume(&ring_buffer, 3);
+    CHECK_EQUAL(STORAGE_SIZE, btstack_ring_buffer_spsc_bytes_free(&ring_buffer));
+}
+
+// Stress test: producer and consumer thread transfer a byte sequence in varying chunk sizes.
+// The same transfer over btstack_ring_buffer protected by a mutex serves as reference.
+
+#define STRESS_STORAGE_SIZE  4096
+#define STRESS_NUM_BYTES     (32u * 1024u * 1024u)
+#define STRESS_MAX_CHUNK     700
+
+static uint8_t stress_storage[STRESS_STORAGE_SIZE];
+static btstack_ring_buffer_spsc_t stress_spsc;
+static btstack_ring_buffer_t stress_mutex_ring_buffer;
+static pthread_mutex_t stress_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t stress_errors;
+
+static inline uint8_t stress_pattern(uint32_t pos){
+    return (uint8_t) ((pos * 7u) ^ (pos >> 9));
+}
+
+static uint32_t stress_chunk_size(uint32_t * seed){
+    *seed = (*seed * 1103515245u) + 12345u;
+    return 1u + ((*seed >> 16) % STRESS_MAX_CHUNK);
+}
+
+static void * stress_spsc_producer(void * context){
+    (void) context;
+    uint8_t chunk[STRESS_MAX_CHUNK];
+    uint32_t seed = 1;
+    uint32_t pos = 0;
+    while (pos < STRESS_NUM_BYTES){
+        uint32_t len = btstack_min(stress_chunk_size(&seed), STRESS_NUM_BYTES - pos);
+        uint32_t i;
+        if ((seed & 0x10000u) != 0u){
+            // copy
+            for (i = 0; i < len; i++){
+                chunk[i] = stress_pattern(pos + i);
+            }
+            while (btstack_ring_buffer_spsc_write(&stress_spsc, chunk, len) != ERROR_CODE_SUCCESS){
+                sched_yield();
+            }
+        } else {
+            // generate directly in ring buffer
+            uint32_t region_len;
+            uint8_t * region = btstack_ring_buffer_spsc_get_write_ptr(&stress_spsc, &region_len);
+            if (region_len == 0){
+                sched_yield();
+                continue;
+            }
+            len = btstack_min(len, region_len);
+            for (i = 0; i < len; i++){
+                region[i] = stress_pattern(pos + i);
+            }
+            btstack_ring_buffer_spsc_commit(&stress_spsc, len);
+        }
+        pos += len;
+    }
+    return NULL;
+}
+
+static void * stress_spsc_consumer(void * context){
+    (void) context;
+    uint8_t chunk[STRESS_MAX_CHUNK];
+    uint32_t seed = 2;
+    uint32_t pos = 0;
+    while (pos < STRESS_NUM_BYTES){
+        uint32_t len = stress_chunk_size(&seed);
+        uint32_t i;
+        if ((seed & 0x10000u) != 0u){
+            // copy
+            btstack_ring_buffer_spsc_read(&stress_spsc, chunk, len, &len);
+            for (i = 0; i < len; i++){
+                if (chunk[i] != stress_pattern(pos + i)) stress_errors++;
+            }
+        } else {
+            // process in place
+            uint32_t region_len;
+            const uint8_t * region = btstack_ring_buffer_spsc_get_read_ptr(&stress_spsc, &region_len);
+            len = btstack_min(len, region_len);
+            for (i = 0; i < len; i++){
+                if (region[i] != stress_pattern(pos + i)) stress_errors++;
+            }
+            btstack_ring_buffer_spsc_consume(&stress_spsc, len);
+        }
+        if (len == 0){
+            sched_yield();
+        }
+        pos += len;
+    }
+    return NULL;
+}
+
+static void * stress_mutex_producer(void * context){
+    (void) context;
+    uint8_t chunk[STRESS_MAX_CHUNK];
+    uint32_t seed = 1;
+    uint32_t pos = 0;
+    while (pos < STRESS_NUM_BYTES){
+        uint32_t len = btstack_min(stress_chunk_size(&seed), STRESS_NUM_BYTES - pos);
+        uint32_t i;
+        for (i = 0; i < len; i++){
+            chunk[i] = stress_pattern(pos + i);
+        }
+        while (true){
+            pthread_mutex_lock(&stress_mutex);
+            int status = btstack_ring_buffer_write(&stress_mutex_ring_buffer, chunk, len);
+            pthread_mutex_unlock(&stress_mutex);
+            if (status == 0) break;
+            sched_yield();
+        }
+        pos += len;
+    }
+    return NULL;
+}
+
+static void * stress_mutex_consumer(void * context){
+    (void) context;
+    uint8_t chunk[STRESS_MAX_CHUNK];
+    uint32_t seed = 2;
+    uint32_t pos = 0;
+    while (pos < STRESS_NUM_BYTES){
+        uint32_t len = stress_chunk_size(&seed);
+        uint32_t i;
+        pthread_mutex_lock(&stress_mutex);
+        btstack_ring_buffer_read(&stress_mutex_ring_buffer, chunk, len, &len);
+        pthread_mutex_unlock(&stress_mutex);
+        for (i = 0; i < len; i++){
+            if (chunk[i] != stress_pattern(pos + i)) stress_errors++;
+        }
+        if (len == 0){
+            sched_yield();
+        }
+        pos += len;
+    }
+    return NULL;
+}
+
+static double stress_run(void * (*producer)(void *), void * (*consumer)(void *)){
+    struct timespec start;
+    struct timespec end;
+    pthread_t producer_thread;
+    pthread_t consumer_thread;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&consumer_thread, NULL, consumer, NULL);
+    pthread_create(&producer_thread, NULL, producer, NULL);
+    pthread_join(producer_thread, NULL);
+    pthread_join(consumer_thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((double) (end.tv_sec - start.tv_sec) * 1000.0) + ((double) (end.tv_nsec - start.tv_nsec) / 1000000.0);
+}
+
+TEST_GROUP(RingBufferStress){
+    void setup(void){
+        stress_errors = 0;
+    }
+};
+
+TEST(RingBufferStress, ConcurrentProducerConsumer){
+    btstack_ring_buffer_init(&stress_mutex_ring_buffer, stress_storage, sizeof(stress_storage));
+    double mutex_ms = stress_run(&stress_mutex_producer, &stress_mutex_consumer);
+    CHECK_EQUAL(0, stress_errors);
+    CHECK_EQUAL(0, btstack_ring_buffer_bytes_available(&stress_mutex_ring_buffer));
+
+    btstack_ring_buffer_spsc_init(&stress_spsc, stress_storage, sizeof(stress_storage));
+    double spsc_ms = stress_run(&stress_spsc_producer, &stress_spsc_consumer);
+    CHECK_EQUAL(0, stress_errors);
+    CHECK_EQUAL(0, btstack_ring_buffer_spsc_bytes_available(&stress_spsc));
+
+    printf("%u MB: btstack_ring_buffer with mutex %.1f ms, btstack_ring_buffer_spsc %.1f ms\n",
+           STRESS_NUM_BYTES / (1024u * 1024u), mutex_ms, spsc_ms);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,218 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+
+#define NUM_TIMERS 200
+
+static btstack_timer_source_t timers[NUM_TIMERS];
+static int      num_timers_fired;
+static uint32_t last_timeout_fired;
+static bool     timers_in_order;
+static btstack_timer_source_t * timer_to_remove;
+static btstack_timer_source_t * timer_to_add;
+
+static void timer_handler(btstack_timer_source_t * ts){
+    if (num_timers_fired > 0){
+        if (btstack_time_delta(ts->timeout, last_timeout_fired) < 0){
+            timers_in_order = false;
+        }
+    }
+    last_timeout_fired = ts->timeout;
+    num_timers_fired++;
+    ts->context = (void *) 1;
+    if (timer_to_remove != NULL){
+        btstack_run_loop_base_remove_timer(timer_to_remove);
+        timer_to_remove = NULL;
+    }
+    if (timer_to_add != NULL){
+        btstack_run_loop_base_add_timer(timer_to_add);
+        timer_to_add = NULL;
+    }
+}
+
+static void setup_timers(int num, uint32_t base_time){
+    int i;
+    for (i=0;i<num;i++){
+        btstack_run_loop_set_timer_handler(&timers[i], &timer_handler);
+        timers[i].timeout = base_time + ((i * 7919) % 1000);
+        timers[i].context = NULL;
+        btstack_run_loop_base_add_timer(&timers[i]);
+    }
+}
+
+TEST_GROUP(RunLoopBaseTimer){
+    void setup(void){
+        btstack_run_loop_base_init();
+        memset(timers, 0, sizeof(timers));
+        num_timers_fired = 0;
+        last_timeout_fired = 0;
+        timers_in_order = true;
+        timer_to_remove = NULL;
+        timer_to_add = NULL;
+    }
+};
+
+TEST(RunLoopBaseTimer, Order){
+    setup_timers(NUM_TIMERS, 0);
+    uint32_t now;
+    for (now = 0; now < 1000; now += 10){
+        btstack_run_loop_base_process_timers(now);
+        int32_t next_timeout = btstack_run_loop_base_get_time_until_timeout(now);
+        CHECK(next_timeout != 0);
+    }
+    btstack_run_loop_base_process_timers(now);
+    CHECK_EQUAL(NUM_TIMERS, num_timers_fired);
+    CHECK(timers_in_order);
+    CHECK(btstack_run_loop_base_timers == NULL);
+    CHECK_EQUAL(-1, btstack_run_loop_base_get_time_until_timeout(now));
+}
+
+TEST(RunLoopBaseTimer, Overrun){
+    setup_timers(NUM_TIMERS, 0xfffffe00UL);
+    btstack_run_loop_base_dump_timer();
+    btstack_run_loop_base_process_timers(0xffffff00UL);
+    CHECK(num_timers_fired > 0);
+    CHECK(num_timers_fired < NUM_TIMERS);
+    btstack_run_loop_base_process_timers(0x00000400UL);
+    CHECK_EQUAL(NUM_TIMERS, num_timers_fired);
+    CHECK(timers_in_order);
+}
+
+TEST(RunLoopBaseTimer, Remove){
+    setup_timers(NUM_TIMERS, 0);
+    int i;
+    int num_removed = 0;
+    for (i=0;i<NUM_TIMERS;i+=3){
+        CHECK(btstack_run_loop_base_remove_timer(&timers[i]));
+        num_removed++;
+    }
+    // remove again
+    CHECK(btstack_run_loop_base_remove_timer(&timers[0]) == false);
+    btstack_run_loop_base_process_timers(1000);
+    CHECK_EQUAL(NUM_TIMERS - num_removed, num_timers_fired);
+    CHECK(timers_in_order);
+    for (i=0;i<NUM_TIMERS;i++){
+        CHECK_EQUAL((i % 3) != 0, timers[i].context != NULL);
+    }
+}
+
+TEST(RunLoopBaseTimer, AddTwice){
+    setup_timers(2, 0);
+    btstack_run_loop_base_add_timer(&timers[1]);
+    btstack_run_loop_base_process_timers(1000);
+    CHECK_EQUAL(2, num_timers_fired);
+}
+
+TEST(RunLoopBaseTimer, AddCopyOfTimer){
+    setup_timers(NUM_TIMERS, 0);
+    // copy of a timer that is not the root keeps its stale links, but is not in the list
+    btstack_timer_source_t copy = timers[NUM_TIMERS / 2];
+    CHECK(btstack_run_loop_base_remove_timer(&copy) == false);
+    btstack_run_loop_base_add_timer(&copy);
+    btstack_run_loop_base_process_timers(1000);
+    CHECK_EQUAL(NUM_TIMERS + 1, num_timers_fired);
+    CHECK(timers_in_order);
+}
+
+TEST(RunLoopBaseTimer, AddUninitializedTimer){
+    setup_timers(NUM_TIMERS, 0);
+    // links of a timer that was never added are not followed
+    btstack_timer_source_t uninitialized;
+    memset(&uninitialized, 0xa5, sizeof(uninitialized));
+    btstack_run_loop_set_timer_handler(&uninitialized, &timer_handler);
+    uninitialized.timeout = 500;
+    CHECK(btstack_run_loop_base_remove_timer(&uninitialized) == false);
+    btstack_run_loop_base_add_timer(&uninitialized);
+    btstack_run_loop_base_process_timers(1000);
+    CHECK_EQUAL(NUM_TIMERS + 1, num_timers_fired);
+    CHECK(timers_in_order);
+}
+
+TEST(RunLoopBaseTimer, ModifyInHandler){
+    setup_timers(10, 0);
+    // timer 1 has the largest timeout
+    timer_to_remove = &timers[1];
+    timers[10].timeout = 20;
+    btstack_run_loop_set_timer_handler(&timers[10], &timer_handler);
+    timer_to_add = &timers[10];
+    btstack_run_loop_base_process_timers(1000);
+    CHECK_EQUAL(10, num_timers_fired);
+    CHECK(timers[1].context == NULL);
+    CHECK(timers[10].context != NULL);
+}
+
+// Benchmark: insert, cancel/re-arm and expire cost for 10, 1k, 100k timers
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+static void benchmark_timers(int num){
+    btstack_timer_source_t * bench_timers = (btstack_timer_source_t *) calloc(num, sizeof(btstack_timer_source_t));
+    btstack_run_loop_base_init();
+    num_timers_fired = 0;
+    timers_in_order = true;
+    uint32_t range = 10 * num;
+    int i;
+
+    uint64_t start_ns = get_time_ns();
+    for (i=0;i<num;i++){
+        btstack_run_loop_set_timer_handler(&bench_timers[i], &timer_handler);
+        bench_timers[i].timeout = (uint32_t) rand() % range;
+        btstack_run_loop_base_add_timer(&bench_timers[i]);
+    }
+    uint64_t insert_ns = get_time_ns() - start_ns;
+
+    // cancel and re-arm, e.g. retransmission timer restarted on each packet
+    start_ns = get_time_ns();
+    for (i=0;i<num;i++){
+        btstack_timer_source_t * ts = &bench_timers[(uint32_t) rand() % num];
+        btstack_run_loop_base_remove_timer(ts);
+        ts->timeout = (uint32_t) rand() % range;
+        btstack_run_loop_base_add_timer(ts);
+    }
+    uint64_t rearm_ns = get_time_ns() - start_ns;
+
+    start_ns = get_time_ns();
+    btstack_run_loop_base_process_timers(range);
+    uint64_t expire_ns = get_time_ns() - start_ns;
+
+    CHECK_EQUAL(num, num_timers_fired);
+    CHECK(timers_in_order);
+    free(bench_timers);
+
+    printf("%6u timers: insert %6u ns, cancel+re-arm %6u ns, expire %6u ns (per timer)\n", num,
+           (unsigned int) (insert_ns / num), (unsigned int) (rearm_ns / num), (unsigned int) (expire_ns / num));
+}
+
+TEST(RunLoopBaseTimer, Benchmark){
+#ifdef ENABLE_RUN_LOOP_TIMER_HEAP
+    printf("Timer heap\n");
+#else
+    printf("Sorted timer list\n");
+#endif
+    srand(0);
+    benchmark_timers(10);
+    benchmark_timers(1000);
+#ifdef ENABLE_RUN_LOOP_TIMER_HEAP
+    benchmark_timers(100000);
+#else
+    // O(n) insert makes 100k timers too slow
+    benchmark_timers(10000);
+#endif
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
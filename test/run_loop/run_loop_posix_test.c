@@ -0,0 +1,466 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/select.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#ifdef __linux__
+#include "btstack_run_loop_epoll.h"
+#endif
+#include "btstack_util.h"
+
+#define MAX_NUM_DATA_SOURCES 1000
+
+static btstack_data_source_t data_sources[MAX_NUM_DATA_SOURCES];
+static int data_source_fds[MAX_NUM_DATA_SOURCES];
+static int pipe_write_fds[MAX_NUM_DATA_SOURCES];
+static int num_data_sources;
+
+static btstack_timer_source_t timer;
+static bool timer_called;
+
+static int read_callbacks;
+static int write_callbacks;
+static btstack_data_source_t * last_data_source;
+static btstack_data_source_t * data_source_to_remove;
+static struct timespec dispatch_ts;
+
+static void (*execute_once)(void);
+
+static void timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    timer_called = true;
+}
+
+static void data_source_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    clock_gettime(CLOCK_MONOTONIC, &dispatch_ts);
+    last_data_source = ds;
+    switch (callback_type){
+        case DATA_SOURCE_CALLBACK_READ:
+            read_callbacks++;
+            uint8_t buffer[8];
+            (void) read(ds->source.fd, buffer, sizeof(buffer));
+            break;
+        case DATA_SOURCE_CALLBACK_WRITE:
+            write_callbacks++;
+            btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_WRITE);
+            break;
+        default:
+            break;
+    }
+    if (data_source_to_remove != NULL){
+        btstack_run_loop_remove_data_source(data_source_to_remove);
+        data_source_to_remove = NULL;
+    }
+}
+
+static void setup_pipe_data_sources(int num){
+    int i;
+    for (i=0;i<num;i++){
+        int fds[2];
+        CHECK_EQUAL(0, pipe(fds));
+        data_source_fds[i] = fds[0];
+        pipe_write_fds[i]  = fds[1];
+        btstack_run_loop_set_data_source_fd(&data_sources[i], fds[0]);
+        btstack_run_loop_set_data_source_handler(&data_sources[i], &data_source_handler);
+        btstack_run_loop_enable_data_source_callbacks(&data_sources[i], DATA_SOURCE_CALLBACK_READ);
+        btstack_run_loop_add_data_source(&data_sources[i]);
+    }
+    num_data_sources = num;
+}
+
+static void close_data_sources(void){
+    int i;
+    for (i=0;i<num_data_sources;i++){
+        btstack_run_loop_remove_data_source(&data_sources[i]);
+        close(data_source_fds[i]);
+        if (pipe_write_fds[i] >= 0){
+            close(pipe_write_fds[i]);
+        }
+    }
+    num_data_sources = 0;
+}
+
+static void trigger_pipe(int index){
+    uint8_t data = 0x55;
+    CHECK_EQUAL(1, write(pipe_write_fds[index], &data, 1));
+}
+
+// make execute_once return without data source activity
+static void add_immediate_timer(void){
+    btstack_run_loop_set_timer_handler(&timer, &timer_handler);
+    btstack_run_loop_set_timer(&timer, 0);
+    btstack_run_loop_add_timer(&timer);
+}
+
+static void reset_state(void){
+    read_callbacks = 0;
+    write_callbacks = 0;
+    last_data_source = NULL;
+    data_source_to_remove = NULL;
+    timer_called = false;
+    num_data_sources = 0;
+    memset(data_sources, 0, sizeof(data_sources));
+}
+
+static void test_read(void){
+    setup_pipe_data_sources(3);
+    trigger_pipe(1);
+    execute_once();
+    CHECK_EQUAL(1, read_callbacks);
+    CHECK(last_data_source == &data_sources[1]);
+    close_data_sources();
+}
+
+static void test_disabled_read(void){
+    setup_pipe_data_sources(1);
+    btstack_run_loop_disable_data_source_callbacks(&data_sources[0], DATA_SOURCE_CALLBACK_READ);
+    trigger_pipe(0);
+    add_immediate_timer();
+    execute_once();
+    CHECK_EQUAL(0, read_callbacks);
+    CHECK(timer_called);
+    // re-enable
+    btstack_run_loop_enable_data_source_callbacks(&data_sources[0], DATA_SOURCE_CALLBACK_READ);
+    execute_once();
+    CHECK_EQUAL(1, read_callbacks);
+    close_data_sources();
+}
+
+static void test_write(void){
+    setup_pipe_data_sources(1);
+    // pipe write end is always writable
+    btstack_run_loop_remove_data_source(&data_sources[0]);
+    btstack_run_loop_set_data_source_fd(&data_sources[0], pipe_write_fds[0]);
+    btstack_run_loop_disable_data_source_callbacks(&data_sources[0], DATA_SOURCE_CALLBACK_READ);
+    btstack_run_loop_enable_data_source_callbacks(&data_sources[0], DATA_SOURCE_CALLBACK_WRITE);
+    btstack_run_loop_add_data_source(&data_sources[0]);
+    execute_once();
+    CHECK_EQUAL(1, write_callbacks);
+    // write callback disabled itself
+    add_immediate_timer();
+    execute_once();
+    CHECK_EQUAL(1, write_callbacks);
+    btstack_run_loop_set_data_source_fd(&data_sources[0], data_source_fds[0]);
+    close_data_sources();
+}
+
+static void test_remove_in_callback(void){
+    setup_pipe_data_sources(2);
+    trigger_pipe(0);
+    trigger_pipe(1);
+    data_source_to_remove = &data_sources[0];
+    execute_once();
+    CHECK_EQUAL(1, read_callbacks);
+    btstack_data_source_t * removed = (last_data_source == &data_sources[0]) ? &data_sources[1] : &data_sources[0];
+    // the other data source is still pending, unless it was the one removed
+    data_source_to_remove = NULL;
+    add_immediate_timer();
+    execute_once();
+    if (removed == &data_sources[0]){
+        CHECK_EQUAL(1, read_callbacks);
+    } else {
+        CHECK_EQUAL(2, read_callbacks);
+    }
+    btstack_run_loop_add_data_source(&data_sources[0]);
+    close_data_sources();
+}
+
+static void test_timer(void){
+    btstack_run_loop_set_timer_handler(&timer, &timer_handler);
+    btstack_run_loop_set_timer(&timer, 5);
+    btstack_run_loop_add_timer(&timer);
+    while (timer_called == false){
+        execute_once();
+    }
+    CHECK(timer_called);
+}
+
+TEST_GROUP(RunLoopPosix){
+    void setup(void){
+        reset_state();
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        execute_once = &btstack_run_loop_posix_execute_once;
+    }
+    void teardown(void){
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(RunLoopPosix, Read){
+    test_read();
+}
+
+TEST(RunLoopPosix, DisabledRead){
+    test_disabled_read();
+}
+
+TEST(RunLoopPosix, Write){
+    test_write();
+}
+
+TEST(RunLoopPosix, RemoveInCallback){
+    test_remove_in_callback();
+}
+
+TEST(RunLoopPosix, Timer){
+    test_timer();
+}
+
+// Callback queue for other threads
+
+#define NUM_PRODUCERS         4
+#define CALLS_PER_PRODUCER    100000
+#define LATENCY_ITERATIONS    1000
+
+static uint32_t calls_received[NUM_PRODUCERS];
+static bool     calls_in_order;
+static uint32_t calls_total;
+static uint32_t calls_queue_full;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+static void producer_call(void * arg){
+    uintptr_t value = (uintptr_t) arg;
+    uint32_t producer = value >> 24;
+    uint32_t sequence = value & 0xffffff;
+    if (calls_received[producer] != sequence){
+        calls_in_order = false;
+    }
+    calls_received[producer] = sequence + 1;
+    calls_total++;
+}
+
+static void * producer_thread(void * context){
+    uintptr_t producer = (uintptr_t) context;
+    uint32_t i;
+    for (i=0;i<CALLS_PER_PRODUCER;i++){
+        while (btstack_run_loop_posix_execute_code_on_main_thread(&producer_call, (void *) ((producer << 24) | i)) == false){
+            __atomic_fetch_add(&calls_queue_full, 1, __ATOMIC_RELAXED);
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static uint64_t latency_post_ns;
+static uint64_t latency_total_ns;
+static uint32_t latency_calls;
+
+static void latency_call(void * arg){
+    UNUSED(arg);
+    latency_total_ns += get_time_ns() - latency_post_ns;
+    __atomic_store_n(&latency_calls, latency_calls + 1, __ATOMIC_RELEASE);
+}
+
+static void * latency_thread(void * context){
+    UNUSED(context);
+    uint32_t i;
+    for (i=0;i<LATENCY_ITERATIONS;i++){
+        // wait for previous call to be processed, give run loop time to block in select
+        while (__atomic_load_n(&latency_calls, __ATOMIC_ACQUIRE) != i){
+            sched_yield();
+        }
+        usleep(50);
+        latency_post_ns = get_time_ns();
+        btstack_run_loop_posix_execute_code_on_main_thread(&latency_call, NULL);
+    }
+    return NULL;
+}
+
+TEST_GROUP(RunLoopPosixQueue){
+    void setup(void){
+        reset_state();
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        memset(calls_received, 0, sizeof(calls_received));
+        calls_in_order = true;
+        calls_total = 0;
+        calls_queue_full = 0;
+        latency_total_ns = 0;
+        latency_calls = 0;
+    }
+    void teardown(void){
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(RunLoopPosixQueue, SingleThread){
+    CHECK(btstack_run_loop_posix_execute_code_on_main_thread(&producer_call, (void *) 0));
+    CHECK(btstack_run_loop_posix_execute_code_on_main_thread(&producer_call, (void *) 1));
+    btstack_run_loop_posix_execute_once();
+    CHECK_EQUAL(2, calls_total);
+    CHECK(calls_in_order);
+}
+
+TEST(RunLoopPosixQueue, QueueFull){
+    uint32_t i = 0;
+    while (btstack_run_loop_posix_execute_code_on_main_thread(&producer_call, (void *) (uintptr_t) i)){
+        i++;
+    }
+    CHECK(i > 0);
+    // processed in batches, wakes up again if more calls pending
+    while (calls_total < i){
+        btstack_run_loop_posix_execute_once();
+    }
+    CHECK_EQUAL(i, calls_total);
+    CHECK(calls_in_order);
+}
+
+TEST(RunLoopPosixQueue, Trigger){
+    btstack_run_loop_posix_trigger();
+    btstack_run_loop_posix_trigger();
+    // returns after wakeup
+    btstack_run_loop_posix_execute_once();
+    CHECK_EQUAL(0, calls_total);
+}
+
+TEST(RunLoopPosixQueue, MultipleProducers){
+    pthread_t threads[NUM_PRODUCERS];
+    uintptr_t i;
+    uint64_t start_ns = get_time_ns();
+    for (i=0;i<NUM_PRODUCERS;i++){
+        CHECK_EQUAL(0, pthread_create(&threads[i], NULL, &producer_thread, (void *) i));
+    }
+    while (calls_total < (NUM_PRODUCERS * CALLS_PER_PRODUCER)){
+        btstack_run_loop_posix_execute_once();
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    for (i=0;i<NUM_PRODUCERS;i++){
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(calls_in_order);
+    for (i=0;i<NUM_PRODUCERS;i++){
+        CHECK_EQUAL(CALLS_PER_PRODUCER, calls_received[i]);
+    }
+    printf("Queue throughput with %u producers: %u calls/s, %u times queue full\n", NUM_PRODUCERS,
+           (unsigned int) (((uint64_t) calls_total * 1000000000ULL) / duration_ns), calls_queue_full);
+}
+
+TEST(RunLoopPosixQueue, WakeLatency){
+    pthread_t thread;
+    CHECK_EQUAL(0, pthread_create(&thread, NULL, &latency_thread, NULL));
+    while (latency_calls < LATENCY_ITERATIONS){
+        btstack_run_loop_posix_execute_once();
+    }
+    pthread_join(thread, NULL);
+    printf("Queue wake latency: %u ns\n", (unsigned int) (latency_total_ns / LATENCY_ITERATIONS));
+}
+
+#ifdef __linux__
+
+TEST_GROUP(RunLoopEpoll){
+    void setup(void){
+        reset_state();
+        btstack_run_loop_init(btstack_run_loop_epoll_get_instance());
+        execute_once = &btstack_run_loop_epoll_execute_once;
+    }
+    void teardown(void){
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(RunLoopEpoll, Read){
+    test_read();
+}
+
+TEST(RunLoopEpoll, DisabledRead){
+    test_disabled_read();
+}
+
+TEST(RunLoopEpoll, Write){
+    test_write();
+}
+
+TEST(RunLoopEpoll, RemoveInCallback){
+    test_remove_in_callback();
+}
+
+TEST(RunLoopEpoll, Timer){
+    test_timer();
+}
+
+// Benchmark: dispatch latency from eventfd write to data source callback for 10/100/1000 data sources
+
+#define BENCHMARK_ITERATIONS 2000
+
+static uint64_t timespec_to_ns(const struct timespec * ts){
+    return ((uint64_t) ts->tv_sec * 1000000000ULL) + (uint64_t) ts->tv_nsec;
+}
+
+static void setup_eventfd_data_sources(int num){
+    int i;
+    for (i=0;i<num;i++){
+        int fd = eventfd(0, EFD_NONBLOCK);
+        CHECK(fd >= 0);
+        data_source_fds[i] = fd;
+        pipe_write_fds[i]  = -1;
+        btstack_run_loop_set_data_source_fd(&data_sources[i], fd);
+        btstack_run_loop_set_data_source_handler(&data_sources[i], &data_source_handler);
+        btstack_run_loop_enable_data_source_callbacks(&data_sources[i], DATA_SOURCE_CALLBACK_READ);
+        btstack_run_loop_add_data_source(&data_sources[i]);
+    }
+    num_data_sources = num;
+}
+
+static uint64_t benchmark_dispatch(const btstack_run_loop_t * run_loop, void (*run_loop_execute_once)(void), int num){
+    reset_state();
+    btstack_run_loop_init(run_loop);
+    execute_once = run_loop_execute_once;
+    setup_eventfd_data_sources(num);
+    uint64_t total_ns = 0;
+    int i;
+    for (i=0;i<BENCHMARK_ITERATIONS;i++){
+        int index = (i * 7919) % num;
+        uint64_t value = 1;
+        struct timespec start_ts;
+        clock_gettime(CLOCK_MONOTONIC, &start_ts);
+        CHECK_EQUAL(sizeof(value), (size_t) write(data_source_fds[index], &value, sizeof(value)));
+        execute_once();
+        CHECK(last_data_source == &data_sources[index]);
+        total_ns += timespec_to_ns(&dispatch_ts) - timespec_to_ns(&start_ts);
+    }
+    CHECK_EQUAL(BENCHMARK_ITERATIONS, read_callbacks);
+    close_data_sources();
+    btstack_run_loop_deinit();
+    return total_ns / BENCHMARK_ITERATIONS;
+}
+
+TEST_GROUP(RunLoopBenchmark){
+};
+
+TEST(RunLoopBenchmark, DispatchLatency){
+    const int sizes[] = { 10, 100, 1000 };
+    unsigned int i;
+    for (i=0;i<sizeof(sizes)/sizeof(int);i++){
+        int num = sizes[i];
+        // select can only handle fds < FD_SETSIZE
+        uint64_t select_ns = 0;
+        if ((num + 16) < FD_SETSIZE){
+            select_ns = benchmark_dispatch(btstack_run_loop_posix_get_instance(), &btstack_run_loop_posix_execute_once, num);
+        }
+        uint64_t epoll_ns = benchmark_dispatch(btstack_run_loop_epoll_get_instance(), &btstack_run_loop_epoll_execute_once, num);
+        printf("Dispatch latency with %4u data sources: select %6u ns, epoll %6u ns\n", num, (unsigned int) select_ns, (unsigned int) epoll_ns);
+    }
+}
+
+#endif
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -31,6 +31,10 @@ uint8_t * mock_packet_buffer(void){
 	return packet_buffer;
 }
 
+uint16_t mock_packet_buffer_len(void){
+	return packet_buffer_len;
+}
+
 void mock_clear_packet_buffer(void){
 	packet_buffer_len = 0;
 	memset(packet_buffer, 0, sizeof(packet_buffer));
@@ -279,3 +283,7 @@ static uint32_t time_ms;
 uint32_t hal_time_ms(void){
 	return time_ms++;
 }
+
+void mock_advance_time_ms(uint32_t delta_ms){
+	time_ms += delta_ms;
+}
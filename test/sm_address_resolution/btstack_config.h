@@ -0,0 +1,27 @@
+//
+// btstack_config.h for address resolution test
+//
+
+#ifndef BTSTACK_CONFIG_H
+#define BTSTACK_CONFIG_H
+
+// Port related features
+#define HAVE_EMBEDDED_TIME_MS
+#define HAVE_MALLOC
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LE_CENTRAL
+#define ENABLE_LE_PERIPHERAL
+#define ENABLE_PRINTF_HEXDUMP
+#define ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+// ENABLE_SOFTWARE_AES128 is set by Makefile for the build-software variant
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 69
+#define HCI_INCOMING_PRE_BUFFER_SIZE 4
+
+#define MAX_NR_LE_DEVICE_DB_ENTRIES 1000
+#define SM_ADDRESS_RESOLUTION_CACHE_SIZE 4
+
+#endif
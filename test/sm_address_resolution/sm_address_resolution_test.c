@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// *****************************************************************************
+//
+// Resolvable Private Address lookup: cache and AES operation count
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_config.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop_embedded.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+#include "ble/le_device_db.h"
+#include "ble/sm.h"
+
+void mock_init(void);
+void mock_simulate_hci_state_working(void);
+void mock_simulate_hci_event(uint8_t * packet, uint16_t size);
+void aes128_report_result(void);
+void aes128_calc_cyphertext(uint8_t key[16], uint8_t plaintext[16], uint8_t cyphertext[16]);
+uint8_t * mock_packet_buffer(void);
+uint16_t mock_packet_buffer_len(void);
+void mock_clear_packet_buffer(void);
+void mock_advance_time_ms(uint32_t delta_ms);
+
+static btstack_packet_callback_registration_t sm_event_callback_registration;
+
+static bool     resolving_done;
+static bool     resolving_succeeded;
+static uint16_t resolving_index;
+static uint32_t num_le_encrypt;
+
+static void sm_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED:
+            resolving_done = true;
+            resolving_succeeded = true;
+            resolving_index = sm_event_identity_resolving_succeeded_get_index(packet);
+            break;
+        case SM_EVENT_IDENTITY_RESOLVING_FAILED:
+            resolving_done = true;
+            resolving_succeeded = false;
+            break;
+        default:
+            break;
+    }
+}
+
+// run stack and answer HCI Commands until nothing is pending
+static void process(void){
+    int idle = 0;
+    while (idle < 3){
+        btstack_run_loop_embedded_execute_once();
+        if (mock_packet_buffer_len() == 0){
+            idle++;
+            continue;
+        }
+        idle = 0;
+        uint16_t opcode = little_endian_read_16(mock_packet_buffer(), 0);
+        mock_clear_packet_buffer();
+        if (opcode == hci_le_encrypt.opcode){
+            num_le_encrypt++;
+            aes128_report_result();
+        } else if (opcode == hci_le_rand.opcode){
+            uint8_t rand_event[] = { HCI_EVENT_COMMAND_COMPLETE, 0x0c, 0x01, 0x18, 0x20, 0x00, 0x2f, 0x04, 0x82, 0x84, 0x72, 0x46, 0x9c, 0x93 };
+            mock_simulate_hci_event(rand_event, sizeof(rand_event));
+        } else {
+            uint8_t command_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 4, 1, (uint8_t) (opcode & 0xff), (uint8_t) (opcode >> 8), 0 };
+            mock_simulate_hci_event(command_complete, sizeof(command_complete));
+        }
+    }
+}
+
+static void irk_for_device(int device, sm_key_t irk){
+    memset(irk, 0x5a, 16);
+    big_endian_store_32(irk, 0, (uint32_t) device);
+}
+
+static void identity_for_device(int device, bd_addr_t addr){
+    addr[0] = 0x00;
+    addr[1] = 0x1b;
+    big_endian_store_32(addr, 2, (uint32_t) device);
+}
+
+// RPA = prand (msb 0b01) || ah(irk, prand)
+static void rpa_for_device(int device, uint8_t nonce, bd_addr_t rpa){
+    sm_key_t irk;
+    irk_for_device(device, irk);
+    uint8_t r_prime[16];
+    uint8_t hash[16];
+    memset(r_prime, 0, 16);
+    r_prime[13] = 0x40 | (nonce & 0x3f);
+    r_prime[14] = (uint8_t) (device >> 8);
+    r_prime[15] = (uint8_t) device;
+    aes128_calc_cyphertext(irk, r_prime, hash);
+    memcpy(&rpa[0], &r_prime[13], 3);
+    memcpy(&rpa[3], &hash[13], 3);
+}
+
+static void add_bonds(int num_bonds){
+    int i;
+    for (i=0;i<num_bonds;i++){
+        sm_key_t irk;
+        bd_addr_t addr;
+        irk_for_device(i, irk);
+        identity_for_device(i, addr);
+        le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, irk);
+    }
+}
+
+static uint32_t resolve(bd_addr_t rpa){
+    resolving_done = false;
+    num_le_encrypt = 0;
+    sm_address_resolution_lookup(BD_ADDR_TYPE_LE_RANDOM, rpa);
+    process();
+    CHECK(resolving_done);
+    return num_le_encrypt;
+}
+
+static double time_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000.0) + (ts.tv_nsec / 1000.0);
+}
+
+TEST_GROUP(AddressResolution){
+    void setup(void){
+        static int first = 1;
+        if (first){
+            first = 0;
+            btstack_memory_init();
+            btstack_run_loop_init(btstack_run_loop_embedded_get_instance());
+        }
+        le_device_db_init();
+        sm_init();
+        sm_event_callback_registration.callback = &sm_packet_handler;
+        sm_add_event_handler(&sm_event_callback_registration);
+        mock_init();
+        mock_simulate_hci_state_working();
+        process();
+    }
+};
+
+TEST(AddressResolution, Benchmark){
+    const int num_bonds_list[] = { 10, 100, 1000 };
+    unsigned int i;
+    for (i=0;i<sizeof(num_bonds_list)/sizeof(int);i++){
+        int num_bonds = num_bonds_list[i];
+        le_device_db_init();
+        add_bonds(num_bonds);
+
+        // worst case: last bonded device
+        bd_addr_t rpa;
+        rpa_for_device(num_bonds - 1, 1, rpa);
+
+        double start_us = time_us();
+        uint32_t aes_uncached = resolve(rpa);
+        double uncached_us = time_us() - start_us;
+        CHECK(resolving_succeeded);
+        CHECK_EQUAL(num_bonds - 1, resolving_index);
+
+        start_us = time_us();
+        uint32_t aes_cached = resolve(rpa);
+        double cached_us = time_us() - start_us;
+        CHECK(resolving_succeeded);
+        CHECK_EQUAL(num_bonds - 1, resolving_index);
+        CHECK_EQUAL(0, aes_cached);
+
+#ifdef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
+        printf("%4u bonds, software AES: first lookup %.0f us, cached %.0f us\n", num_bonds, uncached_us, cached_us);
+#else
+        CHECK_EQUAL(num_bonds, aes_uncached);
+        printf("%4u bonds, controller AES: first lookup %u LE Encrypt round trips, cached %u\n", num_bonds, aes_uncached, aes_cached);
+#endif
+    }
+}
+
+TEST(AddressResolution, Expiry){
+    add_bonds(10);
+    bd_addr_t rpa;
+    rpa_for_device(5, 1, rpa);
+    resolve(rpa);
+    CHECK(resolving_succeeded);
+
+    // peer has rotated its address by now
+    mock_advance_time_ms(15 * 60 * 1000);
+    uint32_t aes_count = resolve(rpa);
+    CHECK(resolving_succeeded);
+    CHECK_EQUAL(5, resolving_index);
+#ifndef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
+    CHECK_EQUAL(6, aes_count);
+#endif
+}
+
+TEST(AddressResolution, BondReplaced){
+    add_bonds(10);
+    bd_addr_t rpa;
+    rpa_for_device(3, 1, rpa);
+    resolve(rpa);
+    CHECK(resolving_succeeded);
+
+    // new bond with different IRK stored in same slot
+    le_device_db_remove(3);
+    sm_key_t irk;
+    bd_addr_t addr;
+    irk_for_device(100, irk);
+    identity_for_device(100, addr);
+    CHECK_EQUAL(3, le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, irk));
+
+    resolve(rpa);
+    CHECK(resolving_succeeded == false);
+}
+
+TEST(AddressResolution, LeastRecentlyUsed){
+    add_bonds(10);
+    bd_addr_t rpa[5];
+    int i;
+    // cache holds 4 entries, resolving 5 addresses evicts the first one
+    for (i=0;i<5;i++){
+        rpa_for_device(i, 1, rpa[i]);
+        resolve(rpa[i]);
+        CHECK(resolving_succeeded);
+    }
+    for (i=1;i<5;i++){
+        CHECK_EQUAL(0, resolve(rpa[i]));
+    }
+    uint32_t aes_count = resolve(rpa[0]);
+    CHECK(resolving_succeeded);
+    CHECK_EQUAL(0, resolving_index);
+#ifndef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
+    CHECK_EQUAL(1, aes_count);
+#endif
+    // rpa[1] was least recently used and got evicted
+    CHECK_EQUAL(0, resolve(rpa[4]));
+#ifndef ENABLE_SM_SOFTWARE_ADDRESS_RESOLUTION
+    CHECK_EQUAL(2, resolve(rpa[1]));
+#endif
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -60,6 +60,7 @@ extern "C" {
 #endif
 
 #include "btstack_config.h"
+#include "btstack_memory_pool.h"
     
 // Core
 #include "hci.h"
@@ -98,10 +99,16 @@ void btstack_memory_init(void);
 
 /**
  * @brief Deinitialize BTstack memory pools
- * @note if HAVE_MALLOC is defined, all previously allocated buffers are free'd
+ * @note if HAVE_MALLOC is defined, all previously allocated buffers are free'd and reported as leaks
  */
 void btstack_memory_deinit(void);
 
+/**
+ * @brief Log allocation statistics for all types: current, max, total allocations, failed allocations and bytes in use
+ * @note use to size MAX_NR_* defines
+ */
+void btstack_memory_dump_stats(void);
+
 /* API_END */
 """
 
@@ -174,22 +181,20 @@ static void btstack_memory_tracking_remove(btstack_memory_buffer_t * buffer){
 
     btstack_memory_malloc_counter--;
 }
-#endif
 
-void btstack_memory_deinit(void){
-#ifdef HAVE_MALLOC
-    while (btstack_memory_malloc_buffers != NULL){
-        btstack_memory_buffer_t * buffer = btstack_memory_malloc_buffers;
-        btstack_memory_malloc_buffers = buffer->next;
-        free(buffer);
+static void btstack_memory_stats_add(btstack_memory_pool_stats_t * stats){
+    stats->num_allocations++;
+    stats->in_use++;
+    if (stats->in_use > stats->max_in_use){
+        stats->max_in_use = stats->in_use;
     }
-    btstack_assert(btstack_memory_malloc_counter == 0);
-#endif
 }
+#endif
 """
 
 header_template = """STRUCT_NAME_t * btstack_memory_STRUCT_NAME_get(void);
-void   btstack_memory_STRUCT_NAME_free(STRUCT_NAME_t *STRUCT_NAME);"""
+void   btstack_memory_STRUCT_NAME_free(STRUCT_NAME_t *STRUCT_NAME);
+void   btstack_memory_STRUCT_NAME_get_stats(btstack_memory_pool_stats_t * stats);"""
 
 code_template = """
 // MARK: STRUCT_TYPE
@@ -204,6 +209,7 @@ code_template = """
 #ifdef POOL_COUNT
 #if POOL_COUNT > 0
 static STRUCT_TYPE STRUCT_NAME_storage[POOL_COUNT];
+static uint32_t STRUCT_NAME_bitmap[BTSTACK_MEMORY_POOL_BITMAP_WORDS(POOL_COUNT)];
 static btstack_memory_pool_t STRUCT_NAME_pool;
 STRUCT_NAME_t * btstack_memory_STRUCT_NAME_get(void){
     void * buffer = btstack_memory_pool_get(&STRUCT_NAME_pool);
@@ -215,6 +221,9 @@ STRUCT_NAME_t * btstack_memory_STRUCT_NAME_get(void){
 void btstack_memory_STRUCT_NAME_free(STRUCT_NAME_t *STRUCT_NAME){
     btstack_memory_pool_free(&STRUCT_NAME_pool, STRUCT_NAME);
 }
+void btstack_memory_STRUCT_NAME_get_stats(btstack_memory_pool_stats_t * stats){
+    btstack_memory_pool_get_stats(&STRUCT_NAME_pool, stats);
+}
 #else
 STRUCT_NAME_t * btstack_memory_STRUCT_NAME_get(void){
     return NULL;
@@ -222,6 +231,9 @@ STRUCT_NAME_t * btstack_memory_STRUCT_NAME_get(void){
 void btstack_memory_STRUCT_NAME_free(STRUCT_NAME_t *STRUCT_NAME){
     UNUSED(STRUCT_NAME);
 };
+void btstack_memory_STRUCT_NAME_get_stats(btstack_memory_pool_stats_t * stats){
+    memset(stats, 0, sizeof(btstack_memory_pool_stats_t));
+}
 #endif
 #elif defined(HAVE_MALLOC)
 
@@ -230,13 +242,17 @@ typedef struct {
     STRUCT_NAME_t data;
 } btstack_memory_STRUCT_NAME_t;
 
+static btstack_memory_pool_stats_t STRUCT_NAME_stats;
+
 STRUCT_NAME_t * btstack_memory_STRUCT_NAME_get(void){
     btstack_memory_STRUCT_NAME_t * buffer = (btstack_memory_STRUCT_NAME_t *) malloc(sizeof(btstack_memory_STRUCT_NAME_t));
     if (buffer){
         memset(buffer, 0, sizeof(btstack_memory_STRUCT_NAME_t));
         btstack_memory_tracking_add(&buffer->tracking);
+        btstack_memory_stats_add(&STRUCT_NAME_stats);
         return &buffer->data;
     } else {
+        STRUCT_NAME_stats.num_failed++;
         return NULL;
     }
 }
@@ -244,8 +260,12 @@ void btstack_memory_STRUCT_NAME_free(STRUCT_NAME_t *STRUCT_NAME){
     // reconstruct buffer start
     btstack_memory_buffer_t * buffer = &((btstack_memory_buffer_t *) STRUCT_NAME)[-1];
     btstack_memory_tracking_remove(buffer);
+    STRUCT_NAME_stats.in_use--;
     free(buffer);
 }
+void btstack_memory_STRUCT_NAME_get_stats(btstack_memory_pool_stats_t * stats){
+    *stats = STRUCT_NAME_stats;
+}
 #endif
 """
 init_header = '''
@@ -254,14 +274,57 @@ void btstack_memory_init(void){
 #ifdef HAVE_MALLOC
     // assert that there is no unexpected padding for combined buffer
     btstack_assert(sizeof(test_buffer_t) == sizeof(btstack_memory_buffer_t) + sizeof(void *));
+    btstack_memory_malloc_stats_reset();
 #endif
   
 '''
 
 init_template = """#if POOL_COUNT > 0
-    btstack_memory_pool_create(&STRUCT_NAME_pool, STRUCT_NAME_storage, POOL_COUNT, sizeof(STRUCT_TYPE));
+    btstack_memory_pool_create_with_bitmap(&STRUCT_NAME_pool, STRUCT_NAME_storage, POOL_COUNT, sizeof(STRUCT_TYPE), STRUCT_NAME_bitmap);
+#endif"""
+
+stats_reset_template = """#ifndef POOL_COUNT
+    memset(&STRUCT_NAME_stats, 0, sizeof(btstack_memory_pool_stats_t));
 #endif"""
 
+stats_iterate_template = """    btstack_memory_STRUCT_NAME_get_stats(&stats);
+    (*handler)("STRUCT_NAME", sizeof(STRUCT_TYPE), &stats);"""
+
+stats_footer = '''
+static void btstack_memory_log_stats(const char * name, uint32_t size, const btstack_memory_pool_stats_t * stats){
+    log_info("%-32s in use %3u, max %3u, allocations %6u, failed %3u, bytes in use %6u", name,
+             (unsigned int) stats->in_use, (unsigned int) stats->max_in_use, (unsigned int) stats->num_allocations,
+             (unsigned int) stats->num_failed, (unsigned int) (stats->in_use * size));
+}
+
+void btstack_memory_dump_stats(void){
+    btstack_memory_iterate_stats(&btstack_memory_log_stats);
+}
+
+#ifdef HAVE_MALLOC
+static void btstack_memory_log_leak(const char * name, uint32_t size, const btstack_memory_pool_stats_t * stats){
+    if (stats->in_use == 0u) return;
+    log_error("%-32s %3u not freed, %6u bytes", name, (unsigned int) stats->in_use, (unsigned int) (stats->in_use * size));
+}
+#endif
+
+void btstack_memory_deinit(void){
+#ifdef HAVE_MALLOC
+    if (btstack_memory_malloc_counter > 0u){
+        log_error("%u buffers not freed", (unsigned int) btstack_memory_malloc_counter);
+        btstack_memory_iterate_stats(&btstack_memory_log_leak);
+    }
+    while (btstack_memory_malloc_buffers != NULL){
+        btstack_memory_buffer_t * buffer = btstack_memory_malloc_buffers;
+        btstack_memory_malloc_buffers = buffer->next;
+        free(buffer);
+        btstack_memory_malloc_counter--;
+    }
+    btstack_memory_malloc_stats_reset();
+#endif
+}
+'''
+
 def writeln(f, data):
     f.write(data + "\n")
 
@@ -359,6 +422,39 @@ for struct_names in list_of_mesh_structs:
     writeln(f, "")
 writeln(f, "#endif")
 
+def writeAllStructs(f, template):
+    for struct_names in list_of_structs:
+        for struct_name in struct_names:
+            writeln(f, replacePlaceholder(template, struct_name))
+    writeln(f, "#ifdef ENABLE_CLASSIC")
+    for struct_names in list_of_classic_structs:
+        for struct_name in struct_names:
+            writeln(f, replacePlaceholder(template, struct_name))
+    writeln(f, "#endif")
+    writeln(f, "#ifdef ENABLE_BLE")
+    for struct_names in list_of_le_structs:
+        for struct_name in struct_names:
+            writeln(f, replacePlaceholder(template, struct_name))
+    writeln(f, "#endif")
+    writeln(f, "#ifdef ENABLE_MESH")
+    for struct_names in list_of_mesh_structs:
+        for struct_name in struct_names:
+            writeln(f, replacePlaceholder(template, struct_name))
+    writeln(f, "#endif")
+
+writeln(f, "#ifdef HAVE_MALLOC")
+writeln(f, "static void btstack_memory_malloc_stats_reset(void){")
+writeAllStructs(f, stats_reset_template)
+writeln(f, "}")
+writeln(f, "#endif")
+writeln(f, "")
+writeln(f, "typedef void (*btstack_memory_stats_handler_t)(const char * name, uint32_t size, const btstack_memory_pool_stats_t * stats);")
+writeln(f, "")
+writeln(f, "static void btstack_memory_iterate_stats(btstack_memory_stats_handler_t handler){")
+writeln(f, "    btstack_memory_pool_stats_t stats;")
+writeAllStructs(f, stats_iterate_template)
+writeln(f, "}")
+
 f.write(init_header)
 for struct_names in list_of_structs:
     for struct_name in struct_names:
@@ -379,6 +475,7 @@ for struct_names in list_of_mesh_structs:
         writeln(f, replacePlaceholder(init_template, struct_name))
 writeln(f, "#endif")
 writeln(f, "}")
+f.write(stats_footer)
 f.close();
     
 # also generate test code
@@ -425,10 +522,24 @@ TEST(btstack_memory, deinit){
     btstack_memory_hci_connection_free(buffer_1);
     // leave buffer in list
     (void) buffer_2;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(3, stats.max_in_use);
+    CHECK_EQUAL(3, stats.num_allocations);
+    // report leak and free buffer
     btstack_memory_deinit();
+    btstack_memory_hci_connection_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
 }
 #endif
 
+TEST(btstack_memory, dump_stats){
+    hci_connection_t * buffer = btstack_memory_hci_connection_get();
+    btstack_memory_dump_stats();
+    btstack_memory_hci_connection_free(buffer);
+}
+
 """
 
 test_template = """
@@ -438,7 +549,14 @@ TEST(btstack_memory, STRUCT_NAME_GetAndFree){
 #ifdef HAVE_MALLOC
     context = btstack_memory_STRUCT_NAME_get();
     CHECK(context != NULL);
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_STRUCT_NAME_get_stats(&stats);
+    CHECK_EQUAL(1, stats.in_use);
+    CHECK_EQUAL(sizeof(STRUCT_TYPE) * stats.in_use, sizeof(STRUCT_TYPE));
     btstack_memory_STRUCT_NAME_free(context);
+    btstack_memory_STRUCT_NAME_get_stats(&stats);
+    CHECK_EQUAL(0, stats.in_use);
+    CHECK_EQUAL(1, stats.num_allocations);
 #else
 #ifdef POOL_COUNT
     // single
@@ -458,6 +576,9 @@ TEST(btstack_memory, STRUCT_NAME_NotEnoughBuffers){
     STRUCT_NAME_t * context;
 #ifdef HAVE_MALLOC
     simulate_no_memory = 1;
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_STRUCT_NAME_get_stats(&stats);
+    CHECK_EQUAL(0, stats.num_failed);
 #else
 #ifdef POOL_COUNT
     int i;
@@ -471,6 +592,16 @@ TEST(btstack_memory, STRUCT_NAME_NotEnoughBuffers){
     // get one more
     context = btstack_memory_STRUCT_NAME_get();
     CHECK(context == NULL);
+#ifdef HAVE_MALLOC
+    btstack_memory_STRUCT_NAME_get_stats(&stats);
+    CHECK_EQUAL(1, stats.num_failed);
+#elif defined(POOL_COUNT)
+    btstack_memory_pool_stats_t stats;
+    btstack_memory_STRUCT_NAME_get_stats(&stats);
+    CHECK_EQUAL(POOL_COUNT, stats.in_use);
+    CHECK_EQUAL(POOL_COUNT, stats.max_in_use);
+    CHECK_EQUAL(1, stats.num_failed);
+#endif
 }
 """
 